@@ -18,12 +18,19 @@
 #include <core/utils/ThreadManager.h>
 #include <core/utils/GpuManager.h>
 #include <core/utils/DEMEPaths.h>
+#include <core/utils/ColumnarBinary.hpp>
+#include <core/utils/ParallelCsvReader.hpp>
 #include <kernel/DEMHelperKernels.cuh>
 #include <DEM/Defines.h>
 #include <DEM/Structs.h>
 #include <DEM/BdrsAndObjs.h>
 #include <DEM/Models.h>
 #include <DEM/AuxClasses.h>
+#include <DEM/SpatialIndex.h>
+#include <DEM/ContactAnalytics.h>
+#include <DEM/ClumpDecomposition.h>
+#include <DEM/BinSizeTuner.h>
+#include <DEM/DriftController.h>
 
 /// Main namespace for the DEM-Engine package.
 namespace deme {
@@ -97,7 +104,7 @@ class DEMSolver {
     /// @return Number of potential contact pairs.
     size_t GetNumContacts() const { return dT->getNumContacts(); }
     /// Get the current time step size in simulation.
-    double GetTimeStepSize() const { return m_ts_size; }
+    double GetTimeStepSize() const;
     /// Get the current expand factor in simulation.
     float GetExpandFactor() const;
     /// Set the number of dT steps before it waits for a contact-pair info update from kT.
@@ -112,9 +119,34 @@ class DEMSolver {
     double GetSimTime() const;
     /// Set the simulation time manually.
     void SetSimTime(double time);
-    /// @brief Set the strategy for auto-adapting time step size (NOT implemented, no effect yet).
+    /// @brief Set the strategy for auto-adapting time step size. The initial time step size is where it starts.
+    /// @details "max_vel" keeps the step size below a few bounds: the smallest sphere radius over the system max
+    /// velocity (a CFL-like bound), and fractions of the Rayleigh wave time and the Hertzian contact duration derived
+    /// from the clump templates and the materials' E and nu. "int_diff" in addition estimates the position error of
+    /// each step from how much the owner accelerations changed, and rejects and retries steps that are off by too much.
+    /// In both cases, the step size grows smoothly, and never beyond what kT sized the contact margins for.
     /// @param type "none" or "max_vel" or "int_diff".
     void SetAdaptiveTimeStepType(const std::string& type);
+    /// @brief Set the range the adaptive time step size stays in (default: 1/100 to 5 times the initial step size).
+    void SetAdaptiveTimeStepBounds(double min_ts, double max_ts);
+    /// @brief Set the fraction of the smallest sphere radius that an owner at system max velocity may travel in one
+    /// step, when adapting the time step size (default 0.1).
+    void SetAdaptiveTimeStepCFL(double cfl);
+    /// @brief Set the fractions of the Rayleigh wave time and of the Hertzian contact duration that one time step may
+    /// be, when adapting the time step size (default 0.2 and 0.05). Use 0 to drop a bound.
+    void SetAdaptiveTimeStepStiffnessFactors(double rayleigh_factor, double hertz_factor);
+    /// @brief Set the max ratio between two consecutive step sizes, when the adaptive time step size grows (default
+    /// 1.05). Shrinking is not limited.
+    void SetAdaptiveTimeStepGrowth(double max_growth);
+    /// @brief Set the allowed position error of one step as a fraction of the smallest sphere radius, for the
+    /// "int_diff" adaptive time step strategy (default 1e-4).
+    void SetAdaptiveTimeStepTolerance(double tol);
+    /// @brief Get the step size history of the adaptive time stepper. A record is added when the step size changes by
+    /// more than 1%, when what limits it changes, or when a step is rejected. Only the latest TS_HISTORY_MAX_RECORDS
+    /// (10000) records are kept.
+    std::vector<TimeStepRecord> GetTimeStepHistory() const;
+    /// @brief Clear the step size history of the adaptive time stepper.
+    void ClearTimeStepHistory();
 
     /// @brief Set the time integrator for this simulator.
     /// @param intg "forward_euler" or "extended_taylor" or "centered_difference".
@@ -172,6 +204,26 @@ class DEMSolver {
     /// Instruct the solver if contact pair arrays should be sorted (based on the types of contacts) before usage.
     void SetSortContactPairs(bool use_sort) { should_sort_contacts = use_sort; }
 
+    /// Instruct the solver to reorder each mesh's triangles along a Morton curve of their centroids at initialization,
+    /// so triangles with consecutive IDs touch nearby bins. Tracker-based per-triangle queries and modifications keep
+    /// using the triangle order of the mesh file; use DEMMeshConnected::GetTriangleInputID to translate other triangle
+    /// IDs (such as those in contact info).
+    void SetSortMeshTriangles(bool use_sort = true) { sort_mesh_triangles = use_sort; }
+
+    /// @brief Reorder clumps, and their sphere components, along a Morton curve of their CoMs every freq time steps, so
+    /// spatially close particles stay close in memory as the system mixes.
+    /// @details It happens at the end of DoDynamicsThenSync calls, once at least freq steps passed since the last
+    /// reordering. Owner and sphere IDs seen through the API (trackers, contact info, output files) do not change. 0 or
+    /// a negative number (default) disables it.
+    void SetOwnerReorderFreq(int freq) { m_owner_reorder_freq = freq; }
+    /// @brief Reorder clumps, and their sphere components, along a Morton curve of their CoMs right now. The system
+    /// must be initialized and synced (see DoDynamicsThenSync).
+    void ReorderOwnersSpatially();
+    /// @brief Set the names of the contact wildcards that change sign when geometries A and B in a contact swap roles,
+    /// which owner reordering may need to do to sphere--sphere contacts. Default: delta_tan_x, delta_tan_y and
+    /// delta_tan_z.
+    void SetAntisymmetricContactWildcards(const std::set<std::string>& names);
+
     /// Instruct the solver to rearrange and consolidate clump templates information, then jitify it into GPU kernels
     /// (if set to true), rather than using flattened sphere component configuration arrays whose entries are associated
     /// with individual spheres.
@@ -284,6 +336,21 @@ class DEMSolver {
     void SetAdaptiveBinSizeLowerProactivity(float ratio) {
         auto_adjust_lower_proactive_ratio = clampBetween(ratio, 0.0, 1.0);
     }
+    /// @brief Set how kT picks the bin size when adaptive bin size is on.
+    /// @param type "cost_model" (default): fit a model of the CD cost to past CD runs and go to the bin size it
+    /// predicts to be the cheapest; "heuristic": the original scheme that keeps nudging the bin size in whichever
+    /// direction lowered the CD time.
+    void SetAdaptiveBinSizeStrategy(const std::string& type);
+    /// @brief Set how kT picks the bin size when adaptive bin size is on.
+    void SetAdaptiveBinSizeStrategy(BIN_TUNER_TYPE type) { m_bin_tuner_type = type; }
+    /// @brief Enable or disable keeping the statistics (bin size, work done, time taken) of every contact detection.
+    /// They can be saved with WriteCDStatsCsv, and used to compare bin size strategies offline with ReplayBinSizeTuner.
+    void SetCDStatsRecording(bool record = true);
+    /// @brief Get the statistics of the contact detections done since recording started. Must be called from
+    /// synchronized stance.
+    std::vector<CDStatsRecord> GetCDStatsRecord() const;
+    /// @brief Clear the recorded contact detection statistics.
+    void ClearCDStatsRecord();
     /// @brief Get the current bin (for contact detection) size. Must be called from synchronized stance.
     /// @return Bin size.
     double GetBinSize() { return kT->simParams->binSize; }
@@ -307,6 +374,27 @@ class DEMSolver {
     /// @brief Set the number of past kT updates that dT will use to calibrate the max future drift limit.
     /// @param n Number of kT updates. Suggest using default.
     void SetCDNumStepsMaxDriftHistorySize(unsigned int n);
+    /// @brief Set how dT adjusts the max future drift (and so the CD update frequency) when it is adjusted
+    /// automatically.
+    /// @param type "step_count" (default): nudge it toward a multiple of the average dT steps per kT update, and up
+    /// whenever dT waits; "predictive": set it from the measured CD round trip and dT step latencies, so the two
+    /// threads are balanced, with safety steps that cover the latency jitter without inflating the contact margin much.
+    void SetAdaptiveUpdateFreqStrategy(const std::string& type);
+    /// @brief Set how dT adjusts the max future drift when it is adjusted automatically.
+    void SetAdaptiveUpdateFreqStrategy(DRIFT_CTRL_TYPE type) { m_drift_ctrl_type = type; }
+    /// @brief Set the parameters of the "predictive" update frequency strategy.
+    /// @param jitter_factor Std devs of the CD round trip latency that the safety steps cover (default 1.5).
+    /// @param margin_budget Most contact margin the safety steps may add, as a fraction of the smallest sphere radius
+    /// (default 0.5).
+    /// @param smoothing Weight of the newest latency measurement in the moving averages, (0, 1] (default 0.2).
+    void SetPredictiveUpdateFreqParams(float jitter_factor, float margin_budget = 0.5, float smoothing = 0.2) {
+        m_drift_jitter_factor = jitter_factor;
+        m_drift_margin_budget = margin_budget;
+        m_drift_smoothing = smoothing;
+    }
+    /// @brief Get the internal state (latency estimates, balanced drift, safety steps, waits) of the update frequency
+    /// controller. Must be called from synchronized stance.
+    DriftControllerState GetUpdateFreqControllerState() const;
     /// @brief Get the current update frequency used by the solver.
     /// @return The current update frequency.
     float GetUpdateFreq() const;
@@ -565,6 +653,23 @@ class DEMSolver {
     /// the normal direction at the contact point.
     std::shared_ptr<ContactInfoContainer> GetContactDetailedInfo(float force_thres = -1.0) const;
 
+    /// @brief Get the same contact info as GetContactDetailedInfo, in compact form.
+    /// @details Contact types are kept as contact_t codes (use GetContactTypeName for the names), and all columns sit
+    /// in one buffer that is reused by later calls once the returned pointer is released, so polling contacts this way
+    /// in a loop does not allocate. ExportSoA gives a zero-copy description of the buffer.
+    /// @param force_thres Contacts with force+torque magnitude smaller than this are not included.
+    /// @return The contact info container.
+    std::shared_ptr<const CompactContactInfo> GetContactDetailedInfoCompact(float force_thres = -1.0) const;
+
+    /// @brief Compute contact network statistics (coordination number, fabric, stress, mobilized friction, force-chain
+    /// percolation) of the current contacts, per group as the analyzer is set up, without writing out contact pairs.
+    /// @details The contact output content must include OWNER (and FORCE).
+    /// @param analyzer The analyzer, set up with grouping and parameters.
+    /// @param force_thres Contacts with force+torque magnitude smaller than this are not included.
+    /// @return The statistics of each group.
+    std::vector<ContactNetworkStats> AnalyzeContactNetwork(const ContactNetworkAnalyzer& analyzer,
+                                                           float force_thres = -1.0) const;
+
     /// @brief Get the host memory usage (in bytes) on dT.
     /// @return Number of bytes.
     size_t GetHostMemUsageDynamic() const { return dT->estimateHostMemUsage(); }
@@ -631,7 +736,7 @@ class DEMSolver {
         return AddClumps(input_type, loc_xyz);
     }
 
-    /// Load a mesh-represented object
+    /// Load a mesh-represented object. Besides Wavefront .obj, .stl and .ply files are accepted (picked by extension).
     std::shared_ptr<DEMMeshConnected> AddWavefrontMeshObject(const std::string& filename,
                                                              const std::shared_ptr<DEMMaterial>& mat,
                                                              bool load_normals = true,
@@ -641,6 +746,10 @@ class DEMSolver {
                                                              bool load_uv = false);
     std::shared_ptr<DEMMeshConnected> AddWavefrontMeshObject(DEMMeshConnected& mesh);
 
+    /// Cache meshes loaded by AddWavefrontMeshObject in this directory, keyed by file content hash, so later runs
+    /// loading the same files skip parsing them. Empty (the default) disables caching.
+    void SetMeshCacheDir(const std::string& dir) { m_mesh_cache_dir = dir; }
+
     /// @brief Create a DEMTracker to allow direct control/modification/query to this external object/batch of
     /// clumps/triangle mesh object.
     /// @details By default, it refers to the first clump in this batch. The user can refer to other clumps in this
@@ -672,6 +781,19 @@ class DEMSolver {
     std::shared_ptr<DEMInspector> CreateInspector(const std::string& quantity = "clump_max_z");
     std::shared_ptr<DEMInspector> CreateInspector(const std::string& quantity, const std::string& region);
 
+    /// @brief Create a force probe on a set of owners, which queries the contact forces they feel, keeping its device
+    /// buffers between queries. Call it after system initialization.
+    /// @param ownerIDs The IDs of the owners.
+    /// @param net_wrench_only If true, the probe only computes the net force and torque on device and brings back those
+    /// 6 numbers, not the per-contact results.
+    std::shared_ptr<DEMForceProbe> CreateForceProbe(const std::vector<bodyID_t>& ownerIDs,
+                                                    bool net_wrench_only = false);
+    /// @brief Create a force probe on all objects tracked by a tracker.
+    std::shared_ptr<DEMForceProbe> CreateForceProbe(const std::shared_ptr<DEMTracker>& tracker,
+                                                    bool net_wrench_only = false);
+    /// @brief Update all force probes created by this solver.
+    void UpdateForceProbes();
+
     /// Instruct the solver that the 2 input families should not have contacts (a.k.a. ignored, if such a pair is
     /// encountered in contact detection). These 2 families can be the same (which means no contact within members of
     /// that family).
@@ -926,6 +1048,31 @@ class DEMSolver {
                                  std::vector<float3>& torques,
                                  bool torque_in_local = false);
 
+    /// @brief Create a reusable request for the states of a list of owners. Take it with TakeStateSnapshot(Async).
+    /// @param ownerIDs The IDs of the owners.
+    /// @param content The states to gather, as a combination of SNAPSHOT_CONTENT flags.
+    /// @return The snapshot request.
+    std::shared_ptr<StateSnapshot> NewStateSnapshot(
+        const std::vector<bodyID_t>& ownerIDs,
+        unsigned int content = SNAP_POS | SNAP_ORI_Q | SNAP_VEL | SNAP_ANG_VEL);
+    /// @brief Create a reusable request for the states of all objects tracked by a list of trackers.
+    /// @details The owners are listed tracker by tracker; StateSnapshot::TrackerStart tells where each tracker's owners
+    /// begin.
+    /// @param trackers The trackers.
+    /// @param content The states to gather, as a combination of SNAPSHOT_CONTENT flags.
+    /// @return The snapshot request.
+    std::shared_ptr<StateSnapshot> NewStateSnapshot(
+        const std::vector<std::shared_ptr<DEMTracker>>& trackers,
+        unsigned int content = SNAP_POS | SNAP_ORI_Q | SNAP_VEL | SNAP_ANG_VEL);
+    /// @brief Fill a snapshot with the current states of its owners, using one device gather and one device-to-host
+    /// copy.
+    /// @details It is an error if an owner of the snapshot is no longer in the simulation (removed by PurgeFamily).
+    void TakeStateSnapshot(const std::shared_ptr<StateSnapshot>& snapshot);
+    /// @brief Like TakeStateSnapshot, but return right after enqueuing the gather on dT's stream. The snapshot still
+    /// holds the states at the time of this call even if DoDynamics is called right after, and the copy overlaps that
+    /// DoDynamics. Reading the snapshot (or StateSnapshot::Wait) blocks until it lands.
+    void TakeStateSnapshotAsync(const std::shared_ptr<StateSnapshot>& snapshot);
+
     /// @brief Set the wildcard values of some triangles.
     /// @param geoID The ID of the starting (first) triangle that needs to be modified.
     /// @param name The name of the wildcard.
@@ -1038,6 +1185,36 @@ class DEMSolver {
         const std::pair<double, double>& Y = std::pair<double, double>(-DEME_HUGE_FLOAT, DEME_HUGE_FLOAT),
         const std::pair<double, double>& Z = std::pair<double, double>(-DEME_HUGE_FLOAT, DEME_HUGE_FLOAT),
         const std::set<unsigned int>& orig_fam = std::set<unsigned int>());
+    /// @brief Change the family number for the listed clumps to the specified value.
+    /// @param fam_num The family number to change into.
+    /// @param owners Owner IDs of the clumps to change, such as the result of a GetClumpsIn* query.
+    /// @param orig_fam Only clumps that originally have these family numbers will be modified. Leave empty to apply
+    /// changes regardless of original family numbers.
+    /// @return The number of owners that get changed by this call.
+    size_t ChangeClumpFamilyByIDs(unsigned int fam_num,
+                                  const std::vector<bodyID_t>& owners,
+                                  const std::set<unsigned int>& orig_fam = std::set<unsigned int>());
+
+    /// @brief Get the owner IDs of the clumps whose CoMs are in a box region.
+    /// @details This and the other region queries use a host-side spatial index over clump CoMs. It is built on the
+    /// first query after the simulation advances, and reused by all the queries until then, so issuing many region
+    /// queries between two DoDynamics calls costs about one full pass over the clumps. Results are sorted ascending.
+    std::vector<bodyID_t> GetClumpsInBox(const float3& L, const float3& U);
+    /// Get the owner IDs of the clumps whose CoMs are within radius of center.
+    std::vector<bodyID_t> GetClumpsInSphere(const float3& center, float radius);
+    /// @brief Get the owner IDs of the clumps whose CoMs are in a cylinder region.
+    /// @param center A point on the cylinder axis, at the middle of the cylinder.
+    /// @param axis Direction of the cylinder axis (need not be normalized).
+    /// @param radius Cylinder radius.
+    /// @param half_length Half of the cylinder length. Default is an infinitely long cylinder.
+    std::vector<bodyID_t> GetClumpsInCylinder(const float3& center,
+                                              const float3& axis,
+                                              float radius,
+                                              float half_length = DEME_HUGE_FLOAT);
+    /// Get the owner IDs of the clumps whose CoMs are on the side of the plane (through point) that normal points to.
+    std::vector<bodyID_t> GetClumpsInHalfSpace(const float3& point, const float3& normal);
+    /// Get the owner IDs of the clumps whose CoMs satisfy an arbitrary predicate.
+    std::vector<bodyID_t> GetClumpsIf(const std::function<bool(const float3&)>& pred);
 
     /// Change the sizes of the clumps by a factor. This method directly works on the clump components spheres,
     /// therefore requiring sphere components to be store in flattened array (default behavior), not jitified templates.
@@ -1048,11 +1225,31 @@ class DEMSolver {
     /// of some random number)
     void EnsureKernelErrMsgLineNum(bool flag = true) { ensure_kernel_line_num = flag; }
 
+    /// @brief Keep compiled kernels in an on-disk cache, so later runs of the same system skip the JIT compilation.
+    /// @details Entries are keyed by the fully substituted kernel source, the compile flags, the NVRTC version and the
+    /// GPU architecture. This setting is process-wide and on by default. The cache location defaults to the
+    /// DEME_JIT_CACHE_DIR environment variable, or a DEME_jit_cache folder in the user's cache directory
+    /// ($XDG_CACHE_HOME or ~/.cache). Since cached kernels are run, the cache is skipped if its folder or an entry is
+    /// not owned by the current user, or is writable by others.
+    void UseJitDiskCache(bool use = true) { JitHelper::setDiskCacheEnabled(use); }
+    /// Set the directory that the JIT kernel cache lives in.
+    void SetJitDiskCacheDir(const std::filesystem::path& dir) { JitHelper::setDiskCacheDir(dir); }
+    /// Set the max size of the JIT kernel cache in bytes (default 1 GiB). Least recently used kernels are removed first.
+    void SetJitDiskCacheMaxSize(size_t max_bytes) { JitHelper::setDiskCacheMaxBytes(max_bytes); }
+    /// Get the numbers of hits, misses and evictions of the JIT kernel cache in this process.
+    JitHelper::DiskCacheStats GetJitDiskCacheStats() const { return JitHelper::getDiskCacheStats(); }
+
     /// Whether the force collection (acceleration calc and reduction) process should be using CUB. If true, the
     /// acceleration array is flattened and reduced using CUB; if false, the acceleration is computed and directly
     /// applied to each body through atomic operations.
     void UseCubForceCollection(bool flag = true) { use_cub_to_reduce_force = flag; }
 
+    /// Whether kT should run contact detection on the host (multi-threaded via OpenMP if available) instead of on its
+    /// GPU. Useful on many-core nodes where the GPU is the bottleneck, or for validating the device CD results.
+    /// @details Only sphere--sphere and sphere--analytical contacts are detected on host, so it is an error to use it
+    /// in a simulation with mesh triangle facets (at initialization, or when meshes are added later).
+    void UseHostContactDetection(bool flag = true) { use_host_contact_detection = flag; }
+
     /// Reduce contact forces to accelerations right after calculating them, in the same kernel. This may give some
     /// performance boost if you have only polydisperse spheres, no clumps.
     void SetCollectAccRightAfterForceCalc(bool flag = true) { collect_force_in_force_kernel = flag; }
@@ -1117,6 +1314,33 @@ class DEMSolver {
     /// Write the current status of all meshes to a file.
     void WriteMeshFile(const std::string& outfilename) const;
     void WriteMeshFile(const std::filesystem::path& outfilename) const { WriteMeshFile(outfilename.string()); }
+    /// @brief Let sphere, clump and contact file writes happen in the background.
+    /// @details When on, each Write*File call only copies the needed data into a host-side frame, and a writer thread
+    /// formats and writes it while the simulation advances. Frame buffers are recycled. CHPF output is always written
+    /// synchronously. Call FlushOutput to make sure all files are on disk.
+    /// @param use Whether to use asynchronous output.
+    /// @param max_queued_frames At most this many frames can wait to be written; further Write*File calls block until
+    /// there is room. Default is 2 (double buffering).
+    void SetAsyncOutput(bool use = true, unsigned int max_queued_frames = 2);
+    /// Block until all output files queued by asynchronous Write*File calls are written to disk.
+    void FlushOutput();
+
+    /// @brief Save the full solver state to a checkpoint directory, so the simulation can be resumed later.
+    /// @details Owner positions (voxel-encoded), orientations, velocities, accelerations, families and all wildcards
+    /// are saved as-is, together with the current contact pairs and kT's contact history. So resuming from it keeps
+    /// tangential histories, unlike re-reading a clump CSV file. Call it when the solver is synced.
+    /// @param path Directory to write the checkpoint files in. It is created if it does not exist.
+    void SaveCheckpoint(const std::string& path);
+    void SaveCheckpoint(const std::filesystem::path& path) { SaveCheckpoint(path.string()); }
+    /// @brief Resume from a checkpoint written by SaveCheckpoint.
+    /// @details Call it after Initialize, on a system set up the same way as the one that saved the checkpoint (same
+    /// clumps, meshes, analytical objects and wildcards). The simulation time is restored too, and so is the step size
+    /// if it is adaptive. Tuning state that only affects speed, such as the adaptive bin size and CD update frequency,
+    /// is not saved and starts over. As CD runs alongside the dynamics, the steps at which contact pairs are refreshed
+    /// can then differ from the uninterrupted run, so results are not guaranteed to be bit-identical.
+    /// @param path Checkpoint directory.
+    void LoadCheckpoint(const std::string& path);
+    void LoadCheckpoint(const std::filesystem::path& path) { LoadCheckpoint(path.string()); }
 
     /// @brief Read 3 columns of your choice from a CSV filem and group them by clump_header.
     /// @param infilename CSV filename.
@@ -1131,17 +1355,18 @@ class DEMSolver {
         const std::string& y_header,
         const std::string& z_header,
         const std::string& clump_header) {
+        ParallelCsvReader in(infilename);
+        const auto& type_names = in.GetStringDictionary(clump_header);
+        std::vector<uint32_t> type_codes = in.GetStringCodes(clump_header);
+        std::vector<float3> XYZ = ZipFloat3Columns(in, x_header, y_header, z_header);
+        // Group by dictionary code first, so no string hashing is needed per row
+        std::vector<std::vector<float3>> grouped(type_names.size());
+        for (size_t i = 0; i < in.NumRows(); i++) {
+            grouped[type_codes[i]].push_back(XYZ[i]);
+        }
         std::unordered_map<std::string, std::vector<float3>> type_xyz_map;
-        io::CSVReader<4, io::trim_chars<' ', '\t'>, io::no_quote_escape<','>, io::throw_on_overflow,
-                      io::empty_line_comment>
-            in(infilename);
-        in.read_header(io::ignore_extra_column, clump_header, x_header, y_header, z_header);
-        std::string type_name;
-        float3 XYZ;
-        size_t count = 0;
-        while (in.read_row(type_name, XYZ.x, XYZ.y, XYZ.z)) {
-            type_xyz_map[type_name].push_back(XYZ);
-            count++;
+        for (size_t j = 0; j < type_names.size(); j++) {
+            type_xyz_map[type_names[j]] = std::move(grouped[j]);
         }
         return type_xyz_map;
     }
@@ -1168,22 +1393,61 @@ class DEMSolver {
     /// Returns an unordered_map which maps each unique clump type name to a vector of float4 (4 components of the
     /// quaternion, (Qx, Qy, Qz, Qw) = (0, 0, 0, 1) means 0 rotation).
     static std::unordered_map<std::string, std::vector<float4>> ReadClumpQuatFromCsv(const std::string& infilename) {
+        ParallelCsvReader in(infilename);
+        const auto& type_names = in.GetStringDictionary(OUTPUT_FILE_CLUMP_TYPE_NAME);
+        std::vector<uint32_t> type_codes = in.GetStringCodes(OUTPUT_FILE_CLUMP_TYPE_NAME);
+        std::vector<float4> Q = ZipQuatColumns(in);
+        std::vector<std::vector<float4>> grouped(type_names.size());
+        for (size_t i = 0; i < in.NumRows(); i++) {
+            grouped[type_codes[i]].push_back(Q[i]);
+        }
         std::unordered_map<std::string, std::vector<float4>> type_Q_map;
-        io::CSVReader<5, io::trim_chars<' ', '\t'>, io::no_quote_escape<','>, io::throw_on_overflow,
-                      io::empty_line_comment>
-            in(infilename);
-        in.read_header(io::ignore_extra_column, OUTPUT_FILE_CLUMP_TYPE_NAME, OUTPUT_FILE_QW_COL_NAME,
-                       OUTPUT_FILE_QX_COL_NAME, OUTPUT_FILE_QY_COL_NAME, OUTPUT_FILE_QZ_COL_NAME);
-        std::string type_name;
-        float4 Q;
-        size_t count = 0;
-        while (in.read_row(type_name, Q.w, Q.x, Q.y, Q.z)) {
-            type_Q_map[type_name].push_back(Q);
-            count++;
+        for (size_t j = 0; j < type_names.size(); j++) {
+            type_Q_map[type_names[j]] = std::move(grouped[j]);
         }
         return type_Q_map;
     }
 
+    /// @brief Clump states read from a clump output file, kept in file row order.
+    /// @details Row i is a clump of type type_names[type_codes[i]]. Arrays whose columns are absent from the file are
+    /// left empty. To load them, map each entry of type_names to a clump template once, then expand type_codes into the
+    /// per-clump template vector AddClumps takes.
+    struct ClumpColumns {
+        std::vector<std::string> type_names;
+        std::vector<uint32_t> type_codes;
+        std::vector<float3> xyz;
+        std::vector<float4> quat;
+        std::vector<float3> vel;
+        std::vector<float3> angVel;
+        size_t size() const { return type_codes.size(); }
+    };
+    /// @brief Read a clump CSV file (whose format is consistent with this solver's clump output file) into typed
+    /// arrays in row order, without grouping by clump type.
+    /// @details The file is memory-mapped and parsed by multiple threads, which makes this the fastest way to restart
+    /// a large simulation from CSV.
+    /// @param infilename CSV filename.
+    /// @param nThreads Number of parsing threads; 0 means use all hardware threads.
+    /// @return The clump types, positions, and whichever of quaternions, velocities and angular velocities the file has.
+    static ClumpColumns ReadClumpColumnsFromCsv(const std::string& infilename, unsigned int nThreads = 0) {
+        ParallelCsvReader in(infilename, nThreads);
+        ClumpColumns res;
+        res.type_names = in.GetStringDictionary(OUTPUT_FILE_CLUMP_TYPE_NAME);
+        res.type_codes = in.GetStringCodes(OUTPUT_FILE_CLUMP_TYPE_NAME);
+        res.xyz = ZipFloat3Columns(in, OUTPUT_FILE_X_COL_NAME, OUTPUT_FILE_Y_COL_NAME, OUTPUT_FILE_Z_COL_NAME);
+        if (in.HasColumn(OUTPUT_FILE_QW_COL_NAME)) {
+            res.quat = ZipQuatColumns(in);
+        }
+        if (in.HasColumn(OUTPUT_FILE_VEL_X_COL_NAME)) {
+            res.vel = ZipFloat3Columns(in, OUTPUT_FILE_VEL_X_COL_NAME, OUTPUT_FILE_VEL_Y_COL_NAME,
+                                       OUTPUT_FILE_VEL_Z_COL_NAME);
+        }
+        if (in.HasColumn(OUTPUT_FILE_ANGVEL_X_COL_NAME)) {
+            res.angVel = ZipFloat3Columns(in, OUTPUT_FILE_ANGVEL_X_COL_NAME, OUTPUT_FILE_ANGVEL_Y_COL_NAME,
+                                          OUTPUT_FILE_ANGVEL_Z_COL_NAME);
+        }
+        return res;
+    }
+
     /// Read all contact pairs (geometry ID) from a contact file
     static std::vector<std::pair<bodyID_t, bodyID_t>> ReadContactPairsFromCsv(
         const std::string& infilename,
@@ -1191,18 +1455,20 @@ class DEMSolver {
         const std::string& cntColName = OUTPUT_FILE_CNT_TYPE_NAME,
         const std::string& first_name = OUTPUT_FILE_GEO_ID_1_NAME,
         const std::string& second_name = OUTPUT_FILE_GEO_ID_2_NAME) {
-        io::CSVReader<3, io::trim_chars<' ', '\t'>, io::no_quote_escape<','>, io::throw_on_overflow,
-                      io::empty_line_comment>
-            in(infilename);
-        in.read_header(io::ignore_extra_column, cntColName, first_name, second_name);
-        bodyID_t A, B;
-        std::string cnt_type_name;
+        ParallelCsvReader in(infilename);
+        const auto& type_names = in.GetStringDictionary(cntColName);
+        std::vector<uint32_t> type_codes = in.GetStringCodes(cntColName);
         std::vector<std::pair<bodyID_t, bodyID_t>> pairs;
-        size_t count = 0;
-        while (in.read_row(cnt_type_name, A, B)) {
-            if (cnt_type_name == cntType) {  // only the type of contact we care
-                pairs.push_back(std::pair<bodyID_t, bodyID_t>(A, B));
-                count++;
+        auto it = std::find(type_names.begin(), type_names.end(), cntType);
+        if (it == type_names.end()) {
+            return pairs;
+        }
+        const uint32_t wanted_code = (uint32_t)(it - type_names.begin());
+        std::vector<bodyID_t> A = in.Get<bodyID_t>(first_name);
+        std::vector<bodyID_t> B = in.Get<bodyID_t>(second_name);
+        for (size_t i = 0; i < in.NumRows(); i++) {
+            if (type_codes[i] == wanted_code) {  // only the type of contact we care
+                pairs.push_back(std::pair<bodyID_t, bodyID_t>(A[i], B[i]));
             }
         }
         return pairs;
@@ -1213,31 +1479,29 @@ class DEMSolver {
         const std::string& infilename,
         const std::string& cntType = OUTPUT_FILE_SPH_SPH_CONTACT_NAME,
         const std::string& cntColName = OUTPUT_FILE_CNT_TYPE_NAME) {
-        io::LineReader in_header(infilename);
-        char* f_header = in_header.next_line();
-        std::vector<std::string> header_names = parse_string_line(std::string(f_header));
+        ParallelCsvReader in(infilename);
         std::vector<std::string> wildcard_names;
         // Find those col names that are not contact file standard names: they have to be wildcard names
-        for (const auto& col_name : header_names) {
+        for (const auto& col_name : in.GetColumnNames()) {
             if (!check_exist(CNT_FILE_KNOWN_COL_NAMES, col_name)) {
                 wildcard_names.push_back(col_name);
             }
         }
-        // Now parse in the csv file
+        // Now parse in the csv file; the file is scanned once, not once per wildcard
         std::unordered_map<std::string, std::vector<float>> w_vals;
-        size_t count = 0;
+        const auto& type_names = in.GetStringDictionary(cntColName);
+        auto it = std::find(type_names.begin(), type_names.end(), cntType);
+        if (it == type_names.end()) {
+            return w_vals;
+        }
+        const uint32_t wanted_code = (uint32_t)(it - type_names.begin());
+        std::vector<uint32_t> type_codes = in.GetStringCodes(cntColName);
         for (const auto& wildcard_name : wildcard_names) {
-            io::CSVReader<2, io::trim_chars<' ', '\t'>, io::no_quote_escape<','>, io::throw_on_overflow,
-                          io::empty_line_comment>
-                in(infilename);
-            in.read_header(io::ignore_extra_column, OUTPUT_FILE_CNT_TYPE_NAME, wildcard_name);
-            std::string cnt_type_name;
-            float w_val;
-
-            while (in.read_row(cnt_type_name, w_val)) {
-                if (cnt_type_name == cntType) {  // only the type of contact we care (SS by default)
-                    w_vals[wildcard_name].push_back(w_val);
-                    count++;
+            std::vector<float> all_vals = in.Get<float>(wildcard_name);
+            auto& vals = w_vals[wildcard_name];
+            for (size_t i = 0; i < in.NumRows(); i++) {
+                if (type_codes[i] == wanted_code) {  // only the type of contact we care (SS by default)
+                    vals.push_back(all_vals[i]);
                 }
             }
         }
@@ -1245,6 +1509,118 @@ class DEMSolver {
         return w_vals;
     }
 
+    /// @brief Read 3 columns of your choice from a binary output file (written with OUTPUT_FORMAT::BINARY) and group
+    /// them by clump_header.
+    /// @param infilename Binary filename.
+    /// @param x_header Column name of the first component.
+    /// @param y_header Column name of the second component.
+    /// @param z_header Column name of the third component.
+    /// @param clump_header The identifier column to separate types of clumps.
+    /// @return Unordered_map which maps types of clumps to a respective vector of float3s.
+    static std::unordered_map<std::string, std::vector<float3>> ReadClumpFloat3FromBinary(
+        const std::string& infilename,
+        const std::string& x_header,
+        const std::string& y_header,
+        const std::string& z_header,
+        const std::string& clump_header) {
+        ColumnarBinaryReader in(infilename);
+        const auto& type_names = in.GetStringDictionary(clump_header);
+        std::vector<uint32_t> type_codes = in.GetStringCodes(clump_header);
+        std::vector<float> X = in.Get<float>(x_header);
+        std::vector<float> Y = in.Get<float>(y_header);
+        std::vector<float> Z = in.Get<float>(z_header);
+        // Group by dictionary code first, so no string hashing is needed per row
+        std::vector<std::vector<float3>> grouped(type_names.size());
+        for (size_t i = 0; i < in.NumRows(); i++) {
+            if (type_codes[i] >= type_names.size()) {
+                DEME_ERROR("Row %zu of %s has clump type code %u, but the file only names %zu clump types.", i,
+                           infilename.c_str(), type_codes[i], type_names.size());
+            }
+            grouped[type_codes[i]].push_back(make_float3(X[i], Y[i], Z[i]));
+        }
+        std::unordered_map<std::string, std::vector<float3>> type_xyz_map;
+        for (size_t j = 0; j < type_names.size(); j++) {
+            type_xyz_map[type_names[j]] = std::move(grouped[j]);
+        }
+        return type_xyz_map;
+    }
+    /// Read clump coordinates from a binary clump output file. Returns an unordered_map which maps each unique clump
+    /// type name to a vector of float3 (XYZ coordinates).
+    static std::unordered_map<std::string, std::vector<float3>> ReadClumpXyzFromBinary(const std::string& infilename) {
+        return ReadClumpFloat3FromBinary(infilename, OUTPUT_FILE_X_COL_NAME, OUTPUT_FILE_Y_COL_NAME,
+                                         OUTPUT_FILE_Z_COL_NAME, OUTPUT_FILE_CLUMP_TYPE_NAME);
+    }
+    /// Read clump velocity from a binary clump output file. Returns an unordered_map which maps each unique clump type
+    /// name to a vector of float3 (velocity).
+    static std::unordered_map<std::string, std::vector<float3>> ReadClumpVelFromBinary(const std::string& infilename) {
+        return ReadClumpFloat3FromBinary(infilename, OUTPUT_FILE_VEL_X_COL_NAME, OUTPUT_FILE_VEL_Y_COL_NAME,
+                                         OUTPUT_FILE_VEL_Z_COL_NAME, OUTPUT_FILE_CLUMP_TYPE_NAME);
+    }
+    /// Read clump angular velocity from a binary clump output file. Returns an unordered_map which maps each unique
+    /// clump type name to a vector of float3 (angular velocity).
+    static std::unordered_map<std::string, std::vector<float3>> ReadClumpAngVelFromBinary(
+        const std::string& infilename) {
+        return ReadClumpFloat3FromBinary(infilename, OUTPUT_FILE_ANGVEL_X_COL_NAME, OUTPUT_FILE_ANGVEL_Y_COL_NAME,
+                                         OUTPUT_FILE_ANGVEL_Z_COL_NAME, OUTPUT_FILE_CLUMP_TYPE_NAME);
+    }
+
+    /// Read clump quaternions from a binary clump output file. Returns an unordered_map which maps each unique clump
+    /// type name to a vector of float4 (4 components of the quaternion, (Qx, Qy, Qz, Qw) = (0, 0, 0, 1) means 0
+    /// rotation).
+    static std::unordered_map<std::string, std::vector<float4>> ReadClumpQuatFromBinary(const std::string& infilename) {
+        ColumnarBinaryReader in(infilename);
+        const auto& type_names = in.GetStringDictionary(OUTPUT_FILE_CLUMP_TYPE_NAME);
+        std::vector<uint32_t> type_codes = in.GetStringCodes(OUTPUT_FILE_CLUMP_TYPE_NAME);
+        std::vector<float> Qw = in.Get<float>(OUTPUT_FILE_QW_COL_NAME);
+        std::vector<float> Qx = in.Get<float>(OUTPUT_FILE_QX_COL_NAME);
+        std::vector<float> Qy = in.Get<float>(OUTPUT_FILE_QY_COL_NAME);
+        std::vector<float> Qz = in.Get<float>(OUTPUT_FILE_QZ_COL_NAME);
+        std::vector<std::vector<float4>> grouped(type_names.size());
+        for (size_t i = 0; i < in.NumRows(); i++) {
+            float4 Q;
+            Q.x = Qx[i];
+            Q.y = Qy[i];
+            Q.z = Qz[i];
+            Q.w = Qw[i];
+            if (type_codes[i] >= type_names.size()) {
+                DEME_ERROR("Row %zu of %s has clump type code %u, but the file only names %zu clump types.", i,
+                           infilename.c_str(), type_codes[i], type_names.size());
+            }
+            grouped[type_codes[i]].push_back(Q);
+        }
+        std::unordered_map<std::string, std::vector<float4>> type_Q_map;
+        for (size_t j = 0; j < type_names.size(); j++) {
+            type_Q_map[type_names[j]] = std::move(grouped[j]);
+        }
+        return type_Q_map;
+    }
+
+    /// Read all contact pairs (geometry ID) from a binary contact file
+    static std::vector<std::pair<bodyID_t, bodyID_t>> ReadContactPairsFromBinary(
+        const std::string& infilename,
+        const std::string& cntType = OUTPUT_FILE_SPH_SPH_CONTACT_NAME,
+        const std::string& cntColName = OUTPUT_FILE_CNT_TYPE_NAME,
+        const std::string& first_name = OUTPUT_FILE_GEO_ID_1_NAME,
+        const std::string& second_name = OUTPUT_FILE_GEO_ID_2_NAME) {
+        ColumnarBinaryReader in(infilename);
+        const auto& type_names = in.GetStringDictionary(cntColName);
+        std::vector<uint32_t> type_codes = in.GetStringCodes(cntColName);
+        std::vector<bodyID_t> A = in.Get<bodyID_t>(first_name);
+        std::vector<bodyID_t> B = in.Get<bodyID_t>(second_name);
+        std::vector<std::pair<bodyID_t, bodyID_t>> pairs;
+        auto it = std::find(type_names.begin(), type_names.end(), cntType);
+        if (it == type_names.end()) {
+            return pairs;
+        }
+        const uint32_t wanted_code = (uint32_t)(it - type_names.begin());
+        for (size_t i = 0; i < in.NumRows(); i++) {
+            if (type_codes[i] == wanted_code) {  // only the type of contact we care
+                pairs.push_back(std::pair<bodyID_t, bodyID_t>(A[i], B[i]));
+            }
+        }
+        return pairs;
+    }
+
     /// Intialize the simulation system.
     void Initialize(bool dry_run = false);
 
@@ -1257,15 +1633,23 @@ class DEMSolver {
     void DoDynamics(double thisCallDuration);
 
     /// Equivalent to calling DoDynamics with the time step size as the argument.
-    void DoStepDynamics() { DoDynamics(m_ts_size); }
+    void DoStepDynamics() { DoDynamics(GetTimeStepSize()); }
 
     /// @brief Transferthe cached sim params to the workers. Used for sim environment modification after system
     /// initialization.
     void UpdateSimParams();
 
     /// @brief TTransfer newly loaded clumps to the GPU-side in mid-simulation.
+    /// @details Only the new entities are uploaded; what is already in the simulation stays on device. When the arrays
+    /// are outgrown, they grow by DEME_ENTITY_ARRAY_GROWTH_FACTOR, so adding a few clumps at a time seldom reallocates.
     void UpdateClumps();
 
+    /// @brief Make room for the simulation to hold this many owners, spheres and triangles in total, so that
+    /// UpdateClumps calls staying within it never reallocate. Useful when clumps are fed in periodically (inflow).
+    /// @details Can be called before or after Initialize (after it, the solver must be synced). PurgeFamily gives the
+    /// room back.
+    void ReserveEntityCapacity(size_t n_owners, size_t n_spheres, size_t n_triangles = 0);
+
     /// @brief Update the time step size. Used after system initialization.
     /// @param ts Time step size.
     void UpdateStepSize(double ts);
@@ -1274,6 +1658,20 @@ class DEMSolver {
     /// dT should be allowed to be in advance of kT.
     void ShowThreadCollaborationStats();
 
+    /// @brief Start (or stop) recording a timeline of what the main thread, kT and dT are doing.
+    /// @details Each contact detection, buffer exchange, force calculation, integration and wait-for-the-other-thread
+    /// section becomes one event, stamped with the dT step it belongs to. Use it to see where kT and dT double-wait
+    /// when tuning SetCDUpdateFreq, SetCDMaxUpdateFreq and SetAdaptiveUpdateFreqStrategy. Recording is cheap, but call
+    /// this only when the solver is synced, not while DoDynamics (without sync) is in flight.
+    /// @param on Whether to record.
+    /// @param max_events_per_thread Events are pre-allocated per thread; beyond this many, new events are dropped.
+    void EnableTimelineTrace(bool on = true, size_t max_events_per_thread = 1 << 20);
+    /// @brief Write the recorded timeline as a Chrome trace JSON file (open it in chrome://tracing or Perfetto). Call
+    /// it when the solver is synced.
+    void WriteTimelineTrace(const std::string& filename);
+    /// Discard all recorded timeline events. Call it when the solver is synced.
+    void ClearTimelineTrace();
+
     /// Show the wall time and percentages of wall time spend on various solver tasks.
     void ShowTimingStats();
 
@@ -1288,8 +1686,16 @@ class DEMSolver {
     /// Reset the recordings of the wall time and percentages of wall time spend on various solver tasks.
     void ClearTimingStats();
 
-    /// Removes all entities associated with a family from the arrays (to save memory space).
-    void PurgeFamily(unsigned int family_num);
+    /// @brief Remove all clumps and meshes in a family from the simulation, releasing their memory. Meant for long runs
+    /// where phased-out entities are parked in a sink family; call it now and then (not every step), as it works on
+    /// host. The system must be initialized and synced (see DoDynamicsThenSync), and the family must have no analytical
+    /// objects.
+    /// @details The remaining owners, spheres and triangles get consecutive IDs, keeping their relative order. Trackers
+    /// and force probes are updated; a tracker whose entities are all gone is marked broken and tracks nothing. So are
+    /// state snapshots, except that one losing any of its owners can no longer be taken. Owner IDs kept elsewhere need
+    /// the returned map.
+    /// @return Map from each owner ID before the purge to the one after (NULL_BODYID if removed).
+    std::vector<bodyID_t> PurgeFamily(unsigned int family_num);
 
     /// Release the memory for the flattened arrays (which are used for initialization pre-processing and transferring
     /// info the worker threads).
@@ -1333,22 +1739,26 @@ class DEMSolver {
     /// Recommend "INFO".
     void SetVerbosity(const std::string& verbose);
     /// @brief Choose sphere and clump output file format.
-    /// @param format Choice among "CSV", "BINARY".
+    /// @param format Choice among "CSV", "BINARY", "VTP". VTP files are VTK XML point clouds with binary arrays.
     void SetOutputFormat(const std::string& format);
     /// @brief Specify the information that needs to go into the clump or sphere output files.
     /// @param content A list of "XYZ", "QUAT", "ABSV", "VEL", "ANG_VEL", "ABS_ACC", "ACC", "ANG_ACC", "FAMILY", "MAT",
     /// "OWNER_WILDCARD" and/or "GEO_WILDCARD".
     void SetOutputContent(const std::vector<std::string>& content);
     /// @brief Specify the file format of contact pairs.
-    /// @param format Choice among "CSV", "BINARY".
+    /// @param format Choice among "CSV", "BINARY", "VTP". VTP files place contacts at their contact points, so they
+    /// need CNT_POINT in the contact output content.
     void SetContactOutputFormat(const std::string& format);
     /// @brief Specify the information that needs to go into the contact pair output files.
     /// @param content A list of "CNT_TYPE", "FORCE", "POINT", "COMPONENT", "NORMAL", "TORQUE", "CNT_WILDCARD", "OWNER",
     /// "GEO_ID" and/or "NICKNAME".
     void SetContactOutputContent(const std::vector<std::string>& content);
     /// @brief Specify the output file format of meshes.
-    /// @param format A choice between "VTK", "OBJ".
+    /// @param format A choice among "VTK", "OBJ", "VTU". VTU (VTK XML with binary arrays) is much faster to write and
+    /// smaller than the ASCII VTK format.
     void SetMeshOutputFormat(const std::string& format);
+    /// @brief Enable/disable zlib compression of the arrays in VTP and VTU output files (needs zlib at build time).
+    void EnableVTKCompression(bool enable = true);
 
     // void SetOutputContent(const std::string& content) { SetOutputContent({content}); }
     // void SetContactOutputContent(const std::string& content) { SetContactOutputContent({content}); }
@@ -1367,12 +1777,12 @@ class DEMSolver {
     void PrintKinematicScratchSpaceUsage() const { kT->printScratchSpaceUsage(); }
 
     /// Let dT do this call and return the reduce value of the inspected quantity.
-    float dTInspectReduce(const std::shared_ptr<jitify::Program>& inspection_kernel,
+    float dTInspectReduce(const std::shared_ptr<JitProgram>& inspection_kernel,
                           const std::string& kernel_name,
                           INSPECT_ENTITY_TYPE thing_to_insp,
                           CUB_REDUCE_FLAVOR reduce_flavor,
                           bool all_domain);
-    float* dTInspectNoReduce(const std::shared_ptr<jitify::Program>& inspection_kernel,
+    float* dTInspectNoReduce(const std::shared_ptr<JitProgram>& inspection_kernel,
                              const std::string& kernel_name,
                              INSPECT_ENTITY_TYPE thing_to_insp,
                              CUB_REDUCE_FLAVOR reduce_flavor,
@@ -1387,6 +1797,15 @@ class DEMSolver {
     VERBOSITY verbosity = INFO;
     // If true, dT should sort contact arrays (based on contact type) before usage
     bool should_sort_contacts = true;
+    // If true, mesh triangles are spatially reordered at initialization
+    bool sort_mesh_triangles = false;
+    // Clumps are spatially reordered every this many steps (if positive), and the step it last happened
+    int m_owner_reorder_freq = 0;
+    size_t m_last_owner_reorder_step = 0;
+    // Number of owners, spheres and triangles the entity arrays have room for
+    size_t m_owner_capacity = 0;
+    size_t m_sphere_capacity = 0;
+    size_t m_tri_capacity = 0;
     // If true, the solvers may need to do a per-step sweep to apply family number changes
     bool famnum_can_change_conditionally = false;
 
@@ -1402,6 +1821,13 @@ class DEMSolver {
     bool use_user_defined_expand_factor = false;
     // Whether to auto-adjust the bin size and the max update frequency
     bool auto_adjust_bin_size = true;
+    // How the bin size is adjusted
+    BIN_TUNER_TYPE m_bin_tuner_type = BIN_TUNER_TYPE::COST_MODEL;
+    // How the max future drift is adjusted, and the parameters of the predictive strategy
+    DRIFT_CTRL_TYPE m_drift_ctrl_type = DRIFT_CTRL_TYPE::STEP_COUNT;
+    float m_drift_jitter_factor = 1.5;
+    float m_drift_margin_budget = 0.5;
+    float m_drift_smoothing = 0.2;
     bool auto_adjust_update_freq = true;
     // User-instructed initial bin size as a multiple of smallest sphere radius
     float m_binSize_as_multiple = 8.0;
@@ -1523,6 +1949,9 @@ class DEMSolver {
     // If we should flatten then reduce forces (true), or use atomic operation to reduce forces (false)
     bool use_cub_to_reduce_force = false;
 
+    // If kT should do contact detection on host rather than device
+    bool use_host_contact_detection = false;
+
     // If the solver sees there are more spheres in a bin than a this `maximum', it errors out
     unsigned int threshold_too_many_spheres_in_bin = 32768;
     // If the solver sees there are more triangles in a bin than a this `maximum', it errors out
@@ -1558,6 +1987,8 @@ class DEMSolver {
 
     // Strategy for auto-adapting time steps size
     ADAPT_TS_TYPE adapt_ts_type = ADAPT_TS_TYPE::NONE;
+    // Parameters of the adaptive time stepper (step size bounds of 0 mean to derive them from the initial step size)
+    AdaptiveTSParams m_adapt_ts_params;
 
     ////////////////////////////////////////////////////////////////////////////////
     // No user method is provided to modify the following key quantities, even if
@@ -1578,6 +2009,18 @@ class DEMSolver {
 
     // Cached inspectors that can be used to query the simulation system
     std::vector<std::shared_ptr<DEMInspector>> m_inspectors;
+    // Force probes created by the user, so they can be updated all together
+    std::vector<std::shared_ptr<DEMForceProbe>> m_force_probes;
+    // State snapshots handed out to the user, so PurgeFamily can remap their owners. The user owns them.
+    std::vector<std::weak_ptr<StateSnapshot>> m_state_snapshots;
+
+    // Host-side spatial index over clump CoMs, serving region queries. It is tagged with the step count, sim time and
+    // owner count at build time, and rebuilt when any of them moved on (or when owners are moved by hand).
+    OwnerSpatialIndex m_clump_index;
+    bool m_clump_index_valid = false;
+    uint64_t m_clump_index_step = 0;
+    double m_clump_index_time = 0.;
+    size_t m_clump_index_nOwners = 0;
 
     // Total number of spheres
     size_t nSpheresGM = 0;
@@ -1694,6 +2137,8 @@ class DEMSolver {
 
     // Shared pointers to meshed objects cached at the API system
     std::vector<std::shared_ptr<DEMMeshConnected>> cached_mesh_objs;
+    // Where loaded mesh files are cached; empty means no caching
+    std::string m_mesh_cache_dir;
 
     // User-input prescribed motion
     std::vector<familyPrescription_t> m_input_family_prescription;
@@ -1844,6 +2289,8 @@ class DEMSolver {
     void decideBinSize();
     /// The method of deciding the thickness of contact margin (user-specified max vel; or a custom inspector)
     void decideCDMarginStrat();
+    /// Derive the adaptive time stepper's static step size bounds from clump templates and materials
+    void decideAdaptiveTSParams();
     /// Add boundaries to the simulation `world' based on user instructions
     void addWorldBoundingBox();
     /// Transfer cached solver preferences/instructions to dT and kT.
@@ -1855,12 +2302,18 @@ class DEMSolver {
     void initializeGPUArrays();
     /// Allocate memory space for GPU-side arrays.
     void allocateGPUArrays();
+    /// Make room in the entity arrays for the current numbers of entities (and what the user reserved). If grow, arrays
+    /// that are outgrown get DEME_ENTITY_ARRAY_GROWTH_FACTOR times the room they had.
+    void reserveEntityArrays(bool grow);
     /// Pack array pointers to a struct so they can be easily used as kernel arguments.
     void packDataPointers();
     /// @brief Move host-prepared simulation parameter data to device.
     void migrateSimParamsToDevice();
     /// @brief Move host-prepared array data to device.
     void migrateArrayDataToDevice();
+    /// @brief Move only the entities added after the given numbers of existing owners, spheres, triangles and contacts
+    /// to device.
+    void migrateNewEntitiesToDevice(size_t nOwners, size_t nSpheres, size_t nFacets, size_t nContacts);
     /// @brief Move device-modified array data to host. This is important when the simulation already started, but some
     /// data need to be re-cooked on host. For small updates to the host, we don't need to do this, just directly modify
     /// the device array.
@@ -1909,6 +2362,8 @@ class DEMSolver {
     void assertSysInit(const std::string& method_name);
     /// Assert that the DEM simulation system is not initialized
     void assertSysNotInit(const std::string& method_name);
+    /// Check that a state snapshot can be taken: its owners all still exist
+    void assertStateSnapshotValid(const std::shared_ptr<StateSnapshot>& snapshot, const std::string& method_name);
     /// Print due information on worker threads reported anomalies
     bool goThroughWorkerAnomalies();
     /// @brief Implementation of getting (unsorted) contact pairs from dT.
@@ -1919,6 +2374,8 @@ class DEMSolver {
                           std::vector<family_t>& famA,
                           std::vector<family_t>& famB,
                           std::function<bool(contact_t)> type_func) const;
+    /// Get the clump CoM spatial index, rebuilding it if the simulation has moved on since it was last built
+    const OwnerSpatialIndex& getClumpSpatialIndex();
     /// The implimentation of persistency assignment
     void assignFamilyPersistentContact_impl(
         unsigned int N1,
@@ -1932,6 +2389,36 @@ class DEMSolver {
     void assignFamilyPersistentContact(unsigned int N1, unsigned int N2, notStupidBool_t is_or_not);
     void assignPersistentContact(notStupidBool_t is_or_not);
 
+    // Parse 3 float columns of a CSV file into float3s, in row order
+    static std::vector<float3> ZipFloat3Columns(const ParallelCsvReader& in,
+                                                const std::string& x_header,
+                                                const std::string& y_header,
+                                                const std::string& z_header) {
+        std::vector<float> X = in.Get<float>(x_header);
+        std::vector<float> Y = in.Get<float>(y_header);
+        std::vector<float> Z = in.Get<float>(z_header);
+        std::vector<float3> res(in.NumRows());
+        for (size_t i = 0; i < res.size(); i++) {
+            res[i] = make_float3(X[i], Y[i], Z[i]);
+        }
+        return res;
+    }
+    // Parse the quaternion columns of a clump CSV file, in row order
+    static std::vector<float4> ZipQuatColumns(const ParallelCsvReader& in) {
+        std::vector<float> Qw = in.Get<float>(OUTPUT_FILE_QW_COL_NAME);
+        std::vector<float> Qx = in.Get<float>(OUTPUT_FILE_QX_COL_NAME);
+        std::vector<float> Qy = in.Get<float>(OUTPUT_FILE_QY_COL_NAME);
+        std::vector<float> Qz = in.Get<float>(OUTPUT_FILE_QZ_COL_NAME);
+        std::vector<float4> res(in.NumRows());
+        for (size_t i = 0; i < res.size(); i++) {
+            res[i].x = Qx[i];
+            res[i].y = Qy[i];
+            res[i].z = Qz[i];
+            res[i].w = Qw[i];
+        }
+        return res;
+    }
+
     // Some JIT packaging helpers
     inline void equipClumpTemplates(std::unordered_map<std::string, std::string>& strMap);
     inline void equipSimParams(std::unordered_map<std::string, std::string>& strMap);
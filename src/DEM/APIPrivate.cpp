@@ -30,6 +30,21 @@ void DEMSolver::assertSysNotInit(const std::string& method_name) {
     }
 }
 
+void DEMSolver::assertStateSnapshotValid(const std::shared_ptr<StateSnapshot>& snapshot,
+                                         const std::string& method_name) {
+    assertSysInit(method_name);
+    if (snapshot->m_purged) {
+        DEME_ERROR(
+            "%s was given a state snapshot with owners removed by PurgeFamily. Please create a new snapshot with "
+            "NewStateSnapshot.",
+            method_name.c_str());
+    }
+    if (snapshot->Size() > 0 && snapshot->m_max_owner >= nOwnerBodies) {
+        DEME_ERROR("%s was given a state snapshot with owner ID %zu, but there are only %zu owners.",
+                   method_name.c_str(), (size_t)snapshot->m_max_owner, nOwnerBodies);
+    }
+}
+
 void DEMSolver::assignFamilyPersistentContact_impl(
     unsigned int N1,
     unsigned int N2,
@@ -129,6 +144,9 @@ void DEMSolver::generatePolicyResources() {
 
     // The method of deciding the thickness of contact margin
     decideCDMarginStrat();
+
+    // Step size bounds that the adaptive time stepper can know in advance
+    decideAdaptiveTSParams();
 }
 
 void DEMSolver::generateEntityResources() {
@@ -259,6 +277,15 @@ void DEMSolver::postResourceGenChecksAndTabKeeping() {
             nAnalGM);
     }
 
+    // Host CD does not know about triangles
+    if (use_host_contact_detection && nTriGM > 0) {
+        DEME_ERROR(
+            "UseHostContactDetection is set, but the simulation has %zu mesh triangle facets. Host contact detection "
+            "only handles spheres and analytical objects; call UseHostContactDetection(false) for simulations with "
+            "meshes.",
+            (size_t)nTriGM);
+    }
+
     // Keep tab of some quatities... It has to be done this late, because initialization may add analytical objects to
     // the system.
     nLastTimeClumpTemplateLoad = nClumpTemplateLoad;
@@ -360,6 +387,9 @@ void DEMSolver::getContacts_impl(std::vector<bodyID_t>& idA,
             cnt_type[useful_contacts] = this_type;
             famA[useful_contacts] = dT->familyID[idA[useful_contacts]];
             famB[useful_contacts] = dT->familyID[idB[useful_contacts]];
+            // Report the owner IDs the user knows
+            idA[useful_contacts] = dT->ownerUserID(idA[useful_contacts]);
+            idB[useful_contacts] = dT->ownerUserID(idB[useful_contacts]);
             useful_contacts++;
         }
     }
@@ -577,6 +607,71 @@ void DEMSolver::decideCDMarginStrat() {
     }
 }
 
+void DEMSolver::decideAdaptiveTSParams() {
+    AdaptiveTSParams& params = m_adapt_ts_params;
+    params.minRadius = 0.;
+    params.rayleighTime = 0.;
+    params.hertzCoeff = 0.;
+    if (adapt_ts_type == ADAPT_TS_TYPE::NONE) {
+        return;
+    }
+
+    // A contact is the stiffest when the other side is the stiffest material, the one with the smallest (1 - nu^2) / E
+    auto get_nu = [](const std::shared_ptr<DEMMaterial>& mat) {
+        return mat->mat_prop.count("nu") ? (double)mat->mat_prop.at("nu") : 0.3;
+    };
+    double min_compliance = DEME_HUGE_FLOAT;
+    for (const auto& mat : m_loaded_materials) {
+        if (mat->mat_prop.count("E") && mat->mat_prop.at("E") > 0.) {
+            const double nu = get_nu(mat);
+            min_compliance = std::min(min_compliance, (1. - nu * nu) / mat->mat_prop.at("E"));
+        }
+    }
+
+    double min_radius = DEME_HUGE_FLOAT, min_rayleigh = DEME_HUGE_FLOAT, min_hertz = DEME_HUGE_FLOAT;
+    for (const auto& clump : m_templates) {
+        double volume = clump->volume;
+        if (volume <= 0.) {
+            volume = 0.;
+            for (const auto& r : clump->radii) {
+                volume += 4. / 3. * PI * r * r * r;
+            }
+        }
+        for (unsigned int i = 0; i < clump->radii.size(); i++) {
+            const double r = clump->radii.at(i);
+            min_radius = std::min(min_radius, r);
+            if (clump->materials.size() <= i || !clump->materials.at(i)->mat_prop.count("E") || volume <= 0.) {
+                continue;
+            }
+            const auto& mat = clump->materials.at(i);
+            const double E = mat->mat_prop.at("E");
+            const double nu = get_nu(mat);
+            if (E <= 0.) {
+                continue;
+            }
+            // Rayleigh wave time, pi * r * sqrt(rho / G) / (0.1631 nu + 0.8766)
+            const double G = E / (2. * (1. + nu));
+            const double rho = clump->mass / volume;
+            min_rayleigh = std::min(min_rayleigh, PI * r * std::sqrt(rho / G) / (0.1631 * nu + 0.8766));
+            // Hertzian contact duration between two of this clump, 2.87 * (m*^2 / (R* E*^2 v))^(1/5), v excluded
+            const double E_star = 1. / ((1. - nu * nu) / E + min_compliance);
+            const double m_star = clump->mass / 2.;
+            const double R_star = r / 2.;
+            min_hertz = std::min(min_hertz, 2.87 * std::pow(m_star * m_star / (R_star * E_star * E_star), 0.2));
+        }
+    }
+    params.minRadius = (min_radius < DEME_HUGE_FLOAT) ? min_radius : 0.;
+    params.rayleighTime = (min_rayleigh < DEME_HUGE_FLOAT) ? min_rayleigh : 0.;
+    params.hertzCoeff = (min_hertz < DEME_HUGE_FLOAT) ? min_hertz : 0.;
+    if (params.rayleighTime <= 0. || params.hertzCoeff <= 0.) {
+        DEME_WARNING(
+            "Adaptive time stepping is on, but clump materials do not have a Young's modulus (E). The time step size "
+            "will not be bounded by material stiffness.");
+    }
+    DEME_DEBUG_PRINTF("Adaptive time stepping: smallest radius %.7g, Rayleigh time %.7g, Hertzian coefficient %.7g",
+                      params.minRadius, params.rayleighTime, params.hertzCoeff);
+}
+
 void DEMSolver::reportInitStats() const {
     DEME_INFO("\n");
     DEME_INFO("Number of total active devices: %d", dTkT_GpuManager->getNumDevices());
@@ -760,6 +855,10 @@ void DEMSolver::preprocessTriangleObjs() {
                 "A meshed object is loaded but does not have associated material.\nPlease assign material to meshes "
                 "via SetMaterial.");
         }
+        // Triangles are reordered before anything per-triangle is taken from the mesh
+        if (sort_mesh_triangles) {
+            mesh_obj->SortTrianglesSpatially();
+        }
         // Put the mesh into the host-side cache
         m_meshes.push_back(mesh_obj);
         // Note that cache_offset needs to be modified by dT in init. This info is important if we need to modify the
@@ -1041,7 +1140,24 @@ void DEMSolver::setSolverParams() {
     dT->solverFlags.isHistoryless = (m_force_model->m_contact_wildcards.size() == 0);
 
     // Time step constant-ness and expand factor constant-ness
-    dT->solverFlags.isStepConst = ts_size_is_const;
+    dT->solverFlags.isStepConst = ts_size_is_const && (adapt_ts_type == ADAPT_TS_TYPE::NONE);
+    switch (adapt_ts_type) {
+        case (ADAPT_TS_TYPE::MAX_VEL):
+            dT->solverFlags.stepSizeStrat = VAR_TS_STRAT::MAX_VEL;
+            break;
+        case (ADAPT_TS_TYPE::INT_DIFF):
+            dT->solverFlags.stepSizeStrat = VAR_TS_STRAT::INT_GAP;
+            break;
+        default:
+            dT->solverFlags.stepSizeStrat = VAR_TS_STRAT::DEME_CONST;
+    }
+    dT->adaptTSParams = m_adapt_ts_params;
+    if (dT->adaptTSParams.tsMin <= 0.) {
+        dT->adaptTSParams.tsMin = m_ts_size / 100.;
+    }
+    if (dT->adaptTSParams.tsMax <= 0.) {
+        dT->adaptTSParams.tsMax = m_ts_size * 5.;
+    }
     kT->solverFlags.isExpandFactorFixed = use_user_defined_expand_factor;
 
     // Jitify or not
@@ -1077,6 +1193,10 @@ void DEMSolver::setSolverParams() {
     dT->solverFlags.useNoContactRecord = no_recording_contact_forces;
     dT->solverFlags.useForceCollectInPlace = collect_force_in_force_kernel;
 
+    // Where kT does its contact detection
+    kT->solverFlags.useHostCD = use_host_contact_detection;
+    dT->solverFlags.useHostCD = use_host_contact_detection;
+
     // Whether sorts contact before using them (not implemented)
     kT->solverFlags.should_sort_pairs = should_sort_contacts;
     dT->solverFlags.should_sort_pairs = should_sort_contacts;
@@ -1098,6 +1218,7 @@ void DEMSolver::setSolverParams() {
         kT->stateParams.binChangeObserveSteps = auto_adjust_observe_steps;
         kT->stateParams.binTopChangeRate = auto_adjust_max_rate;
         kT->stateParams.binChangeRateAcc = auto_adjust_acc;
+        kT->binSizeTuner = CreateBinSizeTuner(m_bin_tuner_type, auto_adjust_max_rate, auto_adjust_acc);
         // Suppose for avoiding bins too big, the most proactive thing you can do is starting to shrink it when half max
         // geo count is reached...
         double base_val = 0.01;
@@ -1111,9 +1232,17 @@ void DEMSolver::setSolverParams() {
     kT->solverFlags.autoUpdateFreq = auto_adjust_update_freq;
     dT->solverFlags.autoUpdateFreq = auto_adjust_update_freq;
     dT->solverFlags.upperBoundFutureDrift = upper_bound_future_drift;
-    dT->solverFlags.targetDriftMoreThanAvg = max_drift_ahead_of_avg_drift;
-    dT->solverFlags.targetDriftMultipleOfAvg = max_drift_multiple_of_avg_drift;
-    dT->accumStepUpdater.SetCacheSize(max_drift_gauge_history_size);
+    if (m_drift_ctrl_type == DRIFT_CTRL_TYPE::PREDICTIVE) {
+        auto ctrl = std::make_unique<PredictiveDriftController>();
+        ctrl->SetJitterFactor(m_drift_jitter_factor);
+        ctrl->SetMarginBudget(m_drift_margin_budget);
+        ctrl->SetSmoothing(m_drift_smoothing);
+        dT->driftController = std::move(ctrl);
+    } else {
+        dT->driftController = std::make_unique<StepCountDriftController>(
+            max_drift_multiple_of_avg_drift, max_drift_ahead_of_avg_drift, max_drift_gauge_history_size);
+    }
+    dT->driftMarginRefSize = (m_smallest_radius < DEME_HUGE_FLOAT) ? m_smallest_radius : 0.f;
 }
 
 void DEMSolver::setSimParams() {
@@ -1182,6 +1311,19 @@ void DEMSolver::allocateGPUArrays() {
     kThread.join();
 }
 
+void DEMSolver::reserveEntityArrays(bool grow) {
+    auto makeRoom = [grow](size_t& capacity, size_t n) {
+        if (n > capacity) {
+            capacity = grow ? DEME_MAX(n, (size_t)(capacity * DEME_ENTITY_ARRAY_GROWTH_FACTOR)) : n;
+        }
+    };
+    makeRoom(m_owner_capacity, nOwnerBodies);
+    makeRoom(m_sphere_capacity, nSpheresGM);
+    makeRoom(m_tri_capacity, nTriGM);
+    dT->reserveEntityArrays(m_owner_capacity, m_sphere_capacity, m_tri_capacity);
+    kT->reserveEntityArrays(m_owner_capacity, m_sphere_capacity, m_tri_capacity);
+}
+
 void DEMSolver::initializeGPUArrays() {
     // Pack clump templates together... that's easier to pass to dT kT
     ClumpTemplateFlatten flattened_clump_templates(m_template_clump_mass, m_template_clump_moi, m_template_sp_mat_ids,
@@ -1222,6 +1364,15 @@ void DEMSolver::initializeGPUArrays() {
         m_family_mask_matrix,
         // Templates and misc.
         flattened_clump_templates);
+
+    // Analytical entities are jitified, but kT still keeps a copy for the host-side contact detection. Same as in
+    // jitification, their owners follow template-loaded clumps.
+    std::vector<bodyID_t> anal_owner(nAnalGM);
+    for (unsigned int i = 0; i < nAnalGM; i++) {
+        anal_owner[i] = nOwnerClumps + m_anal_owner.at(i);
+    }
+    kT->populateAnalEntityArrays(anal_owner, m_anal_types, m_anal_normals, m_anal_comp_pos, m_anal_comp_rot,
+                                 m_anal_size_1, m_anal_size_2, m_anal_size_3);
 }
 
 /// When more clumps/meshed objects got loaded, this method should be called to transfer them to the GPU-side in
@@ -1301,6 +1452,14 @@ void DEMSolver::migrateArrayDataToDevice() {
     kT->migrateDataToDevice();
 }
 
+void DEMSolver::migrateNewEntitiesToDevice(size_t nOwners, size_t nSpheres, size_t nFacets, size_t nContacts) {
+    // Array pointers may have changed in the resizing
+    dT->granData.toDevice();
+    kT->granData.toDevice();
+    dT->migrateNewEntitiesToDevice(nOwners, nSpheres, nFacets, nContacts);
+    kT->migrateNewEntitiesToDevice(nOwners, nSpheres, nFacets);
+}
+
 void DEMSolver::migrateArrayDataToHost() {
     dT->migrateDeviceModifiableInfoToHost();
     kT->migrateDeviceModifiableInfoToHost();
@@ -1349,6 +1508,51 @@ void DEMSolver::validateUserInputs() {
     SetFamilyFixed(RESERVED_FAMILY_NUM);
 }
 
+const OwnerSpatialIndex& DEMSolver::getClumpSpatialIndex() {
+    const double sim_time = dT->getSimTime();
+    if (m_clump_index_valid && m_clump_index_step == dT->nTotalSteps && m_clump_index_time == sim_time &&
+        m_clump_index_nOwners == nOwnerBodies) {
+        return m_clump_index;
+    }
+
+    dT->voxelID.toHost();
+    dT->locX.toHost();
+    dT->locY.toHost();
+    dT->locZ.toHost();
+    // ownerTypes has no way to change on device
+    std::vector<bodyID_t> ids;
+    ids.reserve(nOwnerClumps);
+    for (bodyID_t ownerID = 0; ownerID < nOwnerBodies; ownerID++) {
+        if (dT->ownerTypes[ownerID] == OWNER_T_CLUMP)
+            ids.push_back(ownerID);
+    }
+    std::vector<float3> pos(ids.size());
+    const auto& simParams = dT->simParams;
+#ifdef DEME_USE_OPENMP
+    #pragma omp parallel for schedule(static)
+#endif
+    for (long long i = 0; i < (long long)ids.size(); i++) {
+        const bodyID_t ownerID = ids[i];
+        float3 CoM;
+        voxelIDToPosition<float, voxelID_t, subVoxelPos_t>(CoM.x, CoM.y, CoM.z, dT->voxelID[ownerID],
+                                                           dT->locX[ownerID], dT->locY[ownerID], dT->locZ[ownerID],
+                                                           simParams->nvXp2, simParams->nvYp2, simParams->voxelSize,
+                                                           simParams->l);
+        pos[i] = make_float3(CoM.x + simParams->LBFX, CoM.y + simParams->LBFY, CoM.z + simParams->LBFZ);
+    }
+    // Region queries answer with the owner IDs the user knows
+    for (auto& id : ids) {
+        id = dT->ownerUserID(id);
+    }
+    m_clump_index.Build(std::move(pos), std::move(ids));
+
+    m_clump_index_valid = true;
+    m_clump_index_step = dT->nTotalSteps;
+    m_clump_index_time = sim_time;
+    m_clump_index_nOwners = nOwnerBodies;
+    return m_clump_index;
+}
+
 bool DEMSolver::goThroughWorkerAnomalies() {
     bool there_is = false;
     if (kT->anomalies.over_max_vel || dT->anomalies.over_max_vel) {
@@ -8,6 +8,7 @@
 #include <DEM/Defines.h>
 #include <DEM/HostSideHelpers.hpp>
 #include <DEM/AuxClasses.h>
+#include <core/utils/VtkXmlWriter.hpp>
 
 #include <iostream>
 #include <fstream>
@@ -100,6 +101,9 @@ void DEMSolver::SetOutputFormat(const std::string& format) {
         case ("BINARY"_):
             m_out_format = OUTPUT_FORMAT::BINARY;
             break;
+        case ("VTP"_):
+            m_out_format = OUTPUT_FORMAT::VTP;
+            break;
         case ("CHPF"_):
 #ifdef DEME_USE_CHPF
             m_out_format = OUTPUT_FORMAT::CHPF;
@@ -120,6 +124,9 @@ void DEMSolver::SetContactOutputFormat(const std::string& format) {
         case ("BINARY"_):
             m_cnt_out_format = OUTPUT_FORMAT::BINARY;
             break;
+        case ("VTP"_):
+            m_cnt_out_format = OUTPUT_FORMAT::VTP;
+            break;
         case ("CHPF"_):
 #ifdef DEME_USE_CHPF
             m_cnt_out_format = OUTPUT_FORMAT::CHPF;
@@ -140,10 +147,19 @@ void DEMSolver::SetMeshOutputFormat(const std::string& format) {
         case ("OBJ"_):
             m_mesh_out_format = MESH_FORMAT::OBJ;
             break;
+        case ("VTU"_):
+            m_mesh_out_format = MESH_FORMAT::VTU;
+            break;
         default:
             DEME_ERROR("Instruction %s is unknown in SetMeshOutputFormat call.", format.c_str());
     }
 }
+void DEMSolver::EnableVTKCompression(bool enable) {
+    if (enable && !VtkXmlWriter::CompressionAvailable()) {
+        DEME_ERROR("VTK output compression needs zlib, which was not found when the code was compiled.");
+    }
+    dT->compressVtk = enable;
+}
 
 void DEMSolver::SetOutputContent(const std::vector<std::string>& content) {
     std::vector<std::string> u_content(content.size());
@@ -243,7 +259,9 @@ void DEMSolver::SyncMemoryTransfer() {
     kT->syncMemoryTransfer();
 }
 
-std::vector<bodyID_t> DEMSolver::GetOwnerContactClumps(bodyID_t ownerID) const {
+std::vector<bodyID_t> DEMSolver::GetOwnerContactClumps(bodyID_t userOwnerID) const {
+    // Work with where this owner currently is in the arrays
+    const bodyID_t ownerID = dT->ownerImplID(userOwnerID);
     // Is this owner a clump?
     ownerType_t this_type = dT->ownerTypes[ownerID];  // ownerTypes has no way to change on device
     std::vector<bodyID_t> geo_to_watch;               // geo IDs that need to scan
@@ -314,6 +332,9 @@ std::vector<bodyID_t> DEMSolver::GetOwnerContactClumps(bodyID_t ownerID) const {
             }
         }
     }
+    for (auto& clump : clumps_in_cnt) {
+        clump = dT->ownerUserID(clump);
+    }
     return clumps_in_cnt;
 }
 
@@ -457,6 +478,24 @@ std::shared_ptr<ContactInfoContainer> DEMSolver::GetContactDetailedInfo(float fo
     return dT->generateContactInfo(force_thres);
 }
 
+std::shared_ptr<const CompactContactInfo> DEMSolver::GetContactDetailedInfoCompact(float force_thres) const {
+    return dT->generateCompactContactInfo(force_thres);
+}
+
+std::vector<ContactNetworkStats> DEMSolver::AnalyzeContactNetwork(const ContactNetworkAnalyzer& analyzer,
+                                                                  float force_thres) const {
+    std::shared_ptr<const CompactContactInfo> contacts = GetContactDetailedInfoCompact(force_thres);
+    ContactNetworkOwners owners;
+    owners.pos = GetOwnerPosition(0, nOwnerBodies);
+    owners.family = GetOwnerFamily(0, nOwnerBodies);
+    owners.is_particle.resize(nOwnerBodies);
+    for (bodyID_t i = 0; i < nOwnerBodies; i++) {
+        // ownerTypes has no way to change on device
+        owners.is_particle[i] = (dT->ownerTypes[dT->ownerImplID(i)] == OWNER_T_CLUMP);
+    }
+    return analyzer.Analyze(*contacts, owners);
+}
+
 std::vector<float3> DEMSolver::GetOwnerPosition(bodyID_t ownerID, bodyID_t n) const {
     return dT->getOwnerPos(ownerID, n);
 }
@@ -568,15 +607,63 @@ size_t DEMSolver::GetOwnerContactForces(const std::vector<bodyID_t>& ownerIDs,
     return dT->getOwnerContactForces(ownerIDs, points, forces, torques, torque_in_local);
 }
 
+std::shared_ptr<StateSnapshot> DEMSolver::NewStateSnapshot(const std::vector<bodyID_t>& ownerIDs,
+                                                           unsigned int content) {
+    if (!sys_initialized) {
+        DEME_ERROR("NewStateSnapshot can only be called after the system is initialized.");
+    }
+    for (const auto& owner : ownerIDs) {
+        if (owner >= nOwnerBodies) {
+            DEME_ERROR("NewStateSnapshot got owner ID %zu, but there are only %zu owners.", (size_t)owner,
+                       nOwnerBodies);
+        }
+    }
+    auto snapshot = std::make_shared<StateSnapshot>(ownerIDs, content);
+    // Drop the ones the user let go of, while we are here
+    m_state_snapshots.erase(std::remove_if(m_state_snapshots.begin(), m_state_snapshots.end(),
+                                           [](const std::weak_ptr<StateSnapshot>& s) { return s.expired(); }),
+                            m_state_snapshots.end());
+    m_state_snapshots.push_back(snapshot);
+    return snapshot;
+}
+
+std::shared_ptr<StateSnapshot> DEMSolver::NewStateSnapshot(const std::vector<std::shared_ptr<DEMTracker>>& trackers,
+                                                           unsigned int content) {
+    std::vector<bodyID_t> ownerIDs;
+    std::vector<size_t> starts;
+    for (const auto& tracker : trackers) {
+        starts.push_back(ownerIDs.size());
+        for (size_t i = 0; i < tracker->obj->nSpanOwners; i++)
+            ownerIDs.push_back(tracker->obj->ownerID + i);
+    }
+    auto snapshot = NewStateSnapshot(ownerIDs, content);
+    snapshot->m_tracker_starts = std::move(starts);
+    return snapshot;
+}
+
+void DEMSolver::TakeStateSnapshot(const std::shared_ptr<StateSnapshot>& snapshot) {
+    assertStateSnapshotValid(snapshot, "TakeStateSnapshot");
+    snapshot->m_time = dT->getSimTime();
+    dT->gatherStateSnapshot(*(snapshot->m_buf), snapshot->m_content, snapshot->m_record_len, false);
+    snapshot->m_taken = true;
+}
+
+void DEMSolver::TakeStateSnapshotAsync(const std::shared_ptr<StateSnapshot>& snapshot) {
+    assertStateSnapshotValid(snapshot, "TakeStateSnapshotAsync");
+    snapshot->m_time = dT->getSimTime();
+    dT->gatherStateSnapshot(*(snapshot->m_buf), snapshot->m_content, snapshot->m_record_len, true);
+    snapshot->m_taken = true;
+}
+
 std::vector<float> DEMSolver::GetOwnerMass(bodyID_t ownerID, bodyID_t n) const {
     std::vector<float> res(n);
     for (bodyID_t i = 0; i < n; i++) {
         // No mechanism to change mass properties on device, so [] operator is fine
         if (jitify_mass_moi) {
-            inertiaOffset_t offset = dT->inertiaPropOffsets[ownerID + i];
+            inertiaOffset_t offset = dT->inertiaPropOffsets[dT->ownerImplID(ownerID + i)];
             res[i] = dT->massOwnerBody[offset];
         } else {
-            res[i] = dT->massOwnerBody[ownerID + i];
+            res[i] = dT->massOwnerBody[dT->ownerImplID(ownerID + i)];
         }
     }
     return res;
@@ -587,15 +674,16 @@ std::vector<float3> DEMSolver::GetOwnerMOI(bodyID_t ownerID, bodyID_t n) const {
     for (bodyID_t i = 0; i < n; i++) {
         // No mechanism to change mass properties on device, so [] operator is fine
         if (jitify_mass_moi) {
-            inertiaOffset_t offset = dT->inertiaPropOffsets[ownerID + i];
+            inertiaOffset_t offset = dT->inertiaPropOffsets[dT->ownerImplID(ownerID + i)];
             float m1 = dT->mmiXX[offset];
             float m2 = dT->mmiYY[offset];
             float m3 = dT->mmiZZ[offset];
             res[i] = make_float3(m1, m2, m3);
         } else {
-            float m1 = dT->mmiXX[ownerID + i];
-            float m2 = dT->mmiYY[ownerID + i];
-            float m3 = dT->mmiZZ[ownerID + i];
+            const bodyID_t implID = dT->ownerImplID(ownerID + i);
+            float m1 = dT->mmiXX[implID];
+            float m2 = dT->mmiYY[implID];
+            float m3 = dT->mmiZZ[implID];
             res[i] = make_float3(m1, m2, m3);
         }
     }
@@ -610,6 +698,7 @@ void DEMSolver::AddOwnerNextStepAngAcc(bodyID_t ownerID, const std::vector<float
 }
 void DEMSolver::SetOwnerPosition(bodyID_t ownerID, const std::vector<float3>& pos) {
     dT->setOwnerPos(ownerID, pos);
+    m_clump_index_valid = false;
 }
 void DEMSolver::SetOwnerAngVel(bodyID_t ownerID, const std::vector<float3>& angVel) {
     dT->setOwnerAngVel(ownerID, angVel);
@@ -625,7 +714,16 @@ void DEMSolver::SetOwnerFamily(bodyID_t ownerID, unsigned int fam, bodyID_t n) {
         DEME_ERROR("You called SetOwnerFamily with family number %u, but family number should not be larger than %u.",
                    fam, std::numeric_limits<family_t>::max());
     }
-    kT->setOwnerFamily(ownerID, static_cast<family_t>(fam), n);
+    // kT keeps no ID maps, so it is told where these owners are now
+    if (dT->ownerIDsRemapped()) {
+        std::vector<bodyID_t> userIDs(n);
+        for (bodyID_t i = 0; i < n; i++) {
+            userIDs[i] = ownerID + i;
+        }
+        kT->setOwnerFamily(dT->ownerImplIDs(userIDs), static_cast<family_t>(fam));
+    } else {
+        kT->setOwnerFamily(ownerID, static_cast<family_t>(fam), n);
+    }
     dT->setOwnerFamily(ownerID, static_cast<family_t>(fam), n);
 }
 
@@ -724,8 +822,6 @@ void DEMSolver::SetIntegrator(const std::string& intg) {
 }
 
 void DEMSolver::SetAdaptiveTimeStepType(const std::string& type) {
-    DEME_WARNING(
-        "SetAdaptiveTimeStepType is currently not implemented and has no effect, time step size is still fixed.");
     switch (hash_charr(type.c_str())) {
         case ("none"_):
             adapt_ts_type = ADAPT_TS_TYPE::NONE;
@@ -742,6 +838,106 @@ void DEMSolver::SetAdaptiveTimeStepType(const std::string& type) {
     }
 }
 
+void DEMSolver::SetAdaptiveTimeStepBounds(double min_ts, double max_ts) {
+    if (min_ts <= 0. || max_ts < min_ts) {
+        DEME_ERROR("SetAdaptiveTimeStepBounds needs 0 < min_ts <= max_ts, but got %.7g and %.7g.", min_ts, max_ts);
+    }
+    m_adapt_ts_params.tsMin = min_ts;
+    m_adapt_ts_params.tsMax = max_ts;
+}
+
+void DEMSolver::SetAdaptiveTimeStepCFL(double cfl) {
+    if (cfl <= 0.) {
+        DEME_ERROR("SetAdaptiveTimeStepCFL needs a positive number, but got %.7g.", cfl);
+    }
+    m_adapt_ts_params.cfl = cfl;
+}
+
+void DEMSolver::SetAdaptiveTimeStepStiffnessFactors(double rayleigh_factor, double hertz_factor) {
+    // A factor of 0 drops that bound
+    m_adapt_ts_params.rayleighFactor = (rayleigh_factor > 0.) ? rayleigh_factor : DEME_HUGE_FLOAT;
+    m_adapt_ts_params.hertzFactor = (hertz_factor > 0.) ? hertz_factor : DEME_HUGE_FLOAT;
+}
+
+void DEMSolver::SetAdaptiveTimeStepGrowth(double max_growth) {
+    if (max_growth < 1.) {
+        DEME_ERROR("SetAdaptiveTimeStepGrowth needs a number no smaller than 1, but got %.7g.", max_growth);
+    }
+    m_adapt_ts_params.maxGrowth = max_growth;
+}
+
+void DEMSolver::SetAdaptiveTimeStepTolerance(double tol) {
+    if (tol <= 0.) {
+        DEME_ERROR("SetAdaptiveTimeStepTolerance needs a positive number, but got %.7g.", tol);
+    }
+    m_adapt_ts_params.errTol = tol;
+}
+
+double DEMSolver::GetTimeStepSize() const {
+    // With adaptive step size, dT knows the step size in use
+    if (sys_initialized && adapt_ts_type != ADAPT_TS_TYPE::NONE) {
+        return dT->simParams->h;
+    }
+    return m_ts_size;
+}
+
+std::vector<TimeStepRecord> DEMSolver::GetTimeStepHistory() const {
+    return std::vector<TimeStepRecord>(dT->tsHistory.begin(), dT->tsHistory.end());
+}
+
+void DEMSolver::ClearTimeStepHistory() {
+    dT->tsHistory.clear();
+}
+
+void DEMSolver::SetAdaptiveBinSizeStrategy(const std::string& type) {
+    std::string u_type = str_to_upper(type);
+    switch (hash_charr(u_type.c_str())) {
+        case ("COST_MODEL"_):
+            m_bin_tuner_type = BIN_TUNER_TYPE::COST_MODEL;
+            break;
+        case ("HEURISTIC"_):
+            m_bin_tuner_type = BIN_TUNER_TYPE::HEURISTIC;
+            break;
+        default:
+            DEME_ERROR(
+                "Adaptive bin size strategy %s is unknown. Please select another via SetAdaptiveBinSizeStrategy.",
+                type.c_str());
+    }
+}
+
+void DEMSolver::SetAdaptiveUpdateFreqStrategy(const std::string& type) {
+    std::string u_type = str_to_upper(type);
+    switch (hash_charr(u_type.c_str())) {
+        case ("STEP_COUNT"_):
+            m_drift_ctrl_type = DRIFT_CTRL_TYPE::STEP_COUNT;
+            break;
+        case ("PREDICTIVE"_):
+            m_drift_ctrl_type = DRIFT_CTRL_TYPE::PREDICTIVE;
+            break;
+        default:
+            DEME_ERROR(
+                "Adaptive update frequency strategy %s is unknown. Please select another via "
+                "SetAdaptiveUpdateFreqStrategy.",
+                type.c_str());
+    }
+}
+
+DriftControllerState DEMSolver::GetUpdateFreqControllerState() const {
+    return dT->driftController ? dT->driftController->GetState() : DriftControllerState();
+}
+
+void DEMSolver::SetCDStatsRecording(bool record) {
+    kT->recordCDStats = record;
+}
+
+std::vector<CDStatsRecord> DEMSolver::GetCDStatsRecord() const {
+    return kT->cdStatsRecord;
+}
+
+void DEMSolver::ClearCDStatsRecord() {
+    kT->cdStatsRecord.clear();
+}
+
 void DEMSolver::SetCDNumStepsMaxDriftHistorySize(unsigned int n) {
     if (n > NUM_STEPS_RESERVED_AFTER_RENEWING_FREQ_TUNER) {
         max_drift_gauge_history_size = n;
@@ -1886,7 +2082,8 @@ std::shared_ptr<DEMMeshConnected> DEMSolver::AddWavefrontMeshObject(const std::s
                                                                     bool load_normals,
                                                                     bool load_uv) {
     DEMMeshConnected mesh;
-    bool flag = mesh.LoadWavefrontMesh(filename, load_normals, load_uv);
+    mesh.SetCacheDir(m_mesh_cache_dir);
+    bool flag = mesh.LoadMesh(filename, load_normals, load_uv);
     if (!flag) {
         DEME_ERROR("Failed to load in mesh file %s.", filename.c_str());
     }
@@ -1898,7 +2095,8 @@ std::shared_ptr<DEMMeshConnected> DEMSolver::AddWavefrontMeshObject(const std::s
                                                                     bool load_normals,
                                                                     bool load_uv) {
     DEMMeshConnected mesh;
-    bool flag = mesh.LoadWavefrontMesh(filename, load_normals, load_uv);
+    mesh.SetCacheDir(m_mesh_cache_dir);
+    bool flag = mesh.LoadMesh(filename, load_normals, load_uv);
     if (!flag) {
         DEME_ERROR("Failed to load in mesh file %s.", filename.c_str());
     }
@@ -1917,7 +2115,45 @@ std::shared_ptr<DEMInspector> DEMSolver::CreateInspector(const std::string& quan
     return m_inspectors.back();
 }
 
+std::shared_ptr<DEMForceProbe> DEMSolver::CreateForceProbe(const std::vector<bodyID_t>& ownerIDs,
+                                                           bool net_wrench_only) {
+    if (!sys_initialized) {
+        DEME_ERROR("CreateForceProbe can only be called after the system is initialized.");
+    }
+    if (collect_force_in_force_kernel) {
+        DEME_ERROR(
+            "The solver is currently set to not record force pair info, so force probes cannot work.\nYou can call "
+            "SetCollectAccRightAfterForceCalc(false) before system initialization and try again.");
+    }
+    if (ownerIDs.empty()) {
+        DEME_ERROR("CreateForceProbe needs at least one owner to probe.");
+    }
+    for (const auto& owner : ownerIDs) {
+        if (owner >= nOwnerBodies) {
+            DEME_ERROR("CreateForceProbe got owner ID %zu, but there are only %zu owners.", (size_t)owner,
+                       nOwnerBodies);
+        }
+    }
+    m_force_probes.push_back(std::make_shared<DEMForceProbe>(this, this->dT, ownerIDs, net_wrench_only));
+    return m_force_probes.back();
+}
+
+std::shared_ptr<DEMForceProbe> DEMSolver::CreateForceProbe(const std::shared_ptr<DEMTracker>& tracker,
+                                                           bool net_wrench_only) {
+    return CreateForceProbe(tracker->GetOwnerIDs(), net_wrench_only);
+}
+
+void DEMSolver::UpdateForceProbes() {
+    for (auto& probe : m_force_probes)
+        probe->Update();
+}
+
 void DEMSolver::WriteSphereFile(const std::string& outfilename) const {
+    // CSV, binary and VTP files can be formatted and written by the background writer
+    if (dT->isOutputAsync() && m_out_format != OUTPUT_FORMAT::CHPF) {
+        dT->submitOutputFrame(OUTPUT_FRAME_TYPE::SPHERE, m_out_format, outfilename);
+        return;
+    }
     switch (m_out_format) {
 #ifdef DEME_USE_CHPF
         case (OUTPUT_FORMAT::CHPF): {
@@ -1934,11 +2170,14 @@ void DEMSolver::WriteSphereFile(const std::string& outfilename) const {
             break;
         }
         case (OUTPUT_FORMAT::BINARY): {
-            // std::ofstream ptFile(outfilename, std::ios::out | std::ios::binary);
-            //// TODO: Implement it
-            std::ofstream ptFile(outfilename, std::ios::out);
-            DEME_WARNING("Binary sphere output is not implemented yet, using CSV...");
-            dT->writeSpheresAsCsv(ptFile);
+            std::ofstream ptFile(outfilename, std::ios::out | std::ios::binary);
+            dT->writeSpheresAsBinary(ptFile);
+            ptFile.close();
+            break;
+        }
+        case (OUTPUT_FORMAT::VTP): {
+            std::ofstream ptFile(outfilename, std::ios::out | std::ios::binary);
+            dT->writeSpheresAsVtp(ptFile);
             ptFile.close();
             break;
         }
@@ -1948,6 +2187,11 @@ void DEMSolver::WriteSphereFile(const std::string& outfilename) const {
 }
 
 void DEMSolver::WriteClumpFile(const std::string& outfilename, unsigned int accuracy) const {
+    // CSV, binary and VTP files can be formatted and written by the background writer
+    if (dT->isOutputAsync() && m_out_format != OUTPUT_FORMAT::CHPF) {
+        dT->submitOutputFrame(OUTPUT_FRAME_TYPE::CLUMP, m_out_format, outfilename, accuracy);
+        return;
+    }
     switch (m_out_format) {
 #ifdef DEME_USE_CHPF
         case (OUTPUT_FORMAT::CHPF): {
@@ -1964,11 +2208,15 @@ void DEMSolver::WriteClumpFile(const std::string& outfilename, unsigned int accu
             break;
         }
         case (OUTPUT_FORMAT::BINARY): {
-            // std::ofstream ptFile(outfilename, std::ios::out | std::ios::binary);
-            //// TODO: Implement it
-            std::ofstream ptFile(outfilename, std::ios::out);
-            DEME_WARNING("Binary clump output is not implemented yet, using CSV...");
-            dT->writeClumpsAsCsv(ptFile, accuracy);
+            // Binary output stores full single-precision values, so accuracy is not needed
+            std::ofstream ptFile(outfilename, std::ios::out | std::ios::binary);
+            dT->writeClumpsAsBinary(ptFile);
+            ptFile.close();
+            break;
+        }
+        case (OUTPUT_FORMAT::VTP): {
+            std::ofstream ptFile(outfilename, std::ios::out | std::ios::binary);
+            dT->writeClumpsAsVtp(ptFile);
             ptFile.close();
             break;
         }
@@ -1984,6 +2232,16 @@ void DEMSolver::WriteContactFile(const std::string& outfilename, float force_thr
             "call.");
         return;
     }
+    if (m_cnt_out_format == OUTPUT_FORMAT::VTP && !(m_cnt_out_content & CNT_OUTPUT_CONTENT::CNT_POINT)) {
+        DEME_ERROR(
+            "VTP contact files place contacts at their contact points, so the contact point output (CNT_POINT) must be "
+            "enabled via SetContactOutputContent.");
+    }
+    // CSV, binary and VTP files can be formatted and written by the background writer
+    if (dT->isOutputAsync() && m_cnt_out_format != OUTPUT_FORMAT::CHPF) {
+        dT->submitOutputFrame(OUTPUT_FRAME_TYPE::CONTACT, m_cnt_out_format, outfilename, 10, force_thres);
+        return;
+    }
     switch (m_cnt_out_format) {
         case (OUTPUT_FORMAT::CSV): {
             std::ofstream ptFile(outfilename, std::ios::out);
@@ -1992,11 +2250,14 @@ void DEMSolver::WriteContactFile(const std::string& outfilename, float force_thr
             break;
         }
         case (OUTPUT_FORMAT::BINARY): {
-            // std::ofstream ptFile(outfilename, std::ios::out | std::ios::binary);
-            //// TODO: Implement it
-            DEME_WARNING("Binary contact pair output is not implemented yet, using CSV...");
-            std::ofstream ptFile(outfilename, std::ios::out);
-            dT->writeContactsAsCsv(ptFile, force_thres);
+            std::ofstream ptFile(outfilename, std::ios::out | std::ios::binary);
+            dT->writeContactsAsBinary(ptFile, force_thres);
+            ptFile.close();
+            break;
+        }
+        case (OUTPUT_FORMAT::VTP): {
+            std::ofstream ptFile(outfilename, std::ios::out | std::ios::binary);
+            dT->writeContactsAsVtp(ptFile, force_thres);
             ptFile.close();
             break;
         }
@@ -2006,6 +2267,37 @@ void DEMSolver::WriteContactFile(const std::string& outfilename, float force_thr
     }
 }
 
+void DEMSolver::SetAsyncOutput(bool use, unsigned int max_queued_frames) {
+    if (max_queued_frames == 0) {
+        DEME_ERROR("SetAsyncOutput needs to allow at least 1 queued output frame.");
+    }
+    dT->setAsyncOutput(use, max_queued_frames);
+}
+
+void DEMSolver::FlushOutput() {
+    dT->flushOutput();
+}
+
+void DEMSolver::SaveCheckpoint(const std::string& path) {
+    if (!sys_initialized) {
+        DEME_ERROR("SaveCheckpoint can only be called after the system is initialized.");
+    }
+    dT->saveCheckpoint(path);
+}
+
+void DEMSolver::LoadCheckpoint(const std::string& path) {
+    if (!sys_initialized) {
+        DEME_ERROR(
+            "LoadCheckpoint can only be called after the system is initialized.\nSet up the same system as the one the "
+            "checkpoint is saved from, call Initialize, then load the checkpoint.");
+    }
+    if (!std::filesystem::is_directory(path)) {
+        DEME_ERROR("Checkpoint directory %s does not exist.", path.c_str());
+    }
+    dT->loadCheckpoint(path);
+    m_clump_index_valid = false;
+}
+
 void DEMSolver::WriteMeshFile(const std::string& outfilename) const {
     switch (m_mesh_out_format) {
         case (MESH_FORMAT::VTK): {
@@ -2014,6 +2306,12 @@ void DEMSolver::WriteMeshFile(const std::string& outfilename) const {
             ptFile.close();
             break;
         }
+        case (MESH_FORMAT::VTU): {
+            std::ofstream ptFile(outfilename, std::ios::out | std::ios::binary);
+            dT->writeMeshesAsVtu(ptFile);
+            ptFile.close();
+            break;
+        }
         default:
             DEME_ERROR(
                 "Mesh output file format is unknown or not implemented. Please re-set it via SetMeshOutputFormat.");
@@ -2027,6 +2325,12 @@ size_t DEMSolver::ChangeClumpFamily(unsigned int fam_num,
                                     const std::set<unsigned int>& orig_fam) {
     float3 L = make_float3(X.first, Y.first, Z.first);
     float3 U = make_float3(X.second, Y.second, Z.second);
+    return ChangeClumpFamilyByIDs(fam_num, GetClumpsInBox(L, U), orig_fam);
+}
+
+size_t DEMSolver::ChangeClumpFamilyByIDs(unsigned int fam_num,
+                                         const std::vector<bodyID_t>& owners,
+                                         const std::set<unsigned int>& orig_fam) {
     size_t count = 0;
 
     // And get those device-major data from device
@@ -2034,41 +2338,27 @@ size_t DEMSolver::ChangeClumpFamily(unsigned int fam_num,
         dT->familyID.toHost();
         kT->familyID.toHost();
     }
-    dT->voxelID.toHost();
-    dT->locX.toHost();
-    dT->locY.toHost();
-    dT->locZ.toHost();
 
-    for (bodyID_t ownerID = 0; ownerID < nOwnerBodies; ownerID++) {
+    for (const auto ownerID : owners) {
+        if (ownerID >= nOwnerBodies) {
+            DEME_ERROR("ChangeClumpFamilyByIDs got owner ID %zu, but there are only %zu owners.", (size_t)ownerID,
+                       nOwnerBodies);
+        }
+        // Owners may have been reordered, so find where this one is now
+        const bodyID_t implID = dT->ownerImplID(ownerID);
         // ownerTypes has no way to change on device
-        const ownerType_t this_type = dT->ownerTypes[ownerID];
-        if (this_type != OWNER_T_CLUMP)
+        if (dT->ownerTypes[implID] != OWNER_T_CLUMP)
             continue;
-        float3 CoM;
-        voxelID_t voxel = dT->voxelID[ownerID];
-        subVoxelPos_t subVoxX = dT->locX[ownerID];
-        subVoxelPos_t subVoxY = dT->locY[ownerID];
-        subVoxelPos_t subVoxZ = dT->locZ[ownerID];
-        voxelIDToPosition<float, voxelID_t, subVoxelPos_t>(CoM.x, CoM.y, CoM.z, voxel, subVoxX, subVoxY, subVoxZ,
-                                                           dT->simParams->nvXp2, dT->simParams->nvYp2,
-                                                           dT->simParams->voxelSize, dT->simParams->l);
-        CoM.x += dT->simParams->LBFX;
-        CoM.y += dT->simParams->LBFY;
-        CoM.z += dT->simParams->LBFZ;
-
-        // In region. This can be generalized in future versions.
-        if (isBetween(CoM, L, U)) {
-            if (orig_fam.size() == 0) {
-                dT->familyID[ownerID] = fam_num;
-                kT->familyID[ownerID] = fam_num;  // Must do both for dT and kT
+        if (orig_fam.size() == 0) {
+            dT->familyID[implID] = fam_num;
+            kT->familyID[implID] = fam_num;  // Must do both for dT and kT
+            count++;
+        } else {
+            unsigned int old_fam = dT->familyID[implID];
+            if (check_exist(orig_fam, old_fam)) {
+                dT->familyID[implID] = fam_num;
+                kT->familyID[implID] = fam_num;
                 count++;
-            } else {
-                unsigned int old_fam = dT->familyID[ownerID];
-                if (check_exist(orig_fam, old_fam)) {
-                    dT->familyID[ownerID] = fam_num;
-                    kT->familyID[ownerID] = fam_num;
-                    count++;
-                }
             }
         }
     }
@@ -2078,6 +2368,34 @@ size_t DEMSolver::ChangeClumpFamily(unsigned int fam_num,
     return count;
 }
 
+std::vector<bodyID_t> DEMSolver::GetClumpsInBox(const float3& L, const float3& U) {
+    assertSysInit("GetClumpsInBox");
+    return getClumpSpatialIndex().QueryBox(L, U);
+}
+
+std::vector<bodyID_t> DEMSolver::GetClumpsInSphere(const float3& center, float radius) {
+    assertSysInit("GetClumpsInSphere");
+    return getClumpSpatialIndex().QuerySphere(center, radius);
+}
+
+std::vector<bodyID_t> DEMSolver::GetClumpsInCylinder(const float3& center,
+                                                     const float3& axis,
+                                                     float radius,
+                                                     float half_length) {
+    assertSysInit("GetClumpsInCylinder");
+    return getClumpSpatialIndex().QueryCylinder(center, axis, radius, half_length);
+}
+
+std::vector<bodyID_t> DEMSolver::GetClumpsInHalfSpace(const float3& point, const float3& normal) {
+    assertSysInit("GetClumpsInHalfSpace");
+    return getClumpSpatialIndex().QueryHalfSpace(point, normal);
+}
+
+std::vector<bodyID_t> DEMSolver::GetClumpsIf(const std::function<bool(const float3&)>& pred) {
+    assertSysInit("GetClumpsIf");
+    return getClumpSpatialIndex().QueryIf(pred);
+}
+
 // The method should be called after user inputs are in place, and before starting the simulation. It figures out a part
 // of the required simulation information such as the scale of the problem domain, and makes sure these info live in
 // GPU memory.
@@ -2096,6 +2414,7 @@ void DEMSolver::Initialize(bool dry_run) {
     setSimParams();
 
     // Allocate and populate kT dT arrays
+    reserveEntityArrays(false);
     allocateGPUArrays();
     initializeGPUArrays();
 
@@ -2159,6 +2478,13 @@ void DEMSolver::ShowTimingStats() {
         DEME_PRINTF("%s: %.9g seconds, %.6g%% of dT total runtime\n", dT_timer_names.at(i).c_str(), dT_timer_vals.at(i),
                     dT_timer_vals.at(i) / dT_total_time * 100.);
     }
+    if (JitHelper::isDiskCacheEnabled()) {
+        JitHelper::DiskCacheStats jit_stats = JitHelper::getDiskCacheStats();
+        DEME_PRINTF("\n~~ JIT KERNEL CACHE ~~\n");
+        DEME_PRINTF("Kernels loaded from %s: %zu, compiled: %zu, evicted: %zu\n",
+                    JitHelper::getDiskCacheDir().string().c_str(), jit_stats.hits, jit_stats.misses,
+                    jit_stats.evictions);
+    }
     DEME_PRINTF("--------------------------\n");
 }
 
@@ -2217,6 +2543,7 @@ void DEMSolver::resetWorkerThreads() {
     // The user won't be calling this when dT is working, so our only problem is that kT may be spinning in the inner
     // loop. So let's release kT.
     {
+        TraceScope trace(dTkT_InteractionManager->tracer, TRACE_LANE_MAIN, "Wait for kT to sync", dT->nTotalSteps);
         std::unique_lock<std::mutex> lock(kTMain_InteractionManager->mainCanProceed);
         kT->breakWaitingStatus();
         while (!kTMain_InteractionManager->userCallDone) {
@@ -2293,8 +2620,8 @@ void DEMSolver::UpdateClumps() {
     // This method requires kT and dT are sync-ed
     // resetWorkerThreads();
 
-    // NOTE!!! This step in UpdateClumps is extremely important, as we'll soon modify device-major arrays on host!
-    migrateArrayDataToHost();
+    // The new entities are appended to the arrays and only they are written on host, so the existing ones are not
+    // brought to host: their device copies are kept as they are through resizing.
 
     // Record the number of entities, before adding to the system
     size_t nOwners_old = nOwnerBodies;
@@ -2304,11 +2631,13 @@ void DEMSolver::UpdateClumps() {
     size_t nFacets_old = nTriGM;
     unsigned int nAnalGM_old = nAnalGM;
     unsigned int nExtObj_old = nExtObj;
+    size_t nContacts_old = dT->getNumContacts();
 
     preprocessClumps();
     preprocessClumpTemplates();
     //// TODO: This method should also work on newly added meshes
     updateTotalEntityNum();
+    reserveEntityArrays(true);
     allocateGPUArrays();
     // `Update' method needs to know the number of existing clumps and spheres (before this addition)
     updateClumpMeshArrays(nOwners_old, nClumps_old, nSpheres_old, nTriMesh_old, nFacets_old, nExtObj_old, nAnalGM_old);
@@ -2317,7 +2646,7 @@ void DEMSolver::UpdateClumps() {
     // Now that all params prepared, and all data pointers packed on host side, we need to migrate that imformation to
     // the device
     migrateSimParamsToDevice();
-    migrateArrayDataToDevice();
+    migrateNewEntitiesToDevice(nOwners_old, nSpheres_old, nFacets_old, nContacts_old);
 
     ReleaseFlattenedArrays();
     // Updating clumps is very critical
@@ -2336,6 +2665,21 @@ void DEMSolver::UpdateClumps() {
     ClearCache();
 }
 
+void DEMSolver::ReserveEntityCapacity(size_t n_owners, size_t n_spheres, size_t n_triangles) {
+    m_owner_capacity = DEME_MAX(m_owner_capacity, n_owners);
+    m_sphere_capacity = DEME_MAX(m_sphere_capacity, n_spheres);
+    m_tri_capacity = DEME_MAX(m_tri_capacity, n_triangles);
+    // Before initialization, the room is made when the arrays are first allocated
+    if (sys_initialized) {
+        // This method requires kT and dT are sync-ed
+        reserveEntityArrays(false);
+        // Arrays (kT's transfer buffers included) may have moved
+        packDataPointers();
+        dT->granData.toDevice();
+        kT->granData.toDevice();
+    }
+}
+
 void DEMSolver::ChangeClumpSizes(const std::vector<bodyID_t>& IDs, const std::vector<float>& factors) {
     if (!sys_initialized) {
         DEME_ERROR(
@@ -2351,8 +2695,12 @@ void DEMSolver::ChangeClumpSizes(const std::vector<bodyID_t>& IDs, const std::ve
     // This method requires kT and dT are sync-ed
     // resetWorkerThreads();
 
-    std::thread dThread = std::move(std::thread([this, IDs, factors]() { this->dT->changeOwnerSizes(IDs, factors); }));
-    std::thread kThread = std::move(std::thread([this, IDs, factors]() { this->kT->changeOwnerSizes(IDs, factors); }));
+    // Owners may have been reordered, so the workers need to know where these owners are now
+    const std::vector<bodyID_t> implIDs = dT->ownerImplIDs(IDs);
+    std::thread dThread =
+        std::move(std::thread([this, implIDs, factors]() { this->dT->changeOwnerSizes(implIDs, factors); }));
+    std::thread kThread =
+        std::move(std::thread([this, implIDs, factors]() { this->kT->changeOwnerSizes(implIDs, factors); }));
     dThread.join();
     kThread.join();
 
@@ -2360,11 +2708,140 @@ void DEMSolver::ChangeClumpSizes(const std::vector<bodyID_t>& IDs, const std::ve
     dT->announceCritical();
 }
 
+void DEMSolver::ReorderOwnersSpatially() {
+    if (!sys_initialized) {
+        DEME_ERROR(
+            "ReorderOwnersSpatially moves entities around in the solver arrays, so the system must be initialized "
+            "first.");
+    }
+    // This method requires kT and dT are sync-ed
+    dT->reorderOwners(dT->getMortonOwnerOrder());
+    m_last_owner_reorder_step = dT->nTotalSteps;
+}
+
+void DEMSolver::SetAntisymmetricContactWildcards(const std::set<std::string>& names) {
+    dT->setAntisymmetricContactWildcards(names);
+}
+
 /// Removes all entities associated with a family from the arrays (to save memory space). This method should only be
 /// called periodically because it gives a large overhead. This is only used in long simulations where if the
 /// `phased-out' entities do not get cleared, we won't have enough memory space.
-/// TODO: Implement it.
-void DEMSolver::PurgeFamily(unsigned int family_num) {}
+std::vector<bodyID_t> DEMSolver::PurgeFamily(unsigned int family_num) {
+    assertSysInit("PurgeFamily");
+    if (family_num > std::numeric_limits<family_t>::max()) {
+        DEME_ERROR("You instructed family %u to be purged, but family number should not be larger than %u.",
+                   family_num, std::numeric_limits<family_t>::max());
+    }
+    // This method requires kT and dT are sync-ed
+    std::vector<bodyID_t> ownerNew, sphNew, triNew;
+    const size_t nRemoved = dT->purgeFamily(family_num, ownerNew, sphNew, triNew);
+    if (nRemoved == 0) {
+        return ownerNew;
+    }
+    nOwnerBodies = dT->simParams->nOwnerBodies;
+    nOwnerClumps = dT->simParams->nOwnerClumps;
+    nTriMeshes = dT->simParams->nTriMeshes;
+    nSpheresGM = dT->simParams->nSpheresGM;
+    nTriGM = dT->simParams->nTriGM;
+    // The compacted arrays have no room beyond what is left
+    m_owner_capacity = nOwnerBodies;
+    m_sphere_capacity = nSpheresGM;
+    m_tri_capacity = nTriGM;
+
+    // A tracked ID range shrinks to the entities that stay, which are consecutive after the purge. Returns false if
+    // none stays.
+    const auto remapRange = [](const std::vector<bodyID_t>& newIDs, size_t& start, size_t& n) {
+        size_t newStart = 0, newN = 0;
+        for (size_t k = start; k < start + n && k < newIDs.size(); k++) {
+            if (newIDs[k] == NULL_BODYID)
+                continue;
+            if (newN == 0)
+                newStart = newIDs[k];
+            newN++;
+        }
+        start = newStart;
+        n = newN;
+        return newN > 0;
+    };
+    for (auto& obj : m_tracked_objs) {
+        // Skip those not yet given an owner (they come with the next UpdateClumps) or already broken
+        if (obj->ownerID == NULL_BODYID || obj->isBroken)
+            continue;
+        size_t ownerStart = obj->ownerID;
+        if (!remapRange(ownerNew, ownerStart, obj->nSpanOwners)) {
+            obj->isBroken = true;
+            obj->ownerID = NULL_BODYID;
+            obj->nGeos = 0;
+            continue;
+        }
+        obj->ownerID = ownerStart;
+        if (obj->obj_type == OWNER_TYPE::CLUMP) {
+            remapRange(sphNew, obj->geoID, obj->nGeos);
+        } else if (obj->obj_type == OWNER_TYPE::MESH) {
+            remapRange(triNew, obj->geoID, obj->nGeos);
+        }
+    }
+
+    // dT dropped the purged meshes from its cache and gave them a NULL owner
+    m_meshes.erase(std::remove_if(m_meshes.begin(), m_meshes.end(),
+                                  [](const std::shared_ptr<DEMMeshConnected>& mesh) {
+                                      return mesh->owner == NULL_BODYID;
+                                  }),
+                   m_meshes.end());
+    m_owner_mesh_map.clear();
+    for (const auto& mmesh : m_meshes) {
+        m_owner_mesh_map[mmesh->owner] = mmesh->cache_offset;
+    }
+
+    for (auto& probe : m_force_probes) {
+        std::vector<bodyID_t> owners;
+        for (const auto& owner : probe->owners) {
+            if (owner < ownerNew.size() && ownerNew[owner] != NULL_BODYID)
+                owners.push_back(ownerNew[owner]);
+        }
+        probe->owners = std::move(owners);
+        // The probe's buffer holds the same IDs, to be uploaded again
+        probe->buf->ownerIDs.resizeHost(probe->owners.size());
+        for (size_t i = 0; i < probe->owners.size(); i++)
+            probe->buf->ownerIDs[i] = probe->owners[i];
+        probe->buf->ownerIDsOnDevice = false;
+    }
+
+    // A snapshot keeps its record layout, so it is only remapped if all its owners stay
+    for (const auto& weak : m_state_snapshots) {
+        auto snapshot = weak.lock();
+        if (!snapshot || snapshot->m_purged)
+            continue;
+        bool all_stay = true;
+        for (const auto& owner : snapshot->m_owners) {
+            if (owner >= ownerNew.size() || ownerNew[owner] == NULL_BODYID) {
+                all_stay = false;
+                break;
+            }
+        }
+        if (!all_stay) {
+            snapshot->m_purged = true;
+            continue;
+        }
+        snapshot->m_max_owner = 0;
+        for (size_t i = 0; i < snapshot->m_owners.size(); i++) {
+            snapshot->m_owners[i] = ownerNew[snapshot->m_owners[i]];
+            snapshot->m_buf->ownerIDs[i] = snapshot->m_owners[i];
+            snapshot->m_max_owner = std::max(snapshot->m_max_owner, snapshot->m_owners[i]);
+        }
+        snapshot->m_buf->ownerIDsOnDevice = false;
+    }
+    m_state_snapshots.erase(std::remove_if(m_state_snapshots.begin(), m_state_snapshots.end(),
+                                           [](const std::weak_ptr<StateSnapshot>& s) { return s.expired(); }),
+                            m_state_snapshots.end());
+    m_clump_index_valid = false;
+
+    // The purge puts owners back in user-facing ID order, so spatial ordering is redone if it is in use
+    if (m_owner_reorder_freq > 0) {
+        ReorderOwnersSpatially();
+    }
+    return ownerNew;
+}
 
 void DEMSolver::DoDynamics(double thisCallDuration) {
     if (!sys_initialized) {
@@ -2379,6 +2856,8 @@ void DEMSolver::DoDynamics(double thisCallDuration) {
 
     // Wait till dT is done
     {
+        TraceScope trace(dTkT_InteractionManager->tracer, TRACE_LANE_MAIN, "Wait for dT (DoDynamics)",
+                         dT->nTotalSteps);
         std::unique_lock<std::mutex> lock(dTMain_InteractionManager->mainCanProceed);
         while (!dTMain_InteractionManager->userCallDone) {
             dTMain_InteractionManager->cv_mainCanProceed.wait(lock);
@@ -2397,6 +2876,11 @@ void DEMSolver::DoDynamicsThenSync(double thisCallDuration) {
     // resetWorkerThreads.
     resetWorkerThreads();
 
+    // Synced is when owners can be moved around in memory
+    if (m_owner_reorder_freq > 0 && dT->nTotalSteps - m_last_owner_reorder_step >= (size_t)m_owner_reorder_freq) {
+        ReorderOwnersSpatially();
+    }
+
     // This is hardly needed
     // SyncMemoryTransfer();
 }
@@ -2427,6 +2911,25 @@ void DEMSolver::ShowThreadCollaborationStats() {
     DEME_PRINTF("-----------------------------\n");
 }
 
+void DEMSolver::EnableTimelineTrace(bool on, size_t max_events_per_thread) {
+    dTkT_InteractionManager->tracer.Enable(on, max_events_per_thread);
+}
+
+void DEMSolver::WriteTimelineTrace(const std::string& filename) {
+    const auto& tracer = dTkT_InteractionManager->tracer;
+    if (tracer.NumDropped() > 0) {
+        DEME_WARNING(
+            "%zu timeline events were dropped because the per-thread event buffer is full.\nYou can enlarge it via the "
+            "second argument of EnableTimelineTrace.",
+            tracer.NumDropped());
+    }
+    tracer.WriteChromeTrace(filename);
+}
+
+void DEMSolver::ClearTimelineTrace() {
+    dTkT_InteractionManager->tracer.Clear();
+}
+
 void DEMSolver::ShowAnomalies() {
     DEME_PRINTF("\n~~ Simulation anomaly report ~~\n");
     bool there_is_anomaly = goThroughWorkerAnomalies();
@@ -2449,7 +2952,7 @@ void DEMSolver::ClearThreadCollaborationStats() {
     dT->nTotalSteps = 0;
 }
 
-float DEMSolver::dTInspectReduce(const std::shared_ptr<jitify::Program>& inspection_kernel,
+float DEMSolver::dTInspectReduce(const std::shared_ptr<JitProgram>& inspection_kernel,
                                  const std::string& kernel_name,
                                  INSPECT_ENTITY_TYPE thing_to_insp,
                                  CUB_REDUCE_FLAVOR reduce_flavor,
@@ -2460,7 +2963,7 @@ float DEMSolver::dTInspectReduce(const std::shared_ptr<jitify::Program>& inspect
     return (float)(*pRes);
 }
 
-float* DEMSolver::dTInspectNoReduce(const std::shared_ptr<jitify::Program>& inspection_kernel,
+float* DEMSolver::dTInspectNoReduce(const std::shared_ptr<JitProgram>& inspection_kernel,
                                     const std::string& kernel_name,
                                     INSPECT_ENTITY_TYPE thing_to_insp,
                                     CUB_REDUCE_FLAVOR reduce_flavor,
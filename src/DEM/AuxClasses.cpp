@@ -3,6 +3,7 @@
 //
 //	SPDX-License-Identifier: BSD-3-Clause
 
+#include <algorithm>
 #include <numeric>
 
 #include <DEM/API.h>
@@ -223,10 +224,10 @@ void DEMInspector::Initialize(const std::unordered_map<std::string, std::string>
     my_subs["_inRegionPolicy_"] = in_region_specifier;
     my_subs["_quantityQueryProcess_"] = inspection_code;
     if (thing_to_insp == INSPECT_ENTITY_TYPE::SPHERE) {
-        inspection_kernel = std::make_shared<jitify::Program>(std::move(JitHelper::buildProgram(
+        inspection_kernel = std::make_shared<JitProgram>(std::move(JitHelper::buildProgram(
             "DEMSphereQueryKernels", JitHelper::KERNEL_DIR / "DEMSphereQueryKernels.cu", my_subs, options)));
     } else if (thing_to_insp == INSPECT_ENTITY_TYPE::CLUMP || thing_to_insp == INSPECT_ENTITY_TYPE::EVERYTHING) {
-        inspection_kernel = std::make_shared<jitify::Program>(std::move(JitHelper::buildProgram(
+        inspection_kernel = std::make_shared<JitProgram>(std::move(JitHelper::buildProgram(
             "DEMOwnerQueryKernels", JitHelper::KERNEL_DIR / "DEMOwnerQueryKernels.cu", my_subs, options)));
     } else {
         std::stringstream ss;
@@ -522,6 +523,8 @@ float DEMTracker::GetGeometryWildcardValue(const std::string& name, size_t offse
             break;
         case (OWNER_TYPE::MESH):
             assertGeoOffsetValid(offset, "GetGeometryWildcardValue", "triangles");
+            // Offset counts triangles in the order they were loaded, which may not be the order in the solver
+            offset = sys->GetCachedMesh(obj->ownerID)->GetTriangleCurrentID(offset);
             res = sys->GetTriWildcardValue(obj->geoID + offset, name, 1);
             break;
     }
@@ -537,9 +540,18 @@ std::vector<float> DEMTracker::GetGeometryWildcardValues(const std::string& name
         case (OWNER_TYPE::ANALYTICAL):
             res = sys->GetAnalWildcardValue(obj->geoID, name, obj->nGeos);
             break;
-        case (OWNER_TYPE::MESH):
+        case (OWNER_TYPE::MESH): {
             res = sys->GetTriWildcardValue(obj->geoID, name, obj->nGeos);
+            const auto& mesh = sys->GetCachedMesh(obj->ownerID);
+            if (mesh->IsTriangleOrderChanged()) {
+                std::vector<float> in_input_order(res.size());
+                for (size_t i = 0; i < res.size(); i++) {
+                    in_input_order[mesh->GetTriangleInputID(i)] = res[i];
+                }
+                res = std::move(in_input_order);
+            }
             break;
+        }
     }
     return res;
 }
@@ -581,6 +593,10 @@ size_t DEMTracker::GetContactForcesAndLocalTorqueForAll(std::vector<float3>& poi
     return sys->GetOwnerContactForces(GetOwnerIDs(), points, forces, torques, true);
 }
 
+std::shared_ptr<StateSnapshot> DEMTracker::NewStateSnapshot(unsigned int content) {
+    return sys->NewStateSnapshot(GetOwnerIDs(), content);
+}
+
 size_t DEMTracker::GetContactForcesAndGlobalTorque(std::vector<float3>& points,
                                                    std::vector<float3>& forces,
                                                    std::vector<float3>& torques,
@@ -718,6 +734,7 @@ void DEMTracker::SetGeometryWildcardValue(const std::string& name, float wc, siz
             break;
         case (OWNER_TYPE::MESH):
             assertGeoOffsetValid(offset, "SetGeometryWildcardValue", "triangles");
+            offset = sys->GetCachedMesh(obj->ownerID)->GetTriangleCurrentID(offset);
             sys->SetTriWildcardValue(obj->geoID + offset, name, std::vector<float>(1, wc));
             break;
     }
@@ -733,11 +750,200 @@ void DEMTracker::SetGeometryWildcardValues(const std::string& name, const std::v
             assertGeoSize(wc.size(), "SetGeometryWildcardValues", "analytical components");
             sys->SetAnalWildcardValue(obj->geoID, name, wc);
             break;
-        case (OWNER_TYPE::MESH):
+        case (OWNER_TYPE::MESH): {
             assertGeoSize(wc.size(), "SetGeometryWildcardValues", "triangles");
-            sys->SetTriWildcardValue(obj->geoID, name, wc);
+            const auto& mesh = sys->GetCachedMesh(obj->ownerID);
+            if (mesh->IsTriangleOrderChanged()) {
+                std::vector<float> in_current_order(wc.size());
+                for (size_t i = 0; i < wc.size(); i++) {
+                    in_current_order[i] = wc[mesh->GetTriangleInputID(i)];
+                }
+                sys->SetTriWildcardValue(obj->geoID, name, in_current_order);
+            } else {
+                sys->SetTriWildcardValue(obj->geoID, name, wc);
+            }
             break;
+        }
+    }
+}
+
+// =============================================================================
+// StateSnapshot class
+// =============================================================================
+
+StateSnapshot::StateSnapshot(const std::vector<bodyID_t>& ownerIDs, unsigned int content)
+    : m_owners(ownerIDs), m_content(content), m_buf(std::make_shared<StateSnapshotBuffer>()) {
+    // Record layout follows the order of SNAPSHOT_CONTENT flags
+    const unsigned int field_len[7] = {3, 4, 3, 3, 3, 3, 1};
+    for (unsigned int bit = 0; bit < 7; bit++) {
+        if (m_content & (1u << bit)) {
+            m_field_offset[bit] = m_record_len;
+            m_record_len += field_len[bit];
+        } else {
+            m_field_offset[bit] = -1;
+        }
+    }
+    if (m_record_len == 0) {
+        throw std::runtime_error("A StateSnapshot must gather at least one state (a SNAPSHOT_CONTENT flag).");
+    }
+    // Only host side here; the device side is allocated by dT, on its own GPU
+    m_buf->ownerIDs.resizeHost(m_owners.size());
+    for (size_t i = 0; i < m_owners.size(); i++) {
+        m_buf->ownerIDs[i] = m_owners[i];
+        m_max_owner = std::max(m_max_owner, m_owners[i]);
+    }
+}
+
+StateSnapshot::~StateSnapshot() {}
+
+size_t StateSnapshot::TrackerStart(size_t k) const {
+    if (k >= m_tracker_starts.size()) {
+        std::stringstream ss;
+        ss << "TrackerStart was asked for tracker " << k << ", but this snapshot was made from "
+           << m_tracker_starts.size() << " trackers." << std::endl;
+        throw std::runtime_error(ss.str());
+    }
+    return m_tracker_starts[k];
+}
+
+bool StateSnapshot::IsReady() const {
+    if (!m_buf->pending)
+        return true;
+    if (cudaEventQuery(m_buf->ready) == cudaSuccess) {
+        m_buf->pending = false;
+        return true;
+    }
+    return false;
+}
+
+void StateSnapshot::Wait() const {
+    m_buf->wait();
+}
+
+const float* StateSnapshot::fieldOf(size_t i, SNAPSHOT_CONTENT field, const char* name) const {
+    unsigned int bit = 0;
+    while ((1u << bit) != (unsigned int)field)
+        bit++;
+    if (m_field_offset[bit] < 0) {
+        std::stringstream ss;
+        ss << name << " is called on a StateSnapshot that does not gather this state." << std::endl;
+        throw std::runtime_error(ss.str());
+    }
+    if (!m_taken) {
+        std::stringstream ss;
+        ss << name << " is called on a StateSnapshot that is not taken yet." << std::endl;
+        throw std::runtime_error(ss.str());
     }
+    if (i >= m_owners.size()) {
+        std::stringstream ss;
+        ss << name << " is called with index " << i << ", but this snapshot has only " << m_owners.size()
+           << " owners." << std::endl;
+        throw std::runtime_error(ss.str());
+    }
+    Wait();
+    return m_buf->data.host() + i * m_record_len + m_field_offset[bit];
+}
+
+float3 StateSnapshot::Pos(size_t i) const {
+    const float* v = fieldOf(i, SNAP_POS, "Pos");
+    return make_float3(v[0], v[1], v[2]);
+}
+float4 StateSnapshot::OriQ(size_t i) const {
+    const float* v = fieldOf(i, SNAP_ORI_Q, "OriQ");
+    return make_float4(v[0], v[1], v[2], v[3]);
+}
+float3 StateSnapshot::Vel(size_t i) const {
+    const float* v = fieldOf(i, SNAP_VEL, "Vel");
+    return make_float3(v[0], v[1], v[2]);
+}
+float3 StateSnapshot::AngVelLocal(size_t i) const {
+    const float* v = fieldOf(i, SNAP_ANG_VEL, "AngVelLocal");
+    return make_float3(v[0], v[1], v[2]);
+}
+float3 StateSnapshot::AngVelGlobal(size_t i) const {
+    float3 ang_v = AngVelLocal(i);
+    float4 oriQ = OriQ(i);
+    applyOriQToVector3(ang_v.x, ang_v.y, ang_v.z, oriQ.w, oriQ.x, oriQ.y, oriQ.z);
+    return ang_v;
+}
+float3 StateSnapshot::Acc(size_t i) const {
+    const float* v = fieldOf(i, SNAP_ACC, "Acc");
+    return make_float3(v[0], v[1], v[2]);
+}
+float3 StateSnapshot::AngAccLocal(size_t i) const {
+    const float* v = fieldOf(i, SNAP_ANG_ACC, "AngAccLocal");
+    return make_float3(v[0], v[1], v[2]);
+}
+unsigned int StateSnapshot::Family(size_t i) const {
+    return (unsigned int)(*fieldOf(i, SNAP_FAMILY, "Family"));
+}
+
+std::vector<float3> StateSnapshot::Positions() const {
+    return collect(&StateSnapshot::Pos);
+}
+std::vector<float4> StateSnapshot::OrientationQuaternions() const {
+    return collect(&StateSnapshot::OriQ);
+}
+std::vector<float3> StateSnapshot::Velocities() const {
+    return collect(&StateSnapshot::Vel);
+}
+std::vector<float3> StateSnapshot::AngularVelocitiesLocal() const {
+    return collect(&StateSnapshot::AngVelLocal);
+}
+std::vector<float3> StateSnapshot::AngularVelocitiesGlobal() const {
+    return collect(&StateSnapshot::AngVelGlobal);
+}
+std::vector<float3> StateSnapshot::Accelerations() const {
+    return collect(&StateSnapshot::Acc);
+}
+std::vector<float3> StateSnapshot::AngularAccelerationsLocal() const {
+    return collect(&StateSnapshot::AngAccLocal);
+}
+std::vector<unsigned int> StateSnapshot::Families() const {
+    return collect(&StateSnapshot::Family);
+}
+
+// =============================================================================
+// DEMForceProbe class
+// =============================================================================
+
+DEMForceProbe::DEMForceProbe(DEMSolver* sim_sys,
+                             DEMDynamicThread* dT_sys,
+                             const std::vector<bodyID_t>& ownerIDs,
+                             bool wrench_only)
+    : sys(sim_sys),
+      dT(dT_sys),
+      owners(hostSort(ownerIDs)),
+      net_wrench_only(wrench_only),
+      buf(std::make_shared<ForceProbeBuffer>()) {
+    owners.erase(std::unique(owners.begin(), owners.end()), owners.end());
+    // Only host side here; the device side is allocated by dT, on its own GPU
+    buf->ownerIDs.resizeHost(owners.size());
+    for (size_t i = 0; i < owners.size(); i++)
+        buf->ownerIDs[i] = owners[i];
+}
+
+DEMForceProbe::~DEMForceProbe() {}
+
+size_t DEMForceProbe::Update() {
+    num_contacts = dT->updateForceProbe(*buf, ref_point, !net_wrench_only, wrench);
+    if (!net_wrench_only) {
+        points.assign(buf->points.host(), buf->points.host() + num_contacts);
+        forces.assign(buf->forces.host(), buf->forces.host() + num_contacts);
+        torques.assign(buf->torques.host(), buf->torques.host() + num_contacts);
+    }
+    return num_contacts;
+}
+
+float3 DEMForceProbe::GetNetForce() const {
+    return make_float3(wrench[0], wrench[1], wrench[2]);
+}
+float3 DEMForceProbe::GetNetTorque() const {
+    return make_float3(wrench[3], wrench[4], wrench[5]);
+}
+std::vector<float> DEMForceProbe::GetNetWrench() const {
+    return {(float)wrench[0], (float)wrench[1], (float)wrench[2],
+            (float)wrench[3], (float)wrench[4], (float)wrench[5]};
 }
 
 // =============================================================================
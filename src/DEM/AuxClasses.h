@@ -6,25 +6,28 @@
 #ifndef DEME_INSPECTOR_HPP
 #define DEME_INSPECTOR_HPP
 
+#include <memory>
 #include <unordered_map>
+#include <vector>
 #include <core/utils/JitHelper.h>
 #include <DEM/Defines.h>
 
-// Forward declare jitify::Program to avoid downstream dependency
-namespace jitify {
-class Program;
-}
+// Forward declare JitProgram to avoid downstream dependency
+class JitProgram;
 
 namespace deme {
 
 class DEMSolver;
 class DEMDynamicThread;
+class StateSnapshot;
+struct StateSnapshotBuffer;
+struct ForceProbeBuffer;
 
 /// A class that the user can construct to inspect a certain property (such as void ratio, maximum Z coordinate...) of
 /// their simulation entites, in a given region.
 class DEMInspector {
   private:
-    std::shared_ptr<jitify::Program> inspection_kernel;
+    std::shared_ptr<JitProgram> inspection_kernel;
 
     std::string inspection_code;
     std::string in_region_code;
@@ -413,6 +416,156 @@ class DEMTracker {
     size_t GetContactForcesAndLocalTorqueForAll(std::vector<float3>& points,
                                                 std::vector<float3>& forces,
                                                 std::vector<float3>& torques);
+
+    /// @brief Create a snapshot request covering all objects tracked by this tracker. See DEMSolver::NewStateSnapshot.
+    /// @param content The states to gather, as a combination of SNAPSHOT_CONTENT flags.
+    /// @return The snapshot request, to be filled by DEMSolver::TakeStateSnapshot(Async).
+    std::shared_ptr<StateSnapshot> NewStateSnapshot(
+        unsigned int content = SNAP_POS | SNAP_ORI_Q | SNAP_VEL | SNAP_ANG_VEL);
+};
+
+/// A batched request for the states of a fixed list of owners. DEMSolver::TakeStateSnapshot gathers every requested
+/// state of every listed owner on the device and brings them back in one copy, whereas the DEMTracker accessors make a
+/// few small copies per state per query. Create it with DEMSolver::NewStateSnapshot and reuse it across steps: its
+/// device and pinned host buffers are kept.
+class StateSnapshot {
+  public:
+    StateSnapshot(const std::vector<bodyID_t>& ownerIDs, unsigned int content);
+    ~StateSnapshot();
+
+    /// Number of owners in this snapshot.
+    size_t Size() const { return m_owners.size(); }
+    /// The owners in this snapshot. The i-th state accessor result belongs to the i-th owner here.
+    const std::vector<bodyID_t>& GetOwnerIDs() const { return m_owners; }
+    /// The gathered states, as a combination of SNAPSHOT_CONTENT flags.
+    unsigned int GetContent() const { return m_content; }
+    /// If this snapshot was created from a list of trackers, the index of the first owner of the k-th tracker.
+    size_t TrackerStart(size_t k) const;
+    /// Simulation time when this snapshot was last taken (or requested, for an async one).
+    double GetSimTime() const { return m_time; }
+    /// Whether the data of this snapshot are available.
+    bool IsTaken() const { return m_taken; }
+
+    /// Whether the last TakeStateSnapshotAsync on this snapshot has landed on host.
+    bool IsReady() const;
+    /// Block until the last TakeStateSnapshotAsync on this snapshot lands on host. All the state accessors call it.
+    void Wait() const;
+
+    /// Get the position of the i-th owner.
+    float3 Pos(size_t i) const;
+    /// Get the orientation quaternion of the i-th owner.
+    float4 OriQ(size_t i) const;
+    /// Get the velocity of the i-th owner.
+    float3 Vel(size_t i) const;
+    /// Get the angular velocity of the i-th owner in its local frame.
+    float3 AngVelLocal(size_t i) const;
+    /// Get the angular velocity of the i-th owner in global frame. Needs both SNAP_ANG_VEL and SNAP_ORI_Q.
+    float3 AngVelGlobal(size_t i) const;
+    /// Get the contact-induced acceleration of the i-th owner.
+    float3 Acc(size_t i) const;
+    /// Get the contact-induced angular acceleration of the i-th owner in its local frame.
+    float3 AngAccLocal(size_t i) const;
+    /// Get the family number of the i-th owner.
+    unsigned int Family(size_t i) const;
+
+    /// Get the said state of all owners in this snapshot.
+    std::vector<float3> Positions() const;
+    std::vector<float4> OrientationQuaternions() const;
+    std::vector<float3> Velocities() const;
+    std::vector<float3> AngularVelocitiesLocal() const;
+    std::vector<float3> AngularVelocitiesGlobal() const;
+    std::vector<float3> Accelerations() const;
+    std::vector<float3> AngularAccelerationsLocal() const;
+    std::vector<unsigned int> Families() const;
+
+  private:
+    friend class DEMSolver;
+
+    std::vector<bodyID_t> m_owners;
+    unsigned int m_content;
+    // Floats per owner record, and where each state starts in a record (-1 if not gathered), indexed by the bit
+    // position of its SNAPSHOT_CONTENT flag
+    unsigned int m_record_len = 0;
+    int m_field_offset[7];
+    std::vector<size_t> m_tracker_starts;
+    double m_time = 0.;
+    bool m_taken = false;
+    // Largest owner ID in m_owners, for a cheap bounds check at each take
+    bodyID_t m_max_owner = 0;
+    // Some owners were removed by PurgeFamily, so this snapshot can no longer be taken
+    bool m_purged = false;
+    // Device and pinned host staging, owned by dT's side of things
+    std::shared_ptr<StateSnapshotBuffer> m_buf;
+
+    // Point to the record of owner i at the state field, checking that this state is gathered
+    const float* fieldOf(size_t i, SNAPSHOT_CONTENT field, const char* name) const;
+    template <typename T>
+    std::vector<T> collect(T (StateSnapshot::*getter)(size_t) const) const {
+        std::vector<T> res(m_owners.size());
+        for (size_t i = 0; i < m_owners.size(); i++)
+            res[i] = (this->*getter)(i);
+        return res;
+    }
+};
+
+/// A registered query of the contact forces acting on a fixed set of owners, mainly for co-simulation. It keeps its
+/// device buffers between calls, and can reduce the contact forces to a net wrench on device, so a per-step query can
+/// bring back 6 numbers instead of all contact pairs. Create it with DEMSolver::CreateForceProbe.
+class DEMForceProbe {
+  private:
+    // Its parent DEMSolver and dT system
+    DEMSolver* sys;
+    DEMDynamicThread* dT;
+
+    // Sorted probed owners
+    std::vector<bodyID_t> owners;
+    bool net_wrench_only;
+    float3 ref_point = make_float3(0, 0, 0);
+    std::shared_ptr<ForceProbeBuffer> buf;
+
+    // Results of the last Update
+    size_t num_contacts = 0;
+    std::vector<float3> points;
+    std::vector<float3> forces;
+    std::vector<float3> torques;
+    double wrench[6] = {0., 0., 0., 0., 0., 0.};
+
+  public:
+    friend class DEMSolver;
+
+    DEMForceProbe(DEMSolver* sim_sys,
+                  DEMDynamicThread* dT_sys,
+                  const std::vector<bodyID_t>& ownerIDs,
+                  bool wrench_only);
+    ~DEMForceProbe();
+
+    /// Get the probed owners, sorted.
+    const std::vector<bodyID_t>& GetOwnerIDs() const { return owners; }
+    /// Whether this probe only computes the net wrench, not the per-contact results.
+    bool IsNetWrenchOnly() const { return net_wrench_only; }
+    /// Set the point (in global frame) that the net torque is taken about. Default is the origin.
+    void SetReferencePoint(const float3& point) { ref_point = point; }
+    float3 GetReferencePoint() const { return ref_point; }
+
+    /// @brief Query the current contact forces on the probed owners.
+    /// @return Number of contacts in the per-contact results (always 0 if this probe is net-wrench-only).
+    size_t Update();
+
+    /// Number of contacts in the per-contact results of the last Update.
+    size_t GetNumContacts() const { return num_contacts; }
+    /// Per-contact results of the last Update: contact points, and the forces the probed owners feel, in global frame.
+    const std::vector<float3>& GetContactPoints() const { return points; }
+    const std::vector<float3>& GetContactForces() const { return forces; }
+    /// Per-contact results of the last Update: the extra (e.g. rolling resistance) torque of each contact about the
+    /// probed owner's CoM, in global frame.
+    const std::vector<float3>& GetContactTorques() const { return torques; }
+
+    /// Net contact force the probed set feels, from the last Update. Contacts between two probed owners cancel out.
+    float3 GetNetForce() const;
+    /// Net contact torque the probed set feels about the reference point, in global frame, from the last Update.
+    float3 GetNetTorque() const;
+    /// Net force then net torque, as 6 floats.
+    std::vector<float> GetNetWrench() const;
 };
 
 class DEMForceModel {
@@ -245,6 +245,9 @@ class DEMMeshConnected : public DEMInitializer {
         }
     }
 
+    // Shared by the mesh loaders; format is "obj", "stl" or "ply"
+    bool loadMeshFile(const std::string& input_file, const std::string& format, bool load_normals, bool load_uv);
+
   public:
     // Number of triangle facets in the mesh
     size_t nTri = 0;
@@ -316,13 +319,16 @@ class DEMMeshConnected : public DEMInitializer {
     // normals derived from right-hand-rule are the same as the normals in the mesh file
     bool use_mesh_normals = false;
 
+    // If not empty, processed meshes are cached in this directory (keyed by file content hash) and reloaded from there
+    std::string cache_dir;
+
     DEMMeshConnected() { obj_type = OWNER_TYPE::MESH; }
     DEMMeshConnected(std::string input_file) {
-        LoadWavefrontMesh(input_file);
+        LoadMesh(input_file);
         obj_type = OWNER_TYPE::MESH;
     }
     DEMMeshConnected(std::string input_file, const std::shared_ptr<DEMMaterial>& mat) {
-        LoadWavefrontMesh(input_file);
+        LoadMesh(input_file);
         SetMaterial(mat);
         obj_type = OWNER_TYPE::MESH;
     }
@@ -331,6 +337,19 @@ class DEMMeshConnected : public DEMInitializer {
     /// Load a triangle mesh saved as a Wavefront .obj file
     bool LoadWavefrontMesh(std::string input_file, bool load_normals = true, bool load_uv = false);
 
+    /// Load a triangle mesh saved as a binary or ASCII .stl file. Each facet normal is kept as the normal of its 3
+    /// nodes, and coincident nodes are merged.
+    bool LoadSTLMesh(std::string input_file, bool load_normals = true);
+
+    /// Load a triangle mesh saved as a binary or ASCII .ply file
+    bool LoadPLYMesh(std::string input_file, bool load_normals = true, bool load_uv = false);
+
+    /// Load a triangle mesh file, with the format (.obj, .stl or .ply) picked by its extension
+    bool LoadMesh(std::string input_file, bool load_normals = true, bool load_uv = false);
+
+    /// Cache processed meshes in this directory, so loading the same file again skips parsing it. Empty disables it.
+    void SetCacheDir(const std::string& dir) { cache_dir = dir; }
+
     /// Write the specified meshes in a Wavefront .obj file
     static void WriteWavefront(const std::string& filename, std::vector<DEMMeshConnected>& meshes);
 
@@ -363,6 +382,8 @@ class DEMMeshConnected : public DEMInitializer {
         this->m_face_n_indices.clear();
         this->m_face_uv_indices.clear();
         this->m_face_col_indices.clear();
+        this->m_tri_input_ids.clear();
+        this->m_tri_current_ids.clear();
         this->owner = NULL_BODYID;
     }
 
@@ -553,6 +574,30 @@ class DEMMeshConnected : public DEMInitializer {
     void AddGeometryWildcard(const std::string& name, float val) {
         AddGeometryWildcard(name, std::vector<float>(nTri, val));
     }
+
+    ////////////////////////////////////////////////////////
+    // Triangle ordering
+    ////////////////////////////////////////////////////////
+    // Element i is the ID (in the order the triangles were loaded/added) of the triangle now at position i. Empty means
+    // the triangles were never reordered.
+    std::vector<size_t> m_tri_input_ids;
+    // The inverse map of m_tri_input_ids
+    std::vector<size_t> m_tri_current_ids;
+
+    /// Reorder the triangles: the triangle at position order[i] goes to position i. Per-triangle data (normal, UV and
+    /// color indices, materials and geometry wildcards) follow their triangles; nodes are untouched.
+    void ReorderTriangles(const std::vector<size_t>& order);
+    /// Reorder the triangles along a Morton curve of their centroids, so triangles with close-by IDs are close in
+    /// space. Returns the order applied (see ReorderTriangles).
+    std::vector<size_t> SortTrianglesSpatially();
+    /// Whether the triangles were reordered since they were loaded.
+    bool IsTriangleOrderChanged() const { return !m_tri_input_ids.empty(); }
+    /// Get the original (as loaded) ID of the triangle that is now the id-th.
+    size_t GetTriangleInputID(size_t id) const { return m_tri_input_ids.empty() ? id : m_tri_input_ids.at(id); }
+    /// Get the current ID of the triangle that was the input_id-th when loaded.
+    size_t GetTriangleCurrentID(size_t input_id) const {
+        return m_tri_current_ids.empty() ? input_id : m_tri_current_ids.at(input_id);
+    }
 };
 
 /*
@@ -0,0 +1,469 @@
+//  Copyright (c) 2021, SBEL GPU Development Team
+//  Copyright (c) 2021, University of Wisconsin - Madison
+//
+//	SPDX-License-Identifier: BSD-3-Clause
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+#include <unordered_map>
+
+#include <DEM/BinSizeTuner.h>
+#include <DEM/Structs.h>
+#include <DEM/HostSideHelpers.hpp>
+
+namespace deme {
+
+// Max number of decision periods the cost model is fitted over
+const size_t BIN_TUNER_MAX_SAMPLES = 8;
+// If the fitted model is off by more than this fraction on a new period, it is refitted from scratch
+const double BIN_TUNER_REFIT_TOL = 0.3;
+// Bin sizes closer than this (relative) count as the same bin size
+const double BIN_TUNER_SAME_SIZE_TOL = 0.02;
+// Number of bin sizes tried when searching for the cheapest one
+const unsigned int BIN_TUNER_SEARCH_PTS = 41;
+
+const char* const CD_STATS_CSV_HEADER =
+    "bin_size,num_spheres,num_sph_bin_pairs,num_active_bins,max_sph_in_bin,max_tri_in_bin,num_pair_candidates,"
+    "num_contacts,cd_time";
+
+void WriteCDStatsCsv(std::ostream& out, const std::vector<CDStatsRecord>& records) {
+    out << CD_STATS_CSV_HEADER << "\n";
+    out << std::setprecision(10);
+    for (const auto& rec : records) {
+        out << rec.bin_size << "," << rec.num_spheres << "," << rec.num_sph_bin_pairs << "," << rec.num_active_bins
+            << "," << rec.max_sph_in_bin << "," << rec.max_tri_in_bin << "," << rec.num_pair_candidates << ","
+            << rec.num_contacts << "," << rec.cd_time << "\n";
+    }
+}
+
+std::vector<CDStatsRecord> ReadCDStatsCsv(std::istream& in) {
+    std::vector<CDStatsRecord> records;
+    std::string line;
+    size_t line_num = 0;
+    while (std::getline(in, line)) {
+        line_num++;
+        if (line.empty() || line == CD_STATS_CSV_HEADER || line.rfind("bin_size", 0) == 0) {
+            continue;
+        }
+        std::vector<double> vals;
+        std::stringstream ss(line);
+        std::string cell;
+        try {
+            while (std::getline(ss, cell, ',')) {
+                vals.push_back(std::stod(cell));
+            }
+        } catch (const std::exception&) {
+            vals.clear();
+        }
+        if (vals.size() != 9) {
+            throw std::runtime_error("Line " + std::to_string(line_num) +
+                                     " of the CD statistics CSV does not have 9 numbers: " + line);
+        }
+        CDStatsRecord rec;
+        rec.bin_size = vals[0];
+        rec.num_spheres = (size_t)vals[1];
+        rec.num_sph_bin_pairs = (size_t)vals[2];
+        rec.num_active_bins = (size_t)vals[3];
+        rec.max_sph_in_bin = (size_t)vals[4];
+        rec.max_tri_in_bin = (size_t)vals[5];
+        rec.num_pair_candidates = vals[6];
+        rec.num_contacts = (size_t)vals[7];
+        rec.cd_time = vals[8];
+        records.push_back(rec);
+    }
+    return records;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// The original heuristic
+////////////////////////////////////////////////////////////////////////////////
+
+double HeuristicBinSizeTuner::Decide(double bin_size, const BinSizeLimits& limits) {
+    if (m_pending.empty()) {
+        return bin_size;
+    }
+    double curr_time = 0.;
+    for (const auto& rec : m_pending) {
+        curr_time += rec.cd_time;
+    }
+    curr_time /= (double)m_pending.size();
+    const CDStatsRecord last = m_pending.back();
+    m_pending.clear();
+
+    int speed_dir = sign_func(m_curr_rate);
+    // Note the speed can be 0, yet we find performance variance. Then this is purely noise. We still wish the bin size
+    // to change in the next iteration, so we assign a direction randomly.
+    if (speed_dir == 0)
+        speed_dir = (randomZeroOrOne() == 0) ? -1 : 1;
+    float speed_update;
+    if (curr_time < m_prev_time) {
+        // If there is improvement, then we accelerate the current change direction
+        speed_update = speed_dir * m_rate_acc * m_top_rate;
+    } else {
+        // If no improvement, revert the direction
+        speed_update = -speed_dir * m_rate_acc * m_top_rate;
+    }
+    m_prev_time = curr_time;
+    // But, if the bin size is going to get too big or too small, a penalty is enforced
+    if (last.max_sph_in_bin > limits.max_sph_in_bin || last.max_tri_in_bin > limits.max_tri_in_bin) {
+        // Then the size must start to decrease
+        speed_update = -1.0 * m_rate_acc * m_top_rate;
+    }
+    if (bin_size < limits.min_bin_size) {
+        // Then size must start to increase
+        speed_update = 1.0 * m_rate_acc * m_top_rate;
+    }
+
+    // Acc is done. Now apply it to bin size change speed, which must fall in range
+    m_curr_rate = clampBetween(m_curr_rate + speed_update, -m_top_rate, m_top_rate);
+    if (m_curr_rate > 0) {
+        bin_size *= (1. + m_curr_rate);
+    } else {
+        bin_size /= (1. - m_curr_rate);
+    }
+    return bin_size;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// The cost model tuner
+////////////////////////////////////////////////////////////////////////////////
+
+// Solve the n by n system A x = b in place (Gaussian elimination with partial pivoting); false if singular
+static bool solveSmallSystem(double A[4][4], double b[4], unsigned int n) {
+    for (unsigned int col = 0; col < n; col++) {
+        unsigned int piv = col;
+        for (unsigned int r = col + 1; r < n; r++) {
+            if (std::abs(A[r][col]) > std::abs(A[piv][col]))
+                piv = r;
+        }
+        if (std::abs(A[piv][col]) < 1e-12)
+            return false;
+        std::swap(A[col], A[piv]);
+        std::swap(b[col], b[piv]);
+        for (unsigned int r = col + 1; r < n; r++) {
+            const double f = A[r][col] / A[col][col];
+            for (unsigned int c = col; c < n; c++)
+                A[r][c] -= f * A[col][c];
+            b[r] -= f * b[col];
+        }
+    }
+    for (int r = (int)n - 1; r >= 0; r--) {
+        for (unsigned int c = r + 1; c < n; c++)
+            b[r] -= A[r][c] * b[c];
+        b[r] /= A[r][r];
+    }
+    return true;
+}
+
+bool CostModelBinSizeTuner::fit() {
+    std::fill(m_coeff, m_coeff + 4, 0.);
+    // Count distinct bin sizes: a model with more terms than that cannot be pinned down
+    std::vector<double> sizes;
+    for (const auto& s : m_samples) {
+        bool seen = false;
+        for (double b : sizes) {
+            seen = seen || (std::abs(s.bin_size - b) <= BIN_TUNER_SAME_SIZE_TOL * b);
+        }
+        if (!seen)
+            sizes.push_back(s.bin_size);
+    }
+    if (sizes.size() < 2) {
+        return false;
+    }
+    // Terms join the model in this order as more bin sizes are seen: pairs and candidates (the two sides of the
+    // trade-off), then a constant, then active bins
+    const unsigned int term_order[4] = {1, 3, 0, 2};
+    const unsigned int num_terms = std::min<unsigned int>(sizes.size(), 4);
+
+    // Features, scaled to be about 1
+    const size_t m = m_samples.size();
+    std::vector<std::array<double, 4>> X(m);
+    std::vector<double> y(m);
+    double scale[4] = {1., 0., 0., 0.}, y_scale = 0.;
+    for (size_t i = 0; i < m; i++) {
+        const Sample& s = m_samples[i];
+        X[i] = {1., s.pairs, s.active, s.candidates};
+        y[i] = s.time;
+        for (unsigned int t = 1; t < 4; t++)
+            scale[t] = std::max(scale[t], X[i][t]);
+        y_scale = std::max(y_scale, y[i]);
+    }
+    if (y_scale <= 0.) {
+        return false;
+    }
+    for (unsigned int t = 1; t < 4; t++)
+        scale[t] = (scale[t] > 0.) ? scale[t] : 1.;
+
+    // Non-negative least squares by trying every subset of the allowed terms (there are at most 15)
+    double best_res = DEME_HUGE_FLOAT;
+    bool found = false;
+    for (unsigned int mask = 1; mask < (1u << num_terms); mask++) {
+        unsigned int terms[4], n = 0;
+        for (unsigned int k = 0; k < num_terms; k++) {
+            if (mask & (1u << k))
+                terms[n++] = term_order[k];
+        }
+        double A[4][4] = {}, rhs[4] = {};
+        for (size_t i = 0; i < m; i++) {
+            for (unsigned int r = 0; r < n; r++) {
+                const double xr = X[i][terms[r]] / scale[terms[r]];
+                rhs[r] += xr * y[i] / y_scale;
+                for (unsigned int c = 0; c < n; c++)
+                    A[r][c] += xr * X[i][terms[c]] / scale[terms[c]];
+            }
+        }
+        if (!solveSmallSystem(A, rhs, n))
+            continue;
+        bool nonneg = true;
+        for (unsigned int r = 0; r < n; r++)
+            nonneg = nonneg && (rhs[r] >= 0.);
+        if (!nonneg)
+            continue;
+        double res = 0.;
+        for (size_t i = 0; i < m; i++) {
+            double pred = 0.;
+            for (unsigned int r = 0; r < n; r++)
+                pred += rhs[r] * X[i][terms[r]] / scale[terms[r]];
+            res += (pred - y[i] / y_scale) * (pred - y[i] / y_scale);
+        }
+        // Ties go to the simpler model
+        if (res < best_res * (1. - 1e-9)) {
+            best_res = res;
+            found = true;
+            std::fill(m_coeff, m_coeff + 4, 0.);
+            for (unsigned int r = 0; r < n; r++)
+                m_coeff[terms[r]] = rhs[r] * y_scale / scale[terms[r]];
+        }
+    }
+    // A model that is just a constant cannot tell bin sizes apart
+    return found && (m_coeff[1] > 0. || m_coeff[2] > 0. || m_coeff[3] > 0.);
+}
+
+double CostModelBinSizeTuner::predict(const Sample& s, double b, double& max_sph, double& max_tri) const {
+    const double N = std::max(s.num_spheres, 1.);
+    // A sphere of effective span k touches about (1 + k / b)^3 bins
+    const double k = s.bin_size * (std::cbrt(std::max(s.pairs / N, 1.)) - 1.);
+    const double P = N * std::pow(1. + k / b, 3);
+    // Active bins scale with the bin volume, but a sphere fills at least a bin
+    const double A = std::max(std::min(P, s.active * std::pow(s.bin_size / b, 3)), 1.);
+    // Candidates are about A * nbar^2 / 2 (nbar being the mean spheres per active bin), times a factor for how uneven
+    // the bins are, taken from the sample. It is floored so a sample with no pairs still predicts some at larger bins.
+    const double nbar_s = std::max(s.pairs / std::max(s.active, 1.), 1.);
+    const double nbar = P / A;
+    const double uneven = std::max(s.candidates / (std::max(s.active, 1.) * nbar_s * nbar_s / 2.), 0.25);
+    const double C = uneven * A * nbar * nbar / 2.;
+    max_sph = s.max_sph * nbar / nbar_s;
+    // Triangles are mostly larger than bins, so a bin sees about as many as its face area suggests
+    max_tri = s.max_tri * (b / s.bin_size) * (b / s.bin_size);
+    return m_coeff[0] + m_coeff[1] * P + m_coeff[2] * A + m_coeff[3] * C;
+}
+
+double CostModelBinSizeTuner::Decide(double bin_size, const BinSizeLimits& limits) {
+    if (m_pending.empty()) {
+        return bin_size;
+    }
+    // Average this period's records. The first one may carry one-off costs of the last bin size change (such as
+    // growing work arrays), so it is left out if there are enough others.
+    const size_t first = (m_pending.size() >= 3) ? 1 : 0;
+    Sample s = {m_pending.back().bin_size, 0., 0., 0., 0., 0., 0., 0.};
+    for (size_t i = first; i < m_pending.size(); i++) {
+        const CDStatsRecord& rec = m_pending[i];
+        s.num_spheres += rec.num_spheres;
+        s.pairs += rec.num_sph_bin_pairs;
+        s.active += rec.num_active_bins;
+        s.candidates += rec.num_pair_candidates;
+        s.time += rec.cd_time;
+        s.max_sph = std::max(s.max_sph, (double)rec.max_sph_in_bin);
+        s.max_tri = std::max(s.max_tri, (double)rec.max_tri_in_bin);
+    }
+    const double n = (double)(m_pending.size() - first);
+    s.num_spheres /= n;
+    s.pairs /= n;
+    s.active /= n;
+    s.candidates /= n;
+    s.time /= n;
+    m_pending.clear();
+
+    // If the model is far off on this period, what it learned no longer holds (say, the GPU is shared with other work
+    // now), so start over from this period
+    if (m_fitted) {
+        const double pred =
+            m_coeff[0] + m_coeff[1] * s.pairs + m_coeff[2] * s.active + m_coeff[3] * s.candidates;
+        if (std::abs(pred - s.time) > BIN_TUNER_REFIT_TOL * s.time) {
+            m_samples.clear();
+        }
+    }
+    m_samples.push_back(s);
+    if (m_samples.size() > BIN_TUNER_MAX_SAMPLES) {
+        // Drop the oldest period whose bin size was used again later, so the variety of bin sizes is kept
+        size_t drop = 0;
+        for (size_t i = 0; i + 1 < m_samples.size(); i++) {
+            bool repeated = false;
+            for (size_t j = i + 1; j < m_samples.size(); j++) {
+                repeated = repeated || (std::abs(m_samples[i].bin_size - m_samples[j].bin_size) <=
+                                        BIN_TUNER_SAME_SIZE_TOL * m_samples[j].bin_size);
+            }
+            if (repeated) {
+                drop = i;
+                break;
+            }
+        }
+        m_samples.erase(m_samples.begin() + drop);
+    }
+    m_fitted = fit();
+
+    double max_sph, max_tri;
+    auto feasible = [&](double b) {
+        predict(s, b, max_sph, max_tri);
+        return b >= limits.min_bin_size && max_sph <= limits.max_sph_in_bin && max_tri <= limits.max_tri_in_bin;
+    };
+    const bool curr_feasible = feasible(bin_size);
+
+    if (!m_fitted) {
+        // Probe: try a larger bin size, or a smaller one if the larger one looks unsafe
+        const double up = bin_size * (1. + m_probe_rate), down = bin_size / (1. + m_probe_rate);
+        if (feasible(up))
+            return up;
+        if (feasible(down) || !curr_feasible)
+            return std::max(down, limits.min_bin_size);
+        return bin_size;
+    }
+
+    // Search around the current bin size for the cheapest one that respects the limits
+    const double lo = bin_size / m_max_jump, hi = bin_size * m_max_jump;
+    const double curr_time = predict(s, bin_size, max_sph, max_tri);
+    double best_b = bin_size, best_time = DEME_HUGE_FLOAT;
+    for (unsigned int i = 0; i < BIN_TUNER_SEARCH_PTS; i++) {
+        const double b = lo * std::pow(hi / lo, (double)i / (double)(BIN_TUNER_SEARCH_PTS - 1));
+        if (!feasible(b))
+            continue;
+        const double t = predict(s, b, max_sph, max_tri);
+        if (t < best_time) {
+            best_time = t;
+            best_b = b;
+        }
+    }
+    if (best_time >= DEME_HUGE_FLOAT) {
+        // Nothing nearby is within limits: move as far as allowed toward them
+        predict(s, bin_size, max_sph, max_tri);
+        return (bin_size < limits.min_bin_size) ? std::max(hi, limits.min_bin_size) : std::max(lo, limits.min_bin_size);
+    }
+    // Small predicted gains are not worth the change
+    if (curr_feasible && best_time > (1. - m_min_improvement) * curr_time) {
+        return bin_size;
+    }
+    return best_b;
+}
+
+std::unique_ptr<BinSizeTuner> CreateBinSizeTuner(BIN_TUNER_TYPE type, float top_rate, float rate_acc) {
+    switch (type) {
+        case (BIN_TUNER_TYPE::HEURISTIC):
+            return std::make_unique<HeuristicBinSizeTuner>(top_rate, rate_acc);
+        default:
+            return std::make_unique<CostModelBinSizeTuner>();
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Offline replay
+////////////////////////////////////////////////////////////////////////////////
+
+BinSizeReplayResult ReplayBinSizeTuner(BinSizeTuner& tuner,
+                                       const std::vector<CDStatsRecord>& records,
+                                       double init_bin_size,
+                                       size_t num_periods,
+                                       unsigned int steps_per_period,
+                                       const BinSizeLimits& limits) {
+    if (records.empty()) {
+        throw std::runtime_error("Replaying a bin size tuner needs at least one CD statistics record.");
+    }
+    if (init_bin_size <= 0. || steps_per_period == 0) {
+        throw std::runtime_error("Replaying a bin size tuner needs a positive initial bin size and steps per period.");
+    }
+
+    // Average the records of each recorded bin size
+    std::vector<CDStatsRecord> sorted = records;
+    std::sort(sorted.begin(), sorted.end(),
+              [](const CDStatsRecord& a, const CDStatsRecord& b) { return a.bin_size < b.bin_size; });
+    struct Point {
+        double b;
+        double vals[8];
+        size_t n;
+    };
+    std::vector<Point> table;
+    for (const auto& rec : sorted) {
+        const double vals[8] = {(double)rec.num_spheres,    (double)rec.num_sph_bin_pairs, (double)rec.num_active_bins,
+                                (double)rec.max_sph_in_bin, (double)rec.max_tri_in_bin,    rec.num_pair_candidates,
+                                (double)rec.num_contacts,   rec.cd_time};
+        if (table.empty() || rec.bin_size > table.back().b * (1. + 1e-6)) {
+            table.push_back(Point{rec.bin_size, {0., 0., 0., 0., 0., 0., 0., 0.}, 0});
+        }
+        for (unsigned int k = 0; k < 8; k++)
+            table.back().vals[k] += vals[k];
+        table.back().n++;
+    }
+    for (auto& p : table) {
+        for (unsigned int k = 0; k < 8; k++)
+            p.vals[k] /= (double)p.n;
+    }
+
+    // A CD run at bin size b, interpolated in log b
+    auto lookup = [&](double b) {
+        double vals[8];
+        if (b <= table.front().b || table.size() == 1) {
+            std::copy(table.front().vals, table.front().vals + 8, vals);
+        } else if (b >= table.back().b) {
+            std::copy(table.back().vals, table.back().vals + 8, vals);
+        } else {
+            size_t hi = 1;
+            while (table[hi].b < b)
+                hi++;
+            const Point& p0 = table[hi - 1];
+            const Point& p1 = table[hi];
+            const double w = std::log(b / p0.b) / std::log(p1.b / p0.b);
+            for (unsigned int k = 0; k < 8; k++)
+                vals[k] = (1. - w) * p0.vals[k] + w * p1.vals[k];
+        }
+        CDStatsRecord rec;
+        rec.bin_size = b;
+        rec.num_spheres = (size_t)std::llround(vals[0]);
+        rec.num_sph_bin_pairs = (size_t)std::llround(vals[1]);
+        rec.num_active_bins = (size_t)std::llround(vals[2]);
+        rec.max_sph_in_bin = (size_t)std::llround(vals[3]);
+        rec.max_tri_in_bin = (size_t)std::llround(vals[4]);
+        rec.num_pair_candidates = vals[5];
+        rec.num_contacts = (size_t)std::llround(vals[6]);
+        rec.cd_time = vals[7];
+        return rec;
+    };
+
+    BinSizeReplayResult res;
+    res.best_time = DEME_HUGE_FLOAT;
+    for (const auto& p : table) {
+        if (p.vals[7] < res.best_time) {
+            res.best_time = p.vals[7];
+            res.best_bin_size = p.b;
+        }
+    }
+    res.periods_to_converge = num_periods;
+    double b = init_bin_size;
+    for (size_t period = 0; period < num_periods; period++) {
+        const CDStatsRecord rec = lookup(b);
+        for (unsigned int i = 0; i < steps_per_period; i++)
+            tuner.AddRecord(rec);
+        res.bin_sizes.push_back(b);
+        res.cd_times.push_back(rec.cd_time);
+        res.total_time += rec.cd_time * steps_per_period;
+        if (res.periods_to_converge == num_periods && rec.cd_time <= 1.05 * res.best_time) {
+            res.periods_to_converge = period;
+        }
+        b = tuner.Decide(b, limits);
+    }
+    return res;
+}
+
+}  // namespace deme
@@ -0,0 +1,172 @@
+//  Copyright (c) 2021, SBEL GPU Development Team
+//  Copyright (c) 2021, University of Wisconsin - Madison
+//
+//	SPDX-License-Identifier: BSD-3-Clause
+
+#ifndef DEME_BIN_SIZE_TUNER_H
+#define DEME_BIN_SIZE_TUNER_H
+
+#include <istream>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include <DEM/Defines.h>
+
+namespace deme {
+
+/// What one contact detection (CD) run looked like, as far as the bin size is concerned.
+struct CDStatsRecord {
+    // Bin size used
+    double bin_size = 0.;
+    // Number of spheres
+    size_t num_spheres = 0;
+    // Number of sphere--bin touching pairs
+    size_t num_sph_bin_pairs = 0;
+    // Number of bins that have spheres in them
+    size_t num_active_bins = 0;
+    // Max number of spheres (and triangles) found in one bin
+    size_t max_sph_in_bin = 0;
+    size_t max_tri_in_bin = 0;
+    // Number of sphere pairs checked for contact (sum of n * (n - 1) / 2 over active bins)
+    double num_pair_candidates = 0.;
+    // Number of contacts found
+    size_t num_contacts = 0;
+    // Wall time of this CD run, in seconds
+    double cd_time = 0.;
+};
+
+/// Write CD statistics records as CSV, with a header.
+void WriteCDStatsCsv(std::ostream& out, const std::vector<CDStatsRecord>& records);
+/// Read CD statistics records from CSV written by WriteCDStatsCsv.
+std::vector<CDStatsRecord> ReadCDStatsCsv(std::istream& in);
+
+/// Bounds the bin size must respect.
+struct BinSizeLimits {
+    // Smallest bin size allowed (smaller ones give too many bins in the domain)
+    double min_bin_size = 0.;
+    // Max number of spheres and triangles a bin should have (larger bins risk exceeding these)
+    double max_sph_in_bin = DEME_HUGE_FLOAT;
+    double max_tri_in_bin = DEME_HUGE_FLOAT;
+};
+
+/// Strategies of adjusting bin size.
+enum class BIN_TUNER_TYPE { COST_MODEL, HEURISTIC };
+
+/// Base of bin size tuners. Statistics of every CD run are added, and every so often the tuner is asked which bin size
+/// to use next, based on the records added since it was last asked.
+class BinSizeTuner {
+  public:
+    virtual ~BinSizeTuner() {}
+
+    /// Add the statistics of one CD run.
+    void AddRecord(const CDStatsRecord& rec) { m_pending.push_back(rec); }
+    /// Number of records added since the last Decide call.
+    size_t NumPendingRecords() const { return m_pending.size(); }
+    /// Decide the bin size to use next, and clear the pending records.
+    virtual double Decide(double bin_size, const BinSizeLimits& limits) = 0;
+    /// Drop the pending records, as the CD timing is restarted (what was learned is kept).
+    virtual void Restart() { m_pending.clear(); }
+
+  protected:
+    std::vector<CDStatsRecord> m_pending;
+};
+
+/// The original tuner: it accelerates the bin size change in the current direction if the average CD time improved
+/// since last decision, and reverses the direction otherwise.
+class HeuristicBinSizeTuner : public BinSizeTuner {
+  public:
+    /// Max relative change of bin size in one decision, and how much of it the change rate can gain in one decision.
+    HeuristicBinSizeTuner(float top_rate = 0.05, float rate_acc = 0.1) : m_top_rate(top_rate), m_rate_acc(rate_acc) {}
+
+    double Decide(double bin_size, const BinSizeLimits& limits) override;
+    /// Also stops the bin size change.
+    void Restart() override {
+        m_pending.clear();
+        m_curr_rate = 0.;
+        m_prev_time = DEME_HUGE_FLOAT;
+    }
+
+  private:
+    float m_top_rate;
+    float m_rate_acc;
+    float m_curr_rate = 0.;
+    double m_prev_time = DEME_HUGE_FLOAT;
+};
+
+/// Tuner that fits a cost model to the CD runs it saw, and jumps to the bin size the model says is the cheapest.
+/// The CD time is modeled as c0 + c1 * P + c2 * A + c3 * C (P: sphere--bin pairs, A: active bins, C: pair
+/// candidates), with non-negative coefficients fitted over the recent decisions. How P, A and C change with the bin
+/// size follows from the latest records (each sphere touches about (1 + d / b)^3 bins, active bins scale with b^-3,
+/// candidates with A times the squared mean spheres per bin), so a change in packing is picked up right away. Until
+/// two bin sizes have been tried, it probes.
+class CostModelBinSizeTuner : public BinSizeTuner {
+  public:
+    /// Max factor that the bin size can change by in one decision (default 2).
+    void SetMaxJump(double factor) { m_max_jump = (factor > 1.) ? factor : 1.; }
+    /// Relative change of bin size used when probing (default 0.2).
+    void SetProbeRate(double rate) { m_probe_rate = (rate > 0.) ? rate : 0.; }
+    /// The bin size is left alone if the model predicts less than this relative improvement (default 0.02).
+    void SetMinImprovement(double frac) { m_min_improvement = frac; }
+
+    double Decide(double bin_size, const BinSizeLimits& limits) override;
+
+    /// Model coefficients (c0, c1, c2, c3) of the last fit; all zero if no fit was possible.
+    const double* GetCoefficients() const { return m_coeff; }
+
+  private:
+    // One decision's worth of records, averaged
+    struct Sample {
+        double bin_size;
+        double num_spheres;
+        double pairs;
+        double active;
+        double candidates;
+        double max_sph;
+        double max_tri;
+        double time;
+    };
+    std::vector<Sample> m_samples;
+    double m_coeff[4] = {0., 0., 0., 0.};
+    bool m_fitted = false;
+    double m_max_jump = 2.;
+    double m_probe_rate = 0.2;
+    double m_min_improvement = 0.02;
+
+    // Fit the coefficients to m_samples; return false if they do not tell bin sizes apart
+    bool fit();
+    // Predicted CD time (and feature values) at bin size b, scaled from sample s
+    double predict(const Sample& s, double b, double& max_sph, double& max_tri) const;
+};
+
+/// Create a bin size tuner.
+std::unique_ptr<BinSizeTuner> CreateBinSizeTuner(BIN_TUNER_TYPE type, float top_rate = 0.05, float rate_acc = 0.1);
+
+/// Result of replaying a bin size tuner over recorded statistics.
+struct BinSizeReplayResult {
+    // Bin size used, and the (looked-up) average CD time, of each decision period
+    std::vector<double> bin_sizes;
+    std::vector<double> cd_times;
+    // Total CD time over all periods
+    double total_time = 0.;
+    // Recorded bin size with the lowest CD time, and the first period whose CD time is within 5% of that
+    double best_bin_size = 0.;
+    double best_time = 0.;
+    size_t periods_to_converge = 0;
+};
+
+/// Replay a bin size tuner offline, with no GPU. The records (say, from runs at a sweep of bin sizes, see
+/// DEMSolver::GetCDStatsRecord) are grouped by bin size; a CD run at any other bin size is looked up by interpolating
+/// (in log bin size) between the nearest recorded ones, or taking the nearest one beyond their range. The tuner starts
+/// at init_bin_size and runs num_periods decision periods of steps_per_period CD runs each.
+BinSizeReplayResult ReplayBinSizeTuner(BinSizeTuner& tuner,
+                                       const std::vector<CDStatsRecord>& records,
+                                       double init_bin_size,
+                                       size_t num_periods,
+                                       unsigned int steps_per_period = 25,
+                                       const BinSizeLimits& limits = BinSizeLimits());
+
+}  // namespace deme
+
+#endif
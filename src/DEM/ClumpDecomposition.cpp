@@ -0,0 +1,525 @@
+//  Copyright (c) 2021, SBEL GPU Development Team
+//  Copyright (c) 2021, University of Wisconsin - Madison
+//
+//	SPDX-License-Identifier: BSD-3-Clause
+
+#include <DEM/ClumpDecomposition.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <queue>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <utility>
+
+namespace deme {
+
+// Voxel states in the decomposition grid
+static constexpr uint8_t DECOMP_VOXEL_INSIDE = 1;
+static constexpr uint8_t DECOMP_VOXEL_COVERED = 2;
+// Bounds of the parabola intersections in the distance transform
+static constexpr double DECOMP_EDT_BOUNDARY = 1e300;
+// Slack (in voxels) when checking if a candidate sphere is contained in a neighbor's
+static constexpr double DECOMP_CONTAIN_SLACK = 0.25;
+// Candidates re-evaluated together in the greedy sphere selection
+static constexpr size_t DECOMP_GREEDY_BATCH = 64;
+
+namespace {
+
+// Volume, volume centroid and inertia tensor (about the centroid, unit density) of a closed triangle mesh, summed over
+// the tetrahedra each facet forms with the origin
+void meshMassProperties(const DEMMeshConnected& mesh, double& volume, double centroid[3], double inertia[3][3]) {
+    double C[3][3] = {{0., 0., 0.}, {0., 0., 0.}, {0., 0., 0.}};
+    double first[3] = {0., 0., 0.};
+    volume = 0.;
+    for (const auto& f : mesh.m_face_v_indices) {
+        const float3 v[3] = {mesh.m_vertices[f.x], mesh.m_vertices[f.y], mesh.m_vertices[f.z]};
+        double p[3][3];
+        for (int i = 0; i < 3; i++) {
+            p[i][0] = v[i].x;
+            p[i][1] = v[i].y;
+            p[i][2] = v[i].z;
+        }
+        double vol = (p[0][0] * (p[1][1] * p[2][2] - p[1][2] * p[2][1]) -
+                      p[0][1] * (p[1][0] * p[2][2] - p[1][2] * p[2][0]) +
+                      p[0][2] * (p[1][0] * p[2][1] - p[1][1] * p[2][0])) /
+                     6.;
+        double s[3];
+        for (int a = 0; a < 3; a++)
+            s[a] = p[0][a] + p[1][a] + p[2][a];
+        volume += vol;
+        for (int a = 0; a < 3; a++) {
+            first[a] += vol * s[a] / 4.;
+            // Second moment of a tetrahedron with one vertex at the origin: V/20 (sum_i p_i p_i^T + s s^T)
+            for (int b = 0; b < 3; b++) {
+                double pp = p[0][a] * p[0][b] + p[1][a] * p[1][b] + p[2][a] * p[2][b];
+                C[a][b] += vol / 20. * (pp + s[a] * s[b]);
+            }
+        }
+    }
+    // Facets wound inward just flip every signed quantity
+    if (volume < 0.) {
+        volume = -volume;
+        for (int a = 0; a < 3; a++) {
+            first[a] = -first[a];
+            for (int b = 0; b < 3; b++)
+                C[a][b] = -C[a][b];
+        }
+    }
+    for (int a = 0; a < 3; a++)
+        centroid[a] = (volume > 0.) ? first[a] / volume : 0.;
+    // Shift to the centroid, then I = tr(C) Id - C
+    for (int a = 0; a < 3; a++)
+        for (int b = 0; b < 3; b++)
+            C[a][b] -= volume * centroid[a] * centroid[b];
+    double tr = C[0][0] + C[1][1] + C[2][2];
+    for (int a = 0; a < 3; a++)
+        for (int b = 0; b < 3; b++)
+            inertia[a][b] = ((a == b) ? tr : 0.) - C[a][b];
+}
+
+// Jacobi eigen-decomposition of a symmetric 3x3 matrix (destroyed in the process). Eigenvectors are the columns of
+// V, which is made a proper rotation.
+void symmetricEigen3(double A[3][3], double evals[3], double V[3][3]) {
+    for (int a = 0; a < 3; a++)
+        for (int b = 0; b < 3; b++)
+            V[a][b] = (a == b) ? 1. : 0.;
+    const double scale = std::abs(A[0][0]) + std::abs(A[1][1]) + std::abs(A[2][2]) + 1e-300;
+    for (int sweep = 0; sweep < 50; sweep++) {
+        double off = std::abs(A[0][1]) + std::abs(A[0][2]) + std::abs(A[1][2]);
+        if (off < 1e-15 * scale)
+            break;
+        for (int p = 0; p < 2; p++) {
+            for (int q = p + 1; q < 3; q++) {
+                if (std::abs(A[p][q]) < 1e-300)
+                    continue;
+                double theta = (A[q][q] - A[p][p]) / (2. * A[p][q]);
+                double t = ((theta >= 0.) ? 1. : -1.) / (std::abs(theta) + std::sqrt(theta * theta + 1.));
+                double c = 1. / std::sqrt(t * t + 1.);
+                double s = t * c;
+                for (int k = 0; k < 3; k++) {
+                    double akp = A[k][p], akq = A[k][q];
+                    A[k][p] = c * akp - s * akq;
+                    A[k][q] = s * akp + c * akq;
+                }
+                for (int k = 0; k < 3; k++) {
+                    double apk = A[p][k], aqk = A[q][k];
+                    A[p][k] = c * apk - s * aqk;
+                    A[q][k] = s * apk + c * aqk;
+                }
+                for (int k = 0; k < 3; k++) {
+                    double vkp = V[k][p], vkq = V[k][q];
+                    V[k][p] = c * vkp - s * vkq;
+                    V[k][q] = s * vkp + c * vkq;
+                }
+            }
+        }
+    }
+    for (int a = 0; a < 3; a++)
+        evals[a] = A[a][a];
+    double det = V[0][0] * (V[1][1] * V[2][2] - V[1][2] * V[2][1]) - V[0][1] * (V[1][0] * V[2][2] - V[1][2] * V[2][0]) +
+                 V[0][2] * (V[1][0] * V[2][1] - V[1][1] * V[2][0]);
+    if (det < 0.) {
+        for (int k = 0; k < 3; k++)
+            V[k][2] = -V[k][2];
+    }
+}
+
+// Quaternion (x, y, z, w) of a rotation matrix
+float4 quatFromRotMat(const double R[3][3]) {
+    double x, y, z, w;
+    double tr = R[0][0] + R[1][1] + R[2][2];
+    if (tr > 0.) {
+        double s = std::sqrt(tr + 1.) * 2.;
+        w = 0.25 * s;
+        x = (R[2][1] - R[1][2]) / s;
+        y = (R[0][2] - R[2][0]) / s;
+        z = (R[1][0] - R[0][1]) / s;
+    } else if (R[0][0] > R[1][1] && R[0][0] > R[2][2]) {
+        double s = std::sqrt(1. + R[0][0] - R[1][1] - R[2][2]) * 2.;
+        w = (R[2][1] - R[1][2]) / s;
+        x = 0.25 * s;
+        y = (R[0][1] + R[1][0]) / s;
+        z = (R[0][2] + R[2][0]) / s;
+    } else if (R[1][1] > R[2][2]) {
+        double s = std::sqrt(1. + R[1][1] - R[0][0] - R[2][2]) * 2.;
+        w = (R[0][2] - R[2][0]) / s;
+        x = (R[0][1] + R[1][0]) / s;
+        y = 0.25 * s;
+        z = (R[1][2] + R[2][1]) / s;
+    } else {
+        double s = std::sqrt(1. + R[2][2] - R[0][0] - R[1][1]) * 2.;
+        w = (R[1][0] - R[0][1]) / s;
+        x = (R[0][2] + R[2][0]) / s;
+        y = (R[1][2] + R[2][1]) / s;
+        z = 0.25 * s;
+    }
+    double n = std::sqrt(x * x + y * y + z * z + w * w);
+    return make_float4((float)(x / n), (float)(y / n), (float)(z / n), (float)(w / n));
+}
+
+// Every edge of a closed mesh is shared by exactly 2 facets. Meshes often store a separate copy of a node for each
+// facet using it (to give the facets their own normals or UVs), so nodes are welded by position before the check.
+bool isClosedMesh(const DEMMeshConnected& mesh) {
+    const auto& verts = mesh.m_vertices;
+    std::vector<size_t> order(verts.size());
+    for (size_t n = 0; n < order.size(); n++)
+        order[n] = n;
+    auto key = [&](size_t n) { return std::make_tuple(verts[n].x, verts[n].y, verts[n].z); };
+    std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return key(a) < key(b); });
+    std::vector<size_t> weld(verts.size());
+    for (size_t n = 0; n < order.size(); n++)
+        weld[order[n]] = (n > 0 && key(order[n]) == key(order[n - 1])) ? weld[order[n - 1]] : order[n];
+
+    std::vector<std::pair<size_t, size_t>> edges;
+    edges.reserve(mesh.m_face_v_indices.size() * 3);
+    for (const auto& f : mesh.m_face_v_indices) {
+        const size_t v[3] = {weld[f.x], weld[f.y], weld[f.z]};
+        for (int e = 0; e < 3; e++) {
+            size_t a = v[e], b = v[(e + 1) % 3];
+            // A facet with two welded nodes has no area and no edge to share
+            if (a == b)
+                continue;
+            edges.emplace_back(std::min(a, b), std::max(a, b));
+        }
+    }
+    std::sort(edges.begin(), edges.end());
+    size_t i = 0;
+    while (i < edges.size()) {
+        size_t j = i;
+        while (j < edges.size() && edges[j] == edges[i])
+            j++;
+        if (j - i != 2)
+            return false;
+        i = j;
+    }
+    return true;
+}
+
+// Squared distance transform along one line of the grid (Felzenszwalb and Huttenlocher), in place. Values are
+// integers well within double precision, so the arithmetic is exact.
+void edt1D(double* f, size_t n, size_t stride, std::vector<double>& d, std::vector<size_t>& v, std::vector<double>& z) {
+    d.resize(n);
+    v.resize(n);
+    z.resize(n + 1);
+    size_t k = 0;
+    v[0] = 0;
+    z[0] = -DECOMP_EDT_BOUNDARY;
+    z[1] = DECOMP_EDT_BOUNDARY;
+    for (size_t q = 1; q < n; q++) {
+        double s;
+        while (true) {
+            size_t p = v[k];
+            s = ((f[q * stride] + (double)q * q) - (f[p * stride] + (double)p * p)) / (2. * ((double)q - (double)p));
+            if (s > z[k])
+                break;
+            // z[0] is below any s, so this stops at k = 0
+            k--;
+        }
+        k++;
+        v[k] = q;
+        z[k] = s;
+        z[k + 1] = DECOMP_EDT_BOUNDARY;
+    }
+    k = 0;
+    for (size_t q = 0; q < n; q++) {
+        while (z[k + 1] < (double)q)
+            k++;
+        double diff = (double)q - (double)v[k];
+        d[q] = diff * diff + f[v[k] * stride];
+    }
+    for (size_t q = 0; q < n; q++)
+        f[q * stride] = d[q];
+}
+
+}  // namespace
+
+DEMClumpTemplate MeshSphereDecomposer::Decompose(const DEMMeshConnected& mesh,
+                                                 float density,
+                                                 const std::shared_ptr<DEMMaterial>& material) {
+    if (mesh.GetNumTriangles() == 0) {
+        throw std::runtime_error("Sphere decomposition needs a mesh with triangles in it.");
+    }
+    if (!isClosedMesh(mesh)) {
+        throw std::runtime_error(
+            "Sphere decomposition needs a closed mesh (every edge shared by exactly 2 triangles), and the given mesh "
+            "is not.");
+    }
+    if (m_resolution < 2) {
+        throw std::runtime_error("Sphere decomposition resolution needs to be at least 2.");
+    }
+    m_info = SphereDecompositionInfo();
+
+    // Mass properties come from the mesh, not the spheres: the clump stands for the body the mesh bounds
+    double volume, centroid[3], inertia[3][3], moi[3], R[3][3];
+    meshMassProperties(mesh, volume, centroid, inertia);
+    symmetricEigen3(inertia, moi, R);
+    m_info.mesh_volume = volume;
+    m_info.centroid = make_float3((float)centroid[0], (float)centroid[1], (float)centroid[2]);
+    m_info.principal_Q = quatFromRotMat(R);
+
+    // Voxel grid over the bounding box, padded so exterior voxels surround the mesh and protruding spheres fit
+    float3 L = mesh.m_vertices[0], U = mesh.m_vertices[0];
+    for (const auto& v : mesh.m_vertices) {
+        L = make_float3(std::min(L.x, v.x), std::min(L.y, v.y), std::min(L.z, v.z));
+        U = make_float3(std::max(U.x, v.x), std::max(U.y, v.y), std::max(U.z, v.z));
+    }
+    const double ext[3] = {(double)U.x - L.x, (double)U.y - L.y, (double)U.z - L.z};
+    const double h = std::max({ext[0], ext[1], ext[2]}) / (double)m_resolution;
+    if (!(h > 0.)) {
+        throw std::runtime_error("Sphere decomposition got a mesh with zero extent.");
+    }
+    const double surf_tol_vox = std::max(0., (double)m_surf_tol / h);
+    const size_t pad = 1 + (size_t)std::ceil(surf_tol_vox);
+    size_t dims[3];
+    double origin[3];
+    const double lower[3] = {L.x, L.y, L.z};
+    for (int a = 0; a < 3; a++) {
+        dims[a] = (size_t)std::ceil(ext[a] / h) + 2 * pad;
+        origin[a] = lower[a] - (double)pad * h;
+    }
+    const size_t nx = dims[0], ny = dims[1], nz = dims[2];
+    const size_t nVox = nx * ny * nz;
+    auto vox = [&](size_t i, size_t j, size_t k) { return i + nx * (j + ny * k); };
+    std::vector<uint8_t> state(nVox, 0);
+
+    // Inside test by ray parity: a ray along x through each (j, k) row of voxel centers collects the x of every facet
+    // crossing, and voxels between pairs of crossings are inside. The rays are nudged off the voxel centers a little,
+    // so they do not run exactly through mesh edges or nodes.
+    const double nudge_y = 1.31e-4 * h, nudge_z = 0.97e-4 * h;
+    std::vector<std::vector<double>> crossings(ny * nz);
+    for (const auto& f : mesh.m_face_v_indices) {
+        const float3 a = mesh.m_vertices[f.x], b = mesh.m_vertices[f.y], c = mesh.m_vertices[f.z];
+        double ymin = std::min({a.y, b.y, c.y}), ymax = std::max({a.y, b.y, c.y});
+        double zmin = std::min({a.z, b.z, c.z}), zmax = std::max({a.z, b.z, c.z});
+        long j0 = std::max(0L, (long)std::ceil((ymin - nudge_y - origin[1]) / h - 0.5));
+        long j1 = std::min((long)ny - 1, (long)std::floor((ymax - nudge_y - origin[1]) / h - 0.5));
+        long k0 = std::max(0L, (long)std::ceil((zmin - nudge_z - origin[2]) / h - 0.5));
+        long k1 = std::min((long)nz - 1, (long)std::floor((zmax - nudge_z - origin[2]) / h - 0.5));
+        // Facet projected onto the yz plane; skip it if it is edge-on
+        double area = ((double)b.y - a.y) * ((double)c.z - a.z) - ((double)c.y - a.y) * ((double)b.z - a.z);
+        if (std::abs(area) < 1e-300)
+            continue;
+        for (long k = k0; k <= k1; k++) {
+            double z = origin[2] + ((double)k + 0.5) * h + nudge_z;
+            for (long j = j0; j <= j1; j++) {
+                double y = origin[1] + ((double)j + 0.5) * h + nudge_y;
+                double wa = (((double)b.y - y) * ((double)c.z - z) - ((double)c.y - y) * ((double)b.z - z)) / area;
+                double wb = (((double)c.y - y) * ((double)a.z - z) - ((double)a.y - y) * ((double)c.z - z)) / area;
+                double wc = 1. - wa - wb;
+                if (wa < 0. || wb < 0. || wc < 0.)
+                    continue;
+                crossings[j + ny * k].push_back(wa * a.x + wb * b.x + wc * c.x);
+            }
+        }
+    }
+#ifdef DEME_USE_OPENMP
+    #pragma omp parallel for schedule(dynamic, 64)
+#endif
+    for (long row = 0; row < (long)(ny * nz); row++) {
+        auto& xs = crossings[row];
+        std::sort(xs.begin(), xs.end());
+        size_t j = row % ny, k = row / ny;
+        for (size_t p = 0; p + 1 < xs.size(); p += 2) {
+            long i0 = std::max(0L, (long)std::ceil((xs[p] - origin[0]) / h - 0.5));
+            long i1 = std::min((long)nx - 1, (long)std::floor((xs[p + 1] - origin[0]) / h - 0.5));
+            for (long i = i0; i <= i1; i++)
+                state[vox(i, j, k)] = DECOMP_VOXEL_INSIDE;
+        }
+    }
+    size_t nInside = 0;
+    for (size_t n = 0; n < nVox; n++)
+        nInside += (state[n] & DECOMP_VOXEL_INSIDE) ? 1 : 0;
+    if (nInside == 0) {
+        throw std::runtime_error(
+            "Sphere decomposition found no voxel inside the mesh. The mesh may be too thin for the resolution; "
+            "consider increasing it with SetResolution.");
+    }
+
+    // Squared distance (in voxels) from each voxel center to the closest exterior voxel center, one axis at a time
+    // Interior voxels start at a value larger than any squared distance in the grid
+    const double far = (double)(nx * nx + ny * ny + nz * nz) + 1.;
+    std::vector<double> dist(nVox);
+    for (size_t n = 0; n < nVox; n++)
+        dist[n] = (state[n] & DECOMP_VOXEL_INSIDE) ? far : 0.;
+    const size_t line_len[3] = {nx, ny, nz};
+    const size_t strides[3] = {1, nx, nx * ny};
+    for (int axis = 0; axis < 3; axis++) {
+        const size_t nLines = nVox / line_len[axis];
+#ifdef DEME_USE_OPENMP
+    #pragma omp parallel
+#endif
+        {
+            std::vector<double> d, z;
+            std::vector<size_t> v;
+#ifdef DEME_USE_OPENMP
+    #pragma omp for schedule(static)
+#endif
+            for (long line = 0; line < (long)nLines; line++) {
+                // The first voxel of this line
+                size_t first;
+                if (axis == 0) {
+                    first = (size_t)line * nx;
+                } else if (axis == 1) {
+                    first = ((size_t)line % nx) + ((size_t)line / nx) * nx * ny;
+                } else {
+                    first = (size_t)line;
+                }
+                edt1D(dist.data() + first, line_len[axis], strides[axis], d, v, z);
+            }
+        }
+    }
+    // Radius (in voxels) of the inscribed sphere at each voxel: the surface is taken halfway to the exterior voxel
+    for (size_t n = 0; n < nVox; n++)
+        dist[n] = (state[n] & DECOMP_VOXEL_INSIDE) ? std::sqrt(dist[n]) - 0.5 : 0.;
+
+    // Candidates: interior voxels whose inscribed sphere is not contained in that of any neighbor. A quarter voxel of
+    // slack discards the many near-duplicates that the voxelization noise creates.
+    std::vector<size_t> candidates;
+#ifdef DEME_USE_OPENMP
+    #pragma omp parallel
+#endif
+    {
+        std::vector<size_t> my_candidates;
+#ifdef DEME_USE_OPENMP
+    #pragma omp for schedule(static) nowait
+#endif
+        for (long k = 0; k < (long)nz; k++) {
+            for (size_t j = 0; j < ny; j++) {
+                for (size_t i = 0; i < nx; i++) {
+                    size_t n = vox(i, j, k);
+                    if (!(state[n] & DECOMP_VOXEL_INSIDE))
+                        continue;
+                    bool contained = false;
+                    for (int dk = -1; dk <= 1 && !contained; dk++) {
+                        for (int dj = -1; dj <= 1 && !contained; dj++) {
+                            for (int di = -1; di <= 1 && !contained; di++) {
+                                if (di == 0 && dj == 0 && dk == 0)
+                                    continue;
+                                // Interior voxels are never on the grid boundary, so neighbors exist
+                                size_t m = vox(i + di, j + dj, k + dk);
+                                double sep = std::sqrt((double)(di * di + dj * dj + dk * dk));
+                                contained = dist[n] + sep <= dist[m] + DECOMP_CONTAIN_SLACK;
+                            }
+                        }
+                    }
+                    if (!contained)
+                        my_candidates.push_back(n);
+                }
+            }
+        }
+#ifdef DEME_USE_OPENMP
+    #pragma omp critical
+#endif
+        candidates.insert(candidates.end(), my_candidates.begin(), my_candidates.end());
+    }
+    // Keep the outcome independent of the thread schedule
+    std::sort(candidates.begin(), candidates.end());
+
+    // Visit the voxels in the ball of radius R (in voxels) around voxel n, along with their squared distance to n
+    auto forEachInBall = [&](size_t n, double R, auto&& func) {
+        long ci = n % nx, cj = (n / nx) % ny, ck = n / (nx * ny);
+        long r = (long)std::floor(R);
+        for (long k = std::max(0L, ck - r); k <= std::min((long)nz - 1, ck + r); k++) {
+            double dz2 = (double)(k - ck) * (k - ck);
+            for (long j = std::max(0L, cj - r); j <= std::min((long)ny - 1, cj + r); j++) {
+                double djz2 = dz2 + (double)(j - cj) * (j - cj);
+                if (djz2 > R * R)
+                    continue;
+                long w = (long)std::floor(std::sqrt(R * R - djz2));
+                for (long i = std::max(0L, ci - w); i <= std::min((long)nx - 1, ci + w); i++)
+                    func(vox(i, j, k), djz2 + (double)(i - ci) * (i - ci));
+            }
+        }
+    };
+    // The sphere at voxel n, and the reach within which it covers interior voxels: the voxelized surface is only known
+    // to half a voxel, so interior voxels within half a voxel of the sphere count as covered
+    auto sphereRadius = [&](size_t n) { return dist[n] + surf_tol_vox; };
+    auto coverReach = [&](size_t n) { return sphereRadius(n) + 0.5; };
+    auto coverGain = [&](size_t n) {
+        size_t gain = 0;
+        forEachInBall(n, coverReach(n), [&](size_t m, double) {
+            if (state[m] == DECOMP_VOXEL_INSIDE)
+                gain++;
+        });
+        return gain;
+    };
+
+    // Lazy greedy set cover: gains only shrink as spheres are added, so a candidate whose re-evaluated gain still tops
+    // the queue is the best pick. The ball's volume bounds the gain to begin with. The top few candidates are
+    // re-evaluated at a time, in parallel, and the best of them is picked if it beats the bounds of all the rest.
+    std::priority_queue<std::pair<double, size_t>> queue;
+    for (size_t c = 0; c < candidates.size(); c++) {
+        double R = coverReach(candidates[c]) + 1.;
+        queue.emplace(4. / 3. * PI * R * R * R, c);
+    }
+    size_t uncovered = nInside, excess = 0;
+    const double target = std::max(0., (double)m_vol_tol) * (double)nInside;
+    std::vector<size_t> chosen;
+    std::vector<size_t> batch, gains;
+    while ((double)uncovered > target && !queue.empty() && (m_max_spheres == 0 || chosen.size() < m_max_spheres)) {
+        batch.clear();
+        while (!queue.empty() && batch.size() < DECOMP_GREEDY_BATCH) {
+            batch.push_back(queue.top().second);
+            queue.pop();
+        }
+        gains.assign(batch.size(), 0);
+#ifdef DEME_USE_OPENMP
+    #pragma omp parallel for schedule(dynamic, 1)
+#endif
+        for (long b = 0; b < (long)batch.size(); b++)
+            gains[b] = coverGain(candidates[batch[b]]);
+        size_t best = 0;
+        for (size_t b = 1; b < batch.size(); b++) {
+            if (gains[b] > gains[best])
+                best = b;
+        }
+        const bool accept = gains[best] > 0 && (queue.empty() || (double)gains[best] >= queue.top().first);
+        for (size_t b = 0; b < batch.size(); b++) {
+            // Candidates that cover nothing new never will
+            if (gains[b] > 0 && !(accept && b == best))
+                queue.emplace((double)gains[b], batch[b]);
+        }
+        if (!accept)
+            continue;
+        size_t n = candidates[batch[best]];
+        const double R2 = sphereRadius(n) * sphereRadius(n);
+        forEachInBall(n, coverReach(n), [&](size_t m, double d2) {
+            if (state[m] & DECOMP_VOXEL_INSIDE) {
+                state[m] |= DECOMP_VOXEL_COVERED;
+            } else if (d2 <= R2 && !(state[m] & DECOMP_VOXEL_COVERED)) {
+                excess++;
+                state[m] |= DECOMP_VOXEL_COVERED;
+            }
+        });
+        uncovered -= gains[best];
+        chosen.push_back(n);
+    }
+
+    DEMClumpTemplate clump;
+    for (size_t n : chosen) {
+        size_t i = n % nx, j = (n / nx) % ny, k = n / (nx * ny);
+        clump.relPos.push_back(make_float3((float)(origin[0] + ((double)i + 0.5) * h),
+                                           (float)(origin[1] + ((double)j + 0.5) * h),
+                                           (float)(origin[2] + ((double)k + 0.5) * h)));
+        clump.radii.push_back((float)(sphereRadius(n) * h));
+    }
+    clump.nComp = chosen.size();
+    clump.InformCentroidPrincipal(m_info.centroid, m_info.principal_Q);
+    clump.mass = (float)(density * volume);
+    clump.MOI = make_float3((float)(density * moi[0]), (float)(density * moi[1]), (float)(density * moi[2]));
+    clump.volume = (float)volume;
+    if (material) {
+        clump.materials.assign(clump.nComp, material);
+    }
+
+    m_info.num_spheres = clump.nComp;
+    m_info.covered_fraction = 1. - (double)uncovered / (double)nInside;
+    m_info.excess_fraction = (double)excess / (double)nInside;
+    m_info.voxel_size = h;
+    return clump;
+}
+
+}  // namespace deme
@@ -0,0 +1,74 @@
+//  Copyright (c) 2021, SBEL GPU Development Team
+//  Copyright (c) 2021, University of Wisconsin - Madison
+//
+//	SPDX-License-Identifier: BSD-3-Clause
+
+#ifndef DEME_CLUMP_DECOMPOSITION_H
+#define DEME_CLUMP_DECOMPOSITION_H
+
+#include <memory>
+#include <vector>
+
+#include <DEM/Defines.h>
+#include <DEM/Structs.h>
+#include <DEM/BdrsAndObjs.h>
+
+namespace deme {
+
+/// What the last sphere decomposition produced, besides the clump template itself.
+struct SphereDecompositionInfo {
+    // Number of sphere components
+    unsigned int num_spheres = 0;
+    // Volume enclosed by the mesh
+    double mesh_volume = 0.;
+    // Fraction of the mesh's (voxelized) volume covered by the spheres
+    double covered_fraction = 0.;
+    // Volume of the spheres sticking out of the mesh, as a fraction of the mesh volume
+    double excess_fraction = 0.;
+    // Voxel size used
+    double voxel_size = 0.;
+    // Volume centroid and principal frame of the mesh, in the mesh's own frame. The clump template's sphere locations
+    // are expressed in this centroid and principal frame.
+    float3 centroid = make_float3(0);
+    float4 principal_Q = make_float4(0, 0, 0, 1);
+};
+
+/// Approximates a closed triangle mesh with as few spheres as it can, producing a clump template.
+/// The mesh is voxelized and the inscribed sphere at each voxel is found with a distance transform. Voxels whose
+/// inscribed sphere is not contained in a neighbor's (the discrete medial axis) are the candidates, and spheres are
+/// then picked greedily, each time the one covering the most still-uncovered volume, until the uncovered volume is
+/// within tolerance. Mass, MOI, volume and the centroid and principal frame come from the mesh itself.
+class MeshSphereDecomposer {
+  public:
+    /// Fraction of the mesh volume allowed to be left uncovered by the spheres (default 0.05).
+    void SetVolumeTolerance(float frac) { m_vol_tol = frac; }
+    /// Distance the spheres are allowed to stick out of the mesh surface (default 0). A larger value grows each
+    /// sphere by this much, so fewer of them are needed, at the cost of a bumpier and slightly larger shape.
+    void SetSurfaceTolerance(float dist) { m_surf_tol = dist; }
+    /// Number of voxels along the longest side of the mesh's bounding box (default 64). Sphere locations and radii are
+    /// resolved to about one voxel.
+    void SetResolution(unsigned int n) { m_resolution = n; }
+    /// Upper limit on the number of spheres (default 0, meaning no limit). If it is hit, the volume tolerance may not
+    /// be met.
+    void SetMaxSpheres(unsigned int n) { m_max_spheres = n; }
+
+    /// Decompose a closed mesh into a clump template of uniform density. If a material is given, all components use
+    /// it; otherwise it needs to be set on the returned template before it is loaded.
+    DEMClumpTemplate Decompose(const DEMMeshConnected& mesh,
+                               float density,
+                               const std::shared_ptr<DEMMaterial>& material = nullptr);
+
+    /// Info on the last Decompose call.
+    const SphereDecompositionInfo& GetInfo() const { return m_info; }
+
+  private:
+    float m_vol_tol = 0.05;
+    float m_surf_tol = 0.;
+    unsigned int m_resolution = 64;
+    unsigned int m_max_spheres = 0;
+    SphereDecompositionInfo m_info;
+};
+
+}  // namespace deme
+
+#endif
@@ -0,0 +1,458 @@
+//  Copyright (c) 2021, SBEL GPU Development Team
+//  Copyright (c) 2021, University of Wisconsin - Madison
+//
+//	SPDX-License-Identifier: BSD-3-Clause
+
+#include <DEM/ContactAnalytics.h>
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+
+namespace deme {
+
+// Contacts handled by one unit of parallel work; each unit has its own accumulators, merged in order afterwards, so
+// the results do not depend on the thread count
+static constexpr size_t CONTACT_ANALYTICS_CHUNK = 1 << 14;
+// A contact whose |Ft| / (mu |Fn|) is above this is considered sliding
+static constexpr double CONTACT_ANALYTICS_SLIDING_RATIO = 0.99;
+
+namespace {
+
+struct GroupAcc {
+    size_t num_contacts = 0;
+    size_t num_pp_contacts = 0;
+    size_t num_normals = 0;
+    double fabric[9] = {0., 0., 0., 0., 0., 0., 0., 0., 0.};
+    double stress_moment[9] = {0., 0., 0., 0., 0., 0., 0., 0., 0.};
+    double sum_fn = 0.;
+    double sum_mobilized = 0.;
+    size_t num_loaded = 0;
+    size_t num_sliding = 0;
+
+    void merge(const GroupAcc& other) {
+        num_contacts += other.num_contacts;
+        num_pp_contacts += other.num_pp_contacts;
+        num_normals += other.num_normals;
+        for (int k = 0; k < 9; k++) {
+            fabric[k] += other.fabric[k];
+            stress_moment[k] += other.stress_moment[k];
+        }
+        sum_fn += other.sum_fn;
+        sum_mobilized += other.sum_mobilized;
+        num_loaded += other.num_loaded;
+        num_sliding += other.num_sliding;
+    }
+};
+
+inline double3 toDouble3(const float3& v) {
+    return make_double3(v.x, v.y, v.z);
+}
+
+inline double dot3(const double3& a, const double3& b) {
+    return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+// Add f (x) l to a row-major 3x3 tensor
+inline void addOuter(double* T, const double3& f, const double3& l) {
+    const double fv[3] = {f.x, f.y, f.z}, lv[3] = {l.x, l.y, l.z};
+    for (int i = 0; i < 3; i++)
+        for (int j = 0; j < 3; j++)
+            T[i * 3 + j] += fv[i] * lv[j];
+}
+
+inline double alongDir(const float3& p, SPATIAL_DIR dir) {
+    switch (dir) {
+        case SPATIAL_DIR::X:
+            return p.x;
+        case SPATIAL_DIR::Y:
+            return p.y;
+        default:
+            return p.z;
+    }
+}
+
+size_t findRoot(std::vector<size_t>& parent, size_t i) {
+    while (parent[i] != i) {
+        parent[i] = parent[parent[i]];
+        i = parent[i];
+    }
+    return i;
+}
+
+}  // namespace
+
+void ContactNetworkAnalyzer::GroupByFamily() {
+    m_grouping = GROUPING::FAMILY;
+    m_boxes.clear();
+    m_group_volumes.clear();
+}
+
+unsigned int ContactNetworkAnalyzer::AddRegionBox(const float3& L, const float3& U) {
+    if (m_grouping != GROUPING::REGION)
+        m_group_volumes.clear();
+    m_grouping = GROUPING::REGION;
+    m_boxes.push_back({L, U});
+    return (unsigned int)(m_boxes.size() - 1);
+}
+
+void ContactNetworkAnalyzer::GroupAll() {
+    m_grouping = GROUPING::ALL;
+    m_boxes.clear();
+    m_group_volumes.clear();
+}
+
+void ContactNetworkAnalyzer::SetGroupVolume(unsigned int group, double volume) {
+    for (auto& gv : m_group_volumes) {
+        if (gv.first == group) {
+            gv.second = volume;
+            return;
+        }
+    }
+    m_group_volumes.push_back({group, volume});
+}
+
+std::vector<ContactNetworkStats> ContactNetworkAnalyzer::Analyze(ContactInfoContainer& contacts,
+                                                                 const ContactNetworkOwners& owners) const {
+    ContactColumns cnt;
+    if (!contacts.Contains("AOwner")) {
+        throw std::runtime_error(
+            "Contact network analytics needs owner IDs in the contact info. Include OWNER in SetContactOutputContent "
+            "before Initialize().");
+    }
+    cnt.n = contacts.GetAOwner().size();
+    cnt.a_owner = contacts.GetAOwner().data();
+    cnt.b_owner = contacts.GetBOwner().data();
+    cnt.force = contacts.GetForce().data();
+    if (contacts.Contains("Point"))
+        cnt.point = contacts.GetPoint().data();
+    if (contacts.Contains("Normal"))
+        cnt.normal = contacts.GetNormal().data();
+    const std::string& ss_name = contact_type_out_name_map.at(SPHERE_SPHERE_CONTACT);
+    const std::vector<std::string>& types = contacts.GetContactType();
+    cnt.b_is_geo_sphere.resize(cnt.n);
+    for (size_t i = 0; i < cnt.n; i++)
+        cnt.b_is_geo_sphere[i] = (types[i] == ss_name);
+    return analyze(cnt, owners);
+}
+
+std::vector<ContactNetworkStats> ContactNetworkAnalyzer::Analyze(const CompactContactInfo& contacts,
+                                                                 const ContactNetworkOwners& owners) const {
+    ContactColumns cnt;
+    if (!contacts.Contains("AOwner")) {
+        throw std::runtime_error(
+            "Contact network analytics needs owner IDs in the contact info. Include OWNER in SetContactOutputContent "
+            "before Initialize().");
+    }
+    cnt.n = contacts.Size();
+    cnt.a_owner = contacts.Get<bodyID_t>("AOwner").data();
+    cnt.b_owner = contacts.Get<bodyID_t>("BOwner").data();
+    cnt.force = contacts.Get<float3>("Force").data();
+    if (contacts.Contains("Point"))
+        cnt.point = contacts.Get<float3>("Point").data();
+    if (contacts.Contains("Normal"))
+        cnt.normal = contacts.Get<float3>("Normal").data();
+    auto types = contacts.Get<contact_t>("ContactType");
+    cnt.b_is_geo_sphere.resize(cnt.n);
+    for (size_t i = 0; i < cnt.n; i++)
+        cnt.b_is_geo_sphere[i] = (types[i] == SPHERE_SPHERE_CONTACT);
+    return analyze(cnt, owners);
+}
+
+std::vector<ContactNetworkStats> ContactNetworkAnalyzer::analyze(const ContactColumns& cnt,
+                                                                 const ContactNetworkOwners& owners) const {
+    const size_t nOwners = owners.pos.size();
+    if (m_grouping == GROUPING::FAMILY && owners.family.size() < nOwners) {
+        throw std::runtime_error("Grouping contact network analytics by family needs the family of every owner.");
+    }
+    auto isParticle = [&](bodyID_t o) {
+        return o < nOwners && (owners.is_particle.empty() || owners.is_particle[o]);
+    };
+
+    // Assign particles to groups. Group labels are what the results report; group indices are dense.
+    std::vector<unsigned int> labels;
+    std::vector<int> group_of(nOwners, -1);
+    if (m_grouping == GROUPING::ALL) {
+        labels.push_back(0);
+        for (size_t o = 0; o < nOwners; o++)
+            group_of[o] = isParticle(o) ? 0 : -1;
+    } else if (m_grouping == GROUPING::FAMILY) {
+        std::map<unsigned int, int> fam_index;
+        for (size_t o = 0; o < nOwners; o++) {
+            if (isParticle(o))
+                fam_index.emplace(owners.family[o], 0);
+        }
+        for (auto& fi : fam_index) {
+            fi.second = (int)labels.size();
+            labels.push_back(fi.first);
+        }
+        for (size_t o = 0; o < nOwners; o++)
+            group_of[o] = isParticle(o) ? fam_index[owners.family[o]] : -1;
+    } else {
+        for (size_t b = 0; b < m_boxes.size(); b++)
+            labels.push_back((unsigned int)b);
+#ifdef DEME_USE_OPENMP
+    #pragma omp parallel for schedule(static)
+#endif
+        for (long long o = 0; o < (long long)nOwners; o++) {
+            if (!isParticle(o))
+                continue;
+            const float3& p = owners.pos[o];
+            for (size_t b = 0; b < m_boxes.size(); b++) {
+                const float3& L = m_boxes[b].first;
+                const float3& U = m_boxes[b].second;
+                if (p.x >= L.x && p.y >= L.y && p.z >= L.z && p.x <= U.x && p.y <= U.y && p.z <= U.z) {
+                    group_of[o] = (int)b;
+                    break;
+                }
+            }
+        }
+    }
+    const size_t nGroups = labels.size();
+
+    // Contact pass, in parallel over chunks of contacts
+    const size_t nChunks = (cnt.n + CONTACT_ANALYTICS_CHUNK - 1) / CONTACT_ANALYTICS_CHUNK;
+    std::vector<std::vector<GroupAcc>> chunk_acc(nChunks, std::vector<GroupAcc>(nGroups));
+    std::vector<float> normal_force(cnt.n, 0.f);
+#ifdef DEME_USE_OPENMP
+    #pragma omp parallel for schedule(dynamic, 1)
+#endif
+    for (long long ch = 0; ch < (long long)nChunks; ch++) {
+        std::vector<GroupAcc>& acc = chunk_acc[ch];
+        const size_t end = std::min(cnt.n, (size_t)(ch + 1) * CONTACT_ANALYTICS_CHUNK);
+        for (size_t i = (size_t)ch * CONTACT_ANALYTICS_CHUNK; i < end; i++) {
+            const bodyID_t a = cnt.a_owner[i], b = cnt.b_owner[i];
+            const bool b_particle = cnt.b_is_geo_sphere[i] && isParticle(b);
+            const int ga = isParticle(a) ? group_of[a] : -1;
+            const int gb = b_particle ? group_of[b] : -1;
+            if (ga < 0 && gb < 0)
+                continue;
+            const double3 F = toDouble3(cnt.force[i]);
+            const double3 pa = toDouble3(owners.pos[a]);
+            const double3 pb = (b < nOwners) ? toDouble3(owners.pos[b]) : pa;
+
+            // Contact normal
+            double3 n = make_double3(0, 0, 0);
+            if (cnt.normal) {
+                n = toDouble3(cnt.normal[i]);
+            } else if (b_particle) {
+                n = make_double3(pb.x - pa.x, pb.y - pa.y, pb.z - pa.z);
+            } else if (cnt.point) {
+                n = make_double3(cnt.point[i].x - pa.x, cnt.point[i].y - pa.y, cnt.point[i].z - pa.z);
+            }
+            const double n_len = std::sqrt(dot3(n, n));
+            const bool has_normal = n_len > DEME_TINY_FLOAT;
+            if (has_normal)
+                n = make_double3(n.x / n_len, n.y / n_len, n.z / n_len);
+            const double fn_signed = has_normal ? dot3(F, n) : std::sqrt(dot3(F, F));
+            const double fn = std::abs(fn_signed);
+            double ft = 0.;
+            if (has_normal) {
+                const double3 Ft = make_double3(F.x - fn_signed * n.x, F.y - fn_signed * n.y, F.z - fn_signed * n.z);
+                ft = std::sqrt(dot3(Ft, Ft));
+            }
+            normal_force[i] = (float)fn;
+
+            // Contact point, for the stress
+            bool has_point = true;
+            double3 xc;
+            if (cnt.point) {
+                xc = toDouble3(cnt.point[i]);
+            } else if (b_particle) {
+                xc = make_double3(0.5 * (pa.x + pb.x), 0.5 * (pa.y + pb.y), 0.5 * (pa.z + pb.z));
+            } else {
+                has_point = false;
+            }
+
+            for (int side = 0; side < 2; side++) {
+                const int g = side == 0 ? ga : gb;
+                // A contact with both sides in one group counts once, except for the stress
+                if (g < 0)
+                    continue;
+                if (has_point) {
+                    const double3& p = side == 0 ? pa : pb;
+                    const double3 f = side == 0 ? F : make_double3(-F.x, -F.y, -F.z);
+                    addOuter(acc[g].stress_moment, f, make_double3(xc.x - p.x, xc.y - p.y, xc.z - p.z));
+                }
+                if (side == 1 && gb == ga)
+                    continue;
+                GroupAcc& A = acc[g];
+                A.num_contacts++;
+                if (b_particle)
+                    A.num_pp_contacts++;
+                A.sum_fn += fn;
+                if (has_normal) {
+                    A.num_normals++;
+                    addOuter(A.fabric, n, n);
+                }
+                if (has_normal && fn > DEME_TINY_FLOAT && m_mu > 0.f) {
+                    const double ratio = ft / (m_mu * fn);
+                    A.sum_mobilized += ratio;
+                    A.num_loaded++;
+                    if (ratio >= CONTACT_ANALYTICS_SLIDING_RATIO)
+                        A.num_sliding++;
+                }
+            }
+        }
+    }
+    std::vector<GroupAcc> acc(nGroups);
+    for (const auto& ca : chunk_acc)
+        for (size_t g = 0; g < nGroups; g++)
+            acc[g].merge(ca[g]);
+
+    // Per-particle contact counts, and the strong force network, serially (union--find)
+    std::vector<double> mean_fn(nGroups, 0.);
+    for (size_t g = 0; g < nGroups; g++)
+        mean_fn[g] = acc[g].num_contacts > 0 ? acc[g].sum_fn / acc[g].num_contacts : 0.;
+    std::vector<unsigned int> cnt_count(nOwners, 0);
+    std::vector<size_t> parent(nOwners);
+    for (size_t o = 0; o < nOwners; o++)
+        parent[o] = o;
+    std::vector<size_t> num_strong(nGroups, 0);
+    for (size_t i = 0; i < cnt.n; i++) {
+        const bodyID_t a = cnt.a_owner[i], b = cnt.b_owner[i];
+        const bool b_particle = cnt.b_is_geo_sphere[i] && isParticle(b);
+        const int ga = isParticle(a) ? group_of[a] : -1;
+        const int gb = b_particle ? group_of[b] : -1;
+        if (ga >= 0)
+            cnt_count[a]++;
+        if (gb >= 0)
+            cnt_count[b]++;
+        if (!b_particle)
+            continue;
+        const bool strong_a = ga >= 0 && normal_force[i] > m_strong_factor * mean_fn[ga];
+        const bool strong_b = gb >= 0 && normal_force[i] > m_strong_factor * mean_fn[gb];
+        if (strong_a)
+            num_strong[ga]++;
+        if (strong_b && gb != ga)
+            num_strong[gb]++;
+        // Chains are traced within a group
+        if (strong_a && ga == gb) {
+            size_t ra = findRoot(parent, a), rb = findRoot(parent, b);
+            if (ra != rb)
+                parent[std::max(ra, rb)] = std::min(ra, rb);
+        }
+    }
+
+    // Per-group particle statistics and clusters
+    std::vector<ContactNetworkStats> stats(nGroups);
+    std::vector<size_t> num_rattlers(nGroups, 0);
+    std::vector<double> g_min(nGroups, DEME_HUGE_FLOAT), g_max(nGroups, -DEME_HUGE_FLOAT);
+    // Cluster root -> (size, min, max) along the percolation direction
+    std::map<size_t, std::tuple<size_t, double, double>> clusters;
+    for (size_t o = 0; o < nOwners; o++) {
+        const int g = group_of[o];
+        if (g < 0)
+            continue;
+        stats[g].num_particles++;
+        if (cnt_count[o] < 2)
+            num_rattlers[g]++;
+        const double x = alongDir(owners.pos[o], m_perc_dir);
+        g_min[g] = std::min(g_min[g], x);
+        g_max[g] = std::max(g_max[g], x);
+        auto it = clusters.emplace(findRoot(parent, o), std::make_tuple((size_t)0, x, x)).first;
+        std::get<0>(it->second)++;
+        std::get<1>(it->second) = std::min(std::get<1>(it->second), x);
+        std::get<2>(it->second) = std::max(std::get<2>(it->second), x);
+    }
+    for (const auto& [root, cl] : clusters) {
+        const int g = group_of[root];
+        const size_t size = std::get<0>(cl);
+        if (size < 2)
+            continue;
+        stats[g].largest_chain_cluster = std::max(stats[g].largest_chain_cluster, size);
+        const double extent = g_max[g] - g_min[g];
+        if (m_perc_dir != SPATIAL_DIR::NONE && extent > 0. &&
+            std::get<2>(cl) - std::get<1>(cl) >= (1. - m_perc_tol) * extent)
+            stats[g].percolates = true;
+    }
+
+    for (size_t g = 0; g < nGroups; g++) {
+        ContactNetworkStats& s = stats[g];
+        const GroupAcc& A = acc[g];
+        s.group = labels[g];
+        s.num_contacts = A.num_contacts;
+        if (s.num_particles > 0) {
+            s.rattler_fraction = (double)num_rattlers[g] / s.num_particles;
+        }
+        for (int k = 0; k < 9; k++) {
+            s.fabric[k] = A.num_normals > 0 ? A.fabric[k] / A.num_normals : 0.;
+            s.stress_moment[k] = A.stress_moment[k];
+        }
+        if (m_grouping == GROUPING::REGION) {
+            const float3& L = m_boxes[g].first;
+            const float3& U = m_boxes[g].second;
+            s.volume = (double)(U.x - L.x) * (U.y - L.y) * (U.z - L.z);
+        }
+        for (const auto& gv : m_group_volumes) {
+            if (gv.first == s.group)
+                s.volume = gv.second;
+        }
+        if (s.volume > 0.) {
+            for (int k = 0; k < 9; k++)
+                s.stress[k] = s.stress_moment[k] / s.volume;
+            s.pressure = -(s.stress[0] + s.stress[4] + s.stress[8]) / 3.;
+        }
+        s.mean_normal_force = mean_fn[g];
+        if (A.num_loaded > 0) {
+            s.mobilized_friction = A.sum_mobilized / A.num_loaded;
+            s.sliding_fraction = (double)A.num_sliding / A.num_loaded;
+        }
+        if (A.num_pp_contacts > 0)
+            s.strong_contact_fraction = (double)num_strong[g] / A.num_pp_contacts;
+    }
+    // Coordination number counts contact ends on this group's particles
+    std::vector<size_t> num_ends(nGroups, 0);
+    for (size_t o = 0; o < nOwners; o++) {
+        if (group_of[o] >= 0)
+            num_ends[group_of[o]] += cnt_count[o];
+    }
+    for (size_t g = 0; g < nGroups; g++) {
+        if (stats[g].num_particles > 0)
+            stats[g].coordination_number = (double)num_ends[g] / stats[g].num_particles;
+    }
+    return stats;
+}
+
+void ContactNetworkAnalyzer::WriteCsv(std::ostream& out,
+                                      const std::vector<ContactNetworkStats>& stats,
+                                      double time,
+                                      bool write_header) {
+    static const char* comp[9] = {"xx", "xy", "xz", "yx", "yy", "yz", "zx", "zy", "zz"};
+    // Without a volume there is no stress, and zeros would read as a stress-free packing
+    const bool has_stress =
+        std::any_of(stats.begin(), stats.end(), [](const ContactNetworkStats& s) { return s.volume > 0.; });
+    if (write_header) {
+        out << "time,group,num_particles,num_contacts,coordination_number,rattler_fraction";
+        for (const char* c : comp)
+            out << ",fabric_" << c;
+        if (has_stress) {
+            for (const char* c : comp)
+                out << ",stress_" << c;
+            out << ",pressure";
+        }
+        out << ",mean_normal_force,mobilized_friction,sliding_fraction,strong_contact_fraction,"
+               "largest_chain_cluster,percolates\n";
+    }
+    for (const auto& s : stats) {
+        out << time << "," << s.group << "," << s.num_particles << "," << s.num_contacts << ","
+            << s.coordination_number << "," << s.rattler_fraction;
+        for (int k = 0; k < 9; k++)
+            out << "," << s.fabric[k];
+        if (has_stress && s.volume > 0.) {
+            for (int k = 0; k < 9; k++)
+                out << "," << s.stress[k];
+            out << "," << s.pressure;
+        } else if (has_stress) {
+            out << std::string(10, ',');
+        }
+        out << "," << s.mean_normal_force << "," << s.mobilized_friction << ","
+            << s.sliding_fraction << "," << s.strong_contact_fraction << "," << s.largest_chain_cluster << ","
+            << (s.percolates ? 1 : 0) << "\n";
+    }
+}
+
+}  // namespace deme
@@ -0,0 +1,134 @@
+//  Copyright (c) 2021, SBEL GPU Development Team
+//  Copyright (c) 2021, University of Wisconsin - Madison
+//
+//	SPDX-License-Identifier: BSD-3-Clause
+
+#ifndef DEME_CONTACT_ANALYTICS_H
+#define DEME_CONTACT_ANALYTICS_H
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include <DEM/Defines.h>
+#include <DEM/Structs.h>
+
+namespace deme {
+
+/// Per-owner info the contact network analytics need, all indexed by owner ID.
+struct ContactNetworkOwners {
+    // CoM of each owner
+    std::vector<float3> pos;
+    // Family number of each owner; only needed when grouping by family
+    std::vector<unsigned int> family;
+    // Whether each owner is a particle (a clump), as opposed to a boundary (mesh or analytical object). Empty means
+    // all owners are particles.
+    std::vector<bool> is_particle;
+};
+
+/// Contact network statistics of one group of particles (a region, a family, or the whole domain).
+struct ContactNetworkStats {
+    // Region index, family number, or 0 for the whole domain
+    unsigned int group = 0;
+    // Particles in this group, and contacts touching at least one of them
+    size_t num_particles = 0;
+    size_t num_contacts = 0;
+    // Average number of contacts per particle (boundary contacts included)
+    double coordination_number = 0.;
+    // Fraction of particles with fewer than 2 contacts
+    double rattler_fraction = 0.;
+    // Fabric tensor, (1/Nc) sum of n (x) n over the contacts whose normal is known, row-major
+    double fabric[9] = {0., 0., 0., 0., 0., 0., 0., 0., 0.};
+    // Sum over particles and their contacts of f (x) (x_c - x_p), row-major; divided by volume, it is the mean
+    // (Love--Weber) stress tensor, tension positive
+    double stress_moment[9] = {0., 0., 0., 0., 0., 0., 0., 0., 0.};
+    // Volume used for the stress (what SetGroupVolume sets, else the region box volume, else 0), and the resulting
+    // stress, left at 0 if there is no volume
+    double volume = 0.;
+    double stress[9] = {0., 0., 0., 0., 0., 0., 0., 0., 0.};
+    // Mean pressure, -trace(stress)/3, so compression positive
+    double pressure = 0.;
+    // Mean normal contact force magnitude
+    double mean_normal_force = 0.;
+    // Mean of |Ft| / (mu |Fn|) over the contacts, and the fraction of contacts that are (nearly) sliding
+    double mobilized_friction = 0.;
+    double sliding_fraction = 0.;
+    // Fraction of particle--particle contacts carrying a normal force above strong_force_factor times the mean
+    double strong_contact_fraction = 0.;
+    // Particles in the largest cluster connected by strong contacts, and whether a strong cluster spans the group
+    size_t largest_chain_cluster = 0;
+    bool percolates = false;
+};
+
+/// Host-side analytics of the contact network: coordination number, fabric tensor, mean stress, mobilized friction and
+/// force-chain percolation, per region or per family. It works on one contact snapshot (GetContactDetailedInfo or its
+/// compact flavor) plus owner positions, in parallel, and produces a few numbers per group, so contact pairs need not
+/// be written out just to get these quantities.
+/// Contacts need the OWNER output content. NORMAL and CNT_POINT are used if present: without NORMAL, the normal is
+/// taken along the branch vector (or toward the contact point for boundary contacts); without CNT_POINT, the contact
+/// point of a particle--particle contact is taken as the midpoint of the branch vector, and boundary contacts add no
+/// stress.
+class ContactNetworkAnalyzer {
+  public:
+    /// Friction coefficient that mobilized friction is measured against.
+    void SetFrictionCoefficient(float mu) { m_mu = mu; }
+    /// A contact is strong (part of a force chain) if its normal force is larger than factor times the group's mean.
+    void SetStrongForceFactor(float factor) { m_strong_factor = factor; }
+    /// Direction along which force-chain percolation is checked. A strong cluster percolates if its extent along this
+    /// direction covers at least (1 - tolerance) of the group's extent.
+    void SetPercolationDirection(SPATIAL_DIR dir, float tolerance = 0.1) {
+        m_perc_dir = dir;
+        m_perc_tol = tolerance;
+    }
+
+    /// Group particles by family number. Clears the volumes set with SetGroupVolume.
+    void GroupByFamily();
+    /// Group particles by boxes. A particle belongs to the first added box containing its CoM; particles in no box are
+    /// left out. Returns the index of this region. Switching to region grouping clears the volumes set with
+    /// SetGroupVolume.
+    unsigned int AddRegionBox(const float3& L, const float3& U);
+    /// Treat all particles as one group (the default). Clears the volumes set with SetGroupVolume.
+    void GroupAll();
+    /// Set the volume used to turn a group's stress moment into a stress. The group is what the results report: the
+    /// family number, the region index, or 0 when all particles are one group. A region's volume defaults to that of
+    /// its box; other groups have no volume, hence no stress, unless it is set. Call it after choosing the grouping.
+    void SetGroupVolume(unsigned int group, double volume);
+
+    /// Analyze one contact snapshot.
+    std::vector<ContactNetworkStats> Analyze(ContactInfoContainer& contacts, const ContactNetworkOwners& owners) const;
+    std::vector<ContactNetworkStats> Analyze(const CompactContactInfo& contacts,
+                                             const ContactNetworkOwners& owners) const;
+
+    /// Write results as CSV rows (one per group), prefixed with a time column. Header is written if asked. The stress
+    /// and pressure columns are only there if some group has a volume, and are empty for the groups that do not.
+    static void WriteCsv(std::ostream& out,
+                         const std::vector<ContactNetworkStats>& stats,
+                         double time,
+                         bool write_header = true);
+
+  private:
+    enum class GROUPING { ALL, FAMILY, REGION };
+    GROUPING m_grouping = GROUPING::ALL;
+    std::vector<std::pair<float3, float3>> m_boxes;
+    std::vector<std::pair<unsigned int, double>> m_group_volumes;
+    float m_mu = 0.5;
+    float m_strong_factor = 1.;
+    SPATIAL_DIR m_perc_dir = SPATIAL_DIR::Z;
+    float m_perc_tol = 0.1;
+
+    // Contact columns, resolved from either container
+    struct ContactColumns {
+        size_t n = 0;
+        std::vector<bool> b_is_geo_sphere;
+        const bodyID_t* a_owner = nullptr;
+        const bodyID_t* b_owner = nullptr;
+        const float3* force = nullptr;
+        const float3* point = nullptr;
+        const float3* normal = nullptr;
+    };
+    std::vector<ContactNetworkStats> analyze(const ContactColumns& cnt, const ContactNetworkOwners& owners) const;
+};
+
+}  // namespace deme
+
+#endif
@@ -52,7 +52,12 @@ constexpr int64_t MAX_SUBVOXEL = (int64_t)1 << VOXEL_RES_POWER2;
 
 #define DEME_NUM_TRIANGLE_PER_BLOCK 512
 #define DEME_MAX_THREADS_PER_BLOCK 1024
+// Block size of the (shared memory-based) net contact wrench reduction; must be a power of 2
+#define DEME_WRENCH_REDUCE_NTHREADS 256
 #define DEME_INIT_CNT_MULTIPLIER 1
+// When UpdateClumps outgrows the entity arrays, they are made this many times larger than what was there before, so
+// adding a few clumps at a time only reallocates every so often
+#define DEME_ENTITY_ARRAY_GROWTH_FACTOR 1.5
 // If there are more than this number of analytical geometry, we may have difficulty jitify them all
 #define DEME_THRESHOLD_TOO_MANY_ANAL_GEO 64
 // If a clump has more than this number of sphere components, it is automatically considered a non-jitifiable big clump
@@ -122,6 +127,8 @@ constexpr unsigned int THRESHOLD_CANT_JITIFY_ALL_COMP =
     DEME_MIN(DEME_MIN(RESERVED_CLUMP_COMPONENT_OFFSET, DEME_THRESHOLD_BIG_CLUMP), DEME_THRESHOLD_TOO_MANY_SPHERE_COMP);
 // Max size change the bin auto-adjust algorithm can apply to the bin size per step
 constexpr float BIN_SIZE_MAX_CHANGE_RATE = 0.2;
+// Max number of records the adaptive time stepper keeps in its step size history; the oldest ones are dropped first
+constexpr size_t TS_HISTORY_MAX_RECORDS = 10000;
 
 // Device version of getting geo owner ID
 #define DEME_GET_GEO_OWNER_ID(geoB, type)                                 \
@@ -181,6 +188,17 @@ enum CNT_OUTPUT_CONTENT {
     GEO_ID = 128,
     NICKNAME = 256
 };
+// The owner states a StateSnapshot gathers. In a snapshot, each owner's record holds the requested states in this
+// order, packed as floats.
+enum SNAPSHOT_CONTENT {
+    SNAP_POS = 1,       // 3 floats, CoM position
+    SNAP_ORI_Q = 2,     // 4 floats, quaternion as (x, y, z, w)
+    SNAP_VEL = 4,       // 3 floats, linear velocity
+    SNAP_ANG_VEL = 8,   // 3 floats, angular velocity in local frame
+    SNAP_ACC = 16,      // 3 floats, contact-induced acceleration
+    SNAP_ANG_ACC = 32,  // 3 floats, contact-induced angular acceleration in local frame
+    SNAP_FAMILY = 64    // 1 float, the family number (exactly representable)
+};
 
 // =============================================================================
 // NOW DEFINING SOME GPU-SIDE DATA STRUCTURES
@@ -402,6 +420,19 @@ struct DEMDataKT {
     float3* relPosNode2;
     float3* relPosNode3;
 
+    // Analytical entity info. CD kernels have them jitified; only the host CD uses these.
+    objType_t* typeEntity;
+    float* normalEntity;
+    float* relPosEntityX;
+    float* relPosEntityY;
+    float* relPosEntityZ;
+    float* oriEntityX;
+    float* oriEntityY;
+    float* oriEntityZ;
+    float* sizeEntity1;
+    float* sizeEntity2;
+    float* sizeEntity3;
+
     // kT produces contact info, and stores it, temporarily
     bodyID_t* idGeometryA;
     bodyID_t* idGeometryB;
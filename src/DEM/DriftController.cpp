@@ -0,0 +1,204 @@
+//  Copyright (c) 2021, SBEL GPU Development Team
+//  Copyright (c) 2021, University of Wisconsin - Madison
+//
+//	SPDX-License-Identifier: BSD-3-Clause
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+#include <DEM/DriftController.h>
+
+namespace deme {
+
+////////////////////////////////////////////////////////////////////////////////
+// The original controller
+////////////////////////////////////////////////////////////////////////////////
+
+void StepCountDriftController::AddUpdate(double cd_latency) {
+    m_num_updates++;
+    m_state.num_updates++;
+}
+
+unsigned int StepCountDriftController::AddWait(double wait_time, unsigned int current_drift) {
+    m_state.num_waits++;
+    m_state.wait_time += wait_time;
+    // If dT waits, it is penalized, since waiting means double-wait, very bad.
+    m_state.drift = current_drift + FUTURE_DRIFT_TWEAK_STEP_SIZE;
+    return m_state.drift;
+}
+
+unsigned int StepCountDriftController::Decide(const DriftInputs& in) {
+    unsigned int drift = in.current_drift;
+    if (m_num_updates > NUM_STEPS_RESERVED_AFTER_RENEWING_FREQ_TUNER) {
+        // * 2 because double update freq is an ideal future drift
+        m_state.steps_per_update = (double)m_num_steps / m_num_updates;
+        unsigned int comfortable_drift = (unsigned int)(m_state.steps_per_update * 2);
+        if (m_num_updates >= m_cache_size) {
+            m_num_steps = 0;
+            m_num_updates = 0;
+        }
+        // If the drift needs to increase, then the following value much = drift.
+        comfortable_drift = (float)comfortable_drift * m_multiple_of_avg + m_more_than_avg;
+        m_state.balanced_drift = comfortable_drift;
+        if (drift > comfortable_drift) {
+            drift -= FUTURE_DRIFT_TWEAK_STEP_SIZE;
+        } else if (drift < comfortable_drift) {
+            drift += FUTURE_DRIFT_TWEAK_STEP_SIZE;
+        }
+        drift = std::min(drift, in.upper_bound);
+    }
+    m_state.drift = drift;
+    return drift;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// The predictive controller
+////////////////////////////////////////////////////////////////////////////////
+
+void PredictiveDriftController::AddStep(double step_time) {
+    m_step_sum += step_time;
+    m_step_count++;
+}
+
+void PredictiveDriftController::AddUpdate(double cd_latency) {
+    if (cd_latency >= 0.) {
+        if (m_num_trips == 0) {
+            m_state.cd_latency = cd_latency;
+            m_cd_var = 0.;
+        } else {
+            const double diff = cd_latency - m_state.cd_latency;
+            m_state.cd_latency += m_alpha * diff;
+            m_cd_var = (1. - m_alpha) * (m_cd_var + m_alpha * diff * diff);
+        }
+        m_state.cd_latency_std = std::sqrt(m_cd_var);
+        m_num_trips++;
+    }
+    // Fold the steps since the last update into the step time and steps per update
+    if (m_step_count > 0) {
+        const double step_latency = m_step_sum / m_step_count;
+        const bool first = (m_state.step_latency <= 0.);
+        m_state.step_latency =
+            first ? step_latency : m_state.step_latency + m_alpha * (step_latency - m_state.step_latency);
+        m_state.steps_per_update =
+            first ? m_step_count : m_state.steps_per_update + m_alpha * (m_step_count - m_state.steps_per_update);
+    }
+    m_step_sum = 0.;
+    m_step_count = 0;
+    m_state.num_updates++;
+}
+
+unsigned int PredictiveDriftController::AddWait(double wait_time, unsigned int current_drift) {
+    // dT should not have to wait at all, so the round trip varies more than thought; the next Decide accounts for it
+    m_cd_var += m_alpha * wait_time * wait_time;
+    m_state.cd_latency_std = std::sqrt(m_cd_var);
+    m_state.num_waits++;
+    m_state.wait_time += wait_time;
+    return current_drift;
+}
+
+unsigned int PredictiveDriftController::Decide(const DriftInputs& in) {
+    // Too little is known before a couple of updates; keep what is used
+    if (m_num_trips < 2 || m_state.step_latency <= 0.) {
+        m_state.drift = std::min(in.current_drift, in.upper_bound);
+        return m_state.drift;
+    }
+    // Round trip, and its std dev, in dT steps
+    const double trip = m_state.cd_latency / m_state.step_latency;
+    const double trip_std = m_state.cd_latency_std / m_state.step_latency;
+    // The update built on a work order is used until the next one arrives, one round trip after the first arrived
+    m_state.balanced_drift = 2. * trip;
+    // Cover the spread of those two round trips, plus one step as dT only checks between steps
+    double safety = m_jitter_factor * std::sqrt(2.) * trip_std + 1.;
+    // ...but not at the cost of a much larger contact margin
+    if (in.margin_per_step > 0. && in.ref_size > 0.) {
+        const double affordable = m_margin_budget * in.ref_size / in.margin_per_step;
+        safety = std::min(safety, std::max(affordable, 1.));
+    }
+    m_state.safety_steps = safety;
+    const double drift = std::ceil(m_state.balanced_drift + safety);
+    m_state.drift = (drift < (double)in.upper_bound) ? (unsigned int)drift : in.upper_bound;
+    return m_state.drift;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Synthetic two-thread model
+////////////////////////////////////////////////////////////////////////////////
+
+DriftSimResult SimulateDriftController(FutureDriftController& ctrl, const DriftSimParams& params) {
+    std::mt19937 gen(params.seed);
+    std::normal_distribution<double> normal(0., 1.);
+    // A time around the mean, never below a tenth of it
+    auto draw = [&](double mean, double rel_std) { return mean * std::max(1. + rel_std * normal(gen), 0.1); };
+    // Step and CD times grow with the contact margin
+    auto cost_factor = [&](unsigned int drift) {
+        const double margin = drift * params.margin_per_step;
+        return (params.ref_size > 0.) ? 1. + params.margin_cost * margin / params.ref_size : 1.;
+    };
+
+    DriftSimResult res;
+    DriftInputs in;
+    in.upper_bound = params.upper_bound;
+    in.margin_per_step = params.margin_per_step;
+    in.ref_size = params.ref_size;
+
+    double t = 0.;
+    long long stamp = 0;
+    // The drift new work orders are sent with (the solver's perhapsIdealFutureDrift)
+    unsigned int ideal_drift = params.init_drift;
+    // The work order kT is on: the stamp and drift it was sent with, when it was sent and when kT is done with it
+    long long order_stamp = 0;
+    unsigned int order_drift = ideal_drift;
+    double order_sent = 0.;
+    double order_done = draw(params.cd_time, params.cd_time_jitter) * cost_factor(order_drift);
+    // Like the solver, the first work order has no round trip to report
+    ctrl.AddUpdate(-1.);
+    // The update in use
+    long long update_stamp = 0;
+    unsigned int update_drift = ideal_drift;
+    // Like the solver, dT waits for the first update before it starts
+    t = order_done;
+    double drift_sum = 0., margin_sum = 0.;
+
+    for (size_t step = 0; step < params.num_steps; step++) {
+        // If the update is in, use it, decide the drift and send a new work order, in the solver's order
+        if (order_done <= t) {
+            update_stamp = order_stamp;
+            update_drift = order_drift;
+            const double cd_latency = t - order_sent;
+            res.num_updates++;
+            drift_sum += update_drift;
+            margin_sum += update_drift * params.margin_per_step;
+
+            in.current_drift = ideal_drift;
+            ideal_drift = ctrl.Decide(in);
+            order_drift = ideal_drift;
+            order_stamp = stamp;
+            order_sent = t;
+            order_done = t + draw(params.cd_time, params.cd_time_jitter) * cost_factor(order_drift);
+            ctrl.AddUpdate(cd_latency);
+        }
+        // Wait if too far ahead
+        if (stamp > update_stamp + (long long)update_drift) {
+            const double wait = std::max(order_done - t, 0.);
+            ideal_drift = ctrl.AddWait(wait, ideal_drift);
+            res.num_waits++;
+            res.wait_time += wait;
+            t += wait;
+        }
+        const double step_time = draw(params.step_time, params.step_time_jitter) * cost_factor(update_drift);
+        t += step_time;
+        ctrl.AddStep(step_time);
+        stamp++;
+    }
+
+    res.total_time = t;
+    res.steps_per_second = (t > 0.) ? params.num_steps / t : 0.;
+    if (res.num_updates > 0) {
+        res.avg_drift = drift_sum / res.num_updates;
+        res.avg_margin = margin_sum / res.num_updates;
+    }
+    return res;
+}
+
+}  // namespace deme
@@ -0,0 +1,182 @@
+//  Copyright (c) 2021, SBEL GPU Development Team
+//  Copyright (c) 2021, University of Wisconsin - Madison
+//
+//	SPDX-License-Identifier: BSD-3-Clause
+
+#ifndef DEME_DRIFT_CONTROLLER_H
+#define DEME_DRIFT_CONTROLLER_H
+
+#include <cstddef>
+
+#include <DEM/Defines.h>
+
+namespace deme {
+
+/// Strategies of adjusting the future drift (how many steps dT may run ahead of the state kT's contact pairs are
+/// built on), which sets the CD update frequency.
+enum class DRIFT_CTRL_TYPE { STEP_COUNT, PREDICTIVE };
+
+/// What a drift controller is told when it decides.
+struct DriftInputs {
+    // Drift in use now, and the max drift allowed
+    unsigned int current_drift = 0;
+    unsigned int upper_bound = 200;
+    // Contact margin added by each step of drift: (max vel * expand safety multiplier + adder) * step size
+    double margin_per_step = 0.;
+    // Length the contact margin is judged against (the smallest sphere radius)
+    double ref_size = 0.;
+};
+
+/// Internal state of a drift controller, for tuning. Latencies are wall times in seconds.
+struct DriftControllerState {
+    // Smoothed latency of a CD round trip (dT sending a work order to it receiving the result), and its std dev
+    double cd_latency = 0.;
+    double cd_latency_std = 0.;
+    // Smoothed time of one dT step, waiting excluded
+    double step_latency = 0.;
+    // dT steps taken per kT update
+    double steps_per_update = 0.;
+    // Drift that keeps both threads busy, and the extra steps added on top for safety
+    double balanced_drift = 0.;
+    double safety_steps = 0.;
+    // Drift last decided
+    unsigned int drift = 0;
+    // Number of kT updates and dT waits seen, and the total time dT waited
+    size_t num_updates = 0;
+    size_t num_waits = 0;
+    double wait_time = 0.;
+};
+
+/// Base of drift controllers. dT reports its steps, the kT updates it receives and the times it has to wait for kT,
+/// and asks for the drift to send with each new work order.
+class FutureDriftController {
+  public:
+    virtual ~FutureDriftController() {}
+
+    /// dT finished a step that took step_time (waiting excluded).
+    virtual void AddStep(double step_time) = 0;
+    /// dT sent kT a work order (having taken in the previous update, if any). cd_latency is the round trip of that
+    /// update, from its own work order being sent to it being received; negative if it was not measured.
+    virtual void AddUpdate(double cd_latency) = 0;
+    /// dT had to wait wait_time for kT. Return the drift to use from now on (current_drift is the one in use).
+    virtual unsigned int AddWait(double wait_time, unsigned int current_drift) = 0;
+    /// Decide the drift to send with the next work order.
+    virtual unsigned int Decide(const DriftInputs& in) = 0;
+    /// A new user call starts, so counts in progress are dropped.
+    virtual void Restart() {}
+    /// Whether Decide makes use of DriftInputs::margin_per_step (which needs the system max velocity).
+    virtual bool UsesMargin() const { return false; }
+
+    const DriftControllerState& GetState() const { return m_state; }
+
+  protected:
+    DriftControllerState m_state;
+};
+
+/// The original controller: the drift is nudged by FUTURE_DRIFT_TWEAK_STEP_SIZE toward (a multiple of, plus some)
+/// twice the average number of dT steps per kT update, and up by the same amount each time dT waits.
+class StepCountDriftController : public FutureDriftController {
+  public:
+    StepCountDriftController(float multiple_of_avg = 1.1, float more_than_avg = 4., unsigned int cache_size = 200)
+        : m_multiple_of_avg(multiple_of_avg), m_more_than_avg(more_than_avg), m_cache_size(cache_size) {}
+
+    void AddStep(double step_time) override { m_num_steps++; }
+    void AddUpdate(double cd_latency) override;
+    /// The drift goes up by FUTURE_DRIFT_TWEAK_STEP_SIZE right away.
+    unsigned int AddWait(double wait_time, unsigned int current_drift) override;
+    unsigned int Decide(const DriftInputs& in) override;
+    void Restart() override {
+        m_num_steps = 0;
+        m_num_updates = 0;
+    }
+
+  private:
+    float m_multiple_of_avg;
+    float m_more_than_avg;
+    unsigned int m_cache_size;
+    unsigned int m_num_steps = 0;
+    unsigned int m_num_updates = 0;
+};
+
+/// Controller that predicts the drift from measured latencies. Each kT update is built on the state dT had when it sent
+/// the work order, and it is used until the next update arrives, one more CD round trip later. So dT never has to wait
+/// if the drift covers two round trips' worth of dT steps. Both latencies are tracked with exponential moving averages
+/// (the round trip's spread too), and the drift is set to 2 * (round trip / step time), plus safety steps covering
+/// jitter_factor std devs of the two round trips. Every step of drift grows the contact margin, so the safety steps
+/// are capped to what adds no more than margin_budget * the smallest sphere radius to the margin. A wait is taken as
+/// a sign that the spread was underestimated.
+class PredictiveDriftController : public FutureDriftController {
+  public:
+    /// Weight of the newest measurement in the moving averages, (0, 1] (default 0.2).
+    void SetSmoothing(double alpha) { m_alpha = (alpha > 0. && alpha <= 1.) ? alpha : 1.; }
+    /// Std devs of the CD round trip the safety steps cover (default 1.5).
+    void SetJitterFactor(double z) { m_jitter_factor = (z > 0.) ? z : 0.; }
+    /// Most margin the safety steps may add, as a fraction of the smallest sphere radius (default 0.5).
+    void SetMarginBudget(double frac) { m_margin_budget = (frac > 0.) ? frac : 0.; }
+
+    void AddStep(double step_time) override;
+    void AddUpdate(double cd_latency) override;
+    unsigned int AddWait(double wait_time, unsigned int current_drift) override;
+    unsigned int Decide(const DriftInputs& in) override;
+    void Restart() override {
+        m_step_sum = 0.;
+        m_step_count = 0;
+    }
+    bool UsesMargin() const override { return true; }
+
+  private:
+    double m_alpha = 0.2;
+    double m_jitter_factor = 1.5;
+    double m_margin_budget = 0.5;
+    // Variance of the round trip, and the number of round trips measured
+    double m_cd_var = 0.;
+    size_t m_num_trips = 0;
+    // Steps since the last update
+    double m_step_sum = 0.;
+    size_t m_step_count = 0;
+};
+
+/// Result of running a drift controller on the synthetic two-thread model.
+struct DriftSimResult {
+    // Wall time to finish all steps, and the steps per second that makes
+    double total_time = 0.;
+    double steps_per_second = 0.;
+    // Number of times and total time dT waited for kT
+    size_t num_waits = 0;
+    double wait_time = 0.;
+    // Number of kT updates, and the average drift and contact margin over them
+    size_t num_updates = 0;
+    double avg_drift = 0.;
+    double avg_margin = 0.;
+};
+
+/// Settings of the synthetic two-thread model. Times are in seconds.
+struct DriftSimParams {
+    // Num of dT steps to run
+    size_t num_steps = 10000;
+    // dT step time and kT CD time with no contact margin, and their relative std devs
+    double step_time = 1e-3;
+    double step_time_jitter = 0.05;
+    double cd_time = 5e-3;
+    double cd_time_jitter = 0.2;
+    // Contact margin per step of drift, and the smallest sphere radius
+    double margin_per_step = 1e-4;
+    double ref_size = 5e-3;
+    // Relative increase of the step and CD times per unit of (margin / ref_size), as larger margins give more
+    // contact pairs to work on
+    double margin_cost = 0.5;
+    // Drift of the first work order, and the max drift
+    unsigned int init_drift = 10;
+    unsigned int upper_bound = 200;
+    unsigned int seed = 42;
+};
+
+/// Run a drift controller on a synthetic model of the dT--kT pipeline, with no GPU. It follows the solver's protocol:
+/// dT sends a work order whenever it receives an update, and waits if it gets more than the drift (of the update in
+/// use) steps ahead of the state that update was built on. Step and CD times are drawn around their means, and grow
+/// with the contact margin that the drift causes.
+DriftSimResult SimulateDriftController(FutureDriftController& ctrl, const DriftSimParams& params);
+
+}  // namespace deme
+
+#endif
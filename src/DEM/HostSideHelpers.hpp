@@ -382,6 +382,54 @@ inline std::vector<size_t> hostSortIndices(const std::vector<T1>& v) {
     return idx;
 }
 
+/// Spread the lower 21 bits of x so that there are 2 zero bits between each of them
+inline uint64_t hostSpreadBits3(uint64_t x) {
+    x &= 0x1fffff;
+    x = (x | (x << 32)) & 0x1f00000000ffffULL;
+    x = (x | (x << 16)) & 0x1f0000ff0000ffULL;
+    x = (x | (x << 8)) & 0x100f00f00f00f00fULL;
+    x = (x | (x << 4)) & 0x10c30c30c30c30c3ULL;
+    x = (x | (x << 2)) & 0x1249249249249249ULL;
+    return x;
+}
+
+/// 63-bit Morton (Z-order) code of a point with 21-bit integer coordinates
+inline uint64_t hostMortonCode(uint32_t x, uint32_t y, uint32_t z) {
+    return hostSpreadBits3(x) | (hostSpreadBits3(y) << 1) | (hostSpreadBits3(z) << 2);
+}
+
+/// Order points along a Morton curve spanning their bounding box. Element i of the returned vector is the index of the
+/// point that goes i-th; points with the same code keep their input order.
+inline std::vector<size_t> hostMortonOrder(const std::vector<float3>& points) {
+    if (points.empty())
+        return std::vector<size_t>();
+    float3 L = points[0], U = points[0];
+    for (const auto& p : points) {
+        L = make_float3(std::min(L.x, p.x), std::min(L.y, p.y), std::min(L.z, p.z));
+        U = make_float3(std::max(U.x, p.x), std::max(U.y, p.y), std::max(U.z, p.z));
+    }
+    // One scale for all axes, so the curve cells are cubes
+    const double span = std::max({(double)U.x - L.x, (double)U.y - L.y, (double)U.z - L.z, 1e-30});
+    const double scale = (double)((1u << 21) - 1) / span;
+    std::vector<uint64_t> codes(points.size());
+    for (size_t i = 0; i < points.size(); i++) {
+        codes[i] = hostMortonCode((uint32_t)(((double)points[i].x - L.x) * scale),
+                                  (uint32_t)(((double)points[i].y - L.y) * scale),
+                                  (uint32_t)(((double)points[i].z - L.z) * scale));
+    }
+    return hostSortIndices(codes);
+}
+
+/// Given a permutation (element i is the old index of what goes to position i), return its inverse (element i is the
+/// new position of old index i)
+inline std::vector<size_t> hostInversePermutation(const std::vector<size_t>& perm) {
+    std::vector<size_t> inv(perm.size());
+    for (size_t i = 0; i < perm.size(); i++) {
+        inv[perm[i]] = i;
+    }
+    return inv;
+}
+
 template <typename T1, typename T2>
 inline void hostSortByKey(T1* keys, T2* vals, size_t n) {
     // Just bubble sort it
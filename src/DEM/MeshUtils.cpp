@@ -28,19 +28,19 @@
 // OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include <algorithm>
+#include <cctype>
 #include <cstdio>
+#include <filesystem>
 #include <fstream>
 #include <map>
 #include <unordered_map>
 
 #include <kernel/DEMHelperKernels.cuh>
 #include <DEM/BdrsAndObjs.h>
-#include <core/utils/WavefrontMeshLoader.hpp>
+#include <core/utils/MeshFileReaders.hpp>
 
 namespace deme {
 
-using namespace WAVEFRONT;
-
 std::vector<std::vector<float>> DEMMeshConnected::GetCoordsVerticesAsVectorOfVectors() {
     auto vec = GetCoordsVertices();
     std::vector<std::vector<float>> res(vec.size());
@@ -59,78 +59,161 @@ std::vector<std::vector<int>> DEMMeshConnected::GetIndicesVertexesAsVectorOfVect
     return res;
 }
 
-bool DEMMeshConnected::LoadWavefrontMesh(std::string input_file, bool load_normals, bool load_uv) {
+bool DEMMeshConnected::loadMeshFile(const std::string& input_file,
+                                    const std::string& format,
+                                    bool load_normals,
+                                    bool load_uv) {
     this->m_vertices.clear();
     this->m_normals.clear();
     this->m_UV.clear();
     this->m_face_v_indices.clear();
     this->m_face_n_indices.clear();
     this->m_face_uv_indices.clear();
-
-    GeometryInterface emptybm;  // BuildMesh bm;
+    this->m_tri_input_ids.clear();
+    this->m_tri_current_ids.clear();
+    this->nTri = 0;
 
     filename = input_file;
 
-    OBJ obj;
-
-    int ret = obj.LoadMesh(filename.c_str(), &emptybm, true);
-    if (ret == -1) {
-        std::cerr << "Error loading OBJ file " << filename << std::endl;
+    MeshFileReader reader;
+    TriMeshData mesh;
+    try {
+        // The cache holds the file as parsed; load options are applied afterwards, so one entry serves all of them
+        std::filesystem::path cache_file;
+        uint64_t key = 0;
+        if (!cache_dir.empty()) {
+            key = MeshFileReader::MixKey(reader.HashFile(filename), (uint64_t)format.at(0));
+            char name[32];
+            std::snprintf(name, sizeof(name), "%016llx.demesh", (unsigned long long)key);
+            cache_file = std::filesystem::path(cache_dir) / name;
+        }
+        if (cache_file.empty() || !MeshFileReader::LoadCache(cache_file.string(), key, mesh)) {
+            if (format == "stl") {
+                reader.ReadStl(filename, mesh);
+            } else if (format == "ply") {
+                reader.ReadPly(filename, mesh);
+            } else {
+                reader.ReadObj(filename, mesh);
+            }
+            if (!cache_file.empty()) {
+                // Failing to cache is not fatal
+                try {
+                    std::filesystem::create_directories(cache_dir);
+                    MeshFileReader::SaveCache(cache_file.string(), key, mesh);
+                } catch (const std::exception& e) {
+                    std::cerr << "Could not cache mesh " << filename << ": " << e.what() << std::endl;
+                }
+            }
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error loading mesh file " << filename << ": " << e.what() << std::endl;
         return false;
     }
 
-    float3 tmp_f3;
-    int3 tmp_i3;
-    for (unsigned int iv = 0; iv < obj.mVerts.size(); iv += 3) {
-        tmp_f3.x = obj.mVerts[iv];
-        tmp_f3.y = obj.mVerts[iv + 1];
-        tmp_f3.z = obj.mVerts[iv + 2];
-        this->m_vertices.push_back(tmp_f3);
+    this->m_vertices.resize(mesh.NumVertices());
+    for (size_t i = 0; i < m_vertices.size(); i++) {
+        m_vertices[i] = make_float3(mesh.vertices[3 * i], mesh.vertices[3 * i + 1], mesh.vertices[3 * i + 2]);
     }
-    for (unsigned int in = 0; in < obj.mNormals.size(); in += 3) {
-        tmp_f3.x = obj.mNormals[in];
-        tmp_f3.y = obj.mNormals[in + 1];
-        tmp_f3.z = obj.mNormals[in + 2];
-        this->m_normals.push_back(tmp_f3);
+    this->nTri = mesh.NumTriangles();
+    this->m_face_v_indices.resize(nTri);
+    for (size_t i = 0; i < nTri; i++) {
+        m_face_v_indices[i] = make_int3(mesh.face_v[3 * i], mesh.face_v[3 * i + 1], mesh.face_v[3 * i + 2]);
     }
-    for (unsigned int it = 0; it < obj.mTexels.size(); it += 2)  // +2 because only u,v each texel
-    {
-        tmp_f3.x = obj.mTexels[it];
-        tmp_f3.y = obj.mTexels[it + 1];
-        tmp_f3.z = 0;
-        this->m_UV.push_back(tmp_f3);
+    if (load_normals && !mesh.face_n.empty()) {
+        this->m_normals.resize(mesh.normals.size() / 3);
+        for (size_t i = 0; i < m_normals.size(); i++) {
+            m_normals[i] = make_float3(mesh.normals[3 * i], mesh.normals[3 * i + 1], mesh.normals[3 * i + 2]);
+        }
+        this->m_face_n_indices.resize(nTri);
+        for (size_t i = 0; i < nTri; i++) {
+            m_face_n_indices[i] = make_int3(mesh.face_n[3 * i], mesh.face_n[3 * i + 1], mesh.face_n[3 * i + 2]);
+        }
     }
-    for (unsigned int iiv = 0; iiv < obj.mIndexesVerts.size(); iiv += 3) {
-        tmp_i3.x = obj.mIndexesVerts[iiv];
-        tmp_i3.y = obj.mIndexesVerts[iiv + 1];
-        tmp_i3.z = obj.mIndexesVerts[iiv + 2];
-        this->m_face_v_indices.push_back(tmp_i3);
+    if (load_uv && !mesh.face_uv.empty()) {
+        this->m_UV.resize(mesh.uv.size() / 2);
+        for (size_t i = 0; i < m_UV.size(); i++) {
+            m_UV[i] = make_float3(mesh.uv[2 * i], mesh.uv[2 * i + 1], 0);
+        }
+        this->m_face_uv_indices.resize(nTri);
+        for (size_t i = 0; i < nTri; i++) {
+            m_face_uv_indices[i] = make_int3(mesh.face_uv[3 * i], mesh.face_uv[3 * i + 1], mesh.face_uv[3 * i + 2]);
+        }
     }
-    for (unsigned int iin = 0; iin < obj.mIndexesNormals.size(); iin += 3) {
-        tmp_i3.x = obj.mIndexesNormals[iin];
-        tmp_i3.y = obj.mIndexesNormals[iin + 1];
-        tmp_i3.z = obj.mIndexesNormals[iin + 2];
-        this->m_face_n_indices.push_back(tmp_i3);
+
+    return true;
+}
+
+bool DEMMeshConnected::LoadWavefrontMesh(std::string input_file, bool load_normals, bool load_uv) {
+    return loadMeshFile(input_file, "obj", load_normals, load_uv);
+}
+
+bool DEMMeshConnected::LoadSTLMesh(std::string input_file, bool load_normals) {
+    return loadMeshFile(input_file, "stl", load_normals, false);
+}
+
+bool DEMMeshConnected::LoadPLYMesh(std::string input_file, bool load_normals, bool load_uv) {
+    return loadMeshFile(input_file, "ply", load_normals, load_uv);
+}
+
+bool DEMMeshConnected::LoadMesh(std::string input_file, bool load_normals, bool load_uv) {
+    std::string ext = std::filesystem::path(input_file).extension().string();
+    std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return (char)std::tolower(c); });
+    if (ext == ".stl") {
+        return LoadSTLMesh(input_file, load_normals);
+    } else if (ext == ".ply") {
+        return LoadPLYMesh(input_file, load_normals, load_uv);
     }
-    for (unsigned int iit = 0; iit < obj.mIndexesTexels.size(); iit += 3) {
-        tmp_i3.x = obj.mIndexesTexels[iit];
-        tmp_i3.y = obj.mIndexesTexels[iit + 1];
-        tmp_i3.z = obj.mIndexesTexels[iit + 2];
-        this->m_face_uv_indices.push_back(tmp_i3);
+    return LoadWavefrontMesh(input_file, load_normals, load_uv);
+}
+
+// Apply a gather permutation to a per-triangle array, if it is per-triangle
+template <typename T>
+static void permuteTriArray(std::vector<T>& arr, const std::vector<size_t>& order) {
+    if (arr.size() != order.size())
+        return;
+    std::vector<T> tmp(arr.size());
+    for (size_t i = 0; i < order.size(); i++) {
+        tmp[i] = arr[order[i]];
     }
+    arr.swap(tmp);
+}
 
-    if (!load_normals) {
-        this->m_normals.clear();
-        this->m_face_n_indices.clear();
+void DEMMeshConnected::ReorderTriangles(const std::vector<size_t>& order) {
+    assertLength(order.size(), "ReorderTriangles");
+    std::vector<bool> seen(nTri, false);
+    for (size_t id : order) {
+        if (id >= nTri || seen[id]) {
+            throw std::runtime_error("The order given to ReorderTriangles is not a permutation of the triangle IDs.");
+        }
+        seen[id] = true;
     }
-    if (!load_uv) {
-        this->m_UV.clear();
-        this->m_face_uv_indices.clear();
+    permuteTriArray(m_face_v_indices, order);
+    permuteTriArray(m_face_n_indices, order);
+    permuteTriArray(m_face_uv_indices, order);
+    permuteTriArray(m_face_col_indices, order);
+    permuteTriArray(materials, order);
+    for (auto& wc : geo_wildcards) {
+        permuteTriArray(wc.second, order);
     }
 
-    this->nTri = m_face_v_indices.size();
+    // Compose with whatever reordering happened before
+    if (m_tri_input_ids.empty()) {
+        m_tri_input_ids = order;
+    } else {
+        permuteTriArray(m_tri_input_ids, order);
+    }
+    m_tri_current_ids = hostInversePermutation(m_tri_input_ids);
+}
 
-    return true;
+std::vector<size_t> DEMMeshConnected::SortTrianglesSpatially() {
+    std::vector<float3> centroids(nTri);
+    for (size_t i = 0; i < nTri; i++) {
+        const int3& f = m_face_v_indices[i];
+        centroids[i] = (m_vertices[f.x] + m_vertices[f.y] + m_vertices[f.z]) / 3.f;
+    }
+    std::vector<size_t> order = hostMortonOrder(centroids);
+    ReorderTriangles(order);
+    return order;
 }
 
 // Write the specified meshes in a Wavefront .obj file
@@ -0,0 +1,951 @@
+//  Copyright (c) 2021, SBEL GPU Development Team
+//  Copyright (c) 2021, University of Wisconsin - Madison
+//
+//	SPDX-License-Identifier: BSD-3-Clause
+
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <sstream>
+
+#ifdef DEME_USE_OPENMP
+    #include <omp.h>
+#endif
+
+#include <core/utils/ColumnarBinary.hpp>
+#include <core/utils/VtkXmlWriter.hpp>
+#include <DEM/OutputWriter.h>
+#include <DEM/HostSideHelpers.hpp>
+#include <kernel/DEMHelperKernels.cuh>
+
+namespace deme {
+
+// =============================================================================
+// Frame formatters
+// =============================================================================
+
+// Absolute CoM position of an owner in the snapshot
+static float3 frameOwnerPos(const OutputFrame& frame, size_t owner) {
+    float X, Y, Z;
+    voxelIDToPosition<float, voxelID_t, subVoxelPos_t>(X, Y, Z, frame.voxelID[owner], frame.locX[owner],
+                                                       frame.locY[owner], frame.locZ[owner], frame.nvXp2,
+                                                       frame.nvYp2, frame.voxelSize, frame.l);
+    return make_float3(X + frame.LBFX, Y + frame.LBFY, Z + frame.LBFZ);
+}
+
+// Absolute position of a sphere component in the snapshot
+static float3 frameSpherePos(const OutputFrame& frame, size_t sphere, size_t compOffset) {
+    bodyID_t this_owner = frame.ownerClumpBody[sphere];
+    float3 CoM = frameOwnerPos(frame, this_owner);
+    float3 this_sp_deviation;
+    this_sp_deviation.x = frame.relPosSphereX[compOffset];
+    this_sp_deviation.y = frame.relPosSphereY[compOffset];
+    this_sp_deviation.z = frame.relPosSphereZ[compOffset];
+    applyOriQToVector3<float, float>(this_sp_deviation.x, this_sp_deviation.y, this_sp_deviation.z,
+                                     frame.oriQw[this_owner], frame.oriQx[this_owner], frame.oriQy[this_owner],
+                                     frame.oriQz[this_owner]);
+    return CoM + this_sp_deviation;
+}
+
+// Header columns shared by sphere and clump files, after the position (and quaternion/type) columns
+static void appendOwnerStateHeader(std::ostream& out, unsigned int outFlags) {
+    if (outFlags & OUTPUT_CONTENT::ABSV) {
+        out << ",absv";
+    }
+    if (outFlags & OUTPUT_CONTENT::VEL) {
+        out << "," + OUTPUT_FILE_VEL_X_COL_NAME + "," + OUTPUT_FILE_VEL_Y_COL_NAME + "," + OUTPUT_FILE_VEL_Z_COL_NAME;
+    }
+    if (outFlags & OUTPUT_CONTENT::ANG_VEL) {
+        out << "," + OUTPUT_FILE_ANGVEL_X_COL_NAME + "," + OUTPUT_FILE_ANGVEL_Y_COL_NAME + "," +
+                   OUTPUT_FILE_ANGVEL_Z_COL_NAME;
+    }
+    if (outFlags & OUTPUT_CONTENT::ABS_ACC) {
+        out << ",abs_acc";
+    }
+    if (outFlags & OUTPUT_CONTENT::ACC) {
+        out << ",a_x,a_y,a_z";
+    }
+    if (outFlags & OUTPUT_CONTENT::ANG_ACC) {
+        out << ",alpha_x,alpha_y,alpha_z";
+    }
+    if (outFlags & OUTPUT_CONTENT::FAMILY) {
+        out << ",family";
+    }
+}
+
+// Default precision of an std::ostream, used for sphere and contact CSV files
+const int CSV_DEFAULT_PRECISION = 6;
+
+// Append a value to a text buffer, producing exactly what std::ostream << value gives with default flags and the given
+// precision. std::to_chars with general format is locale-independent and specified as printf's %.*g, same as ostream.
+static void appendFloat(std::string& buf, float val, int precision) {
+    char tmp[64];
+    auto res = std::to_chars(tmp, tmp + sizeof(tmp), val, std::chars_format::general, precision);
+    buf.append(tmp, res.ptr);
+}
+template <typename T>
+static void appendInteger(std::string& buf, T val) {
+    char tmp[32];
+    auto res = std::to_chars(tmp, tmp + sizeof(tmp), val);
+    buf.append(tmp, res.ptr);
+}
+static void appendFloat3(std::string& buf, const float3& val, int precision) {
+    buf += ',';
+    appendFloat(buf, val.x, precision);
+    buf += ',';
+    appendFloat(buf, val.y, precision);
+    buf += ',';
+    appendFloat(buf, val.z, precision);
+}
+
+// Format rows [0, n) into the stream. Rows are split into contiguous chunks that are formatted in parallel into their
+// own buffers, then written out in order, so the result is the same as formatting serially.
+template <typename RowFunc>
+static void formatRowsInChunks(std::ostream& out, size_t n, const RowFunc& format_row) {
+    if (n == 0)
+        return;
+    // Rows per chunk: small enough for load balancing, large enough that per-chunk overhead does not matter
+    const size_t min_rows_per_chunk = 4096;
+    size_t n_workers = 1;
+#ifdef DEME_USE_OPENMP
+    n_workers = (size_t)omp_get_max_threads();
+#endif
+    size_t n_chunks = DEME_MAX((size_t)1, DEME_MIN(4 * n_workers, (n + min_rows_per_chunk - 1) / min_rows_per_chunk));
+    const size_t rows_per_chunk = (n + n_chunks - 1) / n_chunks;
+    n_chunks = (n + rows_per_chunk - 1) / rows_per_chunk;
+    std::vector<std::string> chunks(n_chunks);
+
+#ifdef DEME_USE_OPENMP
+    #pragma omp parallel for schedule(dynamic, 1)
+#endif
+    for (long long c = 0; c < (long long)n_chunks; c++) {
+        std::string& buf = chunks[c];
+        const size_t start = (size_t)c * rows_per_chunk;
+        const size_t end = DEME_MIN(start + rows_per_chunk, n);
+        for (size_t i = start; i < end; i++) {
+            format_row(buf, i);
+        }
+    }
+
+    for (const auto& buf : chunks) {
+        out.write(buf.data(), buf.size());
+    }
+}
+
+// Row values matching appendOwnerStateHeader
+static void appendOwnerStateRow(std::string& buf, const OutputFrame& frame, size_t owner, int precision) {
+    const unsigned int outFlags = frame.outFlags;
+    float3 vxyz = make_float3(frame.vX[owner], frame.vY[owner], frame.vZ[owner]);
+    float3 acc = make_float3(frame.aX[owner], frame.aY[owner], frame.aZ[owner]);
+    if (outFlags & OUTPUT_CONTENT::ABSV) {
+        buf += ',';
+        appendFloat(buf, length(vxyz), precision);
+    }
+    if (outFlags & OUTPUT_CONTENT::VEL) {
+        appendFloat3(buf, vxyz, precision);
+    }
+    if (outFlags & OUTPUT_CONTENT::ANG_VEL) {
+        appendFloat3(buf, make_float3(frame.omgBarX[owner], frame.omgBarY[owner], frame.omgBarZ[owner]), precision);
+    }
+    if (outFlags & OUTPUT_CONTENT::ABS_ACC) {
+        buf += ',';
+        appendFloat(buf, length(acc), precision);
+    }
+    if (outFlags & OUTPUT_CONTENT::ACC) {
+        appendFloat3(buf, acc, precision);
+    }
+    if (outFlags & OUTPUT_CONTENT::ANG_ACC) {
+        appendFloat3(buf, make_float3(frame.alphaX[owner], frame.alphaY[owner], frame.alphaZ[owner]), precision);
+    }
+    // Family number needs to be user number
+    if (outFlags & OUTPUT_CONTENT::FAMILY) {
+        buf += ',';
+        appendInteger(buf, +(frame.familyID[owner]));
+    }
+}
+
+void formatSpheresAsCsv(const OutputFrame& frame, std::ostream& out) {
+    std::ostringstream outstrstream;
+    const unsigned int outFlags = frame.outFlags;
+    const int precision = CSV_DEFAULT_PRECISION;
+
+    outstrstream << OUTPUT_FILE_X_COL_NAME + "," + OUTPUT_FILE_Y_COL_NAME + "," + OUTPUT_FILE_Z_COL_NAME + "," +
+                        OUTPUT_FILE_R_COL_NAME;
+    appendOwnerStateHeader(outstrstream, outFlags);
+    if (outFlags & OUTPUT_CONTENT::OWNER_WILDCARD) {
+        for (const auto& name : frame.ownerWildcardNames) {
+            outstrstream << "," + name;
+        }
+    }
+    if (outFlags & OUTPUT_CONTENT::GEO_WILDCARD) {
+        for (const auto& name : frame.geoWildcardNames) {
+            outstrstream << "," + name;
+        }
+    }
+    outstrstream << "\n";
+    out << outstrstream.str();
+
+    formatRowsInChunks(out, frame.nSpheres, [&](std::string& buf, size_t i) {
+        bodyID_t this_owner = frame.ownerClumpBody[i];
+        // If this (impl-level) family is in the no-output list, skip it
+        if (frame.familiesNoOutput.find(frame.familyID[this_owner]) != frame.familiesNoOutput.end()) {
+            return;
+        }
+
+        size_t compOffset = (frame.useClumpJitify) ? frame.clumpComponentOffsetExt[i] : i;
+        float3 pos = frameSpherePos(frame, i, compOffset);
+        appendFloat(buf, pos.x, precision);
+        buf += ',';
+        appendFloat(buf, pos.y, precision);
+        buf += ',';
+        appendFloat(buf, pos.z, precision);
+        buf += ',';
+        appendFloat(buf, frame.radiiSphere[compOffset], precision);
+
+        appendOwnerStateRow(buf, frame, this_owner, precision);
+
+        // Wildcards. Owner wildcards are per-owner quantities, so they are indexed by the owner of this sphere.
+        if (outFlags & OUTPUT_CONTENT::OWNER_WILDCARD) {
+            for (const auto& w_vals : frame.ownerWildcards) {
+                buf += ',';
+                appendFloat(buf, w_vals[this_owner], precision);
+            }
+        }
+        if (outFlags & OUTPUT_CONTENT::GEO_WILDCARD) {
+            for (const auto& w_vals : frame.sphereWildcards) {
+                buf += ',';
+                appendFloat(buf, w_vals[i], precision);
+            }
+        }
+
+        buf += '\n';
+    });
+}
+
+void formatClumpsAsCsv(const OutputFrame& frame, std::ostream& out) {
+    std::ostringstream outstrstream;
+    const unsigned int outFlags = frame.outFlags;
+    const int precision = (int)frame.accuracy;
+
+    // xyz and quaternion are always there
+    outstrstream << OUTPUT_FILE_X_COL_NAME + "," + OUTPUT_FILE_Y_COL_NAME + "," + OUTPUT_FILE_Z_COL_NAME +
+                        ",Qw,Qx,Qy,Qz," + OUTPUT_FILE_CLUMP_TYPE_NAME;
+    appendOwnerStateHeader(outstrstream, outFlags);
+    if (outFlags & OUTPUT_CONTENT::OWNER_WILDCARD) {
+        for (const auto& name : frame.ownerWildcardNames) {
+            outstrstream << "," + name;
+        }
+    }
+    outstrstream << "\n";
+    out << outstrstream.str();
+
+    formatRowsInChunks(out, frame.nOwners, [&](std::string& buf, size_t i) {
+        // i is this owner's number. And if it is not a clump, we can move on.
+        if (frame.ownerTypes[i] != OWNER_T_CLUMP)
+            return;
+        // If this (impl-level) family is in the no-output list, skip it
+        if (frame.familiesNoOutput.find(frame.familyID[i]) != frame.familiesNoOutput.end()) {
+            return;
+        }
+
+        float3 CoM = frameOwnerPos(frame, i);
+        // Output position
+        appendFloat(buf, CoM.x, precision);
+        buf += ',';
+        appendFloat(buf, CoM.y, precision);
+        buf += ',';
+        appendFloat(buf, CoM.z, precision);
+        // Then quaternions
+        buf += ',';
+        appendFloat(buf, frame.oriQw[i], precision);
+        buf += ',';
+        appendFloat(buf, frame.oriQx[i], precision);
+        buf += ',';
+        appendFloat(buf, frame.oriQy[i], precision);
+        buf += ',';
+        appendFloat(buf, frame.oriQz[i], precision);
+        // Then type of clump
+        buf += ',';
+        buf += frame.templateNumNameMap.at(frame.inertiaPropOffsets[i]);
+
+        appendOwnerStateRow(buf, frame, i, precision);
+
+        if (outFlags & OUTPUT_CONTENT::OWNER_WILDCARD) {
+            for (const auto& w_vals : frame.ownerWildcards) {
+                buf += ',';
+                appendFloat(buf, w_vals[i], precision);
+            }
+        }
+
+        buf += '\n';
+    });
+}
+
+void formatContactsAsCsv(const OutputFrame& frame, std::ostream& out) {
+    std::ostringstream outstrstream;
+    const unsigned int cntOutFlags = frame.cntOutFlags;
+    const CompactContactInfo& contactInfo = *(frame.contactInfo);
+    const int precision = CSV_DEFAULT_PRECISION;
+
+    outstrstream << OUTPUT_FILE_CNT_TYPE_NAME;
+    if (cntOutFlags & CNT_OUTPUT_CONTENT::OWNER) {
+        outstrstream << "," + OUTPUT_FILE_OWNER_1_NAME + "," + OUTPUT_FILE_OWNER_2_NAME;
+    }
+    if (cntOutFlags & CNT_OUTPUT_CONTENT::GEO_ID) {
+        outstrstream << "," + OUTPUT_FILE_GEO_ID_1_NAME + "," + OUTPUT_FILE_GEO_ID_2_NAME;
+    }
+    if (cntOutFlags & CNT_OUTPUT_CONTENT::FORCE) {
+        outstrstream << "," + OUTPUT_FILE_FORCE_X_NAME + "," + OUTPUT_FILE_FORCE_Y_NAME + "," +
+                            OUTPUT_FILE_FORCE_Z_NAME;
+    }
+    if (cntOutFlags & CNT_OUTPUT_CONTENT::CNT_POINT) {
+        outstrstream << "," + OUTPUT_FILE_X_COL_NAME + "," + OUTPUT_FILE_Y_COL_NAME + "," + OUTPUT_FILE_Z_COL_NAME;
+    }
+    // if (cntOutFlags & CNT_OUTPUT_CONTENT::COMPONENT) {
+    //     outstrstream << ","+OUTPUT_FILE_COMP_1_NAME+","+OUTPUT_FILE_COMP_2_NAME;
+    // }
+    // if (cntOutFlags & CNT_OUTPUT_CONTENT::NICKNAME) {
+    //     outstrstream << ","+OUTPUT_FILE_OWNER_NICKNAME_1_NAME+","+OUTPUT_FILE_OWNER_NICKNAME_2_NAME;
+    // }
+    if (cntOutFlags & CNT_OUTPUT_CONTENT::NORMAL) {
+        outstrstream << "," + OUTPUT_FILE_NORMAL_X_NAME + "," + OUTPUT_FILE_NORMAL_Y_NAME + "," +
+                            OUTPUT_FILE_NORMAL_Z_NAME;
+    }
+    if (cntOutFlags & CNT_OUTPUT_CONTENT::TORQUE) {
+        outstrstream << "," + OUTPUT_FILE_TORQUE_X_NAME + "," + OUTPUT_FILE_TORQUE_Y_NAME + "," +
+                            OUTPUT_FILE_TORQUE_Z_NAME;
+    }
+    if (cntOutFlags & CNT_OUTPUT_CONTENT::CNT_WILDCARD) {
+        // Write all wildcard names as header
+        for (const auto& w_name : frame.contactWildcardNames) {
+            outstrstream << "," + w_name;
+        }
+    }
+    outstrstream << "\n";
+    out << outstrstream.str();
+
+    // Look up the columns once, not per row
+    const ColumnView<const contact_t> cnt_types = contactInfo.Get<contact_t>("ContactType");
+    ColumnView<const bodyID_t> AOwner, BOwner, AGeo, BGeo;
+    ColumnView<const float3> forces, points, normals, torques;
+    std::vector<ColumnView<const float>> wildcards;
+    if (cntOutFlags & CNT_OUTPUT_CONTENT::OWNER) {
+        AOwner = contactInfo.Get<bodyID_t>("AOwner");
+        BOwner = contactInfo.Get<bodyID_t>("BOwner");
+    }
+    if (cntOutFlags & CNT_OUTPUT_CONTENT::GEO_ID) {
+        AGeo = contactInfo.Get<bodyID_t>("AGeo");
+        BGeo = contactInfo.Get<bodyID_t>("BGeo");
+    }
+    if (cntOutFlags & CNT_OUTPUT_CONTENT::FORCE) {
+        forces = contactInfo.Get<float3>("Force");
+    }
+    if (cntOutFlags & CNT_OUTPUT_CONTENT::CNT_POINT) {
+        points = contactInfo.Get<float3>("Point");
+    }
+    if (cntOutFlags & CNT_OUTPUT_CONTENT::NORMAL) {
+        normals = contactInfo.Get<float3>("Normal");
+    }
+    if (cntOutFlags & CNT_OUTPUT_CONTENT::TORQUE) {
+        torques = contactInfo.Get<float3>("Torque");
+    }
+    if (cntOutFlags & CNT_OUTPUT_CONTENT::CNT_WILDCARD) {
+        // The order shouldn't be an issue... the same set is being processed here and in equip_contact_wildcards,
+        // see Model.h
+        for (const auto& name : frame.contactWildcardNames) {
+            wildcards.push_back(contactInfo.Get<float>(name));
+        }
+    }
+    // Contact type names, indexed by contact_t code
+    std::vector<const std::string*> type_names(std::numeric_limits<contact_t>::max() + 1, nullptr);
+    for (const auto& [code, name] : contact_type_out_name_map) {
+        type_names[code] = &name;
+    }
+    // Checked up front, as rows may be formatted in a parallel region, where throwing is not an option
+    for (size_t i = 0; i < contactInfo.Size(); i++) {
+        if (!type_names[cnt_types[i]]) {
+            throw std::runtime_error("Contact " + std::to_string(i) + " has type code " +
+                                     std::to_string((unsigned int)cnt_types[i]) + ", which has no output name.");
+        }
+    }
+
+    formatRowsInChunks(out, contactInfo.Size(), [&](std::string& buf, size_t i) {
+        buf += *type_names[cnt_types[i]];
+
+        // (Internal) ownerID and/or geometry ID
+        if (!AOwner.empty()) {
+            buf += ',';
+            appendInteger(buf, AOwner[i]);
+            buf += ',';
+            appendInteger(buf, BOwner[i]);
+        }
+        if (!AGeo.empty()) {
+            buf += ',';
+            appendInteger(buf, AGeo[i]);
+            buf += ',';
+            appendInteger(buf, BGeo[i]);
+        }
+
+        // Force is already in global...
+        if (!forces.empty()) {
+            appendFloat3(buf, forces[i], precision);
+        }
+
+        // oriQ is updated already... whereas the contact point is effectively last step's... That's unfortunate.
+        // Should we do somthing ahout it?
+        if (!points.empty()) {
+            appendFloat3(buf, points[i], precision);
+        }
+
+        // Same order as the header: the normal comes before the torque
+        if (!normals.empty()) {
+            appendFloat3(buf, normals[i], precision);
+        }
+
+        // Torque is in global already...
+        if (!torques.empty()) {
+            appendFloat3(buf, torques[i], precision);
+        }
+
+        // Contact wildcards
+        for (const auto& w_vals : wildcards) {
+            buf += ',';
+            appendFloat(buf, w_vals[i], precision);
+        }
+
+        buf += '\n';
+    });
+}
+
+// Owner-state columns shared by binary sphere and clump files, gathered for the listed owners
+static void addOwnerStateColumns(ColumnarBinaryWriter& writer,
+                                 const OutputFrame& frame,
+                                 const std::vector<bodyID_t>& owners) {
+    const unsigned int outFlags = frame.outFlags;
+    const size_t n = owners.size();
+    auto gather = [&](const std::vector<float>& src) {
+        std::vector<float> res(n);
+        for (size_t k = 0; k < n; k++)
+            res[k] = src[owners[k]];
+        return res;
+    };
+    if (outFlags & OUTPUT_CONTENT::ABSV) {
+        std::vector<float> absv(n);
+        for (size_t k = 0; k < n; k++) {
+            bodyID_t o = owners[k];
+            absv[k] = length(make_float3(frame.vX[o], frame.vY[o], frame.vZ[o]));
+        }
+        writer.AddColumn("absv", std::move(absv));
+    }
+    if (outFlags & OUTPUT_CONTENT::VEL) {
+        writer.AddColumn(OUTPUT_FILE_VEL_X_COL_NAME, gather(frame.vX));
+        writer.AddColumn(OUTPUT_FILE_VEL_Y_COL_NAME, gather(frame.vY));
+        writer.AddColumn(OUTPUT_FILE_VEL_Z_COL_NAME, gather(frame.vZ));
+    }
+    if (outFlags & OUTPUT_CONTENT::ANG_VEL) {
+        writer.AddColumn(OUTPUT_FILE_ANGVEL_X_COL_NAME, gather(frame.omgBarX));
+        writer.AddColumn(OUTPUT_FILE_ANGVEL_Y_COL_NAME, gather(frame.omgBarY));
+        writer.AddColumn(OUTPUT_FILE_ANGVEL_Z_COL_NAME, gather(frame.omgBarZ));
+    }
+    if (outFlags & OUTPUT_CONTENT::ABS_ACC) {
+        std::vector<float> abs_acc(n);
+        for (size_t k = 0; k < n; k++) {
+            bodyID_t o = owners[k];
+            abs_acc[k] = length(make_float3(frame.aX[o], frame.aY[o], frame.aZ[o]));
+        }
+        writer.AddColumn("abs_acc", std::move(abs_acc));
+    }
+    if (outFlags & OUTPUT_CONTENT::ACC) {
+        writer.AddColumn("a_x", gather(frame.aX));
+        writer.AddColumn("a_y", gather(frame.aY));
+        writer.AddColumn("a_z", gather(frame.aZ));
+    }
+    if (outFlags & OUTPUT_CONTENT::ANG_ACC) {
+        writer.AddColumn("alpha_x", gather(frame.alphaX));
+        writer.AddColumn("alpha_y", gather(frame.alphaY));
+        writer.AddColumn("alpha_z", gather(frame.alphaZ));
+    }
+    if (outFlags & OUTPUT_CONTENT::FAMILY) {
+        std::vector<family_t> families(n);
+        for (size_t k = 0; k < n; k++)
+            families[k] = frame.familyID[owners[k]];
+        writer.AddColumn("family", std::move(families));
+    }
+    if (outFlags & OUTPUT_CONTENT::OWNER_WILDCARD) {
+        unsigned int j = 0;
+        for (const auto& name : frame.ownerWildcardNames) {
+            writer.AddColumn(name, gather(frame.ownerWildcards[j++]));
+        }
+    }
+}
+
+void formatSpheresAsBinary(const OutputFrame& frame, std::ostream& out) {
+    std::vector<bodyID_t> owners;
+    std::vector<float> X, Y, Z, R;
+    std::vector<std::vector<float>> geo_wildcard_vals(frame.sphereWildcards.size());
+    for (size_t i = 0; i < frame.nSpheres; i++) {
+        bodyID_t this_owner = frame.ownerClumpBody[i];
+        // If this (impl-level) family is in the no-output list, skip it
+        if (frame.familiesNoOutput.find(frame.familyID[this_owner]) != frame.familiesNoOutput.end()) {
+            continue;
+        }
+        size_t compOffset = (frame.useClumpJitify) ? frame.clumpComponentOffsetExt[i] : i;
+        float3 pos = frameSpherePos(frame, i, compOffset);
+        owners.push_back(this_owner);
+        X.push_back(pos.x);
+        Y.push_back(pos.y);
+        Z.push_back(pos.z);
+        R.push_back(frame.radiiSphere[compOffset]);
+        if (frame.outFlags & OUTPUT_CONTENT::GEO_WILDCARD) {
+            for (size_t j = 0; j < frame.sphereWildcards.size(); j++) {
+                geo_wildcard_vals[j].push_back(frame.sphereWildcards[j][i]);
+            }
+        }
+    }
+
+    // Columns are added in the same order as the CSV header
+    ColumnarBinaryWriter writer(owners.size());
+    writer.AddColumn(OUTPUT_FILE_X_COL_NAME, std::move(X));
+    writer.AddColumn(OUTPUT_FILE_Y_COL_NAME, std::move(Y));
+    writer.AddColumn(OUTPUT_FILE_Z_COL_NAME, std::move(Z));
+    writer.AddColumn(OUTPUT_FILE_R_COL_NAME, std::move(R));
+    addOwnerStateColumns(writer, frame, owners);
+    if (frame.outFlags & OUTPUT_CONTENT::GEO_WILDCARD) {
+        unsigned int j = 0;
+        for (const auto& name : frame.geoWildcardNames) {
+            writer.AddColumn(name, std::move(geo_wildcard_vals[j++]));
+        }
+    }
+    writer.Write(out);
+}
+
+void formatClumpsAsBinary(const OutputFrame& frame, std::ostream& out) {
+    std::vector<bodyID_t> owners;
+    std::vector<float> X, Y, Z, Qw, Qx, Qy, Qz;
+    std::vector<std::string> clump_type;
+    for (size_t i = 0; i < frame.nOwners; i++) {
+        // i is this owner's number. And if it is not a clump, we can move on.
+        if (frame.ownerTypes[i] != OWNER_T_CLUMP)
+            continue;
+        // If this (impl-level) family is in the no-output list, skip it
+        if (frame.familiesNoOutput.find(frame.familyID[i]) != frame.familiesNoOutput.end()) {
+            continue;
+        }
+        float3 CoM = frameOwnerPos(frame, i);
+        owners.push_back((bodyID_t)i);
+        X.push_back(CoM.x);
+        Y.push_back(CoM.y);
+        Z.push_back(CoM.z);
+        Qw.push_back(frame.oriQw[i]);
+        Qx.push_back(frame.oriQx[i]);
+        Qy.push_back(frame.oriQy[i]);
+        Qz.push_back(frame.oriQz[i]);
+        clump_type.push_back(frame.templateNumNameMap.at(frame.inertiaPropOffsets[i]));
+    }
+
+    // Columns are added in the same order as the CSV header
+    ColumnarBinaryWriter writer(owners.size());
+    writer.AddColumn(OUTPUT_FILE_X_COL_NAME, std::move(X));
+    writer.AddColumn(OUTPUT_FILE_Y_COL_NAME, std::move(Y));
+    writer.AddColumn(OUTPUT_FILE_Z_COL_NAME, std::move(Z));
+    writer.AddColumn(OUTPUT_FILE_QW_COL_NAME, std::move(Qw));
+    writer.AddColumn(OUTPUT_FILE_QX_COL_NAME, std::move(Qx));
+    writer.AddColumn(OUTPUT_FILE_QY_COL_NAME, std::move(Qy));
+    writer.AddColumn(OUTPUT_FILE_QZ_COL_NAME, std::move(Qz));
+    writer.AddStringColumn(OUTPUT_FILE_CLUMP_TYPE_NAME, clump_type);
+    addOwnerStateColumns(writer, frame, owners);
+    writer.Write(out);
+}
+
+void formatContactsAsBinary(const OutputFrame& frame, std::ostream& out) {
+    const unsigned int cntOutFlags = frame.cntOutFlags;
+    const CompactContactInfo& contactInfo = *(frame.contactInfo);
+    const size_t n = contactInfo.Size();
+
+    ColumnarBinaryWriter writer(n);
+    // Split a float3 field into 3 float columns
+    auto add_float3_cols = [&](const std::string& key, const std::string& x_name, const std::string& y_name,
+                               const std::string& z_name) {
+        const ColumnView<const float3> vals = contactInfo.Get<float3>(key);
+        std::vector<float> x(n), y(n), z(n);
+        for (size_t i = 0; i < n; i++) {
+            x[i] = vals[i].x;
+            y[i] = vals[i].y;
+            z[i] = vals[i].z;
+        }
+        writer.AddColumn(x_name, std::move(x));
+        writer.AddColumn(y_name, std::move(y));
+        writer.AddColumn(z_name, std::move(z));
+    };
+
+    // Scalar columns are written straight from the container's buffer
+    auto add_view_col = [&](const std::string& key, const std::string& name) {
+        const ColumnView<const bodyID_t> vals = contactInfo.Get<bodyID_t>(key);
+        writer.AddColumnView(name, vals.data(), vals.size());
+    };
+
+    // Contact type codes become dictionary codes; several codes may share one name
+    {
+        const ColumnView<const contact_t> cnt_types = contactInfo.Get<contact_t>("ContactType");
+        std::vector<std::string> dict;
+        std::vector<uint32_t> dict_code_of(std::numeric_limits<contact_t>::max() + 1, 0);
+        for (const auto& [code, name] : contact_type_out_name_map) {
+            auto it = std::find(dict.begin(), dict.end(), name);
+            dict_code_of[code] = (uint32_t)(it - dict.begin());
+            if (it == dict.end())
+                dict.push_back(name);
+        }
+        std::vector<uint32_t> codes(n);
+        for (size_t i = 0; i < n; i++)
+            codes[i] = dict_code_of[cnt_types[i]];
+        writer.AddStringCodeColumn(OUTPUT_FILE_CNT_TYPE_NAME, std::move(codes), std::move(dict));
+    }
+    if (cntOutFlags & CNT_OUTPUT_CONTENT::OWNER) {
+        add_view_col("AOwner", OUTPUT_FILE_OWNER_1_NAME);
+        add_view_col("BOwner", OUTPUT_FILE_OWNER_2_NAME);
+    }
+    if (cntOutFlags & CNT_OUTPUT_CONTENT::GEO_ID) {
+        add_view_col("AGeo", OUTPUT_FILE_GEO_ID_1_NAME);
+        add_view_col("BGeo", OUTPUT_FILE_GEO_ID_2_NAME);
+    }
+    if (cntOutFlags & CNT_OUTPUT_CONTENT::FORCE) {
+        add_float3_cols("Force", OUTPUT_FILE_FORCE_X_NAME, OUTPUT_FILE_FORCE_Y_NAME, OUTPUT_FILE_FORCE_Z_NAME);
+    }
+    if (cntOutFlags & CNT_OUTPUT_CONTENT::CNT_POINT) {
+        add_float3_cols("Point", OUTPUT_FILE_X_COL_NAME, OUTPUT_FILE_Y_COL_NAME, OUTPUT_FILE_Z_COL_NAME);
+    }
+    if (cntOutFlags & CNT_OUTPUT_CONTENT::NORMAL) {
+        add_float3_cols("Normal", OUTPUT_FILE_NORMAL_X_NAME, OUTPUT_FILE_NORMAL_Y_NAME, OUTPUT_FILE_NORMAL_Z_NAME);
+    }
+    if (cntOutFlags & CNT_OUTPUT_CONTENT::TORQUE) {
+        add_float3_cols("Torque", OUTPUT_FILE_TORQUE_X_NAME, OUTPUT_FILE_TORQUE_Y_NAME, OUTPUT_FILE_TORQUE_Z_NAME);
+    }
+    if (cntOutFlags & CNT_OUTPUT_CONTENT::CNT_WILDCARD) {
+        for (const auto& name : frame.contactWildcardNames) {
+            const ColumnView<const float> vals = contactInfo.Get<float>(name);
+            writer.AddColumnView(name, vals.data(), vals.size());
+        }
+    }
+    writer.Write(out);
+}
+
+// Vector point data of 3 components, gathered for the listed owners
+static std::vector<float> gatherOwnerVectors(const std::vector<float>& X,
+                                             const std::vector<float>& Y,
+                                             const std::vector<float>& Z,
+                                             const std::vector<bodyID_t>& owners) {
+    std::vector<float> res(3 * owners.size());
+    for (size_t k = 0; k < owners.size(); k++) {
+        res[3 * k] = X[owners[k]];
+        res[3 * k + 1] = Y[owners[k]];
+        res[3 * k + 2] = Z[owners[k]];
+    }
+    return res;
+}
+
+// Owner-state point data shared by VTP sphere and clump files. Vector quantities are stored as 3-component arrays,
+// named after the CSV columns without the component suffix.
+static void addOwnerStatePointData(VtkXmlWriter& writer,
+                                   const OutputFrame& frame,
+                                   const std::vector<bodyID_t>& owners) {
+    const unsigned int outFlags = frame.outFlags;
+    const size_t n = owners.size();
+    if (outFlags & OUTPUT_CONTENT::ABSV) {
+        std::vector<float> absv(n);
+        for (size_t k = 0; k < n; k++) {
+            bodyID_t o = owners[k];
+            absv[k] = length(make_float3(frame.vX[o], frame.vY[o], frame.vZ[o]));
+        }
+        writer.AddPointData("absv", std::move(absv));
+    }
+    if (outFlags & OUTPUT_CONTENT::VEL) {
+        writer.AddPointData("v", gatherOwnerVectors(frame.vX, frame.vY, frame.vZ, owners), 3);
+    }
+    if (outFlags & OUTPUT_CONTENT::ANG_VEL) {
+        writer.AddPointData("w", gatherOwnerVectors(frame.omgBarX, frame.omgBarY, frame.omgBarZ, owners), 3);
+    }
+    if (outFlags & OUTPUT_CONTENT::ABS_ACC) {
+        std::vector<float> abs_acc(n);
+        for (size_t k = 0; k < n; k++) {
+            bodyID_t o = owners[k];
+            abs_acc[k] = length(make_float3(frame.aX[o], frame.aY[o], frame.aZ[o]));
+        }
+        writer.AddPointData("abs_acc", std::move(abs_acc));
+    }
+    if (outFlags & OUTPUT_CONTENT::ACC) {
+        writer.AddPointData("a", gatherOwnerVectors(frame.aX, frame.aY, frame.aZ, owners), 3);
+    }
+    if (outFlags & OUTPUT_CONTENT::ANG_ACC) {
+        writer.AddPointData("alpha", gatherOwnerVectors(frame.alphaX, frame.alphaY, frame.alphaZ, owners), 3);
+    }
+    if (outFlags & OUTPUT_CONTENT::FAMILY) {
+        std::vector<family_t> families(n);
+        for (size_t k = 0; k < n; k++)
+            families[k] = frame.familyID[owners[k]];
+        writer.AddPointData("family", std::move(families));
+    }
+    if (outFlags & OUTPUT_CONTENT::OWNER_WILDCARD) {
+        unsigned int j = 0;
+        for (const auto& name : frame.ownerWildcardNames) {
+            const std::vector<float>& src = frame.ownerWildcards[j++];
+            std::vector<float> vals(n);
+            for (size_t k = 0; k < n; k++)
+                vals[k] = src[owners[k]];
+            writer.AddPointData(name, std::move(vals));
+        }
+    }
+}
+
+void formatSpheresAsVtp(const OutputFrame& frame, std::ostream& out) {
+    std::vector<bodyID_t> owners;
+    std::vector<float> xyz, R;
+    std::vector<std::vector<float>> geo_wildcard_vals(frame.sphereWildcards.size());
+    for (size_t i = 0; i < frame.nSpheres; i++) {
+        bodyID_t this_owner = frame.ownerClumpBody[i];
+        // If this (impl-level) family is in the no-output list, skip it
+        if (frame.familiesNoOutput.find(frame.familyID[this_owner]) != frame.familiesNoOutput.end()) {
+            continue;
+        }
+        size_t compOffset = (frame.useClumpJitify) ? frame.clumpComponentOffsetExt[i] : i;
+        float3 pos = frameSpherePos(frame, i, compOffset);
+        owners.push_back(this_owner);
+        xyz.push_back(pos.x);
+        xyz.push_back(pos.y);
+        xyz.push_back(pos.z);
+        R.push_back(frame.radiiSphere[compOffset]);
+        if (frame.outFlags & OUTPUT_CONTENT::GEO_WILDCARD) {
+            for (size_t j = 0; j < frame.sphereWildcards.size(); j++) {
+                geo_wildcard_vals[j].push_back(frame.sphereWildcards[j][i]);
+            }
+        }
+    }
+
+    VtkXmlWriter writer(VTK_XML_DATASET::POLY_DATA, frame.compressVtk);
+    writer.SetPoints(std::move(xyz));
+    writer.AddPointData(OUTPUT_FILE_R_COL_NAME, std::move(R));
+    addOwnerStatePointData(writer, frame, owners);
+    if (frame.outFlags & OUTPUT_CONTENT::GEO_WILDCARD) {
+        unsigned int j = 0;
+        for (const auto& name : frame.geoWildcardNames) {
+            writer.AddPointData(name, std::move(geo_wildcard_vals[j++]));
+        }
+    }
+    writer.Write(out);
+}
+
+void formatClumpsAsVtp(const OutputFrame& frame, std::ostream& out) {
+    std::vector<bodyID_t> owners;
+    std::vector<float> xyz, oriQ;
+    std::vector<uint32_t> clump_type;
+    for (size_t i = 0; i < frame.nOwners; i++) {
+        // i is this owner's number. And if it is not a clump, we can move on.
+        if (frame.ownerTypes[i] != OWNER_T_CLUMP)
+            continue;
+        // If this (impl-level) family is in the no-output list, skip it
+        if (frame.familiesNoOutput.find(frame.familyID[i]) != frame.familiesNoOutput.end()) {
+            continue;
+        }
+        float3 CoM = frameOwnerPos(frame, i);
+        owners.push_back((bodyID_t)i);
+        xyz.push_back(CoM.x);
+        xyz.push_back(CoM.y);
+        xyz.push_back(CoM.z);
+        oriQ.push_back(frame.oriQw[i]);
+        oriQ.push_back(frame.oriQx[i]);
+        oriQ.push_back(frame.oriQy[i]);
+        oriQ.push_back(frame.oriQz[i]);
+        // VTK has no binary string arrays, so the clump type is given as its template number
+        clump_type.push_back((uint32_t)frame.inertiaPropOffsets[i]);
+    }
+
+    VtkXmlWriter writer(VTK_XML_DATASET::POLY_DATA, frame.compressVtk);
+    writer.SetPoints(std::move(xyz));
+    // Quaternion as (w, x, y, z)
+    writer.AddPointData("Q", std::move(oriQ), 4);
+    writer.AddPointData(OUTPUT_FILE_CLUMP_TYPE_NAME, std::move(clump_type));
+    addOwnerStatePointData(writer, frame, owners);
+    writer.Write(out);
+}
+
+void formatContactsAsVtp(const OutputFrame& frame, std::ostream& out) {
+    const unsigned int cntOutFlags = frame.cntOutFlags;
+    const CompactContactInfo& contactInfo = *(frame.contactInfo);
+    if (!(cntOutFlags & CNT_OUTPUT_CONTENT::CNT_POINT)) {
+        throw std::runtime_error("VTP contact files need the contact point output (CNT_POINT) to be enabled.");
+    }
+    auto as_floats = [&](const std::string& key) {
+        const ColumnView<const float3> vals = contactInfo.Get<float3>(key);
+        std::vector<float> res(3 * vals.size());
+        std::memcpy(res.data(), vals.data(), res.size() * sizeof(float));
+        return res;
+    };
+    auto as_vector = [&](const std::string& key) {
+        const ColumnView<const bodyID_t> vals = contactInfo.Get<bodyID_t>(key);
+        return std::vector<uint32_t>(vals.begin(), vals.end());
+    };
+    static_assert(sizeof(float3) == 3 * sizeof(float), "float3 is expected to be 3 packed floats.");
+
+    VtkXmlWriter writer(VTK_XML_DATASET::POLY_DATA, frame.compressVtk);
+    writer.SetPoints(as_floats("Point"));
+    // Contact type as its code (see contact_type_out_name_map)
+    {
+        const ColumnView<const contact_t> cnt_types = contactInfo.Get<contact_t>("ContactType");
+        writer.AddPointData(OUTPUT_FILE_CNT_TYPE_NAME, std::vector<uint8_t>(cnt_types.begin(), cnt_types.end()));
+    }
+    if (cntOutFlags & CNT_OUTPUT_CONTENT::OWNER) {
+        writer.AddPointData(OUTPUT_FILE_OWNER_1_NAME, as_vector("AOwner"));
+        writer.AddPointData(OUTPUT_FILE_OWNER_2_NAME, as_vector("BOwner"));
+    }
+    if (cntOutFlags & CNT_OUTPUT_CONTENT::GEO_ID) {
+        writer.AddPointData(OUTPUT_FILE_GEO_ID_1_NAME, as_vector("AGeo"));
+        writer.AddPointData(OUTPUT_FILE_GEO_ID_2_NAME, as_vector("BGeo"));
+    }
+    if (cntOutFlags & CNT_OUTPUT_CONTENT::FORCE) {
+        writer.AddPointData("f", as_floats("Force"), 3);
+    }
+    if (cntOutFlags & CNT_OUTPUT_CONTENT::NORMAL) {
+        writer.AddPointData("n", as_floats("Normal"), 3);
+    }
+    if (cntOutFlags & CNT_OUTPUT_CONTENT::TORQUE) {
+        writer.AddPointData("torque", as_floats("Torque"), 3);
+    }
+    if (cntOutFlags & CNT_OUTPUT_CONTENT::CNT_WILDCARD) {
+        for (const auto& name : frame.contactWildcardNames) {
+            const ColumnView<const float> vals = contactInfo.Get<float>(name);
+            writer.AddPointData(name, std::vector<float>(vals.begin(), vals.end()));
+        }
+    }
+    writer.Write(out);
+}
+
+void writeOutputFrame(const OutputFrame& frame) {
+    const bool binary = (frame.format == OUTPUT_FORMAT::BINARY);
+    const bool vtp = (frame.format == OUTPUT_FORMAT::VTP);
+    std::ofstream ptFile(frame.filename, (binary || vtp) ? (std::ios::out | std::ios::binary) : std::ios::out);
+    if (!ptFile) {
+        throw std::runtime_error("Cannot open output file " + frame.filename);
+    }
+    switch (frame.type) {
+        case (OUTPUT_FRAME_TYPE::SPHERE):
+            if (vtp) {
+                formatSpheresAsVtp(frame, ptFile);
+            } else if (binary) {
+                formatSpheresAsBinary(frame, ptFile);
+            } else {
+                formatSpheresAsCsv(frame, ptFile);
+            }
+            break;
+        case (OUTPUT_FRAME_TYPE::CLUMP):
+            if (vtp) {
+                formatClumpsAsVtp(frame, ptFile);
+            } else if (binary) {
+                formatClumpsAsBinary(frame, ptFile);
+            } else {
+                formatClumpsAsCsv(frame, ptFile);
+            }
+            break;
+        case (OUTPUT_FRAME_TYPE::CONTACT):
+            if (vtp) {
+                formatContactsAsVtp(frame, ptFile);
+            } else if (binary) {
+                formatContactsAsBinary(frame, ptFile);
+            } else {
+                formatContactsAsCsv(frame, ptFile);
+            }
+            break;
+    }
+    ptFile.close();
+}
+
+// =============================================================================
+// DEMOutputWriter class
+// =============================================================================
+
+DEMOutputWriter::DEMOutputWriter(unsigned int max_queued) : m_max_queued(max_queued > 0 ? max_queued : 1) {
+    m_th = std::thread([this]() { this->workerLoop(); });
+}
+
+DEMOutputWriter::~DEMOutputWriter() {
+    {
+        std::lock_guard<std::mutex> lock(m_mtx);
+        m_should_join = true;
+    }
+    m_cv_work.notify_all();
+    // The worker drains the queue before quitting, so no submitted frame is lost
+    m_th.join();
+}
+
+std::unique_ptr<OutputFrame> DEMOutputWriter::AcquireFrame() {
+    std::lock_guard<std::mutex> lock(m_mtx);
+    if (m_free_frames.empty()) {
+        return std::make_unique<OutputFrame>();
+    }
+    std::unique_ptr<OutputFrame> frame = std::move(m_free_frames.back());
+    m_free_frames.pop_back();
+    return frame;
+}
+
+void DEMOutputWriter::Submit(std::unique_ptr<OutputFrame> frame) {
+    {
+        std::unique_lock<std::mutex> lock(m_mtx);
+        m_cv_room.wait(lock, [this]() { return m_queue.size() < m_max_queued || m_error; });
+        rethrowIfFailed();
+        m_queue.push_back(std::move(frame));
+    }
+    m_cv_work.notify_one();
+}
+
+void DEMOutputWriter::Flush() {
+    std::unique_lock<std::mutex> lock(m_mtx);
+    m_cv_room.wait(lock, [this]() { return (m_queue.empty() && !m_busy) || m_error; });
+    rethrowIfFailed();
+}
+
+void DEMOutputWriter::rethrowIfFailed() {
+    // Called with m_mtx held
+    if (m_error) {
+        std::exception_ptr err = m_error;
+        m_error = nullptr;
+        m_queue.clear();
+        std::rethrow_exception(err);
+    }
+}
+
+void DEMOutputWriter::workerLoop() {
+    while (true) {
+        std::unique_ptr<OutputFrame> frame;
+        {
+            std::unique_lock<std::mutex> lock(m_mtx);
+            m_cv_work.wait(lock, [this]() { return !m_queue.empty() || m_should_join; });
+            if (m_queue.empty()) {
+                // Only get here when asked to join and there is nothing left to write
+                return;
+            }
+            frame = std::move(m_queue.front());
+            m_queue.pop_front();
+            m_busy = true;
+        }
+        // Room is freed as soon as the frame leaves the queue
+        m_cv_room.notify_all();
+
+        try {
+            writeOutputFrame(*frame);
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(m_mtx);
+            m_error = std::current_exception();
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(m_mtx);
+            m_busy = false;
+            // Drop the contact container now, but keep the array capacities for the next frame
+            frame->contactInfo.reset();
+            m_free_frames.push_back(std::move(frame));
+        }
+        m_cv_room.notify_all();
+    }
+}
+
+}  // namespace deme
@@ -0,0 +1,135 @@
+//  Copyright (c) 2021, SBEL GPU Development Team
+//  Copyright (c) 2021, University of Wisconsin - Madison
+//
+//	SPDX-License-Identifier: BSD-3-Clause
+
+#ifndef DEME_OUTPUT_WRITER_H
+#define DEME_OUTPUT_WRITER_H
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <set>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <DEM/Defines.h>
+#include <DEM/Structs.h>
+
+namespace deme {
+
+// Which kind of output file a frame is going to
+enum class OUTPUT_FRAME_TYPE { SPHERE, CLUMP, CONTACT };
+
+/// Host-side snapshot of everything needed to format one sphere, clump or contact output file. It is filled by dT on
+/// the calling thread, after which the simulation is free to advance: formatting only ever reads from this copy.
+struct OutputFrame {
+    OUTPUT_FRAME_TYPE type = OUTPUT_FRAME_TYPE::CLUMP;
+    OUTPUT_FORMAT format = OUTPUT_FORMAT::CSV;
+    std::string filename;
+    // Output precision of clump CSV files
+    unsigned int accuracy = 10;
+    unsigned int outFlags = 0;
+    unsigned int cntOutFlags = 0;
+    // Whether VTP arrays are zlib-compressed
+    bool compressVtk = false;
+
+    // Info needed to turn voxel-based locations into coordinates
+    unsigned char nvXp2 = 0;
+    unsigned char nvYp2 = 0;
+    double voxelSize = 0.;
+    double l = 0.;
+    float LBFX = 0.f;
+    float LBFY = 0.f;
+    float LBFZ = 0.f;
+    bool useClumpJitify = false;
+
+    std::unordered_set<family_t> familiesNoOutput;
+    std::unordered_map<unsigned int, std::string> templateNumNameMap;
+    std::set<std::string> ownerWildcardNames;
+    std::set<std::string> geoWildcardNames;
+    std::set<std::string> contactWildcardNames;
+
+    // Owner states (nOwners long)
+    size_t nOwners = 0;
+    std::vector<voxelID_t> voxelID;
+    std::vector<subVoxelPos_t> locX, locY, locZ;
+    std::vector<oriQ_t> oriQw, oriQx, oriQy, oriQz;
+    std::vector<float> vX, vY, vZ;
+    std::vector<float> omgBarX, omgBarY, omgBarZ;
+    std::vector<float> aX, aY, aZ;
+    std::vector<float> alphaX, alphaY, alphaZ;
+    std::vector<family_t> familyID;
+    std::vector<ownerType_t> ownerTypes;
+    std::vector<inertiaOffset_t> inertiaPropOffsets;
+    std::vector<std::vector<float>> ownerWildcards;
+
+    // Sphere components (nSpheres long), and the component template arrays they index into
+    size_t nSpheres = 0;
+    std::vector<bodyID_t> ownerClumpBody;
+    std::vector<clumpComponentOffsetExt_t> clumpComponentOffsetExt;
+    std::vector<float> radiiSphere;
+    std::vector<float> relPosSphereX, relPosSphereY, relPosSphereZ;
+    std::vector<std::vector<float>> sphereWildcards;
+
+    // Contact output is generated as a container already, so it only needs to be held on to
+    std::shared_ptr<const CompactContactInfo> contactInfo;
+};
+
+// Format a snapshot into the stream, in the given file format
+void formatSpheresAsCsv(const OutputFrame& frame, std::ostream& out);
+void formatClumpsAsCsv(const OutputFrame& frame, std::ostream& out);
+void formatContactsAsCsv(const OutputFrame& frame, std::ostream& out);
+void formatSpheresAsBinary(const OutputFrame& frame, std::ostream& out);
+void formatClumpsAsBinary(const OutputFrame& frame, std::ostream& out);
+void formatContactsAsBinary(const OutputFrame& frame, std::ostream& out);
+void formatSpheresAsVtp(const OutputFrame& frame, std::ostream& out);
+void formatClumpsAsVtp(const OutputFrame& frame, std::ostream& out);
+void formatContactsAsVtp(const OutputFrame& frame, std::ostream& out);
+// Open frame.filename and write the frame to it according to its type and format
+void writeOutputFrame(const OutputFrame& frame);
+
+/// A background thread that formats and writes output frames while the simulation advances. Frames are recycled: a
+/// frame handed back by AcquireFrame keeps the capacity of its arrays from earlier use, so steady-state output does not
+/// allocate. At most max_queued frames wait in the queue; Submit blocks until there is room.
+class DEMOutputWriter {
+  public:
+    explicit DEMOutputWriter(unsigned int max_queued = 2);
+    ~DEMOutputWriter();
+
+    /// Get an empty frame to fill, reusing a previously written one if possible.
+    std::unique_ptr<OutputFrame> AcquireFrame();
+    /// Queue a filled frame for writing. Blocks while the queue is full.
+    void Submit(std::unique_ptr<OutputFrame> frame);
+    /// Block until all submitted frames are written to disk. Errors from the writer thread are re-thrown here.
+    void Flush();
+
+    unsigned int GetMaxQueued() const { return m_max_queued; }
+
+  private:
+    void workerLoop();
+    void rethrowIfFailed();
+
+    unsigned int m_max_queued;
+    std::deque<std::unique_ptr<OutputFrame>> m_queue;
+    std::vector<std::unique_ptr<OutputFrame>> m_free_frames;
+    // Whether the worker is writing a frame it already took off the queue
+    bool m_busy = false;
+    bool m_should_join = false;
+    std::exception_ptr m_error;
+
+    std::mutex m_mtx;
+    std::condition_variable m_cv_work;
+    std::condition_variable m_cv_room;
+    std::thread m_th;
+};
+
+}  // namespace deme
+
+#endif
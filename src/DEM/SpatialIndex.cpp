@@ -0,0 +1,182 @@
+//  Copyright (c) 2021, SBEL GPU Development Team
+//  Copyright (c) 2021, University of Wisconsin - Madison
+//
+//	SPDX-License-Identifier: BSD-3-Clause
+
+#include <DEM/SpatialIndex.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace deme {
+
+// Average number of points per grid cell the index aims for
+static constexpr double SPATIAL_INDEX_PTS_PER_CELL = 4.0;
+// Upper bound on the number of cells, so a few far-away points do not blow up memory
+static constexpr double SPATIAL_INDEX_MAX_CELLS = 1 << 24;
+
+void OwnerSpatialIndex::Clear() {
+    m_pos.clear();
+    m_ids.clear();
+    m_cell_start.clear();
+    m_dims[0] = m_dims[1] = m_dims[2] = 0;
+}
+
+void OwnerSpatialIndex::Build(std::vector<float3> pos, std::vector<bodyID_t> ids) {
+    Clear();
+    const size_t n = pos.size();
+    if (n == 0)
+        return;
+
+    float3 L = pos[0], U = pos[0];
+    for (const auto& p : pos) {
+        L.x = std::min(L.x, p.x);
+        L.y = std::min(L.y, p.y);
+        L.z = std::min(L.z, p.z);
+        U.x = std::max(U.x, p.x);
+        U.y = std::max(U.y, p.y);
+        U.z = std::max(U.z, p.z);
+    }
+    // Pick a cell size giving a few points per cell on average, assuming points roughly fill their bounding box
+    const double ext[3] = {(double)U.x - L.x, (double)U.y - L.y, (double)U.z - L.z};
+    const double max_ext = std::max(ext[0], std::max(ext[1], ext[2]));
+    double vol = 1.;
+    unsigned int n_flat = 0;
+    for (double e : ext) {
+        // A (near-)flat dimension should not make the volume vanish
+        if (e > 1e-6 * max_ext)
+            vol *= e;
+        else
+            n_flat++;
+    }
+    const unsigned int n_live_dims = 3 - n_flat;
+    double cell = (n_live_dims == 0) ? 1. : std::pow(vol * SPATIAL_INDEX_PTS_PER_CELL / n, 1. / n_live_dims);
+    auto count_cells = [&](double h) {
+        double c = 1.;
+        for (double e : ext)
+            c *= std::floor(e / h) + 1.;
+        return c;
+    };
+    while (count_cells(cell) > SPATIAL_INDEX_MAX_CELLS)
+        cell *= 1.5;
+    m_cell_size = (float)cell;
+    m_LBF = L;
+    for (int d = 0; d < 3; d++)
+        m_dims[d] = (size_t)std::floor(ext[d] / cell) + 1;
+    const size_t n_cells = m_dims[0] * m_dims[1] * m_dims[2];
+
+    // Counting sort of points into cells
+    std::vector<size_t> cell_of(n);
+    m_cell_start.assign(n_cells + 1, 0);
+    for (size_t i = 0; i < n; i++) {
+        size_t cx = std::min((size_t)((pos[i].x - L.x) / m_cell_size), m_dims[0] - 1);
+        size_t cy = std::min((size_t)((pos[i].y - L.y) / m_cell_size), m_dims[1] - 1);
+        size_t cz = std::min((size_t)((pos[i].z - L.z) / m_cell_size), m_dims[2] - 1);
+        cell_of[i] = cx + m_dims[0] * (cy + m_dims[1] * cz);
+        m_cell_start[cell_of[i] + 1]++;
+    }
+    for (size_t c = 0; c < n_cells; c++)
+        m_cell_start[c + 1] += m_cell_start[c];
+    std::vector<size_t> cursor(m_cell_start.begin(), m_cell_start.end() - 1);
+    m_pos.resize(n);
+    m_ids.resize(n);
+    for (size_t i = 0; i < n; i++) {
+        const size_t slot = cursor[cell_of[i]]++;
+        m_pos[slot] = pos[i];
+        m_ids[slot] = ids[i];
+    }
+}
+
+std::vector<bodyID_t> OwnerSpatialIndex::collectInBox(const float3& L,
+                                                      const float3& U,
+                                                      const std::function<bool(const float3&)>& pred) const {
+    std::vector<bodyID_t> res;
+    if (m_ids.empty())
+        return res;
+    const float lo[3] = {L.x - m_LBF.x, L.y - m_LBF.y, L.z - m_LBF.z};
+    const float hi[3] = {U.x - m_LBF.x, U.y - m_LBF.y, U.z - m_LBF.z};
+    size_t c_lo[3], c_hi[3];
+    for (int d = 0; d < 3; d++) {
+        if (hi[d] < 0.f || lo[d] > m_cell_size * m_dims[d] || lo[d] > hi[d])
+            return res;
+        c_lo[d] = (lo[d] <= 0.f) ? 0 : std::min((size_t)(lo[d] / m_cell_size), m_dims[d] - 1);
+        c_hi[d] = std::min((size_t)std::min(hi[d] / m_cell_size, (float)m_dims[d]), m_dims[d] - 1);
+    }
+    for (size_t cz = c_lo[2]; cz <= c_hi[2]; cz++) {
+        for (size_t cy = c_lo[1]; cy <= c_hi[1]; cy++) {
+            const size_t row = m_dims[0] * (cy + m_dims[1] * cz);
+            for (size_t i = m_cell_start[row + c_lo[0]]; i < m_cell_start[row + c_hi[0] + 1]; i++) {
+                if (pred(m_pos[i]))
+                    res.push_back(m_ids[i]);
+            }
+        }
+    }
+    std::sort(res.begin(), res.end());
+    return res;
+}
+
+std::vector<bodyID_t> OwnerSpatialIndex::QueryBox(const float3& L, const float3& U) const {
+    return collectInBox(L, U, [&](const float3& p) {
+        return p.x >= L.x && p.y >= L.y && p.z >= L.z && p.x <= U.x && p.y <= U.y && p.z <= U.z;
+    });
+}
+
+std::vector<bodyID_t> OwnerSpatialIndex::QuerySphere(const float3& center, float radius) const {
+    const float r2 = radius * radius;
+    return collectInBox(make_float3(center.x - radius, center.y - radius, center.z - radius),
+                        make_float3(center.x + radius, center.y + radius, center.z + radius), [&](const float3& p) {
+                            const float dx = p.x - center.x, dy = p.y - center.y, dz = p.z - center.z;
+                            return dx * dx + dy * dy + dz * dz <= r2;
+                        });
+}
+
+std::vector<bodyID_t> OwnerSpatialIndex::QueryCylinder(const float3& center,
+                                                       const float3& axis,
+                                                       float radius,
+                                                       float half_length) const {
+    const float len = std::sqrt(axis.x * axis.x + axis.y * axis.y + axis.z * axis.z);
+    if (len <= 0.f)
+        return std::vector<bodyID_t>();
+    const float3 a = make_float3(axis.x / len, axis.y / len, axis.z / len);
+    const float r2 = radius * radius;
+    // Bounding box of a finite cylinder: per dimension, the end caps extend by radius * sqrt(1 - a_d^2)
+    float3 L = make_float3(-DEME_HUGE_FLOAT, -DEME_HUGE_FLOAT, -DEME_HUGE_FLOAT);
+    float3 U = make_float3(DEME_HUGE_FLOAT, DEME_HUGE_FLOAT, DEME_HUGE_FLOAT);
+    if (half_length < DEME_HUGE_FLOAT) {
+        auto extent = [&](float ad) {
+            return std::abs(ad) * half_length + radius * std::sqrt(std::max(0.f, 1.f - ad * ad));
+        };
+        L = make_float3(center.x - extent(a.x), center.y - extent(a.y), center.z - extent(a.z));
+        U = make_float3(center.x + extent(a.x), center.y + extent(a.y), center.z + extent(a.z));
+    }
+    return collectInBox(L, U, [&](const float3& p) {
+        const float dx = p.x - center.x, dy = p.y - center.y, dz = p.z - center.z;
+        const float h = dx * a.x + dy * a.y + dz * a.z;
+        if (std::abs(h) > half_length)
+            return false;
+        // Perpendicular offset from the axis, computed directly to avoid cancellation far from center
+        const float px = dx - h * a.x, py = dy - h * a.y, pz = dz - h * a.z;
+        return px * px + py * py + pz * pz <= r2;
+    });
+}
+
+std::vector<bodyID_t> OwnerSpatialIndex::QueryHalfSpace(const float3& point, const float3& normal) const {
+    return collectInBox(make_float3(-DEME_HUGE_FLOAT, -DEME_HUGE_FLOAT, -DEME_HUGE_FLOAT),
+                        make_float3(DEME_HUGE_FLOAT, DEME_HUGE_FLOAT, DEME_HUGE_FLOAT), [&](const float3& p) {
+                            return (p.x - point.x) * normal.x + (p.y - point.y) * normal.y +
+                                       (p.z - point.z) * normal.z >=
+                                   0.f;
+                        });
+}
+
+std::vector<bodyID_t> OwnerSpatialIndex::QueryIf(const std::function<bool(const float3&)>& pred) const {
+    std::vector<bodyID_t> res;
+    for (size_t i = 0; i < m_ids.size(); i++) {
+        if (pred(m_pos[i]))
+            res.push_back(m_ids[i]);
+    }
+    std::sort(res.begin(), res.end());
+    return res;
+}
+
+}  // namespace deme
@@ -0,0 +1,58 @@
+//  Copyright (c) 2021, SBEL GPU Development Team
+//  Copyright (c) 2021, University of Wisconsin - Madison
+//
+//	SPDX-License-Identifier: BSD-3-Clause
+
+#ifndef DEME_SPATIAL_INDEX_H
+#define DEME_SPATIAL_INDEX_H
+
+#include <functional>
+#include <vector>
+
+#include <DEM/Defines.h>
+
+namespace deme {
+
+/// A host-side uniform grid over a set of points (owner CoMs), answering region queries without scanning all of them.
+/// Points are bucketed into cells by a counting sort, so building is O(N) and a query only visits the cells that
+/// overlap the region's bounding box. Query results are the IDs given at build time, sorted ascending.
+class OwnerSpatialIndex {
+  public:
+    /// Rebuild the index over these points. ids[i] is what queries report for pos[i].
+    void Build(std::vector<float3> pos, std::vector<bodyID_t> ids);
+    void Clear();
+    size_t Size() const { return m_ids.size(); }
+
+    /// Points inside the axis-aligned box [L, U] (inclusive).
+    std::vector<bodyID_t> QueryBox(const float3& L, const float3& U) const;
+    /// Points within radius of center.
+    std::vector<bodyID_t> QuerySphere(const float3& center, float radius) const;
+    /// Points within radius of the axis line through center, and at most half_length away from center along the axis.
+    std::vector<bodyID_t> QueryCylinder(const float3& center,
+                                        const float3& axis,
+                                        float radius,
+                                        float half_length = DEME_HUGE_FLOAT) const;
+    /// Points p satisfying dot(p - point, normal) >= 0, i.e. on the side normal points to.
+    std::vector<bodyID_t> QueryHalfSpace(const float3& point, const float3& normal) const;
+    /// Points for which pred(p) is true. This tests every point, but on the cached coordinates.
+    std::vector<bodyID_t> QueryIf(const std::function<bool(const float3&)>& pred) const;
+
+  private:
+    // Cell-sorted point coordinates and their IDs; the points of cell c are [m_cell_start[c], m_cell_start[c + 1])
+    std::vector<float3> m_pos;
+    std::vector<bodyID_t> m_ids;
+    std::vector<size_t> m_cell_start;
+    // Grid geometry
+    float3 m_LBF = make_float3(0, 0, 0);
+    float m_cell_size = 1.f;
+    size_t m_dims[3] = {0, 0, 0};
+
+    // Test every point in the cells overlapping the box [L, U] with pred
+    std::vector<bodyID_t> collectInBox(const float3& L,
+                                       const float3& U,
+                                       const std::function<bool(const float3&)>& pred) const;
+};
+
+}  // namespace deme
+
+#endif
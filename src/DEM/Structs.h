@@ -30,6 +30,8 @@
 #include <cassert>
 #include <typeinfo>
 #include <typeindex>
+#include <algorithm>
+#include <vector>
 
 namespace deme {
 
@@ -218,6 +220,11 @@ struct kTStateParams {
     // The max num of geometries in a bin that appeared in the CD process
     size_t maxSphFoundInBin;
     size_t maxTriFoundInBin;
+    // Num of sphere--bin touching pairs, of bins that have spheres, and of sphere pairs checked for contact (sum of
+    // n * (n - 1) / 2 over those bins) in the last CD process. They are what the bin size tuner models CD cost with.
+    size_t numSphBinPairs = 0;
+    size_t numActiveBins = 0;
+    size_t numPairCandidates = 0;
 
     // Num of bins, currently
     size_t numBins = 0;
@@ -265,9 +272,9 @@ enum class INSPECT_ENTITY_TYPE { SPHERE, CLUMP, MESH, MESH_FACET, EVERYTHING };
 // Which reduce operation is needed in an inspection
 enum class CUB_REDUCE_FLAVOR { NONE, MAX, MIN, SUM };
 // Format of the output files
-enum class OUTPUT_FORMAT { CSV, BINARY, CHPF };
+enum class OUTPUT_FORMAT { CSV, BINARY, CHPF, VTP };
 // Mesh output format
-enum class MESH_FORMAT { VTK, OBJ };
+enum class MESH_FORMAT { VTK, OBJ, VTU };
 // Adaptive time step size methods
 enum class ADAPT_TS_TYPE { NONE, MAX_VEL, INT_DIFF };
 
@@ -462,6 +469,46 @@ struct familyPair_t {
 
 enum class VAR_TS_STRAT { DEME_CONST, MAX_VEL, INT_GAP };
 
+// What decided the step size that the adaptive time stepper picked
+enum class TS_LIMITER { NONE, GROWTH, CFL, RAYLEIGH, HERTZ, INT_DIFF, MIN_SIZE, MAX_SIZE, CD_MARGIN };
+
+// One entry in the step size history of the adaptive time stepper
+struct TimeStepRecord {
+    // Simulation time when this step size started being used
+    double time;
+    // The step size
+    double ts;
+    // How many tries were rejected before this step size was accepted
+    unsigned int num_rejected;
+    // What decided this step size
+    TS_LIMITER limiter;
+};
+
+// Parameters of the adaptive time stepper
+struct AdaptiveTSParams {
+    // Step size bounds
+    double tsMin = 0.;
+    double tsMax = 0.;
+    // Fraction of the smallest sphere radius an owner is allowed to travel in one step
+    double cfl = 0.1;
+    // Fractions of the Rayleigh wave time and of the Hertzian contact duration that a step is allowed to be
+    double rayleighFactor = 0.2;
+    double hertzFactor = 0.05;
+    // Max ratio between two consecutive step sizes, when the step size grows
+    double maxGrowth = 1.05;
+    // Allowed position error of one step (int_diff strategy), as a fraction of the smallest sphere radius
+    double errTol = 1e-4;
+    // Max number of retries of a step (int_diff strategy) before the step is taken anyway
+    unsigned int maxRejects = 10;
+    // The following are derived from clump templates and materials at initialization.
+    // Smallest sphere radius
+    double minRadius = 0.;
+    // Smallest Rayleigh wave time (0 if unknown)
+    double rayleighTime = 0.;
+    // The Hertzian contact duration is hertzCoeff * v^(-1/5), v being the impact velocity (hertzCoeff is 0 if unknown)
+    double hertzCoeff = 0.;
+};
+
 class ClumpTemplateFlatten {
   public:
     std::vector<float>& mass;
@@ -519,10 +566,6 @@ struct SolverFlags {
     bool useForceCollectInPlace = false;
     // Max number of steps dT is allowed to be ahead of kT, even when auto-adapt is enabled
     unsigned int upperBoundFutureDrift = 5000;
-    // (targetDriftMoreThanAvg + targetDriftMultipleOfAvg * actual_dT_steps_per_kT_step) is used to calculate contact
-    // margin size
-    float targetDriftMoreThanAvg = 4.;
-    float targetDriftMultipleOfAvg = 1.1;
 
     // Whether the solver auto-update those sim params
     bool autoBinSize = true;
@@ -535,6 +578,9 @@ struct SolverFlags {
 
     // Whether there are contacts that can never be removed.
     bool hasPersistentContacts = false;
+
+    // Whether kT runs its contact detection on the host (OpenMP) rather than the device
+    bool useHostCD = false;
 };
 
 class DEMMaterial {
@@ -1113,6 +1159,260 @@ class ContactInfoContainer : public DataContainer {
     unsigned int m_cnt_out_content;
 };
 
+/// A non-owning, typed view of one column: a pointer and a length. It is resolved once, so element access is a plain
+/// array access. It is invalidated when the container it came from grows or is reconfigured.
+template <typename T>
+class ColumnView {
+  public:
+    ColumnView() = default;
+    ColumnView(T* data, size_t n) : m_data(data), m_size(n) {}
+    operator ColumnView<const T>() const { return ColumnView<const T>(m_data, m_size); }
+
+    T* data() const { return m_data; }
+    size_t size() const { return m_size; }
+    bool empty() const { return m_size == 0; }
+    T& operator[](size_t i) const { return m_data[i]; }
+    T* begin() const { return m_data; }
+    T* end() const { return m_data + m_size; }
+
+  private:
+    T* m_data = nullptr;
+    size_t m_size = 0;
+};
+
+/// Describes one column of a struct-of-arrays block.
+struct SoAColumnDesc {
+    std::string name;
+    // NumPy-style element type string ("<u4", "<f4", "|u1"...), and how many of them make up one row (3 for float3)
+    std::string dtype;
+    unsigned int components;
+    // Bytes per row
+    size_t elem_size;
+    // Byte offset of the column's first element from the block base; it is 8-byte aligned
+    size_t offset;
+};
+
+/// A non-owning view of a struct-of-arrays block: every column is contiguous and they all live in one buffer, so
+/// consumers (binary writers, Python bindings) can wrap them without copying. It is valid as long as the container it
+/// was exported from is not modified or destroyed.
+struct SoABlockView {
+    const char* base = nullptr;
+    size_t n_bytes = 0;
+    size_t n_rows = 0;
+    std::vector<SoAColumnDesc> columns;
+};
+
+/// The compact counterpart of ContactInfoContainer. It holds the same fields, but the contact type is kept as its
+/// contact_t code rather than as a string, and all columns live in one reusable buffer: re-filling it with a similar
+/// number of contacts does not allocate. Columns are accessed via type-checked ColumnViews.
+class CompactContactInfo {
+  public:
+    CompactContactInfo() = default;
+    CompactContactInfo(unsigned int cnt_out_content, const std::vector<std::string>& wildcard_names) {
+        Configure(cnt_out_content, wildcard_names);
+    }
+
+    /// Set which columns exist. If they are the same as before, this is a no-op; otherwise the contents are discarded
+    /// (but the buffer is kept).
+    void Configure(unsigned int cnt_out_content, const std::vector<std::string>& wildcard_names) {
+        if (m_configured && cnt_out_content == m_cnt_out_content && wildcard_names == m_wildcard_names)
+            return;
+        m_configured = true;
+        m_cnt_out_content = cnt_out_content;
+        m_wildcard_names = wildcard_names;
+        m_cols.clear();
+        // Same columns, in the same order, as ContactInfoContainer
+        addColumn<contact_t>("ContactType", "|u1", 1);
+        if (cnt_out_content & CNT_OUTPUT_CONTENT::CNT_POINT)
+            addColumn<float3>("Point", "<f4", 3);
+        if (cnt_out_content & CNT_OUTPUT_CONTENT::GEO_ID) {
+            addColumn<bodyID_t>("AGeo", "<u4", 1);
+            addColumn<bodyID_t>("BGeo", "<u4", 1);
+        }
+        if (cnt_out_content & CNT_OUTPUT_CONTENT::OWNER) {
+            addColumn<bodyID_t>("AOwner", "<u4", 1);
+            addColumn<bodyID_t>("BOwner", "<u4", 1);
+        }
+        addColumn<family_t>("AOwnerFamily", "|u1", 1);
+        addColumn<family_t>("BOwnerFamily", "|u1", 1);
+        if (cnt_out_content & CNT_OUTPUT_CONTENT::FORCE)
+            addColumn<float3>("Force", "<f4", 3);
+        if (cnt_out_content & CNT_OUTPUT_CONTENT::TORQUE)
+            addColumn<float3>("Torque", "<f4", 3);
+        if (cnt_out_content & CNT_OUTPUT_CONTENT::NORMAL)
+            addColumn<float3>("Normal", "<f4", 3);
+        if (cnt_out_content & CNT_OUTPUT_CONTENT::CNT_WILDCARD) {
+            for (const auto& name : wildcard_names)
+                addColumn<float>(name, "<f4", 1);
+        }
+        m_size = 0;
+        layout(m_capacity);
+    }
+
+    /// Set the number of contacts. Existing contents are preserved up to the new size; growing beyond the capacity
+    /// re-lays out the buffer, invalidating earlier ColumnViews.
+    void Resize(size_t n) {
+        if (n > m_capacity) {
+            std::vector<uint64_t> old_block;
+            std::swap(old_block, m_block);
+            std::vector<size_t> old_offsets(m_cols.size());
+            for (size_t c = 0; c < m_cols.size(); c++)
+                old_offsets[c] = m_cols[c].offset;
+            layout(std::max(n, m_capacity + m_capacity / 2));
+            const char* old_base = reinterpret_cast<const char*>(old_block.data());
+            for (size_t c = 0; c < m_cols.size(); c++) {
+                if (m_size > 0)
+                    std::memcpy(base() + m_cols[c].offset, old_base + old_offsets[c], m_size * m_cols[c].elem_size);
+            }
+        }
+        m_size = n;
+    }
+
+    size_t Size() const { return m_size; }
+    size_t Capacity() const { return m_capacity; }
+    unsigned int GetContentFlags() const { return m_cnt_out_content; }
+    const std::vector<std::string>& GetWildcardNames() const { return m_wildcard_names; }
+
+    bool Contains(const std::string& key) const { return findColumn(key) != nullptr; }
+    std::vector<std::string> keys() const {
+        std::vector<std::string> out;
+        for (const auto& col : m_cols)
+            out.push_back(col.name);
+        return out;
+    }
+
+    template <typename T>
+    ColumnView<T> Get(const std::string& key) {
+        const Column& col = checkedColumn<T>(key);
+        return ColumnView<T>(reinterpret_cast<T*>(base() + col.offset), m_size);
+    }
+    template <typename T>
+    ColumnView<const T> Get(const std::string& key) const {
+        const Column& col = checkedColumn<T>(key);
+        return ColumnView<const T>(reinterpret_cast<const T*>(base() + col.offset), m_size);
+    }
+
+    ColumnView<contact_t> GetContactType() { return Get<contact_t>("ContactType"); }
+    ColumnView<float3> GetPoint() { return Get<float3>("Point"); }
+    ColumnView<bodyID_t> GetAOwner() { return Get<bodyID_t>("AOwner"); }
+    ColumnView<bodyID_t> GetBOwner() { return Get<bodyID_t>("BOwner"); }
+    ColumnView<bodyID_t> GetAGeo() { return Get<bodyID_t>("AGeo"); }
+    ColumnView<bodyID_t> GetBGeo() { return Get<bodyID_t>("BGeo"); }
+    ColumnView<family_t> GetAOwnerFamily() { return Get<family_t>("AOwnerFamily"); }
+    ColumnView<family_t> GetBOwnerFamily() { return Get<family_t>("BOwnerFamily"); }
+    ColumnView<float3> GetForce() { return Get<float3>("Force"); }
+    ColumnView<float3> GetTorque() { return Get<float3>("Torque"); }
+    ColumnView<float3> GetNormal() { return Get<float3>("Normal"); }
+
+    /// The output name of the type of contact i (such as "SS" or "SM").
+    const std::string& GetContactTypeName(size_t i) const {
+        return contact_type_out_name_map.at(Get<contact_t>("ContactType")[i]);
+    }
+
+    /// Describe the buffer as a struct-of-arrays block, without copying anything.
+    SoABlockView ExportSoA() const {
+        SoABlockView view;
+        view.base = base();
+        view.n_bytes = m_block.size() * sizeof(uint64_t);
+        view.n_rows = m_size;
+        for (const auto& col : m_cols)
+            view.columns.push_back(SoAColumnDesc{col.name, col.dtype, col.components, col.elem_size, col.offset});
+        return view;
+    }
+
+    /// Expand into the string-keyed ContactInfoContainer, e.g. for code written against GetContactDetailedInfo.
+    std::shared_ptr<ContactInfoContainer> ToContactInfoContainer() const {
+        std::vector<std::pair<std::string, std::string>> wildcard_keys;
+        for (const auto& name : m_wildcard_names)
+            wildcard_keys.push_back({name, "float"});
+        auto info = std::make_shared<ContactInfoContainer>(m_cnt_out_content, wildcard_keys);
+        info->ResizeAll(m_size);
+        auto types = Get<contact_t>("ContactType");
+        std::vector<std::string>& type_names = info->GetContactType();
+        for (size_t i = 0; i < m_size; i++)
+            type_names[i] = contact_type_out_name_map.at(types[i]);
+        for (const auto& col : m_cols) {
+            if (col.name == "ContactType")
+                continue;
+            if (*col.type == typeid(float3)) {
+                copyInto<float3>(*info, col.name);
+            } else if (*col.type == typeid(bodyID_t)) {
+                copyInto<bodyID_t>(*info, col.name);
+            } else if (*col.type == typeid(family_t)) {
+                copyInto<family_t>(*info, col.name);
+            } else {
+                copyInto<float>(*info, col.name);
+            }
+        }
+        return info;
+    }
+
+  private:
+    struct Column {
+        std::string name;
+        const std::type_info* type;
+        std::string dtype;
+        unsigned int components;
+        size_t elem_size;
+        size_t offset;
+    };
+
+    std::vector<Column> m_cols;
+    // The columns' storage; uint64_t elements keep every column 8-byte aligned
+    std::vector<uint64_t> m_block;
+    size_t m_size = 0;
+    size_t m_capacity = 0;
+    bool m_configured = false;
+    unsigned int m_cnt_out_content = 0;
+    std::vector<std::string> m_wildcard_names;
+
+    char* base() { return reinterpret_cast<char*>(m_block.data()); }
+    const char* base() const { return reinterpret_cast<const char*>(m_block.data()); }
+
+    template <typename T>
+    void addColumn(const std::string& name, const char* dtype, unsigned int components) {
+        m_cols.push_back(Column{name, &typeid(T), dtype, components, sizeof(T), 0});
+    }
+
+    // Place the columns back to back, each padded to 8 bytes, for a capacity of n rows
+    void layout(size_t n) {
+        size_t offset = 0;
+        for (auto& col : m_cols) {
+            col.offset = offset;
+            offset += (n * col.elem_size + 7) & ~size_t(7);
+        }
+        m_block.resize(offset / sizeof(uint64_t));
+        m_capacity = n;
+    }
+
+    const Column* findColumn(const std::string& key) const {
+        for (const auto& col : m_cols) {
+            if (col.name == key)
+                return &col;
+        }
+        return nullptr;
+    }
+
+    template <typename T>
+    const Column& checkedColumn(const std::string& key) const {
+        const Column* col = findColumn(key);
+        if (!col) {
+            throw std::runtime_error("CompactContactInfo does not have field: '" + key +
+                                     "', you may need to turn on the output of this field by correctly calling "
+                                     "SetContactOutputContent before Initialize().");
+        }
+        if (*col->type != typeid(T))
+            throw std::runtime_error("Type mismatch for key: " + key);
+        return *col;
+    }
+
+    template <typename T>
+    void copyInto(ContactInfoContainer& info, const std::string& key) const {
+        auto src = Get<T>(key);
+        std::copy(src.begin(), src.end(), info.Get<T>(key).begin());
+    }
+};
+
 }  // namespace deme
 
 #endif
@@ -7,6 +7,7 @@
 #include <iostream>
 #include <thread>
 #include <algorithm>
+#include <tuple>
 
 #ifdef DEME_USE_CHPF
     #include <chpf.hpp>
@@ -16,6 +17,8 @@
 #include <DEM/dT.h>
 #include <DEM/kT.h>
 #include <DEM/HostSideHelpers.hpp>
+#include <core/utils/ColumnarBinary.hpp>
+#include <core/utils/VtkXmlWriter.hpp>
 #include <kernel/DEMHelperKernels.cuh>
 #include <DEM/Defines.h>
 
@@ -176,6 +179,161 @@ void DEMDynamicThread::migrateDataToDevice() {
     syncMemoryTransfer();
 }
 
+void DEMDynamicThread::migrateNewEntitiesToDevice(size_t nExistOwners,
+                                                  size_t nExistSpheres,
+                                                  size_t nExistFacets,
+                                                  size_t nExistContacts) {
+    // Upload [start, end) of an array; what is before start is already on device
+    auto uploadTail = [&](auto& arr, size_t start, size_t end) {
+        if (end > start)
+            arr.toDeviceAsync(streamInfo.stream, start, end - start);
+    };
+    const size_t nOwners = simParams->nOwnerBodies;
+    const size_t nSpheres = simParams->nSpheresGM;
+    const size_t nTris = simParams->nTriGM;
+
+    // New owners. Arrays not written when loading are still uploaded, so the device gets their default values.
+    uploadTail(inertiaPropOffsets, nExistOwners, nOwners);
+    uploadTail(familyID, nExistOwners, nOwners);
+    uploadTail(voxelID, nExistOwners, nOwners);
+    uploadTail(ownerTypes, nExistOwners, nOwners);
+    uploadTail(locX, nExistOwners, nOwners);
+    uploadTail(locY, nExistOwners, nOwners);
+    uploadTail(locZ, nExistOwners, nOwners);
+    uploadTail(aX, nExistOwners, nOwners);
+    uploadTail(aY, nExistOwners, nOwners);
+    uploadTail(aZ, nExistOwners, nOwners);
+    uploadTail(vX, nExistOwners, nOwners);
+    uploadTail(vY, nExistOwners, nOwners);
+    uploadTail(vZ, nExistOwners, nOwners);
+    uploadTail(oriQw, nExistOwners, nOwners);
+    uploadTail(oriQx, nExistOwners, nOwners);
+    uploadTail(oriQy, nExistOwners, nOwners);
+    uploadTail(oriQz, nExistOwners, nOwners);
+    uploadTail(omgBarX, nExistOwners, nOwners);
+    uploadTail(omgBarY, nExistOwners, nOwners);
+    uploadTail(omgBarZ, nExistOwners, nOwners);
+    uploadTail(alphaX, nExistOwners, nOwners);
+    uploadTail(alphaY, nExistOwners, nOwners);
+    uploadTail(alphaZ, nExistOwners, nOwners);
+    uploadTail(accSpecified, nExistOwners, nOwners);
+    uploadTail(angAccSpecified, nExistOwners, nOwners);
+    if (!solverFlags.useMassJitify) {
+        uploadTail(massOwnerBody, nExistOwners, nOwners);
+        uploadTail(mmiXX, nExistOwners, nOwners);
+        uploadTail(mmiYY, nExistOwners, nOwners);
+        uploadTail(mmiZZ, nExistOwners, nOwners);
+    }
+    for (unsigned int i = 0; i < simParams->nOwnerWildcards; i++) {
+        uploadTail(*ownerWildcards[i], nExistOwners, nOwners);
+    }
+
+    // New spheres
+    uploadTail(ownerClumpBody, nExistSpheres, nSpheres);
+    uploadTail(sphereMaterialOffset, nExistSpheres, nSpheres);
+    if (solverFlags.useClumpJitify) {
+        uploadTail(clumpComponentOffset, nExistSpheres, nSpheres);
+        uploadTail(clumpComponentOffsetExt, nExistSpheres, nSpheres);
+        // Template components are re-written on each load, but there are only a few of them
+        radiiSphere.toDeviceAsync(streamInfo.stream);
+        relPosSphereX.toDeviceAsync(streamInfo.stream);
+        relPosSphereY.toDeviceAsync(streamInfo.stream);
+        relPosSphereZ.toDeviceAsync(streamInfo.stream);
+    } else {
+        uploadTail(radiiSphere, nExistSpheres, nSpheres);
+        uploadTail(relPosSphereX, nExistSpheres, nSpheres);
+        uploadTail(relPosSphereY, nExistSpheres, nSpheres);
+        uploadTail(relPosSphereZ, nExistSpheres, nSpheres);
+    }
+    for (unsigned int i = 0; i < simParams->nGeoWildcards; i++) {
+        uploadTail(*sphereWildcards[i], nExistSpheres, nSpheres);
+    }
+
+    // New triangles
+    uploadTail(ownerMesh, nExistFacets, nTris);
+    uploadTail(relPosNode1, nExistFacets, nTris);
+    uploadTail(relPosNode2, nExistFacets, nTris);
+    uploadTail(relPosNode3, nExistFacets, nTris);
+    uploadTail(triMaterialOffset, nExistFacets, nTris);
+    for (unsigned int i = 0; i < simParams->nGeoWildcards; i++) {
+        uploadTail(*triWildcards[i], nExistFacets, nTris);
+    }
+
+    // Contact pairs that came with the new clumps
+    const size_t nContacts = *solverScratchSpace.numContacts;
+    uploadTail(idGeometryA, nExistContacts, nContacts);
+    uploadTail(idGeometryB, nExistContacts, nContacts);
+    uploadTail(contactType, nExistContacts, nContacts);
+    for (unsigned int i = 0; i < simParams->nContactWildcards; i++) {
+        uploadTail(*contactWildcards[i], nExistContacts, nContacts);
+    }
+
+    syncMemoryTransfer();
+}
+
+void DEMDynamicThread::reserveEntityArrays(size_t nOwners, size_t nSpheres, size_t nTris) {
+    DEME_GPU_CALL(cudaSetDevice(streamInfo.device));
+
+    familyID.reserve(nOwners);
+    voxelID.reserve(nOwners);
+    locX.reserve(nOwners);
+    locY.reserve(nOwners);
+    locZ.reserve(nOwners);
+    oriQw.reserve(nOwners);
+    oriQx.reserve(nOwners);
+    oriQy.reserve(nOwners);
+    oriQz.reserve(nOwners);
+    vX.reserve(nOwners);
+    vY.reserve(nOwners);
+    vZ.reserve(nOwners);
+    omgBarX.reserve(nOwners);
+    omgBarY.reserve(nOwners);
+    omgBarZ.reserve(nOwners);
+    aX.reserve(nOwners);
+    aY.reserve(nOwners);
+    aZ.reserve(nOwners);
+    alphaX.reserve(nOwners);
+    alphaY.reserve(nOwners);
+    alphaZ.reserve(nOwners);
+    accSpecified.reserve(nOwners);
+    angAccSpecified.reserve(nOwners);
+    ownerTypes.reserve(nOwners);
+    inertiaPropOffsets.reserve(nOwners);
+    if (!solverFlags.useMassJitify) {
+        massOwnerBody.reserve(nOwners);
+        mmiXX.reserve(nOwners);
+        mmiYY.reserve(nOwners);
+        mmiZZ.reserve(nOwners);
+    }
+    for (auto& arr : ownerWildcards) {
+        arr->reserve(nOwners);
+    }
+
+    ownerClumpBody.reserve(nSpheres);
+    sphereMaterialOffset.reserve(nSpheres);
+    if (solverFlags.useClumpJitify) {
+        clumpComponentOffset.reserve(nSpheres);
+        clumpComponentOffsetExt.reserve(nSpheres);
+    } else {
+        radiiSphere.reserve(nSpheres);
+        relPosSphereX.reserve(nSpheres);
+        relPosSphereY.reserve(nSpheres);
+        relPosSphereZ.reserve(nSpheres);
+    }
+    for (auto& arr : sphereWildcards) {
+        arr->reserve(nSpheres);
+    }
+
+    ownerMesh.reserve(nTris);
+    relPosNode1.reserve(nTris);
+    relPosNode2.reserve(nTris);
+    relPosNode3.reserve(nTris);
+    triMaterialOffset.reserve(nTris);
+    for (auto& arr : triWildcards) {
+        arr->reserve(nTris);
+    }
+}
+
 void DEMDynamicThread::migrateDeviceModifiableInfoToHost() {
     migrateClumpPosInfoToHost();
     migrateClumpHighOrderInfoToHost();
@@ -405,6 +563,623 @@ void DEMDynamicThread::changeOwnerSizes(const std::vector<bodyID_t>& IDs, const
     radiiSphere.toHost();
 }
 
+std::vector<bodyID_t> DEMDynamicThread::getMortonOwnerOrder() {
+    migrateClumpPosInfoToHost();
+    const size_t nOwners = simParams->nOwnerBodies;
+    // Only clumps are sorted, and among the slots clumps already occupy
+    std::vector<bodyID_t> clumpSlots;
+    std::vector<float3> CoMs;
+    for (size_t i = 0; i < nOwners; i++) {
+        if (ownerTypes[i] != OWNER_T_CLUMP)
+            continue;
+        float3 CoM;
+        voxelIDToPosition<float, voxelID_t, subVoxelPos_t>(CoM.x, CoM.y, CoM.z, voxelID[i], locX[i], locY[i], locZ[i],
+                                                           simParams->nvXp2, simParams->nvYp2, simParams->voxelSize,
+                                                           simParams->l);
+        clumpSlots.push_back(i);
+        CoMs.push_back(CoM);
+    }
+    const std::vector<size_t> morton = hostMortonOrder(CoMs);
+    std::vector<bodyID_t> order(nOwners);
+    for (size_t i = 0; i < nOwners; i++) {
+        order[i] = i;
+    }
+    for (size_t k = 0; k < clumpSlots.size(); k++) {
+        order[clumpSlots[k]] = clumpSlots[morton[k]];
+    }
+    return order;
+}
+
+void DEMDynamicThread::remapContactPairs(const std::vector<bodyID_t>& sphNew, const std::vector<bodyID_t>& triNew) {
+    // geo A is always a sphere; geo B is a sphere only in sphere--sphere contacts, and a triangle in sphere--mesh ones
+    const size_t nContacts = *solverScratchSpace.numContacts;
+    std::vector<bool> antisymWildcard;
+    for (const auto& name : m_contact_wildcard_names) {
+        antisymWildcard.push_back(m_antisym_wildcard_names.count(name) > 0);
+    }
+    std::vector<size_t> cntKeep;
+    cntKeep.reserve(nContacts);
+    for (size_t i = 0; i < nContacts; i++) {
+        const contact_t type = contactType[i];
+        if (type == NOT_A_CONTACT) {
+            cntKeep.push_back(i);
+            continue;
+        }
+        const bodyID_t newA = sphNew[idGeometryA[i]];
+        bodyID_t newB = idGeometryB[i];
+        if (type == SPHERE_SPHERE_CONTACT) {
+            newB = sphNew[newB];
+        } else if (type == SPHERE_MESH_CONTACT && !triNew.empty()) {
+            newB = triNew[newB];
+        }
+        if (newA == NULL_BODYID || newB == NULL_BODYID)
+            continue;
+        cntKeep.push_back(i);
+        idGeometryA[i] = newA;
+        idGeometryB[i] = newB;
+        // CD always gives sphere pairs with A < B, so the roles flip if the two changed order
+        if (type == SPHERE_SPHERE_CONTACT && idGeometryA[i] > idGeometryB[i]) {
+            std::swap(idGeometryA[i], idGeometryB[i]);
+            if (!solverFlags.useNoContactRecord) {
+                std::swap(contactPointGeometryA[i], contactPointGeometryB[i]);
+                contactForces[i] = -contactForces[i];
+                contactTorque_convToForce[i] = -contactTorque_convToForce[i];
+            }
+            for (unsigned int w = 0; w < simParams->nContactWildcards; w++) {
+                if (antisymWildcard[w])
+                    (*contactWildcards[w])[i] = -(*contactWildcards[w])[i];
+            }
+        }
+    }
+    if (cntKeep.size() == nContacts)
+        return;
+
+    // Pack the surviving pairs to the front. The contact arrays keep their capacity, as they are sized for the peak
+    // number of contacts anyway.
+    permuteHostElements(idGeometryA, cntKeep);
+    permuteHostElements(idGeometryB, cntKeep);
+    permuteHostElements(contactType, cntKeep);
+    if (!solverFlags.useNoContactRecord) {
+        permuteHostElements(contactForces, cntKeep);
+        permuteHostElements(contactTorque_convToForce, cntKeep);
+        permuteHostElements(contactPointGeometryA, cntKeep);
+        permuteHostElements(contactPointGeometryB, cntKeep);
+    }
+    for (unsigned int w = 0; w < simParams->nContactWildcards; w++) {
+        permuteHostElements(*contactWildcards[w], cntKeep);
+    }
+    *solverScratchSpace.numContacts = cntKeep.size();
+    solverScratchSpace.numContacts.toDevice();
+}
+
+void DEMDynamicThread::rebuildContactHistory(const std::vector<bodyID_t>& sphNew, const std::vector<bodyID_t>& triNew) {
+    // kT's contact history is the same contact set, sorted by geo A, and dT's arrays are that sorted by type (if pair
+    // sorting is on). Rebuild both in that relationship, so the next CD maps contact history correctly. If the user
+    // loaded contacts manually, kT builds its history from dT's arrays anyway.
+    if (solverFlags.isHistoryless || new_contacts_loaded)
+        return;
+    const size_t nContacts = *solverScratchSpace.numContacts;
+    std::vector<size_t> prevOrder(nContacts);
+    for (size_t i = 0; i < nContacts; i++) {
+        prevOrder[i] = i;
+    }
+    std::stable_sort(prevOrder.begin(), prevOrder.end(),
+                     [&](size_t a, size_t b) { return idGeometryA[a] < idGeometryA[b]; });
+    std::vector<size_t> cntOrder = prevOrder;
+    if (solverFlags.should_sort_pairs) {
+        std::stable_sort(cntOrder.begin(), cntOrder.end(),
+                         [&](size_t a, size_t b) { return contactType[a] < contactType[b]; });
+    }
+
+    std::vector<bodyID_t> prevA(nContacts), prevB(nContacts);
+    std::vector<contact_t> prevType(nContacts);
+    for (size_t k = 0; k < nContacts; k++) {
+        prevA[k] = idGeometryA[prevOrder[k]];
+        prevB[k] = idGeometryB[prevOrder[k]];
+        prevType[k] = contactType[prevOrder[k]];
+    }
+    // Persistency flags are looked up by pair, as kT's history is in its own order
+    std::vector<notStupidBool_t> prevPersistency(nContacts, CONTACT_NOT_PERSISTENT);
+    DEME_GPU_CALL(cudaSetDevice(kT->streamInfo.device));
+    if (solverFlags.hasPersistentContacts) {
+        std::vector<bodyID_t> oldA, oldB;
+        std::vector<contact_t> oldType;
+        std::vector<notStupidBool_t> oldPersistency;
+        size_t nPrevSpheres;
+        kT->getPrevContactArrays(oldA, oldB, oldType, oldPersistency, nPrevSpheres);
+        using PairKey = std::tuple<bodyID_t, bodyID_t, contact_t>;
+        std::vector<std::pair<PairKey, notStupidBool_t>> persistent;
+        for (size_t i = 0; i < oldA.size(); i++) {
+            if (oldPersistency[i] == CONTACT_NOT_PERSISTENT || oldType[i] == NOT_A_CONTACT)
+                continue;
+            bodyID_t a = sphNew[oldA[i]];
+            bodyID_t b = oldB[i];
+            if (oldType[i] == SPHERE_SPHERE_CONTACT) {
+                b = sphNew[b];
+            } else if (oldType[i] == SPHERE_MESH_CONTACT && !triNew.empty()) {
+                b = triNew[b];
+            }
+            if (a == NULL_BODYID || b == NULL_BODYID)
+                continue;
+            if (oldType[i] == SPHERE_SPHERE_CONTACT && a > b)
+                std::swap(a, b);
+            persistent.emplace_back(PairKey(a, b, oldType[i]), oldPersistency[i]);
+        }
+        std::sort(persistent.begin(), persistent.end());
+        for (size_t k = 0; k < nContacts; k++) {
+            const PairKey key(prevA[k], prevB[k], prevType[k]);
+            auto it = std::lower_bound(persistent.begin(), persistent.end(), std::make_pair(key, notStupidBool_t(0)));
+            if (it != persistent.end() && it->first == key)
+                prevPersistency[k] = it->second;
+        }
+    }
+    kT->setPrevContactArrays(prevA, prevB, prevType, prevPersistency, *kT->solverScratchSpace.numPrevSpheres);
+    DEME_GPU_CALL(cudaSetDevice(streamInfo.device));
+
+    permuteHostElements(idGeometryA, cntOrder);
+    permuteHostElements(idGeometryB, cntOrder);
+    permuteHostElements(contactType, cntOrder);
+    if (!solverFlags.useNoContactRecord) {
+        permuteHostElements(contactForces, cntOrder);
+        permuteHostElements(contactTorque_convToForce, cntOrder);
+        permuteHostElements(contactPointGeometryA, cntOrder);
+        permuteHostElements(contactPointGeometryB, cntOrder);
+    }
+    for (unsigned int w = 0; w < simParams->nContactWildcards; w++) {
+        permuteHostElements(*contactWildcards[w], cntOrder);
+    }
+}
+
+void DEMDynamicThread::reorderOwners(const std::vector<bodyID_t>& order) {
+    // Set the gpu for this thread
+    DEME_GPU_CALL(cudaSetDevice(streamInfo.device));
+    const size_t nOwners = simParams->nOwnerBodies;
+    const size_t nSpheres = simParams->nSpheresGM;
+    if (order.size() != nOwners) {
+        DEME_ERROR("Owner reordering needs an order of length %zu (the number of owners), but got %zu.", nOwners,
+                   order.size());
+    }
+    // ownerNew maps current owner IDs to their new positions
+    std::vector<bodyID_t> ownerNew(nOwners, NULL_BODYID);
+    for (size_t k = 0; k < nOwners; k++) {
+        if (order[k] >= nOwners || ownerNew[order[k]] != NULL_BODYID) {
+            DEME_ERROR("Owner reordering was given an order that is not a permutation of the %zu owners.", nOwners);
+        }
+        if (order[k] != k && (ownerTypes[k] != OWNER_T_CLUMP || ownerTypes[order[k]] != OWNER_T_CLUMP)) {
+            DEME_ERROR("Owner reordering can only move clumps to where clumps are, but owner %zu breaks that.",
+                       (size_t)order[k]);
+        }
+        ownerNew[order[k]] = k;
+    }
+
+    // Anything kT has produced must be taken in first, as it refers to the current numbering
+    ifProduceFreshThenUseIt();
+    migrateDeviceModifiableInfoToHost();
+    accSpecified.toHost();
+    angAccSpecified.toHost();
+
+    // Spheres go along with their owners: grouped by the owner's new position, keeping their relative order
+    std::vector<bodyID_t> sphOrder(nSpheres);
+    {
+        std::vector<size_t> ownerSphStart(nOwners + 1, 0);
+        for (size_t i = 0; i < nSpheres; i++) {
+            ownerSphStart[ownerNew[ownerClumpBody[i]] + 1]++;
+        }
+        for (size_t k = 0; k < nOwners; k++) {
+            ownerSphStart[k + 1] += ownerSphStart[k];
+        }
+        for (size_t i = 0; i < nSpheres; i++) {
+            sphOrder[ownerSphStart[ownerNew[ownerClumpBody[i]]]++] = i;
+        }
+    }
+    std::vector<bodyID_t> sphNew(nSpheres);
+    for (size_t k = 0; k < nSpheres; k++) {
+        sphNew[sphOrder[k]] = k;
+    }
+
+    // Owner arrays
+    permuteHostElements(familyID, order);
+    permuteHostElements(voxelID, order);
+    permuteHostElements(locX, order);
+    permuteHostElements(locY, order);
+    permuteHostElements(locZ, order);
+    permuteHostElements(oriQw, order);
+    permuteHostElements(oriQx, order);
+    permuteHostElements(oriQy, order);
+    permuteHostElements(oriQz, order);
+    permuteHostElements(vX, order);
+    permuteHostElements(vY, order);
+    permuteHostElements(vZ, order);
+    permuteHostElements(omgBarX, order);
+    permuteHostElements(omgBarY, order);
+    permuteHostElements(omgBarZ, order);
+    permuteHostElements(aX, order);
+    permuteHostElements(aY, order);
+    permuteHostElements(aZ, order);
+    permuteHostElements(alphaX, order);
+    permuteHostElements(alphaY, order);
+    permuteHostElements(alphaZ, order);
+    permuteHostElements(accSpecified, order);
+    permuteHostElements(angAccSpecified, order);
+    permuteHostElements(ownerTypes, order);
+    permuteHostElements(inertiaPropOffsets, order);
+    if (!solverFlags.useMassJitify) {
+        permuteHostElements(massOwnerBody, order);
+        permuteHostElements(mmiXX, order);
+        permuteHostElements(mmiYY, order);
+        permuteHostElements(mmiZZ, order);
+    }
+    for (unsigned int j = 0; j < simParams->nOwnerWildcards; j++) {
+        permuteHostElements(*ownerWildcards[j], order);
+    }
+
+    // Sphere arrays
+    permuteHostElements(ownerClumpBody, sphOrder);
+    for (size_t i = 0; i < nSpheres; i++) {
+        ownerClumpBody[i] = ownerNew[ownerClumpBody[i]];
+    }
+    permuteHostElements(sphereMaterialOffset, sphOrder);
+    if (solverFlags.useClumpJitify) {
+        permuteHostElements(clumpComponentOffset, sphOrder);
+        permuteHostElements(clumpComponentOffsetExt, sphOrder);
+    } else {
+        permuteHostElements(radiiSphere, sphOrder);
+        permuteHostElements(relPosSphereX, sphOrder);
+        permuteHostElements(relPosSphereY, sphOrder);
+        permuteHostElements(relPosSphereZ, sphOrder);
+    }
+    for (unsigned int j = 0; j < simParams->nGeoWildcards; j++) {
+        permuteHostElements(*sphereWildcards[j], sphOrder);
+    }
+
+    // Contact pairs, and kT's contact history, follow the spheres
+    remapContactPairs(sphNew, {});
+    rebuildContactHistory(sphNew, {});
+
+    // Everything goes back to device
+    familyID.toDevice();
+    voxelID.toDevice();
+    locX.toDevice();
+    locY.toDevice();
+    locZ.toDevice();
+    oriQw.toDevice();
+    oriQx.toDevice();
+    oriQy.toDevice();
+    oriQz.toDevice();
+    vX.toDevice();
+    vY.toDevice();
+    vZ.toDevice();
+    omgBarX.toDevice();
+    omgBarY.toDevice();
+    omgBarZ.toDevice();
+    aX.toDevice();
+    aY.toDevice();
+    aZ.toDevice();
+    alphaX.toDevice();
+    alphaY.toDevice();
+    alphaZ.toDevice();
+    accSpecified.toDevice();
+    angAccSpecified.toDevice();
+    ownerTypes.toDevice();
+    inertiaPropOffsets.toDevice();
+    if (!solverFlags.useMassJitify) {
+        massOwnerBody.toDevice();
+        mmiXX.toDevice();
+        mmiYY.toDevice();
+        mmiZZ.toDevice();
+    }
+    for (unsigned int j = 0; j < simParams->nOwnerWildcards; j++) {
+        ownerWildcards[j]->toDevice();
+    }
+    ownerClumpBody.toDevice();
+    sphereMaterialOffset.toDevice();
+    if (solverFlags.useClumpJitify) {
+        clumpComponentOffset.toDevice();
+        clumpComponentOffsetExt.toDevice();
+    } else {
+        radiiSphere.toDevice();
+        relPosSphereX.toDevice();
+        relPosSphereY.toDevice();
+        relPosSphereZ.toDevice();
+    }
+    for (unsigned int j = 0; j < simParams->nGeoWildcards; j++) {
+        sphereWildcards[j]->toDevice();
+    }
+    idGeometryA.toDevice();
+    idGeometryB.toDevice();
+    contactType.toDevice();
+    contactForces.toDevice();
+    contactTorque_convToForce.toDevice();
+    contactPointGeometryA.toDevice();
+    contactPointGeometryB.toDevice();
+    for (unsigned int w = 0; w < simParams->nContactWildcards; w++) {
+        contactWildcards[w]->toDevice();
+    }
+
+    DEME_GPU_CALL(cudaSetDevice(kT->streamInfo.device));
+    kT->reorderOwners(order, sphOrder, ownerNew);
+    DEME_GPU_CALL(cudaSetDevice(streamInfo.device));
+
+    // Then the user-facing IDs follow the entities to their new places
+    const auto updateIDMaps = [](std::vector<bodyID_t>& userToImpl, std::vector<bodyID_t>& implToUser,
+                                 const std::vector<bodyID_t>& newOrder) {
+        const size_t n = newOrder.size();
+        for (size_t i = implToUser.size(); i < n; i++) {
+            implToUser.push_back(i);
+        }
+        std::vector<bodyID_t> newImplToUser(n);
+        for (size_t k = 0; k < n; k++) {
+            newImplToUser[k] = implToUser[newOrder[k]];
+        }
+        implToUser = std::move(newImplToUser);
+        userToImpl.assign(n, 0);
+        for (size_t k = 0; k < n; k++) {
+            userToImpl[implToUser[k]] = k;
+        }
+    };
+    updateIDMaps(ownerUserToImpl, ownerImplToUser, order);
+    updateIDMaps(sphereUserToImpl, sphereImplToUser, sphOrder);
+    ownerMapVersion++;
+
+    syncMemoryTransfer();
+    // The contact pairs are still valid, but kT must run CD with the new numbering before dT uses them again
+    announceCritical();
+}
+
+size_t DEMDynamicThread::purgeFamily(family_t family,
+                                     std::vector<bodyID_t>& ownerUserNew,
+                                     std::vector<bodyID_t>& sphUserNew,
+                                     std::vector<bodyID_t>& triNew) {
+    // Set the gpu for this thread
+    DEME_GPU_CALL(cudaSetDevice(streamInfo.device));
+    const size_t nOwners = simParams->nOwnerBodies;
+    const size_t nSpheres = simParams->nSpheresGM;
+    const size_t nTris = simParams->nTriGM;
+
+    // Anything kT has produced must be taken in first, as it refers to the current numbering
+    ifProduceFreshThenUseIt();
+    migrateDeviceModifiableInfoToHost();
+    accSpecified.toHost();
+    angAccSpecified.toHost();
+
+    // Owners that stay are gathered in user-facing ID order, so user-facing IDs are array positions again afterwards
+    std::vector<bodyID_t> ownerOrder;
+    std::vector<bodyID_t> ownerNew(nOwners, NULL_BODYID);
+    ownerUserNew.assign(nOwners, NULL_BODYID);
+    size_t nClumpsRemoved = 0, nMeshesRemoved = 0;
+    for (size_t u = 0; u < nOwners; u++) {
+        const bodyID_t i = ownerImplID(u);
+        if (familyID[i] == family) {
+            if (ownerTypes[i] == OWNER_T_ANALYTICAL) {
+                DEME_ERROR(
+                    "Family %u has an analytical object (owner %zu) in it, which cannot be purged as analytical "
+                    "objects are compiled into the kernels.\nConsider re-initializing the system instead.",
+                    (unsigned int)family, u);
+            }
+            nClumpsRemoved += (ownerTypes[i] == OWNER_T_CLUMP);
+            nMeshesRemoved += (ownerTypes[i] == OWNER_T_MESH);
+            continue;
+        }
+        ownerNew[i] = ownerOrder.size();
+        ownerUserNew[u] = ownerOrder.size();
+        ownerOrder.push_back(i);
+    }
+    const size_t nRemoved = nOwners - ownerOrder.size();
+    if (nRemoved == 0) {
+        sphUserNew.resize(nSpheres);
+        for (size_t i = 0; i < nSpheres; i++) {
+            sphUserNew[i] = i;
+        }
+        triNew.resize(nTris);
+        for (size_t i = 0; i < nTris; i++) {
+            triNew[i] = i;
+        }
+        return 0;
+    }
+    // Spheres and triangles go with their owners, keeping their order
+    std::vector<bodyID_t> sphOrder;
+    std::vector<bodyID_t> sphNew(nSpheres, NULL_BODYID);
+    sphUserNew.assign(nSpheres, NULL_BODYID);
+    for (size_t u = 0; u < nSpheres; u++) {
+        const bodyID_t i = sphereImplID(u);
+        if (ownerNew[ownerClumpBody[i]] == NULL_BODYID)
+            continue;
+        sphNew[i] = sphOrder.size();
+        sphUserNew[u] = sphOrder.size();
+        sphOrder.push_back(i);
+    }
+    std::vector<bodyID_t> triOrder;
+    triNew.assign(nTris, NULL_BODYID);
+    for (size_t i = 0; i < nTris; i++) {
+        if (ownerNew[ownerMesh[i]] == NULL_BODYID)
+            continue;
+        triNew[i] = triOrder.size();
+        triOrder.push_back(i);
+    }
+
+    // Owner arrays
+    compactHostElements(familyID, ownerOrder);
+    compactHostElements(voxelID, ownerOrder);
+    compactHostElements(locX, ownerOrder);
+    compactHostElements(locY, ownerOrder);
+    compactHostElements(locZ, ownerOrder);
+    compactHostElements(oriQw, ownerOrder);
+    compactHostElements(oriQx, ownerOrder);
+    compactHostElements(oriQy, ownerOrder);
+    compactHostElements(oriQz, ownerOrder);
+    compactHostElements(vX, ownerOrder);
+    compactHostElements(vY, ownerOrder);
+    compactHostElements(vZ, ownerOrder);
+    compactHostElements(omgBarX, ownerOrder);
+    compactHostElements(omgBarY, ownerOrder);
+    compactHostElements(omgBarZ, ownerOrder);
+    compactHostElements(aX, ownerOrder);
+    compactHostElements(aY, ownerOrder);
+    compactHostElements(aZ, ownerOrder);
+    compactHostElements(alphaX, ownerOrder);
+    compactHostElements(alphaY, ownerOrder);
+    compactHostElements(alphaZ, ownerOrder);
+    compactHostElements(accSpecified, ownerOrder);
+    compactHostElements(angAccSpecified, ownerOrder);
+    compactHostElements(ownerTypes, ownerOrder);
+    compactHostElements(inertiaPropOffsets, ownerOrder);
+    if (!solverFlags.useMassJitify) {
+        compactHostElements(massOwnerBody, ownerOrder);
+        compactHostElements(mmiXX, ownerOrder);
+        compactHostElements(mmiYY, ownerOrder);
+        compactHostElements(mmiZZ, ownerOrder);
+    }
+    for (unsigned int j = 0; j < simParams->nOwnerWildcards; j++) {
+        compactHostElements(*ownerWildcards[j], ownerOrder);
+    }
+
+    // Sphere arrays
+    compactHostElements(ownerClumpBody, sphOrder);
+    for (size_t i = 0; i < sphOrder.size(); i++) {
+        ownerClumpBody[i] = ownerNew[ownerClumpBody[i]];
+    }
+    compactHostElements(sphereMaterialOffset, sphOrder);
+    if (solverFlags.useClumpJitify) {
+        compactHostElements(clumpComponentOffset, sphOrder);
+        compactHostElements(clumpComponentOffsetExt, sphOrder);
+    } else {
+        compactHostElements(radiiSphere, sphOrder);
+        compactHostElements(relPosSphereX, sphOrder);
+        compactHostElements(relPosSphereY, sphOrder);
+        compactHostElements(relPosSphereZ, sphOrder);
+    }
+    for (unsigned int j = 0; j < simParams->nGeoWildcards; j++) {
+        compactHostElements(*sphereWildcards[j], sphOrder);
+    }
+
+    // Triangle arrays
+    compactHostElements(ownerMesh, triOrder);
+    for (size_t i = 0; i < triOrder.size(); i++) {
+        ownerMesh[i] = ownerNew[ownerMesh[i]];
+    }
+    compactHostElements(relPosNode1, triOrder);
+    compactHostElements(relPosNode2, triOrder);
+    compactHostElements(relPosNode3, triOrder);
+    compactHostElements(triMaterialOffset, triOrder);
+    for (unsigned int j = 0; j < simParams->nGeoWildcards; j++) {
+        compactHostElements(*triWildcards[j], triOrder);
+    }
+
+    // Analytical components all stay, but their owners may have moved
+    for (size_t i = 0; i < simParams->nAnalGM; i++) {
+        ownerAnalBody[i] = ownerNew[ownerAnalBody[i]];
+    }
+
+    // Contact pairs involving removed geometries are dropped, and kT's contact history is rebuilt from what is left
+    remapContactPairs(sphNew, triNew);
+    rebuildContactHistory(sphNew, triNew);
+
+    simParams->nOwnerBodies = ownerOrder.size();
+    simParams->nOwnerClumps -= nClumpsRemoved;
+    simParams->nTriMeshes -= nMeshesRemoved;
+    simParams->nSpheresGM = sphOrder.size();
+    simParams->nTriGM = triOrder.size();
+    simParams.toDevice();
+
+    // Everything goes back to device
+    familyID.toDevice();
+    voxelID.toDevice();
+    locX.toDevice();
+    locY.toDevice();
+    locZ.toDevice();
+    oriQw.toDevice();
+    oriQx.toDevice();
+    oriQy.toDevice();
+    oriQz.toDevice();
+    vX.toDevice();
+    vY.toDevice();
+    vZ.toDevice();
+    omgBarX.toDevice();
+    omgBarY.toDevice();
+    omgBarZ.toDevice();
+    aX.toDevice();
+    aY.toDevice();
+    aZ.toDevice();
+    alphaX.toDevice();
+    alphaY.toDevice();
+    alphaZ.toDevice();
+    accSpecified.toDevice();
+    angAccSpecified.toDevice();
+    ownerTypes.toDevice();
+    inertiaPropOffsets.toDevice();
+    if (!solverFlags.useMassJitify) {
+        massOwnerBody.toDevice();
+        mmiXX.toDevice();
+        mmiYY.toDevice();
+        mmiZZ.toDevice();
+    }
+    for (unsigned int j = 0; j < simParams->nOwnerWildcards; j++) {
+        ownerWildcards[j]->toDevice();
+    }
+    ownerClumpBody.toDevice();
+    sphereMaterialOffset.toDevice();
+    if (solverFlags.useClumpJitify) {
+        clumpComponentOffset.toDevice();
+        clumpComponentOffsetExt.toDevice();
+    } else {
+        radiiSphere.toDevice();
+        relPosSphereX.toDevice();
+        relPosSphereY.toDevice();
+        relPosSphereZ.toDevice();
+    }
+    ownerMesh.toDevice();
+    relPosNode1.toDevice();
+    relPosNode2.toDevice();
+    relPosNode3.toDevice();
+    triMaterialOffset.toDevice();
+    for (unsigned int j = 0; j < simParams->nGeoWildcards; j++) {
+        sphereWildcards[j]->toDevice();
+        triWildcards[j]->toDevice();
+    }
+    ownerAnalBody.toDevice();
+    idGeometryA.toDevice();
+    idGeometryB.toDevice();
+    contactType.toDevice();
+    contactForces.toDevice();
+    contactTorque_convToForce.toDevice();
+    contactPointGeometryA.toDevice();
+    contactPointGeometryB.toDevice();
+    for (unsigned int w = 0; w < simParams->nContactWildcards; w++) {
+        contactWildcards[w]->toDevice();
+    }
+    // Shrunk arrays live at new device addresses
+    granData.toDevice();
+
+    DEME_GPU_CALL(cudaSetDevice(kT->streamInfo.device));
+    kT->purgeOwners(ownerOrder, sphOrder, triOrder, ownerNew, simParams->nOwnerClumps, simParams->nTriMeshes);
+    DEME_GPU_CALL(cudaSetDevice(streamInfo.device));
+
+    // Cached meshes that are gone are marked with a NULL owner; the rest learn their new owner and cache positions
+    {
+        std::vector<std::shared_ptr<DEMMeshConnected>> keptMeshes;
+        for (auto& mmesh : m_meshes) {
+            mmesh->owner = ownerNew[mmesh->owner];
+            if (mmesh->owner == NULL_BODYID)
+                continue;
+            mmesh->cache_offset = keptMeshes.size();
+            keptMeshes.push_back(mmesh);
+        }
+        m_meshes = std::move(keptMeshes);
+    }
+
+    // As the survivors are in user-facing ID order, the ID maps are identity now
+    ownerUserToImpl.clear();
+    ownerImplToUser.clear();
+    sphereUserToImpl.clear();
+    sphereImplToUser.clear();
+    ownerMapVersion++;
+
+    syncMemoryTransfer();
+    // kT must run CD with the new numbering before dT uses the contact pairs again
+    announceCritical();
+    return nRemoved;
+}
+
 void DEMDynamicThread::allocateGPUArrays(size_t nOwnerBodies,
                                          size_t nOwnerClumps,
                                          unsigned int nExtObj,
@@ -532,27 +1307,30 @@ void DEMDynamicThread::allocateGPUArrays(size_t nOwnerBodies,
             DEME_DUAL_ARRAY_RESIZE(contactPointGeometryA, cnt_arr_size, make_float3(0));
             DEME_DUAL_ARRAY_RESIZE(contactPointGeometryB, cnt_arr_size, make_float3(0));
         }
-        // Allocate memory for each wildcard array
+        // Allocate memory for each wildcard array. Existing ones are resized rather than re-created, so the values
+        // of the entities already in the simulation survive UpdateClumps.
         contactWildcards.resize(simParams->nContactWildcards);
         ownerWildcards.resize(simParams->nOwnerWildcards);
         sphereWildcards.resize(simParams->nGeoWildcards);
         analWildcards.resize(simParams->nGeoWildcards);
         triWildcards.resize(simParams->nGeoWildcards);
+        auto allocWildcard = [&](std::unique_ptr<DualArray<float>>& arr, size_t n) {
+            if (arr) {
+                DEME_DUAL_ARRAY_RESIZE((*arr), n, 0);
+            } else {
+                arr = std::make_unique<DualArray<float>>(n, 0, &m_approxHostBytesUsed, &m_approxDeviceBytesUsed);
+            }
+        };
         for (unsigned int i = 0; i < simParams->nContactWildcards; i++) {
-            contactWildcards[i] =
-                std::make_unique<DualArray<float>>(cnt_arr_size, 0, &m_approxHostBytesUsed, &m_approxDeviceBytesUsed);
+            allocWildcard(contactWildcards[i], cnt_arr_size);
         }
         for (unsigned int i = 0; i < simParams->nOwnerWildcards; i++) {
-            ownerWildcards[i] =
-                std::make_unique<DualArray<float>>(nOwnerBodies, 0, &m_approxHostBytesUsed, &m_approxDeviceBytesUsed);
+            allocWildcard(ownerWildcards[i], nOwnerBodies);
         }
         for (unsigned int i = 0; i < simParams->nGeoWildcards; i++) {
-            sphereWildcards[i] =
-                std::make_unique<DualArray<float>>(nSpheresGM, 0, &m_approxHostBytesUsed, &m_approxDeviceBytesUsed);
-            analWildcards[i] =
-                std::make_unique<DualArray<float>>(nAnalGM, 0, &m_approxHostBytesUsed, &m_approxDeviceBytesUsed);
-            triWildcards[i] =
-                std::make_unique<DualArray<float>>(nTriGM, 0, &m_approxHostBytesUsed, &m_approxDeviceBytesUsed);
+            allocWildcard(sphereWildcards[i], nSpheresGM);
+            allocWildcard(analWildcards[i], nAnalGM);
+            allocWildcard(triWildcards[i], nTriGM);
         }
     }
 
@@ -1118,6 +1896,13 @@ void DEMDynamicThread::initGPUArrays(const std::vector<std::shared_ptr<DEMClumpB
     registerPolicies(template_number_name_map, clump_templates, ext_obj_mass_types, ext_obj_moi_types,
                      mesh_obj_mass_types, mesh_obj_moi_types, loaded_materials, family_mask_matrix, no_output_families);
 
+    // A fresh start: wildcard values the user does not specify are 0, even if the arrays held something before
+    for (auto* wildcards : {&contactWildcards, &ownerWildcards, &sphereWildcards, &analWildcards, &triWildcards}) {
+        for (auto& arr : *wildcards) {
+            std::fill(arr->getHostVector().begin(), arr->getHostVector().end(), 0);
+        }
+    }
+
     // For initialization, owner array offset is 0
     populateEntityArrays(input_clump_batches, input_ext_obj_xyz, input_ext_obj_rot, input_ext_obj_family,
                          input_mesh_objs, input_mesh_obj_xyz, input_mesh_obj_rot, input_mesh_obj_family,
@@ -1188,7 +1973,8 @@ void DEMDynamicThread::writeSpheresAsChpf(std::ofstream& ptFile) {
     }
     size_t num_output_spheres = 0;
 
-    for (size_t i = 0; i < simParams->nSpheresGM; i++) {
+    for (size_t u = 0; u < simParams->nSpheresGM; u++) {
+        const bodyID_t i = sphereImplID(u);
         auto this_owner = ownerClumpBody[i];
         family_t this_family = familyID[this_owner];
         // If this (impl-level) family is in the no-output list, skip it
@@ -1250,156 +2036,127 @@ void DEMDynamicThread::writeSpheresAsChpf(std::ofstream& ptFile) {
 }
 #endif
 
-void DEMDynamicThread::writeSpheresAsCsv(std::ofstream& ptFile) {
-    std::ostringstream outstrstream;
+template <typename T>
+inline void snapshotHostArray(std::vector<T>& dst, DualArray<T>& src, size_t n) {
+    dst.assign(src.host(), src.host() + n);
+}
+
+// Snapshot in user-facing order, if the entities have been reordered internally
+template <typename T>
+inline void snapshotHostArray(std::vector<T>& dst,
+                              DualArray<T>& src,
+                              size_t n,
+                              const std::vector<bodyID_t>& userToImpl) {
+    if (userToImpl.empty()) {
+        snapshotHostArray(dst, src, n);
+        return;
+    }
+    dst.resize(n);
+    for (size_t u = 0; u < n; u++) {
+        dst[u] = src[(u < userToImpl.size()) ? userToImpl[u] : u];
+    }
+}
+
+void DEMDynamicThread::snapshotOutputFrame(OutputFrame& frame, OUTPUT_FRAME_TYPE type, float force_thres) {
+    frame.type = type;
+    frame.outFlags = solverFlags.outputFlags;
+    frame.cntOutFlags = solverFlags.cntOutFlags;
+    frame.compressVtk = compressVtk;
+    frame.contactWildcardNames = m_contact_wildcard_names;
+    if (type == OUTPUT_FRAME_TYPE::CONTACT) {
+        // The contact info container is already a self-contained host copy
+        frame.contactInfo = generateCompactContactInfo(force_thres);
+        return;
+    }
 
     migrateFamilyToHost();
     migrateClumpPosInfoToHost();
     migrateClumpHighOrderInfoToHost();
     migrateOwnerWildcardToHost();
-    migrateSphGeoWildcardToHost();
-
-    outstrstream << OUTPUT_FILE_X_COL_NAME + "," + OUTPUT_FILE_Y_COL_NAME + "," + OUTPUT_FILE_Z_COL_NAME + "," +
-                        OUTPUT_FILE_R_COL_NAME;
-
-    if (solverFlags.outputFlags & OUTPUT_CONTENT::ABSV) {
-        outstrstream << ",absv";
-    }
-    if (solverFlags.outputFlags & OUTPUT_CONTENT::VEL) {
-        outstrstream << "," + OUTPUT_FILE_VEL_X_COL_NAME + "," + OUTPUT_FILE_VEL_Y_COL_NAME + "," +
-                            OUTPUT_FILE_VEL_Z_COL_NAME;
-    }
-    if (solverFlags.outputFlags & OUTPUT_CONTENT::ANG_VEL) {
-        outstrstream << "," + OUTPUT_FILE_ANGVEL_X_COL_NAME + "," + OUTPUT_FILE_ANGVEL_Y_COL_NAME + "," +
-                            OUTPUT_FILE_ANGVEL_Z_COL_NAME;
-    }
-    if (solverFlags.outputFlags & OUTPUT_CONTENT::ABS_ACC) {
-        outstrstream << ",abs_acc";
-    }
-    if (solverFlags.outputFlags & OUTPUT_CONTENT::ACC) {
-        outstrstream << ",a_x,a_y,a_z";
-    }
-    if (solverFlags.outputFlags & OUTPUT_CONTENT::ANG_ACC) {
-        outstrstream << ",alpha_x,alpha_y,alpha_z";
-    }
-    if (solverFlags.outputFlags & OUTPUT_CONTENT::FAMILY) {
-        outstrstream << ",family";
-    }
-    // if (solverFlags.outputFlags & OUTPUT_CONTENT::MAT) {
-    //     outstrstream << ",material";
-    // }
-    if (solverFlags.outputFlags & OUTPUT_CONTENT::OWNER_WILDCARD) {
-        for (const auto& name : m_owner_wildcard_names) {
-            outstrstream << "," + name;
-        }
-    }
-    if (solverFlags.outputFlags & OUTPUT_CONTENT::GEO_WILDCARD) {
-        for (const auto& name : m_geo_wildcard_names) {
-            outstrstream << "," + name;
-        }
-    }
 
-    outstrstream << "\n";
+    frame.nvXp2 = simParams->nvXp2;
+    frame.nvYp2 = simParams->nvYp2;
+    frame.voxelSize = simParams->voxelSize;
+    frame.l = simParams->l;
+    frame.LBFX = simParams->LBFX;
+    frame.LBFY = simParams->LBFY;
+    frame.LBFZ = simParams->LBFZ;
+    frame.useClumpJitify = solverFlags.useClumpJitify;
+    frame.familiesNoOutput = familiesNoOutput;
+    frame.templateNumNameMap = templateNumNameMap;
+    frame.ownerWildcardNames = m_owner_wildcard_names;
+    frame.geoWildcardNames = m_geo_wildcard_names;
 
     // simParams host version should not be different from device version, so no need to update
-    for (size_t i = 0; i < simParams->nSpheresGM; i++) {
-        auto this_owner = ownerClumpBody[i];
-        family_t this_family = familyID[this_owner];
-        // If this (impl-level) family is in the no-output list, skip it
-        if (familiesNoOutput.find(this_family) != familiesNoOutput.end()) {
-            continue;
-        }
-
-        float3 CoM;
-        float3 pos;
-        float radius;
-        float X, Y, Z;
-        voxelID_t voxel = voxelID[this_owner];
-        subVoxelPos_t subVoxX = locX[this_owner];
-        subVoxelPos_t subVoxY = locY[this_owner];
-        subVoxelPos_t subVoxZ = locZ[this_owner];
-        voxelIDToPosition<float, voxelID_t, subVoxelPos_t>(X, Y, Z, voxel, subVoxX, subVoxY, subVoxZ, simParams->nvXp2,
-                                                           simParams->nvYp2, simParams->voxelSize, simParams->l);
-        CoM.x = X + simParams->LBFX;
-        CoM.y = Y + simParams->LBFY;
-        CoM.z = Z + simParams->LBFZ;
-
-        size_t compOffset = (solverFlags.useClumpJitify) ? clumpComponentOffsetExt[i] : i;
-        float3 this_sp_deviation;
-        this_sp_deviation.x = relPosSphereX[compOffset];
-        this_sp_deviation.y = relPosSphereY[compOffset];
-        this_sp_deviation.z = relPosSphereZ[compOffset];
-        float this_sp_rot_0 = oriQw[this_owner];
-        float this_sp_rot_1 = oriQx[this_owner];
-        float this_sp_rot_2 = oriQy[this_owner];
-        float this_sp_rot_3 = oriQz[this_owner];
-        applyOriQToVector3<float, float>(this_sp_deviation.x, this_sp_deviation.y, this_sp_deviation.z, this_sp_rot_0,
-                                         this_sp_rot_1, this_sp_rot_2, this_sp_rot_3);
-        pos = CoM + this_sp_deviation;
-        outstrstream << pos.x << "," << pos.y << "," << pos.z;
-
-        radius = radiiSphere[compOffset];
-        outstrstream << "," << radius;
-
-        // Only linear velocity
-        float3 vxyz, acc;
-        vxyz.x = vX[this_owner];
-        vxyz.y = vY[this_owner];
-        vxyz.z = vZ[this_owner];
-        acc.x = aX[this_owner];
-        acc.y = aY[this_owner];
-        acc.z = aZ[this_owner];
-        if (solverFlags.outputFlags & OUTPUT_CONTENT::ABSV) {
-            outstrstream << "," << length(vxyz);
-        }
-        if (solverFlags.outputFlags & OUTPUT_CONTENT::VEL) {
-            outstrstream << "," << vxyz.x << "," << vxyz.y << "," << vxyz.z;
-        }
-        if (solverFlags.outputFlags & OUTPUT_CONTENT::ANG_VEL) {
-            float3 ang_v;
-            ang_v.x = omgBarX[this_owner];
-            ang_v.y = omgBarY[this_owner];
-            ang_v.z = omgBarZ[this_owner];
-            outstrstream << "," << ang_v.x << "," << ang_v.y << "," << ang_v.z;
-        }
-
-        if (solverFlags.outputFlags & OUTPUT_CONTENT::ABS_ACC) {
-            outstrstream << "," << length(acc);
-        }
-        if (solverFlags.outputFlags & OUTPUT_CONTENT::ACC) {
-            outstrstream << "," << acc.x << "," << acc.y << "," << acc.z;
-        }
-        if (solverFlags.outputFlags & OUTPUT_CONTENT::ANG_ACC) {
-            float3 ang_acc;
-            ang_acc.x = alphaX[this_owner];
-            ang_acc.y = alphaY[this_owner];
-            ang_acc.z = alphaZ[this_owner];
-            outstrstream << "," << ang_acc.x << "," << ang_acc.y << "," << ang_acc.z;
-        }
-
-        // Family number needs to be user number
-        if (solverFlags.outputFlags & OUTPUT_CONTENT::FAMILY) {
-            outstrstream << "," << +(this_family);
+    const size_t nOwners = simParams->nOwnerBodies;
+    frame.nOwners = nOwners;
+    snapshotHostArray(frame.voxelID, voxelID, nOwners, ownerUserToImpl);
+    snapshotHostArray(frame.locX, locX, nOwners, ownerUserToImpl);
+    snapshotHostArray(frame.locY, locY, nOwners, ownerUserToImpl);
+    snapshotHostArray(frame.locZ, locZ, nOwners, ownerUserToImpl);
+    snapshotHostArray(frame.oriQw, oriQw, nOwners, ownerUserToImpl);
+    snapshotHostArray(frame.oriQx, oriQx, nOwners, ownerUserToImpl);
+    snapshotHostArray(frame.oriQy, oriQy, nOwners, ownerUserToImpl);
+    snapshotHostArray(frame.oriQz, oriQz, nOwners, ownerUserToImpl);
+    snapshotHostArray(frame.vX, vX, nOwners, ownerUserToImpl);
+    snapshotHostArray(frame.vY, vY, nOwners, ownerUserToImpl);
+    snapshotHostArray(frame.vZ, vZ, nOwners, ownerUserToImpl);
+    snapshotHostArray(frame.omgBarX, omgBarX, nOwners, ownerUserToImpl);
+    snapshotHostArray(frame.omgBarY, omgBarY, nOwners, ownerUserToImpl);
+    snapshotHostArray(frame.omgBarZ, omgBarZ, nOwners, ownerUserToImpl);
+    snapshotHostArray(frame.aX, aX, nOwners, ownerUserToImpl);
+    snapshotHostArray(frame.aY, aY, nOwners, ownerUserToImpl);
+    snapshotHostArray(frame.aZ, aZ, nOwners, ownerUserToImpl);
+    snapshotHostArray(frame.alphaX, alphaX, nOwners, ownerUserToImpl);
+    snapshotHostArray(frame.alphaY, alphaY, nOwners, ownerUserToImpl);
+    snapshotHostArray(frame.alphaZ, alphaZ, nOwners, ownerUserToImpl);
+    snapshotHostArray(frame.familyID, familyID, nOwners, ownerUserToImpl);
+    snapshotHostArray(frame.ownerTypes, ownerTypes, nOwners, ownerUserToImpl);
+    snapshotHostArray(frame.inertiaPropOffsets, inertiaPropOffsets, nOwners, ownerUserToImpl);
+    frame.ownerWildcards.resize(m_owner_wildcard_names.size());
+    if (frame.outFlags & OUTPUT_CONTENT::OWNER_WILDCARD) {
+        for (unsigned int j = 0; j < m_owner_wildcard_names.size(); j++) {
+            snapshotHostArray(frame.ownerWildcards[j], *ownerWildcards[j], nOwners, ownerUserToImpl);
         }
+    }
 
-        // Wildcards
-        if (solverFlags.outputFlags & OUTPUT_CONTENT::OWNER_WILDCARD) {
-            // The order shouldn't be an issue... the same set is being processed here and in equip_owner_wildcards, see
-            // Model.h
-            for (unsigned int j = 0; j < m_owner_wildcard_names.size(); j++) {
-                outstrstream << "," << (*ownerWildcards[j])[i];
-            }
+    if (type != OUTPUT_FRAME_TYPE::SPHERE) {
+        frame.nSpheres = 0;
+        return;
+    }
+    migrateSphGeoWildcardToHost();
+    const size_t nSpheres = simParams->nSpheresGM;
+    frame.nSpheres = nSpheres;
+    snapshotHostArray(frame.ownerClumpBody, ownerClumpBody, nSpheres, sphereUserToImpl);
+    if (!ownerImplToUser.empty()) {
+        for (auto& owner : frame.ownerClumpBody) {
+            owner = ownerUserID(owner);
         }
-        if (solverFlags.outputFlags & OUTPUT_CONTENT::GEO_WILDCARD) {
-            for (unsigned int j = 0; j < m_geo_wildcard_names.size(); j++) {
-                outstrstream << "," << (*sphereWildcards[j])[i];
-            }
+    }
+    // Component template arrays are indexed by component offset (or sphere ID, if not jitified)
+    if (solverFlags.useClumpJitify) {
+        snapshotHostArray(frame.clumpComponentOffsetExt, clumpComponentOffsetExt, nSpheres, sphereUserToImpl);
+        snapshotHostArray(frame.radiiSphere, radiiSphere, radiiSphere.size());
+        snapshotHostArray(frame.relPosSphereX, relPosSphereX, relPosSphereX.size());
+        snapshotHostArray(frame.relPosSphereY, relPosSphereY, relPosSphereY.size());
+        snapshotHostArray(frame.relPosSphereZ, relPosSphereZ, relPosSphereZ.size());
+    } else {
+        snapshotHostArray(frame.radiiSphere, radiiSphere, radiiSphere.size(), sphereUserToImpl);
+        snapshotHostArray(frame.relPosSphereX, relPosSphereX, relPosSphereX.size(), sphereUserToImpl);
+        snapshotHostArray(frame.relPosSphereY, relPosSphereY, relPosSphereY.size(), sphereUserToImpl);
+        snapshotHostArray(frame.relPosSphereZ, relPosSphereZ, relPosSphereZ.size(), sphereUserToImpl);
+    }
+    frame.sphereWildcards.resize(m_geo_wildcard_names.size());
+    if (frame.outFlags & OUTPUT_CONTENT::GEO_WILDCARD) {
+        for (unsigned int j = 0; j < m_geo_wildcard_names.size(); j++) {
+            snapshotHostArray(frame.sphereWildcards[j], *sphereWildcards[j], nSpheres, sphereUserToImpl);
         }
-
-        outstrstream << "\n";
     }
+}
 
-    ptFile << outstrstream.str();
+void DEMDynamicThread::writeSpheresAsCsv(std::ofstream& ptFile) {
+    snapshotOutputFrame(syncOutputFrame, OUTPUT_FRAME_TYPE::SPHERE);
+    formatSpheresAsCsv(syncOutputFrame, ptFile);
 }
 
 #ifdef DEME_USE_CHPF
@@ -1425,7 +2182,8 @@ void DEMDynamicThread::writeClumpsAsChpf(std::ofstream& ptFile, unsigned int acc
     }
     size_t num_output_clumps = 0;
 
-    for (size_t i = 0; i < simParams->nOwnerBodies; i++) {
+    for (size_t u = 0; u < simParams->nOwnerBodies; u++) {
+        const bodyID_t i = ownerImplID(u);
         auto this_owner = ownerClumpBody[i];
         family_t this_family = familyID[this_owner];
         // If this (impl-level) family is in the no-output list, skip it
@@ -1488,196 +2246,108 @@ void DEMDynamicThread::writeClumpsAsChpf(std::ofstream& ptFile, unsigned int acc
 #endif
 
 void DEMDynamicThread::writeClumpsAsCsv(std::ofstream& ptFile, unsigned int accuracy) {
-    std::ostringstream outstrstream;
-    outstrstream.precision(accuracy);
-
-    migrateFamilyToHost();
-    migrateClumpPosInfoToHost();
-    migrateClumpHighOrderInfoToHost();
-    migrateOwnerWildcardToHost();
-
-    // xyz and quaternion are always there
-    outstrstream << OUTPUT_FILE_X_COL_NAME + "," + OUTPUT_FILE_Y_COL_NAME + "," + OUTPUT_FILE_Z_COL_NAME +
-                        ",Qw,Qx,Qy,Qz," + OUTPUT_FILE_CLUMP_TYPE_NAME;
-    if (solverFlags.outputFlags & OUTPUT_CONTENT::ABSV) {
-        outstrstream << ",absv";
-    }
-    if (solverFlags.outputFlags & OUTPUT_CONTENT::VEL) {
-        outstrstream << "," + OUTPUT_FILE_VEL_X_COL_NAME + "," + OUTPUT_FILE_VEL_Y_COL_NAME + "," +
-                            OUTPUT_FILE_VEL_Z_COL_NAME;
-    }
-    if (solverFlags.outputFlags & OUTPUT_CONTENT::ANG_VEL) {
-        outstrstream << "," + OUTPUT_FILE_ANGVEL_X_COL_NAME + "," + OUTPUT_FILE_ANGVEL_Y_COL_NAME + "," +
-                            OUTPUT_FILE_ANGVEL_Z_COL_NAME;
-    }
-    if (solverFlags.outputFlags & OUTPUT_CONTENT::ABS_ACC) {
-        outstrstream << ",abs_acc";
-    }
-    if (solverFlags.outputFlags & OUTPUT_CONTENT::ACC) {
-        outstrstream << ",a_x,a_y,a_z";
-    }
-    if (solverFlags.outputFlags & OUTPUT_CONTENT::ANG_ACC) {
-        outstrstream << ",alpha_x,alpha_y,alpha_z";
-    }
-    if (solverFlags.outputFlags & OUTPUT_CONTENT::FAMILY) {
-        outstrstream << ",family";
-    }
-    if (solverFlags.outputFlags & OUTPUT_CONTENT::OWNER_WILDCARD) {
-        for (const auto& name : m_owner_wildcard_names) {
-            outstrstream << "," + name;
-        }
-    }
-    outstrstream << "\n";
-
-    // simParams host version should not be different from device version, so no need to update
-    for (size_t i = 0; i < simParams->nOwnerBodies; i++) {
-        // i is this owner's number. And if it is not a clump, we can move on.
-        if (ownerTypes[i] != OWNER_T_CLUMP)
-            continue;
-
-        family_t this_family = familyID[i];
-        // If this (impl-level) family is in the no-output list, skip it
-        if (familiesNoOutput.find(this_family) != familiesNoOutput.end()) {
-            continue;
-        }
-
-        float3 CoM;
-        float X, Y, Z;
-        voxelID_t voxel = voxelID[i];
-        subVoxelPos_t subVoxX = locX[i];
-        subVoxelPos_t subVoxY = locY[i];
-        subVoxelPos_t subVoxZ = locZ[i];
-        voxelIDToPosition<float, voxelID_t, subVoxelPos_t>(X, Y, Z, voxel, subVoxX, subVoxY, subVoxZ, simParams->nvXp2,
-                                                           simParams->nvYp2, simParams->voxelSize, simParams->l);
-        CoM.x = X + simParams->LBFX;
-        CoM.y = Y + simParams->LBFY;
-        CoM.z = Z + simParams->LBFZ;
-        // Output position
-        outstrstream << CoM.x << "," << CoM.y << "," << CoM.z;
-
-        // Then quaternions
-        outstrstream << "," << oriQw[i] << "," << oriQx[i] << "," << oriQy[i] << "," << oriQz[i];
-
-        // Then type of clump
-        unsigned int clump_mark = inertiaPropOffsets[i];
-        outstrstream << "," << templateNumNameMap.at(clump_mark);
-
-        // Only linear velocity
-        float3 vxyz, ang_v, acc, ang_acc;
-        vxyz.x = vX[i];
-        vxyz.y = vY[i];
-        vxyz.z = vZ[i];
-        acc.x = aX[i];
-        acc.y = aY[i];
-        acc.z = aZ[i];
-        if (solverFlags.outputFlags & OUTPUT_CONTENT::ABSV) {
-            outstrstream << "," << length(vxyz);
-        }
-        if (solverFlags.outputFlags & OUTPUT_CONTENT::VEL) {
-            outstrstream << "," << vxyz.x << "," << vxyz.y << "," << vxyz.z;
-        }
-        if (solverFlags.outputFlags & OUTPUT_CONTENT::ANG_VEL) {
-            ang_v.x = omgBarX[i];
-            ang_v.y = omgBarY[i];
-            ang_v.z = omgBarZ[i];
-            outstrstream << "," << ang_v.x << "," << ang_v.y << "," << ang_v.z;
-        }
-        if (solverFlags.outputFlags & OUTPUT_CONTENT::ABS_ACC) {
-            outstrstream << "," << length(acc);
-        }
-        if (solverFlags.outputFlags & OUTPUT_CONTENT::ACC) {
-            outstrstream << "," << acc.x << "," << acc.y << "," << acc.z;
-        }
-        if (solverFlags.outputFlags & OUTPUT_CONTENT::ANG_ACC) {
-            ang_acc.x = alphaX[i];
-            ang_acc.y = alphaY[i];
-            ang_acc.z = alphaZ[i];
-            outstrstream << "," << ang_acc.x << "," << ang_acc.y << "," << ang_acc.z;
-        }
-
-        // Family number needs to be user number
-        if (solverFlags.outputFlags & OUTPUT_CONTENT::FAMILY) {
-            outstrstream << "," << +(this_family);
-        }
-
-        // Wildcards
-        if (solverFlags.outputFlags & OUTPUT_CONTENT::OWNER_WILDCARD) {
-            // The order shouldn't be an issue... the same set is being processed here and in equip_owner_wildcards, see
-            // Model.h
-            for (unsigned int j = 0; j < m_owner_wildcard_names.size(); j++) {
-                outstrstream << "," << (*ownerWildcards[j])[i];
-            }
-        }
-
-        outstrstream << "\n";
-    }
-
-    ptFile << outstrstream.str();
+    snapshotOutputFrame(syncOutputFrame, OUTPUT_FRAME_TYPE::CLUMP);
+    syncOutputFrame.accuracy = accuracy;
+    formatClumpsAsCsv(syncOutputFrame, ptFile);
 }
 
 std::shared_ptr<ContactInfoContainer> DEMDynamicThread::generateContactInfo(float force_thres) {
+    return generateCompactContactInfo(force_thres)->ToContactInfoContainer();
+}
+
+std::shared_ptr<CompactContactInfo> DEMDynamicThread::generateCompactContactInfo(float force_thres) {
     // Migrate contact info to host
     migrateFamilyToHost();
     migrateClumpPosInfoToHost();
     migrateContactInfoToHost();
 
-    size_t total_contacts = *(solverScratchSpace.numContacts);
-    // Wildcards supports only floats now
-    std::vector<std::pair<std::string, std::string>> existing_wildcards(m_contact_wildcard_names.size());
-    size_t name_i = 0;
-    for (const auto& name : m_contact_wildcard_names) {
-        existing_wildcards[name_i++] = {name, "float"};
+    // Recycle the last container (and its buffer) if no one holds on to it anymore
+    if (!m_compactContactInfo || m_compactContactInfo.use_count() > 1) {
+        m_compactContactInfo = std::make_shared<CompactContactInfo>();
     }
-    ContactInfoContainer contactInfo(solverFlags.cntOutFlags, existing_wildcards);
-    contactInfo.ResizeAll(total_contacts);
+    CompactContactInfo& contactInfo = *m_compactContactInfo;
+    // Wildcards supports only floats now
+    std::vector<std::string> wildcard_names(m_contact_wildcard_names.begin(), m_contact_wildcard_names.end());
+    contactInfo.Configure(solverFlags.cntOutFlags, wildcard_names);
 
-    size_t useful_cnt = 0;
+    // First find the contacts to output. If this force+torque is too small, then it's not an active contact. We don't
+    // output fake contacts; but right now, no contact will be marked fake by kT, so no need to check that.
+    size_t total_contacts = *(solverScratchSpace.numContacts);
+    m_cntOutIndices.clear();
     for (size_t i = 0; i < total_contacts; i++) {
+        if (length(contactForces[i] + contactTorque_convToForce[i]) >= force_thres) {
+            m_cntOutIndices.push_back(i);
+        }
+    }
+    const size_t useful_cnt = m_cntOutIndices.size();
+    contactInfo.Resize(useful_cnt);
+
+    // Resolve the columns once
+    const unsigned int cntOutFlags = solverFlags.cntOutFlags;
+    auto cnt_types = contactInfo.GetContactType();
+    auto AOwnerFamily = contactInfo.GetAOwnerFamily();
+    auto BOwnerFamily = contactInfo.GetBOwnerFamily();
+    ColumnView<bodyID_t> AOwner, BOwner, AGeo, BGeo;
+    ColumnView<float3> forces, points, normals, torques;
+    std::vector<ColumnView<float>> wildcards;
+    if (cntOutFlags & CNT_OUTPUT_CONTENT::OWNER) {
+        AOwner = contactInfo.GetAOwner();
+        BOwner = contactInfo.GetBOwner();
+    }
+    if (cntOutFlags & CNT_OUTPUT_CONTENT::GEO_ID) {
+        AGeo = contactInfo.GetAGeo();
+        BGeo = contactInfo.GetBGeo();
+    }
+    if (cntOutFlags & CNT_OUTPUT_CONTENT::FORCE)
+        forces = contactInfo.GetForce();
+    if (cntOutFlags & CNT_OUTPUT_CONTENT::CNT_POINT)
+        points = contactInfo.GetPoint();
+    if (cntOutFlags & CNT_OUTPUT_CONTENT::NORMAL)
+        normals = contactInfo.GetNormal();
+    if (cntOutFlags & CNT_OUTPUT_CONTENT::TORQUE)
+        torques = contactInfo.GetTorque();
+    if (cntOutFlags & CNT_OUTPUT_CONTENT::CNT_WILDCARD) {
+        // The order shouldn't be an issue... the same set is being processed here and in equip_contact_wildcards,
+        // see Model.h
+        for (const auto& name : wildcard_names)
+            wildcards.push_back(contactInfo.Get<float>(name));
+    }
+
+    // Then fill in the output contacts, independently of each other
+#ifdef DEME_USE_OPENMP
+    #pragma omp parallel for
+#endif
+    for (long long k = 0; k < (long long)useful_cnt; k++) {
+        const size_t i = m_cntOutIndices[k];
         // Geos that are involved in this contact
         auto geoA = idGeometryA[i];
         auto geoB = idGeometryB[i];
         auto type = contactType[i];
-        // We don't output fake contacts; but right now, no contact will be marked fake by kT, so no need to check that
-        // if (type == NOT_A_CONTACT)
-        //     continue;
-
-        float3 forcexyz = contactForces[i];
-        float3 torque = contactTorque_convToForce[i];
-        // If this force+torque is too small, then it's not an active contact
-        if (length(forcexyz + torque) < force_thres) {
-            continue;
-        }
-
         // geoA's owner must be a sphere
         auto ownerA = ownerClumpBody[geoA];
-        bodyID_t ownerB;
         // geoB's owner depends...
-        ownerB = getGeoOwnerID(geoB, type);
+        bodyID_t ownerB = getGeoOwnerID(geoB, type);
 
-        // Type is mapped to SS, SM and such....
-        contactInfo.Get<std::string>("ContactType")[useful_cnt] = contact_type_out_name_map.at(type);
+        // Type is kept as its code; it is mapped to SS, SM and such only when written out
+        cnt_types[k] = type;
 
         // Add family, always
-        {
-            family_t familyA = familyID[ownerA];
-            family_t familyB = familyID[ownerB];
-            contactInfo.Get<family_t>("AOwnerFamily")[useful_cnt] = familyA;
-            contactInfo.Get<family_t>("BOwnerFamily")[useful_cnt] = familyB;
-        }
+        AOwnerFamily[k] = familyID[ownerA];
+        BOwnerFamily[k] = familyID[ownerB];
 
         // (Internal) ownerID and/or geometry ID
-        if (solverFlags.cntOutFlags & CNT_OUTPUT_CONTENT::OWNER) {
-            contactInfo.Get<bodyID_t>("AOwner")[useful_cnt] = ownerA;
-            contactInfo.Get<bodyID_t>("BOwner")[useful_cnt] = ownerB;
+        if (cntOutFlags & CNT_OUTPUT_CONTENT::OWNER) {
+            AOwner[k] = ownerUserID(ownerA);
+            BOwner[k] = ownerUserID(ownerB);
         }
-        if (solverFlags.cntOutFlags & CNT_OUTPUT_CONTENT::GEO_ID) {
-            contactInfo.Get<bodyID_t>("AGeo")[useful_cnt] = geoA;
-            contactInfo.Get<bodyID_t>("BGeo")[useful_cnt] = geoB;
+        if (cntOutFlags & CNT_OUTPUT_CONTENT::GEO_ID) {
+            AGeo[k] = sphereUserID(geoA);
+            BGeo[k] = geoBUserID(geoB, type);
         }
 
         // Force is already in global...
-        if (solverFlags.cntOutFlags & CNT_OUTPUT_CONTENT::FORCE) {
-            contactInfo.Get<float3>("Force")[useful_cnt] = forcexyz;
+        if (cntOutFlags & CNT_OUTPUT_CONTENT::FORCE) {
+            forces[k] = contactForces[i];
         }
 
         // Contact point is in local frame. To make it global, first map that vector to axis-aligned global frame, then
@@ -1704,14 +2374,14 @@ std::shared_ptr<ContactInfoContainer> DEMDynamicThread::generateContactInfo(floa
             applyOriQToVector3(cntPntA.x, cntPntA.y, cntPntA.z, oriQA.w, oriQA.x, oriQA.y, oriQA.z);
             cntPntA += CoM;
         }
-        if (solverFlags.cntOutFlags & CNT_OUTPUT_CONTENT::CNT_POINT) {
+        if (cntOutFlags & CNT_OUTPUT_CONTENT::CNT_POINT) {
             // oriQ is updated already... whereas the contact point is effectively last step's... That's unfortunate.
             // Should we do somthing ahout it?
-            contactInfo.Get<float3>("Point")[useful_cnt] = cntPntA;
+            points[k] = cntPntA;
         }
 
         // To get contact normal: it's just contact point - sphereA center, that gives you the outward normal for body A
-        if (solverFlags.cntOutFlags & CNT_OUTPUT_CONTENT::NORMAL) {
+        if (cntOutFlags & CNT_OUTPUT_CONTENT::NORMAL) {
             size_t compOffset = (solverFlags.useClumpJitify) ? clumpComponentOffsetExt[geoA] : geoA;
             float3 this_sp_deviation;
             this_sp_deviation.x = relPosSphereX[compOffset];
@@ -1720,12 +2390,12 @@ std::shared_ptr<ContactInfoContainer> DEMDynamicThread::generateContactInfo(floa
             applyOriQToVector3<float, float>(this_sp_deviation.x, this_sp_deviation.y, this_sp_deviation.z, oriQA.w,
                                              oriQA.x, oriQA.y, oriQA.z);
             float3 pos = CoM + this_sp_deviation;
-            float3 normal = normalize(cntPntA - pos);
-            contactInfo.Get<float3>("Normal")[useful_cnt] = normal;
+            normals[k] = normalize(cntPntA - pos);
         }
 
         // Torque is in global already...
-        if (solverFlags.cntOutFlags & CNT_OUTPUT_CONTENT::TORQUE) {
+        if (cntOutFlags & CNT_OUTPUT_CONTENT::TORQUE) {
+            float3 torque = contactTorque_convToForce[i];
             // Must derive torque in local...
             {
                 applyOriQToVector3(torque.x, torque.y, torque.z, oriQA.w, -oriQA.x, -oriQA.y, -oriQA.z);
@@ -1734,134 +2404,450 @@ std::shared_ptr<ContactInfoContainer> DEMDynamicThread::generateContactInfo(floa
                 // back to global
                 applyOriQToVector3(torque.x, torque.y, torque.z, oriQA.w, oriQA.x, oriQA.y, oriQA.z);
             }
-            contactInfo.Get<float3>("Torque")[useful_cnt] = torque;
+            torques[k] = torque;
         }
 
         // Contact wildcards
-        if (solverFlags.cntOutFlags & CNT_OUTPUT_CONTENT::CNT_WILDCARD) {
-            // The order shouldn't be an issue... the same set is being processed here and in equip_contact_wildcards,
-            // see Model.h
-            size_t name_i = 0;
-            for (const auto& name : m_contact_wildcard_names) {
-                contactInfo.Get<float>(name)[useful_cnt] = (*contactWildcards[name_i++])[i];
-            }
+        for (size_t w = 0; w < wildcards.size(); w++) {
+            wildcards[w][k] = (*contactWildcards[w])[i];
         }
-
-        useful_cnt++;
     }
-    contactInfo.ResizeAll(useful_cnt);
-    return std::make_shared<ContactInfoContainer>(std::move(contactInfo));
+    return m_compactContactInfo;
 }
 
 void DEMDynamicThread::writeContactsAsCsv(std::ofstream& ptFile, float force_thres) {
-    std::ostringstream outstrstream;
+    snapshotOutputFrame(syncOutputFrame, OUTPUT_FRAME_TYPE::CONTACT, force_thres);
+    formatContactsAsCsv(syncOutputFrame, ptFile);
+    syncOutputFrame.contactInfo.reset();
+}
 
-    std::shared_ptr<ContactInfoContainer> contactInfo = generateContactInfo(force_thres);
+void DEMDynamicThread::writeSpheresAsBinary(std::ofstream& ptFile) {
+    snapshotOutputFrame(syncOutputFrame, OUTPUT_FRAME_TYPE::SPHERE);
+    formatSpheresAsBinary(syncOutputFrame, ptFile);
+}
 
-    outstrstream << OUTPUT_FILE_CNT_TYPE_NAME;
-    if (solverFlags.cntOutFlags & CNT_OUTPUT_CONTENT::OWNER) {
-        outstrstream << "," + OUTPUT_FILE_OWNER_1_NAME + "," + OUTPUT_FILE_OWNER_2_NAME;
+void DEMDynamicThread::writeClumpsAsBinary(std::ofstream& ptFile) {
+    snapshotOutputFrame(syncOutputFrame, OUTPUT_FRAME_TYPE::CLUMP);
+    formatClumpsAsBinary(syncOutputFrame, ptFile);
+}
+
+void DEMDynamicThread::writeContactsAsBinary(std::ofstream& ptFile, float force_thres) {
+    snapshotOutputFrame(syncOutputFrame, OUTPUT_FRAME_TYPE::CONTACT, force_thres);
+    formatContactsAsBinary(syncOutputFrame, ptFile);
+    syncOutputFrame.contactInfo.reset();
+}
+
+void DEMDynamicThread::writeSpheresAsVtp(std::ofstream& ptFile) {
+    snapshotOutputFrame(syncOutputFrame, OUTPUT_FRAME_TYPE::SPHERE);
+    formatSpheresAsVtp(syncOutputFrame, ptFile);
+}
+
+void DEMDynamicThread::writeClumpsAsVtp(std::ofstream& ptFile) {
+    snapshotOutputFrame(syncOutputFrame, OUTPUT_FRAME_TYPE::CLUMP);
+    formatClumpsAsVtp(syncOutputFrame, ptFile);
+}
+
+void DEMDynamicThread::writeContactsAsVtp(std::ofstream& ptFile, float force_thres) {
+    snapshotOutputFrame(syncOutputFrame, OUTPUT_FRAME_TYPE::CONTACT, force_thres);
+    formatContactsAsVtp(syncOutputFrame, ptFile);
+    syncOutputFrame.contactInfo.reset();
+}
+
+void DEMDynamicThread::setAsyncOutput(bool use, unsigned int max_queued) {
+    if (!use) {
+        // Destroying the writer drains its queue first
+        outputWriter.reset();
+        return;
     }
-    if (solverFlags.cntOutFlags & CNT_OUTPUT_CONTENT::GEO_ID) {
-        outstrstream << "," + OUTPUT_FILE_GEO_ID_1_NAME + "," + OUTPUT_FILE_GEO_ID_2_NAME;
+    if (outputWriter && outputWriter->GetMaxQueued() == max_queued) {
+        return;
     }
-    if (solverFlags.cntOutFlags & CNT_OUTPUT_CONTENT::FORCE) {
-        outstrstream << "," + OUTPUT_FILE_FORCE_X_NAME + "," + OUTPUT_FILE_FORCE_Y_NAME + "," +
-                            OUTPUT_FILE_FORCE_Z_NAME;
+    outputWriter = std::make_unique<DEMOutputWriter>(max_queued);
+}
+
+void DEMDynamicThread::submitOutputFrame(OUTPUT_FRAME_TYPE type,
+                                         OUTPUT_FORMAT format,
+                                         const std::string& filename,
+                                         unsigned int accuracy,
+                                         float force_thres) {
+    std::unique_ptr<OutputFrame> frame = outputWriter->AcquireFrame();
+    snapshotOutputFrame(*frame, type, force_thres);
+    frame->format = format;
+    frame->filename = filename;
+    frame->accuracy = accuracy;
+    outputWriter->Submit(std::move(frame));
+}
+
+void DEMDynamicThread::flushOutput() {
+    if (outputWriter) {
+        outputWriter->Flush();
     }
-    if (solverFlags.cntOutFlags & CNT_OUTPUT_CONTENT::CNT_POINT) {
-        outstrstream << "," + OUTPUT_FILE_X_COL_NAME + "," + OUTPUT_FILE_Y_COL_NAME + "," + OUTPUT_FILE_Z_COL_NAME;
+}
+
+// A checkpoint is a directory of columnar binary tables, one per array length
+const unsigned int CHECKPOINT_VERSION = 1;
+const char* const CHECKPOINT_META_FILE = "meta.demecol";
+const char* const CHECKPOINT_OWNER_FILE = "owners.demecol";
+const char* const CHECKPOINT_SPHERE_FILE = "spheres.demecol";
+const char* const CHECKPOINT_TRI_FILE = "triangles.demecol";
+const char* const CHECKPOINT_ANAL_FILE = "analytical.demecol";
+const char* const CHECKPOINT_CONTACT_FILE = "contacts.demecol";
+const char* const CHECKPOINT_PREV_CONTACT_FILE = "prev_contacts.demecol";
+
+inline std::string checkpointWildcardColumn(const std::string& name) {
+    return "wildcard:" + name;
+}
+
+template <typename T>
+inline void addCheckpointColumn(ColumnarBinaryWriter& table, const std::string& name, DualArray<T>& src) {
+    table.AddColumn<T>(name, std::vector<T>(src.host(), src.host() + table.NumRows()));
+}
+
+template <typename T>
+inline void restoreCheckpointColumn(DualArray<T>& dst, const ColumnarBinaryReader& table, const std::string& name) {
+    if (table.NumRows() > 0) {
+        dst.setVal(table.Get<T>(name), 0);
     }
-    // if (solverFlags.cntOutFlags & CNT_OUTPUT_CONTENT::COMPONENT) {
-    //     outstrstream << ","+OUTPUT_FILE_COMP_1_NAME+","+OUTPUT_FILE_COMP_2_NAME;
-    // }
-    // if (solverFlags.cntOutFlags & CNT_OUTPUT_CONTENT::NICKNAME) {
-    //     outstrstream << ","+OUTPUT_FILE_OWNER_NICKNAME_1_NAME+","+OUTPUT_FILE_OWNER_NICKNAME_2_NAME;
-    // }
-    if (solverFlags.cntOutFlags & CNT_OUTPUT_CONTENT::NORMAL) {
-        outstrstream << "," + OUTPUT_FILE_NORMAL_X_NAME + "," + OUTPUT_FILE_NORMAL_Y_NAME + "," +
-                            OUTPUT_FILE_NORMAL_Z_NAME;
+}
+
+inline void writeCheckpointTable(const std::filesystem::path& file, const ColumnarBinaryWriter& table) {
+    std::ofstream out(file, std::ios::out | std::ios::binary);
+    if (!out) {
+        DEME_ERROR("Could not open checkpoint file %s for writing.", file.string().c_str());
     }
-    if (solverFlags.cntOutFlags & CNT_OUTPUT_CONTENT::TORQUE) {
-        outstrstream << "," + OUTPUT_FILE_TORQUE_X_NAME + "," + OUTPUT_FILE_TORQUE_Y_NAME + "," +
-                            OUTPUT_FILE_TORQUE_Z_NAME;
+    table.Write(out);
+}
+
+inline uint64_t readCheckpointCount(const ColumnarBinaryReader& meta, const std::string& name) {
+    return meta.Get<uint64_t>(name).at(0);
+}
+
+// Put wildcard arrays into a table, each in a column named after the wildcard
+inline void addCheckpointWildcards(ColumnarBinaryWriter& table,
+                                   const std::set<std::string>& names,
+                                   std::vector<std::unique_ptr<DualArray<float>>>& wildcards) {
+    unsigned int w_num = 0;
+    for (const auto& w_name : names) {
+        addCheckpointColumn(table, checkpointWildcardColumn(w_name), *wildcards[w_num]);
+        w_num++;
     }
-    if (solverFlags.cntOutFlags & CNT_OUTPUT_CONTENT::CNT_WILDCARD) {
-        // Write all wildcard names as header
-        for (const auto& w_name : m_contact_wildcard_names) {
-            outstrstream << "," + w_name;
-        }
+}
+
+void DEMDynamicThread::saveCheckpoint(const std::filesystem::path& dir) {
+    std::error_code ec;
+    std::filesystem::create_directories(dir, ec);
+    if (ec) {
+        DEME_ERROR("Could not create checkpoint directory %s: %s", dir.string().c_str(), ec.message().c_str());
     }
-    outstrstream << "\n";
+    // familyID is only migrated when it can change on device; otherwise the host copy is already up to date
+    migrateDeviceModifiableInfoToHost();
 
-    for (size_t i = 0; i < contactInfo->Size(); i++) {
-        outstrstream << contactInfo->Get<std::string>("ContactType")[i];
+    // kT's contact history is only meaningful if the contacts carry history
+    std::vector<bodyID_t> prevIdA, prevIdB;
+    std::vector<contact_t> prevType;
+    std::vector<notStupidBool_t> prevPersistency;
+    size_t nPrevSpheres = 0;
+    if (!solverFlags.isHistoryless) {
+        DEME_GPU_CALL(cudaSetDevice(kT->streamInfo.device));
+        kT->getPrevContactArrays(prevIdA, prevIdB, prevType, prevPersistency, nPrevSpheres);
+        DEME_GPU_CALL(cudaSetDevice(streamInfo.device));
+    }
 
-        // (Internal) ownerID and/or geometry ID
-        if (solverFlags.cntOutFlags & CNT_OUTPUT_CONTENT::OWNER) {
-            outstrstream << "," << contactInfo->Get<bodyID_t>("AOwner")[i] << ","
-                         << contactInfo->Get<bodyID_t>("BOwner")[i];
-        }
-        if (solverFlags.cntOutFlags & CNT_OUTPUT_CONTENT::GEO_ID) {
-            outstrstream << "," << contactInfo->Get<bodyID_t>("AGeo")[i] << ","
-                         << contactInfo->Get<bodyID_t>("BGeo")[i];
+    {
+        ColumnarBinaryWriter meta(1);
+        meta.AddColumn<uint32_t>("version", std::vector<uint32_t>{CHECKPOINT_VERSION});
+        meta.AddColumn<uint64_t>("nOwners", std::vector<uint64_t>{(uint64_t)simParams->nOwnerBodies});
+        meta.AddColumn<uint64_t>("nSpheres", std::vector<uint64_t>{(uint64_t)simParams->nSpheresGM});
+        meta.AddColumn<uint64_t>("nTriangles", std::vector<uint64_t>{(uint64_t)simParams->nTriGM});
+        meta.AddColumn<uint64_t>("nAnalGeos", std::vector<uint64_t>{(uint64_t)simParams->nAnalGM});
+        meta.AddColumn<uint64_t>("nPrevSpheres", std::vector<uint64_t>{(uint64_t)nPrevSpheres});
+        meta.AddColumn<uint64_t>("nTotalSteps", std::vector<uint64_t>{(uint64_t)nTotalSteps});
+        meta.AddColumn<double>("simTime", std::vector<double>{simParams->timeElapsed});
+        // The adaptive time stepper grows the next step from this one
+        meta.AddColumn<double>("stepSize", std::vector<double>{(double)simParams->h});
+        writeCheckpointTable(dir / CHECKPOINT_META_FILE, meta);
+    }
+    {
+        ColumnarBinaryWriter owners(simParams->nOwnerBodies);
+        addCheckpointColumn(owners, "voxelID", voxelID);
+        addCheckpointColumn(owners, "locX", locX);
+        addCheckpointColumn(owners, "locY", locY);
+        addCheckpointColumn(owners, "locZ", locZ);
+        addCheckpointColumn(owners, "oriQw", oriQw);
+        addCheckpointColumn(owners, "oriQx", oriQx);
+        addCheckpointColumn(owners, "oriQy", oriQy);
+        addCheckpointColumn(owners, "oriQz", oriQz);
+        addCheckpointColumn(owners, "vX", vX);
+        addCheckpointColumn(owners, "vY", vY);
+        addCheckpointColumn(owners, "vZ", vZ);
+        addCheckpointColumn(owners, "omgBarX", omgBarX);
+        addCheckpointColumn(owners, "omgBarY", omgBarY);
+        addCheckpointColumn(owners, "omgBarZ", omgBarZ);
+        addCheckpointColumn(owners, "aX", aX);
+        addCheckpointColumn(owners, "aY", aY);
+        addCheckpointColumn(owners, "aZ", aZ);
+        addCheckpointColumn(owners, "alphaX", alphaX);
+        addCheckpointColumn(owners, "alphaY", alphaY);
+        addCheckpointColumn(owners, "alphaZ", alphaZ);
+        addCheckpointColumn(owners, "familyID", familyID);
+        // Owners may have been reordered; record which user-facing ID each row is, so a load can match the layout
+        std::vector<bodyID_t> userIDs(simParams->nOwnerBodies);
+        for (size_t i = 0; i < userIDs.size(); i++) {
+            userIDs[i] = ownerUserID(i);
         }
+        owners.AddColumn<bodyID_t>("userID", std::move(userIDs));
+        addCheckpointWildcards(owners, m_owner_wildcard_names, ownerWildcards);
+        writeCheckpointTable(dir / CHECKPOINT_OWNER_FILE, owners);
+    }
+    {
+        ColumnarBinaryWriter spheres(simParams->nSpheresGM);
+        addCheckpointWildcards(spheres, m_geo_wildcard_names, sphereWildcards);
+        writeCheckpointTable(dir / CHECKPOINT_SPHERE_FILE, spheres);
+        ColumnarBinaryWriter triangles(simParams->nTriGM);
+        addCheckpointWildcards(triangles, m_geo_wildcard_names, triWildcards);
+        writeCheckpointTable(dir / CHECKPOINT_TRI_FILE, triangles);
+        ColumnarBinaryWriter anals(simParams->nAnalGM);
+        addCheckpointWildcards(anals, m_geo_wildcard_names, analWildcards);
+        writeCheckpointTable(dir / CHECKPOINT_ANAL_FILE, anals);
+    }
+    {
+        ColumnarBinaryWriter contacts(*solverScratchSpace.numContacts);
+        addCheckpointColumn(contacts, "idGeometryA", idGeometryA);
+        addCheckpointColumn(contacts, "idGeometryB", idGeometryB);
+        addCheckpointColumn(contacts, "contactType", contactType);
+        addCheckpointWildcards(contacts, m_contact_wildcard_names, contactWildcards);
+        writeCheckpointTable(dir / CHECKPOINT_CONTACT_FILE, contacts);
+    }
+    {
+        ColumnarBinaryWriter prevContacts(prevIdA.size());
+        prevContacts.AddColumn<bodyID_t>("idGeometryA", std::move(prevIdA));
+        prevContacts.AddColumn<bodyID_t>("idGeometryB", std::move(prevIdB));
+        prevContacts.AddColumn<contact_t>("contactType", std::move(prevType));
+        prevContacts.AddColumn<notStupidBool_t>("persistency", std::move(prevPersistency));
+        writeCheckpointTable(dir / CHECKPOINT_PREV_CONTACT_FILE, prevContacts);
+    }
+}
 
-        // Force is already in global...
-        if (solverFlags.cntOutFlags & CNT_OUTPUT_CONTENT::FORCE) {
-            outstrstream << "," << contactInfo->Get<float3>("Force")[i].x << ","
-                         << contactInfo->Get<float3>("Force")[i].y << "," << contactInfo->Get<float3>("Force")[i].z;
+// Overwrite wildcard arrays using the columns named after them, leaving those the checkpoint does not have untouched
+inline void restoreCheckpointWildcards(const ColumnarBinaryReader& table,
+                                       const std::set<std::string>& names,
+                                       std::vector<std::unique_ptr<DualArray<float>>>& wildcards,
+                                       const std::string& file,
+                                       VERBOSITY verbosity) {
+    unsigned int w_num = 0;
+    for (const auto& w_name : names) {
+        const std::string col = checkpointWildcardColumn(w_name);
+        if (table.HasColumn(col)) {
+            restoreCheckpointColumn(*wildcards[w_num], table, col);
+        } else {
+            DEME_WARNING("Wildcard %s is not found in checkpoint file %s.\nIts current values are kept.",
+                         w_name.c_str(), file.c_str());
         }
+        w_num++;
+    }
+}
 
-        if (solverFlags.cntOutFlags & CNT_OUTPUT_CONTENT::CNT_POINT) {
-            // oriQ is updated already... whereas the contact point is effectively last step's... That's unfortunate.
-            // Should we do somthing ahout it?
-            outstrstream << "," << contactInfo->Get<float3>("Point")[i].x << ","
-                         << contactInfo->Get<float3>("Point")[i].y << "," << contactInfo->Get<float3>("Point")[i].z;
+void DEMDynamicThread::loadCheckpoint(const std::filesystem::path& dir) {
+    const auto tablePath = [&](const char* name) { return (dir / name).string(); };
+
+    ColumnarBinaryReader meta(tablePath(CHECKPOINT_META_FILE));
+    const unsigned int version = meta.Get<uint32_t>("version").at(0);
+    if (version > CHECKPOINT_VERSION) {
+        DEME_ERROR("Checkpoint %s has version %u, which is newer than what this build can read (%u).",
+                   dir.string().c_str(), version, CHECKPOINT_VERSION);
+    }
+    // A checkpoint only holds the evolving state, so the system must be set up with the same entities
+    const auto checkCount = [&](const char* name, size_t expected) {
+        const uint64_t n = readCheckpointCount(meta, name);
+        if (n != expected) {
+            DEME_ERROR(
+                "Checkpoint %s has %zu entries for %s, but the initialized system has %zu.\nA checkpoint can only be "
+                "loaded into a system set up the same way as the one it was saved from.",
+                dir.string().c_str(), (size_t)n, name, expected);
         }
+    };
+    checkCount("nOwners", simParams->nOwnerBodies);
+    checkCount("nSpheres", simParams->nSpheresGM);
+    checkCount("nTriangles", simParams->nTriGM);
+    checkCount("nAnalGeos", simParams->nAnalGM);
 
-        // Torque is in global already...
-        if (solverFlags.cntOutFlags & CNT_OUTPUT_CONTENT::TORQUE) {
-            outstrstream << "," << contactInfo->Get<float3>("Torque")[i].x << ","
-                         << contactInfo->Get<float3>("Torque")[i].y << "," << contactInfo->Get<float3>("Torque")[i].z;
+    {
+        const std::string file = tablePath(CHECKPOINT_OWNER_FILE);
+        ColumnarBinaryReader owners(file);
+        // Bring the owners (and spheres) to the layout they had when saved, so all the rows below line up
+        if (owners.HasColumn("userID")) {
+            const std::vector<bodyID_t> savedUserIDs = owners.Get<bodyID_t>("userID");
+            std::vector<bodyID_t> order(savedUserIDs.size());
+            bool identity = true;
+            for (size_t k = 0; k < order.size(); k++) {
+                order[k] = ownerImplID(savedUserIDs[k]);
+                identity = identity && (order[k] == k);
+            }
+            if (!identity) {
+                reorderOwners(order);
+            }
         }
-
-        // Contact wildcards
-        if (solverFlags.cntOutFlags & CNT_OUTPUT_CONTENT::CNT_WILDCARD) {
-            // The order shouldn't be an issue... the same set is being processed here and in equip_contact_wildcards,
-            // see Model.h
-            for (const auto& name : m_contact_wildcard_names) {
-                outstrstream << "," << contactInfo->Get<float>(name)[i];
+        restoreCheckpointColumn(voxelID, owners, "voxelID");
+        restoreCheckpointColumn(locX, owners, "locX");
+        restoreCheckpointColumn(locY, owners, "locY");
+        restoreCheckpointColumn(locZ, owners, "locZ");
+        restoreCheckpointColumn(oriQw, owners, "oriQw");
+        restoreCheckpointColumn(oriQx, owners, "oriQx");
+        restoreCheckpointColumn(oriQy, owners, "oriQy");
+        restoreCheckpointColumn(oriQz, owners, "oriQz");
+        restoreCheckpointColumn(vX, owners, "vX");
+        restoreCheckpointColumn(vY, owners, "vY");
+        restoreCheckpointColumn(vZ, owners, "vZ");
+        restoreCheckpointColumn(omgBarX, owners, "omgBarX");
+        restoreCheckpointColumn(omgBarY, owners, "omgBarY");
+        restoreCheckpointColumn(omgBarZ, owners, "omgBarZ");
+        restoreCheckpointColumn(aX, owners, "aX");
+        restoreCheckpointColumn(aY, owners, "aY");
+        restoreCheckpointColumn(aZ, owners, "aZ");
+        restoreCheckpointColumn(alphaX, owners, "alphaX");
+        restoreCheckpointColumn(alphaY, owners, "alphaY");
+        restoreCheckpointColumn(alphaZ, owners, "alphaZ");
+        restoreCheckpointColumn(familyID, owners, "familyID");
+        restoreCheckpointWildcards(owners, m_owner_wildcard_names, ownerWildcards, file, verbosity);
+        // kT keeps its own family numbers, which dT only sends over if they can change on device
+        if (simParams->nOwnerBodies > 0) {
+            kT->setFamilyIDs(owners.Get<family_t>("familyID"));
+        }
+    }
+    {
+        const std::string sph_file = tablePath(CHECKPOINT_SPHERE_FILE);
+        restoreCheckpointWildcards(ColumnarBinaryReader(sph_file), m_geo_wildcard_names, sphereWildcards, sph_file,
+                                   verbosity);
+        const std::string tri_file = tablePath(CHECKPOINT_TRI_FILE);
+        restoreCheckpointWildcards(ColumnarBinaryReader(tri_file), m_geo_wildcard_names, triWildcards, tri_file,
+                                   verbosity);
+        const std::string anal_file = tablePath(CHECKPOINT_ANAL_FILE);
+        restoreCheckpointWildcards(ColumnarBinaryReader(anal_file), m_geo_wildcard_names, analWildcards, anal_file,
+                                   verbosity);
+    }
+    {
+        const std::string file = tablePath(CHECKPOINT_CONTACT_FILE);
+        ColumnarBinaryReader contacts(file);
+        const size_t nContacts = contacts.NumRows();
+        if (nContacts > idGeometryA.size()) {
+            contactEventArraysResize(nContacts);
+        }
+        for (unsigned int i = 0; i < simParams->nContactWildcards; i++) {
+            if (nContacts > contactWildcards[i]->size()) {
+                DEME_DUAL_ARRAY_RESIZE((*contactWildcards[i]), nContacts, 0);
             }
         }
-
-        outstrstream << "\n";
+        restoreCheckpointColumn(idGeometryA, contacts, "idGeometryA");
+        restoreCheckpointColumn(idGeometryB, contacts, "idGeometryB");
+        restoreCheckpointColumn(contactType, contacts, "contactType");
+        restoreCheckpointWildcards(contacts, m_contact_wildcard_names, contactWildcards, file, verbosity);
+        *solverScratchSpace.numContacts = nContacts;
+        solverScratchSpace.numContacts.toDevice();
+        // Resizing may have moved the arrays
+        granData.toDevice();
+    }
+    if (!solverFlags.isHistoryless) {
+        ColumnarBinaryReader prevContacts(tablePath(CHECKPOINT_PREV_CONTACT_FILE));
+        if (prevContacts.NumRows() > 0 || *solverScratchSpace.numContacts == 0) {
+            // Restore kT's contact history as it was, so the next CD maps the contact wildcards exactly like the
+            // uninterrupted run would
+            DEME_GPU_CALL(cudaSetDevice(kT->streamInfo.device));
+            kT->setPrevContactArrays(prevContacts.Get<bodyID_t>("idGeometryA"),
+                                     prevContacts.Get<bodyID_t>("idGeometryB"),
+                                     prevContacts.Get<contact_t>("contactType"),
+                                     prevContacts.Get<notStupidBool_t>("persistency"),
+                                     readCheckpointCount(meta, "nPrevSpheres"));
+            DEME_GPU_CALL(cudaSetDevice(streamInfo.device));
+            new_contacts_loaded = false;
+        } else {
+            // Saved from a history-less run: let kT build its history from the loaded contact pairs instead
+            new_contacts_loaded = true;
+        }
     }
 
-    ptFile << outstrstream.str();
+    nTotalSteps = readCheckpointCount(meta, "nTotalSteps");
+    // A constant step size is the user's to set, but an adaptive one continues from where it was
+    if (!solverFlags.isStepConst && meta.HasColumn("stepSize")) {
+        simParams->h = meta.Get<double>("stepSize").at(0);
+    }
+    setSimTime(meta.Get<double>("simTime").at(0));
+    syncMemoryTransfer();
+    // No critical update is announced, so nothing is recomputed on top of the restored state: like any user call after
+    // a sync, the next one starts by waiting for a CD on the current state anyway
 }
 
-void DEMDynamicThread::writeMeshesAsVtk(std::ofstream& ptFile) {
-    std::ostringstream ostream;
+void DEMDynamicThread::gatherMeshesForOutput(std::vector<float>& xyz,
+                                             std::vector<int64_t>& tri_vertices,
+                                             std::vector<bodyID_t>& tri_owners) {
+    // One batched migration for all mesh owners, instead of device reads per mesh
     migrateFamilyToHost();
+    migrateClumpPosInfoToHost();
 
-    std::vector<size_t> vertexOffset(m_meshes.size() + 1, 0);
-    size_t total_f = 0;
-    size_t total_v = 0;
-    unsigned int mesh_num = 0;
-
-    // May want to jump the families that the user disabled output for
-    std::vector<notStupidBool_t> thisMeshSkip(m_meshes.size(), 0);
-    for (const auto& mmesh : m_meshes) {
+    // May want to jump the families that the user disabled output for, and to write all meshes to one file, we need
+    // vertex and face number offset info
+    const size_t n_meshes = m_meshes.size();
+    std::vector<size_t> vertexOffset(n_meshes + 1, 0);
+    std::vector<size_t> faceOffset(n_meshes + 1, 0);
+    std::vector<float3> ownerPos(n_meshes);
+    std::vector<float4> ownerOriQ(n_meshes);
+    for (size_t m = 0; m < n_meshes; m++) {
+        const auto& mmesh = m_meshes[m];
         bodyID_t mowner = mmesh->owner;
-        family_t this_family = familyID[mowner];
-        // If this (impl-level) family is in the no-output list, skip it
-        if (familiesNoOutput.find(this_family) != familiesNoOutput.end()) {
-            thisMeshSkip[mesh_num] = 1;
+        bool skip = familiesNoOutput.find(familyID[mowner]) != familiesNoOutput.end();
+        vertexOffset[m + 1] = vertexOffset[m] + (skip ? 0 : mmesh->GetCoordsVertices().size());
+        faceOffset[m + 1] = faceOffset[m] + (skip ? 0 : mmesh->GetIndicesVertexes().size());
+        double X, Y, Z;
+        voxelIDToPosition<double, voxelID_t, subVoxelPos_t>(X, Y, Z, voxelID[mowner], locX[mowner], locY[mowner],
+                                                            locZ[mowner], simParams->nvXp2, simParams->nvYp2,
+                                                            simParams->voxelSize, simParams->l);
+        ownerPos[m] = make_float3(X + simParams->LBFX, Y + simParams->LBFY, Z + simParams->LBFZ);
+        ownerOriQ[m] = make_float4(oriQx[mowner], oriQy[mowner], oriQz[mowner], oriQw[mowner]);
+    }
+
+    xyz.resize(3 * vertexOffset[n_meshes]);
+    tri_vertices.resize(3 * faceOffset[n_meshes]);
+    tri_owners.resize(faceOffset[n_meshes]);
+    // Meshes are independent; large meshes get the threads' attention one after another
+    for (size_t m = 0; m < n_meshes; m++) {
+        const size_t nv = vertexOffset[m + 1] - vertexOffset[m];
+        const size_t nf = faceOffset[m + 1] - faceOffset[m];
+        if (nv == 0 && nf == 0)
+            continue;
+        const std::vector<float3>& vertices = m_meshes[m]->GetCoordsVertices();
+        const std::vector<int3>& faces = m_meshes[m]->GetIndicesVertexes();
+        const float3 pos = ownerPos[m];
+        const float4 oriQ = ownerOriQ[m];
+        float* out_v = xyz.data() + 3 * vertexOffset[m];
+#ifdef DEME_USE_OPENMP
+    #pragma omp parallel for
+#endif
+        for (long long j = 0; j < (long long)nv; j++) {
+            float3 point = vertices[j];
+            applyFrameTransformLocalToGlobal(point, pos, oriQ);
+            out_v[3 * j] = point.x;
+            out_v[3 * j + 1] = point.y;
+            out_v[3 * j + 2] = point.z;
         }
-        mesh_num++;
+        const int64_t v_off = vertexOffset[m];
+        int64_t* out_f = tri_vertices.data() + 3 * faceOffset[m];
+        for (size_t j = 0; j < nf; j++) {
+            out_f[3 * j] = faces[j].x + v_off;
+            out_f[3 * j + 1] = faces[j].y + v_off;
+            out_f[3 * j + 2] = faces[j].z + v_off;
+        }
+        std::fill(tri_owners.begin() + faceOffset[m], tri_owners.begin() + faceOffset[m + 1], m_meshes[m]->owner);
     }
+}
+
+void DEMDynamicThread::writeMeshesAsVtk(std::ofstream& ptFile) {
+    std::vector<float> xyz;
+    std::vector<int64_t> tri_vertices;
+    std::vector<bodyID_t> tri_owners;
+    gatherMeshesForOutput(xyz, tri_vertices, tri_owners);
+    const size_t total_v = xyz.size() / 3;
+    const size_t total_f = tri_owners.size();
 
+    std::ostringstream ostream;
     ostream << "# vtk DataFile Version 2.0\n";
     ostream << "VTK from DEM simulation\n";
     ostream << "ASCII\n";
@@ -1869,66 +2855,42 @@ void DEMDynamicThread::writeMeshesAsVtk(std::ofstream& ptFile) {
 
     ostream << "DATASET UNSTRUCTURED_GRID\n";
 
-    // Prescan the V and F: to write all meshes to one file, we need vertex number offset info
-    mesh_num = 0;
-    for (const auto& mmesh : m_meshes) {
-        if (!thisMeshSkip[mesh_num]) {
-            vertexOffset[mesh_num + 1] = mmesh->GetCoordsVertices().size();
-            total_v += mmesh->GetCoordsVertices().size();
-            total_f += mmesh->GetIndicesVertexes().size();
-        }
-        mesh_num++;
-    }
-    for (unsigned int i = 1; i < m_meshes.size(); i++)
-        vertexOffset[i] = vertexOffset[i] + vertexOffset[i - 1];
-
     // Writing m_vertices
-    ostream << "POINTS " << total_v << " float" << std::endl;
-    mesh_num = 0;
-    for (const auto& mmesh : m_meshes) {
-        if (!thisMeshSkip[mesh_num]) {
-            bodyID_t mowner = mmesh->owner;
-            float3 ownerPos = this->getOwnerPos(mowner)[0];
-            float4 ownerOriQ = this->getOwnerOriQ(mowner)[0];
-            for (const auto& v : mmesh->GetCoordsVertices()) {
-                float3 point = v;
-                applyFrameTransformLocalToGlobal(point, ownerPos, ownerOriQ);
-                ostream << point.x << " " << point.y << " " << point.z << std::endl;
-            }
-        }
-        mesh_num++;
+    ostream << "POINTS " << total_v << " float\n";
+    for (size_t i = 0; i < total_v; i++) {
+        ostream << xyz[3 * i] << " " << xyz[3 * i + 1] << " " << xyz[3 * i + 2] << "\n";
     }
 
     // Writing faces
     ostream << "\n\n";
-    ostream << "CELLS " << total_f << " " << 4 * total_f << std::endl;
-    mesh_num = 0;
-    for (const auto& mmesh : m_meshes) {
-        if (!thisMeshSkip[mesh_num]) {
-            for (const auto& f : mmesh->GetIndicesVertexes()) {
-                ostream << "3 " << (size_t)f.x + vertexOffset[mesh_num] << " " << (size_t)f.y + vertexOffset[mesh_num]
-                        << " " << (size_t)f.z + vertexOffset[mesh_num] << std::endl;
-            }
-        }
-        mesh_num++;
+    ostream << "CELLS " << total_f << " " << 4 * total_f << "\n";
+    for (size_t i = 0; i < total_f; i++) {
+        ostream << "3 " << tri_vertices[3 * i] << " " << tri_vertices[3 * i + 1] << " " << tri_vertices[3 * i + 2]
+                << "\n";
     }
 
     // Writing face types. Type 5 is generally triangles
     ostream << "\n\n";
-    ostream << "CELL_TYPES " << total_f << std::endl;
-    mesh_num = 0;
-    for (const auto& mmesh : m_meshes) {
-        if (!thisMeshSkip[mesh_num]) {
-            auto nfaces = mmesh->GetIndicesVertexes().size();
-            for (size_t j = 0; j < nfaces; j++)
-                ostream << "5 " << std::endl;
-        }
-        mesh_num++;
-    }
+    ostream << "CELL_TYPES " << total_f << "\n";
+    for (size_t i = 0; i < total_f; i++)
+        ostream << "5 \n";
 
     ptFile << ostream.str();
 }
 
+void DEMDynamicThread::writeMeshesAsVtu(std::ofstream& ptFile) {
+    std::vector<float> xyz;
+    std::vector<int64_t> tri_vertices;
+    std::vector<bodyID_t> tri_owners;
+    gatherMeshesForOutput(xyz, tri_vertices, tri_owners);
+
+    VtkXmlWriter writer(VTK_XML_DATASET::UNSTRUCTURED_GRID, compressVtk);
+    writer.SetPoints(std::move(xyz));
+    writer.SetTriangles(std::move(tri_vertices));
+    writer.AddCellData("owner", std::vector<uint32_t>(tri_owners.begin(), tri_owners.end()));
+    writer.Write(ptFile);
+}
+
 inline void DEMDynamicThread::contactEventArraysResize(size_t nContactPairs) {
     DEME_DUAL_ARRAY_RESIZE(idGeometryA, nContactPairs, 0);
     DEME_DUAL_ARRAY_RESIZE(idGeometryB, nContactPairs, 0);
@@ -2000,8 +2962,16 @@ inline void DEMDynamicThread::sendToTheirBuffer() {
     DEME_GPU_CALL(cudaMemcpy(granData->pKTOwnedBuffer_absVel, pCycleMaxVel, simParams->nOwnerBodies * sizeof(float),
                              cudaMemcpyDeviceToDevice));
 
-    // Send simulation metrics for kT's reference.
-    DEME_GPU_CALL(cudaMemcpy(granData->pKTOwnedBuffer_ts, &(simParams->h), sizeof(float), cudaMemcpyHostToDevice));
+    // Send simulation metrics for kT's reference. With adaptive step size, kT is told the largest step size dT may
+    // grow to before this order's result replaces it, and dT then sticks to that while using this order's result.
+    float ts_for_kT = simParams->h;
+    if (!solverFlags.isStepConst) {
+        const double drift = std::max<unsigned int>(*perhapsIdealFutureDrift, 1);
+        double cap = std::min<double>(tsPhysicalBound, simParams->h * std::pow(adaptTSParams.maxGrowth, drift));
+        tsCapInFlight = clampBetween<double, double>(cap, adaptTSParams.tsMin, adaptTSParams.tsMax);
+        ts_for_kT = tsCapInFlight;
+    }
+    DEME_GPU_CALL(cudaMemcpy(granData->pKTOwnedBuffer_ts, &ts_for_kT, sizeof(float), cudaMemcpyHostToDevice));
     // Note that perhapsIdealFutureDrift is non-negative, and it will be used to determine the margin size; however, if
     // scheduleHelper is instructed to have negative future drift then perhapsIdealFutureDrift no longer affects them.
     DEME_GPU_CALL(cudaMemcpy(granData->pKTOwnedBuffer_maxDrift, perhapsIdealFutureDrift.getHostPointer(),
@@ -2230,7 +3200,186 @@ inline void DEMDynamicThread::routineChecks() {
 }
 
 inline float* DEMDynamicThread::determineSysVel() {
-    return approxMaxVelFunc->dT_GetValue();
+    float* absv = approxMaxVelFunc->dT_GetValue();
+    // The adaptive time stepper needs the system max velocity, and the step size bounds that follow from it; so does
+    // a drift controller that weighs the contact margin
+    const bool drift_needs_vel = solverFlags.autoUpdateFreq && driftController && driftController->UsesMargin();
+    if (!solverFlags.isStepConst || drift_needs_vel) {
+        DEME_DUAL_ARRAY_RESIZE(adaptTSReduceRes, 1, 0.);
+        cubMaxReduce<float>((float*)m_reduceResArr.device(), adaptTSReduceRes.device(), simParams->nOwnerBodies,
+                            streamInfo.stream, solverScratchSpace);
+        adaptTSReduceRes.toHost();
+        sysMaxVel = (simParams->nOwnerBodies > 0) ? adaptTSReduceRes[0] : 0.;
+    }
+    if (!solverFlags.isStepConst) {
+        const AdaptiveTSParams& params = adaptTSParams;
+        tsPhysicalBound = DEME_HUGE_FLOAT;
+        tsPhysicalLimiter = TS_LIMITER::NONE;
+        auto bound_by = [&](double bound, TS_LIMITER why) {
+            if (bound < tsPhysicalBound) {
+                tsPhysicalBound = bound;
+                tsPhysicalLimiter = why;
+            }
+        };
+        if (sysMaxVel > 0. && params.minRadius > 0.) {
+            bound_by(params.cfl * params.minRadius / sysMaxVel, TS_LIMITER::CFL);
+        }
+        if (params.rayleighTime > 0.) {
+            bound_by(params.rayleighFactor * params.rayleighTime, TS_LIMITER::RAYLEIGH);
+        }
+        if (params.hertzCoeff > 0. && sysMaxVel > 0.) {
+            bound_by(params.hertzFactor * params.hertzCoeff * std::pow((double)sysMaxVel, -0.2), TS_LIMITER::HERTZ);
+        }
+    }
+    return absv;
+}
+
+inline void DEMDynamicThread::proposeStepSize(double remaining) {
+    const AdaptiveTSParams& params = adaptTSParams;
+    // Grow smoothly from the last step size, unless something says otherwise
+    double h = (double)simParams->h * params.maxGrowth;
+    TS_LIMITER limiter = TS_LIMITER::GROWTH;
+    auto bound_by = [&](double bound, TS_LIMITER why) {
+        if (bound < h) {
+            h = bound;
+            limiter = why;
+        }
+    };
+    bound_by(tsPhysicalBound, tsPhysicalLimiter);
+    if (solverFlags.stepSizeStrat == VAR_TS_STRAT::INT_GAP) {
+        bound_by(tsFromErrEst, TS_LIMITER::INT_DIFF);
+    }
+    bound_by(params.tsMax, TS_LIMITER::MAX_SIZE);
+    if (h < params.tsMin) {
+        h = params.tsMin;
+        limiter = TS_LIMITER::MIN_SIZE;
+    }
+    // The contact pairs in use are only safe for steps up to the size kT assumed, and that beats everything else
+    bound_by(tsCapActive, TS_LIMITER::CD_MARGIN);
+
+    tsLimiter = limiter;
+    tsNumRejected = 0;
+    tsBeforeCycleEnd = h;
+    // Land exactly on the end of this user call, so the user sees the simulation time they asked for
+    tsShortenedForCycleEnd = (remaining < h);
+    if (tsShortenedForCycleEnd) {
+        h = remaining;
+    }
+    simParams->h = h;
+    simParams.toDevice();
+}
+
+inline bool DEMDynamicThread::assessStepError() {
+    const AdaptiveTSParams& params = adaptTSParams;
+    const size_t n = simParams->nOwnerBodies;
+    // Need accelerations from an earlier step to compare against
+    if (!accPrevStepValid || accPrevStepMapVersion != ownerMapVersion || accPrevStep.size() != 3 * n || n == 0 ||
+        accPrevStepAge <= 0. || params.minRadius <= 0.) {
+        return true;
+    }
+    float* accJump = (float*)solverScratchSpace.allocateTempVector("accJump", n * sizeof(float));
+    computeOwnerAccJump(accJump, accPrevStep.device(), n, &granData, streamInfo.stream);
+    DEME_DUAL_ARRAY_RESIZE(adaptTSReduceRes, 1, 0.);
+    cubMaxReduce<float>(accJump, adaptTSReduceRes.device(), n, streamInfo.stream, solverScratchSpace);
+    adaptTSReduceRes.toHost();
+    solverScratchSpace.finishUsingTempVector("accJump");
+
+    // The position error of a step is about the jerk term of its Taylor expansion, jerk * h^3 / 6. The acceleration
+    // jump since the last accepted step gives the jerk.
+    const double h = simParams->h;
+    const double jerk = (double)adaptTSReduceRes[0] / accPrevStepAge;
+    const double err = jerk * h * h * h / 6.;
+    const double tol = params.errTol * params.minRadius;
+    // Aim a bit below the tolerance when suggesting a new step size, so the next step is unlikely to be rejected
+    tsFromErrEst = (err > 0.) ? 0.9 * h * std::cbrt(tol / err) : DEME_HUGE_FLOAT;
+    if (err <= tol || h <= params.tsMin || tsNumRejected >= params.maxRejects) {
+        return true;
+    }
+
+    // Rejected, retry with a smaller step
+    tsNumRejected++;
+    tsLimiter = TS_LIMITER::INT_DIFF;
+    tsBeforeCycleEnd = std::max(tsFromErrEst, params.tsMin);
+    // The end of this user call may be out of reach now
+    tsShortenedForCycleEnd = false;
+    simParams->h = tsBeforeCycleEnd;
+    simParams.toDevice();
+    DEME_STEP_DEBUG_PRINTF("Step at time %.9g rejected (estimated error %.7g), retrying with step size %.7g",
+                           simParams->timeElapsed, err, (double)simParams->h);
+    return false;
+}
+
+inline void DEMDynamicThread::saveAccOfThisStep() {
+    const size_t n = simParams->nOwnerBodies;
+    DEME_DUAL_ARRAY_RESIZE_NOVAL(accPrevStep, 3 * n);
+    DEME_GPU_CALL(cudaMemcpyAsync(accPrevStep.device(), granData->aX, n * sizeof(float), cudaMemcpyDeviceToDevice,
+                                  streamInfo.stream));
+    DEME_GPU_CALL(cudaMemcpyAsync(accPrevStep.device() + n, granData->aY, n * sizeof(float), cudaMemcpyDeviceToDevice,
+                                  streamInfo.stream));
+    DEME_GPU_CALL(cudaMemcpyAsync(accPrevStep.device() + 2 * n, granData->aZ, n * sizeof(float),
+                                  cudaMemcpyDeviceToDevice, streamInfo.stream));
+    DEME_GPU_CALL(cudaStreamSynchronize(streamInfo.stream));
+    accPrevStepValid = true;
+    accPrevStepMapVersion = ownerMapVersion;
+    accPrevStepAge = 0.;
+}
+
+inline void DEMDynamicThread::recordStepSize() {
+    // A shortened last step of a user call is not a step size decision worth recording
+    if (tsShortenedForCycleEnd) {
+        return;
+    }
+    const double h = simParams->h;
+    if (tsHistory.empty() || tsNumRejected > 0 || tsHistory.back().limiter != tsLimiter ||
+        std::abs(h - tsHistory.back().ts) > 0.01 * tsHistory.back().ts) {
+        tsHistory.push_back(TimeStepRecord{simParams->timeElapsed, h, tsNumRejected, tsLimiter});
+        if (tsHistory.size() > TS_HISTORY_MAX_RECORDS) {
+            tsHistory.pop_front();
+        }
+    }
+}
+
+inline void DEMDynamicThread::snapshotWildcards() {
+    const size_t nContacts = *solverScratchSpace.numContacts;
+    wildcardSnapshots.clear();
+    for (unsigned int i = 0; i < simParams->nContactWildcards; i++) {
+        float* snapshot = (float*)solverScratchSpace.allocateTempVector("contactWildcardSnapshot_" + std::to_string(i),
+                                                                         nContacts * sizeof(float));
+        wildcardSnapshots.push_back(snapshot);
+        DEME_GPU_CALL(cudaMemcpyAsync(snapshot, contactWildcards[i]->device(), nContacts * sizeof(float),
+                                      cudaMemcpyDeviceToDevice, streamInfo.stream));
+    }
+    for (unsigned int i = 0; i < simParams->nOwnerWildcards; i++) {
+        float* snapshot = (float*)solverScratchSpace.allocateTempVector("ownerWildcardSnapshot_" + std::to_string(i),
+                                                                         simParams->nOwnerBodies * sizeof(float));
+        wildcardSnapshots.push_back(snapshot);
+        DEME_GPU_CALL(cudaMemcpyAsync(snapshot, ownerWildcards[i]->device(), simParams->nOwnerBodies * sizeof(float),
+                                      cudaMemcpyDeviceToDevice, streamInfo.stream));
+    }
+}
+
+inline void DEMDynamicThread::restoreWildcards() {
+    const size_t nContacts = *solverScratchSpace.numContacts;
+    for (unsigned int i = 0; i < simParams->nContactWildcards; i++) {
+        DEME_GPU_CALL(cudaMemcpyAsync(contactWildcards[i]->device(), wildcardSnapshots[i], nContacts * sizeof(float),
+                                      cudaMemcpyDeviceToDevice, streamInfo.stream));
+    }
+    for (unsigned int i = 0; i < simParams->nOwnerWildcards; i++) {
+        DEME_GPU_CALL(cudaMemcpyAsync(ownerWildcards[i]->device(), wildcardSnapshots[simParams->nContactWildcards + i],
+                                      simParams->nOwnerBodies * sizeof(float), cudaMemcpyDeviceToDevice,
+                                      streamInfo.stream));
+    }
+    DEME_GPU_CALL(cudaStreamSynchronize(streamInfo.stream));
+}
+
+inline void DEMDynamicThread::releaseWildcardSnapshot() {
+    for (unsigned int i = 0; i < simParams->nContactWildcards; i++) {
+        solverScratchSpace.finishUsingTempVector("contactWildcardSnapshot_" + std::to_string(i));
+    }
+    for (unsigned int i = 0; i < simParams->nOwnerWildcards; i++) {
+        solverScratchSpace.finishUsingTempVector("ownerWildcardSnapshot_" + std::to_string(i));
+    }
+    wildcardSnapshots.clear();
 }
 
 inline void DEMDynamicThread::unpack_impl() {
@@ -2240,6 +3389,8 @@ inline void DEMDynamicThread::unpack_impl() {
         unpackMyBuffer();
         // Leave myself a mental note that I just obtained new produce from kT
         contactPairArr_isFresh = true;
+        // The contact margins of this produce were sized for the step size sent with its order
+        tsCapActive = tsCapInFlight;
         // pSchedSupport->schedulingStats.nDynamicReceives++;
     }
     // dT got the produce, now mark its buffer to be no longer fresh.
@@ -2263,6 +3414,8 @@ inline void DEMDynamicThread::unpack_impl() {
 
 inline void DEMDynamicThread::ifProduceFreshThenUseIt() {
     if (pSchedSupport->dynamicOwned_Prod2ConsBuffer_isFresh) {
+        TraceScope trace(pSchedSupport->tracer, TRACE_LANE_DYNAMIC, "unpackMyBuffer",
+                         pSchedSupport->currentStampOfDynamic.load());
         unpack_impl();
     }
 }
@@ -2271,43 +3424,48 @@ inline void DEMDynamicThread::calibrateParams() {
     // Unpacking is done; now we can use temp arrays again to derive max velocity and send to kT
     pCycleMaxVel = determineSysVel();
 
-    if (solverFlags.autoUpdateFreq) {
-        unsigned int comfortable_drift;
-        if (accumStepUpdater.Query(comfortable_drift)) {
-            // If perhapsIdealFutureDrift needs to increase, then the following value much = perhapsIdealFutureDrift.
-            comfortable_drift =
-                (float)comfortable_drift * solverFlags.targetDriftMultipleOfAvg + solverFlags.targetDriftMoreThanAvg;
-            if (*perhapsIdealFutureDrift > comfortable_drift) {
-                *perhapsIdealFutureDrift -= FUTURE_DRIFT_TWEAK_STEP_SIZE;
-            } else if (*perhapsIdealFutureDrift < comfortable_drift) {
-                *perhapsIdealFutureDrift += FUTURE_DRIFT_TWEAK_STEP_SIZE;
-            }
-            *perhapsIdealFutureDrift = clampBetween<unsigned int, unsigned int>(*perhapsIdealFutureDrift, 0,
-                                                                                solverFlags.upperBoundFutureDrift);
+    if (solverFlags.autoUpdateFreq && driftController) {
+        DriftInputs in;
+        in.current_drift = *perhapsIdealFutureDrift;
+        in.upper_bound = solverFlags.upperBoundFutureDrift;
+        // Each step of drift adds this much to the contact margins kT uses (see computeMarginFromAbsv)
+        in.margin_per_step =
+            ((double)sysMaxVel * simParams->expSafetyMulti + simParams->expSafetyAdder) * (double)simParams->h;
+        in.ref_size = driftMarginRefSize;
+        *perhapsIdealFutureDrift = driftController->Decide(in);
 
-            DEME_DEBUG_PRINTF("Comfortable future drift is %u", comfortable_drift);
-            DEME_DEBUG_PRINTF("Current future drift is %u", *perhapsIdealFutureDrift);
-        }
+        DEME_DEBUG_PRINTF("Balanced future drift is %.7g", driftController->GetState().balanced_drift);
+        DEME_DEBUG_PRINTF("Current future drift is %u", *perhapsIdealFutureDrift);
     }
     // Actually, perhapsIdealFutureDrift seems to have no need to be on device... but I made it a DualStruct anyway
 }
 
 inline void DEMDynamicThread::ifProduceFreshThenUseItAndSendNewOrder() {
     if (pSchedSupport->dynamicOwned_Prod2ConsBuffer_isFresh) {
+        const int64_t stamp = pSchedSupport->currentStampOfDynamic.load();
         timers.GetTimer("Unpack updates from kT").start();
-        unpack_impl();
+        {
+            TraceScope trace(pSchedSupport->tracer, TRACE_LANE_DYNAMIC, "unpackMyBuffer", stamp);
+            unpack_impl();
+        }
         timers.GetTimer("Unpack updates from kT").stop();
+        // Round trip of the update just taken in, if its work order was timed
+        const double cd_latency = orderTimerValid ? orderTimer.GetTimeSecondsIntermediate() : -1.;
 
         timers.GetTimer("Send to kT buffer").start();
         // Acquire lock and refresh the work order for the kinematic
         {
+            TraceScope trace(pSchedSupport->tracer, TRACE_LANE_DYNAMIC, "sendToTheirBuffer", stamp);
             calibrateParams();
             std::lock_guard<std::mutex> lock(pSchedSupport->kinematicOwnedBuffer_AccessCoordination);
             sendToTheirBuffer();
         }
         pSchedSupport->kinematicOwned_Cons2ProdBuffer_isFresh = true;
         pSchedSupport->schedulingStats.nKinematicUpdates++;
-        accumStepUpdater.AddUpdate();
+        if (driftController)
+            driftController->AddUpdate(cd_latency);
+        orderTimer.start();
+        orderTimerValid = true;
 
         timers.GetTimer("Send to kT buffer").stop();
         // Signal the kinematic that it has data for a new work order
@@ -2343,6 +3501,9 @@ void DEMDynamicThread::workerThread() {
         // check. Note: pendingCriticalUpdate is not fail-safe at all right now. The user still needs to sync before
         // making critical changes to the system to ensure safety.
         if (pSchedSupport->stampLastDynamicUpdateProdDate < 0 || pendingCriticalUpdate) {
+            // The user may have changed the system, so the accelerations of the last step are no longer a reference
+            accPrevStepValid = false;
+            tsFromErrEst = DEME_HUGE_FLOAT;
             // This is possible: If it is after a user-manual sync
             ifProduceFreshThenUseIt();
 
@@ -2365,6 +3526,8 @@ void DEMDynamicThread::workerThread() {
             // In this `new-boot' case, we send kT a work order, b/c dT needs results from CD to proceed. After this one
             // instance, kT and dT may work in an async fashion.
             {
+                TraceScope trace(pSchedSupport->tracer, TRACE_LANE_DYNAMIC, "sendToTheirBuffer",
+                                 pSchedSupport->currentStampOfDynamic.load());
                 pCycleMaxVel = determineSysVel();
                 std::lock_guard<std::mutex> lock(pSchedSupport->kinematicOwnedBuffer_AccessCoordination);
                 sendToTheirBuffer();
@@ -2372,11 +3535,17 @@ void DEMDynamicThread::workerThread() {
             pSchedSupport->kinematicOwned_Cons2ProdBuffer_isFresh = true;
             contactPairArr_isFresh = true;
             pSchedSupport->schedulingStats.nKinematicUpdates++;
-            accumStepUpdater.AddUpdate();
+            // No update was taken in before this work order, so there is no round trip to report
+            if (driftController)
+                driftController->AddUpdate(-1.);
+            orderTimer.start();
+            orderTimerValid = true;
             // Signal the kinematic that it has data for a new work order.
             pSchedSupport->cv_KinematicCanProceed.notify_all();
             // Then dT will wait for kT to finish one initial run
             {
+                TraceScope trace(pSchedSupport->tracer, TRACE_LANE_DYNAMIC, "Wait for initial kT update",
+                                 pSchedSupport->currentStampOfDynamic.load());
                 std::unique_lock<std::mutex> lock(pSchedSupport->dynamicCanProceed);
                 while (!pSchedSupport->dynamicOwned_Prod2ConsBuffer_isFresh) {
                     // loop to avoid spurious wakeups
@@ -2392,7 +3561,9 @@ void DEMDynamicThread::workerThread() {
             }
         }
 
-        for (double cycle = 0.0; cycle < cycleDuration; cycle += (double)(simParams->h)) {
+        // The size of the step just taken
+        double stepTaken = simParams->h;
+        for (double cycle = 0.0; cycle < cycleDuration; cycle += stepTaken) {
             // If the produce is fresh, use it, and then send kT a new work order.
             // We used to send work order to kT whenever kT unpacks its buffer. This can lead to a situation where dT
             // sends a new work order and then immediately bails out (user asks it to do something else). A bit later
@@ -2405,7 +3576,11 @@ void DEMDynamicThread::workerThread() {
             // Check if we need to wait; i.e., if dynamic drifted too much into future, then we must wait a bit before
             // the next cycle begins
             if (pSchedSupport->dynamicShouldWait()) {
+                TraceScope trace(pSchedSupport->tracer, TRACE_LANE_DYNAMIC, "Wait for kT update",
+                                 pSchedSupport->currentStampOfDynamic.load());
                 timers.GetTimer("Wait for kT update").start();
+                Timer<double> wait_timer;
+                wait_timer.start();
                 // Wait for a signal from kT to indicate that kT has caught up
                 std::unique_lock<std::mutex> lock(pSchedSupport->dynamicCanProceed);
                 while (!pSchedSupport->dynamicOwned_Prod2ConsBuffer_isFresh) {
@@ -2413,9 +3588,10 @@ void DEMDynamicThread::workerThread() {
                     pSchedSupport->cv_DynamicCanProceed.wait(lock);
                 }
                 pSchedSupport->schedulingStats.nTimesDynamicHeldBack++;
-                // If dT waits, it is penalized, since waiting means double-wait, very bad.
-                if (solverFlags.autoUpdateFreq)
-                    *perhapsIdealFutureDrift += FUTURE_DRIFT_TWEAK_STEP_SIZE;
+                // If dT waits, the drift controller hears about it, since waiting means double-wait, very bad.
+                if (solverFlags.autoUpdateFreq && driftController)
+                    *perhapsIdealFutureDrift =
+                        driftController->AddWait(wait_timer.GetTimeSecondsIntermediate(), *perhapsIdealFutureDrift);
                 timers.GetTimer("Wait for kT update").stop();
             }
             // NOTE: This ShouldWait check should follow the ifProduceFreshThenUseItAndSendNewOrder call. Because we
@@ -2425,19 +3601,51 @@ void DEMDynamicThread::workerThread() {
             // dynamicOwned_Prod2ConsBuffer_isFresh is false so ifProduceFreshThenUseItAndSendNewOrder didn't run, then
             // kT has to be in the process of doing a CD, we still will not be locked here.
 
+            stepTimer.start();
             // If using variable ts size, only when a step is accepted can we move on
             bool step_accepted = false;
+            const int64_t stamp = pSchedSupport->currentStampOfDynamic.load();
+            const bool assess_error = (!solverFlags.isStepConst) && solverFlags.stepSizeStrat == VAR_TS_STRAT::INT_GAP;
+            if (!solverFlags.isStepConst) {
+                proposeStepSize(cycleDuration - cycle);
+            }
+            if (assess_error) {
+                snapshotWildcards();
+            }
             do {
-                calculateForces();
+                {
+                    TraceScope trace(pSchedSupport->tracer, TRACE_LANE_DYNAMIC, "calculateForces", stamp);
+                    calculateForces();
+                }
+
+                // A rejected step is tried again with a smaller step size, from the wildcards it started with
+                if (assess_error && !assessStepError()) {
+                    restoreWildcards();
+                    continue;
+                }
 
                 routineChecks();
 
                 timers.GetTimer("Integration").start();
-                integrateOwnerMotions();
+                {
+                    TraceScope trace(pSchedSupport->tracer, TRACE_LANE_DYNAMIC, "integrateOwnerMotions", stamp);
+                    integrateOwnerMotions();
+                }
                 timers.GetTimer("Integration").stop();
 
                 step_accepted = true;
-            } while ((!solverFlags.isStepConst) || (!step_accepted));
+            } while (!step_accepted);
+
+            stepTaken = simParams->h;
+            if (assess_error) {
+                releaseWildcardSnapshot();
+                // Keep the accelerations of this step to compare against, unless this step is a shortened one (its
+                // size tells little about how the simulation evolves)
+                if (!tsShortenedForCycleEnd) {
+                    saveAccOfThisStep();
+                }
+                accPrevStepAge += stepTaken;
+            }
 
             // CalculateForces is done, set contactPairArr_isFresh to false
             // This will be set to true next time it receives an update from kT
@@ -2451,17 +3659,32 @@ void DEMDynamicThread::workerThread() {
             // Dynamic wrapped up one cycle, record this fact into schedule support
             pSchedSupport->currentStampOfDynamic++;
             nTotalSteps++;
-            accumStepUpdater.AddStep();
-
-            //// TODO: make changes for variable time step size cases
-            simParams->timeElapsed += (double)simParams->h;
+            if (driftController)
+                driftController->AddStep(stepTimer.GetTimeSecondsIntermediate());
+
+            if (!solverFlags.isStepConst) {
+                recordStepSize();
+                // A step shortened to land on the end of this user call does not change the step size to use next
+                if (tsShortenedForCycleEnd) {
+                    simParams->h = tsBeforeCycleEnd;
+                }
+            }
+            simParams->timeElapsed += stepTaken;
             // timeElapsed needs to be updated to the device each time step
             // simParams.syncMemberToDevice<double>(offsetof(DEMSimParams, timeElapsed));
             simParams.toDevice();
+
+            // Landed on the end of this user call
+            if (!solverFlags.isStepConst && tsShortenedForCycleEnd) {
+                break;
+            }
         }
 
         // Unless the user did something critical, must we wait for a kT update before next step
         pendingCriticalUpdate = false;
+        // The work order in flight may be picked up only after the user is done in between calls, so its round trip
+        // tells nothing about CD latency
+        orderTimerValid = false;
 
         // When getting here, dT has finished one user call (although perhaps not at the end of the user script)
         {
@@ -2492,7 +3715,8 @@ void DEMDynamicThread::resetUserCallStat() {
     // Reset dT stats variables, making ready for next user call
     pSchedSupport->dynamicDone = false;
     contactPairArr_isFresh = true;
-    accumStepUpdater.Clear();
+    if (driftController)
+        driftController->Restart();
 
     // Do not let user artificially set dynamicOwned_Prod2ConsBuffer_isFresh false. B/c only dT has the say on that. It
     // could be that kT has a new produce ready, but dT idled for long and do not want to use it and want a new produce.
@@ -2513,41 +3737,41 @@ void DEMDynamicThread::jitifyKernels(const std::unordered_map<std::string, std::
                                      const std::vector<std::string>& JitifyOptions) {
     // First one is force array preparation kernels
     {
-        prep_force_kernels = std::make_shared<jitify::Program>(std::move(JitHelper::buildProgram(
+        prep_force_kernels = std::make_shared<JitProgram>(std::move(JitHelper::buildProgram(
             "DEMPrepForceKernels", JitHelper::KERNEL_DIR / "DEMPrepForceKernels.cu", Subs, JitifyOptions)));
     }
     // Then force calculation kernels
     {
-        cal_force_kernels = std::make_shared<jitify::Program>(std::move(JitHelper::buildProgram(
+        cal_force_kernels = std::make_shared<JitProgram>(std::move(JitHelper::buildProgram(
             "DEMCalcForceKernels", JitHelper::KERNEL_DIR / "DEMCalcForceKernels.cu", Subs, JitifyOptions)));
     }
     // Then force accumulation kernels
     if (solverFlags.useCubForceCollect) {
-        collect_force_kernels = std::make_shared<jitify::Program>(std::move(JitHelper::buildProgram(
+        collect_force_kernels = std::make_shared<JitProgram>(std::move(JitHelper::buildProgram(
             "DEMCollectForceKernels", JitHelper::KERNEL_DIR / "DEMCollectForceKernels.cu", Subs, JitifyOptions)));
     } else {
-        collect_force_kernels = std::make_shared<jitify::Program>(std::move(
+        collect_force_kernels = std::make_shared<JitProgram>(std::move(
             JitHelper::buildProgram("DEMCollectForceKernels_Compact",
                                     JitHelper::KERNEL_DIR / "DEMCollectForceKernels_Compact.cu", Subs, JitifyOptions)));
     }
     // Then integration kernels
     {
-        integrator_kernels = std::make_shared<jitify::Program>(std::move(JitHelper::buildProgram(
+        integrator_kernels = std::make_shared<JitProgram>(std::move(JitHelper::buildProgram(
             "DEMIntegrationKernels", JitHelper::KERNEL_DIR / "DEMIntegrationKernels.cu", Subs, JitifyOptions)));
     }
     // Then kernels that are... wildcards, which make on-the-fly changes to solver data
     if (solverFlags.canFamilyChangeOnDevice) {
-        mod_kernels = std::make_shared<jitify::Program>(std::move(JitHelper::buildProgram(
+        mod_kernels = std::make_shared<JitProgram>(std::move(JitHelper::buildProgram(
             "DEMModeratorKernels", JitHelper::KERNEL_DIR / "DEMModeratorKernels.cu", Subs, JitifyOptions)));
     }
     // Then misc kernels
     {
-        misc_kernels = std::make_shared<jitify::Program>(std::move(JitHelper::buildProgram(
+        misc_kernels = std::make_shared<JitProgram>(std::move(JitHelper::buildProgram(
             "DEMMiscKernels", JitHelper::KERNEL_DIR / "DEMMiscKernels.cu", Subs, JitifyOptions)));
     }
 }
 
-float* DEMDynamicThread::inspectCall(const std::shared_ptr<jitify::Program>& inspection_kernel,
+float* DEMDynamicThread::inspectCall(const std::shared_ptr<JitProgram>& inspection_kernel,
                                      const std::string& kernel_name,
                                      INSPECT_ENTITY_TYPE thing_to_insp,
                                      CUB_REDUCE_FLAVOR reduce_flavor,
@@ -2718,6 +3942,82 @@ void DEMDynamicThread::setFamilyMeshMaterial(unsigned int N, unsigned int mat_id
     triMaterialOffset.toDevice();
 }
 
+template <typename T>
+std::vector<T> DEMDynamicThread::getMappedVals(DualArray<T>& arr,
+                                               const std::vector<bodyID_t>& userToImpl,
+                                               size_t start,
+                                               size_t n) {
+    if (userToImpl.empty() || n == 0)
+        return arr.getVal(start, n);
+    // Bring back the smallest range covering all requested elements, then gather them in user order
+    size_t lo = SIZE_MAX, hi = 0;
+    for (size_t i = start; i < start + n; i++) {
+        const size_t impl = (i < userToImpl.size()) ? userToImpl[i] : i;
+        lo = DEME_MIN(lo, impl);
+        hi = DEME_MAX(hi, impl);
+    }
+    arr.toHost(lo, hi - lo + 1);
+    std::vector<T> res(n);
+    for (size_t i = 0; i < n; i++) {
+        const size_t u = start + i;
+        res[i] = arr[(u < userToImpl.size()) ? userToImpl[u] : u];
+    }
+    return res;
+}
+
+template <typename T>
+void DEMDynamicThread::setMappedVals(DualArray<T>& arr,
+                                     const std::vector<bodyID_t>& userToImpl,
+                                     const std::vector<T>& vals,
+                                     size_t start) {
+    if (userToImpl.empty()) {
+        arr.setVal(streamInfo.stream, vals, start);
+        return;
+    }
+    if (vals.empty())
+        return;
+    size_t lo = SIZE_MAX, hi = 0;
+    for (size_t i = start; i < start + vals.size(); i++) {
+        const size_t impl = (i < userToImpl.size()) ? userToImpl[i] : i;
+        lo = DEME_MIN(lo, impl);
+        hi = DEME_MAX(hi, impl);
+    }
+    // The elements in between are not ours to change, so get their current values first
+    arr.toHost(lo, hi - lo + 1);
+    for (size_t i = 0; i < vals.size(); i++) {
+        const size_t u = start + i;
+        arr[(u < userToImpl.size()) ? userToImpl[u] : u] = vals[i];
+    }
+    arr.toDevice(lo, hi - lo + 1);
+}
+
+std::vector<bodyID_t> DEMDynamicThread::ownerImplIDs(const std::vector<bodyID_t>& userIDs) const {
+    std::vector<bodyID_t> res(userIDs.size());
+    for (size_t i = 0; i < userIDs.size(); i++) {
+        res[i] = ownerImplID(userIDs[i]);
+    }
+    return res;
+}
+
+void DEMDynamicThread::uploadOwnerIDs(DualArray<bodyID_t>& ids, bool sort) {
+    if (ownerUserToImpl.empty() && !sort) {
+        ids.toDevice();
+        return;
+    }
+    // The host side keeps the user-given IDs; the device side gets what the kernels understand
+    std::vector<bodyID_t> user(ids.host(), ids.host() + ids.size());
+    std::vector<bodyID_t> impl = ownerImplIDs(user);
+    if (sort)
+        impl = hostSort(impl);
+    for (size_t i = 0; i < impl.size(); i++) {
+        ids[i] = impl[i];
+    }
+    ids.toDevice();
+    for (size_t i = 0; i < user.size(); i++) {
+        ids[i] = user[i];
+    }
+}
+
 size_t DEMDynamicThread::getOwnerContactForces(const std::vector<bodyID_t>& ownerIDs,
                                                std::vector<float3>& points,
                                                std::vector<float3>& forces) {
@@ -2730,7 +4030,7 @@ size_t DEMDynamicThread::getOwnerContactForces(const std::vector<bodyID_t>& owne
     solverScratchSpace.allocateDualArray("ownerIDs", ownerIDs.size() * sizeof(bodyID_t));
     solverScratchSpace.allocateDualStruct("numUsefulCnt");
 
-    const std::vector<bodyID_t> ownerIDs_sorted = hostSort(ownerIDs);
+    const std::vector<bodyID_t> ownerIDs_sorted = hostSort(ownerImplIDs(ownerIDs));
     bodyID_t* h_ownerIDs = (bodyID_t*)solverScratchSpace.getDualArrayHost("ownerIDs");
     for (size_t i = 0; i < ownerIDs_sorted.size(); i++) {
         h_ownerIDs[i] = ownerIDs_sorted[i];
@@ -2786,7 +4086,7 @@ size_t DEMDynamicThread::getOwnerContactForces(const std::vector<bodyID_t>& owne
     solverScratchSpace.allocateDualArray("ownerIDs", ownerIDs.size() * sizeof(bodyID_t));
     solverScratchSpace.allocateDualStruct("numUsefulCnt");
 
-    const std::vector<bodyID_t> ownerIDs_sorted = hostSort(ownerIDs);
+    const std::vector<bodyID_t> ownerIDs_sorted = hostSort(ownerImplIDs(ownerIDs));
     bodyID_t* h_ownerIDs = (bodyID_t*)solverScratchSpace.getDualArrayHost("ownerIDs");
     for (size_t i = 0; i < ownerIDs_sorted.size(); i++) {
         h_ownerIDs[i] = ownerIDs_sorted[i];
@@ -2833,6 +4133,93 @@ size_t DEMDynamicThread::getOwnerContactForces(const std::vector<bodyID_t>& owne
     return numUsefulCnt;
 }
 
+size_t DEMDynamicThread::updateForceProbe(ForceProbeBuffer& buf,
+                                          const float3& ref,
+                                          bool need_contacts,
+                                          double* wrench) {
+    // Set the gpu for this thread
+    DEME_GPU_CALL(cudaSetDevice(streamInfo.device));
+    size_t numCnt = *solverScratchSpace.numContacts;
+    size_t nOwners = buf.ownerIDs.size();
+    if (!buf.ownerIDsOnDevice) {
+        buf.numUsefulCnt.resize(1);
+        buf.wrench.resize(6);
+    }
+    if (!buf.ownerIDsOnDevice || buf.ownerMapVersion != ownerMapVersion) {
+        // The contact force kernels bisect into these, so they must be sorted in the internal numbering
+        uploadOwnerIDs(buf.ownerIDs, true);
+        buf.ownerIDsOnDevice = true;
+        buf.ownerMapVersion = ownerMapVersion;
+    }
+    // Grow the device buffers if there are now more contacts
+    size_t nBlocks = getContactWrenchNumBlocks(numCnt);
+    buf.blockWrench.resizeDevice(DEME_MAX(nBlocks, (size_t)1) * 6);
+
+    getContactWrenchConcerningOwners(buf.wrench.device(), buf.blockWrench.device(), buf.ownerIDs.device(), nOwners,
+                                     make_double3(ref.x, ref.y, ref.z), &simParams, &granData, numCnt,
+                                     streamInfo.stream);
+    buf.wrench.toHost();
+    for (int k = 0; k < 6; k++)
+        wrench[k] = buf.wrench[k];
+
+    if (!need_contacts || numCnt == 0)
+        return 0;
+    buf.points.resizeDevice(numCnt);
+    buf.forces.resizeDevice(numCnt);
+    buf.torques.resizeDevice(numCnt);
+    buf.numUsefulCnt[0] = 0;
+    buf.numUsefulCnt.toDevice();
+    getContactForcesConcerningOwners(buf.points.device(), buf.forces.device(), buf.torques.device(),
+                                     buf.numUsefulCnt.device(), buf.ownerIDs.device(), nOwners, &simParams,
+                                     &granData, numCnt, true, false, streamInfo.stream);
+    buf.numUsefulCnt.toHost();
+    size_t numUsefulCnt = buf.numUsefulCnt[0];
+    if (numUsefulCnt > 0) {
+        if (buf.points.size() < numUsefulCnt) {
+            buf.points.resizeHost(numUsefulCnt);
+            buf.forces.resizeHost(numUsefulCnt);
+            buf.torques.resizeHost(numUsefulCnt);
+        }
+        buf.points.toHost(0, numUsefulCnt);
+        buf.forces.toHost(0, numUsefulCnt);
+        buf.torques.toHost(0, numUsefulCnt);
+    }
+    return numUsefulCnt;
+}
+
+void DEMDynamicThread::gatherStateSnapshot(StateSnapshotBuffer& buf,
+                                           unsigned int content,
+                                           unsigned int record_len,
+                                           bool async) {
+    // Set the gpu for this thread
+    DEME_GPU_CALL(cudaSetDevice(streamInfo.device));
+    // The staging buffers are about to be overwritten, so a previous async gather must have landed
+    buf.wait();
+    size_t n = buf.ownerIDs.size();
+    if (n == 0)
+        return;
+    if (!buf.ownerIDsOnDevice || buf.ownerMapVersion != ownerMapVersion) {
+        uploadOwnerIDs(buf.ownerIDs, false);
+        buf.ownerIDsOnDevice = true;
+        buf.ownerMapVersion = ownerMapVersion;
+    }
+    if (buf.data.size() != n * record_len)
+        buf.data.resize(n * record_len);
+
+    gatherOwnerStates(buf.data.device(), buf.ownerIDs.device(), n, content, record_len, &simParams, &granData,
+                      streamInfo.stream);
+    // Host side of a DualArray is pinned, so this copy is truly async
+    buf.data.toHostAsync(streamInfo.stream);
+    if (async) {
+        if (!buf.ready)
+            DEME_GPU_CALL(cudaEventCreateWithFlags(&buf.ready, cudaEventDisableTiming));
+        DEME_GPU_CALL(cudaEventRecord(buf.ready, streamInfo.stream));
+        buf.pending = true;
+    } else {
+        DEME_GPU_CALL(cudaStreamSynchronize(streamInfo.stream));
+    }
+}
+
 void DEMDynamicThread::setFamilyContactWildcardValue_impl(
     unsigned int N1,
     unsigned int N2,
@@ -2896,13 +4283,8 @@ void DEMDynamicThread::setContactWildcardValue(unsigned int wc_num, float val) {
 }
 
 void DEMDynamicThread::setOwnerWildcardValue(bodyID_t ownerID, unsigned int wc_num, const std::vector<float>& vals) {
-    // `set' methods should in general use async-ed flavor, as it only matters when the next kernel is called, which is
-    // serial to the memory transaction
-    for (size_t i = 0; i < vals.size(); i++) {
-        (*ownerWildcards[wc_num])[ownerID + i] = vals.at(i);
-    }
-    // Partial send to device
-    ownerWildcards[wc_num]->toDevice(ownerID, vals.size());
+    setMappedVals(*ownerWildcards[wc_num], ownerUserToImpl, vals, ownerID);
+    syncMemoryTransfer();
 }
 
 void DEMDynamicThread::setTriWildcardValue(bodyID_t geoID, unsigned int wc_num, const std::vector<float>& vals) {
@@ -2914,11 +4296,8 @@ void DEMDynamicThread::setTriWildcardValue(bodyID_t geoID, unsigned int wc_num,
 }
 
 void DEMDynamicThread::setSphWildcardValue(bodyID_t geoID, unsigned int wc_num, const std::vector<float>& vals) {
-    for (size_t i = 0; i < vals.size(); i++) {
-        (*sphereWildcards[wc_num])[geoID + i] = vals.at(i);
-    }
-    // Partial send to device
-    sphereWildcards[wc_num]->toDevice(geoID, vals.size());
+    setMappedVals(*sphereWildcards[wc_num], sphereUserToImpl, vals, geoID);
+    syncMemoryTransfer();
 }
 
 void DEMDynamicThread::setAnalWildcardValue(bodyID_t geoID, unsigned int wc_num, const std::vector<float>& vals) {
@@ -2936,7 +4315,9 @@ void DEMDynamicThread::setFamilyOwnerWildcardValue(unsigned int family_num,
     ownerWildcards[wc_num]->toHost();
     migrateFamilyToHost();
     size_t count = 0;
-    for (size_t i = 0; i < simParams->nOwnerBodies; i++) {
+    // Go through the owners in user-facing order, as the values are given in that order
+    for (size_t u = 0; u < simParams->nOwnerBodies; u++) {
+        const bodyID_t i = ownerImplID(u);
         if (+(familyID[i]) == family_num) {
             (*ownerWildcards[wc_num])[i] = vals.at(count);
             if (count + 1 < vals.size()) {
@@ -2948,7 +4329,7 @@ void DEMDynamicThread::setFamilyOwnerWildcardValue(unsigned int family_num,
 }
 
 void DEMDynamicThread::getSphereWildcardValue(std::vector<float>& res, bodyID_t ID, unsigned int wc_num, size_t n) {
-    res = std::move(sphereWildcards[wc_num]->getVal(ID, n));
+    res = getMappedVals(*sphereWildcards[wc_num], sphereUserToImpl, ID, n);
 }
 
 void DEMDynamicThread::getTriWildcardValue(std::vector<float>& res, bodyID_t ID, unsigned int wc_num, size_t n) {
@@ -2960,11 +4341,11 @@ void DEMDynamicThread::getAnalWildcardValue(std::vector<float>& res, bodyID_t ID
 }
 
 std::vector<float> DEMDynamicThread::getOwnerWildcardValue(bodyID_t ID, unsigned int wc_num, bodyID_t n) {
-    return std::move(ownerWildcards[wc_num]->getVal(ID, n));
+    return getMappedVals(*ownerWildcards[wc_num], ownerUserToImpl, ID, n);
 }
 
 void DEMDynamicThread::getAllOwnerWildcardValue(std::vector<float>& res, unsigned int wc_num) {
-    res = std::move(ownerWildcards[wc_num]->getVal(0, simParams->nOwnerBodies));
+    res = getMappedVals(*ownerWildcards[wc_num], ownerUserToImpl, 0, simParams->nOwnerBodies);
 }
 
 void DEMDynamicThread::getFamilyOwnerWildcardValue(std::vector<float>& res,
@@ -2975,7 +4356,8 @@ void DEMDynamicThread::getFamilyOwnerWildcardValue(std::vector<float>& res,
     migrateFamilyToHost();
     res.resize(simParams->nOwnerBodies);
     size_t count = 0;
-    for (size_t i = 0; i < simParams->nOwnerBodies; i++) {
+    for (size_t u = 0; u < simParams->nOwnerBodies; u++) {
+        const bodyID_t i = ownerImplID(u);
         if (+(familyID[i]) == family_num) {
             res[count] = (*ownerWildcards[wc_num])[i];
             count++;
@@ -2986,9 +4368,9 @@ void DEMDynamicThread::getFamilyOwnerWildcardValue(std::vector<float>& res,
 
 std::vector<float3> DEMDynamicThread::getOwnerAngVel(bodyID_t ownerID, bodyID_t n) {
     std::vector<float3> angVel(n);
-    auto X = omgBarX.getVal(ownerID, n);
-    auto Y = omgBarY.getVal(ownerID, n);
-    auto Z = omgBarZ.getVal(ownerID, n);
+    auto X = getMappedVals(omgBarX, ownerUserToImpl, ownerID, n);
+    auto Y = getMappedVals(omgBarY, ownerUserToImpl, ownerID, n);
+    auto Z = getMappedVals(omgBarZ, ownerUserToImpl, ownerID, n);
     for (bodyID_t i = 0; i < n; i++) {
         angVel[i] = make_float3(X[i], Y[i], Z[i]);
     }
@@ -2997,10 +4379,10 @@ std::vector<float3> DEMDynamicThread::getOwnerAngVel(bodyID_t ownerID, bodyID_t
 
 std::vector<float4> DEMDynamicThread::getOwnerOriQ(bodyID_t ownerID, bodyID_t n) {
     std::vector<float4> oriQ(n);
-    auto W = oriQw.getVal(ownerID, n);
-    auto X = oriQx.getVal(ownerID, n);
-    auto Y = oriQy.getVal(ownerID, n);
-    auto Z = oriQz.getVal(ownerID, n);
+    auto W = getMappedVals(oriQw, ownerUserToImpl, ownerID, n);
+    auto X = getMappedVals(oriQx, ownerUserToImpl, ownerID, n);
+    auto Y = getMappedVals(oriQy, ownerUserToImpl, ownerID, n);
+    auto Z = getMappedVals(oriQz, ownerUserToImpl, ownerID, n);
     for (bodyID_t i = 0; i < n; i++) {
         oriQ[i] = make_float4(X[i], Y[i], Z[i], W[i]);
     }
@@ -3009,9 +4391,9 @@ std::vector<float4> DEMDynamicThread::getOwnerOriQ(bodyID_t ownerID, bodyID_t n)
 
 std::vector<float3> DEMDynamicThread::getOwnerAcc(bodyID_t ownerID, bodyID_t n) {
     std::vector<float3> acc(n);
-    auto X = aX.getVal(ownerID, n);
-    auto Y = aY.getVal(ownerID, n);
-    auto Z = aZ.getVal(ownerID, n);
+    auto X = getMappedVals(aX, ownerUserToImpl, ownerID, n);
+    auto Y = getMappedVals(aY, ownerUserToImpl, ownerID, n);
+    auto Z = getMappedVals(aZ, ownerUserToImpl, ownerID, n);
     for (bodyID_t i = 0; i < n; i++) {
         acc[i] = make_float3(X[i], Y[i], Z[i]);
     }
@@ -3020,9 +4402,9 @@ std::vector<float3> DEMDynamicThread::getOwnerAcc(bodyID_t ownerID, bodyID_t n)
 
 std::vector<float3> DEMDynamicThread::getOwnerAngAcc(bodyID_t ownerID, bodyID_t n) {
     std::vector<float3> aa(n);
-    auto X = alphaX.getVal(ownerID, n);
-    auto Y = alphaY.getVal(ownerID, n);
-    auto Z = alphaZ.getVal(ownerID, n);
+    auto X = getMappedVals(alphaX, ownerUserToImpl, ownerID, n);
+    auto Y = getMappedVals(alphaY, ownerUserToImpl, ownerID, n);
+    auto Z = getMappedVals(alphaZ, ownerUserToImpl, ownerID, n);
     for (bodyID_t i = 0; i < n; i++) {
         aa[i] = make_float3(X[i], Y[i], Z[i]);
     }
@@ -3031,9 +4413,9 @@ std::vector<float3> DEMDynamicThread::getOwnerAngAcc(bodyID_t ownerID, bodyID_t
 
 std::vector<float3> DEMDynamicThread::getOwnerVel(bodyID_t ownerID, bodyID_t n) {
     std::vector<float3> vel(n);
-    auto X = vX.getVal(ownerID, n);
-    auto Y = vY.getVal(ownerID, n);
-    auto Z = vZ.getVal(ownerID, n);
+    auto X = getMappedVals(vX, ownerUserToImpl, ownerID, n);
+    auto Y = getMappedVals(vY, ownerUserToImpl, ownerID, n);
+    auto Z = getMappedVals(vZ, ownerUserToImpl, ownerID, n);
     for (bodyID_t i = 0; i < n; i++) {
         vel[i] = make_float3(X[i], Y[i], Z[i]);
     }
@@ -3042,10 +4424,10 @@ std::vector<float3> DEMDynamicThread::getOwnerVel(bodyID_t ownerID, bodyID_t n)
 
 std::vector<float3> DEMDynamicThread::getOwnerPos(bodyID_t ownerID, bodyID_t n) {
     std::vector<float3> pos(n);
-    std::vector<voxelID_t> voxel = voxelID.getVal(ownerID, n);
-    std::vector<subVoxelPos_t> subVoxX = locX.getVal(ownerID, n);
-    std::vector<subVoxelPos_t> subVoxY = locY.getVal(ownerID, n);
-    std::vector<subVoxelPos_t> subVoxZ = locZ.getVal(ownerID, n);
+    std::vector<voxelID_t> voxel = getMappedVals(voxelID, ownerUserToImpl, ownerID, n);
+    std::vector<subVoxelPos_t> subVoxX = getMappedVals(locX, ownerUserToImpl, ownerID, n);
+    std::vector<subVoxelPos_t> subVoxY = getMappedVals(locY, ownerUserToImpl, ownerID, n);
+    std::vector<subVoxelPos_t> subVoxZ = getMappedVals(locZ, ownerUserToImpl, ownerID, n);
     for (bodyID_t i = 0; i < n; i++) {
         double X, Y, Z;
         voxelIDToPosition<double, voxelID_t, subVoxelPos_t>(X, Y, Z, voxel[i], subVoxX[i], subVoxY[i], subVoxZ[i],
@@ -3059,7 +4441,7 @@ std::vector<float3> DEMDynamicThread::getOwnerPos(bodyID_t ownerID, bodyID_t n)
 std::vector<unsigned int> DEMDynamicThread::getOwnerFamily(bodyID_t ownerID, bodyID_t n) {
     std::vector<unsigned int> fam(n);
     // Get from device by default, even not needed
-    auto short_fam = familyID.getVal(ownerID, n);
+    auto short_fam = getMappedVals(familyID, ownerUserToImpl, ownerID, n);
     for (bodyID_t i = 0; i < n; i++) {
         fam[i] = (unsigned int)(+(short_fam[i]));
     }
@@ -3067,9 +4449,9 @@ std::vector<unsigned int> DEMDynamicThread::getOwnerFamily(bodyID_t ownerID, bod
 }
 
 void DEMDynamicThread::setOwnerAngVel(bodyID_t ownerID, const std::vector<float3>& angVel) {
-    omgBarX.setVal(streamInfo.stream, RealTupleVectorToXComponentVector<float, float3>(angVel), ownerID);
-    omgBarY.setVal(streamInfo.stream, RealTupleVectorToYComponentVector<float, float3>(angVel), ownerID);
-    omgBarZ.setVal(streamInfo.stream, RealTupleVectorToZComponentVector<float, float3>(angVel), ownerID);
+    setMappedVals(omgBarX, ownerUserToImpl, RealTupleVectorToXComponentVector<float, float3>(angVel), ownerID);
+    setMappedVals(omgBarY, ownerUserToImpl, RealTupleVectorToYComponentVector<float, float3>(angVel), ownerID);
+    setMappedVals(omgBarZ, ownerUserToImpl, RealTupleVectorToZComponentVector<float, float3>(angVel), ownerID);
     syncMemoryTransfer();
 }
 
@@ -3087,30 +4469,31 @@ void DEMDynamicThread::setOwnerPos(bodyID_t ownerID, const std::vector<float3>&
                                                             simParams->l);
     }
 
-    voxelID.setVal(streamInfo.stream, vID, ownerID);
-    locX.setVal(streamInfo.stream, subIDx, ownerID);
-    locY.setVal(streamInfo.stream, subIDy, ownerID);
-    locZ.setVal(streamInfo.stream, subIDz, ownerID);
+    setMappedVals(voxelID, ownerUserToImpl, vID, ownerID);
+    setMappedVals(locX, ownerUserToImpl, subIDx, ownerID);
+    setMappedVals(locY, ownerUserToImpl, subIDy, ownerID);
+    setMappedVals(locZ, ownerUserToImpl, subIDz, ownerID);
     syncMemoryTransfer();
 }
 
 void DEMDynamicThread::setOwnerOriQ(bodyID_t ownerID, const std::vector<float4>& oriQ) {
-    oriQw.setVal(streamInfo.stream, RealTupleVectorToWComponentVector<float, float4>(oriQ), ownerID);
-    oriQx.setVal(streamInfo.stream, RealTupleVectorToXComponentVector<float, float4>(oriQ), ownerID);
-    oriQy.setVal(streamInfo.stream, RealTupleVectorToYComponentVector<float, float4>(oriQ), ownerID);
-    oriQz.setVal(streamInfo.stream, RealTupleVectorToZComponentVector<float, float4>(oriQ), ownerID);
+    setMappedVals(oriQw, ownerUserToImpl, RealTupleVectorToWComponentVector<float, float4>(oriQ), ownerID);
+    setMappedVals(oriQx, ownerUserToImpl, RealTupleVectorToXComponentVector<float, float4>(oriQ), ownerID);
+    setMappedVals(oriQy, ownerUserToImpl, RealTupleVectorToYComponentVector<float, float4>(oriQ), ownerID);
+    setMappedVals(oriQz, ownerUserToImpl, RealTupleVectorToZComponentVector<float, float4>(oriQ), ownerID);
     syncMemoryTransfer();
 }
 
 void DEMDynamicThread::setOwnerVel(bodyID_t ownerID, const std::vector<float3>& vel) {
-    vX.setVal(streamInfo.stream, RealTupleVectorToXComponentVector<float, float3>(vel), ownerID);
-    vY.setVal(streamInfo.stream, RealTupleVectorToYComponentVector<float, float3>(vel), ownerID);
-    vZ.setVal(streamInfo.stream, RealTupleVectorToZComponentVector<float, float3>(vel), ownerID);
+    setMappedVals(vX, ownerUserToImpl, RealTupleVectorToXComponentVector<float, float3>(vel), ownerID);
+    setMappedVals(vY, ownerUserToImpl, RealTupleVectorToYComponentVector<float, float3>(vel), ownerID);
+    setMappedVals(vZ, ownerUserToImpl, RealTupleVectorToZComponentVector<float, float3>(vel), ownerID);
     syncMemoryTransfer();
 }
 
 void DEMDynamicThread::setOwnerFamily(bodyID_t ownerID, family_t fam, bodyID_t n) {
-    familyID.setVal(std::vector<family_t>(n, fam), ownerID);
+    setMappedVals(familyID, ownerUserToImpl, std::vector<family_t>(n, fam), ownerID);
+    syncMemoryTransfer();
 }
 
 void DEMDynamicThread::setTriNodeRelPos(size_t start, const std::vector<DEMTriangle>& triangles) {
@@ -3139,18 +4522,18 @@ void DEMDynamicThread::updateTriNodeRelPos(size_t start, const std::vector<DEMTr
 }
 
 void DEMDynamicThread::addOwnerNextStepAcc(bodyID_t ownerID, const std::vector<float3>& acc) {
-    accSpecified.setVal(streamInfo.stream, std::vector<notStupidBool_t>(acc.size(), 1), ownerID);
-    aX.setVal(streamInfo.stream, RealTupleVectorToXComponentVector<float, float3>(acc), ownerID);
-    aY.setVal(streamInfo.stream, RealTupleVectorToYComponentVector<float, float3>(acc), ownerID);
-    aZ.setVal(streamInfo.stream, RealTupleVectorToZComponentVector<float, float3>(acc), ownerID);
+    setMappedVals(accSpecified, ownerUserToImpl, std::vector<notStupidBool_t>(acc.size(), 1), ownerID);
+    setMappedVals(aX, ownerUserToImpl, RealTupleVectorToXComponentVector<float, float3>(acc), ownerID);
+    setMappedVals(aY, ownerUserToImpl, RealTupleVectorToYComponentVector<float, float3>(acc), ownerID);
+    setMappedVals(aZ, ownerUserToImpl, RealTupleVectorToZComponentVector<float, float3>(acc), ownerID);
     syncMemoryTransfer();
 }
 
 void DEMDynamicThread::addOwnerNextStepAngAcc(bodyID_t ownerID, const std::vector<float3>& angAcc) {
-    angAccSpecified.setVal(streamInfo.stream, std::vector<notStupidBool_t>(angAcc.size(), 1), ownerID);
-    alphaX.setVal(streamInfo.stream, RealTupleVectorToXComponentVector<float, float3>(angAcc), ownerID);
-    alphaY.setVal(streamInfo.stream, RealTupleVectorToYComponentVector<float, float3>(angAcc), ownerID);
-    alphaZ.setVal(streamInfo.stream, RealTupleVectorToZComponentVector<float, float3>(angAcc), ownerID);
+    setMappedVals(angAccSpecified, ownerUserToImpl, std::vector<notStupidBool_t>(angAcc.size(), 1), ownerID);
+    setMappedVals(alphaX, ownerUserToImpl, RealTupleVectorToXComponentVector<float, float3>(angAcc), ownerID);
+    setMappedVals(alphaY, ownerUserToImpl, RealTupleVectorToYComponentVector<float, float3>(angAcc), ownerID);
+    setMappedVals(alphaZ, ownerUserToImpl, RealTupleVectorToZComponentVector<float, float3>(angAcc), ownerID);
     syncMemoryTransfer();
 }
 
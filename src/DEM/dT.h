@@ -6,11 +6,13 @@
 #ifndef DEME_DT
 #define DEME_DT
 
+#include <deque>
 #include <mutex>
 #include <vector>
 #include <thread>
 #include <unordered_map>
 #include <set>
+#include <filesystem>
 #include <functional>
 
 #include <core/ApiVersion.h>
@@ -24,11 +26,11 @@
 #include <DEM/Defines.h>
 #include <DEM/Structs.h>
 #include <DEM/AuxClasses.h>
+#include <DEM/OutputWriter.h>
+#include <DEM/DriftController.h>
 
-// Forward declare jitify::Program to avoid downstream dependency
-namespace jitify {
-class Program;
-}
+// Forward declare JitProgram to avoid downstream dependency
+class JitProgram;
 
 namespace deme {
 
@@ -37,6 +39,47 @@ class DEMKinematicThread;
 class DEMDynamicThread;
 class DEMSolverScratchData;
 
+/// Device and pinned host staging of a StateSnapshot. An async gather leaves pending set until the ready event is
+/// waited on.
+struct StateSnapshotBuffer {
+    DualArray<bodyID_t> ownerIDs;
+    DualArray<float> data;
+    bool ownerIDsOnDevice = false;
+    // Owner reordering count when the IDs were uploaded; they are uploaded again if owners have moved since
+    unsigned int ownerMapVersion = 0;
+    bool pending = false;
+    cudaEvent_t ready = nullptr;
+
+    void wait() {
+        if (pending) {
+            DEME_GPU_CALL(cudaEventSynchronize(ready));
+            pending = false;
+        }
+    }
+    ~StateSnapshotBuffer() {
+        if (ready) {
+            cudaEventSynchronize(ready);
+            cudaEventDestroy(ready);
+        }
+    }
+};
+
+/// Resident buffers of a DEMForceProbe. They only grow, so polling a probe every step does not allocate.
+struct ForceProbeBuffer {
+    // Sorted probed owners
+    DualArray<bodyID_t> ownerIDs;
+    bool ownerIDsOnDevice = false;
+    unsigned int ownerMapVersion = 0;
+    // Per-contact results
+    DualArray<float3> points;
+    DualArray<float3> forces;
+    DualArray<float3> torques;
+    DualArray<size_t> numUsefulCnt;
+    // Net wrench, and its per-block partial sums
+    DualArray<double> wrench;
+    DualArray<double> blockWrench;
+};
+
 /// DynamicThread class
 class DEMDynamicThread {
   protected:
@@ -80,6 +123,12 @@ class DEMDynamicThread {
     // dT believes this amount of future drift is ideal
     DualStruct<unsigned int> perhapsIdealFutureDrift = DualStruct<unsigned int>(0);
 
+    // Parameters of the adaptive time stepper (only used if the step size is not constant)
+    AdaptiveTSParams adaptTSParams;
+    // Step size history of the adaptive time stepper: a record is added each time the step size changes noticeably,
+    // and only the latest TS_HISTORY_MAX_RECORDS are kept
+    std::deque<TimeStepRecord> tsHistory;
+
     // Buffer arrays for storing info from the dT side.
     // kT modifies these arrays; dT uses them only.
 
@@ -158,6 +207,8 @@ class DEMDynamicThread {
 
     // The (impl-level) family IDs whose entities should not be outputted to files
     std::unordered_set<family_t> familiesNoOutput;
+    // Whether VTK XML (VTP/VTU) output arrays are zlib-compressed
+    bool compressVtk = false;
 
     // The voxel ID (split into 3 parts, representing XYZ location)
     DualArray<voxelID_t> voxelID = DualArray<voxelID_t>(&m_approxHostBytesUsed, &m_approxDeviceBytesUsed);
@@ -298,6 +349,15 @@ class DEMDynamicThread {
                                             "Wait for kT update"};
     SolverTimers timers = SolverTimers(timer_names);
 
+    // Host snapshot reused by synchronous file writes
+    OutputFrame syncOutputFrame;
+    // Background writer for asynchronous file writes (null if output is synchronous)
+    std::unique_ptr<DEMOutputWriter> outputWriter;
+    // Contact info reused across contact queries and outputs, as long as nobody else still holds on to it
+    std::shared_ptr<CompactContactInfo> m_compactContactInfo;
+    // Indices of the contacts that pass the force threshold, scratch space for generating contact info
+    std::vector<size_t> m_cntOutIndices;
+
   public:
     friend class DEMSolver;
     friend class DEMKinematicThread;
@@ -453,9 +513,64 @@ class DEMDynamicThread {
                                  std::vector<float3>& torques,
                                  bool torque_in_local = false);
 
+    /// @brief Gather the states of the owners in buf.ownerIDs into buf.data, record_len floats per owner, with one
+    /// device gather and one copy back to pinned host memory. If async, it only enqueues the work on dT's stream and
+    /// records buf.ready, so it lands before dT's next step modifies the states; otherwise it waits for it.
+    void gatherStateSnapshot(StateSnapshotBuffer& buf, unsigned int content, unsigned int record_len, bool async);
+
+    /// @brief Query the contacts concerning the owners of a force probe using its resident buffers. The net wrench
+    /// (force, then torque about ref, in global frame) of the probed set is written to wrench; if need_contacts, the
+    /// per-contact points, forces and torques (in global frame, about the owner CoM) are brought to buf's host side.
+    /// @return Number of per-contact results (0 if !need_contacts).
+    size_t updateForceProbe(ForceProbeBuffer& buf, const float3& ref, bool need_contacts, double* wrench);
+
     /// Get owner of contact geo B.
     bodyID_t getGeoOwnerID(const bodyID_t& geoB, const contact_t& type) const;
 
+    /// @brief Move clump owners, and their spheres with them, to a new order in all dT and kT arrays, including the
+    /// contact pairs and kT's contact history. The user-facing owner and sphere IDs do not change.
+    /// @param order Element i is the current ID of the owner that goes to position i. Only clump owners may move.
+    /// @details Done on host, so kT and dT must be synced.
+    void reorderOwners(const std::vector<bodyID_t>& order);
+    /// Get the owner order (see reorderOwners) that sorts clump owners along a Morton curve of their CoM.
+    std::vector<bodyID_t> getMortonOwnerOrder();
+    /// @brief Remove the owners of a family, and their spheres and triangles, from all dT and kT arrays, including the
+    /// contact pairs and kT's contact history. The rest are packed in user-facing ID order, so the user-facing IDs
+    /// become array positions (and consecutive) again, and the memory beyond them is released.
+    /// @param ownerUserNew Set to map each current user-facing owner ID to the new one (NULL_BODYID if removed).
+    /// @param sphUserNew Same, for sphere IDs.
+    /// @param triNew Same, for triangle IDs.
+    /// @return Number of owners removed.
+    /// @details Done on host, so kT and dT must be synced. Analytical objects cannot be removed.
+    size_t purgeFamily(family_t family,
+                       std::vector<bodyID_t>& ownerUserNew,
+                       std::vector<bodyID_t>& sphUserNew,
+                       std::vector<bodyID_t>& triNew);
+    /// Set the contact wildcards that change sign when the roles of the two geometries in a contact swap.
+    void setAntisymmetricContactWildcards(const std::set<std::string>& names) { m_antisym_wildcard_names = names; }
+
+    /// Where the owner with this user-facing ID currently is in the arrays, and the reverse.
+    bodyID_t ownerImplID(bodyID_t userID) const {
+        return (userID < ownerUserToImpl.size()) ? ownerUserToImpl[userID] : userID;
+    }
+    bodyID_t ownerUserID(bodyID_t implID) const {
+        return (implID < ownerImplToUser.size()) ? ownerImplToUser[implID] : implID;
+    }
+    std::vector<bodyID_t> ownerImplIDs(const std::vector<bodyID_t>& userIDs) const;
+    /// Whether owners have been reordered, so user-facing and impl-level owner IDs may differ.
+    bool ownerIDsRemapped() const { return !ownerUserToImpl.empty(); }
+    /// Where the sphere with this user-facing ID currently is in the arrays, and the reverse.
+    bodyID_t sphereImplID(bodyID_t userID) const {
+        return (userID < sphereUserToImpl.size()) ? sphereUserToImpl[userID] : userID;
+    }
+    bodyID_t sphereUserID(bodyID_t implID) const {
+        return (implID < sphereImplToUser.size()) ? sphereImplToUser[implID] : implID;
+    }
+    /// User-facing ID of contact geo B (only spheres are ever reordered).
+    bodyID_t geoBUserID(bodyID_t geoB, contact_t type) const {
+        return (type == SPHERE_SPHERE_CONTACT) ? sphereUserID(geoB) : geoB;
+    }
+
     /// Let dT know that it needs a kT update, as something important may have changed, and old contact pair info is no
     /// longer valid.
     void announceCritical() { pendingCriticalUpdate = true; }
@@ -582,9 +697,19 @@ class DEMDynamicThread {
     // Move array data to or from device
     void migrateDataToDevice();
     // void migrateDataToHost();
+    // Move only the entities appended after the given numbers of existing owners, spheres, triangles and contacts
+    void migrateNewEntitiesToDevice(size_t nExistOwners,
+                                    size_t nExistSpheres,
+                                    size_t nExistFacets,
+                                    size_t nExistContacts);
+    // Make room in the per-owner, per-sphere and per-triangle arrays, so they can grow to these sizes without
+    // reallocating
+    void reserveEntityArrays(size_t nOwners, size_t nSpheres, size_t nTris);
 
     // Generate contact info container based on the current contact array, and return it.
     std::shared_ptr<ContactInfoContainer> generateContactInfo(float force_thres);
+    // Same info in compact form. The returned container is recycled by the next call once the caller lets go of it.
+    std::shared_ptr<CompactContactInfo> generateCompactContactInfo(float force_thres);
 
 #ifdef DEME_USE_CHPF
     void writeSpheresAsChpf(std::ofstream& ptFile);
@@ -593,7 +718,36 @@ class DEMDynamicThread {
     void writeSpheresAsCsv(std::ofstream& ptFile);
     void writeClumpsAsCsv(std::ofstream& ptFile, unsigned int accuracy = 10);
     void writeContactsAsCsv(std::ofstream& ptFile, float force_thres = DEME_TINY_FLOAT);
+    void writeSpheresAsBinary(std::ofstream& ptFile);
+    void writeClumpsAsBinary(std::ofstream& ptFile);
+    void writeContactsAsBinary(std::ofstream& ptFile, float force_thres = DEME_TINY_FLOAT);
+    void writeSpheresAsVtp(std::ofstream& ptFile);
+    void writeClumpsAsVtp(std::ofstream& ptFile);
+    void writeContactsAsVtp(std::ofstream& ptFile, float force_thres = DEME_TINY_FLOAT);
+
+    // Copy what is needed to write a sphere/clump/contact file into a host-side frame
+    void snapshotOutputFrame(OutputFrame& frame, OUTPUT_FRAME_TYPE type, float force_thres = DEME_TINY_FLOAT);
+    // Asynchronous output: frames are snapshotted here and written by a background thread
+    void setAsyncOutput(bool use, unsigned int max_queued);
+    bool isOutputAsync() const { return (bool)outputWriter; }
+    void submitOutputFrame(OUTPUT_FRAME_TYPE type,
+                           OUTPUT_FORMAT format,
+                           const std::string& filename,
+                           unsigned int accuracy = 10,
+                           float force_thres = DEME_TINY_FLOAT);
+    void flushOutput();
+
+    // Write/read the full solver state (owner states, wildcards, contact pairs and kT's contact history) to/from the
+    // checkpoint directory dir
+    void saveCheckpoint(const std::filesystem::path& dir);
+    void loadCheckpoint(const std::filesystem::path& dir);
     void writeMeshesAsVtk(std::ofstream& ptFile);
+    void writeMeshesAsVtu(std::ofstream& ptFile);
+    // Global vertex coordinates (3 per vertex) and triangle vertex indices (3 per triangle, already offset into the
+    // combined vertex list) of all meshes whose family is not in the no-output list, plus each triangle's owner
+    void gatherMeshesForOutput(std::vector<float>& xyz,
+                               std::vector<int64_t>& tri_vertices,
+                               std::vector<bodyID_t>& tri_owners);
 
     /// Called each time when the user calls DoDynamicsThenSync.
     void startThread();
@@ -633,7 +787,7 @@ class DEMDynamicThread {
                        const std::vector<std::string>& JitifyOptions);
 
     // Execute this kernel, then return the reduced value
-    float* inspectCall(const std::shared_ptr<jitify::Program>& inspection_kernel,
+    float* inspectCall(const std::shared_ptr<JitProgram>& inspection_kernel,
                        const std::string& kernel_name,
                        INSPECT_ENTITY_TYPE thing_to_insp,
                        CUB_REDUCE_FLAVOR reduce_flavor,
@@ -648,6 +802,40 @@ class DEMDynamicThread {
     // contact map for dT.
     bool new_contacts_loaded = false;
 
+    // Owners and spheres may be moved around in the arrays by reorderOwners, but the IDs the user sees stay the same.
+    // These map user-facing IDs to where the entities currently are, and back. Empty means no reordering happened, and
+    // IDs beyond their lengths (entities added by UpdateClumps after a reordering) are not remapped either.
+    std::vector<bodyID_t> ownerUserToImpl;
+    std::vector<bodyID_t> ownerImplToUser;
+    std::vector<bodyID_t> sphereUserToImpl;
+    std::vector<bodyID_t> sphereImplToUser;
+    // Number of reorderings so far, so cached owner ID uploads know when they are stale
+    unsigned int ownerMapVersion = 0;
+    // Contact wildcards that flip sign if a contact's A and B swap, which reordering may need to do
+    std::set<std::string> m_antisym_wildcard_names = {"delta_tan_x", "delta_tan_y", "delta_tan_z"};
+
+    // Bring the contact pairs to a new sphere and triangle numbering. sphNew and triNew map current IDs to new ones
+    // (NULL_BODYID if removed; an empty triNew means triangles keep their IDs). Pairs involving a removed geometry are
+    // dropped and the rest packed to the front, in their current order.
+    void remapContactPairs(const std::vector<bodyID_t>& sphNew, const std::vector<bodyID_t>& triNew);
+    // Rebuild kT's contact history from the (remapped) contact pairs, and put the pairs in the order the next CD
+    // expects them relative to that history. Persistency flags in the old history are carried over via sphNew and
+    // triNew, which are as in remapContactPairs.
+    void rebuildContactHistory(const std::vector<bodyID_t>& sphNew, const std::vector<bodyID_t>& triNew);
+
+    // Read n user-facing consecutive entries of an owner- or sphere-indexed array, or write them, through a
+    // user-to-impl ID map (see ownerUserToImpl)
+    template <typename T>
+    std::vector<T> getMappedVals(DualArray<T>& arr, const std::vector<bodyID_t>& userToImpl, size_t start, size_t n);
+    template <typename T>
+    void setMappedVals(DualArray<T>& arr,
+                       const std::vector<bodyID_t>& userToImpl,
+                       const std::vector<T>& vals,
+                       size_t start);
+    // Upload the user-facing owner IDs held on the host side of ids to its device side, translated to where the owners
+    // currently are (and sorted, if asked)
+    void uploadOwnerIDs(DualArray<bodyID_t>& ids, bool sort);
+
     // Meshes cached on dT side that has corresponding owner number associated. Useful for outputting meshes.
     std::vector<std::shared_ptr<DEMMeshConnected>> m_meshes;
 
@@ -661,6 +849,35 @@ class DEMDynamicThread {
     // The inspector for calculating max vel for this cycle
     std::shared_ptr<DEMInspector> approxMaxVelFunc;
 
+    // Adaptive time stepper states.
+    // System max velocity, found the last time determineSysVel was called
+    float sysMaxVel = 0.;
+    // kT sizes its contact margins assuming dT's step size is at most this. tsCapInFlight goes with the work order kT
+    // is currently on; tsCapActive goes with the contact pairs dT is currently using, and the step size stays below it.
+    double tsCapInFlight = DEME_HUGE_FLOAT;
+    double tsCapActive = DEME_HUGE_FLOAT;
+    // The step size before being shortened to land on the end of a user call, and whether it was shortened this step
+    double tsBeforeCycleEnd = 0.;
+    bool tsShortenedForCycleEnd = false;
+    // The smallest of the velocity- and stiffness-based step size bounds, found the last time determineSysVel was called
+    double tsPhysicalBound = DEME_HUGE_FLOAT;
+    TS_LIMITER tsPhysicalLimiter = TS_LIMITER::NONE;
+    // Step size suggested by the error estimate of the last accepted step (int_diff strategy)
+    double tsFromErrEst = DEME_HUGE_FLOAT;
+    // What decided the step size currently in use, and the number of rejected tries of the current step
+    TS_LIMITER tsLimiter = TS_LIMITER::NONE;
+    unsigned int tsNumRejected = 0;
+    // Owner accelerations of the last accepted step (int_diff strategy), and whether they can be compared against
+    DualArray<float> accPrevStep = DualArray<float>(&m_approxHostBytesUsed, &m_approxDeviceBytesUsed);
+    bool accPrevStepValid = false;
+    unsigned int accPrevStepMapVersion = 0;
+    // Simulation time passed since accPrevStep was saved
+    double accPrevStepAge = 0.;
+    // Saved contact wildcards, then owner wildcards, of the step being tried (int_diff strategy)
+    std::vector<float*> wildcardSnapshots;
+    // Reduction results of the adaptive time stepper
+    DualArray<float> adaptTSReduceRes = DualArray<float>(&m_approxHostBytesUsed, &m_approxDeviceBytesUsed);
+
     // Some private arrays that can be used to store inspection results, ready to be passed somewhere else
     DualArray<scratch_t> m_reduceResArr = DualArray<scratch_t>(&m_approxHostBytesUsed, &m_approxDeviceBytesUsed);
     DualArray<scratch_t> m_reduceRes = DualArray<scratch_t>(&m_approxHostBytesUsed, &m_approxDeviceBytesUsed);
@@ -685,6 +902,19 @@ class DEMDynamicThread {
     // Determine the max vel for this cycle, kT needs it
     inline float* determineSysVel();
 
+    // Adaptive time stepping: pick the size of the next step (remaining is what is left of this user call); estimate
+    // the error of the step just tried and return whether it is accepted, otherwise shrink the step size; record the
+    // step size in the history
+    inline void proposeStepSize(double remaining);
+    inline bool assessStepError();
+    inline void recordStepSize();
+    // Keep the owner accelerations of this step, for the error estimate of the next (int_diff strategy)
+    inline void saveAccOfThisStep();
+    // Save or restore the contact and owner wildcards, so a rejected step can be retried
+    inline void snapshotWildcards();
+    inline void restoreWildcards();
+    inline void releaseWildcardSnapshot();
+
     // Some per-step checks/modification, done before integration, but after force calculation (thus sort of in the
     // mid-step stage)
     inline void routineChecks();
@@ -710,48 +940,22 @@ class DEMDynamicThread {
         const std::function<bool(unsigned int, unsigned int, unsigned int, unsigned int)>& condition);
 
     // Just-in-time compiled kernels
-    std::shared_ptr<jitify::Program> prep_force_kernels;
-    std::shared_ptr<jitify::Program> cal_force_kernels;
-    std::shared_ptr<jitify::Program> collect_force_kernels;
-    std::shared_ptr<jitify::Program> integrator_kernels;
-    // std::shared_ptr<jitify::Program> quarry_stats_kernels;
-    std::shared_ptr<jitify::Program> mod_kernels;
-    std::shared_ptr<jitify::Program> misc_kernels;
-
-    // Adjuster for update freq
-    class AccumStepUpdater {
-      private:
-        unsigned int num_steps = 0;
-        unsigned int num_updates = 0;
-        unsigned int cached_size = 200;
-
-      public:
-        AccumStepUpdater() {}
-        ~AccumStepUpdater() {}
-        inline void AddUpdate() { num_updates++; }
-        inline void AddStep() { num_steps++; }
-        inline bool Query(unsigned int& ideal) {
-            if (num_updates > NUM_STEPS_RESERVED_AFTER_RENEWING_FREQ_TUNER) {
-                // * 2 because double update freq is an ideal future drift
-                ideal = (unsigned int)((double)num_steps / num_updates * 2);
-                if (num_updates >= cached_size) {
-                    Clear();
-                }
-                return true;
-            } else {
-                return false;
-            }
-        }
-
-        // Return this accumulator to initial state
-        void Clear() {
-            num_steps = 0;
-            num_updates = 0;
-        }
-
-        void SetCacheSize(unsigned int n) { cached_size = n; }
-    };
-    AccumStepUpdater accumStepUpdater = AccumStepUpdater();
+    std::shared_ptr<JitProgram> prep_force_kernels;
+    std::shared_ptr<JitProgram> cal_force_kernels;
+    std::shared_ptr<JitProgram> collect_force_kernels;
+    std::shared_ptr<JitProgram> integrator_kernels;
+    // std::shared_ptr<JitProgram> quarry_stats_kernels;
+    std::shared_ptr<JitProgram> mod_kernels;
+    std::shared_ptr<JitProgram> misc_kernels;
+
+    // Adjuster for update freq (future drift)
+    std::unique_ptr<FutureDriftController> driftController;
+    // Smallest sphere radius, which the drift controller judges contact margins against
+    float driftMarginRefSize = 0.f;
+    // Times the CD round trip of the work order in flight (valid only if an order was sent this cycle), and dT's steps
+    Timer<double> orderTimer;
+    bool orderTimerValid = false;
+    Timer<double> stepTimer;
 
     // A collection of migrate-to-host methods. Bulk migrate-to-host is by nature on-demand only.
     void migrateFamilyToHost();
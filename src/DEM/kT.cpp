@@ -6,6 +6,7 @@
 #include <cstring>
 #include <iostream>
 #include <thread>
+#include <algorithm>
 
 #include <core/ApiVersion.h>
 #include <core/utils/JitHelper.h>
@@ -41,48 +42,42 @@ inline void DEMKinematicThread::transferArraysResize(size_t nContactPairs) {
 }
 
 void DEMKinematicThread::calibrateParams() {
+    // Statistics of the CD run that just finished
+    CDStatsRecord rec;
+    rec.bin_size = simParams->binSize;
+    rec.num_spheres = simParams->nSpheresGM;
+    rec.num_sph_bin_pairs = stateParams.numSphBinPairs;
+    rec.num_active_bins = stateParams.numActiveBins;
+    rec.max_sph_in_bin = stateParams.maxSphFoundInBin;
+    rec.max_tri_in_bin = stateParams.maxTriFoundInBin;
+    rec.num_pair_candidates = (double)stateParams.numPairCandidates;
+    rec.num_contacts = *(solverScratchSpace.numContacts);
+    rec.cd_time = CDAccumTimer.GetLastSpan();
+    if (recordCDStats) {
+        cdStatsRecord.push_back(rec);
+    }
+    if (solverFlags.autoBinSize && binSizeTuner) {
+        binSizeTuner->AddRecord(rec);
+    }
+
     double prev_time, curr_time;
     // If it is true, then it's the AccumTimer telling us it is the right time to decide how to change bin size
     if (CDAccumTimer.QueryOn(prev_time, curr_time, stateParams.binChangeObserveSteps)) {
         // Auto-adjust bin size
-        if (solverFlags.autoBinSize) {
-            int speed_dir = sign_func(stateParams.binCurrentChangeRate);
-            // Note the speed can be 0, yet we find performance variance. Then this is purely noise. We still wish the
-            // bin size to change in the next iteration, so we assign a direction randomly.
-            if (speed_dir == 0)
-                speed_dir = (randomZeroOrOne() == 0) ? -1 : 1;
-            float speed_update;
-            if (curr_time < prev_time) {
-                // If there is improvement, then we accelerate the current change direction
-                speed_update = speed_dir * stateParams.binChangeRateAcc * stateParams.binTopChangeRate;
-            } else {
-                // If no improvement, revert the direction
-                speed_update = -speed_dir * stateParams.binChangeRateAcc * stateParams.binTopChangeRate;
-            }
-            // But, if the bin size is going to get too big or too small, a penalty is enforced
-            if (stateParams.maxSphFoundInBin > stateParams.binChangeUpperSafety * simParams->errOutBinSphNum ||
-                stateParams.maxTriFoundInBin > stateParams.binChangeUpperSafety * simParams->errOutBinTriNum) {
-                // Then the size must start to decrease
-                speed_update = -1.0 * stateParams.binChangeRateAcc * stateParams.binTopChangeRate;
-            }
-            if (stateParams.numBins >
-                stateParams.binChangeLowerSafety * (double)(std::numeric_limits<binID_t>::max())) {
-                // Then size must start to increase
-                speed_update = 1.0 * stateParams.binChangeRateAcc * stateParams.binTopChangeRate;
-            }
-
-            // Acc is done. Now apply it to bin size change speed
-            stateParams.binCurrentChangeRate += speed_update;
-            // But, the speed must fall in range
-            stateParams.binCurrentChangeRate = clampBetween(
-                stateParams.binCurrentChangeRate, -stateParams.binTopChangeRate, stateParams.binTopChangeRate);
+        if (solverFlags.autoBinSize && binSizeTuner) {
+            BinSizeLimits limits;
+            // Past the point of (binChangeLowerSafety * max num of bin)-many bins in the domain, the bin size must
+            // grow. The num of bins goes about as the inverse cube of bin size.
+            const double max_num_bins =
+                stateParams.binChangeLowerSafety * (double)(std::numeric_limits<binID_t>::max());
+            limits.min_bin_size = simParams->binSize * std::cbrt((double)stateParams.numBins / max_num_bins);
+            // Past the point of (binChangeUpperSafety * error out bin geometry count)-many geometries in a bin, the bin
+            // size must shrink
+            limits.max_sph_in_bin = stateParams.binChangeUpperSafety * simParams->errOutBinSphNum;
+            limits.max_tri_in_bin = stateParams.binChangeUpperSafety * simParams->errOutBinTriNum;
 
             // Change bin size
-            if (stateParams.binCurrentChangeRate > 0) {
-                simParams->binSize *= (1. + stateParams.binCurrentChangeRate);
-            } else {
-                simParams->binSize /= (1. - stateParams.binCurrentChangeRate);
-            }
+            simParams->binSize = binSizeTuner->Decide(simParams->binSize, limits);
             // Register the new bin size
             stateParams.numBins =
                 hostCalcBinNum(simParams->nbX, simParams->nbY, simParams->nbZ, simParams->voxelSize, simParams->binSize,
@@ -191,6 +186,141 @@ inline void DEMKinematicThread::unpackMyBuffer() {
     }
 }
 
+inline void DEMKinematicThread::prepareHostCD() {
+    // Owner states are freshly unpacked on device, and marginSize is derived there
+    const size_t nOwners = simParams->nOwnerBodies;
+    voxelID.toHost(0, nOwners);
+    locX.toHost(0, nOwners);
+    locY.toHost(0, nOwners);
+    locZ.toHost(0, nOwners);
+    oriQw.toHost(0, nOwners);
+    oriQx.toHost(0, nOwners);
+    oriQy.toHost(0, nOwners);
+    oriQz.toHost(0, nOwners);
+    marginSize.toHost(0, nOwners);
+    if (solverFlags.canFamilyChangeOnDevice) {
+        familyID.toHost(0, nOwners);
+    }
+
+    // Host arrays may have been re-allocated since last time, so pack pointers every time
+    granDataHost.familyID = familyID.host();
+    granDataHost.voxelID = voxelID.host();
+    granDataHost.locX = locX.host();
+    granDataHost.locY = locY.host();
+    granDataHost.locZ = locZ.host();
+    granDataHost.oriQw = oriQw.host();
+    granDataHost.oriQx = oriQx.host();
+    granDataHost.oriQy = oriQy.host();
+    granDataHost.oriQz = oriQz.host();
+    granDataHost.marginSize = marginSize.host();
+    granDataHost.familyMasks = familyMaskMatrix.host();
+    granDataHost.familyExtraMarginSize = familyExtraMarginSize.host();
+
+    granDataHost.ownerClumpBody = ownerClumpBody.host();
+    granDataHost.clumpComponentOffset = clumpComponentOffset.host();
+    granDataHost.clumpComponentOffsetExt = clumpComponentOffsetExt.host();
+
+    granDataHost.ownerAnalBody = ownerAnalBody.host();
+    granDataHost.typeEntity = typeEntity.host();
+    granDataHost.normalEntity = normalEntity.host();
+    granDataHost.relPosEntityX = relPosEntityX.host();
+    granDataHost.relPosEntityY = relPosEntityY.host();
+    granDataHost.relPosEntityZ = relPosEntityZ.host();
+    granDataHost.oriEntityX = oriEntityX.host();
+    granDataHost.oriEntityY = oriEntityY.host();
+    granDataHost.oriEntityZ = oriEntityZ.host();
+    granDataHost.sizeEntity1 = sizeEntity1.host();
+    granDataHost.sizeEntity2 = sizeEntity2.host();
+    granDataHost.sizeEntity3 = sizeEntity3.host();
+
+    granDataHost.radiiSphere = radiiSphere.host();
+    granDataHost.relPosSphereX = relPosSphereX.host();
+    granDataHost.relPosSphereY = relPosSphereY.host();
+    granDataHost.relPosSphereZ = relPosSphereZ.host();
+}
+
+void DEMKinematicThread::hostCD() {
+    if (simParams->nTriGM > 0) {
+        DEME_ERROR(
+            "UseHostContactDetection is set, but the simulation has %zu mesh triangle facets. Host contact detection "
+            "only handles spheres and analytical objects; call UseHostContactDetection(false) for simulations with "
+            "meshes.",
+            (size_t)simParams->nTriGM);
+    }
+    prepareHostCD();
+
+    // The previous contact list may be rewritten on device (by dT, or by a checkpoint load), so it is fetched each time
+    const size_t nPrev = *solverScratchSpace.numPrevContacts;
+    hostCDPrevContacts.clear();
+    if (!solverFlags.isHistoryless && nPrev > 0) {
+        previous_idGeometryA.toHost(0, nPrev);
+        previous_idGeometryB.toHost(0, nPrev);
+        previous_contactType.toHost(0, nPrev);
+        hostCDPrevContacts.idGeometryA.assign(previous_idGeometryA.host(), previous_idGeometryA.host() + nPrev);
+        hostCDPrevContacts.idGeometryB.assign(previous_idGeometryB.host(), previous_idGeometryB.host() + nPrev);
+        hostCDPrevContacts.contactType.assign(previous_contactType.host(), previous_contactType.host() + nPrev);
+        if (solverFlags.hasPersistentContacts) {
+            contactPersistency.toHost(0, nPrev);
+            hostCDPrevContacts.contactPersistency.assign(contactPersistency.host(), contactPersistency.host() + nPrev);
+        }
+    }
+    size_t nPrevSpheres = *solverScratchSpace.numPrevSpheres;
+
+    HostContactStats stats;
+    hostContactDetection(granDataHost, *simParams, solverFlags, verbosity, hostCDContacts, hostCDPrevContacts,
+                         nPrevSpheres, timers, stats);
+    stateParams.maxSphFoundInBin = stats.maxSphFoundInBin;
+    stateParams.maxTriFoundInBin = 0;
+    stateParams.numSphBinPairs = stats.numSphBinPairs;
+    stateParams.numActiveBins = stats.numActiveBins;
+    stateParams.numPairCandidates = stats.numPairCandidates;
+    stateParams.avgCntsPerSphere = stats.avgCntsPerSphere;
+
+    // Results were produced on host; dT gets them from kT's device arrays
+    const size_t nContacts = hostCDContacts.idGeometryA.size();
+    if (nContacts > idGeometryA.size()) {
+        DEME_DUAL_ARRAY_RESIZE_NOVAL(idGeometryA, nContacts);
+        DEME_DUAL_ARRAY_RESIZE_NOVAL(idGeometryB, nContacts);
+        DEME_DUAL_ARRAY_RESIZE_NOVAL(contactType, nContacts);
+        granData.toDevice();
+    }
+    if (nContacts > 0) {
+        idGeometryA.setVal(hostCDContacts.idGeometryA, 0);
+        idGeometryB.setVal(hostCDContacts.idGeometryB, 0);
+        contactType.setVal(hostCDContacts.contactType, 0);
+    }
+    if (!solverFlags.isHistoryless && nContacts > 0) {
+        if (nContacts > contactMapping.size()) {
+            DEME_DUAL_ARRAY_RESIZE_NOVAL(contactMapping, nContacts);
+            granData.toDevice();
+        }
+        contactMapping.setVal(hostCDContacts.contactMapping, 0);
+        if (nContacts > previous_idGeometryA.size()) {
+            DEME_DUAL_ARRAY_RESIZE_NOVAL(previous_idGeometryA, nContacts);
+            DEME_DUAL_ARRAY_RESIZE_NOVAL(previous_idGeometryB, nContacts);
+            DEME_DUAL_ARRAY_RESIZE_NOVAL(previous_contactType, nContacts);
+            granData.toDevice();
+        }
+        previous_idGeometryA.setVal(hostCDPrevContacts.idGeometryA, 0);
+        previous_idGeometryB.setVal(hostCDPrevContacts.idGeometryB, 0);
+        previous_contactType.setVal(hostCDPrevContacts.contactType, 0);
+    }
+    if (solverFlags.hasPersistentContacts && !solverFlags.isHistoryless && nContacts > 0) {
+        if (nContacts > contactPersistency.size()) {
+            DEME_DUAL_ARRAY_RESIZE(contactPersistency, nContacts, CONTACT_NOT_PERSISTENT);
+            granData.toDevice();
+        }
+        contactPersistency.setVal(hostCDContacts.contactPersistency, 0);
+    }
+
+    *solverScratchSpace.numContacts = nContacts;
+    *solverScratchSpace.numPrevContacts = nContacts;
+    *solverScratchSpace.numPrevSpheres = nPrevSpheres;
+    solverScratchSpace.numContacts.toDevice();
+    solverScratchSpace.numPrevContacts.toDevice();
+    solverScratchSpace.numPrevSpheres.toDevice();
+}
+
 inline void DEMKinematicThread::sendToTheirBuffer() {
     DEME_GPU_CALL(cudaMemcpy(granData->pDTOwnedBuffer_nContactPairs, &(solverScratchSpace.numContacts), sizeof(size_t),
                              cudaMemcpyDeviceToDevice));
@@ -242,6 +372,8 @@ void DEMKinematicThread::workerThread() {
         while (!pSchedSupport->dynamicDone) {
             // Before producing something, a new work order should be in place. Wait on it.
             if (!pSchedSupport->kinematicOwned_Cons2ProdBuffer_isFresh) {
+                TraceScope trace(pSchedSupport->tracer, TRACE_LANE_KINEMATIC, "Wait for dT update",
+                                 pSchedSupport->kinematicIngredProdDateStamp.load());
                 timers.GetTimer("Wait for dT update").start();
                 pSchedSupport->schedulingStats.nTimesKinematicHeldBack++;
                 std::unique_lock<std::mutex> lock(pSchedSupport->kinematicCanProceed);
@@ -264,6 +396,8 @@ void DEMKinematicThread::workerThread() {
             timers.GetTimer("Unpack updates from dT").start();
             // Getting here means that new `work order' data has been provided
             {
+                TraceScope trace(pSchedSupport->tracer, TRACE_LANE_KINEMATIC, "unpackMyBuffer",
+                                 pSchedSupport->kinematicIngredProdDateStamp.load());
                 // Acquire lock and get the work order
                 std::lock_guard<std::mutex> lock(pSchedSupport->kinematicOwnedBuffer_AccessCoordination);
                 unpackMyBuffer();
@@ -281,15 +415,25 @@ void DEMKinematicThread::workerThread() {
             // kT's main task, contact detection.
             // For auto-adjusting bin size, this part of code is encapsuled in an accumulative timer.
             CDAccumTimer.Begin();
-            contactDetection(bin_sphere_kernels, bin_triangle_kernels, sphere_contact_kernels, sphTri_contact_kernels,
-                             history_kernels, granData, simParams, solverFlags, verbosity, idGeometryA, idGeometryB,
-                             contactType, previous_idGeometryA, previous_idGeometryB, previous_contactType,
-                             contactPersistency, contactMapping, streamInfo.stream, solverScratchSpace, timers,
-                             stateParams);
+            // The stamp of the dT state this CD works on, now that the work order is unpacked
+            const int64_t work_order_stamp = pSchedSupport->kinematicIngredProdDateStamp.load();
+            {
+                TraceScope trace(pSchedSupport->tracer, TRACE_LANE_KINEMATIC, "contactDetection", work_order_stamp);
+                if (solverFlags.useHostCD) {
+                    hostCD();
+                } else {
+                    contactDetection(bin_sphere_kernels, bin_triangle_kernels, sphere_contact_kernels,
+                                     sphTri_contact_kernels, history_kernels, granData, simParams, solverFlags,
+                                     verbosity, idGeometryA, idGeometryB, contactType, previous_idGeometryA,
+                                     previous_idGeometryB, previous_contactType, contactPersistency, contactMapping,
+                                     streamInfo.stream, solverScratchSpace, timers, stateParams);
+                }
+            }
             CDAccumTimer.End();
 
             timers.GetTimer("Send to dT buffer").start();
             {
+                TraceScope trace(pSchedSupport->tracer, TRACE_LANE_KINEMATIC, "sendToTheirBuffer", work_order_stamp);
                 // kT will reflect on how good the choice of parameters is
                 calibrateParams();
                 // Acquire lock and supply the dynamic with fresh produce
@@ -418,6 +562,8 @@ void DEMKinematicThread::resetUserCallStat() {
     CDAccumTimer.Clear();
     // Reset bin size change speed
     stateParams.binCurrentChangeRate = 0.;
+    if (binSizeTuner)
+        binSizeTuner->Restart();
 }
 
 size_t DEMKinematicThread::estimateDeviceMemUsage() const {
@@ -462,6 +608,20 @@ void DEMKinematicThread::packDataPointers() {
     relPosNode2.bindDevicePointer(&(granData->relPosNode2));
     relPosNode3.bindDevicePointer(&(granData->relPosNode3));
 
+    // Analytical entity-related
+    ownerAnalBody.bindDevicePointer(&(granData->ownerAnalBody));
+    typeEntity.bindDevicePointer(&(granData->typeEntity));
+    normalEntity.bindDevicePointer(&(granData->normalEntity));
+    relPosEntityX.bindDevicePointer(&(granData->relPosEntityX));
+    relPosEntityY.bindDevicePointer(&(granData->relPosEntityY));
+    relPosEntityZ.bindDevicePointer(&(granData->relPosEntityZ));
+    oriEntityX.bindDevicePointer(&(granData->oriEntityX));
+    oriEntityY.bindDevicePointer(&(granData->oriEntityY));
+    oriEntityZ.bindDevicePointer(&(granData->oriEntityZ));
+    sizeEntity1.bindDevicePointer(&(granData->sizeEntity1));
+    sizeEntity2.bindDevicePointer(&(granData->sizeEntity2));
+    sizeEntity3.bindDevicePointer(&(granData->sizeEntity3));
+
     // Template array pointers
     radiiSphere.bindDevicePointer(&(granData->radiiSphere));
     relPosSphereX.bindDevicePointer(&(granData->relPosSphereX));
@@ -509,6 +669,104 @@ void DEMKinematicThread::migrateDataToDevice() {
     syncMemoryTransfer();
 }
 
+void DEMKinematicThread::migrateNewEntitiesToDevice(size_t nExistOwners, size_t nExistSpheres, size_t nExistFacets) {
+    // Upload [start, end) of an array; what is before start is already on device
+    auto uploadTail = [&](auto& arr, size_t start, size_t end) {
+        if (end > start)
+            arr.toDeviceAsync(streamInfo.stream, start, end - start);
+    };
+    const size_t nOwners = simParams->nOwnerBodies;
+    const size_t nSpheres = simParams->nSpheresGM;
+    const size_t nTris = simParams->nTriGM;
+
+    uploadTail(familyID, nExistOwners, nOwners);
+    uploadTail(voxelID, nExistOwners, nOwners);
+    uploadTail(locX, nExistOwners, nOwners);
+    uploadTail(locY, nExistOwners, nOwners);
+    uploadTail(locZ, nExistOwners, nOwners);
+    uploadTail(oriQw, nExistOwners, nOwners);
+    uploadTail(oriQx, nExistOwners, nOwners);
+    uploadTail(oriQy, nExistOwners, nOwners);
+    uploadTail(oriQz, nExistOwners, nOwners);
+    uploadTail(marginSize, nExistOwners, nOwners);
+
+    uploadTail(ownerClumpBody, nExistSpheres, nSpheres);
+    if (solverFlags.useClumpJitify) {
+        uploadTail(clumpComponentOffset, nExistSpheres, nSpheres);
+        uploadTail(clumpComponentOffsetExt, nExistSpheres, nSpheres);
+        // Template components are re-written on each load, but there are only a few of them
+        radiiSphere.toDeviceAsync(streamInfo.stream);
+        relPosSphereX.toDeviceAsync(streamInfo.stream);
+        relPosSphereY.toDeviceAsync(streamInfo.stream);
+        relPosSphereZ.toDeviceAsync(streamInfo.stream);
+    } else {
+        uploadTail(radiiSphere, nExistSpheres, nSpheres);
+        uploadTail(relPosSphereX, nExistSpheres, nSpheres);
+        uploadTail(relPosSphereY, nExistSpheres, nSpheres);
+        uploadTail(relPosSphereZ, nExistSpheres, nSpheres);
+    }
+
+    uploadTail(ownerMesh, nExistFacets, nTris);
+    uploadTail(relPosNode1, nExistFacets, nTris);
+    uploadTail(relPosNode2, nExistFacets, nTris);
+    uploadTail(relPosNode3, nExistFacets, nTris);
+
+    // Contact arrays are left alone: kT's device copy is the only up-to-date one, and the contacts that came with the
+    // new clumps reach kT from dT
+    syncMemoryTransfer();
+}
+
+void DEMKinematicThread::reserveEntityArrays(size_t nOwners, size_t nSpheres, size_t nTris) {
+    DEME_GPU_CALL(cudaSetDevice(streamInfo.device));
+
+    familyID.reserve(nOwners);
+    voxelID.reserve(nOwners);
+    locX.reserve(nOwners);
+    locY.reserve(nOwners);
+    locZ.reserve(nOwners);
+    oriQw.reserve(nOwners);
+    oriQx.reserve(nOwners);
+    oriQy.reserve(nOwners);
+    oriQz.reserve(nOwners);
+    marginSize.reserve(nOwners);
+    {
+        // Buffers hold no data between transfers, so growing them is all it takes
+        DEME_GPU_CALL(cudaSetDevice(dT->streamInfo.device));
+        DEME_DEVICE_ARRAY_RESIZE(voxelID_buffer, nOwners);
+        DEME_DEVICE_ARRAY_RESIZE(locX_buffer, nOwners);
+        DEME_DEVICE_ARRAY_RESIZE(locY_buffer, nOwners);
+        DEME_DEVICE_ARRAY_RESIZE(locZ_buffer, nOwners);
+        DEME_DEVICE_ARRAY_RESIZE(oriQ0_buffer, nOwners);
+        DEME_DEVICE_ARRAY_RESIZE(oriQ1_buffer, nOwners);
+        DEME_DEVICE_ARRAY_RESIZE(oriQ2_buffer, nOwners);
+        DEME_DEVICE_ARRAY_RESIZE(oriQ3_buffer, nOwners);
+        DEME_DEVICE_ARRAY_RESIZE(absVel_buffer, nOwners);
+        if (solverFlags.canFamilyChangeOnDevice) {
+            DEME_DEVICE_ARRAY_RESIZE(familyID_buffer, nOwners);
+        }
+        DEME_DEVICE_ARRAY_RESIZE(relPosNode1_buffer, nOwners);
+        DEME_DEVICE_ARRAY_RESIZE(relPosNode2_buffer, nOwners);
+        DEME_DEVICE_ARRAY_RESIZE(relPosNode3_buffer, nOwners);
+        DEME_GPU_CALL(cudaSetDevice(streamInfo.device));
+    }
+
+    ownerClumpBody.reserve(nSpheres);
+    if (solverFlags.useClumpJitify) {
+        clumpComponentOffset.reserve(nSpheres);
+        clumpComponentOffsetExt.reserve(nSpheres);
+    } else {
+        radiiSphere.reserve(nSpheres);
+        relPosSphereX.reserve(nSpheres);
+        relPosSphereY.reserve(nSpheres);
+        relPosSphereZ.reserve(nSpheres);
+    }
+
+    ownerMesh.reserve(nTris);
+    relPosNode1.reserve(nTris);
+    relPosNode2.reserve(nTris);
+    relPosNode3.reserve(nTris);
+}
+
 void DEMKinematicThread::migrateFamilyToHost() {
     if (solverFlags.canFamilyChangeOnDevice) {
         familyID.toHost();
@@ -666,6 +924,20 @@ void DEMKinematicThread::allocateGPUArrays(size_t nOwnerBodies,
     DEME_DUAL_ARRAY_RESIZE(relPosNode2, nTriGM, make_float3(0));
     DEME_DUAL_ARRAY_RESIZE(relPosNode3, nTriGM, make_float3(0));
 
+    // Resize to the number of analytical entities
+    DEME_DUAL_ARRAY_RESIZE(ownerAnalBody, nAnalGM, 0);
+    DEME_DUAL_ARRAY_RESIZE(typeEntity, nAnalGM, 0);
+    DEME_DUAL_ARRAY_RESIZE(normalEntity, nAnalGM, 0);
+    DEME_DUAL_ARRAY_RESIZE(relPosEntityX, nAnalGM, 0);
+    DEME_DUAL_ARRAY_RESIZE(relPosEntityY, nAnalGM, 0);
+    DEME_DUAL_ARRAY_RESIZE(relPosEntityZ, nAnalGM, 0);
+    DEME_DUAL_ARRAY_RESIZE(oriEntityX, nAnalGM, 0);
+    DEME_DUAL_ARRAY_RESIZE(oriEntityY, nAnalGM, 0);
+    DEME_DUAL_ARRAY_RESIZE(oriEntityZ, nAnalGM, 0);
+    DEME_DUAL_ARRAY_RESIZE(sizeEntity1, nAnalGM, 0);
+    DEME_DUAL_ARRAY_RESIZE(sizeEntity2, nAnalGM, 0);
+    DEME_DUAL_ARRAY_RESIZE(sizeEntity3, nAnalGM, 0);
+
     if (solverFlags.useClumpJitify) {
         DEME_DUAL_ARRAY_RESIZE(clumpComponentOffset, nSpheresGM, 0);
         // This extended component offset array can hold offset numbers even for big clumps (whereas
@@ -833,6 +1105,31 @@ void DEMKinematicThread::populateEntityArrays(const std::vector<std::shared_ptr<
     }
 }
 
+void DEMKinematicThread::populateAnalEntityArrays(const std::vector<bodyID_t>& anal_owner,
+                                                  const std::vector<objType_t>& anal_types,
+                                                  const std::vector<float>& anal_normals,
+                                                  const std::vector<float3>& anal_comp_pos,
+                                                  const std::vector<float3>& anal_comp_rot,
+                                                  const std::vector<float>& anal_size_1,
+                                                  const std::vector<float>& anal_size_2,
+                                                  const std::vector<float>& anal_size_3) {
+    // These are the same info that gets jitified into the CD kernels
+    for (size_t i = 0; i < anal_owner.size(); i++) {
+        ownerAnalBody[i] = anal_owner.at(i);
+        typeEntity[i] = anal_types.at(i);
+        normalEntity[i] = anal_normals.at(i);
+        relPosEntityX[i] = anal_comp_pos.at(i).x;
+        relPosEntityY[i] = anal_comp_pos.at(i).y;
+        relPosEntityZ[i] = anal_comp_pos.at(i).z;
+        oriEntityX[i] = anal_comp_rot.at(i).x;
+        oriEntityY[i] = anal_comp_rot.at(i).y;
+        oriEntityZ[i] = anal_comp_rot.at(i).z;
+        sizeEntity1[i] = anal_size_1.at(i);
+        sizeEntity2[i] = anal_size_2.at(i);
+        sizeEntity3[i] = anal_size_3.at(i);
+    }
+}
+
 void DEMKinematicThread::initGPUArrays(const std::vector<std::shared_ptr<DEMClumpBatch>>& input_clump_batches,
                                        const std::vector<unsigned int>& input_ext_obj_family,
                                        const std::vector<unsigned int>& input_mesh_obj_family,
@@ -877,38 +1174,268 @@ void DEMKinematicThread::updatePrevContactArrays(DualStruct<DEMDataDT>& dT_data,
     DEME_DEBUG_PRINTF("Number of spheres after a user-manual contact load: %zu", (size_t)simParams->nSpheresGM);
 }
 
+void DEMKinematicThread::getPrevContactArrays(std::vector<bodyID_t>& idA,
+                                              std::vector<bodyID_t>& idB,
+                                              std::vector<contact_t>& cType,
+                                              std::vector<notStupidBool_t>& persistency,
+                                              size_t& nPrevSpheres) {
+    const size_t nContacts = *solverScratchSpace.numPrevContacts;
+    nPrevSpheres = *solverScratchSpace.numPrevSpheres;
+    if (nContacts == 0) {
+        idA.clear();
+        idB.clear();
+        cType.clear();
+        persistency.clear();
+        return;
+    }
+    previous_idGeometryA.toHost();
+    previous_idGeometryB.toHost();
+    previous_contactType.toHost();
+    contactPersistency.toHost();
+    idA.assign(previous_idGeometryA.host(), previous_idGeometryA.host() + nContacts);
+    idB.assign(previous_idGeometryB.host(), previous_idGeometryB.host() + nContacts);
+    cType.assign(previous_contactType.host(), previous_contactType.host() + nContacts);
+    // The persistency array may be shorter than the contact history, if no contact was ever marked persistent
+    persistency.assign(nContacts, CONTACT_NOT_PERSISTENT);
+    std::copy(contactPersistency.host(), contactPersistency.host() + DEME_MIN(nContacts, contactPersistency.size()),
+              persistency.begin());
+}
+
+void DEMKinematicThread::setPrevContactArrays(const std::vector<bodyID_t>& idA,
+                                              const std::vector<bodyID_t>& idB,
+                                              const std::vector<contact_t>& cType,
+                                              const std::vector<notStupidBool_t>& persistency,
+                                              size_t nPrevSpheres) {
+    const size_t nContacts = idA.size();
+    // Like overwritePrevContactArrays, storage only grows. This resizing is on kT's device, so the caller must have
+    // switched to it.
+    if (nContacts > previous_idGeometryA.size()) {
+        DEME_DUAL_ARRAY_RESIZE_NOVAL(previous_idGeometryA, nContacts);
+        DEME_DUAL_ARRAY_RESIZE_NOVAL(previous_idGeometryB, nContacts);
+        DEME_DUAL_ARRAY_RESIZE_NOVAL(previous_contactType, nContacts);
+        granData.toDevice();
+    }
+    if (nContacts > contactPersistency.size()) {
+        DEME_DUAL_ARRAY_RESIZE(contactPersistency, nContacts, CONTACT_NOT_PERSISTENT);
+        granData.toDevice();
+    }
+    if (nContacts > 0) {
+        previous_idGeometryA.setVal(idA, 0);
+        previous_idGeometryB.setVal(idB, 0);
+        previous_contactType.setVal(cType, 0);
+        contactPersistency.setVal(persistency, 0, nContacts);
+    }
+
+    *solverScratchSpace.numPrevContacts = nContacts;
+    *solverScratchSpace.numPrevSpheres = nPrevSpheres;
+    solverScratchSpace.numPrevContacts.toDevice();
+    solverScratchSpace.numPrevSpheres.toDevice();
+    DEME_DEBUG_PRINTF("Number of previous contacts after a checkpoint load: %zu", nContacts);
+}
+
+void DEMKinematicThread::setFamilyIDs(const std::vector<family_t>& fam) {
+    familyID.setVal(fam, 0);
+}
+
+void DEMKinematicThread::reorderOwners(const std::vector<bodyID_t>& ownerOrder,
+                                       const std::vector<bodyID_t>& sphOrder,
+                                       const std::vector<bodyID_t>& ownerNew) {
+    // Owner states are refreshed from dT at each CD anyway, but moving them along keeps kT consistent in between
+    const size_t nOwners = ownerOrder.size();
+    familyID.toHost(0, nOwners);
+    voxelID.toHost(0, nOwners);
+    locX.toHost(0, nOwners);
+    locY.toHost(0, nOwners);
+    locZ.toHost(0, nOwners);
+    oriQw.toHost(0, nOwners);
+    oriQx.toHost(0, nOwners);
+    oriQy.toHost(0, nOwners);
+    oriQz.toHost(0, nOwners);
+    marginSize.toHost(0, nOwners);
+    permuteHostElements(familyID, ownerOrder);
+    permuteHostElements(voxelID, ownerOrder);
+    permuteHostElements(locX, ownerOrder);
+    permuteHostElements(locY, ownerOrder);
+    permuteHostElements(locZ, ownerOrder);
+    permuteHostElements(oriQw, ownerOrder);
+    permuteHostElements(oriQx, ownerOrder);
+    permuteHostElements(oriQy, ownerOrder);
+    permuteHostElements(oriQz, ownerOrder);
+    permuteHostElements(marginSize, ownerOrder);
+    familyID.toDevice(0, nOwners);
+    voxelID.toDevice(0, nOwners);
+    locX.toDevice(0, nOwners);
+    locY.toDevice(0, nOwners);
+    locZ.toDevice(0, nOwners);
+    oriQw.toDevice(0, nOwners);
+    oriQx.toDevice(0, nOwners);
+    oriQy.toDevice(0, nOwners);
+    oriQz.toDevice(0, nOwners);
+    marginSize.toDevice(0, nOwners);
+
+    const size_t nSpheres = sphOrder.size();
+    ownerClumpBody.toHost(0, nSpheres);
+    permuteHostElements(ownerClumpBody, sphOrder);
+    for (size_t i = 0; i < nSpheres; i++) {
+        ownerClumpBody[i] = ownerNew[ownerClumpBody[i]];
+    }
+    ownerClumpBody.toDevice(0, nSpheres);
+    if (solverFlags.useClumpJitify) {
+        clumpComponentOffset.toHost(0, nSpheres);
+        clumpComponentOffsetExt.toHost(0, nSpheres);
+        permuteHostElements(clumpComponentOffset, sphOrder);
+        permuteHostElements(clumpComponentOffsetExt, sphOrder);
+        clumpComponentOffset.toDevice(0, nSpheres);
+        clumpComponentOffsetExt.toDevice(0, nSpheres);
+    } else {
+        radiiSphere.toHost(0, nSpheres);
+        relPosSphereX.toHost(0, nSpheres);
+        relPosSphereY.toHost(0, nSpheres);
+        relPosSphereZ.toHost(0, nSpheres);
+        permuteHostElements(radiiSphere, sphOrder);
+        permuteHostElements(relPosSphereX, sphOrder);
+        permuteHostElements(relPosSphereY, sphOrder);
+        permuteHostElements(relPosSphereZ, sphOrder);
+        radiiSphere.toDevice(0, nSpheres);
+        relPosSphereX.toDevice(0, nSpheres);
+        relPosSphereY.toDevice(0, nSpheres);
+        relPosSphereZ.toDevice(0, nSpheres);
+    }
+}
+
+void DEMKinematicThread::purgeOwners(const std::vector<bodyID_t>& ownerOrder,
+                                     const std::vector<bodyID_t>& sphOrder,
+                                     const std::vector<bodyID_t>& triOrder,
+                                     const std::vector<bodyID_t>& ownerNew,
+                                     size_t nOwnerClumps,
+                                     size_t nTriMeshes) {
+    const size_t nOwners = simParams->nOwnerBodies;
+    familyID.toHost(0, nOwners);
+    voxelID.toHost(0, nOwners);
+    locX.toHost(0, nOwners);
+    locY.toHost(0, nOwners);
+    locZ.toHost(0, nOwners);
+    oriQw.toHost(0, nOwners);
+    oriQx.toHost(0, nOwners);
+    oriQy.toHost(0, nOwners);
+    oriQz.toHost(0, nOwners);
+    marginSize.toHost(0, nOwners);
+    compactHostElements(familyID, ownerOrder);
+    compactHostElements(voxelID, ownerOrder);
+    compactHostElements(locX, ownerOrder);
+    compactHostElements(locY, ownerOrder);
+    compactHostElements(locZ, ownerOrder);
+    compactHostElements(oriQw, ownerOrder);
+    compactHostElements(oriQx, ownerOrder);
+    compactHostElements(oriQy, ownerOrder);
+    compactHostElements(oriQz, ownerOrder);
+    compactHostElements(marginSize, ownerOrder);
+    familyID.toDevice();
+    voxelID.toDevice();
+    locX.toDevice();
+    locY.toDevice();
+    locZ.toDevice();
+    oriQw.toDevice();
+    oriQx.toDevice();
+    oriQy.toDevice();
+    oriQz.toDevice();
+    marginSize.toDevice();
+
+    const size_t nSpheres = simParams->nSpheresGM;
+    ownerClumpBody.toHost(0, nSpheres);
+    compactHostElements(ownerClumpBody, sphOrder);
+    for (size_t i = 0; i < sphOrder.size(); i++) {
+        ownerClumpBody[i] = ownerNew[ownerClumpBody[i]];
+    }
+    ownerClumpBody.toDevice();
+    if (solverFlags.useClumpJitify) {
+        clumpComponentOffset.toHost(0, nSpheres);
+        clumpComponentOffsetExt.toHost(0, nSpheres);
+        compactHostElements(clumpComponentOffset, sphOrder);
+        compactHostElements(clumpComponentOffsetExt, sphOrder);
+        clumpComponentOffset.toDevice();
+        clumpComponentOffsetExt.toDevice();
+    } else {
+        radiiSphere.toHost(0, nSpheres);
+        relPosSphereX.toHost(0, nSpheres);
+        relPosSphereY.toHost(0, nSpheres);
+        relPosSphereZ.toHost(0, nSpheres);
+        compactHostElements(radiiSphere, sphOrder);
+        compactHostElements(relPosSphereX, sphOrder);
+        compactHostElements(relPosSphereY, sphOrder);
+        compactHostElements(relPosSphereZ, sphOrder);
+        radiiSphere.toDevice();
+        relPosSphereX.toDevice();
+        relPosSphereY.toDevice();
+        relPosSphereZ.toDevice();
+    }
+
+    const size_t nTris = simParams->nTriGM;
+    ownerMesh.toHost(0, nTris);
+    relPosNode1.toHost(0, nTris);
+    relPosNode2.toHost(0, nTris);
+    relPosNode3.toHost(0, nTris);
+    compactHostElements(ownerMesh, triOrder);
+    for (size_t i = 0; i < triOrder.size(); i++) {
+        ownerMesh[i] = ownerNew[ownerMesh[i]];
+    }
+    compactHostElements(relPosNode1, triOrder);
+    compactHostElements(relPosNode2, triOrder);
+    compactHostElements(relPosNode3, triOrder);
+    ownerMesh.toDevice();
+    relPosNode1.toDevice();
+    relPosNode2.toDevice();
+    relPosNode3.toDevice();
+
+    const size_t nAnal = simParams->nAnalGM;
+    ownerAnalBody.toHost(0, nAnal);
+    for (size_t i = 0; i < nAnal; i++) {
+        ownerAnalBody[i] = ownerNew[ownerAnalBody[i]];
+    }
+    ownerAnalBody.toDevice(0, nAnal);
+
+    simParams->nOwnerBodies = ownerOrder.size();
+    simParams->nOwnerClumps = nOwnerClumps;
+    simParams->nTriMeshes = nTriMeshes;
+    simParams->nSpheresGM = sphOrder.size();
+    simParams->nTriGM = triOrder.size();
+    simParams.toDevice();
+    // Shrunk arrays live at new device addresses
+    granData.toDevice();
+}
+
 void DEMKinematicThread::jitifyKernels(const std::unordered_map<std::string, std::string>& Subs,
                                        const std::vector<std::string>& JitifyOptions) {
     // First one is bin_sphere_kernels kernels, which figure out the bin--sphere touch pairs
     {
-        bin_sphere_kernels = std::make_shared<jitify::Program>(std::move(JitHelper::buildProgram(
+        bin_sphere_kernels = std::make_shared<JitProgram>(std::move(JitHelper::buildProgram(
             "DEMBinSphereKernels", JitHelper::KERNEL_DIR / "DEMBinSphereKernels.cu", Subs, JitifyOptions)));
     }
     // Then CD kernels
     {
-        sphere_contact_kernels = std::make_shared<jitify::Program>(std::move(
+        sphere_contact_kernels = std::make_shared<JitProgram>(std::move(
             JitHelper::buildProgram("DEMContactKernels_SphereSphere",
                                     JitHelper::KERNEL_DIR / "DEMContactKernels_SphereSphere.cu", Subs, JitifyOptions)));
     }
     // Then triangle--bin intersection-related kernels
     {
-        bin_triangle_kernels = std::make_shared<jitify::Program>(std::move(JitHelper::buildProgram(
+        bin_triangle_kernels = std::make_shared<JitProgram>(std::move(JitHelper::buildProgram(
             "DEMBinTriangleKernels", JitHelper::KERNEL_DIR / "DEMBinTriangleKernels.cu", Subs, JitifyOptions)));
     }
     // Then sphere--triangle contact detection-related kernels
     {
-        sphTri_contact_kernels = std::make_shared<jitify::Program>(std::move(JitHelper::buildProgram(
+        sphTri_contact_kernels = std::make_shared<JitProgram>(std::move(JitHelper::buildProgram(
             "DEMContactKernels_SphereTriangle", JitHelper::KERNEL_DIR / "DEMContactKernels_SphereTriangle.cu", Subs,
             JitifyOptions)));
     }
     // Then contact history mapping kernels
     {
-        history_kernels = std::make_shared<jitify::Program>(std::move(JitHelper::buildProgram(
+        history_kernels = std::make_shared<JitProgram>(std::move(JitHelper::buildProgram(
             "DEMHistoryMappingKernels", JitHelper::KERNEL_DIR / "DEMHistoryMappingKernels.cu", Subs, JitifyOptions)));
     }
     // Then misc kernels
     {
-        misc_kernels = std::make_shared<jitify::Program>(std::move(JitHelper::buildProgram(
+        misc_kernels = std::make_shared<JitProgram>(std::move(JitHelper::buildProgram(
             "DEMMiscKernels", JitHelper::KERNEL_DIR / "DEMMiscKernels.cu", Subs, JitifyOptions)));
     }
 }
@@ -925,6 +1452,23 @@ void DEMKinematicThread::setOwnerFamily(bodyID_t ownerID, family_t fam, bodyID_t
     familyID.setVal(std::vector<family_t>(n, fam), ownerID);
 }
 
+void DEMKinematicThread::setOwnerFamily(const std::vector<bodyID_t>& implIDs, family_t fam) {
+    // After a reorder, consecutive user IDs are scattered in the arrays. Set them all on host, then upload once per
+    // contiguous run of impl IDs.
+    const std::vector<bodyID_t> sorted = hostSort(implIDs);
+    for (const auto implID : sorted) {
+        familyID[implID] = fam;
+    }
+    size_t runStart = 0;
+    for (size_t i = 1; i <= sorted.size(); i++) {
+        if (i == sorted.size() || sorted[i] > sorted[i - 1] + 1) {
+            familyID.toDeviceAsync(streamInfo.stream, sorted[runStart], sorted[i - 1] - sorted[runStart] + 1);
+            runStart = i;
+        }
+    }
+    syncMemoryTransfer();
+}
+
 void DEMKinematicThread::setTriNodeRelPos(size_t start, const std::vector<DEMTriangle>& triangles) {
     for (size_t i = 0; i < triangles.size(); i++) {
         relPosNode1[start + i] = triangles[i].p1;
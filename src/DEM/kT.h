@@ -24,11 +24,11 @@
 #include <DEM/BdrsAndObjs.h>
 #include <DEM/Defines.h>
 #include <DEM/Structs.h>
+#include <DEM/BinSizeTuner.h>
+#include <algorithms/DEMHostContactDetection.h>
 
-// Forward declare jitify::Program to avoid downstream dependency
-namespace jitify {
-class Program;
-}
+// Forward declare JitProgram to avoid downstream dependency
+class JitProgram;
 
 namespace deme {
 
@@ -73,6 +73,11 @@ class DEMKinematicThread {
 
     // Pointers to those data arrays defined below, stored in a struct
     DualStruct<DEMDataKT> granData = DualStruct<DEMDataKT>();
+    // The same collection of pointers, but to the host-side data. Used when contact detection is done on host.
+    DEMDataKT granDataHost;
+    // Host-side contact arrays of host contact detection, kept to reuse their storage
+    HostContactArrays hostCDContacts;
+    HostContactArrays hostCDPrevContacts;
 
     // Log for anomalies in the simulation
     WorkerAnomalies anomalies = WorkerAnomalies();
@@ -140,6 +145,11 @@ class DEMKinematicThread {
     DualArray<float> sizeEntity1 = DualArray<float>(&m_approxHostBytesUsed, &m_approxDeviceBytesUsed);
     DualArray<float> sizeEntity2 = DualArray<float>(&m_approxHostBytesUsed, &m_approxDeviceBytesUsed);
     DualArray<float> sizeEntity3 = DualArray<float>(&m_approxHostBytesUsed, &m_approxDeviceBytesUsed);
+    // Owner IDs, types and normal directions (inward or outward) of the analytical entities. CD kernels have all
+    // analytical entity info jitified, so these and the arrays above are in fact only used by the host CD.
+    DualArray<bodyID_t> ownerAnalBody = DualArray<bodyID_t>(&m_approxHostBytesUsed, &m_approxDeviceBytesUsed);
+    DualArray<objType_t> typeEntity = DualArray<objType_t>(&m_approxHostBytesUsed, &m_approxDeviceBytesUsed);
+    DualArray<float> normalEntity = DualArray<float>(&m_approxHostBytesUsed, &m_approxDeviceBytesUsed);
 
     // The voxel ID (split into 3 parts, representing XYZ location)
     DualArray<voxelID_t> voxelID = DualArray<voxelID_t>(&m_approxHostBytesUsed, &m_approxDeviceBytesUsed);
@@ -209,6 +219,12 @@ class DEMKinematicThread {
 
     kTStateParams stateParams;
 
+    // The bin size tuner, fed with the statistics of each CD run
+    std::unique_ptr<BinSizeTuner> binSizeTuner;
+    // If true, the statistics of each CD run are also kept in cdStatsRecord (for offline tuner studies)
+    bool recordCDStats = false;
+    std::vector<CDStatsRecord> cdStatsRecord;
+
   public:
     friend class DEMSolver;
     friend class DEMDynamicThread;
@@ -292,6 +308,14 @@ class DEMKinematicThread {
                               size_t nExistOwners,
                               size_t nExistSpheres,
                               size_t nExistingFacets);
+    void populateAnalEntityArrays(const std::vector<bodyID_t>& anal_owner,
+                                  const std::vector<objType_t>& anal_types,
+                                  const std::vector<float>& anal_normals,
+                                  const std::vector<float3>& anal_comp_pos,
+                                  const std::vector<float3>& anal_comp_rot,
+                                  const std::vector<float>& anal_size_1,
+                                  const std::vector<float>& anal_size_2,
+                                  const std::vector<float>& anal_size_3);
 
     /// Initialize arrays
     void initGPUArrays(const std::vector<std::shared_ptr<DEMClumpBatch>>& input_clump_batches,
@@ -349,6 +373,11 @@ class DEMKinematicThread {
     // Move array data to or from device
     void migrateDataToDevice();
     // void migrateDataToHost();
+    // Move only the entities appended after the given numbers of existing owners, spheres and triangles
+    void migrateNewEntitiesToDevice(size_t nExistOwners, size_t nExistSpheres, size_t nExistFacets);
+    // Make room in the per-owner, per-sphere and per-triangle arrays (and the transfer buffers on dT's device), so
+    // they can grow to these sizes without reallocating
+    void reserveEntityArrays(size_t nOwners, size_t nSpheres, size_t nTris);
 
     // Sync my stream
     void syncMemoryTransfer() { DEME_GPU_CALL(cudaStreamSynchronize(streamInfo.stream)); }
@@ -373,8 +402,10 @@ class DEMKinematicThread {
     void jitifyKernels(const std::unordered_map<std::string, std::string>& Subs,
                        const std::vector<std::string>& JitifyOptions);
 
-    /// Set this owner's family number, for n consecutive items.
+    /// Set the family number of n consecutive owners starting from ownerID (impl-level IDs).
     void setOwnerFamily(bodyID_t ownerID, family_t fam, bodyID_t n = 1);
+    /// Set the family number of these owners (by impl-level ID, which dT maps from the user-facing one).
+    void setOwnerFamily(const std::vector<bodyID_t>& implIDs, family_t fam);
 
     /// Rewrite the relative positions of the flattened triangle soup, starting from `start', using triangle nodal
     /// positions in `triangles'.
@@ -385,6 +416,34 @@ class DEMKinematicThread {
 
     /// Update (overwrite) kT's previous contact array based on input
     void updatePrevContactArrays(DualStruct<DEMDataDT>& dT_data, size_t nContacts);
+    /// Copy kT's previous contact arrays (the contact history used for mapping between CD runs) to host vectors
+    void getPrevContactArrays(std::vector<bodyID_t>& idA,
+                              std::vector<bodyID_t>& idB,
+                              std::vector<contact_t>& cType,
+                              std::vector<notStupidBool_t>& persistency,
+                              size_t& nPrevSpheres);
+    /// Overwrite kT's previous contact arrays with host-side data, such as those recovered from a checkpoint
+    void setPrevContactArrays(const std::vector<bodyID_t>& idA,
+                              const std::vector<bodyID_t>& idB,
+                              const std::vector<contact_t>& cType,
+                              const std::vector<notStupidBool_t>& persistency,
+                              size_t nPrevSpheres);
+    /// Overwrite kT's copy of owner family numbers, starting from owner 0
+    void setFamilyIDs(const std::vector<family_t>& fam);
+    /// Apply dT's owner reordering to kT's owner and sphere arrays. ownerOrder and sphOrder give, for each new
+    /// position, the current ID of the entity that goes there; ownerNew maps current owner IDs to new ones.
+    void reorderOwners(const std::vector<bodyID_t>& ownerOrder,
+                       const std::vector<bodyID_t>& sphOrder,
+                       const std::vector<bodyID_t>& ownerNew);
+    /// Apply dT's family purge to kT's owner, sphere and triangle arrays. The orders list, for each new position, the
+    /// current ID of the entity that goes there (removed entities are not listed); ownerNew maps current owner IDs to
+    /// new ones. nOwnerClumps and nTriMeshes are the counts after the purge.
+    void purgeOwners(const std::vector<bodyID_t>& ownerOrder,
+                     const std::vector<bodyID_t>& sphOrder,
+                     const std::vector<bodyID_t>& triOrder,
+                     const std::vector<bodyID_t>& ownerNew,
+                     size_t nOwnerClumps,
+                     size_t nTriMeshes);
 
     /// Print temporary arrays' memory usage. This is for debugging purposes only.
     void printScratchSpaceUsage() const {
@@ -397,6 +456,10 @@ class DEMKinematicThread {
 
     // Bring kT buffer array data to its working arrays
     inline void unpackMyBuffer();
+    // Bring the (device-modifiable) data needed by host-side contact detection to host, and pack host pointers
+    inline void prepareHostCD();
+    // Do contact detection on host, then put the results in the contact arrays on device, for dT
+    void hostCD();
     // Send produced data to dT-owned biffers
     void sendToTheirBuffer();
     // Resize dT's buffer arrays based on the number of contact pairs
@@ -409,31 +472,39 @@ class DEMKinematicThread {
     void deallocateEverything();
 
     // Just-in-time compiled kernels
-    // jitify::Program bin_sphere_kernels = JitHelper::buildProgram("bin_sphere_kernels", " ");
-    std::shared_ptr<jitify::Program> bin_sphere_kernels;
-    std::shared_ptr<jitify::Program> bin_triangle_kernels;
-    std::shared_ptr<jitify::Program> sphTri_contact_kernels;
-    std::shared_ptr<jitify::Program> sphere_contact_kernels;
-    std::shared_ptr<jitify::Program> history_kernels;
-    std::shared_ptr<jitify::Program> misc_kernels;
+    // JitProgram bin_sphere_kernels = JitHelper::buildProgram("bin_sphere_kernels", " ");
+    std::shared_ptr<JitProgram> bin_sphere_kernels;
+    std::shared_ptr<JitProgram> bin_triangle_kernels;
+    std::shared_ptr<JitProgram> sphTri_contact_kernels;
+    std::shared_ptr<JitProgram> sphere_contact_kernels;
+    std::shared_ptr<JitProgram> history_kernels;
+    std::shared_ptr<JitProgram> misc_kernels;
 
     // Adjuster for bin size
     class AccumTimer {
       private:
         double prev_time = DEME_HUGE_FLOAT;
+        double span_start = 0.;
+        double last_span = 0.;
         unsigned int cached_count = 0;
         Timer<double> timer;
 
       public:
         AccumTimer() { timer = Timer<double>(); }
         ~AccumTimer() {}
-        void Begin() { timer.start(); }
+        void Begin() {
+            span_start = timer.GetTimeSeconds();
+            timer.start();
+        }
         void End() {
             timer.stop();
+            last_span = timer.GetTimeSeconds() - span_start;
             cached_count++;
         }
 
         double GetPrevTime() { return prev_time; }
+        // Time of the last Begin--End span
+        double GetLastSpan() { return last_span; }
 
         void Query(double& prev, double& curr) {
             double avg_time = timer.GetTimeSeconds() / (double)(cached_count);
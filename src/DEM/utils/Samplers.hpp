@@ -33,9 +33,13 @@
 #ifndef DEME_SAMPLERS_HPP
 #define DEME_SAMPLERS_HPP
 
+#include <algorithm>
+#include <atomic>
 #include <cmath>
 #include <list>
 #include <random>
+#include <stdexcept>
+#include <thread>
 #include <utility>
 #include <vector>
 #include <DEM/HostSideHelpers.hpp>
@@ -493,6 +497,333 @@ std::vector<float3> PDLayerSampler_BOX(float3 center,                ///< Center
     return points_full;
 }
 
+/// Background-grid Poisson Disk sampler (Bridson's algorithm) that samples large domains with multiple threads.
+/// The domain is cut into tiles no thinner than the largest possible interaction distance. Tiles are processed in 8
+/// phases by the parity of their indices, so tiles running at the same time never neighbor each other, and a tile is
+/// always sampled against the points already placed in its neighbor tiles; therefore tile borders are free of overlaps.
+/// Each tile uses its own random stream, so the result does not depend on the number of threads.
+/// By default, points are at least separation apart. If a list of radii is given, each point is assigned a radius from
+/// it, and two points with radii r_i and r_j are then at least r_i + r_j + separation apart (separation is the gap).
+/// Note that only the point centers are guaranteed to be in the sampling volume.
+class PDGridSampler : public Sampler {
+  public:
+    PDGridSampler(float separation, int pointsPerIteration = m_ppi_default)
+        : Sampler(separation), m_ppi(pointsPerIteration), m_radii(1, 0.f) {
+        m_nThreads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    /// Set the state of the random-number engine (default: 0).
+    void SetRandomEngineSeed(unsigned int seed) { m_seed = seed; }
+    /// Set the number of threads to sample with (default: the number of hardware threads).
+    void SetNumThreads(unsigned int nThreads) { m_nThreads = std::max(1u, nThreads); }
+    /// Set the tile width, in multiples of the largest interaction distance (default: 16).
+    void SetTileSize(unsigned int nCells) { m_tileCells = std::max(1u, nCells); }
+
+    /// Sample polydisperse points using this list of radii. Each new point picks a radius from the list, with
+    /// probabilities proportional to weights (uniform if weights are not given).
+    void SetRadii(const std::vector<float>& radii, const std::vector<float>& weights = std::vector<float>()) {
+        if (radii.empty()) {
+            throw std::runtime_error("PDGridSampler::SetRadii needs at least one radius.");
+        }
+        if (!weights.empty() && weights.size() != radii.size()) {
+            throw std::runtime_error("PDGridSampler::SetRadii needs as many weights as radii.");
+        }
+        m_radii = radii;
+        m_weights = weights;
+    }
+
+    /// Indices (into the radius list) of the radii assigned to the points returned by the last Sample call.
+    const std::vector<unsigned int>& GetSampledRadiusIndices() const { return m_radiusIDs; }
+    /// Radii of the points returned by the last Sample call.
+    std::vector<float> GetSampledRadii() const {
+        std::vector<float> res(m_radiusIDs.size());
+        for (size_t i = 0; i < m_radiusIDs.size(); i++) {
+            res[i] = m_radii[m_radiusIDs[i]];
+        }
+        return res;
+    }
+
+  private:
+    struct SamplePoint {
+        float3 pos;
+        unsigned int rid;
+    };
+
+    // Geometry of the whole sampling run, shared by all tiles
+    struct TileLayout {
+        float3 bl;              ///< bottom-left corner of the sampling domain
+        float3 tileSize;        ///< size of a tile
+        int nTiles[3];          ///< number of tiles in each direction
+        bool flat[3];           ///< whether the domain is collapsed in this direction (2D sampling)
+        float reach;            ///< the largest possible distance two points need to be apart
+        size_t TileIndex(int i, int j, int k) const { return ((size_t)i * nTiles[1] + j) * nTiles[2] + k; }
+    };
+
+    /// Worker function for sampling the given domain.
+    virtual std::vector<float3> Sample(VolumeType t) override {
+        const float maxRad = *std::max_element(m_radii.begin(), m_radii.end());
+        const float minRad = *std::min_element(m_radii.begin(), m_radii.end());
+        const float minDist = 2 * minRad + this->m_separation;
+
+        TileLayout layout;
+        layout.reach = 2 * maxRad + this->m_separation;
+        if (minDist <= 0.f) {
+            throw std::runtime_error("PDGridSampler needs a positive separation, or positive radii.");
+        }
+        // Like PDSampler, switch to planar sampling in a direction thinner than the minimum distance
+        float* size[3] = {&(this->m_size.x), &(this->m_size.y), &(this->m_size.z)};
+        layout.flat[0] = layout.flat[1] = layout.flat[2] = false;
+        for (int d = 2; d >= 0; d--) {
+            if (*size[d] < minDist) {
+                layout.flat[d] = true;
+                *size[d] = 0;
+                break;
+            }
+        }
+        layout.bl = this->m_center - this->m_size;
+        float* tileSize[3] = {&(layout.tileSize.x), &(layout.tileSize.y), &(layout.tileSize.z)};
+        const float tileWidth = layout.reach * m_tileCells;
+        for (int d = 0; d < 3; d++) {
+            const float extent = 2 * (*size[d]);
+            // Tiles are never thinner than tileWidth (>= reach), unless there is only one of them in this direction
+            layout.nTiles[d] = layout.flat[d] ? 1 : std::max(1, (int)(extent / tileWidth));
+            *tileSize[d] = extent / layout.nTiles[d];
+        }
+
+        const size_t nTotalTiles = (size_t)layout.nTiles[0] * layout.nTiles[1] * layout.nTiles[2];
+        std::vector<std::vector<SamplePoint>> tilePoints(nTotalTiles);
+
+        for (int phase = 0; phase < 8; phase++) {
+            std::vector<size_t> phaseTiles;
+            for (int i = phase & 1; i < layout.nTiles[0]; i += 2) {
+                for (int j = (phase >> 1) & 1; j < layout.nTiles[1]; j += 2) {
+                    for (int k = (phase >> 2) & 1; k < layout.nTiles[2]; k += 2) {
+                        phaseTiles.push_back(layout.TileIndex(i, j, k));
+                    }
+                }
+            }
+            // Tiles of the same phase are independent, so threads just take them one by one
+            std::atomic<size_t> next(0);
+            auto worker = [&]() {
+                for (size_t n = next++; n < phaseTiles.size(); n = next++) {
+                    sampleTile(t, layout, phaseTiles[n], tilePoints);
+                }
+            };
+            const unsigned int nThreads = (unsigned int)std::min<size_t>(m_nThreads, phaseTiles.size());
+            std::vector<std::thread> threads;
+            for (unsigned int th = 1; th < nThreads; th++) {
+                threads.emplace_back(worker);
+            }
+            worker();
+            for (auto& th : threads) {
+                th.join();
+            }
+        }
+
+        size_t nPoints = 0;
+        for (const auto& pts : tilePoints) {
+            nPoints += pts.size();
+        }
+        std::vector<float3> out_points;
+        out_points.reserve(nPoints);
+        m_radiusIDs.clear();
+        m_radiusIDs.reserve(nPoints);
+        for (const auto& pts : tilePoints) {
+            for (const auto& pnt : pts) {
+                out_points.push_back(pnt.pos);
+                m_radiusIDs.push_back(pnt.rid);
+            }
+        }
+        return out_points;
+    }
+
+    /// Run Bridson's algorithm in one tile, taking into account the points already placed in the neighbor tiles.
+    void sampleTile(VolumeType t,
+                    const TileLayout& layout,
+                    size_t tileID,
+                    std::vector<std::vector<SamplePoint>>& tilePoints) const {
+        const int ti[3] = {(int)(tileID / ((size_t)layout.nTiles[1] * layout.nTiles[2])),
+                           (int)((tileID / layout.nTiles[2]) % layout.nTiles[1]), (int)(tileID % layout.nTiles[2])};
+        const float3 lo = layout.bl + make_float3(ti[0] * layout.tileSize.x, ti[1] * layout.tileSize.y,
+                                                  ti[2] * layout.tileSize.z);
+        const float3 hi = lo + layout.tileSize;
+        const float reach = layout.reach;
+
+        // Local cell grid of cell size reach, covering the tile and a halo of one reach around it
+        const float3 gridOrigin = lo - reach;
+        int dims[3];
+        const float tileExt[3] = {layout.tileSize.x, layout.tileSize.y, layout.tileSize.z};
+        for (int d = 0; d < 3; d++) {
+            dims[d] = layout.flat[d] ? 1 : (int)(tileExt[d] / reach) + 3;
+        }
+        std::vector<std::vector<unsigned int>> cells((size_t)dims[0] * dims[1] * dims[2]);
+        auto cellOf = [&](const float3& p, int* c) {
+            const float rel[3] = {p.x - gridOrigin.x, p.y - gridOrigin.y, p.z - gridOrigin.z};
+            for (int d = 0; d < 3; d++) {
+                c[d] = layout.flat[d] ? 0 : std::min(std::max((int)(rel[d] / reach), 0), dims[d] - 1);
+            }
+        };
+        auto cellIndex = [&](const int* c) { return ((size_t)c[0] * dims[1] + c[1]) * dims[2] + c[2]; };
+
+        // Points known to this tile: the halo from neighbor tiles first, then the tile's own
+        std::vector<SamplePoint> local;
+        auto addLocal = [&](const SamplePoint& pnt) {
+            int c[3];
+            cellOf(pnt.pos, c);
+            cells[cellIndex(c)].push_back((unsigned int)local.size());
+            local.push_back(pnt);
+        };
+        for (int di = -1; di <= 1; di++) {
+            for (int dj = -1; dj <= 1; dj++) {
+                for (int dk = -1; dk <= 1; dk++) {
+                    const int ni = ti[0] + di, nj = ti[1] + dj, nk = ti[2] + dk;
+                    if ((di == 0 && dj == 0 && dk == 0) || ni < 0 || nj < 0 || nk < 0 || ni >= layout.nTiles[0] ||
+                        nj >= layout.nTiles[1] || nk >= layout.nTiles[2]) {
+                        continue;
+                    }
+                    // Tiles of other phases are either finished or not started, so reading them is safe
+                    for (const auto& pnt : tilePoints[layout.TileIndex(ni, nj, nk)]) {
+                        if (pnt.pos.x >= lo.x - reach && pnt.pos.x <= hi.x + reach && pnt.pos.y >= lo.y - reach &&
+                            pnt.pos.y <= hi.y + reach && pnt.pos.z >= lo.z - reach && pnt.pos.z <= hi.z + reach) {
+                            addLocal(pnt);
+                        }
+                    }
+                }
+            }
+        }
+        const size_t nHalo = local.size();
+
+        std::mt19937 rng;
+        {
+            std::seed_seq seq{m_seed, (unsigned int)(tileID & 0xffffffffu), (unsigned int)(tileID >> 32)};
+            rng.seed(seq);
+        }
+        std::uniform_real_distribution<float> realDist(0.f, 1.f);
+        std::normal_distribution<float> normDist(0.f, 1.f);
+        std::discrete_distribution<unsigned int> radDist(m_weights.begin(), m_weights.end());
+        auto pickRadius = [&]() -> unsigned int {
+            if (m_radii.size() == 1)
+                return 0;
+            if (m_weights.empty())
+                return std::min((unsigned int)(realDist(rng) * m_radii.size()), (unsigned int)m_radii.size() - 1);
+            return radDist(rng);
+        };
+
+        auto inTile = [&](const float3& p) {
+            // The last tile in each direction owns its upper boundary
+            const float pv[3] = {p.x, p.y, p.z};
+            const float lv[3] = {lo.x, lo.y, lo.z};
+            const float hv[3] = {hi.x, hi.y, hi.z};
+            for (int d = 0; d < 3; d++) {
+                if (layout.flat[d])
+                    continue;
+                if (pv[d] < lv[d] || pv[d] > hv[d] || (pv[d] == hv[d] && ti[d] != layout.nTiles[d] - 1))
+                    return false;
+            }
+            return true;
+        };
+        auto farEnough = [&](const SamplePoint& q) {
+            int c[3];
+            cellOf(q.pos, c);
+            const float rq = m_radii[q.rid];
+            for (int i = std::max(c[0] - 1, 0); i <= std::min(c[0] + 1, dims[0] - 1); i++) {
+                for (int j = std::max(c[1] - 1, 0); j <= std::min(c[1] + 1, dims[1] - 1); j++) {
+                    for (int k = std::max(c[2] - 1, 0); k <= std::min(c[2] + 1, dims[2] - 1); k++) {
+                        const int nc[3] = {i, j, k};
+                        for (unsigned int id : cells[cellIndex(nc)]) {
+                            const float minD = rq + m_radii[local[id].rid] + this->m_separation;
+                            const float3 dist = q.pos - local[id].pos;
+                            if (dot(dist, dist) < minD * minD)
+                                return false;
+                        }
+                    }
+                }
+            }
+            return true;
+        };
+
+        // Bridson's loop: grow new points around the active ones until none of them has room left nearby
+        std::vector<unsigned int> active;
+        auto grow = [&]() {
+            while (!active.empty()) {
+                std::uniform_int_distribution<size_t> intDist(0, active.size() - 1);
+                const size_t a = intDist(rng);
+                const SamplePoint src = local[active[a]];
+                bool found = false;
+                for (int n = 0; n < m_ppi; n++) {
+                    SamplePoint q;
+                    q.rid = pickRadius();
+                    // Random direction in the non-flat directions, at a distance between 1 and 2 times the minimum
+                    float dir[3];
+                    float len2 = 0.f;
+                    do {
+                        len2 = 0.f;
+                        for (int d = 0; d < 3; d++) {
+                            dir[d] = layout.flat[d] ? 0.f : normDist(rng);
+                            len2 += dir[d] * dir[d];
+                        }
+                    } while (len2 < 1e-12f);
+                    const float minD = m_radii[src.rid] + m_radii[q.rid] + this->m_separation;
+                    const float dist = minD * (1 + realDist(rng)) / std::sqrt(len2);
+                    q.pos = src.pos + make_float3(dir[0] * dist, dir[1] * dist, dir[2] * dist);
+                    if (!inTile(q.pos) || !this->accept(t, q.pos) || !farEnough(q))
+                        continue;
+                    active.push_back((unsigned int)local.size());
+                    addLocal(q);
+                    found = true;
+                }
+                if (!found) {
+                    active[a] = active.back();
+                    active.pop_back();
+                }
+            }
+        };
+
+        // Grow from the points neighbor tiles placed first
+        active.resize(nHalo);
+        for (size_t n = 0; n < nHalo; n++) {
+            active[n] = (unsigned int)n;
+        }
+        grow();
+        // Then seed at random points of the tile, growing from each one that lands in the domain away from the others.
+        // This covers tiles no neighbor reaches into, and parts of the domain the growth cannot get to (say, where a
+        // curved boundary cuts a corner of the tile). Seeding stops after a number of misses in a row that is a few
+        // times the number of cells in the tile, so even a gap of about one cell is likely found.
+        size_t nTileCells = 1;
+        for (int d = 0; d < 3; d++) {
+            if (!layout.flat[d])
+                nTileCells *= (size_t)std::ceil(tileExt[d] / reach);
+        }
+        const size_t seedBudget = std::max<size_t>(4 * nTileCells, (size_t)m_ppi);
+        for (size_t misses = 0; misses < seedBudget;) {
+            SamplePoint q;
+            q.pos = lo + make_float3(realDist(rng) * layout.tileSize.x, realDist(rng) * layout.tileSize.y,
+                                     realDist(rng) * layout.tileSize.z);
+            q.rid = pickRadius();
+            if (inTile(q.pos) && this->accept(t, q.pos) && farEnough(q)) {
+                active.push_back((unsigned int)local.size());
+                addLocal(q);
+                grow();
+                misses = 0;
+            } else {
+                misses++;
+            }
+        }
+
+        tilePoints[tileID].assign(local.begin() + nHalo, local.end());
+    }
+
+    int m_ppi;  ///< maximum points per iteration
+    unsigned int m_seed = 0;
+    unsigned int m_nThreads;
+    unsigned int m_tileCells = 16;
+    std::vector<float> m_radii;
+    std::vector<float> m_weights;
+    std::vector<unsigned int> m_radiusIDs;
+
+    static const int m_ppi_default = 30;
+};
+
 // HCP
 class HCPSampler : public Sampler {
   public:
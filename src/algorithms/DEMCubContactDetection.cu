@@ -35,11 +35,11 @@ inline void contactEventArraysResize(size_t nContactPairs,
     granData.toDevice();
 }
 
-void contactDetection(std::shared_ptr<jitify::Program>& bin_sphere_kernels,
-                      std::shared_ptr<jitify::Program>& bin_triangle_kernels,
-                      std::shared_ptr<jitify::Program>& sphere_contact_kernels,
-                      std::shared_ptr<jitify::Program>& sphTri_contact_kernels,
-                      std::shared_ptr<jitify::Program>& history_kernels,
+void contactDetection(std::shared_ptr<JitProgram>& bin_sphere_kernels,
+                      std::shared_ptr<JitProgram>& bin_triangle_kernels,
+                      std::shared_ptr<JitProgram>& sphere_contact_kernels,
+                      std::shared_ptr<JitProgram>& sphTri_contact_kernels,
+                      std::shared_ptr<JitProgram>& history_kernels,
                       DualStruct<DEMDataKT>& granData,
                       DualStruct<DEMSimParams>& simParams,
                       SolverFlags& solverFlags,
@@ -72,6 +72,9 @@ void contactDetection(std::shared_ptr<jitify::Program>& bin_sphere_kernels,
     stateParams.maxSphFoundInBin = 0;
     stateParams.maxTriFoundInBin = 0;
     stateParams.avgCntsPerSphere = 0;
+    stateParams.numSphBinPairs = 0;
+    stateParams.numActiveBins = 0;
+    stateParams.numPairCandidates = 0;
 
     // total bytes needed for temp arrays in contact detection
     size_t CD_temp_arr_bytes = 0;
@@ -221,6 +224,7 @@ void contactDetection(std::shared_ptr<jitify::Program>& bin_sphere_kernels,
         // displayDeviceArray<spheresBinTouches_t>(numSpheresBinTouches, *pNumActiveBins);
         // std::cout << "binIDsEachSphereTouches_sorted: ";
         // displayDeviceArray<binID_t>(binIDsEachSphereTouches_sorted, *pNumBinSphereTouchPairs);
+        stateParams.numSphBinPairs = *pNumBinSphereTouchPairs;
         scratchPad.finishUsingDualStruct("numBinSphereTouchPairs");
 
         // We find the max geo num in a bin for the purpose of adjusting bin size.
@@ -232,6 +236,15 @@ void contactDetection(std::shared_ptr<jitify::Program>& bin_sphere_kernels,
         stateParams.maxSphFoundInBin = *((spheresBinTouches_t*)scratchPad.getDualStructHost("maxGeoInBin"));
         scratchPad.finishUsingDualStruct("maxGeoInBin");
 
+        // Also the work this bin size causes, for the bin size tuner
+        scratchPad.allocateDualStruct("numPairCandidates");
+        deviceSumPairsInGroups<spheresBinTouches_t>(scratchPad.getDualStructDevice("numPairCandidates"),
+                                                    numSpheresBinTouches, *pNumActiveBins, this_stream);
+        scratchPad.syncDualStructDeviceToHost("numPairCandidates");
+        stateParams.numPairCandidates = *scratchPad.getDualStructHost("numPairCandidates");
+        scratchPad.finishUsingDualStruct("numPairCandidates");
+        stateParams.numActiveBins = *pNumActiveBins;
+
         // Then, scan to find the offsets that are used to index into sphereIDsEachBinTouches_sorted to obtain bin-wise
         // spheres. Note binIDsEachSphereTouches_sorted can retire.
         scratchPad.finishUsingTempVector("binIDsEachSphereTouches_sorted");
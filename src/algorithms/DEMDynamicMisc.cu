@@ -11,6 +11,57 @@
 
 namespace deme {
 
+// Given the force and torque of contact i as stored (that A feels, in global), turn them into what ownerID, the A side
+// if AorB, feels: the contact point goes to global frame, the force is flipped for B, and the torque is turned into
+// torque about the owner's CoM, expressed in local frame if torque_in_local, in global frame otherwise.
+inline __device__ void getOwnerSideOfContact(float3& cntPnt,
+                                             float3& force,
+                                             float3& torque,
+                                             size_t i,
+                                             bodyID_t ownerID,
+                                             bool AorB,
+                                             bool need_torque,
+                                             bool torque_in_local,
+                                             DEMSimParams* simParams,
+                                             DEMDataDT* granData) {
+    double3 CoM;
+    float4 oriQ;
+    if (AorB) {
+        cntPnt = granData->contactPointGeometryA[i];
+    } else {
+        cntPnt = granData->contactPointGeometryB[i];
+        // Force dir flipped
+        force = -force;
+        if (need_torque)
+            torque = -torque;
+    }
+    oriQ.w = granData->oriQw[ownerID];
+    oriQ.x = granData->oriQx[ownerID];
+    oriQ.y = granData->oriQy[ownerID];
+    oriQ.z = granData->oriQz[ownerID];
+    // Must derive torque in local...
+    if (need_torque) {
+        applyOriQToVector3<float, deme::oriQ_t>(torque.x, torque.y, torque.z, oriQ.w, -oriQ.x, -oriQ.y, -oriQ.z);
+        // Force times point...
+        torque = cross(cntPnt, torque);
+        if (!torque_in_local) {  // back to global if needed
+            applyOriQToVector3<float, deme::oriQ_t>(torque.x, torque.y, torque.z, oriQ.w, oriQ.x, oriQ.y, oriQ.z);
+        }
+    }
+
+    voxelID_t voxel = granData->voxelID[ownerID];
+    subVoxelPos_t subVoxX = granData->locX[ownerID];
+    subVoxelPos_t subVoxY = granData->locY[ownerID];
+    subVoxelPos_t subVoxZ = granData->locZ[ownerID];
+    voxelIDToPosition<double, voxelID_t, subVoxelPos_t>(CoM.x, CoM.y, CoM.z, voxel, subVoxX, subVoxY, subVoxZ,
+                                                        simParams->nvXp2, simParams->nvYp2, simParams->voxelSize,
+                                                        simParams->l);
+    CoM.x += simParams->LBFX;
+    CoM.y += simParams->LBFY;
+    CoM.z += simParams->LBFZ;
+    applyFrameTransformLocalToGlobal<float3, double3, float4>(cntPnt, CoM, oriQ);
+}
+
 __global__ void getContactForcesConcerningOwners_impl(float3* d_points,
                                                       float3* d_forces,
                                                       float3* d_torques,
@@ -53,45 +104,8 @@ __global__ void getContactForcesConcerningOwners_impl(float3* d_points,
         // It's a contact we need to output...
         unsigned long long writeIndex = atomicAdd(d_numUsefulCnt, 1);
         float3 cntPnt;
-        double3 CoM;
-        float4 oriQ;
-        bodyID_t ownerID;
-        if (AorB) {
-            cntPnt = granData->contactPointGeometryA[i];
-            ownerID = ownerA;
-        } else {
-            cntPnt = granData->contactPointGeometryB[i];
-            ownerID = ownerB;
-            // Force dir flipped
-            force = -force;
-            if (need_torque)
-                torque = -torque;
-        }
-        oriQ.w = granData->oriQw[ownerID];
-        oriQ.x = granData->oriQx[ownerID];
-        oriQ.y = granData->oriQy[ownerID];
-        oriQ.z = granData->oriQz[ownerID];
-        // Must derive torque in local...
-        if (need_torque) {
-            applyOriQToVector3<float, deme::oriQ_t>(torque.x, torque.y, torque.z, oriQ.w, -oriQ.x, -oriQ.y, -oriQ.z);
-            // Force times point...
-            torque = cross(cntPnt, torque);
-            if (!torque_in_local) {  // back to global if needed
-                applyOriQToVector3<float, deme::oriQ_t>(torque.x, torque.y, torque.z, oriQ.w, oriQ.x, oriQ.y, oriQ.z);
-            }
-        }
-
-        voxelID_t voxel = granData->voxelID[ownerID];
-        subVoxelPos_t subVoxX = granData->locX[ownerID];
-        subVoxelPos_t subVoxY = granData->locY[ownerID];
-        subVoxelPos_t subVoxZ = granData->locZ[ownerID];
-        voxelIDToPosition<double, voxelID_t, subVoxelPos_t>(CoM.x, CoM.y, CoM.z, voxel, subVoxX, subVoxY, subVoxZ,
-                                                            simParams->nvXp2, simParams->nvYp2, simParams->voxelSize,
-                                                            simParams->l);
-        CoM.x += simParams->LBFX;
-        CoM.y += simParams->LBFY;
-        CoM.z += simParams->LBFZ;
-        applyFrameTransformLocalToGlobal<float3, double3, float4>(cntPnt, CoM, oriQ);
+        getOwnerSideOfContact(cntPnt, force, torque, i, AorB ? ownerA : ownerB, AorB, need_torque, torque_in_local,
+                              simParams, granData);
         d_points[writeIndex] = cntPnt;
         d_forces[writeIndex] = force;
         if (need_torque)
@@ -118,4 +132,184 @@ void getContactForcesConcerningOwners(float3* d_points,
     DEME_GPU_CALL(cudaStreamSynchronize(this_stream));
 }
 
+// Block-wide sum of 6 per-thread values; the result lands in sh[k][0]
+inline __device__ void blockSumWrench(double (*sh)[DEME_WRENCH_REDUCE_NTHREADS], const double* w) {
+    for (int k = 0; k < 6; k++)
+        sh[k][threadIdx.x] = w[k];
+    __syncthreads();
+    for (unsigned int stride = blockDim.x / 2; stride > 0; stride >>= 1) {
+        if (threadIdx.x < stride) {
+            for (int k = 0; k < 6; k++)
+                sh[k][threadIdx.x] += sh[k][threadIdx.x + stride];
+        }
+        __syncthreads();
+    }
+}
+
+__global__ void reduceContactWrenchPerBlock_impl(double* d_blockWrench,
+                                                 bodyID_t* d_ownerIDs,
+                                                 size_t IDListSize,
+                                                 double3 ref,
+                                                 DEMSimParams* simParams,
+                                                 DEMDataDT* granData,
+                                                 size_t numCnt) {
+    __shared__ double sh[6][DEME_WRENCH_REDUCE_NTHREADS];
+    double w[6] = {0., 0., 0., 0., 0., 0.};
+    size_t i = blockIdx.x * blockDim.x + threadIdx.x;
+    if (i < numCnt) {
+        bodyID_t geoA = granData->idGeometryA[i];
+        bodyID_t ownerA = granData->ownerClumpBody[geoA];
+        bodyID_t geoB = granData->idGeometryB[i];
+        contact_t typeB = granData->contactType[i];
+        bodyID_t ownerB = DEME_GET_GEO_OWNER_ID(geoB, typeB);
+        bool hasA = cuda_binary_search<bodyID_t, ssize_t>(d_ownerIDs, ownerA, 0, IDListSize - 1);
+        bool hasB = cuda_binary_search<bodyID_t, ssize_t>(d_ownerIDs, ownerB, 0, IDListSize - 1);
+        // Contacts between two probed owners are internal to the probed set, and cancel out in its net wrench
+        if (hasA != hasB) {
+            float3 force = granData->contactForces[i];
+            float3 torque = granData->contactTorque_convToForce[i];
+            float3 cntPnt;
+            getOwnerSideOfContact(cntPnt, force, torque, i, hasA ? ownerA : ownerB, hasA, true, false, simParams,
+                                  granData);
+            double rx = cntPnt.x - ref.x, ry = cntPnt.y - ref.y, rz = cntPnt.z - ref.z;
+            w[0] = force.x;
+            w[1] = force.y;
+            w[2] = force.z;
+            w[3] = ry * force.z - rz * force.y + torque.x;
+            w[4] = rz * force.x - rx * force.z + torque.y;
+            w[5] = rx * force.y - ry * force.x + torque.z;
+        }
+    }
+    blockSumWrench(sh, w);
+    if (threadIdx.x == 0) {
+        for (int k = 0; k < 6; k++)
+            d_blockWrench[blockIdx.x * 6 + k] = sh[k][0];
+    }
+}
+
+// One block sums up all the per-block results, so the net wrench is deterministic
+__global__ void reduceContactWrenchFinal_impl(double* d_wrench, const double* d_blockWrench, size_t nBlocks) {
+    __shared__ double sh[6][DEME_WRENCH_REDUCE_NTHREADS];
+    double w[6] = {0., 0., 0., 0., 0., 0.};
+    for (size_t b = threadIdx.x; b < nBlocks; b += blockDim.x) {
+        for (int k = 0; k < 6; k++)
+            w[k] += d_blockWrench[b * 6 + k];
+    }
+    blockSumWrench(sh, w);
+    if (threadIdx.x == 0) {
+        for (int k = 0; k < 6; k++)
+            d_wrench[k] = sh[k][0];
+    }
+}
+
+size_t getContactWrenchNumBlocks(size_t numCnt) {
+    return (numCnt + DEME_WRENCH_REDUCE_NTHREADS - 1) / DEME_WRENCH_REDUCE_NTHREADS;
+}
+
+void getContactWrenchConcerningOwners(double* d_wrench,
+                                      double* d_blockWrench,
+                                      bodyID_t* d_ownerIDs,
+                                      size_t IDListSize,
+                                      double3 ref,
+                                      DEMSimParams* simParams,
+                                      DEMDataDT* granData,
+                                      size_t numCnt,
+                                      cudaStream_t& this_stream) {
+    size_t blocks_needed = getContactWrenchNumBlocks(numCnt);
+    if (blocks_needed > 0) {
+        reduceContactWrenchPerBlock_impl<<<blocks_needed, DEME_WRENCH_REDUCE_NTHREADS, 0, this_stream>>>(
+            d_blockWrench, d_ownerIDs, IDListSize, ref, simParams, granData, numCnt);
+    }
+    reduceContactWrenchFinal_impl<<<1, DEME_WRENCH_REDUCE_NTHREADS, 0, this_stream>>>(d_wrench, d_blockWrench,
+                                                                                       blocks_needed);
+    DEME_GPU_CALL(cudaStreamSynchronize(this_stream));
+}
+
+__global__ void gatherOwnerStates_impl(float* d_out,
+                                       const bodyID_t* d_ownerIDs,
+                                       size_t n,
+                                       unsigned int content,
+                                       unsigned int record_len,
+                                       DEMSimParams* simParams,
+                                       DEMDataDT* granData) {
+    size_t i = blockIdx.x * blockDim.x + threadIdx.x;
+    if (i < n) {
+        bodyID_t ownerID = d_ownerIDs[i];
+        // The requested states are written one after another, in the order of SNAPSHOT_CONTENT
+        float* rec = d_out + i * record_len;
+        if (content & SNAP_POS) {
+            double X, Y, Z;
+            voxelIDToPosition<double, voxelID_t, subVoxelPos_t>(
+                X, Y, Z, granData->voxelID[ownerID], granData->locX[ownerID], granData->locY[ownerID],
+                granData->locZ[ownerID], simParams->nvXp2, simParams->nvYp2, simParams->voxelSize, simParams->l);
+            *(rec++) = X + simParams->LBFX;
+            *(rec++) = Y + simParams->LBFY;
+            *(rec++) = Z + simParams->LBFZ;
+        }
+        if (content & SNAP_ORI_Q) {
+            *(rec++) = granData->oriQx[ownerID];
+            *(rec++) = granData->oriQy[ownerID];
+            *(rec++) = granData->oriQz[ownerID];
+            *(rec++) = granData->oriQw[ownerID];
+        }
+        if (content & SNAP_VEL) {
+            *(rec++) = granData->vX[ownerID];
+            *(rec++) = granData->vY[ownerID];
+            *(rec++) = granData->vZ[ownerID];
+        }
+        if (content & SNAP_ANG_VEL) {
+            *(rec++) = granData->omgBarX[ownerID];
+            *(rec++) = granData->omgBarY[ownerID];
+            *(rec++) = granData->omgBarZ[ownerID];
+        }
+        if (content & SNAP_ACC) {
+            *(rec++) = granData->aX[ownerID];
+            *(rec++) = granData->aY[ownerID];
+            *(rec++) = granData->aZ[ownerID];
+        }
+        if (content & SNAP_ANG_ACC) {
+            *(rec++) = granData->alphaX[ownerID];
+            *(rec++) = granData->alphaY[ownerID];
+            *(rec++) = granData->alphaZ[ownerID];
+        }
+        if (content & SNAP_FAMILY) {
+            *(rec++) = (float)granData->familyID[ownerID];
+        }
+    }
+}
+
+void gatherOwnerStates(float* d_out,
+                       const bodyID_t* d_ownerIDs,
+                       size_t n,
+                       unsigned int content,
+                       unsigned int record_len,
+                       DEMSimParams* simParams,
+                       DEMDataDT* granData,
+                       cudaStream_t& this_stream) {
+    size_t blocks_needed = (n + DEME_MAX_THREADS_PER_BLOCK - 1) / DEME_MAX_THREADS_PER_BLOCK;
+    // No sync here: the caller decides whether to wait for it
+    gatherOwnerStates_impl<<<blocks_needed, DEME_MAX_THREADS_PER_BLOCK, 0, this_stream>>>(
+        d_out, d_ownerIDs, n, content, record_len, simParams, granData);
+}
+
+__global__ void computeOwnerAccJump_impl(float* d_out, const float* d_prevAcc, size_t n, DEMDataDT* granData) {
+    size_t ownerID = blockIdx.x * blockDim.x + threadIdx.x;
+    if (ownerID < n) {
+        float3 jump = make_float3(granData->aX[ownerID] - d_prevAcc[ownerID],
+                                  granData->aY[ownerID] - d_prevAcc[n + ownerID],
+                                  granData->aZ[ownerID] - d_prevAcc[2 * n + ownerID]);
+        d_out[ownerID] = length(jump);
+    }
+}
+
+void computeOwnerAccJump(float* d_out,
+                         const float* d_prevAcc,
+                         size_t n,
+                         DEMDataDT* granData,
+                         cudaStream_t& this_stream) {
+    size_t blocks_needed = (n + DEME_MAX_THREADS_PER_BLOCK - 1) / DEME_MAX_THREADS_PER_BLOCK;
+    computeOwnerAccJump_impl<<<blocks_needed, DEME_MAX_THREADS_PER_BLOCK, 0, this_stream>>>(d_out, d_prevAcc, n,
+                                                                                         granData);
+}
+
 }  // namespace deme
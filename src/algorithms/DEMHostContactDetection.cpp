@@ -0,0 +1,584 @@
+//  Copyright (c) 2021, SBEL GPU Development Team
+//  Copyright (c) 2021, University of Wisconsin - Madison
+//
+//	SPDX-License-Identifier: BSD-3-Clause
+
+#include <algorithm>
+#include <numeric>
+#include <vector>
+#include <utility>
+#ifdef DEME_USE_OPENMP
+    #include <omp.h>
+#endif
+
+#include <kernel/DEMHelperKernels.cuh>
+
+#include <algorithms/DEMHostContactDetection.h>
+#include <DEM/HostSideHelpers.hpp>
+
+namespace deme {
+
+// ========================================================================
+// Host counterpart of contactDetection in DEMCubContactDetection.cu. The steps are
+// the same (sphere--bin touch counting, prefix scan, pair population, sort-by-key,
+// run-length encoding of active bins, then bin-wise contact pair generation and
+// history mapping), but run on host arrays, parallelized with OpenMP if available.
+// Nothing here touches the device, so it can be built and run without a GPU.
+// ========================================================================
+
+// Exclusive scan of in into out, which has n + 1 elements; the last one is the total
+template <typename T1, typename T2>
+inline void hostExclusiveScan(const T1* in, T2* out, size_t n) {
+    T2 sum = 0;
+    for (size_t i = 0; i < n; i++) {
+        out[i] = sum;
+        sum += (T2)in[i];
+    }
+    out[n] = sum;
+}
+
+// Stable sort of a group of same-length arrays, based on the keys. Stability matters: it mimics the radix sort on the
+// device.
+template <typename T1>
+inline std::vector<size_t> hostStableSortPermutation(const T1* keys, size_t n) {
+    std::vector<size_t> perm(n);
+    std::iota(perm.begin(), perm.end(), 0);
+    std::stable_sort(perm.begin(), perm.end(), [keys](size_t i1, size_t i2) { return keys[i1] < keys[i2]; });
+    return perm;
+}
+
+template <typename T1>
+inline void hostApplyPermutation(T1* arr, const std::vector<size_t>& perm) {
+    std::vector<T1> tmp(perm.size());
+#pragma omp parallel for schedule(static)
+    for (long long i = 0; i < (long long)perm.size(); i++) {
+        tmp[i] = arr[perm[i]];
+    }
+    std::copy(tmp.begin(), tmp.end(), arr);
+}
+
+// Location and (margin-expanded) radius of a sphere component, as the CD kernels see them
+inline void hostSphereLocation(const DEMDataKT& hostData,
+                               const DEMSimParams* simParams,
+                               const SolverFlags& solverFlags,
+                               bodyID_t sphereID,
+                               double3& pos,
+                               float& radius,
+                               double& radius_double) {
+    const bodyID_t myOwnerID = hostData.ownerClumpBody[sphereID];
+    // If clumps are jitified, the extended offset always points to the correct place in template arrays
+    const size_t compOffset = solverFlags.useClumpJitify ? (size_t)hostData.clumpComponentOffsetExt[sphereID] : sphereID;
+    float3 myRelPos = make_float3(hostData.relPosSphereX[compOffset], hostData.relPosSphereY[compOffset],
+                                  hostData.relPosSphereZ[compOffset]);
+    radius = hostData.radiiSphere[compOffset] + hostData.marginSize[myOwnerID];
+    radius_double = (double)hostData.radiiSphere[compOffset] + hostData.marginSize[myOwnerID];
+
+    double3 ownerXYZ;
+    voxelIDToPosition<double, voxelID_t, subVoxelPos_t>(
+        ownerXYZ.x, ownerXYZ.y, ownerXYZ.z, hostData.voxelID[myOwnerID], hostData.locX[myOwnerID],
+        hostData.locY[myOwnerID], hostData.locZ[myOwnerID], simParams->nvXp2, simParams->nvYp2, simParams->voxelSize,
+        simParams->l);
+    applyOriQToVector3<float, oriQ_t>(myRelPos.x, myRelPos.y, myRelPos.z, hostData.oriQw[myOwnerID],
+                                      hostData.oriQx[myOwnerID], hostData.oriQy[myOwnerID], hostData.oriQz[myOwnerID]);
+    pos = ownerXYZ + to_double3(myRelPos);
+}
+
+// Check a sphere against an analytical entity. Returns the contact type (NOT_A_CONTACT if not in contact).
+inline contact_t hostSphereAnalContact(const DEMDataKT& hostData,
+                                       const DEMSimParams* simParams,
+                                       const double3& myPosXYZ,
+                                       double myRadius,
+                                       unsigned int sphFamilyNum,
+                                       objID_t objB) {
+    const bodyID_t objBOwner = hostData.ownerAnalBody[objB];
+    unsigned int objFamilyNum = hostData.familyID[objBOwner];
+    unsigned int maskMatID = locateMaskPair<unsigned int>(sphFamilyNum, objFamilyNum);
+    if (hostData.familyMasks[maskMatID] != DONT_PREVENT_CONTACT) {
+        return NOT_A_CONTACT;
+    }
+    double3 ownerXYZ;
+    voxelIDToPosition<double, voxelID_t, subVoxelPos_t>(
+        ownerXYZ.x, ownerXYZ.y, ownerXYZ.z, hostData.voxelID[objBOwner], hostData.locX[objBOwner],
+        hostData.locY[objBOwner], hostData.locZ[objBOwner], simParams->nvXp2, simParams->nvYp2, simParams->voxelSize,
+        simParams->l);
+    const float ownerOriQw = hostData.oriQw[objBOwner];
+    const float ownerOriQx = hostData.oriQx[objBOwner];
+    const float ownerOriQy = hostData.oriQy[objBOwner];
+    const float ownerOriQz = hostData.oriQz[objBOwner];
+    float objBRelPosX = hostData.relPosEntityX[objB];
+    float objBRelPosY = hostData.relPosEntityY[objB];
+    float objBRelPosZ = hostData.relPosEntityZ[objB];
+    float objBRotX = hostData.oriEntityX[objB];
+    float objBRotY = hostData.oriEntityY[objB];
+    float objBRotZ = hostData.oriEntityZ[objB];
+    applyOriQToVector3<float, oriQ_t>(objBRelPosX, objBRelPosY, objBRelPosZ, ownerOriQw, ownerOriQx, ownerOriQy,
+                                      ownerOriQz);
+    applyOriQToVector3<float, oriQ_t>(objBRotX, objBRotY, objBRotZ, ownerOriQw, ownerOriQx, ownerOriQy, ownerOriQz);
+    double3 objBPosXYZ = ownerXYZ + make_double3(objBRelPosX, objBRelPosY, objBRelPosZ);
+
+    double overlapDepth;
+    contact_t contact_type;
+    {
+        double3 cntPnt;  // Placeholder
+        float3 cntNorm;  // Placeholder
+        contact_type = checkSphereEntityOverlap<double3, float, double>(
+            myPosXYZ, myRadius, hostData.typeEntity[objB], objBPosXYZ, make_float3(objBRotX, objBRotY, objBRotZ),
+            hostData.sizeEntity1[objB], hostData.sizeEntity2[objB], hostData.sizeEntity3[objB],
+            hostData.normalEntity[objB], hostData.marginSize[objBOwner], cntPnt, cntNorm, overlapDepth);
+    }
+    // Same as the device: overlap must be larger than the smaller of the two extra margins
+    double marginThres = DEME_MIN(hostData.familyExtraMarginSize[sphFamilyNum],
+                                  hostData.familyExtraMarginSize[objFamilyNum]);
+    return (contact_type && overlapDepth > marginThres) ? contact_type : NOT_A_CONTACT;
+}
+
+// Bin-wise sphere--sphere sweep, shared by the counting and the populating passes. If idSphA is nullptr, only count.
+inline binContactPairs_t hostSphSphContactsInBin(const DEMDataKT& hostData,
+                                                 const DEMSimParams* simParams,
+                                                 const std::vector<double3>& sphPos,
+                                                 const std::vector<float>& sphRadii,
+                                                 const bodyID_t* sphereIDs,
+                                                 spheresBinTouches_t nBodiesInBin,
+                                                 binID_t binID,
+                                                 bodyID_t* idSphA,
+                                                 bodyID_t* idSphB,
+                                                 contact_t* dType,
+                                                 contactPairs_t nAllowed) {
+    binContactPairs_t count = 0;
+    for (spheresBinTouches_t a = 0; a < nBodiesInBin; a++) {
+        const bodyID_t sphA = sphereIDs[a];
+        const bodyID_t ownerA = hostData.ownerClumpBody[sphA];
+        const unsigned int bodyAFamily = hostData.familyID[ownerA];
+        for (spheresBinTouches_t b = a + 1; b < nBodiesInBin; b++) {
+            const bodyID_t sphB = sphereIDs[b];
+            const bodyID_t ownerB = hostData.ownerClumpBody[sphB];
+            // Not the same clump
+            if (ownerA == ownerB)
+                continue;
+            const unsigned int bodyBFamily = hostData.familyID[ownerB];
+            unsigned int maskMatID = locateMaskPair<unsigned int>(bodyAFamily, bodyBFamily);
+            if (hostData.familyMasks[maskMatID] != DONT_PREVENT_CONTACT)
+                continue;
+
+            double CPX, CPY, CPZ, overlapDepth;
+            float normX, normY, normZ;
+            bool in_contact = checkSpheresOverlap<double, float>(
+                sphPos[sphA].x, sphPos[sphA].y, sphPos[sphA].z, sphRadii[sphA], sphPos[sphB].x, sphPos[sphB].y,
+                sphPos[sphB].z, sphRadii[sphB], CPX, CPY, CPZ, normX, normY, normZ, overlapDepth);
+            float artificialMargin = DEME_MIN(hostData.familyExtraMarginSize[bodyAFamily],
+                                              hostData.familyExtraMarginSize[bodyBFamily]);
+            in_contact = in_contact && (overlapDepth > (double)artificialMargin);
+            // The contact point must be in this bin to avoid double-counting
+            if (in_contact &&
+                getPointBinID<binID_t>(CPX, CPY, CPZ, simParams->binSize, simParams->nbX, simParams->nbY) == binID) {
+                if (idSphA && count < nAllowed) {
+                    idSphA[count] = sphA;
+                    idSphB[count] = sphB;
+                    dType[count] = SPHERE_SPHERE_CONTACT;
+                }
+                count++;
+            }
+        }
+    }
+    return count;
+}
+
+
+void hostContactDetection(const DEMDataKT& hostData,
+                          const DEMSimParams& simParams,
+                          const SolverFlags& solverFlags,
+                          VERBOSITY& verbosity,
+                          HostContactArrays& contacts,
+                          HostContactArrays& prevContacts,
+                          size_t& numPrevSpheres,
+                          SolverTimers& timers,
+                          HostContactStats& stats) {
+    std::vector<bodyID_t>& idGeometryA = contacts.idGeometryA;
+    std::vector<bodyID_t>& idGeometryB = contacts.idGeometryB;
+    std::vector<contact_t>& contactType = contacts.contactType;
+    stats = HostContactStats();
+    // A dumb check
+    if (simParams.nSpheresGM == 0) {
+        contacts.clear();
+        prevContacts.clear();
+        numPrevSpheres = 0;
+        return;
+    }
+
+    const size_t nSpheres = simParams.nSpheresGM;
+    const objID_t nAnal = simParams.nAnalGM;
+    // Sphere locations and expanded radii are used by every step below, so compute them only once
+    std::vector<double3> sphPos(nSpheres);
+    std::vector<float> sphRadii(nSpheres);
+    // The bin--sphere sweep works with the radius in double, the same as the device
+    std::vector<double> sphRadiiDouble(nSpheres);
+
+    // Sphere--bin touching pairs, as (binID, sphereID), later sorted
+    std::vector<std::pair<binID_t, bodyID_t>> binSpherePairs;
+    // Contacts involving analytical entities go first in the contact arrays
+    size_t nSphereGeoContact = 0;
+
+    {
+        timers.GetTimer("Discretize domain").start();
+        // 1st step: number of bins and analytical entities each sphere touches
+        std::vector<binsSphereTouches_t> numBinsSphereTouches(nSpheres);
+        std::vector<objID_t> numAnalGeoSphereTouches(nSpheres);
+#pragma omp parallel for schedule(static)
+        for (long long s = 0; s < (long long)nSpheres; s++) {
+            const bodyID_t sphereID = (bodyID_t)s;
+            hostSphereLocation(hostData, &simParams, solverFlags, sphereID, sphPos[s], sphRadii[s], sphRadiiDouble[s]);
+            const double3 myPosXYZ = sphPos[s];
+            const double myRadius = sphRadiiDouble[s];
+            const unsigned int sphFamilyNum = hostData.familyID[hostData.ownerClumpBody[sphereID]];
+
+            double myBinX = myPosXYZ.x / simParams.binSize;
+            double myBinY = myPosXYZ.y / simParams.binSize;
+            double myBinZ = myPosXYZ.z / simParams.binSize;
+            double myRadiusSpan = myRadius / simParams.binSize;
+            binsSphereTouches_t numX, numY, numZ;
+            numX = ((myBinX + myRadiusSpan < (double)simParams.nbX) ? (unsigned int)(myBinX + myRadiusSpan)
+                                                                    : (unsigned int)simParams.nbX - 1) -
+                   (unsigned int)((myBinX - myRadiusSpan > 0.0) ? myBinX - myRadiusSpan : 0.0) + 1;
+            numY = ((myBinY + myRadiusSpan < (double)simParams.nbY) ? (unsigned int)(myBinY + myRadiusSpan)
+                                                                    : (unsigned int)simParams.nbY - 1) -
+                   (unsigned int)((myBinY - myRadiusSpan > 0.0) ? myBinY - myRadiusSpan : 0.0) + 1;
+            numZ = ((myBinZ + myRadiusSpan < (double)simParams.nbZ) ? (unsigned int)(myBinZ + myRadiusSpan)
+                                                                    : (unsigned int)simParams.nbZ - 1) -
+                   (unsigned int)((myBinZ - myRadiusSpan > 0.0) ? myBinZ - myRadiusSpan : 0.0) + 1;
+            numBinsSphereTouches[s] = numX * numY * numZ;
+
+            objID_t contact_count = 0;
+            for (objID_t objB = 0; objB < nAnal; objB++) {
+                if (hostSphereAnalContact(hostData, &simParams, myPosXYZ, myRadius, sphFamilyNum, objB) !=
+                    NOT_A_CONTACT) {
+                    contact_count++;
+                }
+            }
+            numAnalGeoSphereTouches[s] = contact_count;
+        }
+
+        // 2nd step: prefix scan both counts
+        std::vector<binSphereTouchPairs_t> numBinsSphereTouchesScan(nSpheres + 1);
+        hostExclusiveScan(numBinsSphereTouches.data(), numBinsSphereTouchesScan.data(), nSpheres);
+        std::vector<binSphereTouchPairs_t> numAnalGeoSphereTouchesScan(nSpheres + 1);
+        hostExclusiveScan(numAnalGeoSphereTouches.data(), numAnalGeoSphereTouchesScan.data(), nSpheres);
+        const size_t nBinSphereTouchPairs = numBinsSphereTouchesScan[nSpheres];
+        nSphereGeoContact = numAnalGeoSphereTouchesScan[nSpheres];
+        idGeometryA.resize(nSphereGeoContact);
+        idGeometryB.resize(nSphereGeoContact);
+        contactType.resize(nSphereGeoContact);
+
+        // 3rd step: populate sphere--bin touching pairs and sphere--analytical contacts
+        binSpherePairs.resize(nBinSphereTouchPairs);
+        bodyID_t* idA = idGeometryA.data();
+        bodyID_t* idB = idGeometryB.data();
+        contact_t* cType = contactType.data();
+#pragma omp parallel for schedule(static)
+        for (long long s = 0; s < (long long)nSpheres; s++) {
+            const bodyID_t sphereID = (bodyID_t)s;
+            const double3 myPosXYZ = sphPos[s];
+            const double myRadius = sphRadiiDouble[s];
+            const unsigned int sphFamilyNum = hostData.familyID[hostData.ownerClumpBody[sphereID]];
+
+            binSphereTouchPairs_t myReportOffset = numBinsSphereTouchesScan[s];
+            const binSphereTouchPairs_t myReportOffset_end = numBinsSphereTouchesScan[s + 1];
+            double myBinX = myPosXYZ.x / simParams.binSize;
+            double myBinY = myPosXYZ.y / simParams.binSize;
+            double myBinZ = myPosXYZ.z / simParams.binSize;
+            double myRadiusSpan = myRadius / simParams.binSize;
+            for (binID_t k = (binID_t)((myBinZ - myRadiusSpan > 0.0) ? myBinZ - myRadiusSpan : 0.0);
+                 (k <= (binID_t)(myBinZ + myRadiusSpan)) && (k < simParams.nbZ); k++) {
+                for (binID_t j = (binID_t)((myBinY - myRadiusSpan > 0.0) ? myBinY - myRadiusSpan : 0.0);
+                     (j <= (binID_t)(myBinY + myRadiusSpan)) && (j < simParams.nbY); j++) {
+                    for (binID_t i = (binID_t)((myBinX - myRadiusSpan > 0.0) ? myBinX - myRadiusSpan : 0.0);
+                         (i <= (binID_t)(myBinX + myRadiusSpan)) && (i < simParams.nbX); i++) {
+                        if (myReportOffset >= myReportOffset_end) {
+                            continue;
+                        }
+                        binSpherePairs[myReportOffset] = std::make_pair(
+                            binIDFrom3Indices<binID_t>(i, j, k, simParams.nbX, simParams.nbY, simParams.nbZ),
+                            sphereID);
+                        myReportOffset++;
+                    }
+                }
+            }
+            for (; myReportOffset < myReportOffset_end; myReportOffset++) {
+                binSpherePairs[myReportOffset] = std::make_pair(NULL_BINID, sphereID);
+            }
+
+            binSphereTouchPairs_t mySphereGeoReportOffset = numAnalGeoSphereTouchesScan[s];
+            const binSphereTouchPairs_t mySphereGeoReportOffset_end = numAnalGeoSphereTouchesScan[s + 1];
+            for (objID_t objB = 0; objB < nAnal && mySphereGeoReportOffset < mySphereGeoReportOffset_end; objB++) {
+                contact_t contact_type =
+                    hostSphereAnalContact(hostData, &simParams, myPosXYZ, myRadius, sphFamilyNum, objB);
+                if (contact_type != NOT_A_CONTACT) {
+                    idA[mySphereGeoReportOffset] = sphereID;
+                    idB[mySphereGeoReportOffset] = (bodyID_t)objB;
+                    cType[mySphereGeoReportOffset] = contact_type;
+                    mySphereGeoReportOffset++;
+                }
+            }
+            for (; mySphereGeoReportOffset < mySphereGeoReportOffset_end; mySphereGeoReportOffset++) {
+                cType[mySphereGeoReportOffset] = NOT_A_CONTACT;
+            }
+        }
+
+        // 4th step: sort by bin ID. Pairs are generated in sphere ID order, so sorting the (binID, sphereID) pairs
+        // gives the same result as the stable radix sort on the device.
+        std::sort(binSpherePairs.begin(), binSpherePairs.end());
+        timers.GetTimer("Discretize domain").stop();
+    }
+
+    {
+        timers.GetTimer("Find contact pairs").start();
+        // 5th step: run-length encode the sorted bin IDs to find active bins, and scan to get their offsets
+        std::vector<binID_t> activeBinIDs;
+        std::vector<spheresBinTouches_t> numSpheresBinTouches;
+        std::vector<binSphereTouchPairs_t> sphereIDsLookUpTable;
+        std::vector<bodyID_t> sphereIDsEachBinTouches_sorted(binSpherePairs.size());
+        for (size_t i = 0; i < binSpherePairs.size(); i++) {
+            sphereIDsEachBinTouches_sorted[i] = binSpherePairs[i].second;
+            if (i == 0 || binSpherePairs[i].first != binSpherePairs[i - 1].first) {
+                activeBinIDs.push_back(binSpherePairs[i].first);
+                numSpheresBinTouches.push_back(0);
+                sphereIDsLookUpTable.push_back(i);
+            }
+            numSpheresBinTouches.back()++;
+        }
+        const size_t nActiveBins = activeBinIDs.size();
+        // Also record the work this bin size causes, for the bin size tuner
+        stats.numSphBinPairs = binSpherePairs.size();
+        for (size_t i = 0; i < nActiveBins; i++) {
+            if (numSpheresBinTouches[i] > stats.maxSphFoundInBin)
+                stats.maxSphFoundInBin = numSpheresBinTouches[i];
+            if (activeBinIDs[i] == NULL_BINID)
+                continue;
+            const size_t n = numSpheresBinTouches[i];
+            stats.numActiveBins++;
+            stats.numPairCandidates += n * (n - 1) / 2;
+        }
+        if (stats.maxSphFoundInBin > simParams.errOutBinSphNum) {
+            DEME_ERROR(
+                "A bin contains %u sphere components, exceeding maximum allowance (%u).\nIf you want the solver to run "
+                "despite this, set allowance higher via SetMaxSphereInBin before simulation starts.",
+                (unsigned int)stats.maxSphFoundInBin, simParams.errOutBinSphNum);
+        }
+
+        // 6th step: bin-wise sphere--sphere contact counting, then scan, then populating
+        std::vector<binContactPairs_t> numSphContactsInEachBin(nActiveBins);
+#pragma omp parallel for schedule(dynamic, 64)
+        for (long long b = 0; b < (long long)nActiveBins; b++) {
+            if (numSpheresBinTouches[b] <= 1 || activeBinIDs[b] == NULL_BINID) {
+                numSphContactsInEachBin[b] = 0;
+                continue;
+            }
+            numSphContactsInEachBin[b] = hostSphSphContactsInBin(
+                hostData, &simParams, sphPos, sphRadii, sphereIDsEachBinTouches_sorted.data() + sphereIDsLookUpTable[b],
+                numSpheresBinTouches[b], activeBinIDs[b], nullptr, nullptr, nullptr, 0);
+        }
+        std::vector<contactPairs_t> sphSphContactReportOffsets(nActiveBins + 1);
+        hostExclusiveScan(numSphContactsInEachBin.data(), sphSphContactReportOffsets.data(), nActiveBins);
+        const size_t nSphereSphereContact = sphSphContactReportOffsets[nActiveBins];
+
+        const size_t nFound = nSphereGeoContact + nSphereSphereContact;
+        idGeometryA.resize(nFound);
+        idGeometryB.resize(nFound);
+        contactType.resize(nFound);
+        // Sphere--sphere contact pairs go after sphere--anal-geo contacts
+        bodyID_t* idSphA = idGeometryA.data() + nSphereGeoContact;
+        bodyID_t* idSphB = idGeometryB.data() + nSphereGeoContact;
+        contact_t* dType = contactType.data() + nSphereGeoContact;
+#pragma omp parallel for schedule(dynamic, 64)
+        for (long long b = 0; b < (long long)nActiveBins; b++) {
+            const contactPairs_t myReportOffset = sphSphContactReportOffsets[b];
+            const contactPairs_t nAllowed = sphSphContactReportOffsets[b + 1] - myReportOffset;
+            if (nAllowed == 0)
+                continue;
+            hostSphSphContactsInBin(hostData, &simParams, sphPos, sphRadii,
+                                    sphereIDsEachBinTouches_sorted.data() + sphereIDsLookUpTable[b],
+                                    numSpheresBinTouches[b], activeBinIDs[b], idSphA + myReportOffset,
+                                    idSphB + myReportOffset, dType + myReportOffset, nAllowed);
+        }
+
+        // Persistent contacts from the previous contact list are added to the current list
+        if (solverFlags.hasPersistentContacts && !solverFlags.isHistoryless) {
+            const size_t nPrev = prevContacts.idGeometryA.size();
+            std::vector<bodyID_t> total_idA, total_idB;
+            std::vector<contact_t> total_types;
+            std::vector<notStupidBool_t> total_persistency;
+            for (size_t i = 0; i < nPrev && i < prevContacts.contactPersistency.size(); i++) {
+                if (prevContacts.contactPersistency[i] == CONTACT_IS_PERSISTENT) {
+                    total_idA.push_back(prevContacts.idGeometryA[i]);
+                    total_idB.push_back(prevContacts.idGeometryB[i]);
+                    total_types.push_back(prevContacts.contactType[i]);
+                    total_persistency.push_back(CONTACT_IS_PERSISTENT);
+                }
+            }
+            total_idA.insert(total_idA.end(), idGeometryA.begin(), idGeometryA.end());
+            total_idB.insert(total_idB.end(), idGeometryB.begin(), idGeometryB.end());
+            total_types.insert(total_types.end(), contactType.begin(), contactType.end());
+            total_persistency.resize(total_idA.size(), CONTACT_NOT_PERSISTENT);
+
+            // Sort by idA, then remove duplicates within each idA segment
+            const size_t numTotalCnts = total_idA.size();
+            std::vector<size_t> perm = hostStableSortPermutation(total_idA.data(), numTotalCnts);
+            hostApplyPermutation(total_idA.data(), perm);
+            hostApplyPermutation(total_idB.data(), perm);
+            hostApplyPermutation(total_types.data(), perm);
+            hostApplyPermutation(total_persistency.data(), perm);
+            std::vector<notStupidBool_t> retain_flags(numTotalCnts, 1);
+            for (size_t start = 0; start < numTotalCnts;) {
+                size_t end = start + 1;
+                while (end < numTotalCnts && total_idA[end] == total_idA[start])
+                    end++;
+                for (size_t i = start; i + 1 < end; i++) {
+                    for (size_t j = i + 1; j < end; j++) {
+                        if (total_idB[i] == total_idB[j] && total_types[i] == total_types[j]) {
+                            // Remove the non-persistent one; if both are persistent, remove the first
+                            if (total_persistency[i] && total_persistency[j]) {
+                                retain_flags[i] = 0;
+                            } else if (total_persistency[i] == CONTACT_NOT_PERSISTENT) {
+                                retain_flags[i] = 0;
+                            } else {
+                                retain_flags[j] = 0;
+                            }
+                        }
+                    }
+                }
+                start = end;
+            }
+            idGeometryA.clear();
+            idGeometryB.clear();
+            contactType.clear();
+            contacts.contactPersistency.clear();
+            for (size_t i = 0; i < numTotalCnts; i++) {
+                if (retain_flags[i]) {
+                    idGeometryA.push_back(total_idA[i]);
+                    idGeometryB.push_back(total_idB[i]);
+                    contactType.push_back(total_types[i]);
+                    contacts.contactPersistency.push_back(total_persistency[i]);
+                }
+            }
+        }
+        timers.GetTimer("Find contact pairs").stop();
+    }
+
+    timers.GetTimer("Build history map").start();
+    const size_t nContacts = idGeometryA.size();
+    if (nContacts > 0) {
+        bodyID_t* idA = idGeometryA.data();
+        bodyID_t* idB = idGeometryB.data();
+        contact_t* cType = contactType.data();
+        // Sort by idA (persistent contacts path already did it)
+        if (!solverFlags.hasPersistentContacts) {
+            std::vector<size_t> perm = hostStableSortPermutation(idA, nContacts);
+            hostApplyPermutation(idA, perm);
+            hostApplyPermutation(idB, perm);
+            hostApplyPermutation(cType, perm);
+        }
+
+        // Run-length of new idA, and tab-keeping on average contacts per sphere
+        const size_t nSpheresSafe = DEME_MAX(nSpheres, numPrevSpheres);
+        std::vector<geoSphereTouches_t> new_idA_runlength_full(nSpheresSafe, 0);
+        size_t numUniqueNewA = 0;
+        for (size_t i = 0; i < nContacts; i++) {
+            if (i == 0 || idA[i] != idA[i - 1])
+                numUniqueNewA++;
+            new_idA_runlength_full[idA[i]]++;
+        }
+        stats.avgCntsPerSphere = (numUniqueNewA > 0) ? (float)nContacts / (float)numUniqueNewA : 0.0;
+        DEME_STEP_DEBUG_PRINTF("Average number of contacts for each geometry: %.7g", stats.avgCntsPerSphere);
+        if (stats.avgCntsPerSphere > solverFlags.errOutAvgSphCnts) {
+            DEME_ERROR(
+                "On average a sphere has %.7g contacts, more than the max allowance (%.7g).\nIf you believe "
+                "this is not abnormal, set the allowance high using SetErrorOutAvgContacts before "
+                "initialization.\nIf you think this is because dT drifting too much ahead of kT so the contact "
+                "margin added is too big, use SetCDMaxUpdateFreq to limit the max dT future drift.\nOtherwise, the "
+                "simulation may have diverged and relaxing the physics may help, such as decreasing the step size "
+                "and modifying material properties.\nIf this happens at the start of simulation, check if there "
+                "are initial penetrations, a.k.a. elements initialized inside walls.",
+                stats.avgCntsPerSphere, solverFlags.errOutAvgSphCnts);
+        }
+
+        if (!solverFlags.isHistoryless) {
+            const size_t nPrev = prevContacts.idGeometryA.size();
+            std::vector<geoSphereTouches_t> old_idA_runlength_full(nSpheresSafe, 0);
+            for (size_t i = 0; i < nPrev; i++) {
+                old_idA_runlength_full[prevContacts.idGeometryA[i]]++;
+            }
+            std::vector<contactPairs_t> new_idA_scanned_runlength(nSpheresSafe + 1);
+            std::vector<contactPairs_t> old_idA_scanned_runlength(nSpheresSafe + 1);
+            hostExclusiveScan(new_idA_runlength_full.data(), new_idA_scanned_runlength.data(), nSpheresSafe);
+            hostExclusiveScan(old_idA_runlength_full.data(), old_idA_scanned_runlength.data(), nSpheresSafe);
+
+            contacts.contactMapping.resize(nContacts);
+            contactPairs_t* mapping = contacts.contactMapping.data();
+            const bodyID_t* prevIdB = prevContacts.idGeometryB.data();
+            const contact_t* prevType = prevContacts.contactType.data();
+            // Same as buildPersistentMap: find the enduring partner of each new contact in the old array
+#pragma omp parallel for schedule(dynamic, 256)
+            for (long long s = 0; s < (long long)nSpheresSafe; s++) {
+                const geoSphereTouches_t new_cnt_count = new_idA_runlength_full[s];
+                const geoSphereTouches_t old_cnt_count = old_idA_runlength_full[s];
+                const contactPairs_t new_cnt_offset = new_idA_scanned_runlength[s];
+                const contactPairs_t old_cnt_offset = old_idA_scanned_runlength[s];
+                for (geoSphereTouches_t i = 0; i < new_cnt_count; i++) {
+                    const contactPairs_t this_contact = new_cnt_offset + i;
+                    contactPairs_t my_partner = NULL_MAPPING_PARTNER;
+                    if (cType[this_contact] != NOT_A_CONTACT) {
+                        for (geoSphereTouches_t j = 0; j < old_cnt_count; j++) {
+                            if (idB[this_contact] == prevIdB[old_cnt_offset + j] &&
+                                cType[this_contact] == prevType[old_cnt_offset + j]) {
+                                my_partner = old_cnt_offset + j;
+                                break;
+                            }
+                        }
+                    }
+                    mapping[this_contact] = my_partner;
+                }
+            }
+
+            // How the old (idA-sorted) array was shipped to dT: sorted by contact type
+            std::vector<contactPairs_t> old_arr_unsort_to_sort_map;
+            if (solverFlags.should_sort_pairs) {
+                std::vector<size_t> old_perm = hostStableSortPermutation(prevType, nPrev);
+                old_arr_unsort_to_sort_map.resize(nPrev);
+                for (size_t i = 0; i < nPrev; i++) {
+                    old_arr_unsort_to_sort_map[old_perm[i]] = i;
+                }
+            }
+
+            // Record the new contact array (sorted by idA) as the old one for the next CD
+            prevContacts.idGeometryA.assign(idA, idA + nContacts);
+            prevContacts.idGeometryB.assign(idB, idB + nContacts);
+            prevContacts.contactType.assign(cType, cType + nContacts);
+
+            // dT potentially benefits from type-sorted contact array
+            if (solverFlags.should_sort_pairs) {
+                std::vector<size_t> perm = hostStableSortPermutation(cType, nContacts);
+                hostApplyPermutation(idA, perm);
+                hostApplyPermutation(idB, perm);
+                hostApplyPermutation(mapping, perm);
+                hostApplyPermutation(cType, perm);
+                for (size_t i = 0; i < nContacts; i++) {
+                    if (mapping[i] != NULL_MAPPING_PARTNER)
+                        mapping[i] = old_arr_unsort_to_sort_map[mapping[i]];
+                }
+            }
+        } else if (solverFlags.should_sort_pairs) {
+            std::vector<size_t> perm = hostStableSortPermutation(cType, nContacts);
+            hostApplyPermutation(idA, perm);
+            hostApplyPermutation(idB, perm);
+            hostApplyPermutation(cType, perm);
+        }
+    }
+    timers.GetTimer("Build history map").stop();
+
+    // With no contact found, the next CD has no previous contact to map to
+    if (nContacts == 0) {
+        prevContacts.clear();
+    }
+    numPrevSpheres = simParams.nSpheresGM;
+}
+
+}  // namespace deme
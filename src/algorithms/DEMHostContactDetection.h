@@ -0,0 +1,62 @@
+//  Copyright (c) 2021, SBEL GPU Development Team
+//  Copyright (c) 2021, University of Wisconsin - Madison
+//
+//	SPDX-License-Identifier: BSD-3-Clause
+
+#ifndef DEME_HOST_CONTACT_DETECTION_H
+#define DEME_HOST_CONTACT_DETECTION_H
+
+#include <vector>
+
+#include <DEM/Defines.h>
+#include <DEM/Structs.h>
+
+namespace deme {
+
+// Contact pair arrays kept on host, in the layout kT ships to dT
+struct HostContactArrays {
+    std::vector<bodyID_t> idGeometryA;
+    std::vector<bodyID_t> idGeometryB;
+    std::vector<contact_t> contactType;
+    // Persistency of each contact, in idA-sorted order. Only filled when there are persistent contacts.
+    std::vector<notStupidBool_t> contactPersistency;
+    // Index of each contact in the previous contact array. Only filled for history-based models.
+    std::vector<contactPairs_t> contactMapping;
+
+    void clear() {
+        idGeometryA.clear();
+        idGeometryB.clear();
+        contactType.clear();
+        contactPersistency.clear();
+        contactMapping.clear();
+    }
+};
+
+// What a host contact detection run found, for kT's state keeping (kTStateParams) and the bin size tuner
+struct HostContactStats {
+    size_t maxSphFoundInBin = 0;
+    size_t numSphBinPairs = 0;
+    size_t numActiveBins = 0;
+    size_t numPairCandidates = 0;
+    float avgCntsPerSphere = 0.;
+};
+
+// Host (OpenMP) counterpart of contactDetection. It works on host data only: every array hostData points to must be a
+// host array that is up to date. Only sphere--sphere and sphere--analytical contacts are handled, so the caller must
+// not use it when there are mesh triangles.
+// contacts gets the contact pairs (and, if needed, their persistency and history mapping), ordered the same way as the
+// device produces them. prevContacts is the previous contact list sorted by idA, with its persistency; on return it is
+// the current one, for the next call. numPrevSpheres is the sphere count of the previous call, updated the same way.
+void hostContactDetection(const DEMDataKT& hostData,
+                          const DEMSimParams& simParams,
+                          const SolverFlags& solverFlags,
+                          VERBOSITY& verbosity,
+                          HostContactArrays& contacts,
+                          HostContactArrays& prevContacts,
+                          size_t& numPrevSpheres,
+                          SolverTimers& timers,
+                          HostContactStats& stats);
+
+}  // namespace deme
+
+#endif
@@ -76,11 +76,11 @@ void cubSortByKey(T1* d_keys_in,
 // For kT and dT's private usage
 ////////////////////////////////////////////////////////////////////////////////
 
-void contactDetection(std::shared_ptr<jitify::Program>& bin_sphere_kernels,
-                      std::shared_ptr<jitify::Program>& bin_triangle_kernels,
-                      std::shared_ptr<jitify::Program>& sphere_contact_kernels,
-                      std::shared_ptr<jitify::Program>& sphTri_contact_kernels,
-                      std::shared_ptr<jitify::Program>& history_kernels,
+void contactDetection(std::shared_ptr<JitProgram>& bin_sphere_kernels,
+                      std::shared_ptr<JitProgram>& bin_triangle_kernels,
+                      std::shared_ptr<JitProgram>& sphere_contact_kernels,
+                      std::shared_ptr<JitProgram>& sphTri_contact_kernels,
+                      std::shared_ptr<JitProgram>& history_kernels,
                       DualStruct<DEMDataKT>& granData,
                       DualStruct<DEMSimParams>& simParams,
                       SolverFlags& solverFlags,
@@ -99,7 +99,7 @@ void contactDetection(std::shared_ptr<jitify::Program>& bin_sphere_kernels,
                       SolverTimers& timers,
                       kTStateParams& stateParams);
 
-void collectContactForcesThruCub(std::shared_ptr<jitify::Program>& collect_force_kernels,
+void collectContactForcesThruCub(std::shared_ptr<JitProgram>& collect_force_kernels,
                                  DualStruct<DEMDataDT>& granData,
                                  const size_t nContactPairs,
                                  const size_t nClumps,
@@ -132,6 +132,41 @@ void getContactForcesConcerningOwners(float3* d_points,
                                       bool torque_in_local,
                                       cudaStream_t& this_stream);
 
+// Number of per-block partial results used in reducing the net contact wrench of numCnt contacts
+size_t getContactWrenchNumBlocks(size_t numCnt);
+
+// Net contact force and torque (about ref, in global frame) that a set of owners (sorted d_ownerIDs) feels, written to
+// d_wrench as 6 doubles. Contacts between two owners of this set are skipped. d_blockWrench needs
+// 6 * getContactWrenchNumBlocks(numCnt) doubles.
+void getContactWrenchConcerningOwners(double* d_wrench,
+                                      double* d_blockWrench,
+                                      bodyID_t* d_ownerIDs,
+                                      size_t IDListSize,
+                                      double3 ref,
+                                      DEMSimParams* simParams,
+                                      DEMDataDT* granData,
+                                      size_t numCnt,
+                                      cudaStream_t& this_stream);
+
+// Pack the requested states (SNAPSHOT_CONTENT flags) of the listed owners into d_out, record_len floats per owner. This
+// is only enqueued on this_stream, not synchronized.
+void gatherOwnerStates(float* d_out,
+                       const bodyID_t* d_ownerIDs,
+                       size_t n,
+                       unsigned int content,
+                       unsigned int record_len,
+                       DEMSimParams* simParams,
+                       DEMDataDT* granData,
+                       cudaStream_t& this_stream);
+
+// Write to d_out the magnitude of how much the acceleration of each of the n owners changed, compared to d_prevAcc
+// (n X components, then n Y, then n Z). This is only enqueued on this_stream, not synchronized.
+void computeOwnerAccJump(float* d_out,
+                         const float* d_prevAcc,
+                         size_t n,
+                         DEMDataDT* granData,
+                         cudaStream_t& this_stream);
+
 }  // namespace deme
 
 #endif
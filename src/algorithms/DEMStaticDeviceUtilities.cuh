@@ -38,6 +38,29 @@ void deviceAssign(T1* res, const T2* a, cudaStream_t& this_stream) {
     DEME_GPU_CALL(cudaStreamSynchronize(this_stream));
 }
 
+// Sum of n * (n - 1) / 2 over an array of group sizes n, i.e. the number of pairs formed within the groups
+template <typename T1>
+__global__ void sumPairsInGroups(unsigned long long* res, const T1* counts, size_t n) {
+    unsigned long long my_sum = 0;
+    for (size_t i = blockIdx.x * blockDim.x + threadIdx.x; i < n; i += (size_t)blockDim.x * gridDim.x) {
+        unsigned long long c = counts[i];
+        my_sum += (c > 1) ? c * (c - 1) / 2 : 0;
+    }
+    if (my_sum > 0)
+        atomicAdd(res, my_sum);
+}
+template <typename T1>
+void deviceSumPairsInGroups(size_t* res, const T1* counts, size_t n, cudaStream_t& this_stream) {
+    DEME_GPU_CALL(cudaMemsetAsync(res, 0, sizeof(size_t), this_stream));
+    if (n > 0) {
+        size_t blocks = (n + DEME_NUM_BODIES_PER_BLOCK - 1) / DEME_NUM_BODIES_PER_BLOCK;
+        blocks = (blocks > 1024) ? 1024 : blocks;
+        sumPairsInGroups<T1>
+            <<<blocks, DEME_NUM_BODIES_PER_BLOCK, 0, this_stream>>>((unsigned long long*)res, counts, n);
+    }
+    DEME_GPU_CALL(cudaStreamSynchronize(this_stream));
+}
+
 }  // namespace deme
 
 #endif
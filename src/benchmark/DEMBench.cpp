@@ -0,0 +1,649 @@
+//  Copyright (c) 2021, SBEL GPU Development Team
+//  Copyright (c) 2021, University of Wisconsin - Madison
+//
+//	SPDX-License-Identifier: BSD-3-Clause
+
+// =============================================================================
+// Host-side micro-benchmarks for I/O formatting and parsing, point samplers,
+// clump template preprocessing and the host sort/scan/merge helpers. Only host
+// code is timed, but the executable links the solver library, so it is built
+// with CUDA like the demos. Inputs are synthetic and seeded, so runs are
+// reproducible. Results are written as JSON, and can be compared against a
+// previous run with --compare, in which case the exit code is non-zero if
+// something regressed.
+//
+// Usage: deme_bench [--sizes 1000,100000,1000000] [--reps 5] [--filter str]
+//                   [--out results.json] [--compare baseline.json]
+//                   [--threshold 0.1] [--tmp dir] [--list]
+// =============================================================================
+
+#include <core/ApiVersion.h>
+#include <DEM/API.h>
+#include <DEM/HostSideHelpers.hpp>
+#include <DEM/OutputWriter.h>
+#include <DEM/utils/Samplers.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <numeric>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace deme;
+using namespace std::filesystem;
+
+namespace {
+
+const unsigned int BENCH_SEED = 20211;
+
+// What a benchmark case hands back after setup: reset (untimed) puts the input back into its initial state, run
+// (timed) does the work and returns the number of items it processed
+struct BenchRun {
+    std::function<void()> reset;
+    std::function<size_t()> run;
+};
+
+struct BenchCase {
+    std::string name;
+    std::string description;
+    // Sizes above this are skipped, for algorithms that would not finish in reasonable time otherwise
+    size_t max_n;
+    std::function<BenchRun(size_t n, const path& tmp_dir)> setup;
+};
+
+struct BenchResult {
+    std::string name;
+    size_t n = 0;
+    unsigned int reps = 0;
+    size_t items = 0;
+    double min_ms = 0.;
+    double median_ms = 0.;
+    double mean_ms = 0.;
+    double items_per_s = 0.;
+};
+
+// Results are consumed here, so the compiler cannot drop the benchmarked work
+volatile size_t bench_sink = 0;
+
+// Synthetic output frame with n clumps of 3 spheres each, spread in a box, using a simple voxel system
+void fillSyntheticFrame(OutputFrame& frame, size_t n) {
+    std::mt19937 gen(BENCH_SEED);
+    std::uniform_real_distribution<float> unit(0.f, 1.f);
+
+    frame.accuracy = 10;
+    frame.outFlags = OUTPUT_CONTENT::QUAT | OUTPUT_CONTENT::ABSV | OUTPUT_CONTENT::VEL | OUTPUT_CONTENT::ANG_VEL |
+                     OUTPUT_CONTENT::FAMILY;
+    frame.nvXp2 = 10;
+    frame.nvYp2 = 10;
+    frame.l = 1e-6;
+    frame.voxelSize = frame.l * (double)((size_t)1 << VOXEL_RES_POWER2);
+    frame.LBFX = frame.LBFY = frame.LBFZ = 0.f;
+    frame.useClumpJitify = false;
+    frame.templateNumNameMap[0] = "clump_0";
+    frame.templateNumNameMap[1] = "clump_1";
+
+    const size_t nvX = (size_t)1 << frame.nvXp2;
+    const size_t nvXY = nvX << frame.nvYp2;
+    frame.nOwners = n;
+    frame.voxelID.resize(n);
+    frame.locX.resize(n);
+    frame.locY.resize(n);
+    frame.locZ.resize(n);
+    frame.oriQw.assign(n, 1.f);
+    frame.oriQx.assign(n, 0.f);
+    frame.oriQy.assign(n, 0.f);
+    frame.oriQz.assign(n, 0.f);
+    for (auto* v : {&frame.vX, &frame.vY, &frame.vZ, &frame.omgBarX, &frame.omgBarY, &frame.omgBarZ, &frame.aX,
+                    &frame.aY, &frame.aZ, &frame.alphaX, &frame.alphaY, &frame.alphaZ}) {
+        v->resize(n);
+    }
+    frame.familyID.assign(n, 0);
+    frame.ownerTypes.assign(n, OWNER_T_CLUMP);
+    frame.inertiaPropOffsets.resize(n);
+    for (size_t i = 0; i < n; i++) {
+        frame.voxelID[i] = (voxelID_t)(i % nvX) + (voxelID_t)((i / nvX) % nvX) * nvX + (voxelID_t)(i / nvXY) * nvXY;
+        frame.locX[i] = (subVoxelPos_t)(unit(gen) * 60000.f);
+        frame.locY[i] = (subVoxelPos_t)(unit(gen) * 60000.f);
+        frame.locZ[i] = (subVoxelPos_t)(unit(gen) * 60000.f);
+        float4 Q = QuatFromAxisAngle(normalize(make_float3(unit(gen), unit(gen), unit(gen) + 0.1f)), unit(gen));
+        frame.oriQw[i] = Q.w;
+        frame.oriQx[i] = Q.x;
+        frame.oriQy[i] = Q.y;
+        frame.oriQz[i] = Q.z;
+        frame.vX[i] = unit(gen) - 0.5f;
+        frame.vY[i] = unit(gen) - 0.5f;
+        frame.vZ[i] = unit(gen) - 0.5f;
+        frame.omgBarX[i] = unit(gen);
+        frame.omgBarY[i] = unit(gen);
+        frame.omgBarZ[i] = unit(gen);
+        frame.inertiaPropOffsets[i] = (inertiaOffset_t)(i % 2);
+    }
+
+    const size_t nComp = 3;
+    frame.nSpheres = n * nComp;
+    frame.ownerClumpBody.resize(frame.nSpheres);
+    frame.radiiSphere.resize(frame.nSpheres);
+    frame.relPosSphereX.resize(frame.nSpheres);
+    frame.relPosSphereY.resize(frame.nSpheres);
+    frame.relPosSphereZ.resize(frame.nSpheres);
+    for (size_t i = 0; i < frame.nSpheres; i++) {
+        frame.ownerClumpBody[i] = (bodyID_t)(i / nComp);
+        frame.radiiSphere[i] = 0.005f + 0.005f * unit(gen);
+        frame.relPosSphereX[i] = 0.01f * (unit(gen) - 0.5f);
+        frame.relPosSphereY[i] = 0.01f * (unit(gen) - 0.5f);
+        frame.relPosSphereZ[i] = 0.01f * (unit(gen) - 0.5f);
+    }
+}
+
+// A square grid mesh of about n triangles, written as a Wavefront OBJ file
+void writeGridObj(const path& file, size_t n) {
+    const size_t m = std::max<size_t>(1, (size_t)std::sqrt((double)n / 2.));
+    std::ofstream out(file);
+    std::string buf;
+    for (size_t j = 0; j <= m; j++) {
+        for (size_t i = 0; i <= m; i++) {
+            buf += "v " + std::to_string((double)i / m) + " " + std::to_string((double)j / m) + " " +
+                   std::to_string(0.01 * std::sin((double)(i + j))) + "\n";
+        }
+        out << buf;
+        buf.clear();
+    }
+    for (size_t j = 0; j < m; j++) {
+        for (size_t i = 0; i < m; i++) {
+            // OBJ vertex numbers are 1-based
+            size_t v0 = j * (m + 1) + i + 1;
+            size_t v1 = v0 + 1, v2 = v0 + m + 1, v3 = v2 + 1;
+            buf += "f " + std::to_string(v0) + " " + std::to_string(v1) + " " + std::to_string(v3) + "\n";
+            buf += "f " + std::to_string(v0) + " " + std::to_string(v3) + " " + std::to_string(v2) + "\n";
+        }
+        out << buf;
+        buf.clear();
+    }
+}
+
+// Half-size of a cube box that holds about n points on a lattice of unit spacing, given the lattice's point density
+float boxHalfSizeForPoints(size_t n, double density) {
+    return (float)(0.5 * std::cbrt((double)n / density));
+}
+
+BenchRun samplerRun(std::function<std::vector<float3>(float)> sample, size_t n, double density) {
+    float h = boxHalfSizeForPoints(n, density);
+    return BenchRun{[]() {}, [sample, h]() { return sample(h).size(); }};
+}
+
+std::vector<BenchCase> allCases() {
+    std::vector<BenchCase> cases;
+
+    // I/O: formatting of sphere and clump output files, which is what the CSV writers spend their time on
+    cases.push_back({"format_spheres_csv", "formatSpheresAsCsv on n clumps of 3 spheres", SIZE_MAX,
+                     [](size_t n, const path&) {
+                         auto frame = std::make_shared<OutputFrame>();
+                         fillSyntheticFrame(*frame, n);
+                         return BenchRun{[]() {}, [frame]() {
+                                             std::ostringstream ss;
+                                             formatSpheresAsCsv(*frame, ss);
+                                             bench_sink = bench_sink + ss.str().size();
+                                             return frame->nSpheres;
+                                         }};
+                     }});
+    cases.push_back({"format_clumps_csv", "formatClumpsAsCsv on n clumps", SIZE_MAX, [](size_t n, const path&) {
+                         auto frame = std::make_shared<OutputFrame>();
+                         fillSyntheticFrame(*frame, n);
+                         return BenchRun{[]() {}, [frame]() {
+                                             std::ostringstream ss;
+                                             formatClumpsAsCsv(*frame, ss);
+                                             bench_sink = bench_sink + ss.str().size();
+                                             return frame->nOwners;
+                                         }};
+                     }});
+    // I/O: parsing a clump file written by this solver
+    cases.push_back({"read_clump_xyz_csv", "ReadClumpXyzFromCsv on a clump file of n rows", SIZE_MAX,
+                     [](size_t n, const path& tmp_dir) {
+                         OutputFrame frame;
+                         fillSyntheticFrame(frame, n);
+                         path file = tmp_dir / ("bench_clumps_" + std::to_string(n) + ".csv");
+                         {
+                             std::ofstream out(file);
+                             formatClumpsAsCsv(frame, out);
+                         }
+                         return BenchRun{[]() {}, [file]() {
+                                             auto xyz = DEMSolver::ReadClumpXyzFromCsv(file.string());
+                                             size_t rows = 0;
+                                             for (const auto& type_pos : xyz)
+                                                 rows += type_pos.second.size();
+                                             return rows;
+                                         }};
+                     }});
+    cases.push_back({"load_wavefront_obj", "LoadWavefrontMesh on a grid mesh of about n triangles", SIZE_MAX,
+                     [](size_t n, const path& tmp_dir) {
+                         path file = tmp_dir / ("bench_grid_" + std::to_string(n) + ".obj");
+                         writeGridObj(file, n);
+                         return BenchRun{[]() {}, [file]() {
+                                             DEMMeshConnected mesh;
+                                             mesh.LoadWavefrontMesh(file.string(), false);
+                                             return mesh.GetNumTriangles();
+                                         }};
+                     }});
+
+    // Samplers, each sized to produce about n points
+    cases.push_back({"grid_sampler", "GridSampler::SampleBox, about n points", SIZE_MAX, [](size_t n, const path&) {
+                         return samplerRun(
+                             [](float h) {
+                                 GridSampler sampler(1.f);
+                                 return sampler.SampleBox(make_float3(0), make_float3(h));
+                             },
+                             n, 1.);
+                     }});
+    cases.push_back({"hcp_sampler", "HCPSampler::SampleBox, about n points", SIZE_MAX, [](size_t n, const path&) {
+                         return samplerRun(
+                             [](float h) {
+                                 HCPSampler sampler(1.f);
+                                 return sampler.SampleBox(make_float3(0), make_float3(h));
+                             },
+                             n, std::sqrt(2.));
+                     }});
+    // The serial Poisson disk sampler scales worse than linearly, hence the size cap
+    cases.push_back({"pd_sampler", "PDSampler::SampleBox, about n points", 100000, [](size_t n, const path&) {
+                         return samplerRun(
+                             [](float h) {
+                                 PDSampler sampler(1.f);
+                                 sampler.SetRandomEngineSeed(BENCH_SEED);
+                                 return sampler.SampleBox(make_float3(0), make_float3(h));
+                             },
+                             n, 0.6);
+                     }});
+    cases.push_back({"pd_grid_sampler", "PDGridSampler::SampleBox, about n points", SIZE_MAX,
+                     [](size_t n, const path&) {
+                         return samplerRun(
+                             [](float h) {
+                                 PDGridSampler sampler(1.f);
+                                 sampler.SetRandomEngineSeed(BENCH_SEED);
+                                 return sampler.SampleBox(make_float3(0), make_float3(h));
+                             },
+                             n, 0.6);
+                     }});
+
+    // Clump template preprocessing. These are the steps of DEMSolver::preprocessClumpTemplates (sort by number of
+    // components, number--name map, flattening), which is private to the solver, whose construction needs a GPU.
+    cases.push_back({"clump_template_flatten", "Sort and flatten n clump templates of 1 to 8 spheres", SIZE_MAX,
+                     [](size_t n, const path&) {
+                         auto mat = std::make_shared<DEMMaterial>(std::unordered_map<std::string, float>{{"E", 1e9}});
+                         mat->load_order = 0;
+                         auto templates = std::make_shared<std::vector<std::shared_ptr<DEMClumpTemplate>>>();
+                         auto work = std::make_shared<std::vector<std::shared_ptr<DEMClumpTemplate>>>();
+                         std::mt19937 gen(BENCH_SEED);
+                         std::uniform_int_distribution<unsigned int> ncomp_dist(1, 8);
+                         for (size_t i = 0; i < n; i++) {
+                             auto clump = std::make_shared<DEMClumpTemplate>();
+                             clump->nComp = ncomp_dist(gen);
+                             clump->radii.assign(clump->nComp, 0.01f);
+                             clump->relPos.assign(clump->nComp, make_float3(0.005f));
+                             clump->materials.assign(clump->nComp, mat);
+                             clump->mass = 1.f;
+                             clump->MOI = make_float3(1e-4f);
+                             clump->volume = 1e-6f;
+                             clump->m_name = "clump_" + std::to_string(i);
+                             templates->push_back(clump);
+                         }
+                         return BenchRun{[templates, work]() {
+                                             *work = *templates;
+                                             for (unsigned int i = 0; i < work->size(); i++)
+                                                 (*work)[i]->mark = i;
+                                         },
+                                         [work]() {
+                                             std::sort(work->begin(), work->end(), [](auto& left, auto& right) {
+                                                 return left->nComp < right->nComp;
+                                             });
+                                             std::unordered_map<unsigned int, unsigned int> old_mark_to_new;
+                                             for (unsigned int i = 0; i < work->size(); i++) {
+                                                 old_mark_to_new[(*work)[i]->mark] = i;
+                                                 (*work)[i]->mark = i;
+                                             }
+                                             std::unordered_map<unsigned int, std::string> name_map;
+                                             for (const auto& clump : *work)
+                                                 name_map[clump->mark] = clump->m_name;
+
+                                             std::vector<float> mass, volume;
+                                             std::vector<float3> moi;
+                                             std::vector<std::vector<unsigned int>> mat_ids;
+                                             std::vector<std::vector<float>> radii;
+                                             std::vector<std::vector<float3>> rel_pos;
+                                             ClumpTemplateFlatten flat(mass, moi, mat_ids, radii, rel_pos, volume);
+                                             for (const auto& clump : *work) {
+                                                 flat.mass.push_back(clump->mass);
+                                                 flat.MOI.push_back(clump->MOI);
+                                                 flat.spRadii.push_back(clump->radii);
+                                                 flat.spRelPos.push_back(clump->relPos);
+                                                 flat.volume.push_back(clump->volume);
+                                                 std::vector<unsigned int> this_clump_sp_mat_ids;
+                                                 for (const auto& this_material : clump->materials)
+                                                     this_clump_sp_mat_ids.push_back(this_material->load_order);
+                                                 flat.matIDs.push_back(this_clump_sp_mat_ids);
+                                             }
+                                             bench_sink = bench_sink + old_mark_to_new.size() + name_map.size();
+                                             return flat.mass.size();
+                                         }};
+                     }});
+
+    // Host sort/scan/merge helpers
+    cases.push_back({"host_sort", "hostSort on n random 64-bit keys", SIZE_MAX, [](size_t n, const path&) {
+                         auto keys = std::make_shared<std::vector<uint64_t>>(n);
+                         std::mt19937_64 gen(BENCH_SEED);
+                         for (auto& k : *keys)
+                             k = gen();
+                         return BenchRun{[]() {}, [keys]() {
+                                             auto sorted = hostSort(*keys);
+                                             bench_sink = bench_sink + (size_t)sorted.front();
+                                             return sorted.size();
+                                         }};
+                     }});
+    cases.push_back({"host_sort_indices", "hostSortIndices on n random floats", SIZE_MAX, [](size_t n, const path&) {
+                         auto vals = std::make_shared<std::vector<float>>(n);
+                         std::mt19937 gen(BENCH_SEED);
+                         std::uniform_real_distribution<float> unit(0.f, 1.f);
+                         for (auto& v : *vals)
+                             v = unit(gen);
+                         return BenchRun{[]() {}, [vals]() {
+                                             auto idx = hostSortIndices(*vals);
+                                             bench_sink = bench_sink + idx.front();
+                                             return idx.size();
+                                         }};
+                     }});
+    // hostSortByKey is a bubble sort, hence the size cap
+    cases.push_back({"host_sort_by_key", "hostSortByKey on n random key--value pairs", 20000,
+                     [](size_t n, const path&) {
+                         auto src_keys = std::make_shared<std::vector<unsigned int>>(n);
+                         auto keys = std::make_shared<std::vector<unsigned int>>(n);
+                         auto vals = std::make_shared<std::vector<unsigned int>>(n);
+                         std::mt19937 gen(BENCH_SEED);
+                         for (auto& k : *src_keys)
+                             k = gen();
+                         return BenchRun{[src_keys, keys, vals]() {
+                                             *keys = *src_keys;
+                                             std::iota(vals->begin(), vals->end(), 0u);
+                                         },
+                                         [keys, vals]() {
+                                             hostSortByKey(keys->data(), vals->data(), keys->size());
+                                             bench_sink = bench_sink + vals->front();
+                                             return keys->size();
+                                         }};
+                     }});
+    cases.push_back({"host_prefix_scan", "hostPrefixScan on n small integers", SIZE_MAX, [](size_t n, const path&) {
+                         auto src = std::make_shared<std::vector<size_t>>(n);
+                         auto arr = std::make_shared<std::vector<size_t>>(n);
+                         std::mt19937 gen(BENCH_SEED);
+                         for (auto& v : *src)
+                             v = gen() % 16;
+                         return BenchRun{[src, arr]() { *arr = *src; },
+                                         [arr]() {
+                                             hostPrefixScan(arr->data(), arr->size());
+                                             bench_sink = bench_sink + arr->back();
+                                             return arr->size();
+                                         }};
+                     }});
+    cases.push_back({"host_merge_search_map_gen", "hostMergeSearchMapGen between two sorted arrays of n IDs", SIZE_MAX,
+                     [](size_t n, const path&) {
+                         // About half of the elements of arr1 can be found in arr2
+                         auto arr1 = std::make_shared<std::vector<size_t>>(n);
+                         auto arr2 = std::make_shared<std::vector<size_t>>(n);
+                         auto map = std::make_shared<std::vector<size_t>>(n);
+                         for (size_t i = 0; i < n; i++) {
+                             (*arr1)[i] = 2 * i;
+                             (*arr2)[i] = 3 * i;
+                         }
+                         return BenchRun{[]() {}, [arr1, arr2, map]() {
+                                             hostMergeSearchMapGen(arr1->data(), arr2->data(), map->data(),
+                                                                   arr1->size(), arr2->size(), (size_t)SIZE_MAX);
+                                             bench_sink = bench_sink + map->back();
+                                             return arr1->size();
+                                         }};
+                     }});
+    cases.push_back({"host_scan_for_jumps", "hostScanForJumpsNum + hostScanForJumps on n sorted IDs", SIZE_MAX,
+                     [](size_t n, const path&) {
+                         // Sorted bin IDs with runs of 1 to 8 elements
+                         auto arr = std::make_shared<std::vector<unsigned int>>(n);
+                         std::mt19937 gen(BENCH_SEED);
+                         unsigned int id = 0;
+                         for (size_t i = 0; i < n; i++) {
+                             if (gen() % 4 == 0)
+                                 id++;
+                             (*arr)[i] = id;
+                         }
+                         return BenchRun{[]() {}, [arr]() {
+                                             size_t n = arr->size(), found = 0;
+                                             hostScanForJumpsNum(arr->data(), n, 1, found);
+                                             std::vector<unsigned int> elem(found + 1);
+                                             std::vector<size_t> loc(found + 1);
+                                             std::vector<unsigned int> len(found + 1);
+                                             hostScanForJumps(arr->data(), elem.data(), loc.data(), len.data(), n, 1);
+                                             bench_sink = bench_sink + found;
+                                             return n;
+                                         }};
+                     }});
+    cases.push_back({"host_morton_order", "hostMortonOrder on n random points", SIZE_MAX, [](size_t n, const path&) {
+                         auto points = std::make_shared<std::vector<float3>>(n);
+                         std::mt19937 gen(BENCH_SEED);
+                         std::uniform_real_distribution<float> unit(-1.f, 1.f);
+                         for (auto& p : *points)
+                             p = make_float3(unit(gen), unit(gen), unit(gen));
+                         return BenchRun{[]() {}, [points]() {
+                                             auto order = hostMortonOrder(*points);
+                                             bench_sink = bench_sink + order.front();
+                                             return order.size();
+                                         }};
+                     }});
+
+    return cases;
+}
+
+BenchResult runCase(const BenchCase& bench, size_t n, unsigned int reps, const path& tmp_dir) {
+    BenchResult res;
+    res.name = bench.name;
+    res.n = n;
+    res.reps = reps;
+    BenchRun run = bench.setup(n, tmp_dir);
+
+    // One warm-up run, then the timed ones
+    run.reset();
+    run.run();
+    std::vector<double> times;
+    for (unsigned int r = 0; r < reps; r++) {
+        run.reset();
+        auto start = std::chrono::steady_clock::now();
+        res.items = run.run();
+        auto end = std::chrono::steady_clock::now();
+        times.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+    }
+    std::sort(times.begin(), times.end());
+    res.min_ms = times.front();
+    res.median_ms = (reps % 2) ? times[reps / 2] : 0.5 * (times[reps / 2 - 1] + times[reps / 2]);
+    res.mean_ms = vector_sum(times) / reps;
+    res.items_per_s = (res.min_ms > 0.) ? (double)res.items / (res.min_ms * 1e-3) : 0.;
+    return res;
+}
+
+// One result per line, so the compare mode can read result files back line by line
+void writeJson(std::ostream& out, const std::vector<BenchResult>& results, unsigned int reps) {
+    char buf[512];
+    out << "{\n";
+    out << "  \"suite\": \"deme_bench\",\n";
+    out << "  \"version\": \"" << DEME_VERSION_MAJOR << "." << DEME_VERSION_MINOR << "." << DEME_VERSION_PATCH
+        << "\",\n";
+    out << "  \"seed\": " << BENCH_SEED << ",\n";
+    out << "  \"reps\": " << reps << ",\n";
+    out << "  \"results\": [\n";
+    for (size_t i = 0; i < results.size(); i++) {
+        const auto& r = results[i];
+        snprintf(buf, sizeof(buf),
+                 "    {\"name\": \"%s\", \"n\": %zu, \"items\": %zu, \"reps\": %u, \"min_ms\": %.6f, \"median_ms\": "
+                 "%.6f, \"mean_ms\": %.6f, \"items_per_s\": %.6e}%s\n",
+                 r.name.c_str(), r.n, r.items, r.reps, r.min_ms, r.median_ms, r.mean_ms, r.items_per_s,
+                 (i + 1 < results.size()) ? "," : "");
+        out << buf;
+    }
+    out << "  ]\n}\n";
+}
+
+// Value of "key" in one JSON result line, as a string
+bool jsonField(const std::string& line, const std::string& key, std::string& value) {
+    size_t pos = line.find("\"" + key + "\":");
+    if (pos == std::string::npos)
+        return false;
+    pos += key.size() + 3;
+    while (pos < line.size() && line[pos] == ' ')
+        pos++;
+    if (pos < line.size() && line[pos] == '"') {
+        size_t end = line.find('"', pos + 1);
+        value = line.substr(pos + 1, end - pos - 1);
+    } else {
+        size_t end = line.find_first_of(",}", pos);
+        value = line.substr(pos, end - pos);
+    }
+    return true;
+}
+
+// Read the median time of each (name, n) pair in a result file written by writeJson
+std::map<std::pair<std::string, size_t>, double> readBaseline(const std::string& file) {
+    std::map<std::pair<std::string, size_t>, double> baseline;
+    std::ifstream in(file);
+    if (!in) {
+        throw std::runtime_error("Could not open baseline file " + file);
+    }
+    std::string line, name, n, median;
+    while (std::getline(in, line)) {
+        if (jsonField(line, "name", name) && jsonField(line, "n", n) && jsonField(line, "median_ms", median)) {
+            baseline[{name, std::stoull(n)}] = std::stod(median);
+        }
+    }
+    return baseline;
+}
+
+// Print a comparison table and return the number of regressions, which are results whose median time is more than
+// (1 + threshold) times the baseline's
+unsigned int compareToBaseline(const std::vector<BenchResult>& results,
+                               const std::map<std::pair<std::string, size_t>, double>& baseline,
+                               double threshold) {
+    unsigned int regressions = 0;
+    fprintf(stderr, "%-28s %10s %14s %14s %9s\n", "benchmark", "n", "baseline(ms)", "current(ms)", "ratio");
+    for (const auto& r : results) {
+        auto it = baseline.find({r.name, r.n});
+        if (it == baseline.end()) {
+            fprintf(stderr, "%-28s %10zu %14s %14.3f %9s\n", r.name.c_str(), r.n, "-", r.median_ms, "new");
+            continue;
+        }
+        double ratio = (it->second > 0.) ? r.median_ms / it->second : 1.;
+        bool regressed = ratio > 1. + threshold;
+        if (regressed)
+            regressions++;
+        fprintf(stderr, "%-28s %10zu %14.3f %14.3f %8.3fx%s\n", r.name.c_str(), r.n, it->second, r.median_ms, ratio,
+                regressed ? "  REGRESSION" : "");
+    }
+    return regressions;
+}
+
+std::vector<size_t> parseSizes(const std::string& str) {
+    std::vector<size_t> sizes;
+    std::stringstream ss(str);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        if (!is_all_spaces(item))
+            sizes.push_back((size_t)std::stod(item));
+    }
+    return sizes;
+}
+
+void printUsage() {
+    std::cout << "Usage: deme_bench [--sizes 1000,100000,1000000] [--reps 5] [--filter str] [--out results.json]\n"
+                 "                  [--compare baseline.json] [--threshold 0.1] [--tmp dir] [--list]\n";
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    std::vector<size_t> sizes = {1000, 100000, 1000000};
+    unsigned int reps = 5;
+    std::string filter, out_file, baseline_file;
+    double threshold = 0.1;
+    path tmp_dir = temp_directory_path() / "deme_bench";
+    bool list_only = false;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        auto next = [&]() -> std::string {
+            if (i + 1 >= argc) {
+                std::cerr << "Missing value for " << arg << std::endl;
+                exit(2);
+            }
+            return argv[++i];
+        };
+        if (arg == "--sizes") {
+            sizes = parseSizes(next());
+        } else if (arg == "--reps") {
+            reps = std::max(1, std::stoi(next()));
+        } else if (arg == "--filter") {
+            filter = next();
+        } else if (arg == "--out") {
+            out_file = next();
+        } else if (arg == "--compare") {
+            baseline_file = next();
+        } else if (arg == "--threshold") {
+            threshold = std::stod(next());
+        } else if (arg == "--tmp") {
+            tmp_dir = next();
+        } else if (arg == "--list") {
+            list_only = true;
+        } else {
+            printUsage();
+            return (arg == "--help" || arg == "-h") ? 0 : 2;
+        }
+    }
+
+    auto cases = allCases();
+    if (list_only) {
+        for (const auto& bench : cases)
+            std::cout << bench.name << ": " << bench.description << std::endl;
+        return 0;
+    }
+    create_directories(tmp_dir);
+
+    std::vector<BenchResult> results;
+    for (const auto& bench : cases) {
+        if (!filter.empty() && bench.name.find(filter) == std::string::npos)
+            continue;
+        for (size_t n : sizes) {
+            if (n > bench.max_n) {
+                fprintf(stderr, "%-28s %10zu skipped (size cap %zu)\n", bench.name.c_str(), n, bench.max_n);
+                continue;
+            }
+            results.push_back(runCase(bench, n, reps, tmp_dir));
+            const auto& r = results.back();
+            fprintf(stderr, "%-28s %10zu %12.3f ms (median) %12.3e items/s\n", r.name.c_str(), r.n, r.median_ms,
+                    r.items_per_s);
+        }
+    }
+
+    if (out_file.empty()) {
+        writeJson(std::cout, results, reps);
+    } else {
+        std::ofstream out(out_file);
+        writeJson(out, results, reps);
+    }
+
+    if (!baseline_file.empty()) {
+        unsigned int regressions = compareToBaseline(results, readBaseline(baseline_file), threshold);
+        if (regressions > 0) {
+            fprintf(stderr, "%u benchmark(s) regressed by more than %.1f%%\n", regressions, threshold * 100.);
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,474 @@
+//  Copyright (c) 2021, SBEL GPU Development Team
+//  Copyright (c) 2021, University of Wisconsin - Madison
+//
+//	SPDX-License-Identifier: BSD-3-Clause
+
+// A small, self-describing, column-oriented binary container used by DEME's OUTPUT_FORMAT::BINARY output files.
+//
+// Layout (all integers and floating-point values are little-endian):
+//   char[8]  magic "DEMECOL\0"
+//   uint32   format version
+//   uint32   number of columns
+//   uint64   number of rows
+//   Then, for each column:
+//     uint32   name length, followed by the name bytes (no terminator)
+//     uint8    data type tag (see BINARY_COLUMN_TYPE)
+//     uint64   absolute byte offset of the column data in this file (8-byte aligned)
+//     uint64   byte size of the column data
+//     For STRING_DICT columns only: uint32 dictionary size, then per entry a uint32 length and the string bytes
+//   Then the column data blocks, each one contiguous and 8-byte aligned. A STRING_DICT column stores one uint32 code
+//   per row, indexing into its dictionary.
+
+#ifndef DEME_COLUMNAR_BINARY_HPP
+#define DEME_COLUMNAR_BINARY_HPP
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <core/utils/MappedFile.hpp>
+
+namespace deme {
+
+/// Type tags of columns in a DEME columnar binary file.
+enum class BINARY_COLUMN_TYPE : uint8_t {
+    INT8 = 1,
+    UINT8 = 2,
+    INT16 = 3,
+    UINT16 = 4,
+    INT32 = 5,
+    UINT32 = 6,
+    INT64 = 7,
+    UINT64 = 8,
+    FLOAT32 = 9,
+    FLOAT64 = 10,
+    STRING_DICT = 11
+};
+
+const char BINARY_COLUMN_FILE_MAGIC[8] = {'D', 'E', 'M', 'E', 'C', 'O', 'L', '\0'};
+const uint32_t BINARY_COLUMN_FILE_VERSION = 1;
+
+template <typename T>
+struct BinaryColumnTypeOf;
+#define DEME_BINARY_COLUMN_TYPE_OF(cpp_type, tag)                            \
+    template <>                                                              \
+    struct BinaryColumnTypeOf<cpp_type> {                                    \
+        static constexpr BINARY_COLUMN_TYPE value = BINARY_COLUMN_TYPE::tag; \
+    };
+DEME_BINARY_COLUMN_TYPE_OF(int8_t, INT8)
+DEME_BINARY_COLUMN_TYPE_OF(uint8_t, UINT8)
+DEME_BINARY_COLUMN_TYPE_OF(int16_t, INT16)
+DEME_BINARY_COLUMN_TYPE_OF(uint16_t, UINT16)
+DEME_BINARY_COLUMN_TYPE_OF(int32_t, INT32)
+DEME_BINARY_COLUMN_TYPE_OF(uint32_t, UINT32)
+DEME_BINARY_COLUMN_TYPE_OF(int64_t, INT64)
+DEME_BINARY_COLUMN_TYPE_OF(uint64_t, UINT64)
+DEME_BINARY_COLUMN_TYPE_OF(float, FLOAT32)
+DEME_BINARY_COLUMN_TYPE_OF(double, FLOAT64)
+#undef DEME_BINARY_COLUMN_TYPE_OF
+
+inline size_t binaryColumnTypeSize(BINARY_COLUMN_TYPE type) {
+    switch (type) {
+        case BINARY_COLUMN_TYPE::INT8:
+        case BINARY_COLUMN_TYPE::UINT8:
+            return 1;
+        case BINARY_COLUMN_TYPE::INT16:
+        case BINARY_COLUMN_TYPE::UINT16:
+            return 2;
+        case BINARY_COLUMN_TYPE::INT32:
+        case BINARY_COLUMN_TYPE::UINT32:
+        case BINARY_COLUMN_TYPE::FLOAT32:
+        case BINARY_COLUMN_TYPE::STRING_DICT:
+            return 4;
+        case BINARY_COLUMN_TYPE::INT64:
+        case BINARY_COLUMN_TYPE::UINT64:
+        case BINARY_COLUMN_TYPE::FLOAT64:
+            return 8;
+    }
+    throw std::runtime_error("Unknown binary column type tag " + std::to_string((unsigned int)type));
+}
+
+inline bool hostIsLittleEndian() {
+    const uint16_t probe = 1;
+    uint8_t first_byte;
+    std::memcpy(&first_byte, &probe, 1);
+    return first_byte == 1;
+}
+
+// Reverse the bytes of each element of size elem_size in a buffer (used only on big-endian hosts)
+inline void byteSwapElements(char* data, size_t n_elem, size_t elem_size) {
+    if (elem_size <= 1)
+        return;
+    for (size_t i = 0; i < n_elem; i++) {
+        char* e = data + i * elem_size;
+        for (size_t lo = 0, hi = elem_size - 1; lo < hi; lo++, hi--) {
+            std::swap(e[lo], e[hi]);
+        }
+    }
+}
+
+/// Collects equal-length columns and writes them as a DEME columnar binary file.
+class ColumnarBinaryWriter {
+  public:
+    explicit ColumnarBinaryWriter(size_t n_rows) : m_n_rows(n_rows) {}
+
+    /// Add a numeric column. The data is moved in, so the caller's buffer can be handed over without copying.
+    template <typename T>
+    void AddColumn(const std::string& name, std::vector<T>&& data) {
+        static_assert(std::is_arithmetic<T>::value, "Binary columns must be of arithmetic types.");
+        checkSize(name, data.size());
+        Column col;
+        col.name = name;
+        col.type = BinaryColumnTypeOf<T>::value;
+        if (data.size() > 0) {
+            auto owned = std::make_shared<std::vector<T>>(std::move(data));
+            col.ext_data = reinterpret_cast<const char*>(owned->data());
+            col.ext_size = owned->size() * sizeof(T);
+            col.owned = std::move(owned);
+        }
+        m_cols.push_back(std::move(col));
+    }
+    /// Add a numeric column. The data is copied once.
+    template <typename T>
+    void AddColumn(const std::string& name, const std::vector<T>& data) {
+        static_assert(std::is_arithmetic<T>::value, "Binary columns must be of arithmetic types.");
+        checkSize(name, data.size());
+        Column col;
+        col.name = name;
+        col.type = BinaryColumnTypeOf<T>::value;
+        col.bytes.resize(data.size() * sizeof(T));
+        if (data.size() > 0)
+            std::memcpy(col.bytes.data(), data.data(), col.bytes.size());
+        m_cols.push_back(std::move(col));
+    }
+    /// Add a numeric column that refers to the caller's memory instead of copying it. It must stay valid until Write.
+    template <typename T>
+    void AddColumnView(const std::string& name, const T* data, size_t n) {
+        static_assert(std::is_arithmetic<T>::value, "Binary columns must be of arithmetic types.");
+        checkSize(name, n);
+        Column col;
+        col.name = name;
+        col.type = BinaryColumnTypeOf<T>::value;
+        col.ext_data = reinterpret_cast<const char*>(data);
+        col.ext_size = n * sizeof(T);
+        m_cols.push_back(std::move(col));
+    }
+
+    /// Add a string column that is already dictionary-encoded: codes[i] indexes into dict.
+    void AddStringCodeColumn(const std::string& name, std::vector<uint32_t> codes, std::vector<std::string> dict) {
+        checkSize(name, codes.size());
+        Column col;
+        col.name = name;
+        col.type = BINARY_COLUMN_TYPE::STRING_DICT;
+        col.dict = std::move(dict);
+        col.bytes.resize(codes.size() * sizeof(uint32_t));
+        if (codes.size() > 0)
+            std::memcpy(col.bytes.data(), codes.data(), col.bytes.size());
+        m_cols.push_back(std::move(col));
+    }
+
+    /// Add a string column. It is stored dictionary-encoded: one uint32 code per row plus the unique strings.
+    void AddStringColumn(const std::string& name, const std::vector<std::string>& data) {
+        checkSize(name, data.size());
+        Column col;
+        col.name = name;
+        col.type = BINARY_COLUMN_TYPE::STRING_DICT;
+        std::unordered_map<std::string, uint32_t> lookup;
+        std::vector<uint32_t> codes(data.size());
+        for (size_t i = 0; i < data.size(); i++) {
+            auto it = lookup.find(data[i]);
+            if (it == lookup.end()) {
+                it = lookup.emplace(data[i], (uint32_t)col.dict.size()).first;
+                col.dict.push_back(data[i]);
+            }
+            codes[i] = it->second;
+        }
+        col.bytes.resize(codes.size() * sizeof(uint32_t));
+        if (codes.size() > 0)
+            std::memcpy(col.bytes.data(), codes.data(), col.bytes.size());
+        m_cols.push_back(std::move(col));
+    }
+
+    size_t NumRows() const { return m_n_rows; }
+    size_t NumColumns() const { return m_cols.size(); }
+
+    /// Write the whole file to a stream (which should be opened in binary mode).
+    void Write(std::ostream& out) const {
+        const bool swap = !hostIsLittleEndian();
+        // First figure out the header size so the data offsets can be recorded in the column descriptors
+        uint64_t header_size = sizeof(BINARY_COLUMN_FILE_MAGIC) + sizeof(uint32_t) * 2 + sizeof(uint64_t);
+        for (const auto& col : m_cols) {
+            header_size += sizeof(uint32_t) + col.name.size() + sizeof(uint8_t) + sizeof(uint64_t) * 2;
+            if (col.type == BINARY_COLUMN_TYPE::STRING_DICT) {
+                header_size += sizeof(uint32_t);
+                for (const auto& str : col.dict)
+                    header_size += sizeof(uint32_t) + str.size();
+            }
+        }
+        std::vector<uint64_t> offsets(m_cols.size());
+        uint64_t cursor = alignUp(header_size);
+        for (size_t i = 0; i < m_cols.size(); i++) {
+            offsets[i] = cursor;
+            cursor = alignUp(cursor + m_cols[i].dataSize());
+        }
+
+        out.write(BINARY_COLUMN_FILE_MAGIC, sizeof(BINARY_COLUMN_FILE_MAGIC));
+        writeScalar<uint32_t>(out, BINARY_COLUMN_FILE_VERSION, swap);
+        writeScalar<uint32_t>(out, (uint32_t)m_cols.size(), swap);
+        writeScalar<uint64_t>(out, (uint64_t)m_n_rows, swap);
+        for (size_t i = 0; i < m_cols.size(); i++) {
+            const auto& col = m_cols[i];
+            writeScalar<uint32_t>(out, (uint32_t)col.name.size(), swap);
+            out.write(col.name.data(), col.name.size());
+            writeScalar<uint8_t>(out, (uint8_t)col.type, swap);
+            writeScalar<uint64_t>(out, offsets[i], swap);
+            writeScalar<uint64_t>(out, (uint64_t)col.dataSize(), swap);
+            if (col.type == BINARY_COLUMN_TYPE::STRING_DICT) {
+                writeScalar<uint32_t>(out, (uint32_t)col.dict.size(), swap);
+                for (const auto& str : col.dict) {
+                    writeScalar<uint32_t>(out, (uint32_t)str.size(), swap);
+                    out.write(str.data(), str.size());
+                }
+            }
+        }
+
+        uint64_t written = header_size;
+        std::vector<char> swapped;
+        for (size_t i = 0; i < m_cols.size(); i++) {
+            writePadding(out, offsets[i] - written);
+            const auto& col = m_cols[i];
+            if (swap) {
+                swapped.assign(col.dataPtr(), col.dataPtr() + col.dataSize());
+                size_t elem_size = binaryColumnTypeSize(col.type);
+                byteSwapElements(swapped.data(), swapped.size() / elem_size, elem_size);
+                out.write(swapped.data(), swapped.size());
+            } else {
+                out.write(col.dataPtr(), col.dataSize());
+            }
+            written = offsets[i] + col.dataSize();
+        }
+        writePadding(out, alignUp(written) - written);
+    }
+
+  private:
+    struct Column {
+        std::string name;
+        BINARY_COLUMN_TYPE type;
+        std::vector<char> bytes;
+        std::vector<std::string> dict;
+        // Set for columns added as views or moved in, in which case bytes is unused
+        const char* ext_data = nullptr;
+        size_t ext_size = 0;
+        // Keeps a moved-in vector alive; ext_data points into it
+        std::shared_ptr<const void> owned;
+
+        const char* dataPtr() const { return ext_data ? ext_data : bytes.data(); }
+        size_t dataSize() const { return ext_data ? ext_size : bytes.size(); }
+    };
+
+    size_t m_n_rows;
+    std::vector<Column> m_cols;
+
+    void checkSize(const std::string& name, size_t n) const {
+        if (n != m_n_rows) {
+            throw std::runtime_error("Binary column " + name + " has " + std::to_string(n) + " rows, but " +
+                                     std::to_string(m_n_rows) + " were expected.");
+        }
+    }
+    static uint64_t alignUp(uint64_t n) { return (n + 7) & ~uint64_t(7); }
+    static void writePadding(std::ostream& out, uint64_t n) {
+        const char zeros[8] = {0};
+        out.write(zeros, n);
+    }
+    template <typename T>
+    static void writeScalar(std::ostream& out, T val, bool swap) {
+        char buf[sizeof(T)];
+        std::memcpy(buf, &val, sizeof(T));
+        if (swap)
+            byteSwapElements(buf, 1, sizeof(T));
+        out.write(buf, sizeof(T));
+    }
+};
+
+/// Memory-maps a DEME columnar binary file and gives typed access to its columns. On little-endian hosts, column data
+/// is used in place (GetView); Get makes an owning copy.
+class ColumnarBinaryReader {
+  public:
+    /// A non-owning view into a column of the mapped file. It is valid as long as the reader is alive.
+    template <typename T>
+    struct View {
+        const T* data = nullptr;
+        size_t size = 0;
+        const T& operator[](size_t i) const { return data[i]; }
+        const T* begin() const { return data; }
+        const T* end() const { return data + size; }
+    };
+
+    explicit ColumnarBinaryReader(const std::string& filename)
+        : m_filename(filename), m_file(filename), m_data(m_file.data()), m_file_size(m_file.size()) {
+        parseHeader();
+    }
+    ColumnarBinaryReader(const ColumnarBinaryReader&) = delete;
+    ColumnarBinaryReader& operator=(const ColumnarBinaryReader&) = delete;
+
+    size_t NumRows() const { return m_n_rows; }
+    std::vector<std::string> GetColumnNames() const {
+        std::vector<std::string> names;
+        for (const auto& col : m_cols)
+            names.push_back(col.name);
+        return names;
+    }
+    bool HasColumn(const std::string& name) const { return m_name_to_col.count(name) > 0; }
+    BINARY_COLUMN_TYPE GetColumnType(const std::string& name) const { return findColumn(name).type; }
+
+    /// Zero-copy view of a numeric column. T must match the stored type exactly.
+    template <typename T>
+    View<T> GetView(const std::string& name) const {
+        const Column& col = findTypedColumn(name, BinaryColumnTypeOf<T>::value);
+        if (m_swap) {
+            throw std::runtime_error("Zero-copy view of binary column " + name +
+                                     " is not available on big-endian hosts, use Get instead.");
+        }
+        View<T> view;
+        view.data = reinterpret_cast<const T*>(m_data + col.offset);
+        view.size = m_n_rows;
+        return view;
+    }
+
+    /// Owning copy of a numeric column. T must match the stored type exactly.
+    template <typename T>
+    std::vector<T> Get(const std::string& name) const {
+        const Column& col = findTypedColumn(name, BinaryColumnTypeOf<T>::value);
+        std::vector<T> res(m_n_rows);
+        if (m_n_rows > 0)
+            std::memcpy(res.data(), m_data + col.offset, m_n_rows * sizeof(T));
+        if (m_swap)
+            byteSwapElements(reinterpret_cast<char*>(res.data()), m_n_rows, sizeof(T));
+        return res;
+    }
+
+    /// Dictionary codes of a string column, one per row.
+    std::vector<uint32_t> GetStringCodes(const std::string& name) const {
+        const Column& col = findTypedColumn(name, BINARY_COLUMN_TYPE::STRING_DICT);
+        std::vector<uint32_t> res(m_n_rows);
+        if (m_n_rows > 0)
+            std::memcpy(res.data(), m_data + col.offset, m_n_rows * sizeof(uint32_t));
+        if (m_swap)
+            byteSwapElements(reinterpret_cast<char*>(res.data()), m_n_rows, sizeof(uint32_t));
+        return res;
+    }
+    /// The unique strings a string column's codes index into.
+    const std::vector<std::string>& GetStringDictionary(const std::string& name) const {
+        return findTypedColumn(name, BINARY_COLUMN_TYPE::STRING_DICT).dict;
+    }
+    /// Decoded string column.
+    std::vector<std::string> GetStrings(const std::string& name) const {
+        const auto& dict = GetStringDictionary(name);
+        std::vector<uint32_t> codes = GetStringCodes(name);
+        std::vector<std::string> res(m_n_rows);
+        for (size_t i = 0; i < m_n_rows; i++)
+            res[i] = dict.at(codes[i]);
+        return res;
+    }
+
+  private:
+    struct Column {
+        std::string name;
+        BINARY_COLUMN_TYPE type;
+        uint64_t offset;
+        uint64_t n_bytes;
+        std::vector<std::string> dict;
+    };
+
+    std::string m_filename;
+    MappedFile m_file;
+    const char* m_data;
+    size_t m_file_size;
+    bool m_swap = false;
+    size_t m_n_rows = 0;
+    std::vector<Column> m_cols;
+    std::unordered_map<std::string, size_t> m_name_to_col;
+
+    template <typename T>
+    T readScalar(size_t& cursor) const {
+        if (cursor + sizeof(T) > m_file_size)
+            throw std::runtime_error("Binary file " + m_filename + " is truncated.");
+        T val;
+        std::memcpy(&val, m_data + cursor, sizeof(T));
+        if (m_swap)
+            byteSwapElements(reinterpret_cast<char*>(&val), 1, sizeof(T));
+        cursor += sizeof(T);
+        return val;
+    }
+    std::string readString(size_t& cursor) const {
+        uint32_t len = readScalar<uint32_t>(cursor);
+        if (cursor + len > m_file_size)
+            throw std::runtime_error("Binary file " + m_filename + " is truncated.");
+        std::string str(m_data + cursor, len);
+        cursor += len;
+        return str;
+    }
+
+    void parseHeader() {
+        if (m_file_size < sizeof(BINARY_COLUMN_FILE_MAGIC) ||
+            std::memcmp(m_data, BINARY_COLUMN_FILE_MAGIC, sizeof(BINARY_COLUMN_FILE_MAGIC)) != 0) {
+            throw std::runtime_error(m_filename + " is not a DEME columnar binary file.");
+        }
+        m_swap = !hostIsLittleEndian();
+        size_t cursor = sizeof(BINARY_COLUMN_FILE_MAGIC);
+        uint32_t version = readScalar<uint32_t>(cursor);
+        if (version > BINARY_COLUMN_FILE_VERSION) {
+            throw std::runtime_error(m_filename + " has binary format version " + std::to_string(version) +
+                                     ", newer than the supported version " +
+                                     std::to_string(BINARY_COLUMN_FILE_VERSION) + ".");
+        }
+        uint32_t n_cols = readScalar<uint32_t>(cursor);
+        m_n_rows = (size_t)readScalar<uint64_t>(cursor);
+        m_cols.resize(n_cols);
+        for (uint32_t i = 0; i < n_cols; i++) {
+            Column& col = m_cols[i];
+            col.name = readString(cursor);
+            col.type = (BINARY_COLUMN_TYPE)readScalar<uint8_t>(cursor);
+            col.offset = readScalar<uint64_t>(cursor);
+            col.n_bytes = readScalar<uint64_t>(cursor);
+            if (col.type == BINARY_COLUMN_TYPE::STRING_DICT) {
+                uint32_t dict_size = readScalar<uint32_t>(cursor);
+                col.dict.resize(dict_size);
+                for (uint32_t j = 0; j < dict_size; j++)
+                    col.dict[j] = readString(cursor);
+            }
+            if (col.n_bytes != m_n_rows * binaryColumnTypeSize(col.type) || col.offset + col.n_bytes > m_file_size) {
+                throw std::runtime_error("Column " + col.name + " in binary file " + m_filename + " is corrupted.");
+            }
+            m_name_to_col[col.name] = i;
+        }
+    }
+
+    const Column& findColumn(const std::string& name) const {
+        auto it = m_name_to_col.find(name);
+        if (it == m_name_to_col.end())
+            throw std::runtime_error("Column " + name + " is not found in binary file " + m_filename);
+        return m_cols[it->second];
+    }
+    const Column& findTypedColumn(const std::string& name, BINARY_COLUMN_TYPE type) const {
+        const Column& col = findColumn(name);
+        if (col.type != type) {
+            throw std::runtime_error("Column " + name + " in binary file " + m_filename + " has type tag " +
+                                     std::to_string((unsigned int)col.type) + ", but type tag " +
+                                     std::to_string((unsigned int)type) + " was requested.");
+        }
+        return col;
+    }
+};
+
+}  // namespace deme
+
+#endif
@@ -283,6 +283,25 @@ class DualArray : private NonCopyable {
         m_device_capacity = n;
     }
 
+    // Make room for n elements on both host and device without changing size(), so growing up to n later does not
+    // reallocate. Existing device data are preserved.
+    void reserve(size_t n) {
+        ensureHostVector();
+        m_host_vec_ptr->reserve(n);
+        resizeDevice(n);
+    }
+
+    // Number of elements the array can hold before it has to reallocate
+    size_t capacity() const { return m_device_capacity; }
+
+    // Release the memory held beyond size(), on both host and device. Device data within size() are preserved.
+    void shrinkToFit() {
+        assert(m_host_vec_ptr == m_pinned_vec.get() && "shrinkToFit() requires internal host ownership");
+        m_host_vec_ptr->shrink_to_fit();
+        if (m_device_capacity > size())
+            resizeDevice(size(), true);
+    }
+
     void freeHost() {
         if (m_host_vec_ptr) {
             updateHostMemCounter(-(ssize_t)(m_host_vec_ptr->size() * sizeof(T)));
@@ -542,6 +561,23 @@ class DualArray : private NonCopyable {
     // m_device_capacity is allocated memory, not array usable data range
     void resizeDevice(size_t n, bool allow_shrink = false) {}
 
+    // Make room for n elements without changing size(), so growing up to n later does not reallocate
+    void reserve(size_t n) {
+        ensureHostVector();
+        m_host_vec_ptr->reserve(n);
+        updateBoundDevicePointer();
+    }
+
+    // Number of elements the array can hold before it has to reallocate
+    size_t capacity() const { return m_host_vec_ptr ? m_host_vec_ptr->capacity() : 0; }
+
+    // Release the memory held beyond size()
+    void shrinkToFit() {
+        assert(m_host_vec_ptr == m_pinned_vec.get() && "shrinkToFit() requires internal host ownership");
+        m_host_vec_ptr->shrink_to_fit();
+        updateBoundDevicePointer();
+    }
+
     void freeHost() {
         if (m_host_vec_ptr) {
             updateMemCounter(-(ssize_t)(m_host_vec_ptr->size() * sizeof(T)));
@@ -662,6 +698,26 @@ class DualArray : private NonCopyable {
 };
 #endif
 
+// Rearrange the first order.size() host-side elements of a DualArray, so that element i becomes what used to be element
+// order[i]. Only the host copy is touched; sending it to device is up to the caller.
+template <typename T, typename IndexT>
+inline void permuteHostElements(DualArray<T>& arr, const std::vector<IndexT>& order) {
+    std::vector<T> old(arr.host(), arr.host() + order.size());
+    for (size_t i = 0; i < order.size(); i++) {
+        arr[i] = old[order[i]];
+    }
+}
+
+// Keep only the host-side elements listed in keep, in that order (element i becomes what used to be element keep[i]),
+// then shrink the array to keep.size() elements and release the memory beyond that. Sending the host copy to device is
+// up to the caller.
+template <typename T, typename IndexT>
+inline void compactHostElements(DualArray<T>& arr, const std::vector<IndexT>& keep) {
+    permuteHostElements(arr, keep);
+    arr.resizeHost(keep.size());
+    arr.shrinkToFit();
+}
+
 // Pure device data type, usually used for scratching space
 template <typename T>
 class DeviceArray : private NonCopyable {
@@ -3,20 +3,169 @@
 //
 //	SPDX-License-Identifier: BSD-3-Clause
 
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
 #include <fstream>
 #include <filesystem>
+#include <sstream>
 #include <string>
 #include <regex>
 
+#ifndef _WIN32
+    #include <fcntl.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#else
+    #include <process.h>
+#endif
+
+#include <cuda_runtime_api.h>
+
 #include <core/ApiVersion.h>
+#include <core/utils/GpuError.h>
 #include <core/utils/RuntimeData.h>
 #include <core/utils/JitHelper.h>
 
-jitify::JitCache JitHelper::kcache;
-
 const std::filesystem::path JitHelper::KERNEL_DIR = RuntimeDataHelper::data_path / "kernel";
 const std::filesystem::path JitHelper::KERNEL_INCLUDE_DIR = RuntimeDataHelper::include_path;
 
+namespace {
+
+// Disk cache settings and counters, shared by all programs in this process
+std::mutex disk_cache_mtx;
+bool disk_cache_enabled = true;
+std::filesystem::path disk_cache_dir;
+uint64_t disk_cache_max_bytes = uint64_t(1) << 30;
+std::atomic<size_t> disk_cache_hits(0);
+std::atomic<size_t> disk_cache_misses(0);
+std::atomic<size_t> disk_cache_evictions(0);
+
+const char JIT_CACHE_MAGIC[8] = {'D', 'E', 'M', 'E', 'J', 'I', 'T', '1'};
+const char* const JIT_CACHE_EXT = ".jit";
+
+// The cache holds code that gets run, so by default it lives under the user's home, not in a shared temp directory
+std::filesystem::path defaultDiskCacheDir() {
+    if (const char* env_dir = std::getenv("DEME_JIT_CACHE_DIR")) {
+        return std::filesystem::path(env_dir);
+    }
+    if (const char* xdg_dir = std::getenv("XDG_CACHE_HOME")) {
+        return std::filesystem::path(xdg_dir) / "DEME_jit_cache";
+    }
+#ifndef _WIN32
+    if (const char* home_dir = std::getenv("HOME")) {
+        return std::filesystem::path(home_dir) / ".cache" / "DEME_jit_cache";
+    }
+    // No home; a temp folder still works since it is made private to this user (see secureCacheDir)
+    std::error_code ec;
+    std::filesystem::path tmp = std::filesystem::temp_directory_path(ec);
+    if (ec) {
+        tmp = std::filesystem::current_path();
+    }
+    return tmp / ("DEME_jit_cache_" + std::to_string(::geteuid()));
+#else
+    if (const char* local_dir = std::getenv("LOCALAPPDATA")) {
+        return std::filesystem::path(local_dir) / "DEME_jit_cache";
+    }
+    std::error_code ec;
+    std::filesystem::path tmp = std::filesystem::temp_directory_path(ec);
+    if (ec) {
+        tmp = std::filesystem::current_path();
+    }
+    return tmp / "DEME_jit_cache";
+#endif
+}
+
+#ifndef _WIN32
+// Whether a cache file or directory can only have been written by this user
+bool ownedPrivately(const struct stat& st) {
+    return st.st_uid == ::geteuid() && (st.st_mode & (S_IWGRP | S_IWOTH)) == 0;
+}
+#endif
+
+// Create the cache directory if needed (private to this user), and check that nobody else can plant entries in it
+bool secureCacheDir(const std::filesystem::path& dir) {
+    std::error_code ec;
+    if (!std::filesystem::exists(dir, ec)) {
+        if (dir.has_parent_path()) {
+            std::filesystem::create_directories(dir.parent_path(), ec);
+        }
+#ifndef _WIN32
+        // Racing jobs may both get here; the loser just finds the directory made
+        if (::mkdir(dir.c_str(), 0700) != 0 && errno != EEXIST) {
+            return false;
+        }
+#else
+        std::filesystem::create_directory(dir, ec);
+        if (ec) {
+            return false;
+        }
+#endif
+    }
+#ifndef _WIN32
+    struct stat st;
+    if (::lstat(dir.c_str(), &st) != 0 || !S_ISDIR(st.st_mode) || !ownedPrivately(st)) {
+        return false;
+    }
+#endif
+    return true;
+}
+
+// Two 64-bit FNV-1a hashes with different offsets, as 32 hex digits. The full key is stored in the entry and compared
+// on load, so a collision only costs a recompilation.
+std::string hashKey(const std::string& key) {
+    uint64_t h1 = 14695981039346656037ULL;
+    uint64_t h2 = 10995116282110ULL;
+    for (unsigned char c : key) {
+        h1 = (h1 ^ c) * 1099511628211ULL;
+        h2 = (h2 ^ c) * 1099511628211ULL;
+    }
+    char buf[33];
+    std::snprintf(buf, sizeof(buf), "%016llx%016llx", (unsigned long long)h1, (unsigned long long)h2);
+    return std::string(buf);
+}
+
+void writeSized(std::ostream& out, const std::string& str) {
+    uint64_t n = str.size();
+    out.write(reinterpret_cast<const char*>(&n), sizeof(n));
+    out.write(str.data(), str.size());
+}
+
+bool readSized(std::istream& in, std::string& str) {
+    uint64_t n = 0;
+    if (!in.read(reinterpret_cast<char*>(&n), sizeof(n))) {
+        return false;
+    }
+    str.resize(n);
+    return (bool)in.read(&str[0], n);
+}
+
+// Size and modification time of each file in dir, which together identify the version of the headers in there
+void appendDirStamp(std::ostringstream& out, const std::filesystem::path& dir) {
+    std::error_code ec;
+    if (!std::filesystem::is_directory(dir, ec)) {
+        return;
+    }
+    std::vector<std::string> entries;
+    for (const auto& entry : std::filesystem::directory_iterator(dir, ec)) {
+        if (!entry.is_regular_file(ec)) {
+            continue;
+        }
+        std::ostringstream stamp;
+        stamp << entry.path().filename().string() << " " << entry.file_size(ec) << " "
+              << entry.last_write_time(ec).time_since_epoch().count();
+        entries.push_back(stamp.str());
+    }
+    std::sort(entries.begin(), entries.end());
+    for (const auto& stamp : entries) {
+        out << stamp << "\n";
+    }
+}
+
+}  // namespace
+
 JitHelper::Header::Header(const std::filesystem::path& sourcefile) {
     this->_source = JitHelper::loadSourceFile(sourcefile);
 }
@@ -33,7 +182,7 @@ void JitHelper::Header::substitute(const std::string& symbol, const std::string&
     }
 }
 
-jitify::Program JitHelper::buildProgram(
+JitProgram JitHelper::buildProgram(
     const std::string& name,
     const std::filesystem::path& source,
     std::unordered_map<std::string, std::string> substitutions,
@@ -47,13 +196,253 @@ jitify::Program JitHelper::buildProgram(
         code = std::regex_replace(code, std::regex(subst.first), subst.second);
     }
 
-    std::vector<std::string> header_code;
-    // THIS BLOCK IS ONLY NEEDED IF THE headers PARAMETER IS USED
-    /*
-    for (auto it = headers.begin(); it != headers.end(); it++) {
-        header_code.push_back(it->getSource());
+    // Compilation is deferred to kernel instantiation, where the disk cache is consulted
+    return JitProgram(std::move(code), std::move(flags));
+}
+
+void JitHelper::setDiskCacheEnabled(bool use) {
+    std::lock_guard<std::mutex> lock(disk_cache_mtx);
+    disk_cache_enabled = use;
+}
+
+bool JitHelper::isDiskCacheEnabled() {
+    std::lock_guard<std::mutex> lock(disk_cache_mtx);
+    return disk_cache_enabled;
+}
+
+void JitHelper::setDiskCacheDir(const std::filesystem::path& dir) {
+    std::lock_guard<std::mutex> lock(disk_cache_mtx);
+    disk_cache_dir = dir;
+}
+
+std::filesystem::path JitHelper::getDiskCacheDir() {
+    std::lock_guard<std::mutex> lock(disk_cache_mtx);
+    if (disk_cache_dir.empty()) {
+        disk_cache_dir = defaultDiskCacheDir();
     }
-    */
+    return disk_cache_dir;
+}
+
+void JitHelper::setDiskCacheMaxBytes(uint64_t max_bytes) {
+    std::lock_guard<std::mutex> lock(disk_cache_mtx);
+    disk_cache_max_bytes = max_bytes;
+}
 
-    return kcache.program(code, header_code, flags);
+JitHelper::DiskCacheStats JitHelper::getDiskCacheStats() {
+    DiskCacheStats stats;
+    stats.hits = disk_cache_hits.load();
+    stats.misses = disk_cache_misses.load();
+    stats.evictions = disk_cache_evictions.load();
+    return stats;
+}
+
+void JitHelper::resetDiskCacheStats() {
+    disk_cache_hits = 0;
+    disk_cache_misses = 0;
+    disk_cache_evictions = 0;
+}
+
+const std::string& JitHelper::cacheFingerprint() {
+    static const std::string fingerprint = []() {
+        std::ostringstream out;
+        int nvrtc_major = 0, nvrtc_minor = 0;
+        nvrtcVersion(&nvrtc_major, &nvrtc_minor);
+        out << "DEME " << DEME_API_VERSION << " NVRTC " << nvrtc_major << "." << nvrtc_minor << "\n";
+        appendDirStamp(out, KERNEL_DIR);
+        appendDirStamp(out, KERNEL_INCLUDE_DIR / "DEM");
+        appendDirStamp(out, KERNEL_INCLUDE_DIR / "kernel");
+        return out.str();
+    }();
+    return fingerprint;
+}
+
+bool JitHelper::loadCachedKernel(const std::string& key, std::string& serialized) {
+    const std::filesystem::path dir = getDiskCacheDir();
+    if (!secureCacheDir(dir)) {
+        return false;
+    }
+    const std::filesystem::path file = dir / (hashKey(key) + JIT_CACHE_EXT);
+#ifndef _WIN32
+    // Check the very file that is read: a regular file, not a link, written by nobody but this user
+    int fd = ::open(file.c_str(), O_RDONLY | O_NOFOLLOW);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    if (::fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || !ownedPrivately(st)) {
+        ::close(fd);
+        return false;
+    }
+    std::string contents(st.st_size, '\0');
+    size_t n_read = 0;
+    while (n_read < contents.size()) {
+        ssize_t n = ::read(fd, &contents[n_read], contents.size() - n_read);
+        if (n <= 0) {
+            break;
+        }
+        n_read += n;
+    }
+    ::close(fd);
+    if (n_read != contents.size()) {
+        return false;
+    }
+    std::istringstream in(std::move(contents));
+#else
+    std::ifstream in(file, std::ios::in | std::ios::binary);
+    if (!in) {
+        return false;
+    }
+#endif
+    char magic[sizeof(JIT_CACHE_MAGIC)];
+    std::string stored_key;
+    if (!in.read(magic, sizeof(magic)) || !std::equal(magic, magic + sizeof(magic), JIT_CACHE_MAGIC) ||
+        !readSized(in, stored_key) || stored_key != key || !readSized(in, serialized)) {
+        return false;
+    }
+    // Mark it as recently used, which is what eviction goes by
+    std::error_code ec;
+    std::filesystem::last_write_time(file, std::filesystem::file_time_type::clock::now(), ec);
+    return true;
+}
+
+void JitHelper::storeCachedKernel(const std::string& key, const std::string& serialized) {
+    const std::filesystem::path dir = getDiskCacheDir();
+    if (!secureCacheDir(dir)) {
+        return;
+    }
+    std::error_code ec;
+    const std::string entry_name = hashKey(key) + JIT_CACHE_EXT;
+    // Write to a uniquely named file first then rename it, so concurrent jobs sharing the cache never see a partial
+    // entry
+#ifndef _WIN32
+    std::string tmp_name = (dir / (entry_name + ".tmpXXXXXX")).string();
+    int fd = ::mkstemp(&tmp_name[0]);
+    if (fd < 0) {
+        return;
+    }
+    ::close(fd);
+    const std::filesystem::path tmp_file(tmp_name);
+#else
+    static std::atomic<unsigned int> tmp_count(0);
+    std::ostringstream tmp_name;
+    tmp_name << entry_name << ".tmp" << ::_getpid() << "_" << tmp_count++;
+    const std::filesystem::path tmp_file = dir / tmp_name.str();
+#endif
+    {
+        std::ofstream out(tmp_file, std::ios::out | std::ios::binary);
+        if (!out) {
+            return;
+        }
+        out.write(JIT_CACHE_MAGIC, sizeof(JIT_CACHE_MAGIC));
+        writeSized(out, key);
+        writeSized(out, serialized);
+        if (!out) {
+            out.close();
+            std::filesystem::remove(tmp_file, ec);
+            return;
+        }
+    }
+    std::filesystem::rename(tmp_file, dir / entry_name, ec);
+    if (ec) {
+        std::filesystem::remove(tmp_file, ec);
+        return;
+    }
+    evictDiskCache(dir);
+}
+
+void JitHelper::evictDiskCache(const std::filesystem::path& dir) {
+    uint64_t max_bytes;
+    {
+        std::lock_guard<std::mutex> lock(disk_cache_mtx);
+        max_bytes = disk_cache_max_bytes;
+    }
+    struct CacheEntry {
+        std::filesystem::path path;
+        std::filesystem::file_time_type last_used;
+        uint64_t bytes;
+    };
+    std::vector<CacheEntry> entries;
+    uint64_t total_bytes = 0;
+    std::error_code ec;
+    for (const auto& entry : std::filesystem::directory_iterator(dir, ec)) {
+        if (!entry.is_regular_file(ec) || entry.path().extension() != JIT_CACHE_EXT) {
+            continue;
+        }
+        CacheEntry e{entry.path(), entry.last_write_time(ec), entry.file_size(ec)};
+        total_bytes += e.bytes;
+        entries.push_back(std::move(e));
+    }
+    if (total_bytes <= max_bytes) {
+        return;
+    }
+    // Least recently used go first
+    std::sort(entries.begin(), entries.end(),
+              [](const CacheEntry& a, const CacheEntry& b) { return a.last_used < b.last_used; });
+    for (const auto& e : entries) {
+        if (total_bytes <= max_bytes) {
+            break;
+        }
+        if (std::filesystem::remove(e.path, ec)) {
+            total_bytes -= e.bytes;
+            disk_cache_evictions++;
+        }
+    }
+}
+
+JitProgram::JitProgram(std::string code, std::vector<std::string> flags)
+    : m_code(std::move(code)), m_flags(std::move(flags)), m_mtx(std::make_unique<std::mutex>()) {}
+
+jitify::experimental::KernelInstantiation& JitProgram::getInstance(const std::string& name,
+                                                                   const std::vector<std::string>& template_args) {
+    std::string inst_name = name;
+    for (const auto& arg : template_args) {
+        inst_name += "," + arg;
+    }
+
+    std::lock_guard<std::mutex> lock(*m_mtx);
+    auto it = m_instances.find(inst_name);
+    if (it != m_instances.end()) {
+        return *(it->second);
+    }
+
+    std::string key;
+    const bool use_disk_cache = JitHelper::isDiskCacheEnabled();
+    if (use_disk_cache) {
+        // The PTX jitify generates targets the current device's architecture
+        int device = 0, cc_major = 0, cc_minor = 0;
+        DEME_GPU_CALL(cudaGetDevice(&device));
+        DEME_GPU_CALL(cudaDeviceGetAttribute(&cc_major, cudaDevAttrComputeCapabilityMajor, device));
+        DEME_GPU_CALL(cudaDeviceGetAttribute(&cc_minor, cudaDevAttrComputeCapabilityMinor, device));
+
+        std::ostringstream key_stream;
+        key_stream << JitHelper::cacheFingerprint() << "sm_" << cc_major << cc_minor << "\n";
+        for (const auto& flag : m_flags) {
+            key_stream << flag << "\n";
+        }
+        key_stream << inst_name << "\n" << m_code;
+        key = key_stream.str();
+
+        std::string serialized;
+        if (JitHelper::loadCachedKernel(key, serialized)) {
+            try {
+                auto inst = std::make_unique<jitify::experimental::KernelInstantiation>(
+                    jitify::experimental::KernelInstantiation::deserialize(serialized));
+                disk_cache_hits++;
+                return *(m_instances[inst_name] = std::move(inst));
+            } catch (const std::exception&) {
+                // A damaged entry is simply recompiled and overwritten
+            }
+        }
+        disk_cache_misses++;
+    }
+
+    if (!m_program) {
+        m_program = std::make_unique<jitify::experimental::Program>(m_code, std::vector<std::string>(), m_flags);
+    }
+    auto inst = std::make_unique<jitify::experimental::KernelInstantiation>(
+        m_program->kernel(name).instantiate(template_args));
+    if (use_disk_cache) {
+        JitHelper::storeCachedKernel(key, inst->serialize());
+    }
+    return *(m_instances[inst_name] = std::move(inst));
 }
@@ -6,7 +6,10 @@
 #ifndef DEME_JIT_HELPER_H
 #define DEME_JIT_HELPER_H
 
+#include <cstdint>
 #include <filesystem>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 #include <unordered_map>
@@ -19,6 +22,8 @@
     #undef strtok_r
 #endif
 
+class JitProgram;
+
 class JitHelper {
   public:
     class Header {
@@ -31,7 +36,14 @@ class JitHelper {
         std::string _source;
     };
 
-    static jitify::Program buildProgram(
+    /// Counters of the on-disk kernel cache, accumulated over the whole process
+    struct DiskCacheStats {
+        size_t hits = 0;
+        size_t misses = 0;
+        size_t evictions = 0;
+    };
+
+    static JitProgram buildProgram(
         const std::string& name,
         const std::filesystem::path& source,
         std::unordered_map<std::string, std::string> substitutions = std::unordered_map<std::string, std::string>(),
@@ -44,11 +56,31 @@ class JitHelper {
     // 	std::vector<std::string> flags = 0
     // );
 
+    // Compiled kernels are kept on disk, keyed by the substituted source, the compile flags, the NVRTC version, the
+    // device architecture and the kernel headers shipped with the library. The cache directory defaults to
+    // DEME_JIT_CACHE_DIR if that environment variable is set, or a folder in the user's cache directory otherwise. It
+    // is created private to the user, and a directory or entry that others could have written is never used.
+    static void setDiskCacheEnabled(bool use);
+    static bool isDiskCacheEnabled();
+    static void setDiskCacheDir(const std::filesystem::path& dir);
+    static std::filesystem::path getDiskCacheDir();
+    // When the cache grows larger than this, the least recently used entries are removed
+    static void setDiskCacheMaxBytes(uint64_t max_bytes);
+    static DiskCacheStats getDiskCacheStats();
+    static void resetDiskCacheStats();
+
     static const std::filesystem::path KERNEL_DIR;
     static const std::filesystem::path KERNEL_INCLUDE_DIR;
 
   private:
-    static jitify::JitCache kcache;
+    friend class JitProgram;
+
+    // Get the serialized kernel stored under key, if any
+    static bool loadCachedKernel(const std::string& key, std::string& serialized);
+    static void storeCachedKernel(const std::string& key, const std::string& serialized);
+    static void evictDiskCache(const std::filesystem::path& dir);
+    // Things that change the compiled kernels without changing their source text
+    static const std::string& cacheFingerprint();
 
     inline static std::string loadSourceFile(const std::filesystem::path& sourcefile) {
         std::string code;
@@ -61,4 +93,46 @@ class JitHelper {
     };
 };
 
+/// A jitified program. Kernels are instantiated on first use, then kept for the lifetime of the program; an
+/// instantiation found in the disk cache is loaded from its stored PTX, skipping NVRTC altogether. The program itself
+/// is only preprocessed if some kernel of it misses the disk cache.
+class JitProgram {
+  public:
+    class Kernel {
+      public:
+        jitify::experimental::KernelInstantiation& instantiate(
+            const std::vector<std::string>& template_args = std::vector<std::string>()) const {
+            return m_program->getInstance(m_name, template_args);
+        }
+        template <typename... TemplateArgs>
+        jitify::experimental::KernelInstantiation& instantiate(TemplateArgs... targs) const {
+            return m_program->getInstance(m_name, std::vector<std::string>({std::string(targs)...}));
+        }
+
+      private:
+        friend class JitProgram;
+        Kernel(JitProgram* program, std::string name) : m_program(program), m_name(std::move(name)) {}
+
+        JitProgram* m_program;
+        std::string m_name;
+    };
+
+    Kernel kernel(std::string name) { return Kernel(this, std::move(name)); }
+
+  private:
+    friend class JitHelper;
+    JitProgram(std::string code, std::vector<std::string> flags);
+
+    jitify::experimental::KernelInstantiation& getInstance(const std::string& name,
+                                                           const std::vector<std::string>& template_args);
+
+    std::string m_code;
+    std::vector<std::string> m_flags;
+    std::unique_ptr<jitify::experimental::Program> m_program;
+    // Instantiations are looked up at every launch, so they are held on to here; kT and dT each use their own programs,
+    // but an inspector may be used from the user thread
+    std::unique_ptr<std::mutex> m_mtx;
+    std::unordered_map<std::string, std::unique_ptr<jitify::experimental::KernelInstantiation>> m_instances;
+};
+
 #endif
@@ -0,0 +1,82 @@
+//  Copyright (c) 2021, SBEL GPU Development Team
+//  Copyright (c) 2021, University of Wisconsin - Madison
+//
+//	SPDX-License-Identifier: BSD-3-Clause
+
+#ifndef DEME_MAPPED_FILE_HPP
+#define DEME_MAPPED_FILE_HPP
+
+#include <cstddef>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#ifndef _WIN32
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+namespace deme {
+
+/// Read-only view of a whole file. It is memory-mapped on POSIX systems, and read into a buffer otherwise.
+class MappedFile {
+  public:
+    explicit MappedFile(const std::string& filename) : m_filename(filename) {
+#ifndef _WIN32
+        int fd = ::open(m_filename.c_str(), O_RDONLY);
+        if (fd < 0)
+            throw std::runtime_error("Cannot open file " + m_filename);
+        struct stat st;
+        if (::fstat(fd, &st) != 0) {
+            ::close(fd);
+            throw std::runtime_error("Cannot stat file " + m_filename);
+        }
+        m_size = (size_t)st.st_size;
+        if (m_size > 0) {
+            void* ptr = ::mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (ptr == MAP_FAILED) {
+                ::close(fd);
+                throw std::runtime_error("Cannot memory-map file " + m_filename);
+            }
+            m_data = static_cast<const char*>(ptr);
+        }
+        ::close(fd);
+#else
+        std::ifstream in(m_filename, std::ios::binary | std::ios::ate);
+        if (!in)
+            throw std::runtime_error("Cannot open file " + m_filename);
+        m_size = (size_t)in.tellg();
+        m_buffer.resize(m_size);
+        in.seekg(0);
+        in.read(m_buffer.data(), m_size);
+        m_data = m_buffer.data();
+#endif
+    }
+    ~MappedFile() {
+#ifndef _WIN32
+        if (m_data && m_size > 0)
+            ::munmap(const_cast<char*>(m_data), m_size);
+#endif
+    }
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const char* data() const { return m_data; }
+    size_t size() const { return m_size; }
+    const std::string& filename() const { return m_filename; }
+
+  private:
+    std::string m_filename;
+    const char* m_data = nullptr;
+    size_t m_size = 0;
+#ifdef _WIN32
+    std::vector<char> m_buffer;
+#endif
+};
+
+}  // namespace deme
+
+#endif
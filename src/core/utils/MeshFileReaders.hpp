@@ -0,0 +1,869 @@
+//  Copyright (c) 2021, SBEL GPU Development Team
+//  Copyright (c) 2021, University of Wisconsin - Madison
+//
+//	SPDX-License-Identifier: BSD-3-Clause
+
+// Fast readers of triangle mesh files (Wavefront OBJ, STL and PLY) into an indexed triangle mesh, plus a binary cache
+// of the result keyed by the file's content hash. The OBJ reader is multithreaded: the memory-mapped file is split at
+// line boundaries, each thread parses its chunk into local arrays, and the chunks are concatenated in order (relative
+// indices are resolved after the per-chunk vertex counts are known). Binary STL and the fixed-size vertex records of
+// binary PLY are decoded in parallel too.
+
+#ifndef DEME_MESH_FILE_READERS_HPP
+#define DEME_MESH_FILE_READERS_HPP
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <functional>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#ifdef _WIN32
+    #include <process.h>
+#endif
+
+#include <core/utils/MappedFile.hpp>
+
+namespace deme {
+
+/// An indexed triangle mesh as read from a file. All indices are 0-based, 3 per triangle.
+struct TriMeshData {
+    std::vector<float> vertices;  // xyz per vertex
+    std::vector<float> normals;   // xyz per normal
+    std::vector<float> uv;        // uv per texture coordinate
+    std::vector<int> face_v;
+    // Empty if the file does not give normal (texture coordinate) indices for every face
+    std::vector<int> face_n;
+    std::vector<int> face_uv;
+
+    size_t NumVertices() const { return vertices.size() / 3; }
+    size_t NumTriangles() const { return face_v.size() / 3; }
+    void Clear() {
+        vertices.clear();
+        normals.clear();
+        uv.clear();
+        face_v.clear();
+        face_n.clear();
+        face_uv.clear();
+    }
+};
+
+class MeshFileReader {
+  public:
+    /// @param nThreads Number of worker threads; 0 means std::thread::hardware_concurrency().
+    explicit MeshFileReader(unsigned int nThreads = 0) {
+        m_n_threads = (nThreads > 0) ? nThreads : std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    /// Read a mesh, picking the format from the file extension (.obj, .stl or .ply, case-insensitive).
+    void Read(const std::string& filename, TriMeshData& mesh) const {
+        const std::string ext = lowerExtension(filename);
+        if (ext == ".stl") {
+            ReadStl(filename, mesh);
+        } else if (ext == ".ply") {
+            ReadPly(filename, mesh);
+        } else {
+            ReadObj(filename, mesh);
+        }
+    }
+
+    /// Read a Wavefront .obj file. Polygons are split into triangle fans; negative (relative) indices are supported.
+    void ReadObj(const std::string& filename, TriMeshData& mesh) const {
+        MappedFile file(filename);
+        const char* data = file.data();
+        const size_t size = file.size();
+        mesh.Clear();
+
+        // Split at line boundaries
+        const size_t n_chunks = (size < PARALLEL_MIN_BYTES) ? 1 : std::min<size_t>(m_n_threads, size / 4096 + 1);
+        std::vector<size_t> bounds(n_chunks + 1, 0);
+        bounds[n_chunks] = size;
+        for (size_t t = 1; t < n_chunks; t++) {
+            size_t raw = std::max(bounds[t - 1], size * t / n_chunks);
+            const void* nl = (raw < size) ? std::memchr(data + raw, '\n', size - raw) : nullptr;
+            bounds[t] = nl ? (size_t)(static_cast<const char*>(nl) - data) + 1 : size;
+        }
+
+        std::vector<ObjChunk> chunks(n_chunks);
+        runChunks(n_chunks, [&](size_t t) { parseObjChunk(data + bounds[t], data + bounds[t + 1], chunks[t]); });
+
+        // Concatenate in order, turning chunk-relative indices into global ones
+        size_t nv = 0, nn = 0, nt = 0, nf = 0;
+        bool all_n = true, all_uv = true;
+        std::vector<size_t> v_off(n_chunks), n_off(n_chunks), t_off(n_chunks), f_off(n_chunks);
+        for (size_t t = 0; t < n_chunks; t++) {
+            v_off[t] = nv;
+            n_off[t] = nn;
+            t_off[t] = nt;
+            f_off[t] = nf;
+            nv += chunks[t].vertices.size() / 3;
+            nn += chunks[t].normals.size() / 3;
+            nt += chunks[t].uv.size() / 2;
+            nf += chunks[t].face_v.size();
+            all_n = all_n && chunks[t].all_have_n;
+            all_uv = all_uv && chunks[t].all_have_uv;
+        }
+        mesh.vertices.resize(nv * 3);
+        mesh.normals.resize(nn * 3);
+        mesh.uv.resize(nt * 2);
+        mesh.face_v.resize(nf);
+        if (all_n && nf > 0)
+            mesh.face_n.resize(nf);
+        if (all_uv && nf > 0)
+            mesh.face_uv.resize(nf);
+        std::vector<std::exception_ptr> errors(n_chunks);
+        runChunks(n_chunks, [&](size_t t) {
+            try {
+                const ObjChunk& c = chunks[t];
+                std::copy(c.vertices.begin(), c.vertices.end(), mesh.vertices.begin() + v_off[t] * 3);
+                std::copy(c.normals.begin(), c.normals.end(), mesh.normals.begin() + n_off[t] * 3);
+                std::copy(c.uv.begin(), c.uv.end(), mesh.uv.begin() + t_off[t] * 2);
+                for (size_t i = 0; i < c.face_v.size(); i++) {
+                    mesh.face_v[f_off[t] + i] = resolveIndex(c.face_v[i], v_off[t], nv, file.filename());
+                    if (!mesh.face_n.empty())
+                        mesh.face_n[f_off[t] + i] = resolveIndex(c.face_n[i], n_off[t], nn, file.filename());
+                    if (!mesh.face_uv.empty())
+                        mesh.face_uv[f_off[t] + i] = resolveIndex(c.face_uv[i], t_off[t], nt, file.filename());
+                }
+            } catch (...) {
+                errors[t] = std::current_exception();
+            }
+        });
+        for (const auto& e : errors) {
+            if (e)
+                std::rethrow_exception(e);
+        }
+    }
+
+    /// Read a binary or ASCII STL file. Coincident corners are welded into shared vertices; each triangle's facet
+    /// normal becomes a normal shared by its 3 corners.
+    void ReadStl(const std::string& filename, TriMeshData& mesh) const {
+        MappedFile file(filename);
+        const char* data = file.data();
+        const size_t size = file.size();
+        mesh.Clear();
+
+        // Binary STL: 80-byte header, uint32 count, then 50-byte records. Some binary files also start with "solid",
+        // so the size is what tells them apart.
+        std::vector<float> corners, facet_normals;
+        uint32_t n_tri = 0;
+        if (size >= 84)
+            std::memcpy(&n_tri, data + 80, 4);
+        if (size >= 84 && size == 84 + (size_t)n_tri * 50) {
+            corners.resize((size_t)n_tri * 9);
+            facet_normals.resize((size_t)n_tri * 3);
+            const size_t n_chunks = (n_tri < PARALLEL_MIN_ITEMS) ? 1 : m_n_threads;
+            runChunks(n_chunks, [&](size_t t) {
+                for (size_t i = n_tri * t / n_chunks; i < n_tri * (t + 1) / n_chunks; i++) {
+                    const char* rec = data + 84 + i * 50;
+                    std::memcpy(&facet_normals[i * 3], rec, 12);
+                    std::memcpy(&corners[i * 9], rec + 12, 36);
+                }
+            });
+        } else {
+            parseAsciiStl(data, data + size, corners, facet_normals, file.filename());
+            n_tri = (uint32_t)(facet_normals.size() / 3);
+        }
+
+        weldCorners(corners, mesh);
+        mesh.normals = std::move(facet_normals);
+        mesh.face_n.resize((size_t)n_tri * 3);
+        for (size_t i = 0; i < mesh.face_n.size(); i++)
+            mesh.face_n[i] = (int)(i / 3);
+    }
+
+    /// Read an ASCII or binary (either endianness) PLY file. Vertex x/y/z, optional nx/ny/nz and u/v (or s/t), and
+    /// the face vertex index lists are read; polygons are split into triangle fans. Other elements are skipped.
+    void ReadPly(const std::string& filename, TriMeshData& mesh) const {
+        MappedFile file(filename);
+        const char* data = file.data();
+        const char* end = data + file.size();
+        mesh.Clear();
+
+        PlyHeader hdr = parsePlyHeader(data, end, file.filename());
+        const char* p = hdr.body;
+        for (const PlyElement& el : hdr.elements) {
+            if (el.name == "vertex") {
+                p = readPlyVertices(hdr, el, p, end, mesh, file.filename());
+            } else if (el.name == "face") {
+                p = readPlyFaces(hdr, el, p, end, mesh, file.filename());
+            } else {
+                p = skipPlyElement(hdr, el, p, end, file.filename());
+            }
+        }
+        const size_t nv = mesh.NumVertices();
+        for (int v : mesh.face_v) {
+            if (v < 0 || (size_t)v >= nv)
+                throw std::runtime_error("Face refers to a non-existent vertex in PLY file " + file.filename());
+        }
+        // Per-vertex normals and texture coordinates share the vertex indices
+        if (!mesh.normals.empty())
+            mesh.face_n = mesh.face_v;
+        if (!mesh.uv.empty())
+            mesh.face_uv = mesh.face_v;
+    }
+
+    /// 64-bit hash of a file's contents: FNV-1a over fixed 1 MiB blocks (in parallel), then over the block hashes and
+    /// the file size. It only depends on the contents, not on the thread count.
+    uint64_t HashFile(const std::string& filename) const {
+        MappedFile file(filename);
+        const size_t size = file.size();
+        const size_t n_blocks = (size + HASH_BLOCK_BYTES - 1) / HASH_BLOCK_BYTES;
+        std::vector<uint64_t> block_hash(n_blocks);
+        const size_t n_chunks = std::min<size_t>(m_n_threads, std::max<size_t>(n_blocks, 1));
+        runChunks(n_chunks, [&](size_t t) {
+            for (size_t b = n_blocks * t / n_chunks; b < n_blocks * (t + 1) / n_chunks; b++) {
+                const size_t start = b * HASH_BLOCK_BYTES;
+                block_hash[b] = fnv1a(file.data() + start, std::min(HASH_BLOCK_BYTES, size - start), FNV_OFFSET);
+            }
+        });
+        uint64_t h = fnv1a(reinterpret_cast<const char*>(&size), sizeof(size), FNV_OFFSET);
+        return fnv1a(reinterpret_cast<const char*>(block_hash.data()), n_blocks * sizeof(uint64_t), h);
+    }
+
+    /// Mix extra bits (such as load options) into a cache key.
+    static uint64_t MixKey(uint64_t key, uint64_t extra) {
+        return fnv1a(reinterpret_cast<const char*>(&extra), sizeof(extra), key);
+    }
+
+    /// Load a mesh from a cache file written by SaveCache. Returns false (leaving mesh untouched) if the file does not
+    /// exist, is not a mesh cache, was written with another key, or has a face index out of range.
+    static bool LoadCache(const std::string& path, uint64_t key, TriMeshData& mesh) {
+        std::ifstream in(path, std::ios::binary);
+        if (!in)
+            return false;
+        char magic[8];
+        uint32_t version = 0, reserved = 0;
+        uint64_t stored_key = 0;
+        in.read(magic, 8);
+        in.read(reinterpret_cast<char*>(&version), 4);
+        in.read(reinterpret_cast<char*>(&reserved), 4);
+        in.read(reinterpret_cast<char*>(&stored_key), 8);
+        if (!in || std::memcmp(magic, CACHE_MAGIC, 8) != 0 || version != CACHE_VERSION || stored_key != key)
+            return false;
+        TriMeshData tmp;
+        if (!readArray(in, tmp.vertices) || !readArray(in, tmp.normals) || !readArray(in, tmp.uv) ||
+            !readArray(in, tmp.face_v) || !readArray(in, tmp.face_n) || !readArray(in, tmp.face_uv))
+            return false;
+        // A damaged file could still have well-formed arrays; never hand out indices past the end of them
+        if (!indicesInRange(tmp.face_v, tmp.NumVertices()) || !indicesInRange(tmp.face_n, tmp.normals.size() / 3) ||
+            !indicesInRange(tmp.face_uv, tmp.uv.size() / 2))
+            return false;
+        mesh = std::move(tmp);
+        return true;
+    }
+
+    /// Write a mesh cache file. It is written to a temporary file first then renamed, so concurrent jobs sharing a
+    /// cache directory never see a partial file.
+    static void SaveCache(const std::string& path, uint64_t key, const TriMeshData& mesh) {
+        // Unique to this process and thread, so jobs on other processes (or other nodes sharing the directory, whose
+        // thread hashes may collide) never write to the same temporary file
+        const std::string tmp_path = path + ".tmp" + std::to_string(processID()) + "_" +
+                                     std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id()));
+        {
+            std::ofstream out(tmp_path, std::ios::binary);
+            if (!out)
+                throw std::runtime_error("Cannot open " + tmp_path + " for writing the mesh cache.");
+            const uint32_t version = CACHE_VERSION, reserved = 0;
+            out.write(CACHE_MAGIC, 8);
+            out.write(reinterpret_cast<const char*>(&version), 4);
+            out.write(reinterpret_cast<const char*>(&reserved), 4);
+            out.write(reinterpret_cast<const char*>(&key), 8);
+            writeArray(out, mesh.vertices);
+            writeArray(out, mesh.normals);
+            writeArray(out, mesh.uv);
+            writeArray(out, mesh.face_v);
+            writeArray(out, mesh.face_n);
+            writeArray(out, mesh.face_uv);
+            if (!out)
+                throw std::runtime_error("Failed writing the mesh cache " + tmp_path);
+        }
+        if (std::rename(tmp_path.c_str(), path.c_str()) != 0) {
+            std::remove(tmp_path.c_str());
+            throw std::runtime_error("Cannot move the mesh cache into place at " + path);
+        }
+    }
+
+  private:
+    unsigned int m_n_threads = 1;
+
+    // Inputs smaller than these are not worth spawning threads for
+    static constexpr size_t PARALLEL_MIN_BYTES = 1 << 20;
+    static constexpr size_t PARALLEL_MIN_ITEMS = 1 << 15;
+    static constexpr size_t HASH_BLOCK_BYTES = 1 << 20;
+    static constexpr uint64_t FNV_OFFSET = 14695981039346656037ULL;
+    static constexpr uint64_t FNV_PRIME = 1099511628211ULL;
+    static constexpr char CACHE_MAGIC[9] = "DEMEMSH\0";
+    static constexpr uint32_t CACHE_VERSION = 1;
+    // Marks a chunk-relative index (from a negative OBJ index) before it is resolved
+    static constexpr int64_t OBJ_RELATIVE_FLAG = (int64_t)1 << 62;
+    static constexpr int64_t OBJ_NO_INDEX = INT64_MIN;
+
+    struct ObjChunk {
+        std::vector<float> vertices, normals, uv;
+        std::vector<int64_t> face_v, face_n, face_uv;
+        bool all_have_n = true, all_have_uv = true;
+    };
+
+    static uint64_t fnv1a(const char* p, size_t n, uint64_t h) {
+        for (size_t i = 0; i < n; i++) {
+            h ^= (unsigned char)p[i];
+            h *= FNV_PRIME;
+        }
+        return h;
+    }
+
+    static std::string lowerExtension(const std::string& filename) {
+        const size_t dot = filename.find_last_of('.');
+        const size_t slash = filename.find_last_of("/\\");
+        if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+            return std::string();
+        std::string ext = filename.substr(dot);
+        std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return (char)std::tolower(c); });
+        return ext;
+    }
+
+    template <typename Func>
+    static void runChunks(size_t n_chunks, const Func& func) {
+        if (n_chunks <= 1) {
+            func((size_t)0);
+            return;
+        }
+        std::vector<std::thread> workers;
+        workers.reserve(n_chunks);
+        for (size_t t = 0; t < n_chunks; t++)
+            workers.emplace_back([&, t]() { func(t); });
+        for (auto& w : workers)
+            w.join();
+    }
+
+    static bool isBlank(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+    // Advance p past blanks and return the end of the next token within [p, end)
+    static const char* nextToken(const char*& p, const char* end) {
+        while (p < end && isBlank(*p))
+            p++;
+        const char* q = p;
+        while (q < end && !isBlank(*q))
+            q++;
+        return q;
+    }
+
+    static bool parseFloat(const char*& p, const char* end, float& val) {
+        const char* q = nextToken(p, end);
+        if (p == q)
+            return false;
+        const char* s = (*p == '+') ? p + 1 : p;
+        std::from_chars_result res = std::from_chars(s, q, val);
+        p = q;
+        return res.ec == std::errc();
+    }
+
+    // Parse one OBJ index; chunk-relative ones (negative in the file) are flagged
+    static int64_t objIndex(const char* b, const char* e, size_t local_count) {
+        if (b == e)
+            return OBJ_NO_INDEX;
+        long long k = 0;
+        std::from_chars_result res = std::from_chars(b, e, k);
+        if (res.ec != std::errc() || k == 0)
+            return OBJ_NO_INDEX;
+        if (k > 0)
+            return (int64_t)k - 1;
+        return OBJ_RELATIVE_FLAG + (int64_t)local_count + k;
+    }
+
+    static int resolveIndex(int64_t idx, size_t chunk_offset, size_t count, const std::string& filename) {
+        int64_t g = idx;
+        if (idx != OBJ_NO_INDEX && idx >= OBJ_RELATIVE_FLAG / 2)
+            g = (int64_t)chunk_offset + (idx - OBJ_RELATIVE_FLAG);
+        if (idx == OBJ_NO_INDEX || g < 0 || g >= (int64_t)count)
+            throw std::runtime_error("A face refers to a missing vertex, normal or texture coordinate in OBJ file " +
+                                     filename);
+        return (int)g;
+    }
+
+    static void parseObjChunk(const char* p, const char* end, ObjChunk& c) {
+        std::vector<int64_t> poly_v, poly_n, poly_uv;
+        while (p < end) {
+            const char* line_end = static_cast<const char*>(std::memchr(p, '\n', end - p));
+            if (!line_end)
+                line_end = end;
+            const char* q = p;
+            const char* tok_end = nextToken(q, line_end);
+            const size_t tok_len = tok_end - q;
+            if (tok_len == 1 && (*q == 'v' || *q == 'V')) {
+                float x, y, z;
+                const char* r = tok_end;
+                // Extra components (such as vertex colors) are ignored
+                if (parseFloat(r, line_end, x) && parseFloat(r, line_end, y) && parseFloat(r, line_end, z)) {
+                    c.vertices.push_back(x);
+                    c.vertices.push_back(y);
+                    c.vertices.push_back(z);
+                }
+            } else if (tok_len == 2 && (q[0] == 'v' || q[0] == 'V') && (q[1] == 'n' || q[1] == 'N')) {
+                float x, y, z;
+                const char* r = tok_end;
+                if (parseFloat(r, line_end, x) && parseFloat(r, line_end, y) && parseFloat(r, line_end, z)) {
+                    c.normals.push_back(x);
+                    c.normals.push_back(y);
+                    c.normals.push_back(z);
+                }
+            } else if (tok_len == 2 && (q[0] == 'v' || q[0] == 'V') && (q[1] == 't' || q[1] == 'T')) {
+                float u, v;
+                const char* r = tok_end;
+                // A 3rd component is ignored
+                if (parseFloat(r, line_end, u) && parseFloat(r, line_end, v)) {
+                    c.uv.push_back(u);
+                    c.uv.push_back(v);
+                }
+            } else if (tok_len == 1 && (*q == 'f' || *q == 'F')) {
+                poly_v.clear();
+                poly_n.clear();
+                poly_uv.clear();
+                const char* r = tok_end;
+                while (true) {
+                    const char* e = nextToken(r, line_end);
+                    if (r == e)
+                        break;
+                    // v, v/vt, v//vn or v/vt/vn
+                    const char* s1 = std::find(r, e, '/');
+                    const char* s2 = (s1 < e) ? std::find(s1 + 1, e, '/') : e;
+                    poly_v.push_back(objIndex(r, s1, c.vertices.size() / 3));
+                    poly_uv.push_back((s1 < e) ? objIndex(s1 + 1, s2, c.uv.size() / 2) : OBJ_NO_INDEX);
+                    poly_n.push_back((s2 < e) ? objIndex(s2 + 1, e, c.normals.size() / 3) : OBJ_NO_INDEX);
+                    r = e;
+                }
+                // Triangle fan around the first corner
+                for (size_t i = 2; i < poly_v.size(); i++) {
+                    const size_t corner[3] = {0, i - 1, i};
+                    for (size_t k : corner) {
+                        c.face_v.push_back(poly_v[k]);
+                        c.face_n.push_back(poly_n[k]);
+                        c.face_uv.push_back(poly_uv[k]);
+                        c.all_have_n = c.all_have_n && poly_n[k] != OBJ_NO_INDEX;
+                        c.all_have_uv = c.all_have_uv && poly_uv[k] != OBJ_NO_INDEX;
+                    }
+                }
+            }
+            p = line_end + 1;
+        }
+    }
+
+    static void parseAsciiStl(const char* p,
+                              const char* end,
+                              std::vector<float>& corners,
+                              std::vector<float>& facet_normals,
+                              const std::string& filename) {
+        size_t n_corners_this_facet = 0;
+        while (p < end) {
+            const char* line_end = static_cast<const char*>(std::memchr(p, '\n', end - p));
+            if (!line_end)
+                line_end = end;
+            const char* q = p;
+            const char* tok_end = nextToken(q, line_end);
+            const std::string tok(q, tok_end);
+            if (tok == "facet") {
+                // "facet normal nx ny nz"
+                const char* r = tok_end;
+                nextToken(r, line_end);
+                float n[3] = {0.f, 0.f, 0.f};
+                r = nextToken(r, line_end);
+                for (float& v : n)
+                    parseFloat(r, line_end, v);
+                facet_normals.insert(facet_normals.end(), n, n + 3);
+                n_corners_this_facet = 0;
+            } else if (tok == "vertex") {
+                const char* r = tok_end;
+                float v[3];
+                for (float& x : v) {
+                    if (!parseFloat(r, line_end, x))
+                        throw std::runtime_error("Malformed vertex line in STL file " + filename);
+                }
+                if (++n_corners_this_facet > 3)
+                    throw std::runtime_error("A facet has more than 3 vertices in STL file " + filename);
+                corners.insert(corners.end(), v, v + 3);
+            }
+            p = line_end + 1;
+        }
+        if (corners.size() != facet_normals.size() * 3)
+            throw std::runtime_error("Facets and vertices do not match up in STL file " + filename);
+    }
+
+    // Merge bitwise-identical corners into shared vertices, numbered in order of first appearance
+    void weldCorners(const std::vector<float>& corners, TriMeshData& mesh) const {
+        const size_t n = corners.size() / 3;
+        std::vector<uint32_t> order(n);
+        std::iota(order.begin(), order.end(), 0u);
+        auto key = [&](uint32_t i, int d) {
+            uint32_t b;
+            std::memcpy(&b, &corners[(size_t)i * 3 + d], 4);
+            return b;
+        };
+        std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+            for (int d = 0; d < 3; d++) {
+                const uint32_t ka = key(a, d), kb = key(b, d);
+                if (ka != kb)
+                    return ka < kb;
+            }
+            return a < b;
+        });
+        // The first corner (lowest index) of each run of equal corners represents them
+        std::vector<uint32_t> rep(n);
+        for (size_t s = 0; s < n;) {
+            size_t e = s + 1;
+            while (e < n && key(order[e], 0) == key(order[s], 0) && key(order[e], 1) == key(order[s], 1) &&
+                   key(order[e], 2) == key(order[s], 2))
+                e++;
+            for (size_t k = s; k < e; k++)
+                rep[order[k]] = order[s];
+            s = e;
+        }
+        std::vector<int> vid(n, -1);
+        mesh.face_v.resize(n);
+        for (size_t i = 0; i < n; i++) {
+            const uint32_t r = rep[i];
+            if (vid[r] < 0) {
+                vid[r] = (int)(mesh.vertices.size() / 3);
+                mesh.vertices.insert(mesh.vertices.end(), corners.begin() + (size_t)r * 3,
+                                     corners.begin() + (size_t)r * 3 + 3);
+            }
+            mesh.face_v[i] = vid[r];
+        }
+    }
+
+    // PLY
+    enum class PLY_FORMAT { ASCII, BINARY_LE, BINARY_BE };
+    struct PlyProperty {
+        std::string name;
+        int type = 0;  // Size in bytes; negative for signed integers, 0x10 | size for floating point
+        bool is_list = false;
+        int count_type = 0;
+    };
+    struct PlyElement {
+        std::string name;
+        size_t count = 0;
+        std::vector<PlyProperty> props;
+    };
+    struct PlyHeader {
+        PLY_FORMAT format = PLY_FORMAT::ASCII;
+        std::vector<PlyElement> elements;
+        const char* body = nullptr;
+    };
+
+    static int plyType(const std::string& t, const std::string& filename) {
+        if (t == "char" || t == "int8")
+            return -1;
+        if (t == "uchar" || t == "uint8")
+            return 1;
+        if (t == "short" || t == "int16")
+            return -2;
+        if (t == "ushort" || t == "uint16")
+            return 2;
+        if (t == "int" || t == "int32")
+            return -4;
+        if (t == "uint" || t == "uint32")
+            return 4;
+        if (t == "float" || t == "float32")
+            return 0x10 | 4;
+        if (t == "double" || t == "float64")
+            return 0x10 | 8;
+        throw std::runtime_error("Unknown property type " + t + " in PLY file " + filename);
+    }
+    static size_t plyTypeSize(int type) { return (size_t)((type < 0) ? -type : (type & 0xF)); }
+
+    static PlyHeader parsePlyHeader(const char* p, const char* end, const std::string& filename) {
+        PlyHeader hdr;
+        bool first = true;
+        while (p < end) {
+            const char* line_end = static_cast<const char*>(std::memchr(p, '\n', end - p));
+            if (!line_end)
+                throw std::runtime_error("PLY header has no end_header in file " + filename);
+            std::vector<std::string> toks;
+            const char* q = p;
+            while (true) {
+                const char* e = nextToken(q, line_end);
+                if (q == e)
+                    break;
+                toks.emplace_back(q, e);
+                q = e;
+            }
+            p = line_end + 1;
+            if (first) {
+                if (toks.empty() || toks[0] != "ply")
+                    throw std::runtime_error(filename + " is not a PLY file");
+                first = false;
+                continue;
+            }
+            if (toks.empty() || toks[0] == "comment" || toks[0] == "obj_info")
+                continue;
+            if (toks[0] == "end_header") {
+                hdr.body = p;
+                return hdr;
+            }
+            if (toks[0] == "format" && toks.size() >= 2) {
+                if (toks[1] == "ascii")
+                    hdr.format = PLY_FORMAT::ASCII;
+                else if (toks[1] == "binary_little_endian")
+                    hdr.format = PLY_FORMAT::BINARY_LE;
+                else if (toks[1] == "binary_big_endian")
+                    hdr.format = PLY_FORMAT::BINARY_BE;
+                else
+                    throw std::runtime_error("Unknown PLY format " + toks[1] + " in file " + filename);
+            } else if (toks[0] == "element" && toks.size() >= 3) {
+                PlyElement el;
+                el.name = toks[1];
+                el.count = (size_t)std::stoull(toks[2]);
+                hdr.elements.push_back(el);
+            } else if (toks[0] == "property" && !hdr.elements.empty()) {
+                PlyProperty prop;
+                if (toks.size() >= 5 && toks[1] == "list") {
+                    prop.is_list = true;
+                    prop.count_type = plyType(toks[2], filename);
+                    prop.type = plyType(toks[3], filename);
+                    prop.name = toks[4];
+                } else if (toks.size() >= 3) {
+                    prop.type = plyType(toks[1], filename);
+                    prop.name = toks[2];
+                } else {
+                    throw std::runtime_error("Malformed property line in PLY file " + filename);
+                }
+                hdr.elements.back().props.push_back(prop);
+            }
+        }
+        throw std::runtime_error("PLY header has no end_header in file " + filename);
+    }
+
+    // Decode one binary scalar
+    static double plyBinaryValue(const char* p, int type, bool big_endian) {
+        char buf[8];
+        const size_t n = plyTypeSize(type);
+        std::memcpy(buf, p, n);
+        if (big_endian)
+            std::reverse(buf, buf + n);
+        switch (type) {
+            case -1:
+                return (double)*reinterpret_cast<int8_t*>(buf);
+            case 1:
+                return (double)*reinterpret_cast<uint8_t*>(buf);
+            case -2: {
+                int16_t v;
+                std::memcpy(&v, buf, 2);
+                return v;
+            }
+            case 2: {
+                uint16_t v;
+                std::memcpy(&v, buf, 2);
+                return v;
+            }
+            case -4: {
+                int32_t v;
+                std::memcpy(&v, buf, 4);
+                return v;
+            }
+            case 4: {
+                uint32_t v;
+                std::memcpy(&v, buf, 4);
+                return v;
+            }
+            case 0x14: {
+                float v;
+                std::memcpy(&v, buf, 4);
+                return v;
+            }
+            default: {
+                double v;
+                std::memcpy(&v, buf, 8);
+                return v;
+            }
+        }
+    }
+
+    // Read the next scalar of an element record; p is advanced past it
+    static double plyValue(const PlyHeader& hdr,
+                           int type,
+                           const char*& p,
+                           const char* end,
+                           const std::string& filename) {
+        if (hdr.format == PLY_FORMAT::ASCII) {
+            // Skip line breaks too: ASCII records are whitespace-separated
+            while (p < end && (isBlank(*p) || *p == '\n'))
+                p++;
+            const char* q = p;
+            while (q < end && !isBlank(*q) && *q != '\n')
+                q++;
+            double v = 0.;
+            std::from_chars_result res = std::from_chars((p < q && *p == '+') ? p + 1 : p, q, v);
+            if (p == q || res.ec != std::errc())
+                throw std::runtime_error("Malformed or truncated data in PLY file " + filename);
+            p = q;
+            return v;
+        }
+        const size_t n = plyTypeSize(type);
+        if ((size_t)(end - p) < n)
+            throw std::runtime_error("Truncated data in PLY file " + filename);
+        double v = plyBinaryValue(p, type, hdr.format == PLY_FORMAT::BINARY_BE);
+        p += n;
+        return v;
+    }
+
+    const char* readPlyVertices(const PlyHeader& hdr,
+                                const PlyElement& el,
+                                const char* p,
+                                const char* end,
+                                TriMeshData& mesh,
+                                const std::string& filename) const {
+        // Where each useful property goes: 0-2 xyz, 3-5 normal, 6-7 uv, -1 ignored
+        std::vector<int> slot(el.props.size(), -1);
+        bool has_n = false, has_uv = false, fixed_size = true;
+        size_t rec_size = 0;
+        std::vector<size_t> offset(el.props.size(), 0);
+        for (size_t i = 0; i < el.props.size(); i++) {
+            const std::string& nm = el.props[i].name;
+            if (nm == "x" || nm == "y" || nm == "z")
+                slot[i] = nm[0] - 'x';
+            else if (nm == "nx" || nm == "ny" || nm == "nz")
+                slot[i] = 3 + (nm[1] - 'x');
+            else if (nm == "u" || nm == "s" || nm == "texture_u")
+                slot[i] = 6;
+            else if (nm == "v" || nm == "t" || nm == "texture_v")
+                slot[i] = 7;
+            has_n = has_n || (slot[i] >= 3 && slot[i] <= 5);
+            has_uv = has_uv || slot[i] >= 6;
+            if (el.props[i].is_list)
+                fixed_size = false;
+            offset[i] = rec_size;
+            rec_size += plyTypeSize(el.props[i].type);
+        }
+        const size_t nv = el.count;
+        mesh.vertices.assign(nv * 3, 0.f);
+        if (has_n)
+            mesh.normals.assign(nv * 3, 0.f);
+        if (has_uv)
+            mesh.uv.assign(nv * 2, 0.f);
+        auto store = [&](size_t v, int s, double val) {
+            if (s < 0)
+                return;
+            if (s < 3)
+                mesh.vertices[v * 3 + s] = (float)val;
+            else if (s < 6)
+                mesh.normals[v * 3 + s - 3] = (float)val;
+            else
+                mesh.uv[v * 2 + s - 6] = (float)val;
+        };
+
+        if (hdr.format != PLY_FORMAT::ASCII && fixed_size) {
+            if ((size_t)(end - p) < nv * rec_size)
+                throw std::runtime_error("Truncated vertex data in PLY file " + filename);
+            const bool be = hdr.format == PLY_FORMAT::BINARY_BE;
+            const size_t n_chunks = (nv < PARALLEL_MIN_ITEMS) ? 1 : m_n_threads;
+            runChunks(n_chunks, [&](size_t t) {
+                for (size_t v = nv * t / n_chunks; v < nv * (t + 1) / n_chunks; v++) {
+                    const char* rec = p + v * rec_size;
+                    for (size_t i = 0; i < el.props.size(); i++)
+                        store(v, slot[i], plyBinaryValue(rec + offset[i], el.props[i].type, be));
+                }
+            });
+            return p + nv * rec_size;
+        }
+        for (size_t v = 0; v < nv; v++) {
+            for (size_t i = 0; i < el.props.size(); i++) {
+                const PlyProperty& prop = el.props[i];
+                if (prop.is_list) {
+                    const size_t cnt = (size_t)plyValue(hdr, prop.count_type, p, end, filename);
+                    for (size_t k = 0; k < cnt; k++)
+                        plyValue(hdr, prop.type, p, end, filename);
+                } else {
+                    store(v, slot[i], plyValue(hdr, prop.type, p, end, filename));
+                }
+            }
+        }
+        return p;
+    }
+
+    static const char* readPlyFaces(const PlyHeader& hdr,
+                                    const PlyElement& el,
+                                    const char* p,
+                                    const char* end,
+                                    TriMeshData& mesh,
+                                    const std::string& filename) {
+        std::vector<int> poly;
+        for (size_t f = 0; f < el.count; f++) {
+            for (const PlyProperty& prop : el.props) {
+                if (!prop.is_list) {
+                    plyValue(hdr, prop.type, p, end, filename);
+                    continue;
+                }
+                const size_t cnt = (size_t)plyValue(hdr, prop.count_type, p, end, filename);
+                const bool is_index = (prop.name == "vertex_indices" || prop.name == "vertex_index");
+                poly.clear();
+                for (size_t k = 0; k < cnt; k++)
+                    poly.push_back((int)plyValue(hdr, prop.type, p, end, filename));
+                if (!is_index)
+                    continue;
+                // Triangle fan around the first corner
+                for (size_t i = 2; i < poly.size(); i++) {
+                    mesh.face_v.push_back(poly[0]);
+                    mesh.face_v.push_back(poly[i - 1]);
+                    mesh.face_v.push_back(poly[i]);
+                }
+            }
+        }
+        return p;
+    }
+
+    static const char* skipPlyElement(const PlyHeader& hdr,
+                                      const PlyElement& el,
+                                      const char* p,
+                                      const char* end,
+                                      const std::string& filename) {
+        for (size_t r = 0; r < el.count; r++) {
+            for (const PlyProperty& prop : el.props) {
+                const size_t cnt = prop.is_list ? (size_t)plyValue(hdr, prop.count_type, p, end, filename) : 1;
+                for (size_t k = 0; k < cnt; k++)
+                    plyValue(hdr, prop.type, p, end, filename);
+            }
+        }
+        return p;
+    }
+
+    template <typename T>
+    static void writeArray(std::ofstream& out, const std::vector<T>& vec) {
+        const uint64_t n = vec.size();
+        out.write(reinterpret_cast<const char*>(&n), sizeof(n));
+        out.write(reinterpret_cast<const char*>(vec.data()), n * sizeof(T));
+    }
+    template <typename T>
+    static bool readArray(std::ifstream& in, std::vector<T>& vec) {
+        uint64_t n = 0;
+        in.read(reinterpret_cast<char*>(&n), sizeof(n));
+        if (!in || n > ((uint64_t)1 << 40))
+            return false;
+        vec.resize(n);
+        in.read(reinterpret_cast<char*>(vec.data()), n * sizeof(T));
+        return (bool)in;
+    }
+    static bool indicesInRange(const std::vector<int>& indices, size_t n) {
+        return std::all_of(indices.begin(), indices.end(), [n](int i) { return i >= 0 && (size_t)i < n; });
+    }
+    static long processID() {
+#ifdef _WIN32
+        return (long)::_getpid();
+#else
+        return (long)::getpid();
+#endif
+    }
+};
+
+}  // namespace deme
+
+#endif
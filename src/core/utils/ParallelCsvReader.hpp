@@ -0,0 +1,320 @@
+//  Copyright (c) 2021, SBEL GPU Development Team
+//  Copyright (c) 2021, University of Wisconsin - Madison
+//
+//	SPDX-License-Identifier: BSD-3-Clause
+
+// A multithreaded reader for the plain, comma-separated files DEME writes (OUTPUT_FORMAT::CSV). The file is
+// memory-mapped, split at line boundaries across threads, and each requested column is parsed with std::from_chars
+// straight into a typed array in row order. Fields may be padded with spaces or tabs; quoting is not supported, same
+// as the CSVReader settings used elsewhere in DEME. Lines that are empty (or whitespace-only) are skipped.
+
+#ifndef DEME_PARALLEL_CSV_READER_HPP
+#define DEME_PARALLEL_CSV_READER_HPP
+
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+#include <core/utils/MappedFile.hpp>
+
+namespace deme {
+
+class ParallelCsvReader {
+  public:
+    /// @param filename CSV file to read. Its first non-empty line is the header.
+    /// @param nThreads Number of worker threads; 0 means std::thread::hardware_concurrency().
+    explicit ParallelCsvReader(const std::string& filename, unsigned int nThreads = 0)
+        : m_filename(filename), m_file(filename), m_data(m_file.data()), m_file_size(m_file.size()) {
+        m_n_threads = (nThreads > 0) ? nThreads : std::max(1u, std::thread::hardware_concurrency());
+        parseHeader();
+        indexRows();
+    }
+    ParallelCsvReader(const ParallelCsvReader&) = delete;
+    ParallelCsvReader& operator=(const ParallelCsvReader&) = delete;
+
+    size_t NumRows() const { return m_row_starts.size(); }
+    unsigned int NumThreads() const { return m_n_threads; }
+    const std::vector<std::string>& GetColumnNames() const { return m_col_names; }
+    bool HasColumn(const std::string& name) const { return m_name_to_col.count(name) > 0; }
+
+    /// Parse a numeric column (integral or floating-point T) into an array in row order.
+    template <typename T>
+    std::vector<T> Get(const std::string& name) const {
+        static_assert(std::is_arithmetic<T>::value, "ParallelCsvReader::Get only parses arithmetic types.");
+        const size_t col = findColumn(name);
+        std::vector<T> res(NumRows());
+        parallelFor(NumRows(), [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                std::string_view field = getField(i, col);
+                if (!parseNumber(field, res[i])) {
+                    throw std::runtime_error("Cannot parse \"" + std::string(field) + "\" in column " + name +
+                                             " of data row " + std::to_string(i) + " in CSV file " + m_filename);
+                }
+            }
+        });
+        return res;
+    }
+
+    /// Dictionary codes of a string column, one per row. Codes follow the order in which each string first appears.
+    std::vector<uint32_t> GetStringCodes(const std::string& name) const { return buildStringColumn(name).codes; }
+    /// The unique strings a string column's codes index into.
+    const std::vector<std::string>& GetStringDictionary(const std::string& name) const {
+        return buildStringColumn(name).dict;
+    }
+    /// Decoded string column.
+    std::vector<std::string> GetStrings(const std::string& name) const {
+        const StringColumn& str_col = buildStringColumn(name);
+        std::vector<std::string> res(NumRows());
+        for (size_t i = 0; i < NumRows(); i++)
+            res[i] = str_col.dict[str_col.codes[i]];
+        return res;
+    }
+
+  private:
+    struct StringColumn {
+        std::vector<uint32_t> codes;
+        std::vector<std::string> dict;
+    };
+
+    std::string m_filename;
+    MappedFile m_file;
+    const char* m_data;
+    size_t m_file_size;
+    unsigned int m_n_threads = 1;
+    std::vector<std::string> m_col_names;
+    std::unordered_map<std::string, size_t> m_name_to_col;
+    // Byte offset of the first line after the header
+    size_t m_body_start = 0;
+    // Byte offset of the first character of each data row
+    std::vector<size_t> m_row_starts;
+    // String columns are dictionary-encoded once and reused by GetStringCodes/GetStringDictionary/GetStrings
+    mutable std::unordered_map<size_t, StringColumn> m_string_cols;
+
+    // Files smaller than this are not worth spawning threads for
+    static constexpr size_t PARALLEL_MIN_BYTES = 1 << 20;
+    static constexpr size_t PARALLEL_MIN_ROWS = 1 << 14;
+
+    static bool isBlank(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+    size_t lineEnd(size_t pos) const {
+        const void* nl = std::memchr(m_data + pos, '\n', m_file_size - pos);
+        return nl ? (size_t)(static_cast<const char*>(nl) - m_data) : m_file_size;
+    }
+    bool lineIsBlank(size_t begin, size_t end) const {
+        for (size_t i = begin; i < end; i++) {
+            if (!isBlank(m_data[i]))
+                return false;
+        }
+        return true;
+    }
+    static std::string_view trim(const char* begin, const char* end) {
+        while (begin < end && isBlank(*begin))
+            begin++;
+        while (end > begin && isBlank(*(end - 1)))
+            end--;
+        return std::string_view(begin, end - begin);
+    }
+
+    // Run func(begin, end) over [0, n) split into contiguous chunks, one per thread. The first exception thrown by a
+    // worker is re-thrown on the calling thread.
+    template <typename Func>
+    void parallelFor(size_t n, const Func& func, size_t min_n = PARALLEL_MIN_ROWS) const {
+        const size_t n_chunks = (n < min_n) ? 1 : std::min<size_t>(m_n_threads, n);
+        if (n_chunks <= 1) {
+            func((size_t)0, n);
+            return;
+        }
+        std::vector<std::exception_ptr> errors(n_chunks);
+        std::vector<std::thread> workers;
+        workers.reserve(n_chunks);
+        for (size_t t = 0; t < n_chunks; t++) {
+            workers.emplace_back([&, t]() {
+                try {
+                    func(n * t / n_chunks, n * (t + 1) / n_chunks);
+                } catch (...) {
+                    errors[t] = std::current_exception();
+                }
+            });
+        }
+        for (auto& w : workers)
+            w.join();
+        for (const auto& e : errors) {
+            if (e)
+                std::rethrow_exception(e);
+        }
+    }
+
+    void parseHeader() {
+        size_t pos = 0;
+        // Skip leading empty lines
+        while (pos < m_file_size) {
+            size_t end = lineEnd(pos);
+            if (!lineIsBlank(pos, end))
+                break;
+            pos = end + 1;
+        }
+        if (pos >= m_file_size)
+            throw std::runtime_error("CSV file " + m_filename + " has no header line.");
+        const size_t end = lineEnd(pos);
+        const char* field_begin = m_data + pos;
+        const char* line_end = m_data + end;
+        while (true) {
+            const char* comma = std::find(field_begin, line_end, ',');
+            std::string col_name(trim(field_begin, comma));
+            if (m_name_to_col.count(col_name)) {
+                throw std::runtime_error("Column " + col_name + " appears more than once in CSV file " + m_filename);
+            }
+            m_name_to_col[col_name] = m_col_names.size();
+            m_col_names.push_back(std::move(col_name));
+            if (comma == line_end)
+                break;
+            field_begin = comma + 1;
+        }
+        m_body_start = std::min(end + 1, m_file_size);
+    }
+
+    // Find the start of every non-empty data line. Each thread owns the lines starting inside its byte range; a count
+    // pass sizes the output, then a fill pass writes the offsets in file order.
+    void indexRows() {
+        const size_t body_bytes = m_file_size - m_body_start;
+        const size_t n_chunks =
+            (body_bytes < PARALLEL_MIN_BYTES) ? 1 : std::min<size_t>(m_n_threads, body_bytes / 4096 + 1);
+        std::vector<size_t> bounds(n_chunks + 1);
+        bounds[0] = m_body_start;
+        bounds[n_chunks] = m_file_size;
+        for (size_t t = 1; t < n_chunks; t++) {
+            size_t raw = m_body_start + body_bytes * t / n_chunks;
+            // Move the boundary to the start of the next line, unless it already is one
+            bounds[t] = (m_data[raw - 1] == '\n') ? raw : std::min(lineEnd(raw) + 1, m_file_size);
+            bounds[t] = std::max(bounds[t], bounds[t - 1]);
+        }
+        std::vector<size_t> counts(n_chunks, 0);
+        auto scan = [&](size_t t, size_t* out) {
+            size_t pos = bounds[t];
+            size_t n = 0;
+            while (pos < bounds[t + 1]) {
+                const size_t end = lineEnd(pos);
+                if (!lineIsBlank(pos, end)) {
+                    if (out)
+                        out[n] = pos;
+                    n++;
+                }
+                pos = end + 1;
+            }
+            counts[t] = n;
+        };
+        runChunks(n_chunks, [&](size_t t) { scan(t, nullptr); });
+        std::vector<size_t> offsets(n_chunks + 1, 0);
+        for (size_t t = 0; t < n_chunks; t++)
+            offsets[t + 1] = offsets[t] + counts[t];
+        m_row_starts.resize(offsets[n_chunks]);
+        runChunks(n_chunks, [&](size_t t) { scan(t, m_row_starts.data() + offsets[t]); });
+    }
+
+    template <typename Func>
+    static void runChunks(size_t n_chunks, const Func& func) {
+        if (n_chunks <= 1) {
+            func((size_t)0);
+            return;
+        }
+        std::vector<std::thread> workers;
+        workers.reserve(n_chunks);
+        for (size_t t = 0; t < n_chunks; t++)
+            workers.emplace_back([&, t]() { func(t); });
+        for (auto& w : workers)
+            w.join();
+    }
+
+    size_t findColumn(const std::string& name) const {
+        auto it = m_name_to_col.find(name);
+        if (it == m_name_to_col.end())
+            throw std::runtime_error("Column " + name + " is not found in CSV file " + m_filename);
+        return it->second;
+    }
+
+    // The trimmed text of column col in data row row; empty if that row has fewer fields
+    std::string_view getField(size_t row, size_t col) const {
+        const char* p = m_data + m_row_starts[row];
+        const char* line_end = m_data + lineEnd(m_row_starts[row]);
+        for (size_t c = 0; c < col; c++) {
+            p = std::find(p, line_end, ',');
+            if (p == line_end)
+                return std::string_view();
+            p++;
+        }
+        return trim(p, std::find(p, line_end, ','));
+    }
+
+    template <typename T>
+    static bool parseNumber(std::string_view field, T& val) {
+        if (!field.empty() && field.front() == '+')
+            field.remove_prefix(1);
+        if (field.empty())
+            return false;
+        const char* end = field.data() + field.size();
+        std::from_chars_result res = std::from_chars(field.data(), end, val);
+        return res.ec == std::errc() && res.ptr == end;
+    }
+
+    // Dictionary-encode a string column. Each thread builds a local dictionary for its contiguous rows; merging them
+    // in thread order keeps the codes in first-appearance order, as the binary writer does.
+    const StringColumn& buildStringColumn(const std::string& name) const {
+        const size_t col = findColumn(name);
+        auto cached = m_string_cols.find(col);
+        if (cached != m_string_cols.end())
+            return cached->second;
+
+        const size_t n_rows = NumRows();
+        const size_t n_chunks = (n_rows < PARALLEL_MIN_ROWS) ? 1 : std::min<size_t>(m_n_threads, n_rows);
+        StringColumn str_col;
+        str_col.codes.resize(n_rows);
+        std::vector<std::vector<std::string_view>> local_dicts(n_chunks);
+        runChunks(n_chunks, [&](size_t t) {
+            std::unordered_map<std::string_view, uint32_t> lookup;
+            for (size_t i = n_rows * t / n_chunks; i < n_rows * (t + 1) / n_chunks; i++) {
+                std::string_view field = getField(i, col);
+                auto it = lookup.find(field);
+                if (it == lookup.end()) {
+                    it = lookup.emplace(field, (uint32_t)local_dicts[t].size()).first;
+                    local_dicts[t].push_back(field);
+                }
+                str_col.codes[i] = it->second;
+            }
+        });
+        // Merge local dictionaries, then translate local codes to global ones
+        std::unordered_map<std::string_view, uint32_t> global_lookup;
+        std::vector<std::vector<uint32_t>> remap(n_chunks);
+        for (size_t t = 0; t < n_chunks; t++) {
+            remap[t].resize(local_dicts[t].size());
+            for (size_t j = 0; j < local_dicts[t].size(); j++) {
+                auto it = global_lookup.find(local_dicts[t][j]);
+                if (it == global_lookup.end()) {
+                    it = global_lookup.emplace(local_dicts[t][j], (uint32_t)str_col.dict.size()).first;
+                    str_col.dict.emplace_back(local_dicts[t][j]);
+                }
+                remap[t][j] = it->second;
+            }
+        }
+        if (n_chunks > 1) {
+            runChunks(n_chunks, [&](size_t t) {
+                for (size_t i = n_rows * t / n_chunks; i < n_rows * (t + 1) / n_chunks; i++)
+                    str_col.codes[i] = remap[t][str_col.codes[i]];
+            });
+        }
+        return m_string_cols.emplace(col, std::move(str_col)).first->second;
+    }
+};
+
+}  // namespace deme
+
+#endif
@@ -10,6 +10,8 @@
 #include <condition_variable>
 #include <mutex>
 
+#include <core/utils/TimelineTracer.hpp>
+
 // class holds on to statistics related to the scheduling process
 class ManagerStatistics {
   public:
@@ -34,6 +36,9 @@ class ManagerStatistics {
     ~ManagerStatistics() {}
 };
 
+// Lanes of ThreadManager::tracer, one per thread
+enum TRACE_LANE : unsigned int { TRACE_LANE_MAIN = 0, TRACE_LANE_KINEMATIC = 1, TRACE_LANE_DYNAMIC = 2 };
+
 // class that will be used via an atomic object to coordinate the
 // production-consumption interplay
 class ThreadManager {
@@ -58,6 +63,8 @@ class ThreadManager {
     std::condition_variable cv_KinematicCanProceed;
     std::condition_variable cv_DynamicCanProceed;
     ManagerStatistics schedulingStats;
+    // Opt-in timeline of what the main thread, kT and dT are doing (off by default)
+    deme::TimelineTracer tracer = deme::TimelineTracer({"Main thread", "kT", "dT"});
 
     // The following variables are used to ensure that when an instance of d or k thread is created, a while loop that
     // spins in place is created. It does actual work only when we tell it all preparations are done and it can proceed
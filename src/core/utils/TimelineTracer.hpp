@@ -0,0 +1,156 @@
+//  Copyright (c) 2021, SBEL GPU Development Team
+//  Copyright (c) 2021, University of Wisconsin - Madison
+//
+//	SPDX-License-Identifier: BSD-3-Clause
+
+// An opt-in, low-overhead timeline recorder for the solver threads. Each thread records into its own lane (no locking),
+// every event being one named, timed interval tagged with a step stamp. The timeline is exported in the Chrome trace
+// event format, viewable in chrome://tracing or https://ui.perfetto.dev.
+
+#ifndef DEME_TIMELINE_TRACER_HPP
+#define DEME_TIMELINE_TRACER_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace deme {
+
+class TimelineTracer {
+  public:
+    struct Event {
+        // Must point to a string with static storage duration (usually a literal)
+        const char* name;
+        int64_t start_ns;
+        int64_t dur_ns;
+        int64_t step;
+    };
+
+    explicit TimelineTracer(const std::vector<std::string>& lane_names)
+        : m_lane_names(lane_names), m_lanes(lane_names.size()), m_dropped(lane_names.size(), 0) {
+        m_origin = now();
+    }
+
+    /// Start (or stop) recording. max_events_per_lane events are pre-allocated per lane, so recording never allocates;
+    /// events beyond that are dropped and counted. Call it only when no thread is recording.
+    void Enable(bool on = true, size_t max_events_per_lane = 1 << 20) {
+        if (on) {
+            for (auto& lane : m_lanes)
+                lane.reserve(max_events_per_lane);
+            m_capacity = max_events_per_lane;
+        }
+        m_enabled.store(on, std::memory_order_release);
+    }
+    bool IsEnabled() const { return m_enabled.load(std::memory_order_relaxed); }
+
+    /// Forget all recorded events. Call it only when no thread is recording.
+    void Clear() {
+        for (auto& lane : m_lanes)
+            lane.clear();
+        std::fill(m_dropped.begin(), m_dropped.end(), 0);
+        m_origin = now();
+    }
+
+    static int64_t now() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch())
+            .count();
+    }
+
+    /// Record an interval on a lane. Only the thread owning this lane may call it.
+    void Record(unsigned int lane, const char* name, int64_t start_ns, int64_t end_ns, int64_t step) {
+        std::vector<Event>& events = m_lanes[lane];
+        if (events.size() >= m_capacity) {
+            m_dropped[lane]++;
+            return;
+        }
+        events.push_back(Event{name, start_ns, end_ns - start_ns, step});
+    }
+
+    size_t NumEvents() const {
+        size_t n = 0;
+        for (const auto& lane : m_lanes)
+            n += lane.size();
+        return n;
+    }
+    size_t NumDropped() const {
+        size_t n = 0;
+        for (const auto& d : m_dropped)
+            n += d;
+        return n;
+    }
+
+    /// Write the recorded events as a Chrome trace JSON document. Call it only when no thread is recording.
+    void WriteChromeTrace(std::ostream& out) const {
+        char buf[256];
+        out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+        bool first = true;
+        for (size_t lane = 0; lane < m_lanes.size(); lane++) {
+            out << (first ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << lane
+                << ",\"args\":{\"name\":\"" << m_lane_names[lane] << "\"}}";
+            out << ",\n{\"name\":\"thread_sort_index\",\"ph\":\"M\",\"pid\":1,\"tid\":" << lane
+                << ",\"args\":{\"sort_index\":" << lane << "}}";
+            first = false;
+        }
+        for (size_t lane = 0; lane < m_lanes.size(); lane++) {
+            for (const auto& e : m_lanes[lane]) {
+                // Chrome traces are in microseconds
+                std::snprintf(buf, sizeof(buf),
+                              ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%zu,\"ts\":%.3f,\"dur\":%.3f,"
+                              "\"args\":{\"step\":%lld}}",
+                              e.name, lane, (double)(e.start_ns - m_origin) * 1e-3, (double)e.dur_ns * 1e-3,
+                              (long long)e.step);
+                out << buf;
+            }
+        }
+        out << "\n]}\n";
+    }
+    void WriteChromeTrace(const std::string& filename) const {
+        std::ofstream out(filename);
+        if (!out)
+            throw std::runtime_error("Cannot open " + filename + " for writing the timeline trace.");
+        WriteChromeTrace(out);
+    }
+
+  private:
+    std::vector<std::string> m_lane_names;
+    std::vector<std::vector<Event>> m_lanes;
+    std::vector<size_t> m_dropped;
+    size_t m_capacity = 0;
+    std::atomic<bool> m_enabled{false};
+    int64_t m_origin = 0;
+};
+
+/// Records the lifetime of this object as one event, if the tracer is enabled when it is created.
+class TraceScope {
+  public:
+    TraceScope(TimelineTracer& tracer, unsigned int lane, const char* name, int64_t step)
+        : m_tracer(tracer), m_lane(lane), m_name(name), m_step(step) {
+        if (m_tracer.IsEnabled())
+            m_start = TimelineTracer::now();
+    }
+    ~TraceScope() {
+        if (m_start >= 0)
+            m_tracer.Record(m_lane, m_name, m_start, TimelineTracer::now(), m_step);
+    }
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+  private:
+    TimelineTracer& m_tracer;
+    unsigned int m_lane;
+    const char* m_name;
+    int64_t m_step;
+    int64_t m_start = -1;
+};
+
+}  // namespace deme
+
+#endif
@@ -0,0 +1,307 @@
+//  Copyright (c) 2021, SBEL GPU Development Team
+//  Copyright (c) 2021, University of Wisconsin - Madison
+//
+//	SPDX-License-Identifier: BSD-3-Clause
+
+// A writer of VTK XML files (.vtp PolyData point clouds and .vtu UnstructuredGrids), storing all arrays as appended raw
+// binary data, optionally zlib-compressed (when built with DEME_USE_ZLIB). The files are read by ParaView and VisIt.
+//
+// Every array is one block of the AppendedData section, prefixed by a UInt64 header: its byte size if uncompressed, or
+// [#blocks, block size, last partial block size, compressed size of each block] if compressed.
+
+#ifndef DEME_VTK_XML_WRITER_HPP
+#define DEME_VTK_XML_WRITER_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <ostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#ifdef DEME_USE_ZLIB
+    #include <zlib.h>
+#endif
+
+namespace deme {
+
+// The kinds of VTK XML dataset this writer produces
+enum class VTK_XML_DATASET { POLY_DATA, UNSTRUCTURED_GRID };
+
+// VTK cell type of a triangle
+const uint8_t VTK_CELL_TRIANGLE = 5;
+
+template <typename T>
+struct VtkTypeNameOf;
+#define DEME_VTK_TYPE_NAME_OF(cpp_type, name)                 \
+    template <>                                               \
+    struct VtkTypeNameOf<cpp_type> {                          \
+        static const char* value() { return name; }           \
+    };
+DEME_VTK_TYPE_NAME_OF(int8_t, "Int8")
+DEME_VTK_TYPE_NAME_OF(uint8_t, "UInt8")
+DEME_VTK_TYPE_NAME_OF(int16_t, "Int16")
+DEME_VTK_TYPE_NAME_OF(uint16_t, "UInt16")
+DEME_VTK_TYPE_NAME_OF(int32_t, "Int32")
+DEME_VTK_TYPE_NAME_OF(uint32_t, "UInt32")
+DEME_VTK_TYPE_NAME_OF(int64_t, "Int64")
+DEME_VTK_TYPE_NAME_OF(uint64_t, "UInt64")
+DEME_VTK_TYPE_NAME_OF(float, "Float32")
+DEME_VTK_TYPE_NAME_OF(double, "Float64")
+#undef DEME_VTK_TYPE_NAME_OF
+
+class VtkXmlWriter {
+  public:
+    explicit VtkXmlWriter(VTK_XML_DATASET kind, bool compress = false) : m_kind(kind), m_compress(compress) {
+        if (compress && !CompressionAvailable()) {
+            throw std::runtime_error("VTK XML compression needs zlib, which was not found when DEME was built.");
+        }
+    }
+
+    static bool CompressionAvailable() {
+#ifdef DEME_USE_ZLIB
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    /// Set the point coordinates, 3 per point.
+    void SetPoints(std::vector<float> xyz) {
+        if (xyz.size() % 3 != 0)
+            throw std::runtime_error("VTK point coordinates must come in triplets.");
+        m_n_points = xyz.size() / 3;
+        m_points = makeArray("Points", std::move(xyz), 3);
+    }
+
+    /// Set the cells of an UnstructuredGrid: cell i uses connectivity[offsets[i-1], offsets[i]) and is of VTK type
+    /// types[i].
+    void SetCells(std::vector<int64_t> connectivity, std::vector<int64_t> offsets, std::vector<uint8_t> types) {
+        if (m_kind != VTK_XML_DATASET::UNSTRUCTURED_GRID)
+            throw std::runtime_error("Only VTK UnstructuredGrids have cells.");
+        if (offsets.size() != types.size())
+            throw std::runtime_error("VTK cell offsets and types must have the same length.");
+        m_n_cells = offsets.size();
+        m_cells.clear();
+        m_cells.push_back(makeArray("connectivity", std::move(connectivity), 1));
+        m_cells.push_back(makeArray("offsets", std::move(offsets), 1));
+        m_cells.push_back(makeArray("types", std::move(types), 1));
+    }
+    /// Set triangle cells, 3 vertex indices per triangle.
+    void SetTriangles(std::vector<int64_t> connectivity) {
+        const size_t n_tri = connectivity.size() / 3;
+        std::vector<int64_t> offsets(n_tri);
+        for (size_t i = 0; i < n_tri; i++)
+            offsets[i] = 3 * (int64_t)(i + 1);
+        SetCells(std::move(connectivity), std::move(offsets), std::vector<uint8_t>(n_tri, VTK_CELL_TRIANGLE));
+    }
+
+    /// Add an array of n_components values per point.
+    template <typename T>
+    void AddPointData(const std::string& name, std::vector<T> data, unsigned int n_components = 1) {
+        checkSize(name, data.size(), m_n_points * n_components);
+        m_point_data.push_back(makeArray(name, std::move(data), n_components));
+    }
+    /// Add an array of n_components values per cell.
+    template <typename T>
+    void AddCellData(const std::string& name, std::vector<T> data, unsigned int n_components = 1) {
+        checkSize(name, data.size(), m_n_cells * n_components);
+        m_cell_data.push_back(makeArray(name, std::move(data), n_components));
+    }
+
+    size_t NumPoints() const { return m_n_points; }
+    size_t NumCells() const { return m_n_cells; }
+
+    /// Write the file to a stream (which should be opened in binary mode).
+    void Write(std::ostream& out) const {
+        // Encode all blocks first: the XML header needs their offsets
+        std::vector<const Array*> arrays;
+        for (const auto& a : m_point_data)
+            arrays.push_back(&a);
+        for (const auto& a : m_cell_data)
+            arrays.push_back(&a);
+        arrays.push_back(&m_points);
+        for (const auto& a : m_cells)
+            arrays.push_back(&a);
+        std::vector<std::vector<char>> blocks(arrays.size());
+        std::vector<uint64_t> offsets(arrays.size());
+        uint64_t cursor = 0;
+        for (size_t i = 0; i < arrays.size(); i++) {
+            blocks[i] = encode(*arrays[i]);
+            offsets[i] = cursor;
+            cursor += blocks[i].size();
+        }
+
+        const char* dataset = (m_kind == VTK_XML_DATASET::POLY_DATA) ? "PolyData" : "UnstructuredGrid";
+        std::ostringstream xml;
+        xml << "<?xml version=\"1.0\"?>\n";
+        xml << "<VTKFile type=\"" << dataset << "\" version=\"1.0\" byte_order=\""
+            << (hostIsLittleEndianVtk() ? "LittleEndian" : "BigEndian") << "\" header_type=\"UInt64\"";
+        if (m_compress)
+            xml << " compressor=\"vtkZLibDataCompressor\"";
+        xml << ">\n  <" << dataset << ">\n";
+        if (m_kind == VTK_XML_DATASET::POLY_DATA) {
+            xml << "    <Piece NumberOfPoints=\"" << m_n_points
+                << "\" NumberOfVerts=\"0\" NumberOfLines=\"0\" NumberOfStrips=\"0\" NumberOfPolys=\"0\">\n";
+        } else {
+            xml << "    <Piece NumberOfPoints=\"" << m_n_points << "\" NumberOfCells=\"" << m_n_cells << "\">\n";
+        }
+        size_t k = 0;
+        xml << "      <PointData>\n";
+        for (size_t i = 0; i < m_point_data.size(); i++, k++)
+            writeArrayTag(xml, *arrays[k], offsets[k]);
+        xml << "      </PointData>\n      <CellData>\n";
+        for (size_t i = 0; i < m_cell_data.size(); i++, k++)
+            writeArrayTag(xml, *arrays[k], offsets[k]);
+        xml << "      </CellData>\n      <Points>\n";
+        writeArrayTag(xml, *arrays[k], offsets[k]);
+        k++;
+        xml << "      </Points>\n";
+        if (m_kind == VTK_XML_DATASET::UNSTRUCTURED_GRID) {
+            xml << "      <Cells>\n";
+            for (size_t i = 0; i < m_cells.size(); i++, k++)
+                writeArrayTag(xml, *arrays[k], offsets[k]);
+            xml << "      </Cells>\n";
+        }
+        xml << "    </Piece>\n  </" << dataset << ">\n  <AppendedData encoding=\"raw\">\n   _";
+        out << xml.str();
+        for (const auto& block : blocks)
+            out.write(block.data(), block.size());
+        out << "\n  </AppendedData>\n</VTKFile>\n";
+    }
+    void Write(const std::string& filename) const {
+        std::ofstream out(filename, std::ios::out | std::ios::binary);
+        if (!out)
+            throw std::runtime_error("Cannot open " + filename + " for writing.");
+        Write(out);
+    }
+
+  private:
+    struct Array {
+        std::string name;
+        const char* type = "Float32";
+        unsigned int n_components = 1;
+        size_t elem_size = 4;
+        std::vector<char> bytes;
+    };
+
+    // Size of the pieces compressed independently; they are compressed in parallel
+    static constexpr size_t COMPRESSION_BLOCK_SIZE = 1 << 20;
+
+    VTK_XML_DATASET m_kind;
+    bool m_compress;
+    size_t m_n_points = 0;
+    size_t m_n_cells = 0;
+    Array m_points = makeArray("Points", std::vector<float>(), 3);
+    std::vector<Array> m_cells;
+    std::vector<Array> m_point_data;
+    std::vector<Array> m_cell_data;
+
+    template <typename T>
+    static Array makeArray(const std::string& name, std::vector<T>&& data, unsigned int n_components) {
+        Array a;
+        a.name = name;
+        a.type = VtkTypeNameOf<T>::value();
+        a.n_components = n_components;
+        a.elem_size = sizeof(T);
+        a.bytes.resize(data.size() * sizeof(T));
+        if (!data.empty())
+            std::memcpy(a.bytes.data(), data.data(), a.bytes.size());
+        return a;
+    }
+
+    static void checkSize(const std::string& name, size_t n, size_t expected) {
+        if (n != expected) {
+            throw std::runtime_error("VTK array " + name + " has " + std::to_string(n) + " values, but " +
+                                     std::to_string(expected) + " were expected.");
+        }
+    }
+
+    static bool hostIsLittleEndianVtk() {
+        const uint16_t probe = 1;
+        uint8_t first_byte;
+        std::memcpy(&first_byte, &probe, 1);
+        return first_byte == 1;
+    }
+
+    static void writeArrayTag(std::ostream& xml, const Array& a, uint64_t offset) {
+        xml << "        <DataArray type=\"" << a.type << "\" Name=\"" << a.name << "\" NumberOfComponents=\""
+            << a.n_components << "\" format=\"appended\" offset=\"" << offset << "\"/>\n";
+    }
+
+    static void appendUInt64(std::vector<char>& buf, uint64_t val) {
+        const size_t pos = buf.size();
+        buf.resize(pos + sizeof(uint64_t));
+        std::memcpy(buf.data() + pos, &val, sizeof(uint64_t));
+    }
+
+    // Turn an array into its appended-data block, header included
+    std::vector<char> encode(const Array& a) const {
+        std::vector<char> block;
+        if (!m_compress) {
+            block.reserve(sizeof(uint64_t) + a.bytes.size());
+            appendUInt64(block, a.bytes.size());
+            block.insert(block.end(), a.bytes.begin(), a.bytes.end());
+            return block;
+        }
+#ifdef DEME_USE_ZLIB
+        const size_t n_bytes = a.bytes.size();
+        const size_t n_blocks = (n_bytes + COMPRESSION_BLOCK_SIZE - 1) / COMPRESSION_BLOCK_SIZE;
+        std::vector<std::vector<char>> compressed(n_blocks);
+        auto compress_block = [&](size_t b) {
+            const size_t start = b * COMPRESSION_BLOCK_SIZE;
+            const uLong src_len = (uLong)std::min(COMPRESSION_BLOCK_SIZE, n_bytes - start);
+            uLongf dst_len = compressBound(src_len);
+            compressed[b].resize(dst_len);
+            if (compress2((Bytef*)compressed[b].data(), &dst_len, (const Bytef*)a.bytes.data() + start, src_len,
+                          Z_DEFAULT_COMPRESSION) != Z_OK) {
+                throw std::runtime_error("Failed to compress VTK array " + a.name + ".");
+            }
+            compressed[b].resize(dst_len);
+        };
+        const size_t n_threads =
+            std::min<size_t>(n_blocks, std::max<unsigned int>(1, std::thread::hardware_concurrency()));
+        if (n_threads <= 1) {
+            for (size_t b = 0; b < n_blocks; b++)
+                compress_block(b);
+        } else {
+            std::vector<std::thread> pool;
+            std::vector<std::exception_ptr> errors(n_threads);
+            for (size_t t = 0; t < n_threads; t++) {
+                pool.emplace_back([&, t]() {
+                    try {
+                        for (size_t b = t; b < n_blocks; b += n_threads)
+                            compress_block(b);
+                    } catch (...) {
+                        errors[t] = std::current_exception();
+                    }
+                });
+            }
+            for (auto& th : pool)
+                th.join();
+            for (const auto& e : errors) {
+                if (e)
+                    std::rethrow_exception(e);
+            }
+        }
+        appendUInt64(block, n_blocks);
+        appendUInt64(block, COMPRESSION_BLOCK_SIZE);
+        appendUInt64(block, n_bytes % COMPRESSION_BLOCK_SIZE);
+        for (const auto& c : compressed)
+            appendUInt64(block, c.size());
+        for (const auto& c : compressed)
+            block.insert(block.end(), c.begin(), c.end());
+#endif
+        return block;
+    }
+};
+
+}  // namespace deme
+
+#endif
@@ -0,0 +1,68 @@
+//  Copyright (c) 2021, SBEL GPU Development Team
+//  Copyright (c) 2021, University of Wisconsin - Madison
+//
+//	SPDX-License-Identifier: BSD-3-Clause
+
+// =============================================================================
+// A check of the cost-model bin size tuner, replayed (ReplayBinSizeTuner) over a
+// synthetic sweep of CD statistics, so it needs no GPU. The statistics follow
+// the tuner's own scaling laws for a packing of equal spheres, and the CD time
+// has a clear optimal bin size. Starting from bin sizes well below and well
+// above it, the tuner should get there within a few decision periods, and stay.
+// Returns non-zero if it does not.
+// =============================================================================
+
+#include <DEM/BinSizeTuner.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+
+using namespace deme;
+
+int main() {
+    // A million spheres of diameter 0.02 in a unit-volume domain, at a sweep of bin sizes
+    const double num_spheres = 1e6, diameter = 0.02, domain_volume = 1.;
+    std::vector<CDStatsRecord> records;
+    for (double b = 0.005; b < 0.5; b *= 1.1) {
+        CDStatsRecord rec;
+        rec.bin_size = b;
+        rec.num_spheres = (size_t)num_spheres;
+        const double pairs = num_spheres * std::pow(1. + diameter / b, 3);
+        const double active = std::min(pairs, domain_volume / (b * b * b));
+        const double per_bin = pairs / active;
+        rec.num_sph_bin_pairs = (size_t)pairs;
+        rec.num_active_bins = (size_t)active;
+        rec.num_pair_candidates = active * per_bin * per_bin / 2.;
+        rec.max_sph_in_bin = (size_t)(2. * per_bin + 1.);
+        rec.cd_time = 1e-3 + 2e-8 * pairs + 1e-8 * active + 5e-9 * rec.num_pair_candidates;
+        records.push_back(rec);
+    }
+
+    BinSizeLimits limits;
+    limits.max_sph_in_bin = 1000;
+    bool ok = true;
+    for (double init_bin_size : {0.01, 0.2}) {
+        CostModelBinSizeTuner tuner;
+        auto res = ReplayBinSizeTuner(tuner, records, init_bin_size, 20, 25, limits);
+        // Once converged, it should not wander off either
+        double worst_after = 0.;
+        for (size_t p = res.periods_to_converge; p < res.cd_times.size(); p++)
+            worst_after = std::max(worst_after, res.cd_times[p]);
+        printf("Start at bin size %g: converged in %zu periods to bin size %g (best recorded %g), worst CD time after "
+               "that %g s (best %g s)\n",
+               init_bin_size, res.periods_to_converge, res.bin_sizes.back(), res.best_bin_size, worst_after,
+               res.best_time);
+        if (res.periods_to_converge < 1 || res.periods_to_converge > 4 || worst_after > 1.05 * res.best_time)
+            ok = false;
+    }
+
+    if (!ok) {
+        std::cout << "The cost-model bin size tuner did not converge in 1 to 4 decision periods!" << std::endl;
+        return 1;
+    }
+    std::cout << "The cost-model bin size tuner converged." << std::endl;
+    std::cout << "DEMdemo_BinSizeTuner exiting..." << std::endl;
+    return 0;
+}
@@ -0,0 +1,47 @@
+//  Copyright (c) 2021, SBEL GPU Development Team
+//  Copyright (c) 2021, University of Wisconsin - Madison
+//
+//	SPDX-License-Identifier: BSD-3-Clause
+
+// =============================================================================
+// A check of the drift controllers on the synthetic model of the dT--kT pipeline
+// (SimulateDriftController), so it needs no GPU. The predictive controller sizes
+// the drift from measured latencies, and should make dT wait for kT far less
+// often than the step-count one, most of all when CD is slow. Returns non-zero
+// if it does not.
+// =============================================================================
+
+#include <DEM/DriftController.h>
+
+#include <cstdio>
+#include <iostream>
+
+using namespace deme;
+
+int main() {
+    // CD times from about 2 to 20 dT steps; the slowest is the one checked
+    const double cd_times[] = {2e-3, 5e-3, 2e-2};
+    DriftSimResult step_count_res, predictive_res;
+    for (double cd_time : cd_times) {
+        DriftSimParams params;
+        params.cd_time = cd_time;
+        StepCountDriftController step_count;
+        PredictiveDriftController predictive;
+        step_count_res = SimulateDriftController(step_count, params);
+        predictive_res = SimulateDriftController(predictive, params);
+        printf("CD time %.0f ms | step-count: %.1f steps/s, %zu waits, avg drift %.1f | predictive: %.1f steps/s, %zu "
+               "waits, avg drift %.1f\n",
+               cd_time * 1e3, step_count_res.steps_per_second, step_count_res.num_waits, step_count_res.avg_drift,
+               predictive_res.steps_per_second, predictive_res.num_waits, predictive_res.avg_drift);
+    }
+
+    // With slow CD, the predictive controller should wait well under half as often, and not finish later
+    if (2 * predictive_res.num_waits >= step_count_res.num_waits ||
+        predictive_res.total_time > step_count_res.total_time) {
+        std::cout << "The predictive drift controller does not beat the step-count one!" << std::endl;
+        return 1;
+    }
+    std::cout << "The predictive drift controller waits less than the step-count one." << std::endl;
+    std::cout << "DEMdemo_DriftController exiting..." << std::endl;
+    return 0;
+}
@@ -0,0 +1,81 @@
+//  Copyright (c) 2021, SBEL GPU Development Team
+//  Copyright (c) 2021, University of Wisconsin - Madison
+//
+//	SPDX-License-Identifier: BSD-3-Clause
+
+// =============================================================================
+// A check of host-side contact detection (UseHostContactDetection) against the
+// device one. The same scene, a pile of fixed clumps sitting in a box, is set
+// up twice, and the contacts both find must be the same. Returns non-zero if
+// they differ.
+// =============================================================================
+
+#include <core/ApiVersion.h>
+#include <core/utils/ThreadManager.h>
+#include <DEM/API.h>
+#include <DEM/HostSideHelpers.hpp>
+#include <DEM/utils/Samplers.hpp>
+
+#include <algorithm>
+#include <cstdio>
+#include <random>
+#include <filesystem>
+
+using namespace deme;
+
+// Build the scene and return the contacts found after a few CD runs
+std::vector<std::pair<bodyID_t, bodyID_t>> ContactsOfScene(bool use_host_cd, std::vector<float3> xyz) {
+    DEMSolver DEMSim;
+    DEMSim.SetVerbosity(WARNING);
+    DEMSim.UseHostContactDetection(use_host_cd);
+    DEMSim.InstructBoxDomainDimension(4, 4, 4);
+
+    auto mat_type = DEMSim.LoadMaterial({{"E", 1e8}, {"nu", 0.3}, {"CoR", 0.5}, {"mu", 0.4}});
+    // Analytical walls, so sphere--analytical contacts are checked too
+    DEMSim.InstructBoxDomainBoundingBC("all", mat_type);
+    DEMSim.AddBCPlane(make_float3(0, 0, -1.5), make_float3(0, 0, 1), mat_type);
+
+    // A two-sphere clump, so component offsets matter
+    auto clump_type = DEMSim.LoadClumpType(1.f, make_float3(0.01, 0.01, 0.01), {0.1, 0.08},
+                                           {make_float3(-0.04, 0, 0), make_float3(0.05, 0, 0.02)}, mat_type);
+    auto particles =
+        DEMSim.AddClumps(std::vector<std::shared_ptr<DEMClumpTemplate>>(xyz.size(), clump_type), std::move(xyz));
+    // Nothing moves, so both runs see exactly the same geometry
+    particles->SetFamily(1);
+    DEMSim.SetFamilyFixed(1);
+
+    DEMSim.SetGravitationalAcceleration(make_float3(0, 0, 0));
+    DEMSim.SetInitTimeStep(1e-5);
+    DEMSim.SetCDUpdateFreq(5);
+    DEMSim.Initialize();
+    DEMSim.DoDynamicsThenSync(50 * 1e-5);
+
+    auto contacts = DEMSim.GetContacts();
+    std::sort(contacts.begin(), contacts.end());
+    return contacts;
+}
+
+int main() {
+    // Clumps a bit closer than their size, with some jitter, so there are plenty of contacts, some with the floor
+    std::vector<float3> xyz;
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<float> jitter(-0.02, 0.02);
+    GridSampler sampler(0.18);
+    for (auto& p : sampler.SampleBox(make_float3(0, 0, -0.9), make_float3(1.5, 1.5, 0.55))) {
+        xyz.push_back(p + make_float3(jitter(rng), jitter(rng), jitter(rng)));
+    }
+    std::cout << "Number of clumps: " << xyz.size() << std::endl;
+
+    auto device_contacts = ContactsOfScene(false, xyz);
+    auto host_contacts = ContactsOfScene(true, xyz);
+    std::cout << "Contacts found on device: " << device_contacts.size() << std::endl;
+    std::cout << "Contacts found on host: " << host_contacts.size() << std::endl;
+
+    if (device_contacts.empty() || host_contacts != device_contacts) {
+        std::cout << "Host and device contact detection do not agree!" << std::endl;
+        return 1;
+    }
+    std::cout << "Host and device contact detection agree." << std::endl;
+    std::cout << "DEMdemo_HostContactDetection exiting..." << std::endl;
+    return 0;
+}
@@ -0,0 +1,124 @@
+//  Copyright (c) 2021, SBEL GPU Development Team
+//  Copyright (c) 2021, University of Wisconsin - Madison
+//
+//	SPDX-License-Identifier: BSD-3-Clause
+
+// =============================================================================
+// A check of mesh triangle reordering (SortTrianglesSpatially, ReorderTriangles
+// and the hostMortonOrder they use) on the host, so it needs no GPU. A mesh is
+// sorted along a Morton curve, shuffled, then put back in its file order. After
+// each step, every triangle must still carry its own nodes, normals and
+// wildcard values, and the current/as-loaded ID maps must agree with each other.
+// Returns non-zero if anything is lost on the way.
+// =============================================================================
+
+#include <DEM/BdrsAndObjs.h>
+#include <DEM/HostSideHelpers.hpp>
+#include <core/utils/DEMEPaths.h>
+
+#include <algorithm>
+#include <iostream>
+#include <random>
+
+using namespace deme;
+
+bool IsPermutation(const std::vector<size_t>& order, size_t n) {
+    std::vector<size_t> sorted = order;
+    std::sort(sorted.begin(), sorted.end());
+    for (size_t i = 0; i < sorted.size(); i++) {
+        if (sorted[i] != i)
+            return false;
+    }
+    return sorted.size() == n;
+}
+
+// Whether each triangle of mesh is the one of the as-loaded original that its ID map says it is
+bool MatchesOriginal(DEMMeshConnected& mesh, DEMMeshConnected& original) {
+    const size_t nTri = mesh.GetNumTriangles();
+    if (nTri != original.GetNumTriangles())
+        return false;
+    for (size_t i = 0; i < nTri; i++) {
+        const size_t input_id = mesh.GetTriangleInputID(i);
+        if (input_id >= nTri || mesh.GetTriangleCurrentID(input_id) != i)
+            return false;
+        const int3& f = mesh.GetIndicesVertexes()[i];
+        const int3& f0 = original.GetIndicesVertexes()[input_id];
+        const int3& n = mesh.GetIndicesNormals()[i];
+        const int3& n0 = original.GetIndicesNormals()[input_id];
+        if (f.x != f0.x || f.y != f0.y || f.z != f0.z || n.x != n0.x || n.y != n0.y || n.z != n0.z)
+            return false;
+        if (mesh.geo_wildcards["input_id"][i] != (float)input_id)
+            return false;
+    }
+    return true;
+}
+
+// Average distance between the centroids of consecutive triangles
+double AvgNeighborGap(DEMMeshConnected& mesh) {
+    const auto& faces = mesh.GetIndicesVertexes();
+    const auto& nodes = mesh.GetCoordsVertices();
+    double sum = 0.;
+    for (size_t i = 1; i < faces.size(); i++) {
+        float3 c0 = (nodes[faces[i - 1].x] + nodes[faces[i - 1].y] + nodes[faces[i - 1].z]) / 3.f;
+        float3 c1 = (nodes[faces[i].x] + nodes[faces[i].y] + nodes[faces[i].z]) / 3.f;
+        sum += length(c1 - c0);
+    }
+    return faces.size() > 1 ? sum / (faces.size() - 1) : 0.;
+}
+
+int main() {
+    DEMMeshConnected original;
+    if (!original.LoadWavefrontMesh(GetDEMEDataFile("mesh/sphere.obj"))) {
+        std::cout << "Failed to load the mesh!" << std::endl;
+        return 1;
+    }
+    const size_t nTri = original.GetNumTriangles();
+    // Tag each triangle with its as-loaded ID, so it can be told where it came from
+    std::vector<float> input_ids(nTri);
+    for (size_t i = 0; i < nTri; i++)
+        input_ids[i] = (float)i;
+    original.AddGeometryWildcard("input_id", input_ids);
+    DEMMeshConnected mesh = original;
+    bool ok = true;
+
+    // Morton order of the centroids, and applying it
+    const std::vector<size_t> order = mesh.SortTrianglesSpatially();
+    ok = ok && IsPermutation(order, nTri) && mesh.IsTriangleOrderChanged() && MatchesOriginal(mesh, original);
+    std::cout << "Avg gap between consecutive triangles: " << AvgNeighborGap(original) << " as loaded, "
+              << AvgNeighborGap(mesh) << " after the Morton sort" << std::endl;
+    ok = ok && AvgNeighborGap(mesh) < AvgNeighborGap(original);
+
+    // A second reordering on top of it must compose with the first
+    std::vector<size_t> shuffle(nTri);
+    for (size_t i = 0; i < nTri; i++)
+        shuffle[i] = i;
+    std::shuffle(shuffle.begin(), shuffle.end(), std::mt19937(42));
+    mesh.ReorderTriangles(shuffle);
+    ok = ok && MatchesOriginal(mesh, original);
+
+    // And ordering by the as-loaded IDs brings the file order back
+    std::vector<size_t> back(nTri);
+    for (size_t i = 0; i < nTri; i++)
+        back[i] = mesh.GetTriangleCurrentID(i);
+    mesh.ReorderTriangles(back);
+    ok = ok && MatchesOriginal(mesh, original);
+    for (size_t i = 0; i < nTri; i++)
+        ok = ok && mesh.GetTriangleInputID(i) == i;
+
+    // A bad order is refused, leaving the mesh as it was
+    bool refused = false;
+    try {
+        mesh.ReorderTriangles(std::vector<size_t>(nTri, 0));
+    } catch (const std::exception&) {
+        refused = true;
+    }
+    ok = ok && refused && MatchesOriginal(mesh, original);
+
+    if (!ok) {
+        std::cout << "Mesh triangle reordering lost track of the triangles!" << std::endl;
+        return 1;
+    }
+    std::cout << "Mesh triangle reordering keeps every triangle's data and IDs." << std::endl;
+    std::cout << "DEMdemo_MeshTriangleOrder exiting..." << std::endl;
+    return 0;
+}